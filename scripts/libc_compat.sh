@@ -28,7 +28,7 @@ cat >"$header" <<EOF
 /* This header is generated by scripts/libc_compat.sh */
 EOF
 
-for sym in fcntl64; do
+for sym in fcntl64 epoll_pwait2; do
     find_sym "$libc_path" "$sym" "$header"
 done
 
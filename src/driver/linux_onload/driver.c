@@ -528,6 +528,7 @@ static int __init onload_module_init(void)
   linux_tcp_helper_fops_udp.owner = THIS_MODULE;
   linux_tcp_helper_fops_pipe_writer.owner = THIS_MODULE;
   linux_tcp_helper_fops_pipe_reader.owner = THIS_MODULE;
+  linux_tcp_helper_fops_unix.owner = THIS_MODULE;
 
   rc = onload_sanity_checks();
   if( rc < 0 )
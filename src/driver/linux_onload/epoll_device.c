@@ -233,8 +233,7 @@ static int oo_epoll2_ctl(struct oo_epoll_private *priv, int op_kepfd,
   /* Fixme: epoll fd - do we want to accelerate something? */
   if( file->f_op != &linux_tcp_helper_fops_udp &&
       file->f_op != &linux_tcp_helper_fops_tcp ) {
-    if( ( file->f_op == &linux_tcp_helper_fops_pipe_reader ||
-          file->f_op == &linux_tcp_helper_fops_pipe_writer ) ) {
+    if( FILE_IS_ENDPOINT_PIPE(file) ) {
       priv->p.p2.do_spin = 1;
     }
 #if CI_CFG_EPOLL2
@@ -82,6 +82,23 @@ tcp_helper_rm_nopage_timesync(tcp_helper_resource_t* trs,
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+static struct page*
+tcp_helper_rm_nopage_steer(tcp_helper_resource_t* trs,
+                           struct vm_area_struct *vma,
+                           unsigned long offset)
+{
+  ci_netif* ni = &trs->netif;
+
+  OO_DEBUG_SHM(ci_log("%s: %u", __FUNCTION__, trs->id));
+
+  if( ni->steer == NULL || offset >= ni->steer_bytes )
+    return NULL;
+  return vmalloc_to_page((char*) ni->steer + offset);
+}
+#endif
+
+
 static struct page*
 tcp_helper_rm_nopage_iobuf(tcp_helper_resource_t* trs, struct vm_area_struct *vma,
                            unsigned long offset)
@@ -144,6 +161,11 @@ tcp_helper_rm_nopage(tcp_helper_resource_t* trs, struct vm_area_struct *vma,
     case CI_NETIF_MMAP_ID_IOBUFS:
       *page_out = tcp_helper_rm_nopage_iobuf(trs, vma, offset);
       return *page_out == NULL ? VM_FAULT_SIGBUS : 0;
+#if CI_CFG_CLUSTER_STEER
+    case CI_NETIF_MMAP_ID_STEER:
+      *page_out = tcp_helper_rm_nopage_steer(trs, vma, offset);
+      return *page_out == NULL ? VM_FAULT_SIGBUS : 0;
+#endif
     case CI_NETIF_MMAP_ID_IO:
     case CI_NETIF_MMAP_ID_EFCT_SHM:
 #if CI_CFG_PIO
@@ -443,6 +465,21 @@ static int tcp_helper_rm_mmap_efct_shm(tcp_helper_resource_t* trs,
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+static int tcp_helper_rm_mmap_steer(tcp_helper_resource_t* trs,
+                                    unsigned long bytes,
+                                    struct vm_area_struct* vma)
+{
+  OO_DEBUG_VM(ci_log("%s: %u bytes=0x%lx", __func__, trs->id, bytes));
+
+  /* Pages are supplied by the nopage handler. */
+  if( trs->netif.steer == NULL || bytes != trs->netif.steer_bytes )
+    return -EINVAL;
+  return 0;
+}
+#endif
+
+
 static int tcp_helper_rm_mmap_pkts(tcp_helper_resource_t* trs,
                                    unsigned long bytes,
                                    struct vm_area_struct* vma, uint64_t map_id)
@@ -520,6 +557,11 @@ efab_tcp_helper_rm_mmap(tcp_helper_resource_t* trs, unsigned long bytes,
     case CI_NETIF_MMAP_ID_EFCT_SHM:
       rc = tcp_helper_rm_mmap_efct_shm(trs, bytes, vma);
       break;
+#if CI_CFG_CLUSTER_STEER
+    case CI_NETIF_MMAP_ID_STEER:
+      rc = tcp_helper_rm_mmap_steer(trs, bytes, vma);
+      break;
+#endif
     default:
       /* CI_NETIF_MMAP_ID_PKTS + set_id */
       rc = tcp_helper_rm_mmap_pkts(trs, bytes, vma, map_id);
@@ -32,6 +32,7 @@ static struct file_operations *oo_fops_by_type(oo_fd_flags fd_flags)
     case OO_FDFLAG_EP_ALIEN: return &linux_tcp_helper_fops_alien;
     case OO_FDFLAG_EP_PIPE_READ: return &linux_tcp_helper_fops_pipe_reader;
     case OO_FDFLAG_EP_PIPE_WRITE: return &linux_tcp_helper_fops_pipe_writer;
+    case OO_FDFLAG_EP_UNIX: return &linux_tcp_helper_fops_unix;
     default:
       CI_DEBUG(ci_log("%s: error fd_flags "OO_FDFLAG_FMT,
                       __FUNCTION__, OO_FDFLAG_ARG(fd_flags)));
@@ -411,6 +411,10 @@ typedef struct {
   ci_int32      sack_blocks;
   ci_uint32     ack,seq;         /* ACK and SEQ values in host endian */
   ci_uint32     hash;            /* hash for l/r addr/port */
+  /* Fast Open cookie in a SYN or SYN-ACK, valid iff CI_TCPT_FLAG_TFO is
+   * set in [flags].  Zero length is a cookie request. */
+  const ci_uint8* tfo_cookie;
+  ci_int32      tfo_cookie_len;
 } ciip_tcp_rx_pkt;
 
 
@@ -482,6 +486,7 @@ extern int  ci_netif_poll_intf_future(ci_netif*, int intf_i, ci_uint64 now_frc)
 extern int  ci_netif_poll_n(ci_netif*, int max_evs) CI_HF;
 #define     ci_netif_poll(ni)  ci_netif_poll_n((ni), NI_OPTS(ni).evs_per_poll)
 extern void ci_netif_loopback_pkts_send(ci_netif* ni) CI_HF;
+extern void ci_netif_get_rx_timestamp(ci_netif* ni, ci_ip_pkt_fmt* pkt) CI_HF;
 
 #if CI_CFG_WANT_BPF_NATIVE
 #ifdef __KERNEL__
@@ -874,6 +879,26 @@ extern void ci_udp_ep_assert_valid(citp_socket* ep,
 extern void ci_udp_handle_rx(ci_netif*, ci_ip_pkt_fmt* pkt, ci_udp_hdr*,
                              int ip_paylen) CI_HF;
 
+#if CI_CFG_IP_REASM
+/*** ip_reasm.c ***/
+extern void ci_ip_reasm_init(ci_netif*) CI_HF;
+extern void ci_ip_reasm_rx(ci_netif*, ci_ip_pkt_fmt* pkt) CI_HF;
+extern void ci_ip_reasm_timeout(ci_netif*) CI_HF;
+#endif
+
+#if CI_CFG_TX_PACING
+/*** tx_pacing.c ***/
+/* Pacing rates from this up are treated as unlimited. */
+#define CI_TX_PACE_RATE_MAX  (1ull << 34)
+extern void ci_tx_pace_init(ci_netif*) CI_HF;
+extern ci_int32 ci_tx_pace_tokens(ci_netif*, ci_sock_cmn*, ci_uint64 rate,
+                                  ci_int32 quantum) CI_HF;
+extern void ci_tx_pace_throttle(ci_netif*, ci_sock_cmn*, ci_uint64 rate,
+                                ci_int32 need) CI_HF;
+extern ci_uint64 ci_tcp_pace_rate(ci_netif*, ci_tcp_state*) CI_HF;
+extern void ci_tx_pace_timeout(ci_netif*) CI_HF;
+#endif
+
 
 ci_inline 
 void ci_pkt_init_from_ipcache_len(ci_ip_pkt_fmt *pkt,
@@ -922,8 +947,10 @@ struct cmsg_state {
 
 extern void ci_put_cmsg(struct cmsg_state *cmsg_state, int level, int type,
                         socklen_t len, const void *data) CI_HF;
-/* info_out contains a pointer to struct in_pktinfo or struct in6_pktinfo */
-extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out) CI_HF;
+/* info_out contains a pointer to struct in_pktinfo or struct in6_pktinfo,
+ * gso_size_out is updated if UDP_SEGMENT is present */
+extern int ci_ip_cmsg_send(const struct msghdr*, void** info_out,
+                           ci_uint16* gso_size_out) CI_HF;
 extern void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state) CI_HF;
 
 #ifndef __KERNEL__
@@ -996,6 +1023,24 @@ extern int ci_udp_recvmmsg(ci_udp_iomsg_args *a, struct mmsghdr* mmsg,
 struct onload_zc_mmsg;
 extern int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, 
                           struct onload_zc_mmsg* msgs, int flags);
+extern bool ci_netif_zc_usermem_unsupported(ci_netif* ni);
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY)
+/* Shorter MSG_ZEROCOPY sends are copied: pinning the pages would cost more
+ * than copying them. */
+#define CI_TCP_ZEROCOPY_MIN_LEN  EF_VI_NIC_PAGE_SIZE
+#define CI_TCP_ZEROCOPY_MAX_LEN  0x3fffffff
+/* The most MSG_ZEROCOPY sends per socket whose pages are pinned */
+#define CI_TCP_ZEROCOPY_MAX_PINNED  64
+extern int ci_tcp_zerocopy_pin_ok(ci_netif* ni, ci_tcp_state* ts,
+                                  const ci_iovec* iov, unsigned long iovlen);
+extern void ci_tcp_zerocopy_copied_init(ci_netif* ni, ci_tcp_state* ts,
+                                        ci_ip_pkt_fmt* pkt, ci_uint32 id);
+#endif
+#if CI_CFG_TIMESTAMPING
+extern void ci_tcp_zc_complete_to_cmsg(ci_netif* ni, ci_tcp_state* ts,
+                                       ci_ip_pkt_fmt* pkt,
+                                       struct cmsg_state* cmsg_state);
+#endif
 struct onload_zc_recv_args;
 int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args);
 
@@ -1020,7 +1065,7 @@ ci_netif_raw_send(ci_netif* ni, int intf_i,
 
 extern void ci_ip_cmsg_recv(ci_netif*, ci_udp_state*, const ci_ip_pkt_fmt*,
                             struct msghdr*, int netif_locked,
-                            int *p_msg_flags) CI_HF;
+                            int *p_msg_flags, int gro_size) CI_HF;
 #if OO_DO_STACK_POLL
 extern void ci_udp_all_fds_gone(ci_netif* netif, oo_sp, int do_free);
 #endif
@@ -1029,6 +1074,13 @@ extern void ci_udp_state_try_free(ci_netif*, ci_udp_state*) CI_HF;
 extern int ci_udp_csum_correct(ci_ip_pkt_fmt* pkt, ci_udp_hdr* udp) CI_HF;
 
 extern void ci_udp_sendmsg_send_async_q(ci_netif*, ci_udp_state*) CI_HF;
+#if CI_CFG_UDP_SEND_RING
+extern void ci_udp_sendmsg_send_ring(ci_netif*, ci_udp_state*) CI_HF;
+#endif
+#if CI_CFG_TX_PACING
+extern void ci_udp_sendmsg_send_paced(ci_netif*, ci_udp_state*,
+                                      int all) CI_HF;
+#endif
 extern void ci_udp_perform_deferred_socket_work(ci_netif*, ci_udp_state*)CI_HF;
 extern int ci_udp_try_to_free_pkts(ci_netif*, ci_udp_state*,
                                     int desperation) CI_HF;
@@ -1044,11 +1096,20 @@ struct ci_pipe_pkt_list {
 typedef int (*ci_pipe_zc_read_cb)(void* context, struct iovec* iovec,
                                  int iov_num, int flags);
 
+/* [flags] may include MSG_DONTWAIT, and MSG_PEEK for reads or MSG_NOSIGNAL
+ * for writes. */
 extern int ci_pipe_read(ci_netif*, struct oo_pipe*, const struct iovec*,
-                  size_t iovlen) CI_HF;
+                  size_t iovlen, int flags) CI_HF;
 extern int oo_pipe_write_block(ci_netif* ni, struct oo_pipe* p, int flags) CI_HF;
 extern int ci_pipe_write(ci_netif*, struct oo_pipe*, const struct iovec*,
-                         size_t iovlen) CI_HF;
+                         size_t iovlen, int flags) CI_HF;
+/* Called by ci_pipe_write_cb() with the stack locked, just before the first
+ * byte is written, with the position of that byte in the stream.  It must
+ * not block.  A negative return is an error, and then nothing is written. */
+typedef int (*ci_pipe_write_start_cb)(void* context, ci_uint32 pos);
+extern int ci_pipe_write_cb(ci_netif*, struct oo_pipe*, const struct iovec*,
+                            size_t iovlen, int flags,
+                            ci_pipe_write_start_cb start_cb, void* ctx) CI_HF;
 extern int ci_pipe_zc_read(ci_netif* ni, struct oo_pipe* p, int len,
                            int flags, ci_pipe_zc_read_cb cb, void* ctx) CI_HF;
 extern int ci_pipe_zc_move(ci_netif* ni, struct oo_pipe* pipe_src,
@@ -1308,6 +1369,14 @@ extern int ci_pipe_list_to_iovec(ci_netif* ni, struct oo_pipe* p,
 #define TCP_NEED_ACK(ts)    (++(ts)->acks_pending)
 #define TCP_ACK_FORCED(ts)  ((ts)->acks_pending & CI_TCP_ACK_FORCED_FLAG)
 
+/* Whether a forced ACK for in-order data may be left to
+ * ci_tcp_rx_post_poll(), so that one ACK covers everything the current poll
+ * delivered to [ts].  TCP_NODELAY sockets want their ACKs on time. */
+#define TCP_ACK_MAY_COALESCE(ni, ts)                                    \
+  (NI_OPTS(ni).tcp_ack_coalesce &&                                      \
+   (ts)->s.b.state == CI_TCP_ESTABLISHED &&                             \
+   ! ((ts)->s.s_aflags & CI_SOCK_AFLAG_NODELAY))
+
 /* macros for getting source and dest addresses and ports */
 #if CI_CFG_IPV6
 #define ipcache_ttl(ipcache) (*(ipcache_is_ipv6(ipcache) ? \
@@ -1513,6 +1582,25 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
                      ciip_tcp_rx_pkt* rxp,
                      ci_tcp_state_synrecv **tsr_p);
 
+/* TCP Fast Open cookies.  The server generates them from the client
+ * address with the stack's secret salt, and clients keep the ones they
+ * receive in a per-stack cache. */
+#define CI_TCP_FASTOPEN_COOKIE_LEN  8
+#define CI_TCP_FASTOPEN_COOKIE_MIN  4
+#define CI_TCP_FASTOPEN_COOKIE_MAX  16
+extern void
+ci_tcp_fastopen_cookie(ci_netif* netif, const ci_addr_t* raddr,
+                       ci_uint8* cookie);
+extern int
+ci_tcp_fastopen_cookie_ok(ci_netif* netif, const ci_addr_t* raddr,
+                          const ci_uint8* cookie, int len);
+extern int
+ci_tcp_fastopen_cache_get(ci_netif* netif, const ci_addr_t* raddr,
+                          ci_uint8* cookie);
+extern void
+ci_tcp_fastopen_cache_put(ci_netif* netif, const ci_addr_t* raddr,
+                          const ci_uint8* cookie, int len);
+
 extern void ci_tcp_set_sndbuf(ci_netif* ni, ci_tcp_state* ts);
 extern void ci_tcp_set_sndbuf_from_sndbuf_pkts(ci_netif* ni, ci_tcp_state* ts);
 
@@ -1655,12 +1743,19 @@ extern const char* ci_tcp_congstate_str(unsigned state) CI_HF;
 extern void ci_tcp_handle_rx(ci_netif*, struct ci_netif_poll_state*,
                              ci_ip_pkt_fmt*, ci_tcp_hdr*, int ip_paylen) CI_HF;
 extern void ci_tcp_rx_deliver2(ci_tcp_state*,ci_netif*,ciip_tcp_rx_pkt*) CI_HF;
+extern void ci_tcp_rx_forced_ack(ci_netif*, ci_tcp_state*, int in_order,
+                                 int was_forced, int do_update_wnd) CI_HF;
 extern void ci_tcp_rx_plugin_meta(ci_netif*, struct ci_netif_poll_state*,
                                   ci_ip_pkt_fmt* pkt) CI_HF;
 
 extern void ci_tcp_tx_change_mss(ci_netif*, ci_tcp_state*) CI_HF;
 extern void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
                                    ci_ip_pkt_fmt* pkt) CI_HF;
+extern int ci_tcp_enqueue_syn_fastopen(ci_tcp_state* ts, ci_netif* netif,
+                                       ci_ip_pkt_fmt* pkt,
+                                       const ci_iovec* iov, int iovlen) CI_HF;
+extern void ci_tcp_fastopen_retrans_syn_data(ci_netif* netif,
+                                             ci_tcp_state* ts) CI_HF;
 extern int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
                                ci_tcp_state_synrecv* tsr, 
@@ -1684,6 +1779,23 @@ extern void ci_tcp_retrans_init_ptrs(ci_netif* ni, ci_tcp_state* ts,
 extern void ci_tcp_get_fack(ci_netif* ni, ci_tcp_state* ts,
                             unsigned* fack_out, int* retrans_data_out) CI_HF;
 
+#if CI_CFG_TCP_RACK
+/*** tcp_rack.c ***/
+extern void ci_tcp_rack_init(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+/* [pkt] has been newly acked or SACKed. */
+extern void ci_tcp_rack_delivered(ci_netif* ni, ci_tcp_state* ts,
+                                  ci_ip_pkt_fmt* pkt) CI_HF;
+extern void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+extern void ci_tcp_rack_recovered(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+/* Returns true if [pkt] is lost.  If not, but it will be unless it is
+ * delivered in time, sets the RACK timer. */
+extern int /*bool*/
+ci_tcp_rack_is_lost(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt) CI_HF;
+/* As ci_tcp_rack_is_lost() for the head of the retransmit queue. */
+extern int /*bool*/
+ci_tcp_rack_head_lost(ci_netif* ni, ci_tcp_state* ts) CI_HF;
+#endif
+
 
 extern void ci_tcp_retrans_coalesce_block(ci_netif* ni, ci_tcp_state* ts,
                                           ci_ip_pkt_fmt* pkt) CI_HF;
@@ -1707,6 +1819,22 @@ extern void ci_tcp_send_rst(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void
 ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
                       ciip_tcp_rx_pkt* rxp) CI_HF;
+#if CI_CFG_TCP_REPLY_CACHE_SIZE
+extern void
+ci_tcp_reply_retrieve(ci_netif* netif, ci_ip_cached_hdrs* ipcache,
+                      const struct oo_sock_cplane* sock_cp) CI_HF;
+ci_inline void ci_tcp_reply_cache_init(ci_netif* netif)
+{
+  int i;
+  for( i = 0; i < CI_CFG_TCP_REPLY_CACHE_SIZE; ++i ) {
+    netif->tcp_reply_cache[i].ipcache.status = retrrc_noroute;
+    ci_ip_cache_invalidate(&netif->tcp_reply_cache[i].ipcache);
+  }
+}
+#else
+# define ci_tcp_reply_retrieve cicp_user_retrieve
+ci_inline void ci_tcp_reply_cache_init(ci_netif* netif) {}
+#endif
 extern int ci_tcp_reset_untrusted(ci_netif *netif, ci_tcp_state *ts) CI_HF;
 extern void ci_tcp_send_zwin_probe(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_set_established_state(ci_netif*, ci_tcp_state*) CI_HF;
@@ -1729,6 +1857,8 @@ ci_inline void ci_tcp_send_ack(ci_netif* netif, ci_tcp_state* ts,
 }
 extern int ci_tcp_send_challenge_ack(ci_netif*, ci_tcp_state*,
                                      ci_ip_pkt_fmt*) CI_HF;
+extern int ci_tcp_send_fastopen_synack(ci_netif*, ci_tcp_state*,
+                                       ci_ip_pkt_fmt*) CI_HF;
 extern int/*bool*/
 ci_tcp_may_send_ack_ratelimited(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 
@@ -1909,6 +2039,9 @@ extern void ci_tcp_timeout_zwin(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_delack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_timeout_cork(ci_netif* netif, ci_tcp_state* ts) CI_HF;
+#if CI_CFG_TCP_RACK
+extern void ci_tcp_timeout_rack(ci_netif* netif, ci_tcp_state* ts) CI_HF;
+#endif
 extern void ci_tcp_timeout_recycle(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts) CI_HF;
 extern void ci_tcp_send_corked_packets(ci_netif* netif, ci_tcp_state* ts) CI_HF;
@@ -2014,6 +2147,10 @@ extern int  ci_netif_lock_or_defer_work(ci_netif*, citp_waitable*) CI_HF;
 #ifndef __KERNEL__
 extern int ci_tcp_connect(citp_socket*, const struct sockaddr*, socklen_t,
                           ci_fd_t fd, int *p_moved) CI_HF;
+extern int ci_tcp_connect_fastopen(citp_socket*, const struct sockaddr*,
+                                   socklen_t, ci_fd_t fd,
+                                   const ci_iovec* iov, int iovlen,
+                                   int* tfo_len) CI_HF;
 extern int ci_tcp_shutdown(citp_socket*, int how, ci_fd_t fd) CI_HF;
 #endif
 
@@ -2597,6 +2734,15 @@ ci_inline void ci_ip_time_get_us(ci_ip_timer_state* its, ci_iptime_t* t) {
 #endif  
 }
 
+/*! This function gets the cached free cycle counter time in us, as of the
+**  last ci_ip_time_update()
+**  \param ni   A pointer to the netif
+*/
+ci_inline ci_iptime_t ci_ip_time_now_us(ci_netif* ni) {
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return (ci_iptime_t)(its->frc >> its->ci_ip_time_frc2us);
+}
+
 /*! Convert a time measure in ms to the number of ticks
 **  \param ni   A pointer to the netif 
 **  \param t    The time in ms
@@ -2714,6 +2860,48 @@ ci_inline int ci_netif_intf_has_event(ci_netif* ni, int intf_i)
 { return ef_eventq_has_event(ci_netif_vi(ni, intf_i)); }
 
 
+#if CI_CFG_CLUSTER_STEER
+/* Stops instance 0 from passing packets to [ring].  Returns false if it may
+ * still be filling a slot, in which case the ring must not be reused until
+ * a later call returns true. */
+ci_inline int oo_steer_ring_stop(struct oo_steer_ring* ring)
+{
+  ring->live = 0;
+  ci_mb();
+  return ! ring->busy;
+}
+
+/* Returns slot [i] of the steering ring of [instance]. */
+ci_inline struct oo_steer_slot*
+ci_netif_steer_slot(ci_netif* ni, unsigned instance, ci_uint32 i)
+{
+  ci_assert_gt(instance, 0);
+  ci_assert_lt(instance, ni->steer_n_rings);
+  return (struct oo_steer_slot*) ((char*) ni->steer + OO_STEER_SLOTS_OFS) +
+         (instance - 1) * (ni->steer_ring_mask + 1) +
+         (i & ni->steer_ring_mask);
+}
+
+
+/* Returns true if another stack of the cluster has left packets in this
+ * stack's steering ring. */
+ci_inline int ci_netif_steer_has_rx(ci_netif* ni)
+{
+  struct oo_steer_ring* ring;
+  if( ni->steer == NULL || ni->steer_instance == 0 )
+    return 0;
+  ring = &ni->steer->ring[ni->steer_instance];
+  return ring->head != ring->tail;
+}
+
+extern int ci_netif_steer_rx(ci_netif* ni, ci_ip_pkt_fmt* pkt) CI_HF;
+extern void ci_netif_steer_pkt_fill(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                                    const struct oo_steer_slot* slot,
+                                    unsigned len, int intf_i) CI_HF;
+extern void ci_netif_steer_kick(ci_netif* ni) CI_HF;
+#endif
+
+
 /* Returns true if there are any hardware events outstanding on any
  * interface.
  */
@@ -2726,6 +2914,10 @@ ci_inline int ci_netif_has_event(ci_netif* ni) {
     }
   if( OO_PP_NOT_NULL(ni->state->looppkts) )
     rc = 1;
+#if CI_CFG_CLUSTER_STEER
+  if( ci_netif_steer_has_rx(ni) )
+    rc = 1;
+#endif
   return rc;
 }
 
@@ -3962,6 +4154,44 @@ ci_inline unsigned ci_tcp_taildrop_timeout(const ci_netif* netif,
 
 #endif
 
+#if CI_CFG_TX_PACING
+/* Returns the SO_MAX_PACING_RATE of [s], or 0 if it is not paced. */
+ci_inline ci_uint64 ci_tx_pace_max_rate(const ci_sock_cmn* s)
+{
+  if( s->pace_max_rate >= CI_TX_PACE_RATE_MAX )
+    return 0;
+  return CI_MAX(s->pace_max_rate, 1);
+}
+
+ci_inline void ci_tx_pace_cancel(ci_netif* ni, ci_sock_cmn* s)
+{
+  oo_p_dllink_del_init(ni, oo_p_dllink_sb(ni, &s->b, &s->pace_link));
+}
+#endif
+
+/* Loopback connections and MSG_WARM are never paced. */
+ci_inline int ci_tcp_may_pace(const ci_netif* ni, const ci_tcp_state* ts)
+{
+#if CI_CFG_TX_PACING
+  return (ts->s.pace_max_rate < CI_TX_PACE_RATE_MAX ||
+          NI_OPTS(ni).tcp_auto_pacing) &&
+         OO_SP_IS_NULL(ts->local_peer) &&
+         ! (ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE) &&
+         ! (ts->tcpflags & CI_TCPT_FLAG_MSG_WARM);
+#else
+  return 0;
+#endif
+}
+
+ci_inline int ci_tcp_rack_enabled(const ci_netif* ni, const ci_tcp_state* ts)
+{
+#if CI_CFG_TCP_RACK
+  return NI_OPTS(ni).tcp_rack && (ts->tcpflags & CI_TCPT_FLAG_SACK);
+#else
+  return 0;
+#endif
+}
+
 /* keep alive timers */
 
 /*
@@ -4126,6 +4356,11 @@ ci_inline void ci_tcp_retrans_drop(ci_netif* ni, ci_tcp_state* ts)
   ci_ip_queue_drop(ni, &ts->retrans);
 }
 
+#if CI_CFG_TIMESTAMPING
+extern void ci_tcp_zerocopy_release(ci_netif* ni, ci_tcp_state* ts,
+                                    ci_ip_pkt_fmt* pkt) CI_HF;
+#endif
+
 extern int ci_tcp_add_fin(ci_tcp_state* ts, ci_netif* netif) CI_HF;
 /* Try to re-send pending FIN, return true in success. */
 static inline int ci_tcp_resend_fin(ci_tcp_state* ts, ci_netif* netif)
@@ -4399,6 +4634,43 @@ ci_inline unsigned ci_tcp_losswnd(ci_tcp_state* ts) {
   return CI_MAX(x, y);
 }
 
+/* Congestion control algorithms, selected per socket by [c.cc_algo] (one
+ * of CI_TCP_CC_*).  Slow start, fast recovery and the response to RTO are
+ * common to all of them: an algorithm decides how cwnd grows in congestion
+ * avoidance and how far it is cut on loss.
+ */
+typedef struct {
+  const char* name;     /* as for TCP_CONGESTION */
+  /* Forget any state: at connection start, on RTO and when selected. */
+  void (*init)(ci_netif* ni, ci_tcp_state* ts);
+  /* New data has been ACKed with cwnd >= ssthresh.  Grow cwnd, consuming
+   * [bytes_acked] as it does so. */
+  void (*cong_avoid)(ci_netif* ni, ci_tcp_state* ts);
+  /* Loss has been detected.  Returns the new value for [ssthresh]. */
+  ci_uint32 (*ssthresh)(ci_netif* ni, ci_tcp_state* ts);
+} ci_tcp_cc_ops;
+
+#define CI_TCP_CC_N  2
+extern const ci_tcp_cc_ops* const ci_tcp_cc_algos[CI_TCP_CC_N];
+
+/* [cc_algo] is in shared state, so don't trust it. */
+ci_inline const ci_tcp_cc_ops* ci_tcp_cc_algo(unsigned algo) {
+  return ci_tcp_cc_algos[algo < CI_TCP_CC_N ? algo : CI_TCP_CC_RENO];
+}
+
+ci_inline const ci_tcp_cc_ops* ci_tcp_cc(ci_tcp_state* ts) {
+  return ci_tcp_cc_algo(ts->c.cc_algo);
+}
+
+/* Integer cube root used by CUBIC, rounding down.  [a] < 2^63. */
+extern ci_uint32 ci_tcp_cubic_cbrt(ci_uint64 a);
+
+/* Returns the CI_TCP_CC_* value for the algorithm called [name], or -1. */
+extern int ci_tcp_cc_find(const char* name, int len) CI_HF;
+/* Switch [ts] to algorithm [algo] and reset its state. */
+extern void ci_tcp_cc_select(ci_netif* ni, ci_tcp_state* ts,
+                             unsigned algo) CI_HF;
+
 
 #if CI_CFG_BURST_CONTROL
 ci_inline unsigned ci_tcp_burst_exhausted(ci_netif* ni, ci_tcp_state* ts) {
@@ -4432,12 +4704,35 @@ ci_inline int ci_tcp_sendq_n_pkts(ci_tcp_state* ts) {
   return n >= 0 ? n : 0;
 }
 
+/* Return number of payload bytes that have been queued by the app but not
+ * yet sent, including the prequeue.  As above, the result may be stale.
+ */
+ci_inline int ci_tcp_sendq_unsent_bytes(ci_tcp_state* ts) {
+  int n = SEQ_SUB(tcp_enq_nxt(ts), tcp_snd_nxt(ts)) +
+          oo_atomic_read(&ts->send_prequeue_bytes);
+  return n >= 0 ? n : 0;
+}
+
+/* TCP_NOTSENT_LOWAT in effect for this socket, or 0 if none. */
+ci_inline ci_uint32 ci_tcp_notsent_lowat(ci_netif* ni, ci_tcp_state* ts) {
+  return ts->c.notsent_lowat ? ts->c.notsent_lowat :
+                               NI_OPTS(ni).tcp_notsent_lowat;
+}
+
 /* This test is used to decide whether we should indicate to the app that
 ** it can enqueue more data on a socket.  ie. It is used to decide when to
 ** wake a blocking thread, and to decide whether to indicate the socket is
 ** writable in select() and poll().
+**
+** With TCP_NOTSENT_LOWAT, Linux waits until less than half the limit is
+** unsent, so that a writer is not woken for every segment sent.
 */
 ci_inline int ci_tcp_tx_advertise_space(ci_netif* ni, ci_tcp_state* ts) {
+  ci_uint32 lowat = ci_tcp_notsent_lowat(ni, ts);
+  if( lowat != 0 &&
+      ((ci_uint64) ci_tcp_sendq_unsent_bytes(ts) << 1) >= lowat )
+    return 0;
+
   if( NI_OPTS(ni).tcp_sndbuf_mode ) {
     int pkts_queued = ci_tcp_sendq_n_pkts(ts)
 #if CI_CFG_TIMESTAMPING
@@ -4454,13 +4749,31 @@ ci_inline int ci_tcp_tx_advertise_space(ci_netif* ni, ci_tcp_state* ts) {
   }
 }
 
+/* Whether a writer should be woken as data is sent from the sendq.  Sending
+ * is what makes room under TCP_NOTSENT_LOWAT; otherwise, with
+ * EF_TCP_SNDBUF_MODE, the writer waits for the ACK.
+ */
+ci_inline int ci_tcp_tx_wake_on_send(ci_netif* ni, ci_tcp_state* ts) {
+  return (NI_OPTS(ni).tcp_sndbuf_mode == 0 ||
+          ci_tcp_notsent_lowat(ni, ts) != 0) &&
+         ci_tcp_tx_advertise_space(ni, ts);
+}
+
 /* Returns the number of additional packet buffers that this socket is
  * permitted to queue on its send queue.
+ *
+ * With TCP_NOTSENT_LOWAT that is enough segments to reach the limit, so
+ * that, as on Linux, the unsent data may overshoot it by less than a
+ * segment.
  */
 ci_inline int ci_tcp_tx_send_space(ci_netif* ni, ci_tcp_state* ts)
 {
+  ci_uint32 lowat = ci_tcp_notsent_lowat(ni, ts);
+  ci_uint32 unsent, mss;
+  int space;
+
   if( NI_OPTS(ni).tcp_sndbuf_mode ) {
-    return ts->so_sndbuf_pkts -
+    space = ts->so_sndbuf_pkts -
         (ci_tcp_sendq_n_pkts(ts)
 #if CI_CFG_TIMESTAMPING
          + ci_udp_recv_q_pkts(&ts->timestamp_q)
@@ -4468,7 +4781,16 @@ ci_inline int ci_tcp_tx_send_space(ci_netif* ni, ci_tcp_state* ts)
          + ts->retrans.num);
   }
   else
-    return ts->so_sndbuf_pkts - ci_tcp_sendq_n_pkts(ts);
+    space = ts->so_sndbuf_pkts - ci_tcp_sendq_n_pkts(ts);
+
+  if( lowat != 0 && space > 0 ) {
+    unsent = ci_tcp_sendq_unsent_bytes(ts);
+    if( unsent >= lowat )
+      return 0;
+    mss = CI_MAX(tcp_eff_mss(ts), 1);
+    space = CI_MIN((ci_uint32) space, (lowat - unsent - 1) / mss + 1);
+  }
+  return space;
 }
 
 
@@ -4599,21 +4921,120 @@ ci_inline int  ci_sock_is_locked(ci_netif* ni, citp_waitable* w)
 #define ci_tcp_acceptq_n(tls)			\
   ((tls)->acceptq_n_in - (tls)->acceptq_n_out)
 
-/* Use this if you do own the [get] lock. */
-#define ci_tcp_acceptq_not_empty(tls)                                   \
-  (((tls)->acceptq_put >= 0) | OO_SP_NOT_NULL((tls)->acceptq_get))
+/* Fast Open connections waiting to be accepted. */
+#define ci_tcp_acceptq_n_tfo(tls)               \
+  ((tls)->tfo_n_in - (tls)->tfo_n_out)
+
+ci_inline int ci_tcp_acceptq_is_tfo(citp_waitable* w) {
+  ci_tcp_state* ts = &CI_CONTAINER(citp_waitable_obj, waitable, w)->tcp;
+  return (ts->tcpflags & (CI_TCPT_FLAG_TFO | CI_TCPT_FLAG_PASSIVE_OPENED)) ==
+         (CI_TCPT_FLAG_TFO | CI_TCPT_FLAG_PASSIVE_OPENED);
+}
+
+/* Account for [w] leaving the accept queue, or being put back on it. */
+ci_inline void ci_tcp_acceptq_tfo_out(ci_tcp_socket_listen* tls,
+                                      citp_waitable* w, int put_back) {
+  if(CI_UNLIKELY( ci_tcp_acceptq_is_tfo(w) )) {
+    if( put_back )
+      ci_atomic32_dec(&tls->tfo_n_out);
+    else
+      ci_atomic32_inc(&tls->tfo_n_out);
+  }
+}
+
+/* May another connection accept data from its SYN with Fast Open? */
+ci_inline int ci_tcp_acceptq_tfo_ok(ci_tcp_socket_listen* tls) {
+  return ci_tcp_acceptq_n_tfo(tls) < tls->c.tfo_qlen;
+}
+
+
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+/* Accept queue sharding (EF_TCP_ACCEPTQ_SHARDS).  A sharded listening
+ * socket queues each connection on one of acceptq_shard[] by flow hash, and
+ * the [get] side of each shard has its own lock.  Accepting threads each
+ * have a preferred shard, so that they do not contend with one another.
+ *
+ * The lock order is sock lock, then shard lock.  A shard lock is held only
+ * while moving sockets on or off the shard.
+ */
+#define ci_tcp_acceptq_sharded(tls)  ((tls)->acceptq_n_shards > 1)
+
+#define ci_tcp_acceptq_shard_not_empty(sh)                              \
+  (((sh)->put >= 0) | OO_SP_NOT_NULL((sh)->get))
+
+ci_inline int ci_tcp_acceptq_shard_trylock(struct ci_tcp_acceptq_shard* sh)
+{
+  return sh->lock == 0 && ci_cas32u_succeed(&sh->lock, 0, 1);
+}
+
+#ifdef __KERNEL__
+/* The holder is usually a user-level thread, which may have died while
+ * holding the lock.  Taking the lock from it could corrupt the shard, so
+ * retry for a while and then give up, leaving the shard to its holder.
+ * Returns true if the lock was taken.
+ */
+ci_inline int ci_tcp_acceptq_shard_lock_kernel(struct ci_tcp_acceptq_shard* sh)
+{
+  int i;
+  for( i = 0; i < 1000000; ++i ) {
+    if( ci_tcp_acceptq_shard_trylock(sh) )
+      return 1;
+    ci_spinloop_pause();
+  }
+  return 0;
+}
+#else
+ci_inline void ci_tcp_acceptq_shard_lock(struct ci_tcp_acceptq_shard* sh)
+{
+  while( ! ci_tcp_acceptq_shard_trylock(sh) )
+    ci_spinloop_pause();
+}
+#endif
+
+ci_inline void ci_tcp_acceptq_shard_unlock(struct ci_tcp_acceptq_shard* sh)
+{
+  ci_assert(sh->lock);
+  ci_mb();
+  sh->lock = 0;
+}
+#else
+#define ci_tcp_acceptq_sharded(tls)  0
+#endif
+
+
+/* Should not be called directly. */
+ci_inline void __ci_tcp_acceptq_push(ci_netif* ni, ci_int32* put,
+                                     citp_waitable* w)
+{
+  do
+    w->wt_next = OO_SP_FROM_INT(ni, *put);
+  while( ci_cas32_fail(put, OO_SP_TO_INT(w->wt_next), W_ID(w)) );
+}
 
 
 ci_inline void ci_tcp_acceptq_put(ci_netif* ni,
                                   ci_tcp_socket_listen* tls,
 				  citp_waitable* w) {
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  ci_uint32 n_shards = CI_READ_ONCE(tls->acceptq_n_shards);
+#endif
   ci_assert(OO_SP_IS_NULL(w->wt_next));
   ci_assert(ci_netif_is_locked(ni));
-  do
-    w->wt_next = OO_SP_FROM_INT(ni, tls->acceptq_put);
-  while( ci_cas32_fail(&tls->acceptq_put,
-                       OO_SP_TO_INT(w->wt_next), W_ID(w)) );
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( n_shards > 1 ) {
+    ci_tcp_state* ts = &CI_CONTAINER(citp_waitable_obj, waitable, w)->tcp;
+    unsigned h = onload_hash3(tcp_ipx_laddr(ts), tcp_lport_be16(ts),
+                              tcp_ipx_raddr(ts), tcp_rport_be16(ts),
+                              IPPROTO_TCP);
+    h = (h % n_shards) % CI_CFG_TCP_ACCEPTQ_SHARDS;
+    __ci_tcp_acceptq_push(ni, &tls->acceptq_shard[h].put, w);
+  }
+  else
+#endif
+    __ci_tcp_acceptq_push(ni, &tls->acceptq_put, w);
   ++tls->acceptq_n_in;
+  if(CI_UNLIKELY( ci_tcp_acceptq_is_tfo(w) ))
+    ++tls->tfo_n_in;
 }
 
 
@@ -4623,50 +5044,143 @@ ci_inline void ci_tcp_acceptq_put_back_tail(ci_netif* ni,
   ci_assert(OO_SP_IS_NULL(w->wt_next));
   ci_assert(ci_sock_is_locked(ni, &tls->s.b));
   ci_assert(w->sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
-  do
-    w->wt_next = OO_SP_FROM_INT(ni, tls->acceptq_put);
-  while( ci_cas32_fail(&tls->acceptq_put,
-                       OO_SP_TO_INT(w->wt_next), W_ID(w)) );
+  ci_assert(! ci_tcp_acceptq_sharded(tls));
+  __ci_tcp_acceptq_push(ni, &tls->acceptq_put, w);
   --tls->acceptq_n_out;
+  ci_tcp_acceptq_tfo_out(tls, w, 1);
 }
 
 
 /* Should not be called directly, use ci_tcp_acceptq_get() and
  * ci_tcp_acceptq_peek(). */
-ci_inline void ci_tcp_acceptq_get_swizzle(ci_netif* ni,
-					  ci_tcp_socket_listen* tls) {
+ci_inline void __ci_tcp_acceptq_get_swizzle(ci_netif* ni, ci_int32* put,
+                                            oo_sp* get) {
   ci_int32 from;
   oo_sp from_sp;
   ci_tcp_state* ts;
   /* Atomically grab the contents of the [put] list. */
   do
-    from = tls->acceptq_put;
-  while( ci_cas32_fail(&tls->acceptq_put, from, CI_ILL_END) );
+    from = *put;
+  while( ci_cas32_fail(put, from, CI_ILL_END) );
   /* Reverse the list onto [get]. */
   ci_assert(from >= 0);
-  ci_assert(OO_SP_IS_NULL(tls->acceptq_get));
+  ci_assert(OO_SP_IS_NULL(*get));
   from_sp = OO_SP_FROM_INT(ni, from);
   do {
     ts = SP_TO_TCP(ni, from_sp);
     from_sp = ts->s.b.wt_next;
-    ts->s.b.wt_next = tls->acceptq_get;
-    tls->acceptq_get = S_SP(ts);
+    ts->s.b.wt_next = *get;
+    *get = S_SP(ts);
   } while( OO_SP_NOT_NULL(from_sp) );
 }
 
 
-/* Only call this if ci_tcp_acceptq_not_empty() is true. */
+/* Should not be called directly. */
+ci_inline citp_waitable* __ci_tcp_acceptq_get(ci_netif* ni, ci_int32* put,
+                                              oo_sp* get) {
+  citp_waitable* w;
+  if( OO_SP_IS_NULL(*get) )  __ci_tcp_acceptq_get_swizzle(ni, put, get);
+  ci_assert(OO_SP_NOT_NULL(*get));
+  w = SP_TO_WAITABLE(ni, *get);
+  *get = w->wt_next;
+  CI_DEBUG(w->wt_next = OO_SP_NULL);
+  return w;
+}
+
+
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+/* Must hold the shard lock, and only call this if
+ * ci_tcp_acceptq_shard_not_empty() is true. */
+ci_inline citp_waitable*
+ci_tcp_acceptq_shard_get(ci_netif* ni, ci_tcp_socket_listen* tls,
+                         struct ci_tcp_acceptq_shard* sh) {
+  citp_waitable* w;
+  ci_assert(sh->lock);
+  ci_atomic32_inc(&tls->acceptq_n_out);
+  w = __ci_tcp_acceptq_get(ni, &sh->put, &sh->get);
+  ci_tcp_acceptq_tfo_out(tls, w, 0);
+  return w;
+}
+
+
+#ifndef __ci_driver__
+/* Must hold the shard lock, and only call this if
+ * ci_tcp_acceptq_shard_not_empty() is true. */
+ci_inline ci_tcp_state*
+ci_tcp_acceptq_shard_peek(ci_netif* ni, struct ci_tcp_acceptq_shard* sh) {
+  ci_assert(sh->lock);
+  if( OO_SP_IS_NULL(sh->get) )
+    __ci_tcp_acceptq_get_swizzle(ni, &sh->put, &sh->get);
+  ci_assert(OO_SP_NOT_NULL(sh->get));
+  return SP_TO_TCP(ni, sh->get);
+}
+#endif
+
+
+/* Must hold the shard lock. */
+ci_inline void
+ci_tcp_acceptq_shard_put_back(ci_netif* ni, ci_tcp_socket_listen* tls,
+                              struct ci_tcp_acceptq_shard* sh,
+                              citp_waitable* w) {
+  ci_assert(sh->lock);
+  ci_assert(w->sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+  ci_atomic32_dec(&tls->acceptq_n_out);
+  ci_tcp_acceptq_tfo_out(tls, w, 1);
+  w->wt_next = sh->get;
+  sh->get = W_SP(w);
+}
+#endif
+
+
+/* Use this if you do own the [get] lock. */
+ci_inline int ci_tcp_acceptq_not_empty(ci_tcp_socket_listen* tls) {
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( ci_tcp_acceptq_sharded(tls) ) {
+    int i;
+    for( i = 0; i < CI_CFG_TCP_ACCEPTQ_SHARDS; ++i )
+      if( ci_tcp_acceptq_shard_not_empty(&tls->acceptq_shard[i]) )
+        return 1;
+    return 0;
+  }
+#endif
+  return (tls->acceptq_put >= 0) | OO_SP_NOT_NULL(tls->acceptq_get);
+}
+
+
+/* Only call this if ci_tcp_acceptq_not_empty() is true.  If [tls] is
+ * sharded, another thread may have taken the last connection since, in
+ * which case this returns NULL.  In the kernel it also returns NULL if the
+ * only non-empty shards stay locked by another thread.
+ */
 ci_inline citp_waitable* ci_tcp_acceptq_get(ci_netif* ni,
 					   ci_tcp_socket_listen* tls) {
   citp_waitable* w;
   ci_assert(ci_sock_is_locked(ni, &tls->s.b) ||
             (tls->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN));
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( ci_tcp_acceptq_sharded(tls) ) {
+    int i;
+    w = NULL;
+    for( i = 0; i < CI_CFG_TCP_ACCEPTQ_SHARDS && w == NULL; ++i ) {
+      struct ci_tcp_acceptq_shard* sh = &tls->acceptq_shard[i];
+      if( ! ci_tcp_acceptq_shard_not_empty(sh) )
+        continue;
+#ifdef __KERNEL__
+      if( ! ci_tcp_acceptq_shard_lock_kernel(sh) )
+        continue;
+#else
+      ci_tcp_acceptq_shard_lock(sh);
+#endif
+      if( ci_tcp_acceptq_shard_not_empty(sh) )
+        w = ci_tcp_acceptq_shard_get(ni, tls, sh);
+      ci_tcp_acceptq_shard_unlock(sh);
+    }
+    return w;
+  }
+#endif
   ++tls->acceptq_n_out;
-  if( OO_SP_IS_NULL(tls->acceptq_get) )  ci_tcp_acceptq_get_swizzle(ni, tls);
-  ci_assert(OO_SP_NOT_NULL(tls->acceptq_get));
-  w = SP_TO_WAITABLE(ni, tls->acceptq_get);
-  tls->acceptq_get = w->wt_next;
-  CI_DEBUG(w->wt_next = OO_SP_NULL);
+  w = __ci_tcp_acceptq_get(ni, &tls->acceptq_put, &tls->acceptq_get);
+  ci_tcp_acceptq_tfo_out(tls, w, 0);
   return w;
 }
 
@@ -4676,7 +5190,9 @@ ci_inline citp_waitable* ci_tcp_acceptq_get(ci_netif* ni,
 ci_inline ci_tcp_state* ci_tcp_acceptq_peek(ci_netif* ni,
 					    ci_tcp_socket_listen* tls) {
   ci_assert(ci_sock_is_locked(ni, &tls->s.b));
-  if( OO_SP_IS_NULL(tls->acceptq_get) )  ci_tcp_acceptq_get_swizzle(ni, tls);
+  ci_assert(! ci_tcp_acceptq_sharded(tls));
+  if( OO_SP_IS_NULL(tls->acceptq_get) )
+    __ci_tcp_acceptq_get_swizzle(ni, &tls->acceptq_put, &tls->acceptq_get);
   ci_assert(OO_SP_NOT_NULL(tls->acceptq_get));
   return SP_TO_TCP(ni, tls->acceptq_get);
 }
@@ -4688,7 +5204,9 @@ ci_inline void ci_tcp_acceptq_put_back(ci_netif* ni, ci_tcp_socket_listen* tls,
                                        citp_waitable* w) {
   ci_assert(ci_sock_is_locked(ni, &tls->s.b));
   ci_assert(w->sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+  ci_assert(! ci_tcp_acceptq_sharded(tls));
   --tls->acceptq_n_out;
+  ci_tcp_acceptq_tfo_out(tls, w, 1);
   w->wt_next = tls->acceptq_get;
   tls->acceptq_get = W_SP(w);
 }
@@ -5286,10 +5804,22 @@ ci_inline ci_uint16 oo_tcpdump_queue_len(ci_netif* ni)
   return ni->state->dump_write_i - ni->state->dump_read_i;
 }
 
+/* Run the capture filter over [pkt].  Returns true if it matches. */
+extern int oo_tcpdump_filter_match(ci_netif* ni, ci_ip_pkt_fmt* pkt);
+
+/* Does [pkt] pass the capture filter, if there is one?  Packets which don't
+ * are not queued, so neither use dump queue entries nor count as missed. */
+ci_inline int oo_tcpdump_filter_ok(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  return ni->state->dump_filter_len == 0 ||
+         oo_tcpdump_filter_match(ni, pkt);
+}
+
 /* Should we dump this packet? */
 ci_inline int oo_tcpdump_check(ci_netif *ni, ci_ip_pkt_fmt *pkt, int intf_i)
 {
-  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL ) {
+  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_ALL &&
+      oo_tcpdump_filter_ok(ni, pkt) ) {
     if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
       return 1;
     else
@@ -5302,7 +5832,8 @@ ci_inline int oo_tcpdump_check(ci_netif *ni, ci_ip_pkt_fmt *pkt, int intf_i)
 ci_inline int oo_tcpdump_check_no_match(ci_netif *ni, ci_ip_pkt_fmt *pkt,
                                         int intf_i)
 {
-  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_NO_MATCH ) {
+  if( ni->state->dump_intf[intf_i] == OO_INTF_I_DUMP_NO_MATCH &&
+      oo_tcpdump_filter_ok(ni, pkt) ) {
     if( oo_tcpdump_queue_len(ni) < CI_CFG_DUMPQUEUE_LEN - 1 )
       return 1;
     else
@@ -5426,6 +5957,76 @@ ci_inline ci_uint64 __oo_usec_to_cycles64(ci_uint32 khz, unsigned usec)
     __oo_usec_to_cycles64(IPTIMER_STATE(ni)->khz, usec)
 
 
+/**********************************************************************
+ * Latency histograms
+ */
+
+#if CI_CFG_LATENCY_HIST
+
+/* Index of the ci_lat_hist bucket which counts [ticks]. */
+ci_inline unsigned ci_lat_hist_bucket(ci_uint64 ticks)
+{
+  unsigned msb, i;
+
+  if( ticks < (1ull << CI_LAT_HIST_MIN_SHIFT) )
+    return 0;
+  msb = 63 - __builtin_clzll(ticks);
+  i = ((msb - CI_LAT_HIST_MIN_SHIFT) << CI_LAT_HIST_SUB_BITS) +
+      ((ticks >> (msb - CI_LAT_HIST_SUB_BITS)) &
+       ((1u << CI_LAT_HIST_SUB_BITS) - 1));
+  return CI_MIN(i, CI_LAT_HIST_N_BUCKETS - 1u);
+}
+
+/* Smallest value counted in bucket [i]. */
+ci_inline ci_uint64 ci_lat_hist_bucket_lo(unsigned i)
+{
+  ci_uint64 mantissa = (1u << CI_LAT_HIST_SUB_BITS) +
+                       (i & ((1u << CI_LAT_HIST_SUB_BITS) - 1));
+  return mantissa << (CI_LAT_HIST_MIN_SHIFT - CI_LAT_HIST_SUB_BITS +
+                      (i >> CI_LAT_HIST_SUB_BITS));
+}
+
+/* The stack histograms are shared by sockets locked by different threads,
+ * so the buckets are incremented atomically.  [max] may lose a race. */
+ci_inline void ci_lat_hist_add(ci_lat_hist* h, ci_uint64 ticks)
+{
+  ci_atomic32_inc(&h->bucket[ci_lat_hist_bucket(ticks)]);
+  if( ticks > h->max )
+    h->max = ticks;
+}
+
+/* Record the time since [start_frc] in histogram [kind] of the stack and,
+ * if configured, of the socket. */
+ci_inline void ci_netif_lat_hist_sample(ci_netif* ni, ci_sock_cmn* s,
+                                        int kind, ci_uint64 start_frc)
+{
+  ci_int64 ticks;
+
+  if( CI_LIKELY( ! NI_OPTS(ni).latency_hist ) || start_frc == 0 )
+    return;
+  ticks = ci_frc64_get() - start_frc;
+  /* The frc of the CPU which stamped the packet may be a little ahead. */
+  ticks = CI_MAX(ticks, (ci_int64) 0);
+  ci_lat_hist_add(&ni->state->lat_hist[kind], ticks);
+#if CI_CFG_LATENCY_HIST_SOCK
+  ci_lat_hist_add(&s->lat_hist[kind], ticks);
+#endif
+}
+
+/* Time at which a send call put data into a packet, or zero. */
+ci_inline ci_uint64 ci_netif_lat_hist_tx_stamp(ci_netif* ni)
+{
+  return NI_OPTS(ni).latency_hist ? ci_frc64_get() : 0;
+}
+
+#else
+
+#define ci_netif_lat_hist_sample(ni, s, kind, start_frc)  do{}while(0)
+#define ci_netif_lat_hist_tx_stamp(ni)                    0
+
+#endif
+
+
 /**********************************************************************
  * Zero-copy API helpers
  */
@@ -234,17 +234,18 @@ ci_inline char* oo_state_off_to_ptr(ci_netif* ni, unsigned off)
 #define EP_BUF_SIZE        CI_CFG_EP_BUF_SIZE
 #define EP_BUF_PER_PAGE    (CI_PAGE_SIZE / EP_BUF_SIZE)
 
-#define EP_BUF_PER_CHUNK    2048
+/* 2^21-byte chunks */
+#define EP_BUF_PER_CHUNK    ((1 << 21) / EP_BUF_SIZE)
 #ifdef __KERNEL__
   CI_BUILD_ASSERT(OO_SHARED_BUFFER_CHUNK_SIZE / CI_CFG_EP_BUF_SIZE ==
                   EP_BUF_PER_CHUNK);
 #endif
 
 /* Threshhold for proactive socket allocation is half of the shmbuf chunk
- * capability: 2^21 / 2^10 / 2 = 1024.  It can't guarantee that one driverlink
- * poll does not exhaust all the spare socket buffers, but probably gives
- * a good chance that a listener can accept all incoming connections and
- * create new sockets.
+ * capability: 2^21 / 2^10 / 2 = 1024 with 1024-byte socket buffers.  It
+ * can't guarantee that one driverlink poll does not exhaust all the spare
+ * socket buffers, but probably gives a good chance that a listener can
+ * accept all incoming connections and create new sockets.
  *
  * Driverlink budget is usually 64, but with RX event merging one poll can
  * accept some hundreds of packets.
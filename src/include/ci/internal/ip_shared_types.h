@@ -232,6 +232,10 @@ typedef union {
                                       * used in oo_deferred_arp_failed() */
 #if CI_CFG_TIMESTAMPING
     struct oo_timespec first_tx_hw_stamp; /* Timestamp of the first transmit */
+#endif
+#if CI_CFG_TCP_RACK
+    ci_iptime_t       xmit_time;     /* Time of the latest transmit in us;
+                                      * valid if EF_TCP_RACK is set */
 #endif
     ci_user_ptr_t     next CI_ALIGN(8);   /* for ci_tcp_sendmsg() local use only! */
   } tcp_tx CI_ALIGN(8);
@@ -245,6 +249,9 @@ typedef union {
     ci_uint32         base;       /* Offset of start of data from dma_start. */
     ci_uint32         pay_len;    /* This buffer's payload length. */
   } pipe;
+  struct {
+    ci_uint32         offset;     /* Offset of fragment in IP payload. */
+  } ip_reasm;
 } ci_ip_pkt_fmt_prefix;
 
 
@@ -405,6 +412,10 @@ struct ci_ip_pkt_fmt_s {
                                    * processing (EF100 feature). The user_mark
                                    * is put in pf.tcp_rx.lo.rx_sock */
 #define CI_PKT_RX_FLAG_RX_SHARED       0x08 /* Packet comes from shared RXQ */
+#define CI_PKT_RX_FLAG_REASSEMBLED     0x10 /* Reassembled from IP fragments */
+#define CI_PKT_RX_FLAG_STEERED         0x20 /* Passed on by another stack of
+                                   * the cluster (EF_CLUSTER_STEER), which
+                                   * has already timestamped it */
   ci_uint8              rx_flags;
 
   /*! Number of these buffers that are chained together using
@@ -488,11 +499,14 @@ struct ci_pkt_zc_payload {
    */
   ci_uint8 crc_insert_first_byte : 2;
   ci_uint8 crc_insert_n_bytes : 3;
-  ci_uint8 reserved : 1;
+  ci_uint8 is_msg_zerocopy : 1;  /* Sent with MSG_ZEROCOPY: complete with a
+                                  * SO_EE_ORIGIN_ZEROCOPY notification for
+                                  * zerocopy_id rather than app_cookie */
 #define ZC_PAYLOAD_FLAG_ACCUM_CRC 0x1
 #define ZC_PAYLOAD_FLAG_INSERT_CRC 0x2
   ci_uint16 zcp_flags;          /* Flags from onload_zc_iovec::iov_flags. */
   ci_uint32 crc_id;
+  ci_uint32 zerocopy_id;        /* MSG_ZEROCOPY notification id */
 #if CI_CFG_NVME_LOCAL_CRC_MODE
   void* local_addr;
 #endif
@@ -609,6 +623,35 @@ typedef struct {
 } ci_netif_stats;
 
 
+/*!
+** ci_lat_hist
+**
+** Log-linear histogram of latencies in frc ticks.  Each power of two from
+** 2^CI_LAT_HIST_MIN_SHIFT is split into 2^CI_LAT_HIST_SUB_BITS buckets of
+** equal width, so the resolution is 25% of the value.  Smaller values are
+** counted in the first bucket and larger ones in the last.
+**
+** Counts are updated with the socket lock only, so a reader may see a
+** sample in [max] before it is in a bucket.
+*/
+#define CI_LAT_HIST_SUB_BITS    2
+#define CI_LAT_HIST_MIN_SHIFT   8
+#define CI_LAT_HIST_MAX_SHIFT   32
+#define CI_LAT_HIST_N_BUCKETS                                   \
+  ((CI_LAT_HIST_MAX_SHIFT - CI_LAT_HIST_MIN_SHIFT) << CI_LAT_HIST_SUB_BITS)
+
+typedef struct {
+  ci_uint64             max;
+  ci_uint32             bucket[CI_LAT_HIST_N_BUCKETS];
+} ci_lat_hist;
+
+/* From packet arrival to the application reading it */
+#define CI_LAT_HIST_RX  0
+/* From the send call (TCP or UDP) to the packet being pushed to the NIC */
+#define CI_LAT_HIST_TX  1
+#define CI_LAT_HIST_N   2
+
+
 /*!
 ** ci_netif_filter_table
 **
@@ -750,6 +793,9 @@ typedef struct {
   /* Stack statistics timer */
   ci_iptime_t tconst_stats;
 # define CI_TCONST_STATS 0    /*!< manual statistics collection = 0 */
+
+  /* Time to hold the fragments of an incomplete datagram. */
+  ci_iptime_t tconst_ip_reasm;
 } ci_netif_config;
 
 
@@ -841,6 +887,9 @@ typedef struct {
 # define CI_IP_TIMER_NETIF_STATS        0xa  /* netif statistics timer   */
 # define CI_IP_TIMER_TCP_CORK           0xb  /* TCP_CORK timer           */
 # define CI_IP_TIMER_NETIF_TCP_RECYCLE  0xc  /* EF100 plugin recycling   */
+# define CI_IP_TIMER_NETIF_IP_REASM     0xd  /* IP reassembly expiry     */
+# define CI_IP_TIMER_TCP_RACK           0xe  /* TCP RACK reordering wnd  */
+# define CI_IP_TIMER_NETIF_TX_PACE      0xf  /* release paced sockets    */
 } ci_ip_timer;
 
 
@@ -1106,6 +1155,49 @@ typedef struct {
 } ci_netif_state_nic_t;
 
 
+/* TCP Fast Open cookie received from a server, cached for use in the SYNs
+ * of later connections to it. */
+typedef struct {
+  ci_addr_t             raddr;
+  ci_uint8              len;        /* 0 if the entry is unused */
+  ci_uint8              cookie[16];
+} ci_tcp_fastopen_cache_entry;
+
+
+#if CI_CFG_IP_REASM
+/* A UDP datagram under reassembly (EF_IP_REASM).  The fragments received so
+ * far are linked through [frag_next] in order of offset.  Once [to_kernel]
+ * is set no fragments are held, and the rest of the datagram goes to the
+ * kernel until the entry expires. */
+typedef struct {
+  ci_addr_t             saddr;
+  ci_addr_t             daddr;
+  ci_uint32             id;         /* IP identification, network order */
+  ci_uint8              protocol;
+  ci_uint8              is_ip6;
+  ci_uint16             n_frags;
+  oo_pkt_p              frags;      /* OO_PP_NULL if the entry is unused
+                                     * or [to_kernel] */
+  ci_uint32             to_kernel;
+  ci_int32              len;        /* datagram length, or -1 until the last
+                                     * fragment arrives */
+  ci_int32              bytes;      /* payload bytes received so far */
+  ci_iptime_t           expiry;
+} ci_ip_reasm_entry;
+#endif
+
+
+#if CI_CFG_TCPDUMP
+/* One classic BPF instruction, laid out as struct sock_filter. */
+typedef struct {
+  ci_uint16             code;
+  ci_uint8              jt;
+  ci_uint8              jf;
+  ci_uint32             k;
+} oo_dump_filter_insn;
+#endif
+
+
 struct ci_netif_state_s {
 
   ci_netif_state_nic_t  nic[CI_CFG_MAX_INTERFACES];
@@ -1296,9 +1388,20 @@ struct ci_netif_state_s {
                                                ci_tcp_state_t::recycle_link */
 #endif
 
+#if CI_CFG_IP_REASM
+  ci_ip_timer           reasm_tid;  /**< expiry of incomplete datagrams */
+  ci_uint32             reasm_n_pkts; /**< fragments held in [reasm] */
+  ci_ip_reasm_entry     reasm[CI_CFG_IP_REASM];
+#endif
+
   /* List of sockets that may have reapable buffers. */
   struct oo_p_dllink        reap_list;
 
+#if CI_CFG_TX_PACING
+  ci_ip_timer           pace_tid;  /**< release of throttled sockets */
+  struct oo_p_dllink    pace_q;    /**< linked ci_sock_cmn::pace_link */
+#endif
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   ci_int32              stats_fmt; /**< Output format */
   ci_ip_timer           stats_tid CI_ALIGN(8); /**< NETIF statistics timer id */
@@ -1390,6 +1493,10 @@ struct ci_netif_state_s {
   CI_ULCONST ci_uint32   plugin_mmap_bytes;
 #endif
   CI_ULCONST ci_uint32  efct_shm_mmap_bytes;
+#if CI_CFG_CLUSTER_STEER
+  /* Length of the cluster's steering area, or 0 if not steering. */
+  CI_ULCONST ci_uint32  steer_mmap_bytes;
+#endif
 
   /* Set to true when endpoints are woken. */
   CI_ULCONST ci_int32 poll_did_wake;
@@ -1416,10 +1523,18 @@ struct ci_netif_state_s {
 
   CI_ULCONST ci_uint8   hash_salt[16];
 
+  /* Client-side TCP Fast Open cookies, hashed by remote address */
+  ci_tcp_fastopen_cache_entry
+                        tfo_cache[CI_CFG_TCP_FASTOPEN_CACHE_SIZE];
+
 #if CI_CFG_STATS_NETIF
   ci_netif_stats        stats;
 #endif
 
+#if CI_CFG_LATENCY_HIST
+  ci_lat_hist           lat_hist[CI_LAT_HIST_N] CI_ALIGN(8);
+#endif
+
 #define OO_INTF_I_SEND_VIA_OS   CI_CFG_MAX_INTERFACES
 #define OO_INTF_I_LOOPBACK      (CI_CFG_MAX_INTERFACES+1)
 #define OO_INTF_I_NUM           (CI_CFG_MAX_INTERFACES+2)
@@ -1431,6 +1546,12 @@ struct ci_netif_state_s {
   ci_uint8              dump_intf[OO_INTF_I_NUM];
   volatile ci_uint16    dump_read_i;
   volatile ci_uint16    dump_write_i;
+  /* Capture filter set by onload_tcpdump.  Only packets it accepts are
+   * queued.  No filter is applied if dump_filter_len is 0.  With
+   * dump_filter_vlan it sees frames with any 802.1Q tag removed. */
+  ci_uint16             dump_filter_len;
+  ci_uint8              dump_filter_vlan;
+  oo_dump_filter_insn   dump_filter[CI_CFG_DUMP_FILTER_LEN];
 #endif
 
   ef_vi_stats           vi_stats CI_ALIGN(8);
@@ -1536,6 +1657,60 @@ struct oo_timesync {
 CI_BUILD_ASSERT(sizeof(struct oo_timesync) <= CI_PAGE_SIZE);
 
 
+#if CI_CFG_CLUSTER_STEER
+/* Software flow steering between the stacks of a cluster (EF_CLUSTER_STEER).
+ *
+ * One of these is allocated per cluster and mapped by each of its stacks.
+ * The stack with rss_instance 0 receives all of the cluster's traffic and
+ * copies packets of flows which hash to another instance into that
+ * instance's ring.  Each ring has a single producer (instance 0) and a
+ * single consumer (the stack which owns the ring).  Ring 0 is not used.
+ *
+ * The slots follow the header at [slots_ofs] (OO_STEER_SLOTS_OFS); ring i
+ * (i > 0) has [ring_size] slots of OO_STEER_SLOT_SIZE bytes starting at
+ * slot (i - 1) * ring_size.
+ */
+#define OO_STEER_MAX_RINGS  64
+#define OO_STEER_SLOT_SIZE  2048
+
+struct oo_steer_slot {
+  ci_uint16 len;                    /* length of the frame */
+  ci_uint16 hwport;                 /* port which received it */
+  ci_uint32 reserved;
+  ci_uint64 tstamp_frc;             /* when instance 0 received it */
+  struct oo_timespec hw_stamp;      /* NIC timestamp, if any */
+  ci_uint8  frame[OO_STEER_SLOT_SIZE - 24];
+};
+#define OO_STEER_FRAME_MAX  (OO_STEER_SLOT_SIZE - 24)
+
+struct oo_steer_ring {
+  /* Written by the producer only. */
+  ci_uint32 head                    CI_ALIGN(CI_CACHE_LINE_SIZE);
+  ci_uint32 n_full;                 /* packets dropped because ring full */
+  ci_uint32 busy;                   /* producer may be filling a slot (the
+                                     * kernel clears it if it gives up
+                                     * waiting) */
+  /* Written by the consumer only, except that the producer clears [armed]
+   * when it wakes the consumer. */
+  ci_uint32 tail                    CI_ALIGN(CI_CACHE_LINE_SIZE);
+  ci_uint32 armed;                  /* consumer wants a wakeup */
+  /* Written by the kernel: the ring has a stack attached. */
+  ci_uint32 live                    CI_ALIGN(CI_CACHE_LINE_SIZE);
+};
+
+struct oo_steer_area {
+  ci_uint32 n_rings;                /* == cluster size */
+  ci_uint32 ring_size;              /* slots per ring, power of 2 */
+  ci_uint32 slots_ofs;
+  struct oo_steer_ring ring[OO_STEER_MAX_RINGS] CI_ALIGN(CI_CACHE_LINE_SIZE);
+};
+CI_BUILD_ASSERT(sizeof(struct oo_steer_slot) == OO_STEER_SLOT_SIZE);
+
+#define OO_STEER_SLOTS_OFS \
+  CI_ROUND_UP(sizeof(struct oo_steer_area), CI_CACHE_LINE_SIZE)
+#endif
+
+
 
 /*********************************************************************
 *************************** Per-socket lock **************************
@@ -1966,6 +2141,8 @@ struct ci_sock_cmn_s {
 #define CI_SOCK_AFLAG_NEED_ACK_BIT      10u
 #define CI_SOCK_AFLAG_SELECT_ERR_QUEUE  0x800
 #define CI_SOCK_AFLAG_SELECT_ERR_QUEUE_BIT 11u
+#define CI_SOCK_AFLAG_ZEROCOPY          0x1000       /* SO_ZEROCOPY  */
+#define CI_SOCK_AFLAG_ZEROCOPY_BIT      12u
 
 
   /*! Which socket flags should be inherited by accepted connections? */
@@ -1977,7 +2154,7 @@ struct ci_sock_cmn_s {
    CI_SOCK_FLAG_IP6_PMTU_DO | CI_SOCK_FLAG_IP6_ALWAYS_DF |                  \
    CI_SOCK_FLAG_TCP_OFFLOAD)
 #define CI_SOCK_AFLAG_TCP_INHERITED \
-    (CI_SOCK_AFLAG_CORK | CI_SOCK_AFLAG_NODELAY)
+    (CI_SOCK_AFLAG_CORK | CI_SOCK_AFLAG_NODELAY | CI_SOCK_AFLAG_ZEROCOPY)
 
   /* Bound-to local address.
    * - s.laddr is the bound-to address, unmodified.  Used by the filters.
@@ -2093,6 +2270,23 @@ struct ci_sock_cmn_s {
 
   struct oo_p_dllink    reap_link;
 
+#if CI_CFG_TX_PACING
+  /* Cycle count of the last refill.  All 64 bits, so that a socket idle
+   * for longer than a 32-bit count wraps still finds its bucket full. */
+  ci_uint64             pace_stamp CI_ALIGN(8);
+  /* SO_MAX_PACING_RATE in bytes per second. */
+  ci_uint64             pace_max_rate;
+#define CI_TX_PACE_RATE_UNLIMITED  (~(ci_uint64) 0)
+  /* Bytes that may be sent now, refilled at the pacing rate.  UDP sends
+   * whole datagrams so can leave this negative. */
+  ci_int32              pace_tokens;
+  struct oo_p_dllink    pace_link;   /**< linked on ci_netif_state::pace_q */
+#endif
+
+#if CI_CFG_LATENCY_HIST_SOCK
+  ci_lat_hist           lat_hist[CI_LAT_HIST_N] CI_ALIGN(8);
+#endif
+
   /* Size of 'ci_sock_cmn_s' structure may be improved by making 'domain'
    * as a flag. Also 'so_debug' field of 'so' structure has 2 flags and size
    * of 4 bytes.
@@ -2205,6 +2399,8 @@ typedef struct {
   ci_uint32 n_rx_mem_drop;    /* datagrams dropped due to out-of-mem   */
   ci_uint32 n_rx_pktinfo;     /* n times IP/IPV6_PKTINFO retrieved     */
   ci_uint32 max_recvq_pkts;   /* maximum packets queued for recv       */
+  ci_uint32 n_rx_gro;         /* reads which coalesced with UDP_GRO    */
+  ci_uint32 n_rx_gro_segs;    /* datagrams returned by those reads     */
 
   ci_uint32 n_tx_os;          /* datagrams send via OS socket          */
   ci_uint32 n_tx_os_slow;     /* datagrams send via OS socket (slower) */
@@ -2228,6 +2424,15 @@ typedef struct {
   ci_uint32 n_tx_msg_confirm; /* onload send with MSG_CONFIRM          */
   ci_uint32 n_tx_os_late;     /* sent via OS, after copying            */
   ci_uint32 n_tx_unconnect_late; /* concurrent send and unconnect      */
+  ci_uint32 n_tx_gso;         /* sends segmented with UDP_SEGMENT      */
+  ci_uint32 n_tx_gso_segs;    /* datagrams produced by UDP_SEGMENT     */
+  ci_uint32 n_tx_ring;        /* datagrams left in the send ring       */
+  ci_uint32 n_tx_ring_full;   /* send ring full, sender drained it     */
+  ci_uint32 n_tx_ring_drains; /* times send ring drained non-empty     */
+  ci_uint32 tx_ring_max_batch;/* most datagrams sent by one drain      */
+#if CI_CFG_TX_PACING
+  ci_uint32 n_tx_paced;       /* datagrams held back by pacing         */
+#endif
 } ci_udp_socket_stats;
 
 struct  ci_udp_state_s {
@@ -2253,9 +2458,14 @@ struct  ci_udp_state_s {
 #define CI_UDPF_MCAST_FILTER    0x00010000  /*!< mcast filter added */
 #define CI_UDPF_NO_UCAST_FILTER 0x00020000  /*!< don't add unicast filters */
 #define CI_UDPF_LAST_SEND_NOMAC 0x00040000  /*!< last send was via nomac path */
+#define CI_UDPF_GRO             0x00080000  /*!< UDP_GRO */
 
   ci_uint32 future_intf_i; /* Interface to check for incoming future packets */
 
+  /* UDP_SEGMENT: payload size of each datagram in a segmented send, or 0
+   * if the socket does not segment sends by default. */
+  ci_uint16 gso_size;
+
 #if CI_CFG_ZC_RECV_FILTER
   /* Only safe to use these at user-level in context of caller who set them */
   ci_uint64     recv_q_filter CI_ALIGN(8);
@@ -2288,6 +2498,28 @@ struct  ci_udp_state_s {
    */
   ci_int32  tx_async_q;
   oo_atomic_t tx_async_q_level;
+#if CI_CFG_UDP_SEND_RING
+  /* Ring of datagrams to be sent, used instead of [tx_async_q] when
+   * EF_UDP_SEND_RING is set.  Senders claim [tx_ring_tail] with a CAS and
+   * then fill the slot; the lock holder empties slots from [tx_ring_head],
+   * which only it changes.  Empty slots are OO_PP_ID_NULL.  [tx_ring_kick]
+   * is set by the sender which arranges for the ring to be drained, so
+   * that other senders need not touch the stack lock.  Datagrams here are
+   * counted in [tx_async_q_level].
+   */
+  ci_uint32 tx_ring_head;
+  ci_uint32 tx_ring_tail;
+  ci_uint32 tx_ring_kick;
+  ci_int32  tx_ring[CI_CFG_UDP_SEND_RING];
+#endif
+#if CI_CFG_TX_PACING
+  /* Datagrams held back by pacing, linked by [pkt->netif.tx.dmaq_next] in
+   * the order they are to be sent.  We hold a reference to each, and they
+   * are counted in [tx_async_q_level].  Protected by the stack lock.
+   */
+  oo_pkt_p  tx_pace_head;
+  oo_pkt_p  tx_pace_tail;
+#endif
   /* Number of bytes "inflight".  i.e. Sent to interface (including
    * overflow queue) and not yet had TX event.
    */
@@ -2361,6 +2593,23 @@ struct oo_pipe {
 #define CI_PFD_AFLAG_WRITER_SHIFT   4
 #define CI_PFD_AFLAG_WRITER_MASK    0x70
 
+  /* Reads see end-of-file, and writes fail with EPIPE, once either end is
+   * closed.  An end sees its own flag only when it is an AF_UNIX socket that
+   * has been shut down; ordinary pipes see only the other end's. */
+#define CI_PFD_AFLAG_EITHER_CLOSED \
+  ((CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_WRITER_SHIFT) | \
+   (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT))
+
+  /* For the two pipes of an accelerated AF_UNIX socketpair, the pipe
+   * carrying data the other way.  The socket that reads this pipe writes to
+   * [peer].  OO_SP_NULL for an ordinary pipe. */
+  oo_sp peer;
+
+  /* For a socketpair pipe, the number of messages of ancillary data sent
+   * over the sockets' OS sockets for this direction and not yet taken by
+   * the reader.  Each one is tagged with its position in the byte stream. */
+  volatile ci_uint32 ctrl_n;
+
   ci_uint32 bufs_num;
 
   /* Maximum size of the pipe. It is not always enforced */
@@ -2514,6 +2763,11 @@ typedef struct {
   ci_uint16            user_mss;            /* user-provided maximum MSS */
   ci_uint8             tcp_defer_accept;    /* TCP_DEFER_ACCEPT sockopt  */
 #define OO_TCP_DEFER_ACCEPT_OFF 0xff
+  ci_uint8             cc_algo;             /* TCP_CONGESTION sockopt,
+                                             * CI_TCP_CC_* */
+  ci_uint32            tfo_qlen;            /* TCP_FASTOPEN sockopt */
+  ci_uint32            notsent_lowat;       /* TCP_NOTSENT_LOWAT sockopt,
+                                             * 0 for EF_TCP_NOTSENT_LOWAT */
 
 } ci_tcp_socket_cmn;
 
@@ -2527,6 +2781,9 @@ struct oo_tcp_socket_stats {
   ci_uint32  tx_stop_app;     /* TX stopped because TXQ empty      */
 #if CI_CFG_BURST_CONTROL
   ci_uint32  tx_stop_burst;   /* TX stopped by burst control       */
+#endif
+#if CI_CFG_TX_PACING
+  ci_uint32  tx_stop_pace;    /* TX stopped by pacing              */
 #endif
   ci_uint32  tx_nomac_defer;  /* Deferred send waiting for ARP     */
   ci_uint32  tx_defer;        /* Deferred send to avoid lock contention */
@@ -2608,6 +2865,27 @@ struct ci_tcp_state_s {
    * because packet allocation failed.  Must send FIN, really. */
 #define CI_TCPT_FLAG_FIN_PENDING        0x800000
 
+  /* TCP Fast Open (RFC7413).  On an active-open socket the SYN carries a
+   * Fast Open option; on a synrecv the SYN-ACK carries a fresh cookie; on
+   * a passive-open socket data was accepted from the SYN. */
+#define CI_TCPT_FLAG_TFO                0x1000000
+  /* TCP_FASTOPEN_CONNECT sockopt is set */
+#define CI_TCPT_FLAG_TFO_CONNECT        0x2000000
+
+  /* RACK (EF_TCP_RACK): [rack_xmit_ts], [rack_end_seq] and [rack_rtt]
+   * describe a delivered segment */
+#define CI_TCPT_FLAG_RACK_SAMPLE        0x4000000
+  /* RACK: the peer has been seen to reorder segments */
+#define CI_TCPT_FLAG_RACK_REORDER       0x8000000
+  /* RACK: the reordering window grew on a DSACK this round; the round ends
+   * when [rack_dsack_round] is acked */
+#define CI_TCPT_FLAG_RACK_DSACK         0x10000000
+  /* RACK: enough dupacks for fast retransmit arrived, but the reordering
+   * window had not yet expired */
+#define CI_TCPT_FLAG_RACK_DEFERRED      0x20000000
+  /* On a synrecv, the data on the SYN is being accepted with Fast Open */
+#define CI_TCPT_FLAG_TFO_DATA           0x40000000
+
   /* flags advertised on SYN */
 # define CI_TCPT_SYN_FLAGS \
         (CI_TCPT_FLAG_WSCL | CI_TCPT_FLAG_TSO | CI_TCPT_FLAG_SACK)
@@ -2681,6 +2959,10 @@ struct ci_tcp_state_s {
                                        timestamp_q, or OO_PP_NULL if there is
                                        no such packet. Protected by the stack
                                        lock */
+  ci_uint32           zerocopy_next_id; /* Id of the next MSG_ZEROCOPY send */
+  ci_uint32           zerocopy_n_pinned; /* MSG_ZEROCOPY sends whose pages
+                                       are pinned until their completion is
+                                       read from the error queue */
 #endif
 
   /* Next field is needed to support PathMTU discovery functionality */
@@ -2754,6 +3036,15 @@ struct ci_tcp_state_s {
   ci_uint32            cwnd_extra;  /* adjustments when congested         */
   ci_uint32            ssthresh;    /* slow-start threshold               */
   ci_uint32            bytes_acked; /* bytes acked but not yet added to cwnd */
+
+  /* CUBIC congestion control state (RFC 8312), see tcp_cong.c.  Windows
+   * are in bytes. */
+  ci_uint32            cubic_w_max;  /* cwnd before the last reduction    */
+  ci_uint32            cubic_origin; /* cwnd at the plateau of the curve  */
+  ci_uint32            cubic_cwnd_epoch; /* cwnd at the start of epoch    */
+  ci_uint32            cubic_k;      /* ms from epoch start to plateau    */
+  ci_iptime_t          cubic_epoch_start; /* start of congestion avoidance,
+                                           * or 0 if not started yet      */
   
 #if CI_CFG_TCP_FASTSTART  
   ci_uint32            faststart_acks; /* Bytes to ack before leaving faststart */
@@ -2765,6 +3056,21 @@ struct ci_tcp_state_s {
   ci_uint32            taildrop_mark;
 #endif
 
+#if CI_CFG_TCP_RACK
+  /* RACK loss detection state (RFC 8985), see tcp_rack.c.  Times are in
+   * microseconds, as for pf.tcp_tx.xmit_time. */
+  ci_iptime_t          rack_xmit_ts;  /* sent time of the most recently sent
+                                       * segment to have been delivered   */
+  ci_uint32            rack_end_seq;  /* ... and its end sequence number  */
+  ci_uint32            rack_rtt;      /* ... and its round trip time      */
+  ci_uint32            rack_min_rtt;  /* smallest RTT seen, or ~0u        */
+  ci_uint32            rack_dsack_round; /* see CI_TCPT_FLAG_RACK_DSACK   */
+  ci_uint8             rack_reo_wnd_mult; /* reordering window, in
+                                           * quarters of min RTT          */
+  ci_uint8             rack_reo_wnd_persist; /* recoveries before
+                                              * rack_reo_wnd_mult resets  */
+#endif
+
   /* Keep alive probes, and sending ACKs after gaps that may cause
    * other end to validated its congetion window 
    */
@@ -2852,6 +3158,9 @@ struct ci_tcp_state_s {
   ci_ip_timer          stats_tid;   /* Statistics report timer            */
 #endif
   ci_ip_timer          cork_tid;    /* TCP timer for TCP_CORK/MSG_MORE   */
+#if CI_CFG_TCP_RACK
+  ci_ip_timer          rack_tid;    /* RACK reordering window timer       */
+#endif
 
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   /* Technically a timer, but it always has a single-tick expiry so we save
@@ -2885,6 +3194,9 @@ struct ci_tcp_state_s {
   /* send_prequeue_in is an atomic addition to send_in; it is never
    * decremented.  See ci_tcp_sendq_n_pkts(). */
   oo_atomic_t          send_prequeue_in;
+  /* Payload bytes on the prequeue, which are not yet counted by
+   * [enq_nxt].  See ci_tcp_sendq_unsent_bytes(). */
+  oo_atomic_t          send_prequeue_bytes;
 
   struct oo_p_dllink   timeout_q_link;
 
@@ -2937,6 +3249,20 @@ typedef struct {
 } ci_tcp_socket_listen_stats;
 
 
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+/* One of the accept queues of a listening socket with EF_TCP_ACCEPTQ_SHARDS.
+ * [put] is a concurrent lifo, as ci_tcp_socket_listen::acceptq_put.  The
+ * [get] side is protected by [lock] rather than by the sock lock, so that
+ * threads accepting from different shards do not contend.
+ */
+struct ci_tcp_acceptq_shard {
+  ci_int32             put;
+  oo_sp                get;
+  ci_uint32            lock;
+} CI_ALIGN(CI_CACHE_LINE_SIZE);
+#endif
+
+
 struct ci_tcp_socket_listen_s {
   ci_sock_cmn          s;
   ci_tcp_socket_cmn    c;
@@ -2949,6 +3275,19 @@ struct ci_tcp_socket_listen_s {
   ci_uint32            acceptq_n_in;
   oo_sp                acceptq_get;
   ci_uint32            acceptq_n_out;
+  /* Connections in the accept queue which have accepted data from the SYN
+   * with Fast Open, limited by the TCP_FASTOPEN qlen.  [tfo_n_out] is
+   * updated atomically. */
+  ci_uint32            tfo_n_in;
+  ci_uint32            tfo_n_out;
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  /* With more than one shard, connections are queued on acceptq_shard[]
+   * by flow hash and [acceptq_put] and [acceptq_get] are not used.
+   * [acceptq_n_in] and [acceptq_n_out] still count all connections, and
+   * [acceptq_n_out] is then updated atomically.
+   */
+  ci_uint32            acceptq_n_shards;
+#endif
 
   /* For each listening socket we have a list of SYNRECV buffs, one for each
    * SYN we've received for which there hasn't yet been an ACK.  i.e. on
@@ -2983,6 +3322,10 @@ struct ci_tcp_socket_listen_s {
 #if CI_CFG_STATS_TCP_LISTEN
   ci_tcp_socket_listen_stats  stats;
 #endif
+
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  struct ci_tcp_acceptq_shard acceptq_shard[CI_CFG_TCP_ACCEPTQ_SHARDS];
+#endif
 };
 
 
@@ -102,6 +102,18 @@ struct oo_ringbuffer {
 };
 
 
+#if CI_CFG_TCP_REPLY_CACHE_SIZE
+/* Route and headers for replies to a remote address on behalf of a
+ * listening socket, as found by cicp_user_retrieve() with [sock_cp].  Only
+ * routes with status retrrc_success are cached, and an entry is used only
+ * while its fwd table verinfo is valid. */
+typedef struct {
+  struct oo_sock_cplane sock_cp;
+  ci_ip_cached_hdrs     ipcache;
+} ci_tcp_reply_cache_entry;
+#endif
+
+
 /*!
 ** ci_netif
 **
@@ -188,6 +200,26 @@ struct ci_netif_s {
 #endif
   ci_tcp_prev_seq_t*   seq_table;
 
+#if CI_CFG_CLUSTER_STEER
+  /* Cluster's software steering area (EF_CLUSTER_STEER), or NULL.  The
+   * sizes are trusted copies, for use instead of those in the area. */
+  struct oo_steer_area* steer;
+  ci_uint32            steer_bytes;
+  ci_uint32            steer_ring_mask;
+  ci_uint32            steer_n_rings;
+  ci_uint32            steer_instance;    /* this stack's rss_instance */
+  /* Rings which instance 0 has filled during this poll and which must be
+   * checked for a waiting consumer. */
+  ci_uint64            steer_kick_mask;
+#endif
+
+#if CI_CFG_TCP_REPLY_CACHE_SIZE
+  /* Routes for SYN-ACKs and RSTs, hashed by addresses and local port.
+   * Protected by the stack lock. */
+  ci_tcp_reply_cache_entry
+                       tcp_reply_cache[CI_CFG_TCP_REPLY_CACHE_SIZE];
+#endif
+
   struct oo_deferred_pkt* deferred_pkts;
 
 #ifdef __ci_driver__
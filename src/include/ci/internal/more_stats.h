@@ -83,6 +83,14 @@ static inline void get_more_stats(ci_netif* ni, more_stats_t* s)
       s->udp_tot_send_pkts_ul += us->stats.n_tx_onload_uc;
       s->udp_tot_send_pkts_ul += us->stats.n_tx_onload_c;
       s->udp_tot_send_pkts_os += us->stats.n_tx_os;
+#if CI_CFG_UDP_SEND_RING
+      s->udp_send_ring_pkts += us->tx_ring_tail - us->tx_ring_head;
+#endif
+      s->udp_send_ring_tot_pkts += us->stats.n_tx_ring;
+      s->udp_send_ring_full += us->stats.n_tx_ring_full;
+      s->udp_send_ring_drains += us->stats.n_tx_ring_drains;
+      s->udp_send_ring_max_batch = CI_MAX(s->udp_send_ring_max_batch,
+                                          us->stats.tx_ring_max_batch);
     }
   }
 
@@ -134,6 +134,25 @@ OO_STAT("The total number of UDP packets sent via the kernel.  A small "
         "count is normal, for route resolution purposes.  This count is "
         "also available per socket (os=).",
         unsigned, udp_tot_send_pkts_os, count)
+OO_STAT("The number of UDP datagrams currently waiting in send rings "
+        "(EF_UDP_SEND_RING) for the stack lock holder to send them.",
+        unsigned, udp_send_ring_pkts, val)
+OO_STAT("The total number of UDP datagrams left in send rings by senders "
+        "which found the stack lock held.  This count is also available per "
+        "socket (ring=).",
+        unsigned, udp_send_ring_tot_pkts, count)
+OO_STAT("The number of times that a UDP send ring was full, and so the "
+        "sender waited for the stack lock to send the ring and its datagram.  "
+        "This count is also available per socket (full=).",
+        unsigned, udp_send_ring_full, count)
+OO_STAT("The number of times that the stack lock holder sent the contents "
+        "of a UDP send ring.  udp_send_ring_tot_pkts divided by this is the "
+        "mean batch size.  This count is also available per socket "
+        "(drains=).",
+        unsigned, udp_send_ring_drains, count)
+OO_STAT("The largest number of datagrams sent from a UDP send ring at once, "
+        "over all sockets.",
+        unsigned, udp_send_ring_max_batch, val)
 OO_STAT("Only applicable to older cards; internal error.",
         unsigned, ef_vi_rx_ev_lost, count)
 OO_STAT(MORE_STATS_DERIVED_DESC,
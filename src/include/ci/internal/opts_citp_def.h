@@ -396,6 +396,21 @@ CI_CFG_OPT("EF_PIPE", ul_pipe, ci_uint32,
            CI_UNIX_PIPE_DONT_ACCELERATE, CI_UNIX_PIPE_ACCELERATE_IF_NETIF,
            level)
 
+CI_CFG_OPT("EF_UNIX_SOCKETPAIR", ul_unix_socketpair, ci_uint32,
+"Accelerate socketpair(AF_UNIX, SOCK_STREAM).  Each socket of the pair reads "
+"one user-level pipe and writes the other, so the pair behaves as pipes do "
+"for spinning (EF_PIPE_RECV_SPIN, EF_PIPE_SEND_SPIN), buffering "
+"(EF_PIPE_SIZE) and epoll, across fork() as well as within a process.  "
+"Other socket types and named AF_UNIX sockets are not accelerated.\n"
+"Each socket is also backed by a kernel socket, which handles bind(), "
+"connect() and the socket names, and carries ancillary data such as "
+"SCM_RIGHTS.  Sending ancillary data therefore costs system calls, but "
+"the data sent with it still goes through the pipes.\n"
+"  0 - disable (default), 1 - enable, "
+"2 - enable only if an Onload stack already exists in the process.",
+           2, , CI_UNIX_PIPE_DONT_ACCELERATE, CI_UNIX_PIPE_DONT_ACCELERATE,
+           CI_UNIX_PIPE_ACCELERATE_IF_NETIF, level)
+
 CI_CFG_OPT("EF_FDTABLE_SIZE", fdtable_size, ci_uint32,
 "Limit the number of opened file descriptors by this value.  "
 "If zero, the initial hard limit of open files (`ulimit -n -H`) is used.  "
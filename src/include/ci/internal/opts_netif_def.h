@@ -141,6 +141,17 @@ CI_CFG_OPT("EF_TX_PUSH", tx_push, ci_uint32,
 "Enable low-latency transmit.",
            1, , 1, 0, 1, yesno)
 
+#if CI_CFG_LATENCY_HIST
+CI_CFG_OPT("EF_LATENCY_HIST", latency_hist, ci_uint32,
+"Record histograms of the latency from packet arrival to the application "
+"reading the data, and from a send call to the packet being pushed to the "
+"NIC.  UDP datagrams which wait for ARP resolution or go via the kernel "
+"are not counted.  The histograms can be viewed with 'onload_stackdump "
+"lat_hist' and in the 'lat_hist' output of onload_remote_monitor.  "
+"Sampling reads the CPU timestamp counter on each receive and transmit.",
+           1, , 0, 0, 1, yesno)
+#endif
+
 /* Takes its value from EF_ACCEPT_INHERIT_NONBLOCK in opts_citp_def.  Do
  * not document this one here.
  */
@@ -292,6 +303,41 @@ CI_CFG_OPT("EF_UDP_SEND_UNLOCKED", udp_send_unlocked, ci_uint32,
 "concurrency when multiple threads are performing UDP sends.",
            1, , 1, 0, 1, yesno)
 
+#if CI_CFG_UDP_SEND_RING
+CI_CFG_OPT("EF_UDP_SEND_RING", udp_send_ring, ci_uint32,
+"When a UDP send finds the stack lock held by another thread, leave the "
+"datagram in a per-socket lock-free ring for the lock holder to send, "
+"rather than deferring work to the lock holder for every datagram.  Only "
+"the first sender after the ring is drained touches the stack lock, so "
+"this reduces contention when many threads send on different sockets in "
+"one stack.  A sender which finds the ring full waits for the stack lock "
+"and sends the ring itself, so that datagrams stay in order.  Requires "
+"EF_UDP_SEND_UNLOCKED.",
+           1, , 0, 0, 1, yesno)
+#endif
+
+#if CI_CFG_IP_REASM
+CI_CFG_OPT("EF_IP_REASM", ip_reasm, ci_uint32,
+"Reassemble fragmented UDP datagrams in the Onload stack.  By default IP "
+"fragments that reach the stack are discarded or passed to the kernel.  When "
+"this option is set, the fragments of a UDP datagram are held until the "
+"datagram is complete and it is then delivered to Onload sockets.  A "
+"reassembled datagram that does not match any Onload socket is dropped "
+"rather than passed to the kernel.",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_IP_REASM_MAX_PKTS", ip_reasm_max_pkts, ci_uint32,
+"Maximum number of packet buffers that may hold fragments awaiting "
+"reassembly (see EF_IP_REASM).  When the limit is reached the oldest "
+"incomplete datagram is discarded.",
+           , , 128, 1, 4096, count)
+
+CI_CFG_OPT("EF_IP_REASM_TIMEOUT", ip_reasm_timeout, ci_uint32,
+"Time in milliseconds to hold the fragments of an incomplete datagram "
+"before discarding them (see EF_IP_REASM).",
+           , , 1000, 1, 60000, time:msec)
+#endif
+
 CI_CFG_OPT("EF_UNCONFINE_SYN", unconfine_syn, ci_uint32,
 "Accept TCP connections that cross into or out-of a private network.",
            1, , 1, 0, 1, yesno)
@@ -379,6 +425,26 @@ CI_CFG_OPT("EF_CLUSTER_IGNORE", cluster_ignore, ci_uint32,
 "effectively ignore attempts to set SO_REUSEPORT.",
            1, , 0, 0, 1, count)
 
+#if CI_CFG_CLUSTER_STEER
+CI_CFG_OPT("EF_CLUSTER_STEER", cluster_steer, ci_uint32,
+"Spread the flows of a cluster over its stacks in software, for NICs and "
+"interfaces which cannot do so with RSS (e.g. AF_XDP on a single-queue "
+"interface).  All of the cluster's traffic is received by the first stack "
+"of the cluster, which hashes each TCP or UDP flow with the Toeplitz "
+"function and passes the packets of flows belonging to other stacks to them "
+"through shared memory rings.  Packets cost an extra copy, and hardware "
+"receive timestamps are not passed on.  Set this option on every process "
+"of the cluster.  Not compatible with EF_SCALABLE_FILTERS_ENABLE in "
+"transparent proxy mode.",
+           1, , 0, 0, 1, yesno)
+
+CI_CFG_OPT("EF_CLUSTER_STEER_RING", cluster_steer_ring, ci_uint32,
+"Number of packets which each stack's EF_CLUSTER_STEER ring can hold.  "
+"Packets for a stack whose ring is full are dropped.  Rounded up to a "
+"power of 2.",
+           16, , 512, 16, 16384, count)
+#endif
+
 CI_CFG_OPT("EF_VALIDATE_ENV", validate_env, ci_uint32,
 "When set this option validates Onload related environment "
 "variables (starting with EF_).",
@@ -392,6 +458,34 @@ CI_CFG_OPT("EF_TAIL_DROP_PROBE", tail_drop_probe, ci_uint32,
            , , 1, 0, 1, yesno)
 #endif
 
+#if CI_CFG_TCP_RACK
+CI_CFG_OPT("EF_TCP_RACK", tcp_rack, ci_uint32,
+"Use time-based loss detection (RACK, RFC 8985) on TCP connections that "
+"negotiate SACK.  A segment is taken to be lost once a segment sent after "
+"it has been delivered and it has been outstanding for longer than the "
+"round trip time of that segment plus a reordering window.  "
+"Until the peer is seen to reorder segments, three duplicate ACKs still "
+"trigger a fast retransmit.  After that the window, a quarter of the "
+"minimum round trip time that grows when DSACKs report spurious "
+"retransmits, is always waited out, which avoids spurious fast "
+"retransmits on paths that reorder.  Tail losses are still detected by "
+"EF_TAIL_DROP_PROBE.",
+           1, , 0, 0, 1, yesno)
+#endif
+
+#if CI_CFG_TX_PACING
+CI_CFG_OPT("EF_TCP_AUTO_PACING", tcp_auto_pacing, ci_uint32,
+"Pace transmits on TCP connections at a rate derived from the congestion "
+"window and smoothed round trip time: twice cwnd per RTT in slow start "
+"and 1.2 times cwnd per RTT after it, as Linux does with the fq qdisc.  "
+"Without this, a connection sends everything the congestion window allows "
+"at line rate, which can overflow shallow switch buffers.  SO_MAX_PACING_RATE "
+"limits the rate of TCP and UDP sockets whether or not this is set.  "
+"Paced sockets are released from the stack timer, so the pacing rate is "
+"met on average over a timer tick rather than per packet.",
+           1, , 0, 0, 1, yesno)
+#endif
+
 CI_CFG_OPT("EF_TCP_RST_DELAYED_CONN", rst_delayed_conn, ci_uint32,
 "This option tells Onload to reset TCP connections rather than allow data to "
 "be transmitted late.  Specifically, TCP connections are reset if the "
@@ -418,6 +512,17 @@ CI_CFG_OPT("EF_TCP_SNDBUF_MODE", tcp_sndbuf_mode, ci_uint32,
            "EF_TCP_RCVBUF_MODE to give automatic adjustment of RCVBUF.",
            2, , 1, 0, 2, oneof:no;yes;auto)
 
+CI_CFG_OPT("EF_TCP_NOTSENT_LOWAT", tcp_notsent_lowat, ci_uint32,
+"Default for the TCP_NOTSENT_LOWAT socket option: the number of bytes that "
+"a TCP socket may have queued but not yet sent before send() blocks and the "
+"socket stops being reported as writable.  A socket is reported as "
+"writable again once less than half of this is left unsent, as with "
+"Linux's net.ipv4.tcp_notsent_lowat.  This keeps the send queues of "
+"applications that write whenever epoll reports space short, so that data "
+"is not left waiting behind megabytes queued earlier.  0 means no limit "
+"other than SO_SNDBUF.",
+           , , 0, 0, MAX, bincount)
+
 CI_CFG_OPT("EF_TCP_COMBINE_SENDS_MODE", tcp_combine_sends_mode, ci_uint32,
            "This option controls how Onload fills packets in the TCP send "
            "buffer. In the default mode (set to 0) Onload will prefer to use "
@@ -854,6 +959,15 @@ CI_CFG_OPT("EF_DYNAMIC_ACK_THRESH", dynack_thresh, ci_uint16,
            , , 16, 0, 65535, count)
 #endif
 
+CI_CFG_OPT("EF_TCP_ACK_COALESCE", tcp_ack_coalesce, ci_uint32,
+"When set, ACKs that would be sent immediately for in-order TCP data (for "
+"example while the reorder buffer is being drained after a loss) are left to "
+"the end of the poll, so that a single ACK covers all of the segments "
+"delivered to a socket by that poll.  ACKs for out-of-order segments are "
+"still sent at once, as the sender needs them for fast retransmit.  Sockets "
+"with TCP_NODELAY set are not affected.",
+           , , 0, 0, 1, yesno)
+
 CI_CFG_OPT("EF_INVALID_ACK_RATELIMIT", oow_ack_ratelimit, ci_uint32,
 "Limit the rate of ACKs sent because of invalid incoming TCP packet, "
 "in milliseconds.  The limitation is applied per-socket.  "
@@ -882,6 +996,19 @@ CI_CFG_OPT("EF_ACCEPTQ_MIN_BACKLOG", acceptq_min_backlog, ci_uint16,
 "call.  If the application requests a smaller value, use this value instead.",
            , , 1, MIN, MAX, count)
 
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+CI_CFG_OPT("EF_TCP_ACCEPTQ_SHARDS", tcp_acceptq_shards, ci_uint32,
+"Sets the number of accept queues for each listening socket.  When greater "
+"than 1, established connections are spread over the queues by flow hash, "
+"and each thread calling accept() or onload_accept_batch() takes connections "
+"from a queue of its own before looking at the others, so that threads "
+"accepting from the same socket do not contend.  Connections may then be "
+"accepted in a different order from that in which they were established.\n"
+
+"This option is ignored when socket caching (EF_SOCKET_CACHE_MAX) is enabled.",
+           , , 1, 1, CI_CFG_TCP_ACCEPTQ_SHARDS, count)
+#endif
+
 CI_CFG_OPT("EF_NONAGLE_INFLIGHT_MAX", nonagle_inflight_max, ci_uint16,
 "This option affects the behaviour of TCP sockets with the TCP_NODELAY socket "
 "option.  Nagle's algorithm is enabled when the number of packets in-flight "
@@ -1228,6 +1355,29 @@ CI_CFG_OPT("EF_TCP_MIN_CWND", min_cwnd, ci_uint32,
 "WARNING: Modifying this option may violate the TCP protocol.",
            ,  , 0, 0, SMAX, count)
 
+#define CI_TCP_CC_RENO   0
+#define CI_TCP_CC_CUBIC  1
+CI_CFG_OPT("EF_TCP_CONGESTION", tcp_cc, ci_uint32,
+"Selects the default congestion control algorithm for TCP sockets.  "
+"Individual sockets can select a different algorithm with the "
+"TCP_CONGESTION socket option.\n"
+"reno  - NewReno, as used by previous versions of Onload.\n"
+"cubic - CUBIC (RFC 8312), which grows the congestion window faster on "
+"paths with a large bandwidth-delay product.",
+           1, , CI_TCP_CC_RENO, 0, 1, oneof:reno;cubic)
+
+#define CI_TCP_FASTOPEN_CLIENT  0x1
+#define CI_TCP_FASTOPEN_SERVER  0x2
+CI_CFG_OPT("EF_TCP_FASTOPEN", tcp_fastopen, ci_uint32,
+"A bitmask enabling TCP Fast Open (RFC7413), similar to "
+"/proc/sys/net/ipv4/tcp_fastopen.\n"
+"bit 0 (0x1) enables it for active opens, when the application uses "
+"MSG_FASTOPEN or the TCP_FASTOPEN_CONNECT socket option,\n"
+"bit 1 (0x2) enables it for listening sockets which have the TCP_FASTOPEN "
+"socket option set.",
+           2, , CI_TCP_FASTOPEN_CLIENT | CI_TCP_FASTOPEN_SERVER, 0, 3,
+           bitset:client;server)
+
 #if CI_CFG_TCP_FASTSTART
 CI_CFG_OPT("EF_TCP_FASTSTART_INIT", tcp_faststart_init, ci_uint32,
 "The FASTSTART feature prevents Onload from delaying ACKs during times when "
@@ -314,6 +314,21 @@ OO_STAT("Number of tail-drop probes that were probably unnecessary.",
 OO_STAT("Number of tail-drop probes that probably recovered loss.",
         ci_uint32, tail_drop_probe_success, count)
 #endif
+#if CI_CFG_TCP_RACK
+OO_STAT("Number of times RACK detected loss and entered fast recovery.",
+        ci_uint32, tcp_rack_recoveries, count)
+OO_STAT("Number of times the RACK reordering window timer expired.",
+        ci_uint32, tcp_rack_timeouts, count)
+OO_STAT("Number of fast retransmits that the duplicate ACK threshold would "
+        "have made but RACK held back, after which the missing segment "
+        "was delivered.",
+        ci_uint32, tcp_rack_spurious_avoided, count)
+#endif
+#if CI_CFG_TX_PACING
+OO_STAT("Number of times the pacing timer expired and released sockets "
+        "held back by SO_MAX_PACING_RATE or EF_TCP_AUTO_PACING.",
+        ci_uint32, tx_pace_timeouts, count)
+#endif
 OO_STAT("Number of times a connection has been reset while in accept queue; "
         "not yet a fully-connected socket.",
         ci_uint32, rst_recv_acceptq, count)
@@ -447,6 +462,14 @@ OO_STAT("Number of times accept() was accelerated.",
         ci_uint32, ul_accepts, count)
 OO_STAT("Number of times accept() returned EAGAIN.",
         ci_uint32, accept_eagain, count)
+OO_STAT("Number of calls to onload_accept_batch() which accepted more than "
+        "one connection.",
+        ci_uint32, accept_batches, count)
+OO_STAT("Number of connections accepted by onload_accept_batch() in batches.",
+        ci_uint32, accept_batch_socks, count)
+OO_STAT("Number of times a thread accepted from an accept queue shard other "
+        "than its own (EF_TCP_ACCEPTQ_SHARDS).",
+        ci_uint32, acceptq_shard_steals, count)
 OO_STAT("Number of failed aux-buffer allocations.",
         ci_uint32, aux_alloc_fails, count)
 OO_STAT("Number of failed bucket-aux-buffer allocations.",
@@ -456,11 +479,56 @@ OO_STAT("Times that accept() was called, but as a result of the "
         "promote a half-opened connection from listen to accept queue until "
         "some data arrives from the client (or it reaches the timeout)",
         ci_uint32, accepts_deferred, count)
+OO_STAT("Number of SYNs received by TCP_FASTOPEN listening sockets which "
+        "requested a Fast Open cookie.",
+        ci_uint32, tfo_cookie_req_rx, count)
+OO_STAT("Number of Fast Open cookies sent in SYN-ACKs.",
+        ci_uint32, tfo_cookie_sent, count)
+OO_STAT("Number of SYNs with a valid Fast Open cookie whose data was "
+        "accepted, saving a round trip.",
+        ci_uint32, tfo_syn_data_accepted, count)
+OO_STAT("Number of SYNs with an invalid Fast Open cookie.  Any data is "
+        "dropped, and the peer retransmits it once the connection is "
+        "established.",
+        ci_uint32, tfo_cookie_invalid, count)
+OO_STAT("Number of SYNs with a valid Fast Open cookie whose data was not "
+        "accepted because there were already TCP_FASTOPEN sockets waiting "
+        "to be accepted.",
+        ci_uint32, tfo_qlen_overflow, count)
+OO_STAT("Number of SYNs sent requesting a Fast Open cookie, because none was "
+        "cached for the destination.",
+        ci_uint32, tfo_cookie_req_tx, count)
+OO_STAT("Number of SYNs sent with a cached Fast Open cookie and data.",
+        ci_uint32, tfo_syn_data_tx, count)
+OO_STAT("Number of SYNs sent with Fast Open data which the server "
+        "acknowledged.",
+        ci_uint32, tfo_syn_data_acked, count)
+OO_STAT("Number of SYNs sent with Fast Open data which the server did not "
+        "acknowledge, so that the data had to be retransmitted.",
+        ci_uint32, tfo_syn_data_rejected, count)
+OO_STAT("Number of SYN-ACKs and RSTs sent in reply to received segments "
+        "whose route was found in the reply route cache.",
+        ci_uint32, tcp_reply_cache_hits, count)
+OO_STAT("Number of SYN-ACKs and RSTs sent in reply to received segments "
+        "whose route had to be looked up.",
+        ci_uint32, tcp_reply_cache_misses, count)
+OO_STAT("Number of MSG_ZEROCOPY sends whose data was sent from the "
+        "application's pages without copying.",
+        ci_uint32, tcp_zerocopy_sent, count)
+OO_STAT("Number of MSG_ZEROCOPY sends whose data was copied, and reported "
+        "with SO_EE_CODE_ZEROCOPY_COPIED.",
+        ci_uint32, tcp_zerocopy_copied, count)
 OO_STAT("Number of times we have sent a pure ACK packet.  Indicates that we "
         "are receiving data substantially more often than we are sending any.",
         ci_uint32, acks_sent, count)
 OO_STAT("Number of TCP window updates sent.",
         ci_uint32, wnd_updates_sent, count)
+OO_STAT("Number of ACKs for in-order TCP data which were left to the end of "
+        "the poll rather than sent immediately (EF_TCP_ACK_COALESCE).",
+        ci_uint32, tcp_acks_deferred, count)
+OO_STAT("Number of ACKs which were not sent at all because the ACK sent at "
+        "the end of the poll covered them (EF_TCP_ACK_COALESCE).",
+        ci_uint32, tcp_acks_coalesced, count)
 OO_STAT("This means that Onload received a packet, and had to do something "
         "other than just put it onto the receive queue.  Usually just "
         "(indicates TCP where we have to update state machinery, reset "
@@ -619,6 +687,30 @@ OO_STAT("We've been asked to free up a UDP socket (i.e. nothing references "
         "that fd any more) - but there are still some transmits waiting to "
         "complete.  The socket will be freed up once those transmits complete.",
         ci_uint32, udp_free_with_tx_active, count)
+#if CI_CFG_IP_REASM
+OO_STAT("Number of IP fragments of UDP datagrams received for reassembly "
+        "(EF_IP_REASM).",
+        ci_uint32, ip_reasm_frags, count)
+OO_STAT("Number of UDP datagrams reassembled from IP fragments.",
+        ci_uint32, ip_reasm_ok, count)
+OO_STAT("Number of incomplete datagrams discarded because their fragments "
+        "were not all received within EF_IP_REASM_TIMEOUT.",
+        ci_uint32, ip_reasm_timeouts, count)
+OO_STAT("Number of incomplete datagrams discarded to make room for others, "
+        "because the reassembly table was full or EF_IP_REASM_MAX_PKTS "
+        "was reached.",
+        ci_uint32, ip_reasm_evictions, count)
+OO_STAT("Number of datagrams discarded because fragments overlapped or "
+        "disagreed about the datagram length.",
+        ci_uint32, ip_reasm_overlaps, count)
+OO_STAT("Number of fragments passed to the kernel, because they or another "
+        "fragment of the same datagram were scattered over several buffers.",
+        ci_uint32, ip_reasm_to_kernel, count)
+OO_STAT("Number of fragments discarded because they were malformed, "
+        "duplicates, or the datagram was too large or its UDP checksum was "
+        "wrong.",
+        ci_uint32, ip_reasm_drops, count)
+#endif
 OO_STAT("We've run out of space in the filter table; on the host.  "
         "Try increasing EF_MAX_ENDPOINTS",
         ci_uint32, sw_filter_insert_table_full, count)
@@ -868,6 +960,26 @@ OO_STAT("Number of packets not captured by onload_tcpdump because the "
         ci_uint32, tcpdump_missed, count)
 #endif
 
+#if CI_CFG_CLUSTER_STEER
+OO_STAT("Number of packets received for the cluster and handled by this "
+        "stack (EF_CLUSTER_STEER).",
+        ci_uint32, steer_local, count)
+OO_STAT("Number of packets passed to other stacks of the cluster "
+        "(EF_CLUSTER_STEER).",
+        ci_uint32, steer_tx, count)
+OO_STAT("Number of packets dropped because another stack's steering ring "
+        "was full.",
+        ci_uint32, steer_ring_full, count)
+OO_STAT("Number of times another stack was woken to handle its steering "
+        "ring.",
+        ci_uint32, steer_kicks, count)
+OO_STAT("Number of packets received from this stack's steering ring.",
+        ci_uint32, steer_rx, count)
+OO_STAT("Number of packets in the steering ring dropped because no packet "
+        "buffer was available or the packet was invalid.",
+        ci_uint32, steer_rx_drop, count)
+#endif
+
 OO_STAT("Lowest recorded number of free packets",
         ci_uint32, lowest_free_pkts, val)
 #if CI_CFG_WANT_BPF_NATIVE
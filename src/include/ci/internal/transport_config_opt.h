@@ -105,6 +105,13 @@
 #define CI_CFG_SUPPORT_STATS_COLLECTION	1
 #define CI_CFG_TCP_SOCK_STATS           0
 
+/* Per-stack histograms of the latency from packet arrival to the
+ * application's read and from the send call to the packet being pushed to
+ * the NIC.  Sampling is enabled at runtime with EF_LATENCY_HIST. */
+#define CI_CFG_LATENCY_HIST             1
+/* The same histograms per socket.  These need CI_CFG_EP_BUF_SIZE 2048. */
+#define CI_CFG_LATENCY_HIST_SOCK        0
+
 /* Enable this to cause buffered stats (from sockopt) to be output
  * to the log rather than written to a buffer */
 #define CI_CFG_SEND_STATS_TO_LOG        1
@@ -192,6 +199,18 @@
 */
 #define CI_CFG_TCP_DUPACK_THRESH_MAX 127
 
+/* Number of entries in the per-stack cache of TCP Fast Open cookies
+** received from servers.  Must be a power of 2.
+*/
+#define CI_CFG_TCP_FASTOPEN_CACHE_SIZE  64
+
+/* Number of entries in the per-stack cache of routes used for SYN-ACKs and
+** RSTs sent on behalf of listening sockets.  The cache is per address
+** space, in ci_netif.  Must be a power of 2, or 0 to
+** look up the route for every reply.
+*/
+#define CI_CFG_TCP_REPLY_CACHE_SIZE     32
+
 /* IP TTL settings */
 #define CI_IP_DFLT_TTL 64
 #define CI_IP_MAX_TTL 255 
@@ -274,6 +293,17 @@
 #define CI_CFG_UDP_SNDBUF_MIN	        CI_SOCK_MIN_SNDBUF
 #define CI_CFG_UDP_RCVBUF_MIN		CI_SOCK_MIN_RCVBUF
 
+/* Size of the per-socket ring of datagrams which senders that find the
+** stack lock contended leave for the lock holder (EF_UDP_SEND_RING).
+** Must be a power of 2, or 0 to disable the ring.
+*/
+#define CI_CFG_UDP_SEND_RING            32
+
+/* Number of fragmented datagrams each stack can hold under reassembly at
+** once (EF_IP_REASM).  0 to compile out user-level reassembly.
+*/
+#define CI_CFG_IP_REASM                 16
+
 /* TCP sndbuf */
 #define CI_CFG_TCP_SNDBUF_MIN	        CI_SOCK_MIN_SNDBUF
 #define CI_CFG_TCP_SNDBUF_DEFAULT	16384
@@ -402,6 +432,16 @@
 */
 #define CI_CFG_TAIL_DROP_PROBE 1
 
+/* Time-based loss detection for SACK connections (RACK, RFC 8985), selected
+ * per stack by EF_TCP_RACK.
+ */
+#define CI_CFG_TCP_RACK 1
+
+/* Transmit pacing of TCP and UDP sockets by SO_MAX_PACING_RATE, and of TCP
+ * by a rate derived from cwnd and srtt with EF_TCP_AUTO_PACING.
+ */
+#define CI_CFG_TX_PACING 1
+
 /* Dump users of TCP and UDP sockets to a log file. */
 #define CI_CFG_LOG_SOCKET_USERS         0
 
@@ -416,6 +456,10 @@
 /* Active wild support */
 #define CI_CFG_TCP_SHARED_LOCAL_PORTS 1
 
+/* Software flow steering between the stacks of a cluster, for NICs and
+ * interfaces without RSS (EF_CLUSTER_STEER).  Uses the active wild hash. */
+#define CI_CFG_CLUSTER_STEER 1
+
 /* Enable endpoint move.
  * It is used in:
  * - extension API onload_move_fd();
@@ -454,6 +498,11 @@
 /* Maximum number of retransmit for SYN-ACKs */
 #define CI_CFG_TCP_SYNACK_RETRANS_MAX 10
 
+/* Maximum number of accept queues per listening socket
+ * (EF_TCP_ACCEPTQ_SHARDS).  Each takes a cache line in the listening socket's
+ * endpoint buffer.  Set to 0 to compile out accept queue sharding. */
+#define CI_CFG_TCP_ACCEPTQ_SHARDS 4
+
 /* Enable inspection of packets before delivery */
 #define CI_CFG_ZC_RECV_FILTER    1
 
@@ -478,6 +527,8 @@
 #if CI_CFG_TCPDUMP
 /* Dump queue length, should be 2^x, x <= 16 */
 #define CI_CFG_DUMPQUEUE_LEN 128
+/* Max instructions in the capture filter run by the stack */
+#define CI_CFG_DUMP_FILTER_LEN 64
 #endif /* CI_CFG_TCPDUMP */
 
 
@@ -604,12 +655,18 @@
 
 /* Size of socket shared state buffer.  Must be 1024 or 2048.  Larger
  * value is needed if you enable too many CI_CFG_* options, such as
- * CI_CFG_TCP_SOCK_STATS. */
+ * CI_CFG_TCP_SOCK_STATS.  Build profiles may set it. */
+#ifndef CI_CFG_EP_BUF_SIZE
 #define CI_CFG_EP_BUF_SIZE              1024
+#endif
 
 #if CI_CFG_IPV6 && !CI_CFG_FAKE_IPV6
 #error "CI_CFG_FAKE_IPV6 should be enabled to support IPv6"
 #endif
 
+#if CI_CFG_LATENCY_HIST_SOCK && ! CI_CFG_LATENCY_HIST
+#error "CI_CFG_LATENCY_HIST_SOCK requires CI_CFG_LATENCY_HIST"
+#endif
+
 #endif /* __CI_INTERNAL_TRANSPORT_CONFIG_OPT_H__ */
 /*! \cidoxg_end */
@@ -25,4 +25,8 @@
 #undef CI_CFG_TX_CRC_OFFLOAD
 #define CI_CFG_TX_CRC_OFFLOAD 1
 
+/* IPv6 addresses and the plugin state make TCP sockets too large for
+ * 1024-byte buffers. */
+#define CI_CFG_EP_BUF_SIZE 2048
+
 #endif /* __CI_INTERNAL_TRANSPORT_CONFIG_OPT_CLOUD_H__ */
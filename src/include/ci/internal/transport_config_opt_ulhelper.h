@@ -30,6 +30,8 @@
 #define CI_CFG_HANDLE_ICMP 0
 #undef CI_CFG_TCP_SHARED_LOCAL_PORTS
 #define CI_CFG_TCP_SHARED_LOCAL_PORTS 0
+#undef CI_CFG_CLUSTER_STEER
+#define CI_CFG_CLUSTER_STEER 0
 
 /* See also BREAK_SCALABLE_FILTERS in src/lib/efthrm/tcp_helper_endpoint.c */
 
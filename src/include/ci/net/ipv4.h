@@ -260,6 +260,7 @@ typedef struct ci_tcp_hdr_s {
 #define CI_TCP_OPT_SACK_PERM           0x4
 #define CI_TCP_OPT_SACK                0x5
 #define CI_TCP_OPT_TIMESTAMP           0x8
+#define CI_TCP_OPT_FASTOPEN            0x22
 
 
 /**********************************************************************
@@ -15,12 +15,34 @@
 #ifndef __CI_TOOLS_CRC32C_H__
 #define __CI_TOOLS_CRC32C_H__
 
+/* CRC32C (Castagnoli polynomial) of a buffer, with the same conventions
+ * as ci_crc32_partial().  Uses the SSE4.2 crc32 instruction where the CPU
+ * has it, and a table otherwise. */
 extern ci_uint32 ci_crc32c_partial(const ci_uint8 *buf, ci_uint32 buflen,
                                    ci_uint32 crc);
 
 extern ci_uint32 ci_crc32c_partial_copy(ci_uint8 *dest, const ci_uint8 *buf,
                                         ci_uint32 buflen, ci_uint32 crc);
 
+extern ci_uint32 ci_crc32c_partial_table(const ci_uint8 *buf,
+                                         ci_uint32 buflen, ci_uint32 crc);
+
+#if ! defined(__KERNEL__) && defined(CI_HAVE_X86INTRIN)
+# define CI_CRC32C_HW  1
+#else
+# define CI_CRC32C_HW  0
+#endif
+
+#if CI_CRC32C_HW
+/* Only to be called if ci_cpu_has_feature() reports "sse4.2" (and "pclmul"
+ * for the second one).  The pclmul version runs three streams at once on
+ * long buffers. */
+extern ci_uint32 ci_crc32c_partial_sse42(const ci_uint8 *buf,
+                                         ci_uint32 buflen, ci_uint32 crc);
+extern ci_uint32 ci_crc32c_partial_pclmul(const ci_uint8 *buf,
+                                          ci_uint32 buflen, ci_uint32 crc);
+#endif
+
 ci_inline ci_uint32 ci_crc32c(const ci_uint8 *buf, ci_uint32 buflen)
 {
   return ~ci_crc32c_partial(buf, buflen, 0xffffffff);
@@ -257,6 +257,44 @@ extern unsigned ci_ip_csum_copy_asm(void* dest, const void* src,
 				    int n, unsigned sum) CI_HF;
 
 
+/****************************************************************************
+ * Vector functions
+ ***************************************************************************/
+
+#if ! defined(__KERNEL__) && defined(CI_HAVE_X86INTRIN)
+# define CI_IP_CSUM_SIMD  1
+#else
+# define CI_IP_CSUM_SIMD  0
+#endif
+
+/* Below this many bytes the C versions are at least as fast. */
+#define CI_IP_CSUM_SIMD_MIN  64
+
+#if CI_IP_CSUM_SIMD
+  /*! Vector versions of ci_ip_csum_copy_aligned_c() and
+  ** ci_ip_csum_aligned_c().  They return a partial checksum which is not
+  ** necessarily equal to the one from the C version, but folds to the
+  ** same 16-bit value.
+  **
+  ** The _simd variants use the widest instructions the CPU supports.  The
+  ** others must only be called if ci_cpu_has_feature() says so.
+  */
+extern unsigned ci_ip_csum_copy_simd(void* dest, const void* src,
+                                     int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_simd(const void* src, int n, unsigned sum) CI_HF;
+
+extern unsigned ci_ip_csum_copy_sse2(void* dest, const void* src,
+                                     int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_sse2(const void* src, int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_copy_avx2(void* dest, const void* src,
+                                     int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_avx2(const void* src, int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_copy_avx512(void* dest, const void* src,
+                                       int n, unsigned sum) CI_HF;
+extern unsigned ci_ip_csum_avx512(const void* src, int n, unsigned sum) CI_HF;
+#endif
+
+
 /****************************************************************************
  * Other functions
  ***************************************************************************/
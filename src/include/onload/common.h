@@ -213,6 +213,16 @@ typedef struct {
   ci_int32              type;
 } oo_tcp_accept_sock_attach_t;
 
+/* Maximum number of sockets for OO_IOC_TCP_ACCEPT_SOCK_ATTACH_BATCH */
+#define OO_ACCEPT_BATCH_MAX  32
+
+typedef struct {
+  ci_user_ptr_t         ep_ids; /* IN: array of oo_sp */
+  ci_user_ptr_t         fds;    /* OUT: array of ci_int32 */
+  ci_int32              n;      /* IN: number of ep_ids, OUT: fds created */
+  ci_int32              type;
+} oo_tcp_accept_sock_attach_batch_t;
+
 typedef struct {
   ci_uint64 base_ptr;
   ci_uint64 num_pages;
@@ -226,6 +236,16 @@ typedef struct {
   ci_int32              flags;
 } oo_pipe_attach_t;
 
+/* Creates the two fds of an accelerated AF_UNIX socketpair.  The socket
+ * fd[i] reads pipe ep_id[i] and writes the other.  os_fd[] are the two ends
+ * of a kernel socketpair, which become the sockets' OS sockets. */
+typedef struct {
+  ci_fixed_descriptor_t fd[2];      /* OUT */
+  ci_fixed_descriptor_t os_fd[2];   /* IN */
+  oo_sp                 ep_id[2];
+  ci_int32              flags;
+} oo_unix_attach_t;
+
 typedef struct {
   ci_int32      bufs_num;
   ci_int32      bufs_start;
@@ -315,7 +335,8 @@ typedef ci_uint16 oo_fd_flags;
 #define OO_FDFLAG_EP_ALIEN       0x10
 #define OO_FDFLAG_EP_PIPE_READ   0x20
 #define OO_FDFLAG_EP_PIPE_WRITE  0x40
-#define OO_FDFLAG_EP_MASK        0x7e
+#define OO_FDFLAG_EP_UNIX        0x200
+#define OO_FDFLAG_EP_MASK        0x27e
 /* Replacement for "type" when it is not known, to be used as function
  * parameter only.
  */
@@ -332,7 +353,8 @@ typedef ci_uint16 oo_fd_flags;
   (flags) & OO_FDFLAG_EP_PASSTHROUGH ? "os_sock" :  \
   (flags) & OO_FDFLAG_EP_ALIEN ? "moved" :          \
   (flags) & OO_FDFLAG_EP_PIPE_READ ? "piper" :      \
-  (flags) & OO_FDFLAG_EP_PIPE_WRITE ? "pipew" : "?" \
+  (flags) & OO_FDFLAG_EP_PIPE_WRITE ? "pipew" :     \
+  (flags) & OO_FDFLAG_EP_UNIX ? "unix" : "?"        \
 
 #define OO_FDFLAG_FMT "0x%x %s %s"
 #define OO_FDFLAG_ARG(flags) \
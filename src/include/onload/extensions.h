@@ -709,6 +709,28 @@ onload_socket_nonaccel(int domain, int type, int protocol);
 extern int
 onload_socket_unicast_nonaccel(int domain, int type, int protocol);
 
+
+/**********************************************************************
+ * onload_accept_batch: accept several connections at once
+ *
+ * Accepts up to [n] connections from the listening socket [fd], storing
+ * the new file descriptors in [fds] and, if [addrs] is not NULL, the
+ * peer addresses in [addrs].  [flags] are as for accept4().
+ *
+ * Blocks (unless [fd] is non-blocking) until at least one connection is
+ * available, then takes as many more as are already queued without
+ * blocking.  For accelerated sockets the file descriptors are created
+ * with a single system call.
+ *
+ * Returns the number of connections accepted, or -1 with errno set as for
+ * accept4().  If [fd] is not accelerated by Onload at most one connection
+ * is accepted.  Returns -1 with errno ENOSYS if the onload extensions
+ * library is not in use.
+ */
+extern int
+onload_accept_batch(int fd, int* fds, struct sockaddr_storage* addrs,
+                    int n, int flags);
+
 #endif /* ONLOAD_INCLUDE_DS_DATA_ONLY */
 
 #ifdef __cplusplus
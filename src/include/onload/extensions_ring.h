@@ -0,0 +1,256 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_HEADER >
+**  \brief  Onload submission/completion ring API
+** </L5_PRIVATE>
+**
+** An asynchronous interface to send, recv, accept and connect, shaped
+** like io_uring.  io_uring requests are executed by the kernel and so
+** bypass Onload; requests submitted through this API are executed by
+** Onload in user space, with the same calls as the intercepted system
+** calls.
+*//*
+\**************************************************************************/
+
+#ifndef __ONLOAD_EXTENSIONS_RING_H__
+#define __ONLOAD_EXTENSIONS_RING_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/******************************************************************************
+ * Usage
+ ******************************************************************************/
+
+/* The application owns a struct onload_ring, initialised with
+ * onload_ring_init().  To issue requests it fills in submission queue
+ * entries (SQEs) obtained with onload_ring_get_sqe(), typically with one of
+ * the onload_ring_prep_*() helpers, and then calls onload_ring_submit() to
+ * hand all of them to Onload at once.
+ *
+ * Each request produces exactly one completion queue entry (CQE), carrying
+ * the user_data of the request and the result as it would have been
+ * returned by the corresponding system call, or -errno on failure.
+ * Requests which can complete immediately do so during
+ * onload_ring_submit().  The others remain in flight until
+ * onload_ring_wait(), which polls their fds as onload_poll() would,
+ * spinning or blocking according to the usual EF_POLL_USEC and EF_UL_POLL
+ * settings, and then retries those which are ready.  CQEs are
+ * read with onload_ring_peek_cqe() and released with onload_ring_cqe_seen().
+ *
+ *   struct onload_ring ring;
+ *   struct onload_ring_sqe* sqe;
+ *   struct onload_ring_cqe* cqe;
+ *
+ *   onload_ring_init(64, &ring, 0);
+ *   sqe = onload_ring_get_sqe(&ring);
+ *   onload_ring_prep_recv(sqe, fd, buf, sizeof(buf), 0);
+ *   sqe->user_data = 1;
+ *   onload_ring_submit(&ring);
+ *   onload_ring_wait(&ring, 1, -1);
+ *   while( (cqe = onload_ring_peek_cqe(&ring)) != NULL ) {
+ *     ... cqe->user_data, cqe->res ...
+ *     onload_ring_cqe_seen(&ring, cqe);
+ *   }
+ *
+ * Requests on the same fd complete in the order they were submitted.  NOP
+ * ignores its fd and always completes during onload_ring_submit().  The
+ * fds need not be accelerated: requests on other fds are passed to the
+ * kernel in the same way as the corresponding system calls.  connect() and
+ * accept() on a kernel socket have no way to avoid blocking other than
+ * O_NONBLOCK.  So on a blocking kernel socket, including one that Onload
+ * hands a connect over to, CONNECT is made synchronously by
+ * onload_ring_submit(), and ACCEPT waits for the listener to become
+ * readable before calling accept().
+ *
+ * The API saves the application from managing readiness itself; it is not
+ * a faster path than the system calls.  Each request is made with its own
+ * call into the stack, so submitting a batch does not amortise the cost of
+ * taking the stack lock, and completions are not posted by the stack as it
+ * processes events.
+ *
+ * A ring must not be used by more than one thread at a time.  The number
+ * of requests in flight plus unread CQEs is limited to the size of the
+ * completion queue, twice the number of SQEs.  onload_ring_submit() stops
+ * consuming SQEs when that limit is reached.
+ *
+ * Request buffers, addresses and address lengths must remain valid until
+ * the request completes.
+ */
+
+
+/******************************************************************************
+ * Ring structures
+ ******************************************************************************/
+
+enum onload_ring_op {
+  ONLOAD_RING_OP_NOP = 0,
+  /* send(fd, addr, len, msg_flags) */
+  ONLOAD_RING_OP_SEND,
+  /* recv(fd, addr, len, msg_flags) */
+  ONLOAD_RING_OP_RECV,
+  /* accept4(fd, addr, addr2, msg_flags) */
+  ONLOAD_RING_OP_ACCEPT,
+  /* connect(fd, addr, len) */
+  ONLOAD_RING_OP_CONNECT,
+};
+
+struct onload_ring_sqe {
+  uint8_t  opcode;     /* enum onload_ring_op */
+  uint8_t  reserved[3];
+  int32_t  fd;
+  uint64_t addr;       /* buffer or socket address */
+  uint64_t addr2;      /* ACCEPT: pointer to the address length */
+  uint32_t len;        /* buffer or socket address length */
+  uint32_t msg_flags;  /* MSG_* flags, or SOCK_* flags for ACCEPT */
+  uint64_t user_data;  /* copied to the CQE */
+};
+
+struct onload_ring_cqe {
+  uint64_t user_data;
+  int32_t  res;        /* result, or -errno */
+  uint32_t flags;      /* reserved, currently zero */
+};
+
+struct onload_ring {
+  /* Submission queue.  The application writes entries at sq_tail, and
+   * onload_ring_submit() consumes them from sq_head. */
+  struct onload_ring_sqe* sqes;
+  unsigned sq_entries;
+  unsigned sq_head;
+  unsigned sq_tail;
+
+  /* Completion queue.  Onload writes entries at cq_tail, and the
+   * application consumes them from cq_head. */
+  struct onload_ring_cqe* cqes;
+  unsigned cq_entries;
+  unsigned cq_head;
+  unsigned cq_tail;
+
+  /* Private to Onload */
+  void* priv;
+};
+
+
+/******************************************************************************
+ * Ring functions
+ ******************************************************************************/
+
+/* Allocate the queues of [ring].  [entries] is rounded up to a power of
+ * two.  [flags] must be zero.
+ *
+ * Returns 0 on success, or -ENOSYS if not running with Onload, -EINVAL or
+ * -ENOMEM.
+ */
+extern int onload_ring_init(unsigned entries, struct onload_ring* ring,
+                            unsigned flags);
+
+/* Free the queues of [ring].  Requests still in flight are abandoned
+ * without completion.
+ */
+extern int onload_ring_free(struct onload_ring* ring);
+
+/* Start executing the requests placed in the submission queue.
+ *
+ * Returns the number of SQEs consumed, which is less than the number
+ * submitted if the completion queue would otherwise be at risk of
+ * overflow, or -EBUSY if none could be consumed for that reason.
+ */
+extern int onload_ring_submit(struct onload_ring* ring);
+
+/* Poll the stack until there are at least [min_complete] unread CQEs, or
+ * [timeout] milliseconds elapse (-1 for no limit), or no requests remain in
+ * flight.
+ *
+ * Returns the number of unread CQEs, or -errno.
+ */
+extern int onload_ring_wait(struct onload_ring* ring, unsigned min_complete,
+                            int timeout);
+
+
+static inline struct onload_ring_sqe*
+onload_ring_get_sqe(struct onload_ring* ring)
+{
+  struct onload_ring_sqe* sqe;
+
+  if( ring->sq_tail - ring->sq_head >= ring->sq_entries )
+    return NULL;
+  sqe = &ring->sqes[ring->sq_tail++ & (ring->sq_entries - 1)];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+static inline struct onload_ring_cqe*
+onload_ring_peek_cqe(struct onload_ring* ring)
+{
+  if( ring->cq_head == ring->cq_tail )
+    return NULL;
+  return &ring->cqes[ring->cq_head & (ring->cq_entries - 1)];
+}
+
+static inline void
+onload_ring_cqe_seen(struct onload_ring* ring, struct onload_ring_cqe* cqe)
+{
+  (void) cqe;
+  ++ring->cq_head;
+}
+
+
+static inline void
+onload_ring_prep_send(struct onload_ring_sqe* sqe, int fd, const void* buf,
+                      size_t len, int flags)
+{
+  sqe->opcode = ONLOAD_RING_OP_SEND;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) buf;
+  sqe->len = len;
+  sqe->msg_flags = flags;
+}
+
+static inline void
+onload_ring_prep_recv(struct onload_ring_sqe* sqe, int fd, void* buf,
+                      size_t len, int flags)
+{
+  sqe->opcode = ONLOAD_RING_OP_RECV;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) buf;
+  sqe->len = len;
+  sqe->msg_flags = flags;
+}
+
+static inline void
+onload_ring_prep_accept(struct onload_ring_sqe* sqe, int fd,
+                        struct sockaddr* addr, socklen_t* addrlen, int flags)
+{
+  sqe->opcode = ONLOAD_RING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) addr;
+  sqe->addr2 = (uintptr_t) addrlen;
+  sqe->msg_flags = flags;
+}
+
+static inline void
+onload_ring_prep_connect(struct onload_ring_sqe* sqe, int fd,
+                         const struct sockaddr* addr, socklen_t addrlen)
+{
+  sqe->opcode = ONLOAD_RING_OP_CONNECT;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t) addr;
+  sqe->len = addrlen;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ONLOAD_EXTENSIONS_RING_H__ */
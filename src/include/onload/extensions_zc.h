@@ -16,6 +16,7 @@
 
 #include <sys/uio.h>    // for struct iovec
 #include <sys/socket.h> // for struct msghdr
+#include <sys/epoll.h>  // for struct epoll_event
 #include <stdint.h>
 
 #include <etherfabric/ef_vi.h>
@@ -284,6 +285,57 @@ extern int onload_zc_recv(int fd, struct onload_zc_recv_args *args);
 extern int onload_recvmsg_kernel(int fd, struct msghdr *msg, int flags);
 
 
+/* onload_zc_recv_epoll waits for events on the epoll set epfd as
+ * epoll_wait() would, and then does a zero-copy receive from each ready
+ * socket, so that a single call returns the data from many sockets.
+ *
+ * On entry each msgs[i].msg.iov must point to an array of
+ * msgs[i].msg.msghdr.msg_iovlen iovecs, and msg_name and msg_control may
+ * be set as for recvmsg.  On return the first n entries, where n is the
+ * return value, each describe one message:
+ *
+ *  - msgs[i].fd is the socket it was received on
+ *  - msgs[i].rc is its length
+ *  - msgs[i].msg.iov and msg_iovlen give the buffers holding it.  If
+ *  there were not enough iovecs MSG_TRUNC is set in msg_flags, and the
+ *  rest of the message is not returned.
+ *  - msg_name, msg_namelen, msg_control, msg_controllen and msg_flags are
+ *  filled as for recvmsg
+ *
+ * Ownership of the buffers passes to the application, as if the callback
+ * of onload_zc_recv() had returned ONLOAD_ZC_KEEP, and they must be freed
+ * with onload_zc_release_buffers(msgs[i].fd, &msgs[i].msg.iov[0].buf, 1).
+ * For TCP a message is a run of in-order segments, and several messages
+ * may be returned for a socket.
+ *
+ * Ready events that are not returned as messages are stored in events,
+ * which has room for *n_events entries, and *n_events is set to the number
+ * stored.  These are events for fds which can't be read with zero-copy
+ * (kernel sockets, and UDP sockets with kernel traffic unless flags
+ * includes ONLOAD_MSG_RECV_OS_INLINE), events other than EPOLLIN, sockets
+ * reporting an error or end of file, and sockets which may have more data
+ * because msgs was filled.  The application should handle these as it
+ * would the results of epoll_wait(), which is important when using
+ * EPOLLET.  No more than the smaller of mlen and *n_events ready fds are
+ * taken from the set in one call.
+ *
+ * Zero-copy receive is only possible when Onload handles the epoll set
+ * itself (EF_UL_EPOLL=1 or 3).  Otherwise all events are returned in
+ * events.
+ *
+ * flags may include ONLOAD_MSG_RECV_OS_INLINE, which has the same meaning
+ * as for onload_zc_recv().  The receives never block; timeout applies
+ * only to waiting for events.
+ *
+ * Returns the number of messages, which may be 0 when there are events,
+ * or <0 to indicate an error.
+ */
+
+extern int onload_zc_recv_epoll(int epfd, struct onload_zc_mmsg* msgs,
+                                int mlen, struct epoll_event* events,
+                                int* n_events, int timeout, int flags);
+
+
 /* onload_zc_send will send each of the messages supplied in the msgs
  * array using the fd from struct onload_zc_mmsg.  Each message
  * consists of an array of buffers (msgs[i].msg.iov[j].iov_base,
@@ -109,9 +109,17 @@ enum {
 #define OO_IOC_TCP_ACCEPT_SOCK_ATTACH   OO_IOC_RW(TCP_ACCEPT_SOCK_ATTACH, \
                                               oo_tcp_accept_sock_attach_t)
 
+  OO_OP_TCP_ACCEPT_SOCK_ATTACH_BATCH,
+#define OO_IOC_TCP_ACCEPT_SOCK_ATTACH_BATCH \
+                          OO_IOC_RW(TCP_ACCEPT_SOCK_ATTACH_BATCH, \
+                                    oo_tcp_accept_sock_attach_batch_t)
+
   OO_OP_PIPE_ATTACH,
 #define OO_IOC_PIPE_ATTACH          OO_IOC_RW(PIPE_ATTACH, \
                                               oo_pipe_attach_t)
+  OO_OP_UNIX_ATTACH,
+#define OO_IOC_UNIX_ATTACH          OO_IOC_RW(UNIX_ATTACH, \
+                                              oo_unix_attach_t)
 #if CI_CFG_FD_CACHING
   OO_OP_SOCK_DETACH,
 #define OO_IOC_SOCK_DETACH          OO_IOC_RW(SOCK_DETACH, \
@@ -239,6 +247,12 @@ enum {
   OO_OP_AF_XDP_KICK,
 #define OO_IOC_AF_XDP_KICK OO_IOC_W(AF_XDP_KICK, ci_int32)
 
+#if CI_CFG_CLUSTER_STEER
+  /* Wake the cluster stack with the given rss_instance */
+  OO_OP_CLUSTER_STEER_KICK,
+#define OO_IOC_CLUSTER_STEER_KICK OO_IOC_W(CLUSTER_STEER_KICK, ci_int32)
+#endif
+
   OO_OP_EFCT_SUPERBUF_CONFIG_REFRESH,
 #define OO_IOC_EFCT_SUPERBUF_CONFIG_REFRESH \
                                OO_IOC_W(EFCT_SUPERBUF_CONFIG_REFRESH, \
@@ -55,6 +55,7 @@ extern struct file_operations linux_tcp_helper_fops_udp;
 extern struct file_operations linux_tcp_helper_fops_tcp;
 extern struct file_operations linux_tcp_helper_fops_pipe_reader;
 extern struct file_operations linux_tcp_helper_fops_pipe_writer;
+extern struct file_operations linux_tcp_helper_fops_unix;
 extern struct file_operations oo_epoll_fops;
 extern struct file_operations linux_tcp_helper_fops_passthrough;
 extern struct file_operations linux_tcp_helper_fops_alien;
@@ -84,7 +85,8 @@ linux_tcp_helper_fop_sendpage_udp(struct file*, struct page*, int offset,
       (f)->f_op == &linux_tcp_helper_fops_alien )
 #define FILE_IS_ENDPOINT_PIPE(f) \
     ( (f)->f_op == &linux_tcp_helper_fops_pipe_reader || \
-      (f)->f_op == &linux_tcp_helper_fops_pipe_writer )
+      (f)->f_op == &linux_tcp_helper_fops_pipe_writer || \
+      (f)->f_op == &linux_tcp_helper_fops_unix )
 #define FILE_IS_ENDPOINT_EPOLL(f) \
     ( (f)->f_op == &oo_epoll_fops )
 
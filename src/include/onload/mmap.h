@@ -22,6 +22,7 @@
  * - CI_NETIF_MMAP_ID_CTPIO     VI resource: CTPIO IO BAR
  * - CI_NETIF_MMAP_ID_PLUGIN    VI resource: EF100 plugin-specific BAR
  * - CI_NETIF_MMAP_ID_EFCT_SHM  VI resource: EFCT rxq shared state
+ * - CI_NETIF_MMAP_ID_STEER     cluster software steering rings
  * - CI_NETIF_MMAP_ID_PKTS + packet set id
  *   packet sets
  */
@@ -33,7 +34,8 @@
 #define CI_NETIF_MMAP_ID_CTPIO    5
 #define CI_NETIF_MMAP_ID_PLUGIN   6
 #define CI_NETIF_MMAP_ID_EFCT_SHM 7
-#define CI_NETIF_MMAP_ID_PKTS     8
+#define CI_NETIF_MMAP_ID_STEER    8
+#define CI_NETIF_MMAP_ID_PKTS     9
 #define CI_NETIF_MMAP_ID_PKTSET(id) (CI_NETIF_MMAP_ID_PKTS+(id))
 
 
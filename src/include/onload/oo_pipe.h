@@ -19,9 +19,7 @@
                                  (_p)->bufs_num < (_p)->bufs_max)
 
 
-#ifdef __KERNEL__
 void oo_pipe_wake_peer(ci_netif* ni, struct oo_pipe* p, unsigned wake);
-#endif
 
 extern void oo_pipe_buf_clear_state(ci_netif* ni, struct oo_pipe* p);
 
@@ -112,6 +112,9 @@ typedef struct tcp_helper_cluster_s {
 #define THC_FLAG_SCALABLE          0x10
 
 #define THC_FLAG_PREALLOC_LPORTS   0x20
+
+/* Flows are spread over the stacks in software (EF_CLUSTER_STEER). */
+#define THC_FLAG_STEER             0x40
   unsigned                        thc_flags;
   uint16_t*                       thc_tproxy_ifindex;
   int                             thc_tproxy_ifindex_count;
@@ -133,6 +136,21 @@ typedef struct tcp_helper_cluster_s {
    * the tcp_helper_resource_t instances that use it for the packet buffer
    * allocation. */
   struct oo_hugetlb_allocator*    thc_pktbuf_alloc;
+
+#if CI_CFG_CLUSTER_STEER
+  /* Software steering area, shared with the stacks.  Allocated with the
+   * first stack, as the ring size is a stack option. */
+  struct oo_steer_area*           thc_steer;
+  unsigned                        thc_steer_bytes;
+  unsigned                        thc_steer_ring_size;
+  /* rss_instance values in use, and the one being given to the stack
+   * under construction (protected by thc_mutex). */
+  ci_uint64                       thc_steer_claimed;
+  int                             thc_steer_claiming;
+  /* Stacks by rss_instance, for wakeups. */
+  ci_irqlock_t                    thc_steer_lock;
+  struct tcp_helper_resource_s*   thc_steer_thr[OO_STEER_MAX_RINGS];
+#endif
 } tcp_helper_cluster_t;
 
 
@@ -484,6 +502,11 @@ struct tcp_helper_endpoint_s {
 #define OO_THR_EP_AFLAG_OS_NOTIFIER    0x20 /* Pollwait registration for os */
 #define OO_THR_EP_AFLAG_TCP_OFFLOAD_ISN 0x40 /* Send sync_stream to plugin */
 
+  /*! For a pipe of an AF_UNIX socketpair: the pipe the socket reading this
+   * one writes to.  Kept here rather than trusted from the shared state, as
+   * closing the socket closes both pipes. */
+  oo_sp unix_peer;
+
   struct ci_private_s* alien_ref;
 
   struct {
@@ -50,6 +50,10 @@ extern int tcp_helper_cluster_vi_hw_stack_id(tcp_helper_cluster_t* thc, int hwpo
  * given cluster, or -1 if cluster does not have VI set for that hwport */
 extern int tcp_helper_cluster_vi_base(tcp_helper_cluster_t* thc, int hwport);
 
+/* Return whether filters for the given cluster should spread traffic over
+ * its VI sets with RSS. */
+extern int tcp_helper_cluster_vi_rss(tcp_helper_cluster_t* thc);
+
 /* Return whether receiving of looped back traffic is enabled on
  * the named hwport, or -1 if we don't have a VI for that hwport.
  */
@@ -231,6 +231,12 @@ extern int efab_tcp_helper_map_usermem(tcp_helper_resource_t* trs,
 extern void efab_tcp_helper_unmap_usermem(tcp_helper_resource_t* trs,
                                           struct oo_iobufs_usermem* ioum);
 
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+extern void
+efab_tcp_helper_zc_unregister_buffers_deferred(tcp_helper_resource_t* trs,
+                                               ci_uint64 id);
+#endif
+
 extern int efab_tcp_helper_more_bufs(tcp_helper_resource_t* trs);
 
 extern int efab_tcp_helper_more_socks(tcp_helper_resource_t* trs);
@@ -293,6 +299,17 @@ extern int tcp_helper_cluster_alloc_thr(const char* name,
                                         const ci_netif_config_opts* ni_opts,
                                         tcp_helper_resource_t** thr_out);
 
+#if CI_CFG_CLUSTER_STEER
+extern int
+tcp_helper_cluster_steer_instance(tcp_helper_cluster_t* thc);
+
+extern int
+tcp_helper_cluster_steer_kick(tcp_helper_resource_t* thr, int instance);
+
+extern void
+tcp_helper_defer_poll_and_prime(tcp_helper_resource_t* trs);
+#endif
+
 
 /*--------------------------------------------------------------------
  *!
@@ -422,6 +439,8 @@ efab_tcp_helper_ready_list_events(tcp_helper_resource_t* trs,
 
 
 extern int efab_attach_os_socket(tcp_helper_endpoint_t*, struct file*);
+extern void efab_tcp_helper_drop_os_socket(tcp_helper_resource_t* trs,
+                                           tcp_helper_endpoint_t* ep);
 extern int efab_create_os_socket(tcp_helper_resource_t* trs,
                                  tcp_helper_endpoint_t* ep, ci_int32 domain,
                                  ci_int32 type, int flags);
@@ -193,5 +193,28 @@ oo_pipe_poll_write_events(struct oo_pipe* p)
   return events;
 }
 
+/* Events for one end of an accelerated AF_UNIX socketpair, which reads [rx]
+ * and writes [tx].  As Linux does, a socket that cannot send is reported
+ * writable so that send() fails at once, and POLLHUP needs both directions
+ * shut down. */
+ci_inline unsigned
+oo_unix_poll_events(struct oo_pipe* rx, struct oo_pipe* tx)
+{
+  unsigned events = 0;
+  int rx_shut = rx->aflags & CI_PFD_AFLAG_EITHER_CLOSED;
+  int tx_shut = tx->aflags & CI_PFD_AFLAG_EITHER_CLOSED;
+
+  if( oo_pipe_data_len(rx) || rx_shut )
+    events |= POLLIN | POLLRDNORM;
+  if( rx_shut )
+    events |= POLLRDHUP;
+  if( oo_pipe_is_writable(tx) || tx_shut )
+    events |= POLLOUT | POLLWRNORM | POLLWRBAND;
+  if( rx_shut && tx_shut )
+    events |= POLLHUP;
+
+  return events;
+}
+
 
 #endif  /* __ONLOAD_TCP_POLL_H__ */
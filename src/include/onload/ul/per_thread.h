@@ -46,6 +46,9 @@ struct oo_per_thread {
   ci_uint64                  select_nonblock_fast_frc;
   struct oo_timesync         timesync;
   unsigned                   spinstate; 
+  unsigned                   accept_shard;
+  /* Set while onload_ring makes a call which must not block */
+  unsigned                   ring_nonblock;
   int                        in_vfork_child;
   void*                      vfork_scratch[OO_VFORK_SCRATCH_SIZE];
 };
@@ -37,8 +37,19 @@ ci_tcp_helper_sock_attach_to_existing_file(ci_fd_t stack_fd, oo_sp ep_id);
 /*! Allocate fd for accepted tcp socket ep_id */
 extern int ci_tcp_helper_tcp_accept_sock_attach(ci_fd_t stack_fd, oo_sp ep_id,
                                                int type);
+/*! Allocate fds for [n] accepted tcp sockets.  Returns the number of fds
+ * created, which may be fewer than [n], or a negative error code. */
+extern int ci_tcp_helper_tcp_accept_sock_attach_batch(ci_fd_t stack_fd,
+                                                      const oo_sp* ep_ids,
+                                                      int* fds, int n,
+                                                      int type);
 extern int ci_tcp_helper_pipe_attach(ci_fd_t stack_fd, oo_sp ep_id,
                                      int flags, int fds[2]);
+/*! Allocate fds for the two ends of an AF_UNIX socketpair; fds[i] reads
+ * pipe ep_ids[i] and writes the other. */
+extern int ci_tcp_helper_unix_attach(ci_fd_t stack_fd, const oo_sp ep_ids[2],
+                                     const int os_fds[2], int flags,
+                                     int fds[2]);
 
 #if CI_CFG_FD_CACHING
 extern int ci_tcp_helper_clear_epcache(struct ci_netif_s*);
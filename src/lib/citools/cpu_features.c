@@ -152,6 +152,45 @@ get_cpuid(int op, int *eax, int *ebx, int *ecx, int *edx)
                         : "a" (op));
 }
 
+/* For the leaves which take a sub-leaf in ecx */
+ci_inline void
+get_cpuid_count(int op, int count, int *eax, int *ebx, int *ecx, int *edx)
+{
+  __asm__ __volatile__ ("cpuid\n\t"
+                        : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                        : "a" (op), "c" (count));
+}
+
+/* The register state the OS saves on context switch, from XCR0.  Vector
+ * instructions are only usable if the OS saves the registers they use. */
+static ci_uint64 get_xcr0(void)
+{
+  int eax, ebx, ecx, edx;
+  ci_uint32 lo, hi;
+
+  get_cpuid(1, &eax, &ebx, &ecx, &edx);
+  if( ! (ecx & 0x08000000) )  /* OSXSAVE */
+    return 0;
+  __asm__ __volatile__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  return ((ci_uint64) hi << 32) | lo;
+}
+
+#define XCR0_SSE        0x02
+#define XCR0_AVX        0x04
+#define XCR0_AVX512     0xe0  /* opmask, ZMM_Hi256 and Hi16_ZMM */
+
+/* Leaf 7 ebx bits, or 0 if the CPU does not have leaf 7 */
+static int get_cpuid7_ebx(void)
+{
+  int eax, ebx, ecx, edx;
+
+  get_cpuid(0, &eax, &ebx, &ecx, &edx);
+  if( eax < 7 )
+    return 0;
+  get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+  return ebx;
+}
+
 #else
 
 /*****************************************************************************
@@ -177,6 +216,19 @@ int ci_cpu_has_feature(char* feature)
 
   if( ! strcmp(feature, "pclmul") )
     return ecx & 0x00000002;
+  if( ! strcmp(feature, "sse2") )
+    return edx & 0x04000000;
+  if( ! strcmp(feature, "sse4.2") )
+    return ecx & 0x00100000;
+#endif
+#if defined(__x86_64__)
+  if( ! strcmp(feature, "avx2") )
+    return (get_xcr0() & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX) &&
+           (get_cpuid7_ebx() & 0x00000020);
+  if( ! strcmp(feature, "avx512f") )
+    return (get_xcr0() & (XCR0_SSE | XCR0_AVX | XCR0_AVX512)) ==
+             (XCR0_SSE | XCR0_AVX | XCR0_AVX512) &&
+           (get_cpuid7_ebx() & 0x00010000);
 #endif
 
   /* Not supported on platforms that don't implement the CPUID instruction */
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/**************************************************************************\
+*//*! \file
+** <L5_PRIVATE L5_SOURCE>
+**  \brief  Vector implementations of Internet checksum and copy.
+** </L5_PRIVATE>
+*//*
+\**************************************************************************/
+
+/*! \cidoxg_lib_citools */
+
+#include "citools_internal.h"
+#include <ci/tools/cpu_features.h>
+
+#if CI_IP_CSUM_SIMD
+
+#include <x86intrin.h>
+
+/* All the kernels work in the same way: the data is loaded one vector at a
+ * time, stored to [dest] if copying, and each 32-bit word is zero-extended
+ * and added into a vector of 64-bit accumulators.  These can't overflow
+ * for any buffer with an int length, so there is no carry to propagate
+ * inside the loop.  At the end the lanes are added together and folded to
+ * 32 bits with end-around carry.
+ *
+ * The result is congruent modulo 0xffff with the one produced by
+ * ci_ip_csum_copy_aligned_c(), and is zero only if that one is, so the two
+ * fold to the same 16-bit checksum.  The tail which does not fill a whole
+ * vector is handled by the C version.
+ */
+
+ci_inline unsigned ci_ip_csum_add64(unsigned sum, ci_uint64 acc)
+{
+  ci_uint32 v;
+
+  acc = (acc & 0xffffffffu) + (acc >> 32u);
+  acc = (acc & 0xffffffffu) + (acc >> 32u);
+  v = (ci_uint32) acc;
+  ci_add_carry32(sum, v);
+  return sum;
+}
+
+
+__attribute__((target("sse2"), always_inline)) static inline unsigned
+ci_ip_csum_sse2_body(void* dest, const void* src, int n, unsigned sum,
+                     int copy)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc0 = zero, acc1 = zero;
+  const char* s = src;
+  char* d = dest;
+  int i;
+
+  for( i = 0; i + 16 <= n; i += 16 ) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+    if( copy )
+      _mm_storeu_si128((__m128i*) (d + i), v);
+    acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v, zero));
+    acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v, zero));
+  }
+  acc0 = _mm_add_epi64(acc0, acc1);
+  acc0 = _mm_add_epi64(acc0, _mm_unpackhi_epi64(acc0, acc0));
+  sum = ci_ip_csum_add64(sum, (ci_uint64) _mm_cvtsi128_si64(acc0));
+
+  if( copy )
+    return ci_ip_csum_copy_aligned_c(d + i, s + i, n - i, sum);
+  return ci_ip_csum_aligned_c(s + i, n - i, sum);
+}
+
+
+__attribute__((target("avx2"), always_inline)) static inline unsigned
+ci_ip_csum_avx2_body(void* dest, const void* src, int n, unsigned sum,
+                     int copy)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i acc0 = zero, acc1 = zero, acc2 = zero, acc3 = zero;
+  __m128i acc;
+  const char* s = src;
+  char* d = dest;
+  int i;
+
+  /* Two vectors per iteration, to keep more adds in flight. */
+  for( i = 0; i + 64 <= n; i += 64 ) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i*) (s + i));
+    __m256i v1 = _mm256_loadu_si256((const __m256i*) (s + i + 32));
+    if( copy ) {
+      _mm256_storeu_si256((__m256i*) (d + i), v0);
+      _mm256_storeu_si256((__m256i*) (d + i + 32), v1);
+    }
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+    acc2 = _mm256_add_epi64(acc2, _mm256_unpacklo_epi32(v1, zero));
+    acc3 = _mm256_add_epi64(acc3, _mm256_unpackhi_epi32(v1, zero));
+  }
+  if( i + 32 <= n ) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i*) (s + i));
+    if( copy )
+      _mm256_storeu_si256((__m256i*) (d + i), v0);
+    acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+    acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+    i += 32;
+  }
+  acc0 = _mm256_add_epi64(_mm256_add_epi64(acc0, acc1),
+                          _mm256_add_epi64(acc2, acc3));
+  acc = _mm_add_epi64(_mm256_castsi256_si128(acc0),
+                      _mm256_extracti128_si256(acc0, 1));
+  acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+  sum = ci_ip_csum_add64(sum, (ci_uint64) _mm_cvtsi128_si64(acc));
+
+  if( copy )
+    return ci_ip_csum_copy_aligned_c(d + i, s + i, n - i, sum);
+  return ci_ip_csum_aligned_c(s + i, n - i, sum);
+}
+
+
+__attribute__((target("avx512f"), always_inline)) static inline unsigned
+ci_ip_csum_avx512_body(void* dest, const void* src, int n, unsigned sum,
+                       int copy)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  __m512i acc0 = zero, acc1 = zero;
+  const char* s = src;
+  char* d = dest;
+  int i;
+
+  for( i = 0; i + 64 <= n; i += 64 ) {
+    __m512i v = _mm512_loadu_si512((const void*) (s + i));
+    if( copy )
+      _mm512_storeu_si512((void*) (d + i), v);
+    acc0 = _mm512_add_epi64(acc0, _mm512_unpacklo_epi32(v, zero));
+    acc1 = _mm512_add_epi64(acc1, _mm512_unpackhi_epi32(v, zero));
+  }
+  sum = ci_ip_csum_add64(sum, (ci_uint64)
+                         _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1)));
+
+  if( copy )
+    return ci_ip_csum_copy_aligned_c(d + i, s + i, n - i, sum);
+  return ci_ip_csum_aligned_c(s + i, n - i, sum);
+}
+
+
+__attribute__((target("sse2"))) unsigned
+ci_ip_csum_copy_sse2(void* dest, const void* src, int n, unsigned sum)
+{ return ci_ip_csum_sse2_body(dest, src, n, sum, 1); }
+
+__attribute__((target("sse2"))) unsigned
+ci_ip_csum_sse2(const void* src, int n, unsigned sum)
+{ return ci_ip_csum_sse2_body(NULL, src, n, sum, 0); }
+
+__attribute__((target("avx2"))) unsigned
+ci_ip_csum_copy_avx2(void* dest, const void* src, int n, unsigned sum)
+{ return ci_ip_csum_avx2_body(dest, src, n, sum, 1); }
+
+__attribute__((target("avx2"))) unsigned
+ci_ip_csum_avx2(const void* src, int n, unsigned sum)
+{ return ci_ip_csum_avx2_body(NULL, src, n, sum, 0); }
+
+__attribute__((target("avx512f"))) unsigned
+ci_ip_csum_copy_avx512(void* dest, const void* src, int n, unsigned sum)
+{ return ci_ip_csum_avx512_body(dest, src, n, sum, 1); }
+
+__attribute__((target("avx512f"))) unsigned
+ci_ip_csum_avx512(const void* src, int n, unsigned sum)
+{ return ci_ip_csum_avx512_body(NULL, src, n, sum, 0); }
+
+
+static unsigned
+ci_ip_csum_copy_c_fn(void* dest, const void* src, int n, unsigned sum)
+{ return ci_ip_csum_copy_aligned_c(dest, src, n, sum); }
+
+static unsigned
+ci_ip_csum_c_fn(const void* src, int n, unsigned sum)
+{ return ci_ip_csum_aligned_c(src, n, sum); }
+
+
+static unsigned
+(*ci_ip_csum_copy_fn)(void* dest, const void* src, int n, unsigned sum);
+static unsigned (*ci_ip_csum_fn)(const void* src, int n, unsigned sum);
+
+
+/* Pick the widest kernel the CPU supports.  It doesn't matter if several
+ * threads race to do this, as they all make the same choice. */
+static void ci_ip_csum_simd_select(void)
+{
+  if( ci_cpu_has_feature("avx512f") ) {
+    ci_ip_csum_fn = ci_ip_csum_avx512;
+    ci_ip_csum_copy_fn = ci_ip_csum_copy_avx512;
+  }
+  else if( ci_cpu_has_feature("avx2") ) {
+    ci_ip_csum_fn = ci_ip_csum_avx2;
+    ci_ip_csum_copy_fn = ci_ip_csum_copy_avx2;
+  }
+  else if( ci_cpu_has_feature("sse2") ) {
+    ci_ip_csum_fn = ci_ip_csum_sse2;
+    ci_ip_csum_copy_fn = ci_ip_csum_copy_sse2;
+  }
+  else {
+    ci_ip_csum_fn = ci_ip_csum_c_fn;
+    ci_ip_csum_copy_fn = ci_ip_csum_copy_c_fn;
+  }
+}
+
+
+unsigned ci_ip_csum_copy_simd(void* dest, const void* src, int n,
+                              unsigned sum)
+{
+  if(CI_UNLIKELY( ci_ip_csum_copy_fn == NULL ))
+    ci_ip_csum_simd_select();
+  return ci_ip_csum_copy_fn(dest, src, n, sum);
+}
+
+
+unsigned ci_ip_csum_simd(const void* src, int n, unsigned sum)
+{
+  if(CI_UNLIKELY( ci_ip_csum_fn == NULL ))
+    ci_ip_csum_simd_select();
+  return ci_ip_csum_fn(src, n, sum);
+}
+
+#endif /* CI_IP_CSUM_SIMD */
+
+/*! \cidoxg_end */
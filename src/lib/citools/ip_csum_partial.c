@@ -25,6 +25,11 @@ unsigned ci_ip_csum_partial(unsigned sum, const volatile void* in_buf,
   ci_assert(in_buf || bytes == 0);
   ci_assert(bytes >= 0);
 
+#if CI_IP_CSUM_SIMD
+  if( bytes >= CI_IP_CSUM_SIMD_MIN )
+    return ci_ip_csum_simd((const void*) in_buf, bytes, sum);
+#endif
+
   while( bytes > 1 ) {
     sum += *buf++;
     bytes -= 2;
@@ -166,7 +166,7 @@ oo_hw_filter_set_hwport(struct oo_hw_filter* oofilter, int hwport,
       flags |= EFX_FILTER_FLAG_TX;
     }
 
-    if( cluster && ! drop && oofilter->thc->thc_cluster_size > 1 )
+    if( cluster && ! drop && tcp_helper_cluster_vi_rss(oofilter->thc) )
       flags |= EFX_FILTER_FLAG_RX_RSS;
 
     efx_filter_init_rx(&spec, EFX_FILTER_PRI_REQUIRED, flags, vi_id);
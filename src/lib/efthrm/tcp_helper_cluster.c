@@ -186,6 +186,17 @@ static int thc_alloc(const char* cluster_name, int protocol, int port_be16,
   ci_assert(mutex_is_locked(&thc_init_mutex));
   ci_assert(mutex_is_locked(&thc_mutex));
 
+#if CI_CFG_CLUSTER_STEER
+  if( (flags & THC_FLAG_STEER) &&
+      (tproxy || cluster_size < 2 || cluster_size > OO_STEER_MAX_RINGS) ) {
+    if( cluster_size > 1 )
+      LOG_E(ci_log("%s: EF_CLUSTER_STEER is not supported with transparent "
+                   "proxy or with a cluster size above %d; using RSS",
+                   __FUNCTION__, OO_STEER_MAX_RINGS));
+    flags &= ~THC_FLAG_STEER;
+  }
+#endif
+
   thc = kmalloc(sizeof(*thc), GFP_KERNEL);
   if( thc == NULL )
     return -ENOMEM;
@@ -232,6 +243,10 @@ static int thc_alloc(const char* cluster_name, int protocol, int port_be16,
   thc->thc_switch_port        = 0;
   thc->thc_switch_addr        = addr_any;
   thc->thc_pktbuf_alloc       = NULL;
+#if CI_CFG_CLUSTER_STEER
+  thc->thc_steer_claiming     = -1;
+  ci_irqlock_ctor(&thc->thc_steer_lock);
+#endif
 
   if( thr && thr->thc_pktbuf_alloc ) {
     thc->thc_pktbuf_alloc = oo_hugetlb_allocator_get(thr->thc_pktbuf_alloc);
@@ -274,7 +289,9 @@ static int thc_alloc(const char* cluster_name, int protocol, int port_be16,
     rss_flags = tproxy ? EFHW_RSS_MODE_DST | EFHW_RSS_MODE_SRC :
                          EFHW_RSS_MODE_DEFAULT;
 redo:
-    rc = efrm_vi_set_alloc(pd, thc->thc_cluster_size,
+    /* A steering cluster receives everything on the VI of one stack. */
+    rc = efrm_vi_set_alloc(pd, (flags & THC_FLAG_STEER) ?
+                                 1 : thc->thc_cluster_size,
                            rss_flags, &thc->thc_vi_set[i]);
     if( rc != 0 && (rss_flags != EFHW_RSS_MODE_DEFAULT) ) {
       LOG_E(ci_log("Installing special RSS mode filter failed on hwport %d, "
@@ -451,12 +468,183 @@ static void thc_cluster_free(tcp_helper_cluster_t* thc)
       efrm_vi_set_release(thc->thc_vi_set[i]);
   if( thc->thc_pktbuf_alloc )
     oo_hugetlb_allocator_put(thc->thc_pktbuf_alloc);
+#if CI_CFG_CLUSTER_STEER
+  ci_assert_equal(thc->thc_steer_claimed, 0);
+  vfree(thc->thc_steer);
+  ci_irqlock_dtor(&thc->thc_steer_lock);
+#endif
   kfree(thc->thc_thr_rrobin);
   ci_assert(ci_dllist_is_empty(&thc->thc_tlos));
   kfree(thc);
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+/* Allocate the area through which instance 0 of a steering cluster passes
+ * packets to the other instances.
+ *
+ * requires thc_mutex
+ */
+static int thc_steer_alloc(tcp_helper_cluster_t* thc, unsigned ring_size)
+{
+  struct oo_steer_area* area;
+  unsigned slots_ofs, bytes;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+  ci_assert_ge(thc->thc_cluster_size, 2);
+  ci_assert_le(thc->thc_cluster_size, OO_STEER_MAX_RINGS);
+
+  ring_size = 1u << ci_log2_ge(CI_MAX(ring_size, 16u), 0);
+  ring_size = CI_MIN(ring_size, 16384u);
+  slots_ofs = OO_STEER_SLOTS_OFS;
+  bytes = PAGE_ALIGN(slots_ofs + (thc->thc_cluster_size - 1) * ring_size *
+                     OO_STEER_SLOT_SIZE);
+
+  area = vmalloc_user(bytes);
+  if( area == NULL )
+    return -ENOMEM;
+  area->n_rings = thc->thc_cluster_size;
+  area->ring_size = ring_size;
+  area->slots_ofs = slots_ofs;
+
+  thc->thc_steer = area;
+  thc->thc_steer_bytes = bytes;
+  thc->thc_steer_ring_size = ring_size;
+  return 0;
+}
+
+
+/* Pick the rss_instance for the next stack of a steering cluster.  The
+ * lowest free one is used so that instance 0, which receives for the whole
+ * cluster, is replaced when its stack goes away.
+ *
+ * requires thc_mutex
+ */
+static int thc_steer_claim(tcp_helper_cluster_t* thc)
+{
+  int i;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+  for( i = 0; i < thc->thc_cluster_size; ++i )
+    if( ! (thc->thc_steer_claimed & (1ull << i)) ) {
+      thc->thc_steer_claimed |= 1ull << i;
+      return i;
+    }
+  return -ENOSPC;
+}
+
+
+/* Stop instance 0 from using the ring of [instance], and wait until it is
+ * not part way through filling a slot.  A producer which doesn't finish
+ * within a second has stopped with its stack lock held.  If it resumes it
+ * completes a whole slot before moving the head, so we give up waiting.
+ *
+ * requires thc_mutex
+ */
+static void thc_steer_quiesce(tcp_helper_cluster_t* thc, int instance)
+{
+  struct oo_steer_ring* ring = &thc->thc_steer->ring[instance];
+  unsigned long deadline = jiffies + HZ;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+  while( ! oo_steer_ring_stop(ring) ) {
+    if( time_after(jiffies, deadline) ) {
+      ci_log("%s: %s: instance %d: steering producer did not finish",
+             __FUNCTION__, thc->thc_name, instance);
+      ring->busy = 0;
+      break;
+    }
+    schedule_timeout_uninterruptible(1);
+  }
+}
+
+
+/* Connect a new stack to its ring.
+ *
+ * requires thc_mutex
+ */
+static void thc_steer_attach(tcp_helper_cluster_t* thc,
+                             tcp_helper_resource_t* thr)
+{
+  ci_netif* ni = &thr->netif;
+  int instance = thr->thc_rss_instance;
+  struct oo_steer_ring* ring = &thc->thc_steer->ring[instance];
+  ci_irqlock_state_t lock_flags;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+  ci_assert_lt((unsigned) instance, thc->thc_cluster_size);
+
+  ni->steer_ring_mask = thc->thc_steer_ring_size - 1;
+  ni->steer_n_rings = thc->thc_cluster_size;
+  ni->steer_instance = instance;
+  ni->steer_bytes = thc->thc_steer_bytes;
+  ni->steer = thc->thc_steer;
+  ni->state->steer_mmap_bytes = thc->thc_steer_bytes;
+
+  /* Discard anything left by a previous owner of the ring, once instance 0
+   * can't be adding to it. */
+  thc_steer_quiesce(thc, instance);
+  ring->tail = ring->head;
+  ring->armed = 0;
+  ci_irqlock_lock(&thc->thc_steer_lock, &lock_flags);
+  thc->thc_steer_thr[instance] = thr;
+  ci_irqlock_unlock(&thc->thc_steer_lock, &lock_flags);
+  ci_wmb();
+  ring->live = 1;
+}
+
+
+/* requires thc_mutex */
+static void thc_steer_detach(tcp_helper_cluster_t* thc,
+                             tcp_helper_resource_t* thr)
+{
+  int instance = thr->thc_rss_instance;
+  ci_irqlock_state_t lock_flags;
+
+  ci_assert(mutex_is_locked(&thc_mutex));
+  if( thr->netif.steer == NULL )
+    return;
+
+  thc_steer_quiesce(thc, instance);
+  ci_irqlock_lock(&thc->thc_steer_lock, &lock_flags);
+  thc->thc_steer_thr[instance] = NULL;
+  ci_irqlock_unlock(&thc->thc_steer_lock, &lock_flags);
+  thc->thc_steer_claimed &= ~(1ull << instance);
+  thr->netif.steer = NULL;
+}
+
+
+/* Returns the rss_instance of the stack being allocated in [thc].  Only
+ * valid during tcp_helper_rm_alloc() for a steering cluster. */
+int tcp_helper_cluster_steer_instance(tcp_helper_cluster_t* thc)
+{
+  ci_assert(mutex_is_locked(&thc_mutex));
+  ci_assert(thc->thc_flags & THC_FLAG_STEER);
+  ci_assert_ge(thc->thc_steer_claiming, 0);
+  return thc->thc_steer_claiming;
+}
+
+
+/* Wake the stack with rss_instance [instance] in the cluster of [thr],
+ * which has new packets in its steering ring. */
+int tcp_helper_cluster_steer_kick(tcp_helper_resource_t* thr, int instance)
+{
+  tcp_helper_cluster_t* thc = thr->thc;
+  ci_irqlock_state_t lock_flags;
+
+  if( thc == NULL || ! (thc->thc_flags & THC_FLAG_STEER) ||
+      (unsigned) instance >= thc->thc_cluster_size )
+    return -EINVAL;
+
+  ci_irqlock_lock(&thc->thc_steer_lock, &lock_flags);
+  if( thc->thc_steer_thr[instance] != NULL )
+    tcp_helper_defer_poll_and_prime(thc->thc_steer_thr[instance]);
+  ci_irqlock_unlock(&thc->thc_steer_lock, &lock_flags);
+  return 0;
+}
+#endif
+
+
 /* Remove the thr from the list of stacks tracked by the thc.
  * Remove the thr from the round robin array of stack pointers tracked by the thc.
  *
@@ -483,6 +671,10 @@ static void thc_remove_thr(tcp_helper_cluster_t* thc,
                                                    thc_thr_link, link);
     if( thr_walk == thr ) {
       ci_dllist_remove(link);
+#if CI_CFG_CLUSTER_STEER
+      if( thc->thc_flags & THC_FLAG_STEER )
+        thc_steer_detach(thc, thr);
+#endif
       thr->thc = NULL;
       oo_atomic_dec_and_test(&thc->thc_thr_count);
       ci_assert_ge(oo_atomic_read(&thc->thc_thr_count), 0);
@@ -911,8 +1103,30 @@ static int thc_alloc_thr(tcp_helper_cluster_t* thc,
    * stack did so. TODO should this be configurable? */
   opts->no_hw = 0;
 
+#if CI_CFG_CLUSTER_STEER
+  if( thc->thc_flags & THC_FLAG_STEER ) {
+    if( thc->thc_steer == NULL &&
+        (rc = thc_steer_alloc(thc, opts->cluster_steer_ring)) < 0 ) {
+      kfree(opts);
+      return rc;
+    }
+    if( (rc = thc_steer_claim(thc)) < 0 ) {
+      kfree(opts);
+      return rc;
+    }
+    thc->thc_steer_claiming = rc;
+  }
+#endif
+
   rc = tcp_helper_rm_alloc(&roa, opts, -1, thc, &thr_walk);
   kfree(opts);
+#if CI_CFG_CLUSTER_STEER
+  if( thc->thc_flags & THC_FLAG_STEER ) {
+    if( rc != 0 )
+      thc->thc_steer_claimed &= ~(1ull << thc->thc_steer_claiming);
+    thc->thc_steer_claiming = -1;
+  }
+#endif
   if( rc != 0 )
     return rc;
 
@@ -941,6 +1155,10 @@ static int thc_alloc_thr(tcp_helper_cluster_t* thc,
   thr_walk->thc               = thc;
   if( thc_is_scalable(thr_walk->thc->thc_flags) )
     netif->state->flags |= CI_NETIF_FLAG_SCALABLE_FILTERS_RSS;
+#if CI_CFG_CLUSTER_STEER
+  if( thc->thc_flags & THC_FLAG_STEER )
+    thc_steer_attach(thc, thr_walk);
+#endif
 
   tcp_helper_cluster_ref(thc);
   ci_dllist_push_tail(&thc->thc_thr_list, &thr_walk->thc_thr_link);
@@ -1132,6 +1350,11 @@ static int tcp_helper_cluster_thc_flags(const ci_netif_config_opts* ni_opts)
   int maybe_prealloc_lports = ni_opts->tcp_shared_local_ports_per_ip ?
     0 : THC_FLAG_PREALLOC_LPORTS;
 
+#if CI_CFG_CLUSTER_STEER
+  if( ni_opts->cluster_steer )
+    flags |= THC_FLAG_STEER;
+#endif
+
   /* The remaining flags are only applicable to scalable clusters, i.e. to
    * those that have a MAC filter pointing at their VI set.  If scalable
    * filters are disabled, or if they're not in one of the "rss" modes, then
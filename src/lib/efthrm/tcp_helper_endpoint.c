@@ -53,6 +53,7 @@ tcp_helper_endpoint_ctor(tcp_helper_endpoint_t *ep,
   ep->wakeup_next = 0;
   ep->fasync_queue = NULL;
   ep->ep_aflags = 0;
+  ep->unix_peer = OO_SP_NULL;
   ep->alien_ref = NULL;
   spin_lock_init(&ep->lock);
   oo_os_sock_poll_ctor(&ep->os_sock_poll);
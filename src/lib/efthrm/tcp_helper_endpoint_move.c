@@ -75,6 +75,9 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_ip_timer_pending(ni, &ts->rto_tid) ||
       ci_ip_timer_pending(ni, &ts->zwin_tid) ||
       ci_ip_timer_pending(ni, &ts->cork_tid) ||
+#if CI_CFG_TCP_RACK
+      ci_ip_timer_pending(ni, &ts->rack_tid) ||
+#endif
       OO_PP_NOT_NULL(ts->pmtus) ) {
     if( do_assert ) {
       ci_assert(ci_ip_queue_is_empty(&ts->send));
@@ -84,6 +87,9 @@ static int efab_file_move_supported_tcp(ci_netif *ni, ci_tcp_state *ts,
       ci_assert(! ci_ip_timer_pending(ni, &ts->rto_tid));
       ci_assert(! ci_ip_timer_pending(ni, &ts->zwin_tid));
       ci_assert(! ci_ip_timer_pending(ni, &ts->cork_tid));
+#if CI_CFG_TCP_RACK
+      ci_assert(! ci_ip_timer_pending(ni, &ts->rack_tid));
+#endif
       ci_assert(OO_PP_IS_NULL(ts->pmtus));
     }
     return false;
@@ -142,6 +148,20 @@ static int efab_file_move_supported_udp(ci_netif *ni, ci_udp_state *us,
     }
     return false;
   }
+#if CI_CFG_UDP_SEND_RING
+  if( us->tx_ring_head != us->tx_ring_tail ) {
+    if( do_assert )
+      ci_assert_equal(us->tx_ring_head, us->tx_ring_tail);
+    return false;
+  }
+#endif
+#if CI_CFG_TX_PACING
+  if( OO_PP_NOT_NULL(us->tx_pace_head) ) {
+    if( do_assert )
+      ci_assert(OO_PP_IS_NULL(us->tx_pace_head));
+    return false;
+  }
+#endif
 
   return true;
 }
@@ -328,6 +348,9 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
   mid_s->b.epoll = new_s->b.epoll;
   mid_s->b.ready_lists_in_use = 0;
   mid_s->reap_link = new_s->reap_link;
+#if CI_CFG_TX_PACING
+  mid_s->pace_link = new_s->pace_link;
+#endif
 
   if( tcp_helper_get_user_ns(old_thr) != tcp_helper_get_user_ns(new_thr) ) {
     /* Need to update the UID associated with this socket to be correct
@@ -349,6 +372,9 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     mid_ts->cork_tid = new_ts->cork_tid;
 #if CI_CFG_TCP_SOCK_STATS
     mid_ts->stats_tid = new_ts->stats_tid;
+#endif
+#if CI_CFG_TCP_RACK
+    mid_ts->rack_tid = new_ts->rack_tid;
 #endif
     ci_ip_queue_init(&mid_ts->recv1);
     ci_ip_queue_init(&mid_ts->recv2);
@@ -358,6 +384,7 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
     new_ts->retrans_ptr = OO_PP_NULL;
     mid_ts->tmpl_head = OO_PP_NULL;
     oo_atomic_set(&mid_ts->send_prequeue_in, 0);
+    oo_atomic_set(&mid_ts->send_prequeue_bytes, 0);
 
     *new_ts = *mid_ts;
 #if CI_CFG_FD_CACHING
@@ -520,6 +547,9 @@ int efab_file_move_to_alien_stack(ci_private_t *priv, ci_netif *alien_ni,
 
   link = oo_p_dllink_sb(&old_thr->netif, &old_s->b, &old_s->reap_link);
   oo_p_dllink_del(&old_thr->netif, link);
+#if CI_CFG_TX_PACING
+  ci_tx_pace_cancel(&old_thr->netif, old_s);
+#endif
 
   link = oo_p_dllink_sb(&old_thr->netif, &old_s->b, &old_s->b.post_poll_link);
   oo_p_dllink_del_init(&old_thr->netif, link);
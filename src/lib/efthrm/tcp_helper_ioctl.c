@@ -488,31 +488,29 @@ efab_tcp_helper_sock_attach_to_existing_file(ci_private_t* priv, void *arg)
 #endif
 
 
+/* Create an fd for a socket taken from an accept queue.  Returns the fd, or
+ * a negative error code.
+ */
 static int
-efab_tcp_helper_tcp_accept_sock_attach(ci_private_t* priv, void *arg)
+efab_tcp_helper_tcp_accept_sock_attach_ep(tcp_helper_resource_t* trs,
+                                          oo_sp ep_id, int type)
 {
-  oo_tcp_accept_sock_attach_t* op = arg;
-  tcp_helper_resource_t* trs = priv->thr;
   tcp_helper_endpoint_t* ep = NULL;
   citp_waitable_obj *wo;
   int rc;
   int flags;
-  int sock_type = op->type;
+  int sock_type = type;
   int aflags_saved;
 
-  OO_DEBUG_TCPH(ci_log("%s: ep_id=%d", __FUNCTION__, op->ep_id));
-  if( trs == NULL ) {
-    LOG_E(ci_log("%s: ERROR: not attached to a stack", __FUNCTION__));
-    return -EINVAL;
-  }
+  OO_DEBUG_TCPH(ci_log("%s: ep_id=%d", __FUNCTION__, ep_id));
 
   /* Validate and find the endpoint. */
-  if( ! IS_VALID_SOCK_P(&trs->netif, op->ep_id) ) {
+  if( ! IS_VALID_SOCK_P(&trs->netif, ep_id) ) {
     LOG_E(ci_log("%s: invalid endp", __FUNCTION__));
     return -EINVAL;
   }
 
-  ep = ci_trs_get_valid_ep(trs, op->ep_id);
+  ep = ci_trs_get_valid_ep(trs, ep_id);
   wo = SP_TO_WAITABLE_OBJ(&trs->netif, ep->id);
   ci_assert(wo->waitable.state & CI_TCP_STATE_TCP);
 
@@ -526,7 +524,7 @@ efab_tcp_helper_tcp_accept_sock_attach(ci_private_t* priv, void *arg)
                     CI_SB_AFLAG_O_CLOEXEC | CI_SB_AFLAG_O_NONBLOCK));
 
   flags = efab_tcp_helper_sock_attach_setup_flags(&sock_type);
-  rc = efab_tcp_helper_sock_attach_common(trs, ep, op->type,
+  rc = efab_tcp_helper_sock_attach_common(trs, ep, type,
                                           OO_FDFLAG_EP_TCP, flags);
   if( rc < 0 )
     goto on_error;
@@ -551,8 +549,7 @@ efab_tcp_helper_tcp_accept_sock_attach(ci_private_t* priv, void *arg)
   }
 #endif
 
-  op->fd = rc;
-  return 0;
+  return rc;
 
  on_error:
   /* - accept() does not touch the ep - no need to clear it up;
@@ -565,6 +562,63 @@ efab_tcp_helper_tcp_accept_sock_attach(ci_private_t* priv, void *arg)
 }
 
 
+static int
+efab_tcp_helper_tcp_accept_sock_attach(ci_private_t* priv, void *arg)
+{
+  oo_tcp_accept_sock_attach_t* op = arg;
+  tcp_helper_resource_t* trs = priv->thr;
+  int rc;
+
+  if( trs == NULL ) {
+    LOG_E(ci_log("%s: ERROR: not attached to a stack", __FUNCTION__));
+    return -EINVAL;
+  }
+
+  rc = efab_tcp_helper_tcp_accept_sock_attach_ep(trs, op->ep_id, op->type);
+  if( rc < 0 )
+    return rc;
+  op->fd = rc;
+  return 0;
+}
+
+
+/* As OO_IOC_TCP_ACCEPT_SOCK_ATTACH, for a number of sockets.  Stops at the
+ * first failure, and fails only if no fd has been created.
+ */
+static int
+efab_tcp_helper_tcp_accept_sock_attach_batch(ci_private_t* priv, void *arg)
+{
+  oo_tcp_accept_sock_attach_batch_t* op = arg;
+  tcp_helper_resource_t* trs = priv->thr;
+  oo_sp ep_ids[OO_ACCEPT_BATCH_MAX];
+  ci_int32 fds[OO_ACCEPT_BATCH_MAX];
+  int i, n = op->n, rc = 0;
+
+  if( trs == NULL ) {
+    LOG_E(ci_log("%s: ERROR: not attached to a stack", __FUNCTION__));
+    return -EINVAL;
+  }
+  if( n <= 0 || n > OO_ACCEPT_BATCH_MAX )
+    return -EINVAL;
+  if( copy_from_user(ep_ids, CI_USER_PTR_GET(op->ep_ids),
+                     n * sizeof(ep_ids[0])) )
+    return -EFAULT;
+
+  for( i = 0; i < n; ++i ) {
+    rc = efab_tcp_helper_tcp_accept_sock_attach_ep(trs, ep_ids[i], op->type);
+    if( rc < 0 )
+      break;
+    fds[i] = rc;
+  }
+  op->n = i;
+  if( i == 0 )
+    return rc;
+  if( copy_to_user(CI_USER_PTR_GET(op->fds), fds, i * sizeof(fds[0])) )
+    return -EFAULT;
+  return 0;
+}
+
+
 static int
 efab_tcp_helper_pipe_attach(ci_private_t* priv, void *arg)
 {
@@ -612,6 +666,81 @@ efab_tcp_helper_pipe_attach(ci_private_t* priv, void *arg)
   return 0;
 }
 
+
+static int
+efab_tcp_helper_unix_attach(ci_private_t* priv, void *arg)
+{
+  oo_unix_attach_t* op = arg;
+  tcp_helper_resource_t* trs = priv->thr;
+  tcp_helper_endpoint_t* ep[2];
+  int i, rc;
+
+  OO_DEBUG_TCPH(ci_log("%s: ep_id=%d,%d", __FUNCTION__,
+                       op->ep_id[0], op->ep_id[1]));
+  if( trs == NULL ) {
+    LOG_E(ci_log("%s: ERROR: not attached to a stack", __FUNCTION__));
+    return -EINVAL;
+  }
+
+  /* Validate and find the endpoints. */
+  if( ! IS_VALID_SOCK_P(&trs->netif, op->ep_id[0]) ||
+      ! IS_VALID_SOCK_P(&trs->netif, op->ep_id[1]) ||
+      op->ep_id[0] == op->ep_id[1] )
+    return -EINVAL;
+  for( i = 0; i < 2; ++i ) {
+    citp_waitable_obj* wo;
+    ep[i] = ci_trs_get_valid_ep(trs, op->ep_id[i]);
+    wo = SP_TO_WAITABLE_OBJ(&trs->netif, ep[i]->id);
+    ci_atomic32_and(&wo->waitable.sb_aflags,
+                    ~(CI_SB_AFLAG_ORPHAN | CI_SB_AFLAG_TCP_IN_ACCEPTQ));
+  }
+  ep[0]->unix_peer = ep[1]->id;
+  ep[1]->unix_peer = ep[0]->id;
+
+  /* The OS sockets carry names and ancillary data, which the pipes
+   * cannot. */
+  for( i = 0; i < 2; ++i ) {
+    struct file* os_file = fget(op->os_fd[i]);
+    if( os_file == NULL ) {
+      rc = -EBADF;
+      goto fail;
+    }
+    /* NB. efab_attach_os_socket() consumes [os_file] even on error. */
+    rc = efab_attach_os_socket(ep[i], os_file);
+    if( rc < 0 )
+      goto fail;
+  }
+
+  rc = oo_create_ep_fd(ep[0], op->flags, OO_FDFLAG_EP_UNIX);
+  if( rc < 0 ) {
+    LOG_E(ci_log("%s: ERROR: failed to bind [%d:%d] to fd",
+                 __func__, trs->id, ep[0]->id));
+    goto fail;
+  }
+  op->fd[0] = rc;
+
+  rc = oo_create_ep_fd(ep[1], op->flags, OO_FDFLAG_EP_UNIX);
+  if( rc < 0 ) {
+    LOG_E(ci_log("%s: ERROR: failed to bind [%d:%d] to fd",
+                 __func__, trs->id, ep[1]->id));
+    /* Closing the first socket then frees both pipes. */
+    for( i = 0; i < 2; ++i )
+      tcp_helper_endpoint_set_aflags(ep[i], OO_THR_EP_AFLAG_PEER_CLOSED);
+    efab_linux_sys_close(op->fd[0]);
+    return rc;
+  }
+  op->fd[1] = rc;
+
+  return 0;
+
+ fail:
+  for( i = 0; i < 2; ++i ) {
+    tcp_helper_endpoint_set_aflags(ep[i], OO_THR_EP_AFLAG_PEER_CLOSED);
+    efab_tcp_helper_close_endpoint(trs, ep[i]->id, 0);
+  }
+  return rc;
+}
+
 /*--------------------------------------------------------------------
  *!
  * Entry point from user-mode when the TCP/IP stack requests
@@ -1265,6 +1394,41 @@ static int usermem_release_by_id(tcp_helper_resource_t* trs, ci_uint64 id)
 }
 
 
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+struct oo_zc_unregister_work_data {
+  struct work_struct work;
+  tcp_helper_resource_t* trs;
+  ci_uint64 id;
+};
+
+static void oo_zc_unregister_work(struct work_struct* work)
+{
+  struct oo_zc_unregister_work_data* data =
+            container_of(work, struct oo_zc_unregister_work_data, work);
+
+  usermem_release_by_id(data->trs, data->id);
+  kfree(data);
+}
+
+/* Releases a MSG_ZEROCOPY registration from a context which may not sleep.
+ * Should that fail, the registration lasts until the stack is destroyed,
+ * which also flushes any release still queued. */
+void efab_tcp_helper_zc_unregister_buffers_deferred(tcp_helper_resource_t* trs,
+                                                    ci_uint64 id)
+{
+  struct oo_zc_unregister_work_data* data;
+
+  data = kmalloc(sizeof(*data), GFP_ATOMIC);
+  if( data == NULL )
+    return;
+  INIT_WORK(&data->work, oo_zc_unregister_work);
+  data->trs = trs;
+  data->id = id;
+  queue_work(trs->wq, &data->work);
+}
+#endif
+
+
 static int efab_tcp_helper_zc_register_buffers_rsop(ci_private_t* priv,
                                                     void* arg)
 {
@@ -1560,6 +1724,17 @@ static int oo_af_xdp_kick_rsop(ci_private_t *priv, void *arg)
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+static int oo_cluster_steer_kick_rsop(ci_private_t *priv, void *arg)
+{
+  int instance = *(int32_t*)arg;
+  if( priv->thr == NULL )
+    return -EINVAL;
+  return tcp_helper_cluster_steer_kick(priv->thr, instance);
+}
+#endif
+
+
 /*************************************************************************
  * ATTENTION! ACHTUNG! ATENCION!                                         *
  * This table MUST be synchronised with enum of OO_OP_* operations!      *
@@ -1640,7 +1815,10 @@ oo_operations_table_t oo_operations[] = {
   op(OO_IOC_INSTALL_STACK_BY_ID, efab_tcp_helper_lookup_and_attach_stack),
   op(OO_IOC_SOCK_ATTACH,           efab_tcp_helper_sock_attach ),
   op(OO_IOC_TCP_ACCEPT_SOCK_ATTACH,efab_tcp_helper_tcp_accept_sock_attach ),
+  op(OO_IOC_TCP_ACCEPT_SOCK_ATTACH_BATCH,
+                          efab_tcp_helper_tcp_accept_sock_attach_batch),
   op(OO_IOC_PIPE_ATTACH,       efab_tcp_helper_pipe_attach ),
+  op(OO_IOC_UNIX_ATTACH,       efab_tcp_helper_unix_attach ),
 #if CI_CFG_FD_CACHING
   op(OO_IOC_SOCK_DETACH,       efab_tcp_helper_sock_detach_file),
   op(OO_IOC_SOCK_ATTACH_TO_EXISTING, efab_tcp_helper_sock_attach_to_existing_file),
@@ -1703,6 +1881,9 @@ oo_operations_table_t oo_operations[] = {
 #endif
 
   op(OO_IOC_AF_XDP_KICK, oo_af_xdp_kick_rsop),
+#if CI_CFG_CLUSTER_STEER
+  op(OO_IOC_CLUSTER_STEER_KICK, oo_cluster_steer_kick_rsop),
+#endif
   op(OO_IOC_EFCT_SUPERBUF_CONFIG_REFRESH,oo_efct_superbuf_config_refresh_rsop),
   op(OO_IOC_PKT_BUF_MMAP, oo_pkt_buf_map_rsop),
   op(OO_IOC_DESIGN_PARAMETERS, oo_design_parameters_rsop),
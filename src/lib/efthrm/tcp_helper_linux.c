@@ -205,7 +205,7 @@ static ssize_t linux_tcp_helper_fop_read_iov_pipe(struct file *filp,
   tcp_helper_resource_t* trs = efab_priv_to_thr(priv);
 
   return ci_pipe_read(&trs->netif, SP_TO_PIPE(&trs->netif, priv->sock_id),
-                      iov, iovlen);
+                      iov, iovlen, 0);
 }
 static ssize_t linux_tcp_helper_fop_write_iov_pipe(struct file *filp,
                                                    const struct iovec *iov,
@@ -215,13 +215,27 @@ static ssize_t linux_tcp_helper_fop_write_iov_pipe(struct file *filp,
   tcp_helper_resource_t* trs = efab_priv_to_thr(priv);
 
   return ci_pipe_write(&trs->netif, SP_TO_PIPE(&trs->netif, priv->sock_id),
-                       iov, iovlen);
+                       iov, iovlen, 0);
+}
+/* An AF_UNIX socket reads its own pipe and writes its peer's. */
+static ssize_t linux_tcp_helper_fop_write_iov_unix(struct file *filp,
+                                                   const struct iovec *iov,
+                                                   unsigned long iovlen)
+{
+  ci_private_t* priv = filp->private_data;
+  tcp_helper_resource_t* trs = efab_priv_to_thr(priv);
+  tcp_helper_endpoint_t* ep = ci_trs_ep_get(trs, priv->sock_id);
+
+  return ci_pipe_write(&trs->netif, SP_TO_PIPE(&trs->netif, ep->unix_peer),
+                       iov, iovlen, 0);
 }
 #ifdef EFRM_HAVE_FOP_READ_ITER
 DEFINE_FOP_RW_ITER(linux_tcp_helper_fop_read_iov_pipe, \
                    linux_tcp_helper_fop_read_iter_pipe)
 DEFINE_FOP_RW_ITER(linux_tcp_helper_fop_write_iov_pipe, \
                    linux_tcp_helper_fop_write_iter_pipe)
+DEFINE_FOP_RW_ITER(linux_tcp_helper_fop_write_iov_unix, \
+                   linux_tcp_helper_fop_write_iter_unix)
 #else
 DEFINE_FOP_READ(linux_tcp_helper_fop_read_iov_pipe, \
                 linux_tcp_helper_fop_read_pipe)
@@ -231,6 +245,10 @@ DEFINE_FOP_AIO_RW(linux_tcp_helper_fop_read_iov_pipe, \
                   linux_tcp_helper_fop_aio_read_pipe)
 DEFINE_FOP_AIO_RW(linux_tcp_helper_fop_write_iov_pipe, \
                   linux_tcp_helper_fop_aio_write_pipe)
+DEFINE_FOP_WRITE(linux_tcp_helper_fop_write_iov_unix, \
+                 linux_tcp_helper_fop_write_unix)
+DEFINE_FOP_AIO_RW(linux_tcp_helper_fop_write_iov_unix, \
+                  linux_tcp_helper_fop_aio_write_unix)
 #endif
 
 
@@ -289,6 +307,23 @@ static unsigned linux_tcp_helper_fop_poll_pipe_writer(struct file* filp,
 }
 
 
+static unsigned linux_tcp_helper_fop_poll_unix(struct file* filp,
+                                               poll_table* wait)
+{
+  ci_private_t *priv = filp->private_data;
+  tcp_helper_resource_t* trs = efab_priv_to_thr(priv);
+  tcp_helper_endpoint_t* ep = ci_trs_ep_get(trs, priv->sock_id);
+  struct oo_pipe* rx = SP_TO_PIPE(&trs->netif, ep->id);
+  struct oo_pipe* tx = SP_TO_PIPE(&trs->netif, ep->unix_peer);
+
+  poll_wait(filp, &ep->waitq.wq, wait);
+  poll_wait(filp, &TCP_HELPER_WAITQ(trs, ep->unix_peer)->wq, wait);
+  ci_atomic32_or(&rx->b.wake_request, CI_SB_FLAG_WAKE_RX);
+  ci_atomic32_or(&tx->b.wake_request, CI_SB_FLAG_WAKE_TX);
+  return oo_unix_poll_events(rx, tx);
+}
+
+
 static unsigned efab_linux_tcp_helper_fop_poll_tcp(struct file* filp,
 					    tcp_helper_resource_t* trs,
 					    oo_sp id,
@@ -443,6 +478,55 @@ static int linux_tcp_helper_fop_close_pipe(struct inode* inode,
   return rc;
 }
 
+/* Closes one end of a pipe of an AF_UNIX socketpair, freeing the pipe if
+ * the other end is already closed. */
+static void oo_unix_close_pipe_end(tcp_helper_resource_t* trs,
+                                   tcp_helper_endpoint_t* ep, int shift)
+{
+  unsigned ep_aflags;
+
+  ci_assert_equal(SP_TO_WAITABLE(&trs->netif, ep->id)->state,
+                  CI_TCP_STATE_PIPE);
+
+  ep_aflags = tcp_helper_endpoint_set_aflags(ep, OO_THR_EP_AFLAG_PEER_CLOSED);
+  if( ! (ep_aflags & OO_THR_EP_AFLAG_PEER_CLOSED) ) {
+    struct oo_pipe* p = SP_TO_PIPE(&trs->netif, ep->id);
+    ci_atomic32_or(&p->aflags, CI_PFD_AFLAG_CLOSED << shift);
+    oo_pipe_wake_peer(&trs->netif, p, CI_SB_FLAG_WAKE_RX | CI_SB_FLAG_WAKE_TX);
+  }
+  else {
+    efab_tcp_helper_close_endpoint(trs, ep->id, 0);
+  }
+}
+
+static int linux_tcp_helper_fop_close_unix(struct inode* inode,
+                                           struct file* filp)
+{
+  ci_private_t* priv = filp->private_data;
+  tcp_helper_resource_t* trs = efab_priv_to_thr(priv);
+  tcp_helper_endpoint_t* ep = ci_trs_ep_get(trs, priv->sock_id);
+  int rc;
+
+  OO_DEBUG_TCPH(ci_log("%s:", __FUNCTION__));
+
+  /* The OS socket goes now, rather than with the endpoint, so that any
+   * descriptors queued on it are released as the kernel would release
+   * them. */
+  efab_tcp_helper_drop_os_socket(trs, ep);
+
+  /* The socket is the writer of its peer's pipe, and the reader of its own
+   * pipe, which goes last as it may take the fd's endpoint with it. */
+  oo_unix_close_pipe_end(trs, ci_trs_ep_get(trs, ep->unix_peer),
+                         CI_PFD_AFLAG_WRITER_SHIFT);
+  if( ep->fasync_queue )
+    linux_tcp_helper_fop_fasync(-1, filp, 0);
+  oo_unix_close_pipe_end(trs, ep, CI_PFD_AFLAG_READER_SHIFT);
+
+  rc = oo_fop_release(inode, filp);
+  OO_DEBUG_TCPH(ci_log("%s: rc=%d", __FUNCTION__, rc));
+  return rc;
+}
+
 int linux_tcp_helper_fop_fasync_no_os(int fd, struct file *filp, int mode)
 {
   ci_private_t* priv = filp->private_data;
@@ -1021,6 +1105,29 @@ struct file_operations linux_tcp_helper_fops_pipe_writer =
   CI_STRUCT_MBR(fasync, linux_tcp_helper_fop_fasync),
 };
 
+struct file_operations linux_tcp_helper_fops_unix =
+{
+  CI_STRUCT_MBR(owner, THIS_MODULE),
+#if ! CI_CFG_UL_INTERRUPT_HELPER
+#ifdef EFRM_HAVE_FOP_READ_ITER
+  CI_STRUCT_MBR(read_iter, linux_tcp_helper_fop_read_iter_pipe),
+  CI_STRUCT_MBR(write_iter, linux_tcp_helper_fop_write_iter_unix),
+#else
+  CI_STRUCT_MBR(read, linux_tcp_helper_fop_read_pipe),
+  CI_STRUCT_MBR(write, linux_tcp_helper_fop_write_unix),
+  CI_STRUCT_MBR(aio_read, linux_tcp_helper_fop_aio_read_pipe),
+  CI_STRUCT_MBR(aio_write, linux_tcp_helper_fop_aio_write_unix),
+#endif
+#endif /* ! CI_CFG_UL_INTERRUPT_HELPER */
+  CI_STRUCT_MBR(poll, linux_tcp_helper_fop_poll_unix),
+  CI_STRUCT_MBR(unlocked_ioctl, oo_fop_unlocked_ioctl),
+  CI_STRUCT_MBR(compat_ioctl, oo_fop_compat_ioctl),
+  CI_STRUCT_MBR(mmap, oo_fop_mmap),
+  CI_STRUCT_MBR(open, oo_fop_open),
+  CI_STRUCT_MBR(release,  linux_tcp_helper_fop_close_unix),
+  CI_STRUCT_MBR(fasync, linux_tcp_helper_fop_fasync),
+};
+
 
 /* fixme: function should be optimized for >= 2.6.32 kernel to use
  * poll_schedule_timeout() function. */
@@ -171,10 +171,6 @@ static void
 get_os_ready_list(tcp_helper_resource_t* thr, int ready_list);
 #endif
 
-static void
-efab_tcp_helper_drop_os_socket(tcp_helper_resource_t* trs,
-                               tcp_helper_endpoint_t* ep);
-
 /* Allocate a block of IDs from the pool of ID blocks */
 static int efab_ipid_alloc(efab_ipid_cb_t* ipid);
 
@@ -919,6 +915,13 @@ int tcp_helper_cluster_vi_base(tcp_helper_cluster_t* thc, int hwport)
 }
 
 
+int tcp_helper_cluster_vi_rss(tcp_helper_cluster_t* thc)
+{
+  /* A cluster doing software steering has a single VI in each set. */
+  return thc->thc_cluster_size > 1 && ! (thc->thc_flags & THC_FLAG_STEER);
+}
+
+
 int tcp_helper_vi_hw_rx_loopback_supported(tcp_helper_resource_t* trs,
                                            int hwport)
 {
@@ -1218,12 +1221,20 @@ static int allocate_pd(ci_netif* ni, struct vi_allocate_info* info,
     int hwport = ni->intf_i_to_hwport[info->intf_i];
     ci_assert_ge(hwport, 0);
     info->vi_set = info->cluster->thc_vi_set[hwport];
+#if CI_CFG_CLUSTER_STEER
+    /* With software steering the VI set has a single VI, which belongs to
+     * the instance which receives for the whole cluster.  The others get
+     * VIs of their own. */
+    if( (info->cluster->thc_flags & THC_FLAG_STEER) &&
+        tcp_helper_cluster_steer_instance(info->cluster) != 0 )
+      info->vi_set = NULL;
+#endif
   }
   else {
     info->vi_set = NULL;
   }
 
-  if( info->cluster == NULL || !(nic->flags & NIC_FLAG_SHARED_PD) ) {
+  if( info->vi_set == NULL || !(nic->flags & NIC_FLAG_SHARED_PD) ) {
     rc = efrm_pd_alloc(&info->pd, info->client,
         ((info->ef_vi_flags & EF_VI_RX_PHYS_ADDR) ?
             EFRM_PD_ALLOC_FLAG_PHYS_ADDR_MODE : 0) |
@@ -1782,6 +1793,11 @@ static int allocate_vis(tcp_helper_resource_t* trs,
     vi_rs = tcp_helper_vi(trs, intf_i);
     /* FIXME we should impose vi_set instance top down */
     if( thc ) {
+#if CI_CFG_CLUSTER_STEER
+      if( thc->thc_flags & THC_FLAG_STEER )
+        trs->thc_rss_instance = tcp_helper_cluster_steer_instance(thc);
+      else
+#endif
       trs->thc_rss_instance = efrm_vi_set_get_vi_instance(vi_rs);
       ns->rss_instance = trs->thc_rss_instance;
       ns->cluster_size = thc->thc_cluster_size;
@@ -4434,6 +4450,12 @@ int tcp_helper_rm_alloc(ci_resource_onload_alloc_t* alloc,
 
   ni->opts = *opts;
   ci_netif_config_opts_rangecheck(&ni->opts);
+#if CI_CFG_CLUSTER_STEER
+  /* Set by tcp_helper_cluster.c once the stack has joined its cluster. */
+  ni->steer = NULL;
+  ni->steer_kick_mask = 0;
+#endif
+  ci_tcp_reply_cache_init(ni);
 
   rc = tcp_helper_get_ns_components(&ni->cplane, &rs->filter_ns);
   if( rc != 0 )
@@ -5487,6 +5509,7 @@ tcp_helper_close_cleanup_ep(tcp_helper_resource_t* trs,
                             tcp_helper_endpoint_t* ep)
 {
     tcp_helper_endpoint_clear_aflags(ep, OO_THR_EP_AFLAG_PEER_CLOSED);
+    ep->unix_peer = OO_SP_NULL;
     if( ep->alien_ref != NULL ) {
       fput(ep->alien_ref->_filp);
       ep->alien_ref = NULL;
@@ -6923,6 +6946,16 @@ static void defer_poll_and_prime(tcp_helper_resource_t* trs)
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+/* Called when another stack of the cluster has put packets in this
+ * stack's steering ring. */
+void tcp_helper_defer_poll_and_prime(tcp_helper_resource_t* trs)
+{
+  defer_poll_and_prime(trs);
+}
+#endif
+
+
 static int tcp_helper_wakeup(tcp_helper_resource_t* trs, int intf_i, int budget)
 {
   ci_netif* ni = &trs->netif;
@@ -7446,7 +7479,7 @@ tcp_helper_stop_periodic_work(tcp_helper_resource_t* rs)
  *
  *--------------------------------------------------------------------*/
 
-static void
+void
 efab_tcp_helper_drop_os_socket(tcp_helper_resource_t* trs,
                                tcp_helper_endpoint_t* ep)
 {
@@ -16,6 +16,7 @@
 #include <onload/extensions.h>
 #include <onload/extensions_zc.h>
 #include <onload/extensions_zc_hlrx.h>
+#include <onload/extensions_ring.h>
 
 unsigned int onload_ext_version[] = 
   {ONLOAD_EXT_VERSION_MAJOR,
@@ -147,6 +148,14 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
   return -ENOSYS;
 }
 
+__attribute__((weak))
+int onload_zc_recv_epoll(int epfd, struct onload_zc_mmsg* msgs, int mlen,
+                         struct epoll_event* events, int* n_events,
+                         int timeout, int flags)
+{
+  return -ENOSYS;
+}
+
 __attribute__((weak))
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
@@ -347,3 +356,39 @@ onload_socket_unicast_nonaccel(int domain, int type, int protocol)
   return socket(domain, type, protocol);
 }
 
+__attribute__((weak))
+int
+onload_accept_batch(int fd, int* fds, struct sockaddr_storage* addrs,
+                    int n, int flags)
+{
+  errno = ENOSYS;
+  return -1;
+}
+
+/**************************************************************************/
+
+__attribute__((weak))
+int onload_ring_init(unsigned entries, struct onload_ring* ring,
+                     unsigned flags)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_ring_free(struct onload_ring* ring)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_ring_submit(struct onload_ring* ring)
+{
+  return -ENOSYS;
+}
+
+__attribute__((weak))
+int onload_ring_wait(struct onload_ring* ring, unsigned min_complete,
+                     int timeout)
+{
+  return -ENOSYS;
+}
@@ -15,6 +15,7 @@
 #include <onload/extensions.h>
 #include <onload/extensions_zc.h>
 #include <onload/extensions_zc_hlrx.h>
+#include <onload/extensions_ring.h>
 #include <dlfcn.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -173,6 +174,11 @@ wrap(int, onload_zc_buffer_decref, (int fd, onload_zc_handle buf),
 wrap(int, onload_zc_recv, (int fd, struct onload_zc_recv_args* args),
      (fd, args), -ENOSYS)
 
+wrap(int, onload_zc_recv_epoll, (int epfd, struct onload_zc_mmsg* msgs,
+                                 int mlen, struct epoll_event* events,
+                                 int* n_events, int timeout, int flags),
+     (epfd, msgs, mlen, events, n_events, timeout, flags), -ENOSYS)
+
 wrap(int, onload_zc_send, (struct onload_zc_mmsg* msgs, int mlen, int flags),
      (msgs, mlen, flags), -ENOSYS)
 
@@ -267,3 +273,19 @@ wrap_with_fn(int, onload_socket_unicast_nonaccel,
              (int domain, int type, int protocol),
              (domain, type, protocol), socket)
 
+wrap_with_errno(int, onload_accept_batch,
+                (int fd, int* fds, struct sockaddr_storage* addrs, int n,
+                 int flags),
+                (fd, fds, addrs, n, flags), -1, ENOSYS)
+
+wrap(int, onload_ring_init, (unsigned entries, struct onload_ring* ring,
+                             unsigned flags),
+     (entries, ring, flags), -ENOSYS)
+
+wrap(int, onload_ring_free, (struct onload_ring* ring), (ring), -ENOSYS)
+
+wrap(int, onload_ring_submit, (struct onload_ring* ring), (ring), -ENOSYS)
+
+wrap(int, onload_ring_wait, (struct onload_ring* ring, unsigned min_complete,
+                             int timeout),
+     (ring, min_complete, timeout), -ENOSYS)
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Software flow steering between the stacks of a cluster (EF_CLUSTER_STEER).
+ *
+ * Where the NIC or interface cannot spread a cluster's traffic over its
+ * stacks with RSS, all of it is delivered to the stack with rss_instance 0.
+ * That stack hashes each TCP and UDP flow with the same Toeplitz function
+ * and key that the NIC would use, so that a flow belongs to the same stack
+ * as it would with RSS (and as ci_netif_active_wild_rss_ok() expects), and
+ * copies packets of flows belonging to other stacks into their rings.  The
+ * rings are drained by ci_netif_poll_steer_ring() in the receiving stack.
+ */
+
+#include "ip_internal.h"
+
+#if CI_CFG_CLUSTER_STEER && OO_DO_STACK_POLL
+
+#define LPF "steer "
+
+
+/* Called by instance 0 for each received frame.  Returns true if the packet
+ * has been passed on to (or dropped on behalf of) another stack, in which
+ * case it has been released; otherwise the caller handles it as usual.
+ */
+int ci_netif_steer_rx(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  struct oo_steer_ring* ring;
+  struct oo_steer_slot* slot;
+  ci_ip4_hdr* ip;
+  ci_uint16* ports;
+  unsigned instance, head, ihl;
+  int pre_l3_len;
+
+  ci_assert(ni->steer);
+  ci_assert_equal(ni->steer_instance, 0);
+
+  if( *((ci_uint16*) oo_l3_hdr(pkt) - 1) != CI_ETHERTYPE_IP )
+    return 0;
+  ip = oo_ip_hdr(pkt);
+  if( (ip->ip_protocol != IPPROTO_TCP && ip->ip_protocol != IPPROTO_UDP) ||
+      (ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE)) )
+    return 0;
+  ihl = CI_IP4_IHL(ip);
+  pre_l3_len = oo_pre_l3_len(pkt);
+  if( pre_l3_len + ihl + 4 > pkt->pay_len )
+    return 0;
+
+  ports = (ci_uint16*) ((char*) ip + ihl);
+  instance = ci_netif_active_wild_nic_hash(ni,
+                                   CI_ADDR_FROM_IP4(ip->ip_daddr_be32),
+                                   ports[1],
+                                   CI_ADDR_FROM_IP4(ip->ip_saddr_be32),
+                                   ports[0]) % ni->steer_n_rings;
+  if( instance == 0 ) {
+    CITP_STATS_NETIF_INC(ni, steer_local);
+    return 0;
+  }
+
+  /* Until the stack for this instance exists we handle its flows here,
+   * rather than lose them.  Jumbo and scattered frames are not passed on.
+   */
+  ring = &ni->steer->ring[instance];
+  if( pkt->pay_len > OO_STEER_FRAME_MAX || pkt->n_buffers != 1 ) {
+    CITP_STATS_NETIF_INC(ni, steer_local);
+    return 0;
+  }
+  /* The kernel waits for [busy] to clear before it gives the ring to a new
+   * stack (see oo_steer_ring_stop()). */
+  ring->busy = 1;
+  ci_mb();
+  if( ! ring->live ) {
+    ring->busy = 0;
+    CITP_STATS_NETIF_INC(ni, steer_local);
+    return 0;
+  }
+
+  head = ring->head;
+  if( head - ring->tail > ni->steer_ring_mask ) {
+    LOG_NR(ci_log(LPF "%d: ring %u full", NI_ID(ni), instance));
+    ++ring->n_full;
+    CITP_STATS_NETIF_INC(ni, steer_ring_full);
+  }
+  else {
+    slot = ci_netif_steer_slot(ni, instance, head);
+    memcpy(slot->frame, PKT_START(pkt), pkt->pay_len);
+    slot->len = pkt->pay_len;
+    slot->hwport = ni->state->intf_i_to_hwport[pkt->intf_i];
+    /* The packet is timestamped here, on arrival, rather than when the
+     * other stack gets round to it. */
+    slot->tstamp_frc = IPTIMER_STATE(ni)->frc;
+#if CI_CFG_TIMESTAMPING
+    ci_netif_get_rx_timestamp(ni, pkt);
+    slot->hw_stamp = pkt->hw_stamp;
+#endif
+    ci_wmb();
+    ring->head = head + 1;
+    ni->steer_kick_mask |= 1ull << instance;
+    CITP_STATS_NETIF_INC(ni, steer_tx);
+  }
+  ci_wmb();
+  ring->busy = 0;
+  ci_netif_pkt_release_rx_1ref(ni, pkt);
+  return 1;
+}
+
+
+/* Called by the other instances to fill [pkt] with the frame in [slot],
+ * which is [len] bytes long and arrived on [intf_i].  The packet keeps the
+ * timestamps taken by instance 0, so that SO_TIMESTAMP and the latency
+ * histograms include the time spent in the ring.
+ */
+void ci_netif_steer_pkt_fill(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                             const struct oo_steer_slot* slot,
+                             unsigned len, int intf_i)
+{
+  pkt->pkt_start_off = 0;
+  pkt->intf_i = intf_i;
+  pkt->flags |= CI_PKT_FLAG_RX;
+  pkt->rx_flags |= CI_PKT_RX_FLAG_STEERED;
+  pkt->refcount = 1;
+  pkt->pay_len = len;
+  pkt->tstamp_frc = slot->tstamp_frc;
+#if CI_CFG_TIMESTAMPING
+  pkt->hw_stamp = slot->hw_stamp;
+#endif
+  ++ni->state->n_rx_pkts;
+  memcpy(pkt->dma_start, slot->frame, len);
+  oo_offbuf_init(&pkt->buf, PKT_START(pkt), len);
+}
+
+
+/* Called by instance 0 at the end of a poll: wake any stack which we have
+ * given packets to and which has said that it is not polling.
+ */
+void ci_netif_steer_kick(ci_netif* ni)
+{
+  ci_uint64 mask = ni->steer_kick_mask;
+  ci_int32 instance;
+
+  ni->steer_kick_mask = 0;
+  for( ; mask != 0; mask &= mask - 1 ) {
+    struct oo_steer_ring* ring;
+
+    instance = __builtin_ctzll(mask);
+    ring = &ni->steer->ring[instance];
+    if( ! ring->armed || ! ci_cas32u_succeed(&ring->armed, 1, 0) )
+      continue;
+    CITP_STATS_NETIF_INC(ni, steer_kicks);
+#ifdef __KERNEL__
+    tcp_helper_cluster_steer_kick(netif2tcp_helper_resource(ni), instance);
+#else
+    oo_resource_op(ci_netif_get_driver_handle(ni),
+                   OO_IOC_CLUSTER_STEER_KICK, &instance);
+#endif
+  }
+}
+
+#endif
@@ -714,6 +714,24 @@ int ci_get_sol_socket( ci_netif* netif, ci_sock_cmn* s,
     goto u_out;
 #endif
 
+#ifdef SO_ZEROCOPY
+  case SO_ZEROCOPY:
+    u = !!(s->s_aflags & CI_SOCK_AFLAG_ZEROCOPY);
+    goto u_out;
+#endif
+
+#if CI_CFG_TX_PACING
+  case SO_MAX_PACING_RATE:
+    /* As Linux, 64 bits if there is room, else saturated to 32. */
+    if( (int)*optlen >= (int)sizeof(ci_uint64) ) {
+      memcpy(optval, &s->pace_max_rate, sizeof(ci_uint64));
+      *optlen = sizeof(ci_uint64);
+      break;
+    }
+    u = (int) CI_MIN(s->pace_max_rate, (ci_uint64) ~0u);
+    goto u_out;
+#endif
+
   default: /* Unexpected & known invalid options end up here */
     goto fail_noopt;
   }
@@ -1826,6 +1844,42 @@ int ci_set_sol_socket(ci_netif* netif, ci_sock_cmn* s,
     break;
 #endif
 
+#ifdef SO_ZEROCOPY
+  case SO_ZEROCOPY:
+    /* MSG_ZEROCOPY is implemented for TCP only. */
+    if( ! (s->b.state & CI_TCP_STATE_TCP) ) {
+      rc = -EOPNOTSUPP;
+      goto fail_other;
+    }
+    if( (rc = opt_not_ok(optval, optlen, int)) )
+      goto fail_inval;
+    v = ci_get_optval(optval, optlen);
+    if( v < 0 || v > 1 ) {
+      rc = -EINVAL;
+      goto fail_inval;
+    }
+    if( v )
+      ci_bit_set(&s->s_aflags, CI_SOCK_AFLAG_ZEROCOPY_BIT);
+    else
+      ci_bit_clear(&s->s_aflags, CI_SOCK_AFLAG_ZEROCOPY_BIT);
+    break;
+#endif
+
+#if CI_CFG_TX_PACING
+  case SO_MAX_PACING_RATE:
+    /* Bytes per second, as 64 bits or as 32 bits with ~0U for unlimited. */
+    if( (rc = opt_not_ok(optval, optlen, unsigned)) )
+      goto fail_inval;
+    if( optlen >= sizeof(ci_uint64) ) {
+      memcpy(&s->pace_max_rate, optval, sizeof(ci_uint64));
+    }
+    else {
+      unsigned rate = *(unsigned*) optval;
+      s->pace_max_rate = rate == ~0u ? CI_TX_PACE_RATE_UNLIMITED : rate;
+    }
+    break;
+#endif
+
   default:
     /* SOL_SOCKET options that are defined to fail with ENOPROTOOPT:
      *  SO_TYPE,  CI_SOSNDLOWAT,
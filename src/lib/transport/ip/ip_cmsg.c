@@ -384,9 +384,13 @@ void ci_ip_cmsg_finish(struct cmsg_state* cmsg_state)
 /**
  * Fill in the msg ancillary data buffer with all control messages
  * according to cmsg_flags the user has set beforehand.
+ *
+ * \param gro_size   Non-zero if several datagrams are being returned
+ * together, in which case it is reported with UDP_GRO.
  */
 void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
-                     struct msghdr *msg, int netif_locked, int *p_msg_flags)
+                     struct msghdr *msg, int netif_locked, int *p_msg_flags,
+                     int gro_size)
 {
   unsigned flags = us->s.cmsg_flags;
   struct cmsg_state cmsg_state;
@@ -432,6 +436,10 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
     ip_cmsg_recv_timestamping(ni, pkt, us->s.timestamping_flags, &cmsg_state);
 #endif
 
+  if( gro_size != 0 )
+    ci_put_cmsg(&cmsg_state, IPPROTO_UDP, UDP_GRO, sizeof(gro_size),
+                &gro_size);
+
   ci_ip_cmsg_finish(&cmsg_state);
 }
 
@@ -443,8 +451,11 @@ void ci_ip_cmsg_recv(ci_netif* ni, ci_udp_state* us, const ci_ip_pkt_fmt *pkt,
  *
  * \param info_out    Must be a valid pointer. Contains a pointer to
  * struct in_pktinfo or struct in6_pktinfo.
+ * \param gso_size_out Must be a valid pointer.  Set to the segment size
+ * if UDP_SEGMENT is given, otherwise left unchanged.
  */
-int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
+int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out,
+                    ci_uint16* gso_size_out)
 {
   struct cmsghdr *cmsg;
 
@@ -483,6 +494,15 @@ int ci_ip_cmsg_send(const struct msghdr* msg, void** info_out)
       else
         return -EINVAL;
     }
+    else if( cmsg->cmsg_level == IPPROTO_UDP ) {
+      if( cmsg->cmsg_type == UDP_SEGMENT ) {
+        if( cmsg->cmsg_len != CMSG_LEN(sizeof(ci_uint16)) )
+          return -EINVAL;
+        *gso_size_out = *(ci_uint16*) CMSG_DATA(cmsg);
+      }
+      else
+        return -EINVAL;
+    }
   }
 
   return 0;
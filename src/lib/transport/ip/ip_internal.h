@@ -402,6 +402,14 @@ ci_tcp_ep_mcast_add_del(ci_netif*         ni,
 # define SO_REUSEPORT   15
 #endif
 
+#ifndef UDP_SEGMENT
+# define UDP_SEGMENT    103
+#endif
+
+#ifndef UDP_GRO
+# define UDP_GRO        104
+#endif
+
 #if CI_CFG_TIMESTAMPING
 /* The following value needs to match its counterpart
  * in kernel headers.
@@ -426,6 +434,18 @@ struct oo_sock_extended_err {
 #ifndef SO_EE_ORIGIN_TIMESTAMPING
 #define SO_EE_ORIGIN_TIMESTAMPING 4
 #endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
 
 /* The following value needs to match its counterpart
  * in kernel headers.
@@ -0,0 +1,432 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Reassembly of fragmented UDP datagrams at user level (EF_IP_REASM).
+ *
+ * Each stack has a small table of datagrams under reassembly, keyed on
+ * source, destination, IP identification and protocol.  The fragments of a
+ * datagram are linked through [frag_next] in order of offset, with [buf]
+ * covering each fragment's share of the IP payload.  When they cover the
+ * whole datagram the headers of the first fragment are rewritten to
+ * describe the complete datagram, which is then passed to ci_udp_handle_rx()
+ * as a chain of buffers in the same way as a scattered jumbo frame.
+ *
+ * Fragments that overlap, other than exact duplicates, discard the whole
+ * datagram (RFC 5722).  Incomplete datagrams are discarded after
+ * EF_IP_REASM_TIMEOUT, or to make room for new ones when the table is full
+ * or EF_IP_REASM_MAX_PKTS fragments are held.
+ *
+ * A fragment scattered over several buffers cannot be held in the chain, so
+ * it goes to the kernel, and with it every other fragment of its datagram:
+ * those already held, and those that arrive until the entry expires.
+ */
+
+#include "ip_internal.h"
+
+#if CI_CFG_IP_REASM
+
+#define LPF "reasm "
+
+/* Limit on the fragments of one datagram, so that its UDP checksum can be
+ * computed from an iovec on the stack.  Enough for 64KiB in fragments sized
+ * for the IPv6 minimum MTU. */
+#define CI_IP_REASM_MAX_FRAGS  64
+
+
+void ci_ip_reasm_init(ci_netif* ni)
+{
+  ci_netif_state* nis = ni->state;
+  int i;
+
+  ci_ip_timer_init(ni, &nis->reasm_tid,
+                   oo_ptr_to_statep(ni, &nis->reasm_tid),
+                   "rsmt");
+  nis->reasm_tid.fn = CI_IP_TIMER_NETIF_IP_REASM;
+  nis->reasm_n_pkts = 0;
+  for( i = 0; i < CI_CFG_IP_REASM; ++i ) {
+    nis->reasm[i].frags = OO_PP_NULL;
+    nis->reasm[i].to_kernel = 0;
+  }
+}
+
+
+ci_inline int ci_ip_reasm_in_use(const ci_ip_reasm_entry* e)
+{
+  return OO_PP_NOT_NULL(e->frags) || e->to_kernel;
+}
+
+
+static void ci_ip_reasm_drop(ci_netif* ni, ci_ip_reasm_entry* e)
+{
+  ci_assert(ci_ip_reasm_in_use(e));
+
+  /* Releasing the first fragment releases the rest of the chain. */
+  if( OO_PP_NOT_NULL(e->frags) ) {
+    ni->state->reasm_n_pkts -= e->n_frags;
+    ci_netif_pkt_release_rx(ni, PKT_CHK(ni, e->frags));
+    e->frags = OO_PP_NULL;
+  }
+  e->to_kernel = 0;
+}
+
+
+static void ci_ip_reasm_pass_to_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ci_assert(OO_PP_IS_NULL(pkt->frag_next));
+
+  CITP_STATS_NETIF_INC(ni, ip_reasm_to_kernel);
+  if( ! ci_netif_pkt_pass_to_kernel(ni, pkt) )
+    ci_netif_pkt_release_rx(ni, pkt);
+}
+
+
+/* From now until [e] expires, its datagram is reassembled by the kernel.
+ * Passes it the fragments held so far. */
+static void ci_ip_reasm_to_kernel(ci_netif* ni, ci_ip_reasm_entry* e)
+{
+  oo_pkt_p pp = e->frags;
+
+  LOG_NR(log(LPF "%d: id=%x passed to kernel with %d fragments", NI_ID(ni),
+             (unsigned) e->id, e->n_frags));
+  ni->state->reasm_n_pkts -= e->n_frags;
+  e->frags = OO_PP_NULL;
+  e->n_frags = 0;
+  e->to_kernel = 1;
+
+  while( OO_PP_NOT_NULL(pp) ) {
+    ci_ip_pkt_fmt* frag = PKT_CHK(ni, pp);
+    pp = frag->frag_next;
+    frag->frag_next = OO_PP_NULL;
+    ci_ip_reasm_pass_to_kernel(ni, frag);
+  }
+}
+
+
+/* Returns the entry that will expire first, other than [exclude]. */
+static ci_ip_reasm_entry* ci_ip_reasm_oldest(ci_netif* ni,
+                                             ci_ip_reasm_entry* exclude)
+{
+  ci_ip_reasm_entry* oldest = NULL;
+  ci_ip_reasm_entry* e;
+
+  for( e = ni->state->reasm; e < ni->state->reasm + CI_CFG_IP_REASM; ++e )
+    if( e != exclude && ci_ip_reasm_in_use(e) &&
+        (oldest == NULL || TIME_LT(e->expiry, oldest->expiry)) )
+      oldest = e;
+  return oldest;
+}
+
+
+/* All fragments of [e] have arrived.  Turn them into a single datagram and
+ * deliver it. */
+static void ci_ip_reasm_complete(ci_netif* ni, ci_ip_reasm_entry* e)
+{
+  ci_ip_pkt_fmt* pkt = PKT_CHK(ni, e->frags);
+  ci_ip_pkt_fmt* frag;
+  ci_iovec iov[CI_IP_REASM_MAX_FRAGS];
+  ci_udp_hdr* udp;
+  int i, hdr_len, len = e->len, n_frags = e->n_frags;
+  unsigned csum;
+
+  ci_assert_equal(pkt->pf.ip_reasm.offset, 0);
+  ci_assert_equal(e->bytes, e->len);
+  ci_assert_le(n_frags, CI_IP_REASM_MAX_FRAGS);
+
+  /* The entry no longer holds the fragments. */
+  e->frags = OO_PP_NULL;
+  ni->state->reasm_n_pkts -= n_frags;
+
+  udp = (ci_udp_hdr*) oo_offbuf_ptr(&pkt->buf);
+  if( oo_offbuf_left(&pkt->buf) < sizeof(ci_udp_hdr) ||
+      CI_BSWAP_BE16(udp->udp_len_be16) != len ) {
+    LOG_U(log(LPF "%d: BAD UDP length len=%d first_frag=%d", NI_ID(ni),
+              len, oo_offbuf_left(&pkt->buf)));
+    goto drop;
+  }
+
+  /* Rewrite the headers of the first fragment to describe the whole
+   * datagram. */
+#if CI_CFG_IPV6
+  if( e->is_ip6 ) {
+    ci_ip6_frag_hdr* fh = (ci_ip6_frag_hdr*) (oo_ip6_hdr(pkt) + 1);
+    ci_uint8 next_hdr = fh->next_hdr;
+
+    /* Move the link-layer and IPv6 headers up over the fragment header. */
+    memmove(PKT_START(pkt) + sizeof(*fh), PKT_START(pkt),
+            oo_pre_l3_len(pkt) + sizeof(ci_ip6_hdr));
+    pkt->pkt_start_off += sizeof(*fh);
+    pkt->pkt_eth_payload_off += sizeof(*fh);
+    oo_ip6_hdr(pkt)->next_hdr = next_hdr;
+    oo_ip6_hdr(pkt)->payload_len = CI_BSWAP_BE16(len);
+    hdr_len = sizeof(ci_ip6_hdr);
+  }
+  else
+#endif
+  {
+    ci_ip4_hdr* ip = oo_ip_hdr(pkt);
+    hdr_len = CI_IP4_IHL(ip);
+    if( hdr_len + len > 0xffff ) {
+      LOG_U(log(LPF "%d: BAD datagram length %d", NI_ID(ni), hdr_len + len));
+      goto drop;
+    }
+    ip->ip_frag_off_be16 &= CI_IP4_FRAG_DONT;
+    ip->ip_tot_len_be16 = CI_BSWAP_BE16(hdr_len + len);
+  }
+  pkt->pay_len = oo_pre_l3_len(pkt) + hdr_len + len;
+
+  i = 0;
+  for( frag = pkt; ; frag = PKT_CHK(ni, frag->frag_next) ) {
+    frag->n_buffers = n_frags - i;
+    iov[i].iov_base = oo_offbuf_ptr(&frag->buf);
+    iov[i].iov_len = oo_offbuf_left(&frag->buf);
+    ++i;
+    if( OO_PP_IS_NULL(frag->frag_next) )
+      break;
+  }
+  ci_assert_equal(i, n_frags);
+  iov[0].iov_base = udp + 1;
+  iov[0].iov_len -= sizeof(ci_udp_hdr);
+
+  /* The NIC cannot check the UDP checksum of a fragmented datagram. */
+#if CI_CFG_IPV6
+  if( e->is_ip6 )
+    csum = ci_ip6_udp_checksum(oo_ip6_hdr(pkt), udp, iov, n_frags);
+  else
+#endif
+  if( udp->udp_check_be16 != 0 )
+    csum = ci_udp_checksum(oo_ip_hdr(pkt), udp, iov, n_frags);
+  else
+    csum = 0;  /* RFC768: csum not computed */
+  if( csum != udp->udp_check_be16 ) {
+    CI_UDP_STATS_INC_IN_ERRS(ni);
+    LOG_U(log(LPF "%d: BAD UDP CHECKSUM %04x", NI_ID(ni),
+              (unsigned) udp->udp_check_be16));
+    goto drop;
+  }
+
+  LOG_NR(log(LPF "%d: id=%x len=%d n_frags=%d complete", NI_ID(ni),
+             (unsigned) e->id, len, n_frags));
+  CITP_STATS_NETIF_INC(ni, ip_reasm_ok);
+  pkt->rx_flags |= CI_PKT_RX_FLAG_REASSEMBLED;
+  ci_udp_handle_rx(ni, pkt, udp, len);
+  return;
+
+ drop:
+  CITP_STATS_NETIF_INC(ni, ip_reasm_drops);
+  ci_netif_pkt_release_rx(ni, pkt);
+}
+
+
+/* Called for each received fragment of a UDP datagram.  Consumes [pkt],
+ * and delivers the datagram if this fragment completes it.
+ */
+void ci_ip_reasm_rx(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ci_netif_state* nis = ni->state;
+  ci_ip_reasm_entry* e;
+  ci_ip_reasm_entry* free_e = NULL;
+  ci_ip_pkt_fmt* prev = NULL;
+  ci_ip_pkt_fmt* next = NULL;
+  oo_pkt_p next_p;
+  ci_addr_t saddr, daddr;
+  ci_uint32 id;
+  ci_uint8 protocol, is_ip6 = 0;
+  char* payload;
+  int offset, len, more, l3_len;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert(OO_PP_IS_NULL(pkt->frag_next));
+
+  CITP_STATS_NETIF_INC(ni, ip_reasm_frags);
+  /* The headers are in the first buffer, even if the fragment is
+   * scattered, and [pay_len] covers all of its buffers. */
+  l3_len = pkt->pay_len - oo_pre_l3_len(pkt);
+
+#if CI_CFG_IPV6
+  if( pkt->flags & CI_PKT_FLAG_IS_IP6 ) {
+    ci_ip6_hdr* ip6 = oo_ip6_hdr(pkt);
+    ci_ip6_frag_hdr* fh = (ci_ip6_frag_hdr*) (ip6 + 1);
+    int ip6_paylen = CI_BSWAP_BE16(ip6->payload_len);
+    ci_uint16 frag_off;
+
+    ci_assert_equal(ip6->next_hdr, CI_NEXTHDR_FRAGMENT);
+    if( ip6_paylen < sizeof(*fh) ||
+        sizeof(ci_ip6_hdr) + ip6_paylen > l3_len )
+      goto drop;
+    frag_off = CI_BSWAP_BE16(fh->frag_off);
+    id = fh->frag_id;
+    protocol = fh->next_hdr;
+    offset = frag_off & CI_IP6_OFFSET;
+    more = frag_off & CI_IP6_MF;
+    payload = (char*) (fh + 1);
+    len = ip6_paylen - sizeof(*fh);
+    is_ip6 = 1;
+  }
+  else
+#endif
+  {
+    ci_ip4_hdr* ip = oo_ip_hdr(pkt);
+    int ip_tot_len = CI_BSWAP_BE16(ip->ip_tot_len_be16);
+    int ihl = CI_IP4_IHL(ip);
+
+    if( ihl < sizeof(ci_ip4_hdr) || ip_tot_len < ihl || ip_tot_len > l3_len )
+      goto drop;
+    id = ip->ip_id_be16;
+    protocol = ip->ip_protocol;
+    offset = CI_IP4_FRAG_OFFSET(ip) << 3;
+    more = ip->ip_frag_off_be16 & CI_IP4_FRAG_MORE;
+    payload = (char*) ip + ihl;
+    len = ip_tot_len - ihl;
+  }
+
+  /* All but the last fragment must be a multiple of 8 bytes. */
+  if( protocol != IPPROTO_UDP || len == 0 || (more && (len & 7)) ||
+      offset + len > 0xffff )
+    goto drop;
+
+  saddr = RX_PKT_SADDR(pkt);
+  daddr = RX_PKT_DADDR(pkt);
+
+  for( e = nis->reasm; e < nis->reasm + CI_CFG_IP_REASM; ++e ) {
+    if( ! ci_ip_reasm_in_use(e) ) {
+      if( free_e == NULL )
+        free_e = e;
+    }
+    else if( e->id == id && e->protocol == protocol && e->is_ip6 == is_ip6 &&
+             CI_IPX_ADDR_EQ(e->saddr, saddr) &&
+             CI_IPX_ADDR_EQ(e->daddr, daddr) ) {
+      break;
+    }
+  }
+
+  if( e == nis->reasm + CI_CFG_IP_REASM ) {
+    if( free_e == NULL ) {
+      free_e = ci_ip_reasm_oldest(ni, NULL);
+      CITP_STATS_NETIF_INC(ni, ip_reasm_evictions);
+      ci_ip_reasm_drop(ni, free_e);
+    }
+    e = free_e;
+    e->saddr = saddr;
+    e->daddr = daddr;
+    e->id = id;
+    e->protocol = protocol;
+    e->is_ip6 = is_ip6;
+    e->to_kernel = 0;
+    e->n_frags = 0;
+    e->len = -1;
+    e->bytes = 0;
+    e->expiry = ci_ip_time_now(ni) + NI_CONF(ni).tconst_ip_reasm;
+    if( ! ci_ip_timer_pending(ni, &nis->reasm_tid) )
+      ci_ip_timer_set(ni, &nis->reasm_tid, e->expiry);
+  }
+
+  if( pkt->n_buffers != 1 && ! e->to_kernel )
+    ci_ip_reasm_to_kernel(ni, e);
+  if( e->to_kernel ) {
+    ci_ip_reasm_pass_to_kernel(ni, pkt);
+    return;
+  }
+
+  /* Find where this fragment goes in the chain. */
+  for( next_p = e->frags; OO_PP_NOT_NULL(next_p); next_p = prev->frag_next ) {
+    next = PKT_CHK(ni, next_p);
+    if( next->pf.ip_reasm.offset >= offset )
+      break;
+    prev = next;
+    next = NULL;
+  }
+
+  if( next != NULL && next->pf.ip_reasm.offset == offset &&
+      oo_offbuf_left(&next->buf) == len &&
+      ! more == (e->len == offset + len) ) {
+    LOG_NR(log(LPF "%d: id=%x offset=%d len=%d duplicate", NI_ID(ni),
+               (unsigned) id, offset, len));
+    CITP_STATS_NETIF_INC(ni, ip_reasm_drops);
+    ci_netif_pkt_release_rx(ni, pkt);
+    return;
+  }
+
+  if( (prev != NULL &&
+       prev->pf.ip_reasm.offset + oo_offbuf_left(&prev->buf) > offset) ||
+      (next != NULL && offset + len > next->pf.ip_reasm.offset) ||
+      (! more && next != NULL) ||
+      (e->len >= 0 && (! more || offset + len > e->len)) ) {
+    LOG_U(log(LPF "%d: id=%x offset=%d len=%d overlaps", NI_ID(ni),
+              (unsigned) id, offset, len));
+    CITP_STATS_NETIF_INC(ni, ip_reasm_overlaps);
+    if( OO_PP_NOT_NULL(e->frags) )
+      ci_ip_reasm_drop(ni, e);
+    ci_netif_pkt_release_rx(ni, pkt);
+    return;
+  }
+
+  while( nis->reasm_n_pkts >= NI_OPTS(ni).ip_reasm_max_pkts ) {
+    ci_ip_reasm_entry* victim = ci_ip_reasm_oldest(ni, e);
+    CITP_STATS_NETIF_INC(ni, ip_reasm_evictions);
+    if( victim == NULL ) {
+      /* This datagram alone is over the limit. */
+      ci_ip_reasm_drop(ni, e);
+      ci_netif_pkt_release_rx(ni, pkt);
+      return;
+    }
+    ci_ip_reasm_drop(ni, victim);
+  }
+
+  pkt->pf.ip_reasm.offset = offset;
+  oo_offbuf_init(&pkt->buf, payload, len);
+  pkt->frag_next = next_p;
+  if( prev != NULL )
+    prev->frag_next = OO_PKT_P(pkt);
+  else
+    e->frags = OO_PKT_P(pkt);
+  ++e->n_frags;
+  ++nis->reasm_n_pkts;
+  e->bytes += len;
+  if( ! more )
+    e->len = offset + len;
+
+  if( e->bytes == e->len )
+    ci_ip_reasm_complete(ni, e);
+  else if( e->n_frags == CI_IP_REASM_MAX_FRAGS ) {
+    LOG_U(log(LPF "%d: id=%x too many fragments", NI_ID(ni),
+              (unsigned) id));
+    CITP_STATS_NETIF_INC(ni, ip_reasm_drops);
+    ci_ip_reasm_drop(ni, e);
+  }
+  return;
+
+ drop:
+  LOG_U(log(LPF "%d: BAD fragment "PKT_DBG_FMT, NI_ID(ni), PKT_DBG_ARGS(pkt)));
+  CITP_STATS_NETIF_INC(ni, ip_reasm_drops);
+  ci_netif_pkt_release_rx(ni, pkt);
+}
+
+
+void ci_ip_reasm_timeout(ci_netif* ni)
+{
+  ci_netif_state* nis = ni->state;
+  ci_iptime_t now = ci_ip_time_now(ni);
+  ci_ip_reasm_entry* e;
+  ci_ip_reasm_entry* next = NULL;
+
+  for( e = nis->reasm; e < nis->reasm + CI_CFG_IP_REASM; ++e ) {
+    if( ! ci_ip_reasm_in_use(e) )
+      continue;
+    if( TIME_LE(e->expiry, now) ) {
+      if( ! e->to_kernel ) {
+        LOG_NR(log(LPF "%d: id=%x timed out with %d/%d bytes", NI_ID(ni),
+                   (unsigned) e->id, e->bytes, e->len));
+        CITP_STATS_NETIF_INC(ni, ip_reasm_timeouts);
+      }
+      ci_ip_reasm_drop(ni, e);
+    }
+    else if( next == NULL || TIME_LT(e->expiry, next->expiry) ) {
+      next = e;
+    }
+  }
+
+  if( next != NULL )
+    ci_ip_timer_set(ni, &nis->reasm_tid, next->expiry);
+}
+
+#endif /* CI_CFG_IP_REASM */
@@ -19,20 +19,19 @@
 
 
 #if OO_DO_STACK_POLL
-void ci_ip_send_pkt_lookup(ci_netif* ni,
-                           const struct oo_sock_cplane* sock_cp_opt,
-                           ci_ip_pkt_fmt* pkt,
-                           ci_ip_cached_hdrs* ipcache)
+static void ci_ip_send_pkt_lookup_key(const struct oo_sock_cplane* sock_cp_opt,
+                                      ci_ip_pkt_fmt* pkt,
+                                      ci_ip_cached_hdrs* ipcache,
+                                      struct oo_sock_cplane* sock_cp)
 {
   int af = ipcache_af(ipcache);
-  struct oo_sock_cplane sock_cp;
 
   if( sock_cp_opt != NULL )
-    sock_cp = *sock_cp_opt;
+    *sock_cp = *sock_cp_opt;
   else
-    oo_sock_cplane_init(&sock_cp);
+    oo_sock_cplane_init(sock_cp);
 
-  sock_cp.laddr = TX_PKT_SADDR(af,pkt);
+  sock_cp->laddr = TX_PKT_SADDR(af,pkt);
 
   ci_assert(!CI_IPX_ADDR_IS_ANY(TX_PKT_SADDR(af, pkt)));
   ci_assert(!CI_IPX_ADDR_IS_ANY(TX_PKT_DADDR(af, pkt)));
@@ -41,19 +40,100 @@ void ci_ip_send_pkt_lookup(ci_netif* ni,
   switch( TX_PKT_PROTOCOL(af, pkt) ) {
   case IPPROTO_UDP:
   case IPPROTO_TCP:
-    sock_cp.lport_be16 = TX_PKT_SPORT_BE16(pkt);
+    sock_cp->lport_be16 = TX_PKT_SPORT_BE16(pkt);
     ipcache->dport_be16 = TX_PKT_DPORT_BE16(pkt);
     break;
   default:
-    sock_cp.lport_be16 = 0;
+    sock_cp->lport_be16 = 0;
     ipcache->dport_be16 = 0;
     break;
   }
+}
 
+
+void ci_ip_send_pkt_lookup(ci_netif* ni,
+                           const struct oo_sock_cplane* sock_cp_opt,
+                           ci_ip_pkt_fmt* pkt,
+                           ci_ip_cached_hdrs* ipcache)
+{
+  struct oo_sock_cplane sock_cp;
+
+  ci_ip_send_pkt_lookup_key(sock_cp_opt, pkt, ipcache, &sock_cp);
   cicp_user_retrieve(ni, ipcache, &sock_cp);
 }
 
 
+void ci_tcp_reply_pkt_lookup(ci_netif* ni,
+                             const struct oo_sock_cplane* sock_cp_opt,
+                             ci_ip_pkt_fmt* pkt,
+                             ci_ip_cached_hdrs* ipcache)
+{
+  struct oo_sock_cplane sock_cp;
+
+  ci_ip_send_pkt_lookup_key(sock_cp_opt, pkt, ipcache, &sock_cp);
+  ci_tcp_reply_retrieve(ni, ipcache, &sock_cp);
+}
+
+
+#if CI_CFG_TCP_REPLY_CACHE_SIZE
+/* As cicp_user_retrieve(), but for SYN-ACKs and RSTs sent on behalf of a
+ * listening socket.  A SYN flood or a port scan sends many replies to a
+ * handful of remote addresses, so we keep the result of the route lookup
+ * for each (sock_cp, raddr).
+ *
+ * The route depends on the remote port only when the interface is a bond
+ * that hashes on layer 4, so those routes are not cached.  Everything else
+ * in the ipcache is a function of [sock_cp] and the remote address, and is
+ * valid for as long as the fwd table entry it came from.
+ *
+ * The ipcache is also the header template for the reply.  There are no
+ * checksums to carry over from one reply to the next: the headers are
+ * built with zero checksums, which the NIC or oo_pkt_calc_checksums()
+ * fills in at send time.
+ */
+void ci_tcp_reply_retrieve(ci_netif* ni, ci_ip_cached_hdrs* ipcache,
+                           const struct oo_sock_cplane* sock_cp)
+{
+  ci_addr_t raddr = ipcache_raddr(ipcache);
+  ci_uint16 dport_be16 = ipcache->dport_be16;
+  ci_uint8 protocol = ipcache_protocol(ipcache);
+  ci_tcp_reply_cache_entry* e;
+  unsigned h;
+
+  ci_assert(ci_netif_is_locked(ni));
+  CI_BUILD_ASSERT(CI_IS_POW2(CI_CFG_TCP_REPLY_CACHE_SIZE));
+
+  h = onload_hash3(sock_cp->laddr, sock_cp->lport_be16, raddr, 0,
+                   IPPROTO_TCP);
+  e = &ni->tcp_reply_cache[h & (CI_CFG_TCP_REPLY_CACHE_SIZE - 1)];
+
+  if( e->ipcache.status == retrrc_success &&
+      ipcache_af(&e->ipcache) == ipcache_af(ipcache) &&
+      CI_IPX_ADDR_EQ(ipcache_raddr(&e->ipcache), raddr) &&
+      /* Differences in padding can only cost us a miss. */
+      memcmp(&e->sock_cp, sock_cp, sizeof(*sock_cp)) == 0 &&
+      oo_cp_ipcache_is_valid(ni, &e->ipcache) ) {
+    *ipcache = e->ipcache;
+    ipcache->dport_be16 = dport_be16;
+    ipcache_protocol(ipcache) = protocol;
+    CITP_STATS_NETIF_INC(ni, tcp_reply_cache_hits);
+    return;
+  }
+
+  CITP_STATS_NETIF_INC(ni, tcp_reply_cache_misses);
+  cicp_user_retrieve(ni, ipcache, sock_cp);
+  if( ipcache->status == retrrc_success
+#if CI_CFG_TEAMING
+      && ! (ipcache->encap.type & CICP_LLAP_TYPE_USES_HASH)
+#endif
+      ) {
+    e->sock_cp = *sock_cp;
+    e->ipcache = *ipcache;
+  }
+}
+#endif
+
+
 void ci_ip_send_pkt_defer(ci_netif* ni, const struct oo_sock_cplane* sock_cp,
                           cicpos_retrieve_rc_t retrieve_rc,
                           ci_uerr_t *ref_os_rc, ci_ip_pkt_fmt* pkt,
@@ -60,6 +60,14 @@ extern void ci_ip_send_pkt_lookup(ci_netif* ni,
                                   ci_ip_pkt_fmt* pkt,
                                   ci_ip_cached_hdrs* ipcache) CI_HF;
 
+/* As ci_ip_send_pkt_lookup(), for a SYN-ACK or RST sent on behalf of a
+ * listening socket.  Uses the stack's reply route cache.
+ */
+extern void ci_tcp_reply_pkt_lookup(ci_netif* ni,
+                                    const struct oo_sock_cplane* sock_cp_opt,
+                                    ci_ip_pkt_fmt* pkt,
+                                    ci_ip_cached_hdrs* ipcache) CI_HF;
+
 /* Second half of split version of ci_ip_send_pkt(). */
 extern int
 ci_ip_send_pkt_send(ci_netif* ni, const struct oo_sock_cplane* sock_cp_opt,
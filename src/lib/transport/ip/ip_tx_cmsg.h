@@ -241,5 +241,39 @@ static inline int ci_ip_tx_timestamping_to_cmsg(int proto, ci_netif* ni,
 
   return rc;
 }
+
+
+/* Puts a MSG_ZEROCOPY completion notification for sends [lo] to [hi] in the
+ * format used by Linux. */
+static inline void ci_ip_zerocopy_to_cmsg(ci_sock_cmn* s,
+                                          struct cmsg_state* cmsg_state,
+                                          ci_uint32 lo, ci_uint32 hi,
+                                          int copied)
+{
+  struct {
+    struct oo_sock_extended_err ee;
+    union {
+      struct sockaddr_in        offender;
+#if CI_CFG_IPV6
+      struct sockaddr_in6       offender6;
+#endif
+    };
+  } __attribute__((packed, aligned(sizeof(ci_uint32)))) errhdr;
+
+  memset(&errhdr, 0, sizeof(errhdr));
+  errhdr.ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+  errhdr.ee.ee_code = copied ? SO_EE_CODE_ZEROCOPY_COPIED : 0;
+  errhdr.ee.ee_info = lo;
+  errhdr.ee.ee_data = hi;
+
+#if CI_CFG_IPV6
+  if( IS_AF_INET6(s->domain) )
+    ci_put_cmsg(cmsg_state, SOL_IPV6, IPV6_RECVERR,
+                sizeof(errhdr.ee) + sizeof(errhdr.offender6), &errhdr);
+  else
+#endif
+    ci_put_cmsg(cmsg_state, SOL_IP, IP_RECVERR,
+                sizeof(errhdr.ee) + sizeof(errhdr.offender), &errhdr);
+}
 #endif
 #endif
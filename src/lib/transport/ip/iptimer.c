@@ -336,12 +336,29 @@ static void ci_ip_timer_docallback(ci_netif *netif, ci_ip_timer* ts)
     sp = oo_statep_to_sockp(netif, ts->statep);
     ci_tcp_timeout_cork(netif, SP_TO_TCP(netif, sp));
     break;
+#if CI_CFG_TCP_RACK
+  case CI_IP_TIMER_TCP_RACK:
+    sp = oo_statep_to_sockp(netif, ts->statep);
+    CHECK_TS(netif, SP_TO_TCP(netif, sp));
+    ci_tcp_timeout_rack(netif, SP_TO_TCP(netif, sp));
+    break;
+#endif
   case CI_IP_TIMER_NETIF_TCP_RECYCLE:
     ci_ip_timer_do_recycle(netif);
     break;
   case CI_IP_TIMER_NETIF_TIMEOUT:
     ci_netif_timeout_state(netif);
     break;
+#if CI_CFG_IP_REASM
+  case CI_IP_TIMER_NETIF_IP_REASM:
+    ci_ip_reasm_timeout(netif);
+    break;
+#endif
+#if CI_CFG_TX_PACING
+  case CI_IP_TIMER_NETIF_TX_PACE:
+    ci_tx_pace_timeout(netif);
+    break;
+#endif
   case CI_IP_TIMER_PMTU_DISCOVER:
   {
     oo_p pmtu_p = ts->statep;
@@ -582,8 +599,17 @@ static const char* ci_ip_timer_dump(const ci_ip_timer* ts)
     MAKECASE(CI_IP_TIMER_TCP_KALIVE,   "kalive")
     MAKECASE(CI_IP_TIMER_TCP_LISTEN,   "listen")
     MAKECASE(CI_IP_TIMER_TCP_CORK,     "cork")
+#if CI_CFG_TCP_RACK
+    MAKECASE(CI_IP_TIMER_TCP_RACK,     "rack")
+#endif
     MAKECASE(CI_IP_TIMER_NETIF_TIMEOUT, "netif")
     MAKECASE(CI_IP_TIMER_PMTU_DISCOVER, "pmtu")
+#if CI_CFG_IP_REASM
+    MAKECASE(CI_IP_TIMER_NETIF_IP_REASM, "reasm")
+#endif
+#if CI_CFG_TX_PACING
+    MAKECASE(CI_IP_TIMER_NETIF_TX_PACE, "pace")
+#endif
 #if CI_CFG_SUPPORT_STATS_COLLECTION
     MAKECASE(CI_IP_TIMER_TCP_STATS,     "tcp-stats")
     MAKECASE(CI_IP_TIMER_NETIF_STATS,   "ni-stats")
@@ -11,7 +11,10 @@ LIB_SRCS	:=		\
 		netif_table.c	\
 		netif_table_ip6.c	\
 		netif_pkt.c	\
+		cluster_steer.c	\
 		tcp_misc.c	\
+		tcp_cong.c	\
+		tcp_rack.c	\
 		tcp_rx.c	\
 		tcp_sleep.c	\
 		tcp_synrecv.c	\
@@ -24,6 +27,8 @@ LIB_SRCS	:=		\
 		ip_tx.c		\
 		udp.c		\
 		udp_rx.c	\
+		ip_reasm.c	\
+		tx_pacing.c	\
 		udp_connect.c	\
 		udp_misc.c	\
 		icmp_send.c	\
@@ -53,7 +58,8 @@ LIB_SRCS	:=		\
 		active_wild.c	\
 		pkt_checksum.c	\
 		netif_dtor.c	\
-		ringbuffer.c
+		ringbuffer.c	\
+		tcpdump_filter.c
 
 ifneq ($(DRIVER),1)
 LIB_SRCS	+=		\
@@ -201,12 +201,16 @@ static void record_rx_timestamp(ci_netif* netif, ci_netif_state_nic_t* nsn,
       OO_PKT_FMT(pkt), (long)stamp.tv_sec, stamp.tv_nsec, sync_flags));
 }
 
-static void get_rx_timestamp(ci_netif* netif, ci_ip_pkt_fmt* pkt)
+void ci_netif_get_rx_timestamp(ci_netif* netif, ci_ip_pkt_fmt* pkt)
 {
 #if CI_CFG_TIMESTAMPING
   ci_netif_state_nic_t* nsn = &netif->state->nic[pkt->intf_i];
   ef_vi* vi = ci_netif_vi(netif, pkt->intf_i);
 
+  /* A steered packet has no RX prefix; it came with its timestamp. */
+  if( pkt->rx_flags & CI_PKT_RX_FLAG_STEERED )
+    return;
+
   if( (vi->nic_type.arch != EF_VI_ARCH_EFCT) &&
       (nsn->oo_vi_flags & OO_VI_FLAGS_RX_HW_TS_EN) ) {
     unsigned sync_flags;
@@ -272,7 +276,8 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
   if( CI_UNLIKELY(rand() < NI_OPTS(netif).rx_drop_rate) )  goto drop;
 #endif
 
-  pkt->tstamp_frc = IPTIMER_STATE(netif)->frc;
+  if(CI_LIKELY( ~pkt->rx_flags & CI_PKT_RX_FLAG_STEERED ))
+    pkt->tstamp_frc = IPTIMER_STATE(netif)->frc;
 
   /* Is this an IP packet? */
   if(CI_LIKELY( ether_type == CI_ETHERTYPE_IP )) {
@@ -329,7 +334,7 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
       ** for the IP header.  The ULP is expected to notice...
       */
 
-      get_rx_timestamp(netif, pkt);
+      ci_netif_get_rx_timestamp(netif, pkt);
 
       if( oo_tcpdump_check(netif, pkt, pkt->intf_i) )
         oo_tcpdump_dump_pkt(netif, pkt);
@@ -349,6 +354,19 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
       LOG_FL(unexpected_rx_log_flag(pkt),
              CI_RLLOG(10, LPF "IGNORE IP protocol=%d", (int) ip->ip_protocol));
     }
+#if CI_CFG_IP_REASM
+    else if( NI_OPTS(netif).ip_reasm && ip->ip_protocol == IPPROTO_UDP &&
+             (ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE)) &&
+             (~pkt->rx_flags & CI_PKT_RX_FLAG_RX_SHARED) ) {
+      ci_netif_get_rx_timestamp(netif, pkt);
+
+      if( oo_tcpdump_check(netif, pkt, pkt->intf_i) )
+        oo_tcpdump_dump_pkt(netif, pkt);
+
+      ci_ip_reasm_rx(netif, pkt);
+      return;
+    }
+#endif
     else if( ~pkt->rx_flags & CI_PKT_RX_FLAG_RX_SHARED ) {
       /*! \todo IP slow path.  Don't want to deal with this yet.
        * 
@@ -396,7 +414,7 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
 
     CI_IP_STATS_INC_IN6_RECVS( netif );
 
-    get_rx_timestamp(netif, pkt);
+    ci_netif_get_rx_timestamp(netif, pkt);
 
     if( oo_tcpdump_check(netif, pkt, pkt->intf_i) )
       oo_tcpdump_dump_pkt(netif, pkt);
@@ -413,6 +431,15 @@ static void handle_rx_pkt(ci_netif* netif, struct ci_netif_poll_state* ps,
       CI_IP_STATS_INC_IN6_DELIVERS( netif );
       return;
     }
+#if CI_CFG_IP_REASM
+    else if( ip6_hdr->next_hdr == CI_NEXTHDR_FRAGMENT &&
+             NI_OPTS(netif).ip_reasm &&
+             ((ci_ip6_frag_hdr*) payload)->next_hdr == IPPROTO_UDP &&
+             (~pkt->rx_flags & CI_PKT_RX_FLAG_RX_SHARED) ) {
+      ci_ip_reasm_rx(netif, pkt);
+      return;
+    }
+#endif
 
     CI_IP_STATS_INC_IN6_DISCARDS( netif );
 
@@ -728,6 +755,11 @@ ci_inline void __handle_rx_pkt(ci_netif* ni, struct ci_netif_poll_state* ps,
 #endif
     if( oo_xdp_check_pkt(ni, pkt) ) {
       ci_parse_rx_vlan(*pkt);
+#if CI_CFG_CLUSTER_STEER
+      if( ni->steer != NULL && ni->steer_instance == 0 &&
+          ci_netif_steer_rx(ni, *pkt) )
+        return;
+#endif
       handle_rx_pkt(ni, ps, *pkt);
     }
   }
@@ -771,6 +803,10 @@ ci_inline int handle_rx_pre_future(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     void* payload = (char*)ip + hdr_size;
 
     if( ip_payload_offset > valid_bytes ||
+#if CI_CFG_IP_REASM
+        (NI_OPTS(ni).ip_reasm &&
+         (ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE))) ||
+#endif
         (hdr_size > sizeof(ci_ip4_hdr) &&
          ci_ip_options_parse(ni, ip, hdr_size)) )
       goto no_future;
@@ -780,7 +816,7 @@ ci_inline int handle_rx_pre_future(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     pkt->flags &=~ CI_PKT_FLAG_IS_IP6;
 #endif
 
-    get_rx_timestamp(ni, pkt);
+    ci_netif_get_rx_timestamp(ni, pkt);
 
     if( ip->ip_protocol == IPPROTO_TCP ) {
       CI_IPV4_STATS_INC_IN_DELIVERS( ni );
@@ -1209,10 +1245,9 @@ static void discard_rx_multi_pkts(ci_netif* ni, struct ci_netif_poll_state* ps,
     CITP_STATS_NETIF_INC(ni, rx_discard_other);
 
   if( !handled ) {
-    if( oo_tcpdump_check(ni, pkt, pkt->intf_i) ) {
-        pkt->pay_len = frame_len;
-        oo_tcpdump_dump_pkt(ni, pkt);
-    }
+    pkt->pay_len = frame_len;
+    if( oo_tcpdump_check(ni, pkt, pkt->intf_i) )
+      oo_tcpdump_dump_pkt(ni, pkt);
 
     ci_netif_pkt_release_rx_1ref(ni, pkt);
   }
@@ -1412,15 +1447,14 @@ static void __handle_rx_discard(ci_netif* ni, struct ci_netif_poll_state* ps,
 
   if( !handled ) {
     /* Only dump the packet if the NIC actually delivered it */
+    pkt->pay_len = frame_len;
     if( (discard_type == EF_EVENT_RX_DISCARD_CSUM_BAD ||
          discard_type == EF_EVENT_RX_DISCARD_MCAST_MISMATCH ||
          discard_type == EF_EVENT_RX_DISCARD_CRC_BAD ||
          discard_type == EF_EVENT_RX_DISCARD_TRUNC ||
          discard_type == EF_EVENT_RX_DISCARD_OTHER) &&
-        oo_tcpdump_check(ni, pkt, pkt->intf_i) ) {
-        pkt->pay_len = frame_len;
-        oo_tcpdump_dump_pkt(ni, pkt);
-    }
+        oo_tcpdump_check(ni, pkt, pkt->intf_i) )
+      oo_tcpdump_dump_pkt(ni, pkt);
 
     ci_netif_pkt_release_rx_1ref(ni, pkt);
   }
@@ -1692,6 +1726,10 @@ static void ci_netif_rx_pkt_complete_tcp(ci_netif* ni,
         ci_tcp_wake_possibly_not_in_poll(ni, ts, CI_SB_FLAG_WAKE_RX);
       }
     }
+    /* If the socket dropped the packet while the NIC was reading it then
+     * its MSG_ZEROCOPY pages can only be released now. */
+    if( pkt->refcount == 1 )
+      ci_tcp_zerocopy_release(ni, NULL, pkt);
   }
 #endif
   ci_netif_pkt_release_in_poll(ni, pkt, ps);
@@ -2309,6 +2347,84 @@ void ci_netif_loopback_pkts_send(ci_netif* ni)
 }
 
 
+#if CI_CFG_CLUSTER_STEER
+/* Largest frame which fits in a single packet buffer. */
+#define STEER_RX_MAX_LEN \
+  (CI_CFG_PKT_BUF_SIZE - CI_MEMBER_OFFSET(ci_ip_pkt_fmt, dma_start))
+
+/* Handle packets which instance 0 of our cluster has passed to this stack
+ * (EF_CLUSTER_STEER).  When the ring is empty, ask instance 0 to wake us
+ * when it next adds to it.  Returns the number of packets handled.
+ */
+static int ci_netif_poll_steer_ring(ci_netif* ni)
+{
+  struct oo_steer_ring* ring = &ni->steer->ring[ni->steer_instance];
+  struct ci_netif_poll_state ps;
+  ci_uint32 head, tail = ring->tail;
+  int n = 0;
+
+  ci_assert(ci_netif_is_locked(ni));
+  ci_assert_gt(ni->steer_instance, 0);
+  ps.tx_pkt_free_list_insert = &ps.tx_pkt_free_list;
+  ps.tx_pkt_free_list_n = 0;
+
+  while( 1 ) {
+    head = ring->head;
+    if( head == tail ) {
+      if( ring->armed )
+        break;
+      ring->armed = 1;
+      ci_mb();
+      continue;
+    }
+    if( n > ni->steer_ring_mask ) {
+      /* Instance 0 is keeping up with us; come back after the unlock. */
+      ef_eplock_holder_set_flag(&ni->state->lock, CI_EPLOCK_NETIF_NEED_POLL);
+      break;
+    }
+    ci_rmb();
+
+    do {
+      struct oo_steer_slot* slot;
+      ci_ip_pkt_fmt* pkt = NULL;
+      unsigned len, hwport;
+      int intf_i = -1;
+
+      slot = ci_netif_steer_slot(ni, ni->steer_instance, tail);
+      len = slot->len;
+      hwport = slot->hwport;
+      if( hwport < CI_CFG_MAX_HWPORTS )
+#ifdef __KERNEL__
+        intf_i = ni->hwport_to_intf_i[hwport];
+#else
+        intf_i = ni->state->hwport_to_intf_i[hwport];
+#endif
+      if( len >= ETH_HLEN && len <= STEER_RX_MAX_LEN && intf_i >= 0 )
+        pkt = ci_netif_pkt_alloc(ni, 0);
+      if( pkt != NULL ) {
+        ci_netif_steer_pkt_fill(ni, pkt, slot, len, intf_i);
+        CITP_STATS_NETIF_INC(ni, steer_rx);
+        ci_parse_rx_vlan(pkt);
+        handle_rx_pkt(ni, &ps, pkt);
+      }
+      else {
+        CITP_STATS_NETIF_INC(ni, steer_rx_drop);
+      }
+      ++tail;
+      ++n;
+    } while( tail != head );
+
+    ring->tail = tail;
+    process_post_poll_list(ni);
+  }
+
+  if( ps.tx_pkt_free_list_n )
+    ci_netif_poll_free_pkts(ni, &ps);
+  return n;
+}
+#endif
+
+
 int ci_netif_poll_n(ci_netif* netif, int max_evs)
 {
   int intf_i, n_evs_handled = 0;
@@ -2350,6 +2466,15 @@ int ci_netif_poll_n(ci_netif* netif, int max_evs)
     n_evs_handled += n;
   }
 
+#if CI_CFG_CLUSTER_STEER
+  if( netif->steer != NULL ) {
+    if( netif->steer_instance != 0 )
+      n_evs_handled += ci_netif_poll_steer_ring(netif);
+    else if( netif->steer_kick_mask != 0 )
+      ci_netif_steer_kick(netif);
+  }
+#endif
+
   while( OO_PP_NOT_NULL(netif->state->looppkts) ) {
     ci_netif_loopback_pkts_send(netif);
     process_post_poll_list(netif);
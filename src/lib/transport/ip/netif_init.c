@@ -129,6 +129,14 @@ void ci_netif_state_init(ci_netif* ni, int cpu_khz, const char* name)
   oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &nis->recycle_retry_q));
 #endif
 
+#if CI_CFG_IP_REASM
+  ci_ip_reasm_init(ni);
+#endif
+
+#if CI_CFG_TX_PACING
+  ci_tx_pace_init(ni);
+#endif
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   ci_ip_timer_init(ni, &nis->stats_tid,
                    oo_ptr_to_statep(ni, &nis->stats_tid),
@@ -913,6 +921,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
    */
   opts->dynack_thresh = CI_MAX(opts->dynack_thresh, opts->delack_thresh);
 #endif
+  if ( (s = getenv("EF_TCP_ACK_COALESCE")) )
+    opts->tcp_ack_coalesce = atoi(s);
 
   if ( (s = getenv("EF_INVALID_ACK_RATELIMIT")) )
     opts->oow_ack_ratelimit = atoi(s);
@@ -945,6 +955,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 #endif
   if( (s = getenv("EF_TX_PUSH")) )
     opts->tx_push = atoi(s);
+#if CI_CFG_LATENCY_HIST
+  if( (s = getenv("EF_LATENCY_HIST")) )
+    opts->latency_hist = atoi(s) != 0;
+#endif
   if( opts->tx_push && (s = getenv("EF_TX_PUSH_THRESHOLD")) )
     opts->tx_push_thresh = atoi(s);
   if( (s = getenv("EF_PACKET_BUFFER_MODE")) )
@@ -953,6 +967,8 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->rst_delayed_conn = atoi(s);
   if( (s = getenv("EF_TCP_SNDBUF_MODE")) )
     opts->tcp_sndbuf_mode = atoi(s);
+  if( (s = getenv("EF_TCP_NOTSENT_LOWAT")) )
+    opts->tcp_notsent_lowat = atoi(s);
   if( (s = getenv("EF_TCP_COMBINE_SENDS_MODE")) )
     opts->tcp_combine_sends_mode = atoi(s);
   if( (s = getenv("EF_TCP_SEND_NONBLOCK_NO_PACKETS_MODE")) )
@@ -981,6 +997,18 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->udp_connect_handover = atoi(s);
   if( (s = getenv("EF_UDP_SEND_UNLOCKED")) )
     opts->udp_send_unlocked = atoi(s);
+#if CI_CFG_UDP_SEND_RING
+  if( (s = getenv("EF_UDP_SEND_RING")) )
+    opts->udp_send_ring = atoi(s) != 0;
+#endif
+#if CI_CFG_IP_REASM
+  if( (s = getenv("EF_IP_REASM")) )
+    opts->ip_reasm = atoi(s) != 0;
+  if( (s = getenv("EF_IP_REASM_MAX_PKTS")) )
+    opts->ip_reasm_max_pkts = atoi(s);
+  if( (s = getenv("EF_IP_REASM_TIMEOUT")) )
+    opts->ip_reasm_timeout = atoi(s);
+#endif
   if( (s = getenv("EF_UDP_SEND_NONBLOCK_NO_PACKETS_MODE")) )
     opts->udp_nonblock_no_pkts_mode = atoi(s);
   if( (s = getenv("EF_UNCONFINE_SYN")) )
@@ -1015,6 +1043,17 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
 
   if( (s = getenv("EF_ACCEPTQ_MIN_BACKLOG")) )
     opts->acceptq_min_backlog = atoi(s);
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( (s = getenv("EF_TCP_ACCEPTQ_SHARDS")) )
+    opts->tcp_acceptq_shards = atoi(s);
+#if CI_CFG_FD_CACHING
+  if( opts->tcp_acceptq_shards > 1 && opts->sock_cache_max > 0 ) {
+    CONFIG_LOG(opts, CONFIG_WARNINGS, "EF_TCP_ACCEPTQ_SHARDS is ignored "
+               "because EF_SOCKET_CACHE_MAX is set");
+    opts->tcp_acceptq_shards = 1;
+  }
+#endif
+#endif
 
   if ( (s = getenv("EF_TCP_SNDBUF")) )
     opts->tcp_sndbuf_user = atoi(s);
@@ -1107,6 +1146,10 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
     opts->loss_min_cwnd = atoi(s);
   if ( (s = getenv("EF_TCP_MIN_CWND")) )
     opts->min_cwnd = atoi(s);
+  static const char* const tcp_cc_opts[] = { "reno", "cubic", 0 };
+  opts->tcp_cc = parse_enum(opts, "EF_TCP_CONGESTION", tcp_cc_opts, "reno");
+  if ( (s = getenv("EF_TCP_FASTOPEN")) )
+    opts->tcp_fastopen = atoi(s);
 #if CI_CFG_TCP_FASTSTART
   if ( (s = getenv("EF_TCP_FASTSTART_INIT")) )
     opts->tcp_faststart_init = atoi(s);
@@ -1146,6 +1189,14 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   if ( (s = getenv("EF_TAIL_DROP_PROBE")))
     opts->tail_drop_probe = atoi(s);
 #endif
+#if CI_CFG_TCP_RACK
+  if ( (s = getenv("EF_TCP_RACK")))
+    opts->tcp_rack = atoi(s);
+#endif
+#if CI_CFG_TX_PACING
+  if ( (s = getenv("EF_TCP_AUTO_PACING")))
+    opts->tcp_auto_pacing = atoi(s);
+#endif
 #if CI_CFG_CONG_AVOID_SCALE_BACK
   if ( (s = getenv("EF_CONG_AVOID_SCALE_BACK")))
     opts->cong_avoid_scale_back = atoi(s);
@@ -1221,6 +1272,13 @@ void ci_netif_config_opts_getenv(ci_netif_config_opts* opts)
   else
     opts->cluster_ignore = 1;
 
+#if CI_CFG_CLUSTER_STEER
+  if( (s = getenv("EF_CLUSTER_STEER")) )
+    opts->cluster_steer = atoi(s) != 0;
+  if( (s = getenv("EF_CLUSTER_STEER_RING")) )
+    opts->cluster_steer_ring = atoi(s);
+#endif
+
 #if CI_CFG_TCP_SHARED_LOCAL_PORTS
   if( (s = getenv("EF_TCP_SHARED_LOCAL_PORTS")) )
     opts->tcp_shared_local_ports = atoi(s);
@@ -1761,6 +1819,14 @@ static void netif_tcp_helper_munmap(ci_netif* ni)
     if( rc < 0 )  LOG_NV(ci_log("%s: munmap efct shm %d", __FUNCTION__, rc));
   }
 
+#if CI_CFG_CLUSTER_STEER
+  if( ni->steer != NULL ) {
+    rc = oo_resource_munmap(ci_netif_get_driver_handle(ni),
+                            ni->steer, ni->steer_bytes);
+    if( rc < 0 )  LOG_NV(ci_log("%s: munmap steer %d", __FUNCTION__, rc));
+  }
+#endif
+
   if( ni->buf_ptr != NULL ) {
     rc = oo_resource_munmap(ci_netif_get_driver_handle(ni),
                             ni->buf_ptr, ni->state->buf_mmap_bytes);
@@ -1826,6 +1892,11 @@ static int netif_tcp_helper_mmap(ci_netif* ni)
 #endif
   ni->buf_ptr = NULL;
   ni->efct_shm_ptr = NULL;
+#if CI_CFG_CLUSTER_STEER
+  ni->steer = NULL;
+  ni->steer_kick_mask = 0;
+#endif
+  ci_tcp_reply_cache_init(ni);
   ni->packets = NULL;
 
   /****************************************************************************
@@ -1955,6 +2026,29 @@ static int netif_tcp_helper_mmap(ci_netif* ni)
     ni->efct_shm_ptr = p;
   }
 
+#if CI_CFG_CLUSTER_STEER
+  /****************************************************************************
+   * Map the cluster's software steering rings.
+   */
+  if( ns->steer_mmap_bytes != 0 ) {
+    struct oo_steer_area* area;
+    rc = oo_resource_mmap(ci_netif_get_driver_handle(ni),
+                          OO_MMAP_TYPE_NETIF,
+                          CI_NETIF_MMAP_ID_STEER, ns->steer_mmap_bytes,
+                          OO_MMAP_FLAG_DEFAULT, &p);
+    if( rc < 0 ) {
+      LOG_NV(ci_log("%s: oo_resource_mmap steer %d", __FUNCTION__, rc));
+      goto fail2;
+    }
+    area = p;
+    ni->steer = area;
+    ni->steer_bytes = ns->steer_mmap_bytes;
+    ni->steer_ring_mask = area->ring_size - 1;
+    ni->steer_n_rings = CI_MIN(area->n_rings, OO_STEER_MAX_RINGS);
+    ni->steer_instance = ns->rss_instance;
+  }
+#endif
+
   return 0;
 
  fail2:
@@ -2064,6 +2158,13 @@ unsigned ci_netif_build_future_intf_mask(ci_netif* ni)
   int nic_i;
   unsigned mask = 0;
 
+#if CI_CFG_CLUSTER_STEER
+  /* The receiving stack of a steering cluster must look at each packet
+   * before deciding which stack handles it. */
+  if( ni->steer != NULL && ni->steer_instance == 0 )
+    return 0;
+#endif
+
   OO_STACK_FOR_EACH_INTF_I(ni, nic_i) {
     /* Disable future when there's an XDP prog attached because that prog may
      * alter the destination socket, in which case the future code would be
@@ -178,12 +178,10 @@ ci_inline void __oo_pipe_wake_peer(ci_netif* ni, struct oo_pipe* p,
 }
 
 
-#ifdef __KERNEL__
 void oo_pipe_wake_peer(ci_netif* ni, struct oo_pipe* p, unsigned wake)
 {
   __oo_pipe_wake_peer(ni, p, wake);
 }
-#endif
 
 
 #if OO_DO_STACK_POLL
@@ -235,7 +233,7 @@ static int oo_pipe_read_wait(ci_netif* ni, struct oo_pipe* p, int non_block)
   ci_uint64 sleep_seq;
   int rc;
 
-  if( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_WRITER_SHIFT) ) {
+  if( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED ) {
   closed_double_check:
     ci_mb();
     return oo_pipe_data_len(p) ? 1 : 0;
@@ -269,7 +267,7 @@ static int oo_pipe_read_wait(ci_netif* ni, struct oo_pipe* p, int non_block)
       }
       if( oo_pipe_data_len(p) )
         return 1;
-      if( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_WRITER_SHIFT) )
+      if( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED )
         goto closed_double_check;
       ci_frc64(&now_frc);
 #if CI_CFG_SPIN_STATS
@@ -284,7 +282,7 @@ static int oo_pipe_read_wait(ci_netif* ni, struct oo_pipe* p, int non_block)
     ci_rmb();
     if( oo_pipe_data_len(p) )
       return 1;
-    if( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_WRITER_SHIFT) )
+    if( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED )
       goto closed_double_check;
 
     LOG_PIPE("%s [%u]: going to sleep seq=(%u, %u) data_len=%d aflags=%x",
@@ -328,7 +326,7 @@ oo_pipe_move_read_ptr(ci_netif* ni, struct oo_pipe* p, ci_ip_pkt_fmt** pkt,
 
 
 int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
-                 const struct iovec *iov, size_t iovlen)
+                 const struct iovec *iov, size_t iovlen, int flags)
 {
   int bytes_available;
   int rc;
@@ -350,8 +348,9 @@ int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
   bytes_available = oo_pipe_data_len(p);
   if( bytes_available == 0 ) {
     if( (rc = oo_pipe_read_wait(ni, p,
-                                p->aflags & (CI_PFD_AFLAG_NONBLOCK <<
-                                             CI_PFD_AFLAG_READER_SHIFT))) != 1 )
+                                (flags & MSG_DONTWAIT) ||
+                                (p->aflags & (CI_PFD_AFLAG_NONBLOCK <<
+                                              CI_PFD_AFLAG_READER_SHIFT)))) != 1 )
       goto out;
   }
 
@@ -390,6 +389,10 @@ int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
       ci_assert_le(offset + burst, pkt->pf.pipe.pay_len);
 
       if(CI_UNLIKELY( do_copy_read(start, read_point, burst) != 0 )) {
+        if( flags & MSG_PEEK ) {
+          CI_SET_ERROR(rc, EFAULT);
+          goto unlock_out;
+        }
         ci_wmb();
         p->bytes_removed += rc;
         CI_SET_ERROR(rc, EFAULT);
@@ -406,6 +409,9 @@ int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
   }
 
  read:
+  /* MSG_PEEK leaves the data, and the read pointer, where they were. */
+  if( flags & MSG_PEEK )
+    goto unlock_out;
   ci_wmb();
   p->bytes_removed += rc;
   p->read_ptr.pp = OO_PKT_P(pkt);
@@ -413,6 +419,7 @@ int ci_pipe_read(ci_netif* ni, struct oo_pipe* p,
  wake_and_unlock_out:
   if( do_wake || bytes_available == rc )
     __oo_pipe_wake_peer(ni, p, CI_SB_FLAG_WAKE_TX);
+ unlock_out:
   ci_sock_unlock(ni, &p->b);
  out:
   LOG_PIPE("%s[%u]: EXIT return %d", __FUNCTION__, p->b.bufid, rc);
@@ -447,7 +454,7 @@ int oo_pipe_write_block(ci_netif* ni, struct oo_pipe* p, int flags)
     /* we should sleep here */
     LOG_PIPE("%s: going to sleep", __FUNCTION__);
     rc = ci_sock_sleep(ni, &p->b, CI_SB_FLAG_WAKE_TX, 0, sleep_seq, 0);
-    if ( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT) ) {
+    if ( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED ) {
       CI_SET_ERROR(rc, EPIPE);
       if( ! (flags & MSG_NOSIGNAL) )
         oo_pipe_signal(ni);
@@ -505,7 +512,7 @@ static int oo_pipe_wait_write(ci_netif* ni, struct oo_pipe* p, int flags,
       if ( oo_pipe_is_writable(p) )
         return 0;
 
-      if ( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT) ) {
+      if ( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED ) {
         CI_SET_ERROR(rc, EPIPE);
         if( ! (flags & MSG_NOSIGNAL) )
           oo_pipe_signal(ni);
@@ -1750,9 +1757,10 @@ int ci_pipe_zc_move(ci_netif* ni, struct oo_pipe* pipe_src,
 #endif
 
 
-int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
-                  const struct iovec *iov,
-                  size_t iovlen)
+int ci_pipe_write_cb(ci_netif* ni, struct oo_pipe* p,
+                     const struct iovec *iov,
+                     size_t iovlen, int flags,
+                     ci_pipe_write_start_cb start_cb, void* ctx)
 {
   int total_bytes = 0, rc;
   int i;
@@ -1788,11 +1796,12 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
 
   pipe_dump(ni, p);
 
-  if( p->aflags & (CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT)) {
+  if( p->aflags & CI_PFD_AFLAG_EITHER_CLOSED ) {
     /* send sigpipe: not sure if anything can be done
      * in case of failure*/
     CI_SET_ERROR(rc, EPIPE);
-    oo_pipe_signal(ni);
+    if( ! (flags & MSG_NOSIGNAL) )
+      oo_pipe_signal(ni);
     goto out;
   }
 
@@ -1831,6 +1840,17 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
       burst = CI_MIN(oo_pipe_buf_space(pkt), (ci_uint32)(end - start));
 
       if( burst ) {
+        if( CI_UNLIKELY(start_cb != NULL) ) {
+          /* Other writers publish what they have written before they drop
+           * the stack lock, so this is where our first byte goes. */
+          ci_assert_equal(total_bytes + add, 0);
+          rc = start_cb(ctx, p->bytes_added);
+          start_cb = NULL;
+          if( rc < 0 ) {
+            CI_SET_ERROR(rc, -rc);
+            goto out;
+          }
+        }
         if(CI_UNLIKELY( do_copy_write(write_point, start, burst) != 0 )) {
           CI_SET_ERROR(rc, EFAULT);
           if( add > 0 )
@@ -1866,8 +1886,9 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
         }
         ci_assert_nequal(pkt, NULL);
         p->write_ptr.pp_wait = pkt->next;
-        if( p->aflags &
-            (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT) ) {
+        if( (flags & MSG_DONTWAIT) ||
+            (p->aflags &
+             (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT)) ) {
           /* Since we're non-blocking, [add] is the total count of bytes we've
            * written. */
           if( add > 0 )
@@ -1886,7 +1907,7 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
 
       if( total_bytes )
         __oo_pipe_wake_peer(ni, p, CI_SB_FLAG_WAKE_RX);
-      rc = oo_pipe_wait_write(ni, p, 0, &stack_locked);
+      rc = oo_pipe_wait_write(ni, p, flags, &stack_locked);
       if (rc != 0) {
         if( total_bytes ) {
           /* Partial write followed by failed wait is success. */
@@ -1934,6 +1955,14 @@ int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
 }
 
 
+int ci_pipe_write(ci_netif* ni, struct oo_pipe* p,
+                  const struct iovec *iov,
+                  size_t iovlen, int flags)
+{
+  return ci_pipe_write_cb(ni, p, iov, iovlen, flags, NULL, NULL);
+}
+
+
 #if OO_DO_STACK_POLL
 static void oo_pipe_free_bufs(ci_netif* ni, struct oo_pipe* p)
 {
@@ -2024,6 +2053,9 @@ void oo_pipe_dump(ci_netif* ni, struct oo_pipe* p, const char* pf,
          p->bytes_added,
          (p->aflags & CI_PFD_AFLAG_WRITER_MASK ) >> CI_PFD_AFLAG_WRITER_SHIFT);
   logger(log_arg, "%s  num_bufs=%d/%d", pf, p->bufs_num, p->bufs_max);
+  if( OO_SP_NOT_NULL(p->peer) )
+    logger(log_arg, "%s  unix_peer=%d ctrl_n=%u", pf, OO_SP_FMT(p->peer),
+           p->ctrl_n);
 }
 
 #endif
@@ -105,10 +105,21 @@ void ci_sock_cmn_init(ci_netif* ni, ci_sock_cmn* s, int can_poison)
   }
 #endif
 
+#if CI_CFG_LATENCY_HIST_SOCK
+  memset(s->lat_hist, 0, sizeof(s->lat_hist));
+#endif
+
   ci_sock_cmn_reinit(ni, s);
 
   oo_p_dllink_init(ni, oo_p_dllink_sb(ni, &s->b, &s->reap_link));
 
+#if CI_CFG_TX_PACING
+  s->pace_max_rate = CI_TX_PACE_RATE_UNLIMITED;
+  s->pace_tokens = 0;
+  s->pace_stamp = 0;
+  oo_p_dllink_init(ni, oo_p_dllink_sb(ni, &s->b, &s->pace_link));
+#endif
+
   /* Not functionally necessary, but avoids garbage addresses in stackdump. */
   sock_laddr_be32(s) = sock_raddr_be32(s) = 0;
   sock_lport_be16(s) = sock_rport_be16(s) = 0;
@@ -137,6 +148,16 @@ void ci_sock_cmn_dump(ci_netif* ni, ci_sock_cmn* s, const char* pf,
          s->os_sock_status >> OO_OS_STATUS_SEQ_SHIFT,
          (s->os_sock_status & OO_OS_STATUS_RX) ? ",RX":"",
          (s->os_sock_status & OO_OS_STATUS_TX) ? ",TX":"");
+#if CI_CFG_TX_PACING
+  {
+    int throttled = ! oo_p_dllink_is_empty(ni, oo_p_dllink_sb(ni, &s->b,
+                                                               &s->pace_link));
+    if( s->pace_max_rate != CI_TX_PACE_RATE_UNLIMITED || throttled )
+      logger(log_arg, "%s  pace: max_rate=%llu tokens=%d%s", pf,
+             (unsigned long long) s->pace_max_rate, s->pace_tokens,
+             throttled ? " THROTTLED" : "");
+  }
+#endif
 
   if( s->b.ready_lists_in_use != 0 ) {
     ci_uint32 tmp, i;
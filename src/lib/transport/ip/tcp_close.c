@@ -36,8 +36,10 @@ void __ci_tcp_listen_to_normal(ci_netif* netif, ci_tcp_socket_listen* tls)
 #endif
 
   ci_assert(tls->n_listenq == 0);
-  ci_assert_equal(ci_tcp_acceptq_n(tls), 0);
-  ci_assert_equal(ci_tcp_acceptq_not_empty(tls), 0);
+  /* Connections may be left on a locked shard of the accept queue: see
+   * ci_tcp_listen_shutdown_queues(). */
+  ci_assert(ci_tcp_acceptq_n(tls) == 0 || ci_tcp_acceptq_sharded(tls));
+  ci_assert(! ci_tcp_acceptq_not_empty(tls) || ci_tcp_acceptq_sharded(tls));
 
   ci_ip_timer_clear(netif, &tls->listenq_tid);
 
@@ -674,6 +676,23 @@ void ci_tcp_listen_shutdown_queues(ci_netif* netif, ci_tcp_socket_listen* tls)
     ci_tcp_state* ats;    /* accepted ts */
 
     w = ci_tcp_acceptq_get(netif, tls);
+    if( w == NULL ) {
+#ifdef __KERNEL__
+      /* Nothing can be added to the queue while we hold the stack lock, so
+       * what remains is on shards whose lock a user-level thread has held
+       * for too long.  It may have died holding it, so leave them; they
+       * are freed with the stack.
+       */
+      if( ci_tcp_acceptq_not_empty(tls) ) {
+        LOG_U(log("%s: %d:%d accept queue shard is locked: leaving %d "
+                  "connections", __FUNCTION__, NI_ID(netif), S_FMT(tls),
+                  ci_tcp_acceptq_n(tls)));
+        break;
+      }
+#endif
+      /* An accepting thread took it from a sharded queue. */
+      continue;
+    }
 
 #if defined(__KERNEL__) && CI_CFG_ENDPOINT_MOVE
     if( w->sb_aflags & CI_SB_AFLAG_MOVED_AWAY ) {
@@ -763,7 +782,7 @@ void ci_tcp_listen_shutdown_queues(ci_netif* netif, ci_tcp_socket_listen* tls)
 #endif
   }
 
-  ci_assert_equal(ci_tcp_acceptq_n(tls), 0);
+  ci_assert(ci_tcp_acceptq_n(tls) == 0 || ci_tcp_acceptq_sharded(tls));
 
 #if CI_CFG_FD_CACHING
   /* Above we uncached and closed EPs on the accept q.  While an EP is cached
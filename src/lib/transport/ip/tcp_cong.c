@@ -0,0 +1,239 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* TCP congestion control algorithms.
+ *
+ * The common code in tcp_rx.c and tcp_timer.c does slow start, fast
+ * recovery and RTO handling.  The algorithms here decide how cwnd grows in
+ * congestion avoidance and how far it is cut when loss is detected.
+ */
+
+#include "ip_internal.h"
+
+
+#define LPF "TCP CC "
+
+
+/**********************************************************************
+ * NewReno
+ */
+
+static void ci_tcp_reno_init(ci_netif* ni, ci_tcp_state* ts)
+{
+}
+
+
+/* Implements RFC3465 (ABC). */
+static void ci_tcp_reno_cong_avoid(ci_netif* ni, ci_tcp_state* ts)
+{
+  /* Hack - Increase less aggresively on small round trip times */
+#if CI_CFG_CONG_AVOID_SCALE_BACK
+  unsigned tmp = 0, cwnd_scaled;
+  /* tcp_srtt(ts) would relatively easy exceed 32 for a round trip time
+   * on longer links */
+  if( tcp_srtt(ts) < 32 )
+    tmp = NI_OPTS(ni).cong_avoid_scale_back >> tcp_srtt(ts);
+  cwnd_scaled = CI_MAX(1U, tmp) * ts->cwnd;
+#else
+  unsigned cwnd_scaled = ts->cwnd;
+#endif
+  /* Congestion avoidance.  RFC3465 says: increase the congestion window
+  ** by one segment each RTT.  i.e. wait for bytes_acked to be > cwnd
+  ** (which takes one RTT), then reset bytes_acked by subtracting the
+  ** cwnd from it, and add one segment to cwnd.
+  */
+  LOG_TV(log(LPF "%d OPENCWND: CA eff_mss=%u bytes_acked=%u cwnd=%u",
+             S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
+  if( ts->bytes_acked >= cwnd_scaled ) {
+    ts->bytes_acked -= cwnd_scaled;
+    ts->cwnd += tcp_eff_mss(ts);
+  }
+}
+
+
+static ci_uint32 ci_tcp_reno_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  return ci_tcp_losswnd(ts);
+}
+
+
+static const ci_tcp_cc_ops ci_tcp_reno_ops = {
+  .name       = "reno",
+  .init       = ci_tcp_reno_init,
+  .cong_avoid = ci_tcp_reno_cong_avoid,
+  .ssthresh   = ci_tcp_reno_ssthresh,
+};
+
+
+/**********************************************************************
+ * CUBIC (RFC 8312)
+ *
+ * In congestion avoidance cwnd follows
+ *
+ *   W(t) = C * (t - K)^3 + W_max
+ *
+ * where t is the time since the epoch (congestion avoidance) started and
+ * W_max the window before the last reduction.  K is chosen so that W(0) is
+ * the window after the reduction, so cwnd grows quickly back towards
+ * W_max, flattens out around it and then probes beyond it.  The growth
+ * depends on time rather than on RTT, which is what lets it fill paths
+ * with a large bandwidth-delay product.
+ *
+ * Times are in milliseconds.  HyStart is not implemented: slow start is
+ * the common one.
+ */
+
+/* Multiplicative decrease 0.7, in units of 1/1024 */
+#define CUBIC_BETA          717
+#define CUBIC_BETA_SHIFT    10
+
+/* 1/C in ms^3 per segment, for C = 0.4 segments/s^3 */
+#define CUBIC_MS3_PER_SEG   2500000000ull
+
+/* Bound on |t - K| so that its cube fits in 63 bits: about 17 minutes */
+#define CUBIC_MAX_DT_MS     (1 << 20)
+
+
+/* Integer cube root, rounding down.  [a] must be less than 2^63. */
+ci_uint32 ci_tcp_cubic_cbrt(ci_uint64 a)
+{
+  ci_uint64 x = 0, y;
+  int b;
+
+  for( b = 20; b >= 0; --b ) {
+    y = x | (1u << b);
+    if( y * y * y <= a )
+      x = y;
+  }
+  return x;
+}
+
+
+static void ci_tcp_cubic_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->cubic_w_max = 0;
+  ts->cubic_origin = 0;
+  ts->cubic_cwnd_epoch = 0;
+  ts->cubic_k = 0;
+  ts->cubic_epoch_start = 0;
+}
+
+
+static void ci_tcp_cubic_cong_avoid(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint32 mss = tcp_eff_mss(ts);
+  ci_iptime_t now = ci_tcp_time_now(ni);
+  ci_uint32 elapsed_ms, rtt_ms;
+  ci_int64 dt, target, est;
+  ci_uint64 thresh, n;
+
+  if( ts->cubic_epoch_start == 0 ) {
+    ts->cubic_epoch_start = now;
+    ts->cubic_cwnd_epoch = ts->cwnd;
+    if( ts->cubic_w_max > ts->cwnd ) {
+      ci_uint64 segs = (ts->cubic_w_max - ts->cwnd) / mss;
+      ts->cubic_k = ci_tcp_cubic_cbrt(segs * CUBIC_MS3_PER_SEG);
+      ts->cubic_origin = ts->cubic_w_max;
+    }
+    else {
+      ts->cubic_k = 0;
+      ts->cubic_origin = ts->cwnd;
+    }
+  }
+
+  elapsed_ms = ci_ip_time_ticks2ms(ni, now - ts->cubic_epoch_start);
+  rtt_ms = CI_MAX(ci_ip_time_ticks2ms(ni, tcp_srtt(ts)), 1u);
+
+  /* Aim for the point on the curve one RTT from now. */
+  dt = (ci_int64) elapsed_ms + rtt_ms - ts->cubic_k;
+  dt = CI_MIN(dt, (ci_int64) CUBIC_MAX_DT_MS);
+  dt = CI_MAX(dt, (ci_int64) -CUBIC_MAX_DT_MS);
+  target = ts->cubic_origin +
+           dt * dt * dt / (ci_int64) CUBIC_MS3_PER_SEG * mss;
+
+  /* Never grow more slowly than standard TCP would (RFC 8312 section 4.2),
+   * whose window increases by 3 * (1 - beta) / (1 + beta) = 9/17 segments
+   * per RTT from the same reduction. */
+  est = ts->cubic_cwnd_epoch +
+        (ci_int64) elapsed_ms * 9 * mss / (17 * (ci_int64) rtt_ms);
+  target = CI_MAX(target, est);
+
+  /* Grow by one segment per [thresh] bytes acked, so as to reach [target]
+   * in an RTT, but by no more than half of cwnd per RTT. */
+  if( target > ts->cwnd )
+    thresh = (ci_uint64) ts->cwnd * mss / (target - ts->cwnd);
+  else
+    thresh = (ci_uint64) ts->cwnd * 100;
+  thresh = CI_MAX(thresh, (ci_uint64) mss * 2);
+
+  LOG_TV(log(LPF "%d OPENCWND: CUBIC eff_mss=%u bytes_acked=%u cwnd=%u "
+             "target=%lld thresh=%llu", S_FMT(ts), mss, ts->bytes_acked,
+             ts->cwnd, (long long) target, (unsigned long long) thresh));
+
+  if( ts->bytes_acked >= thresh ) {
+    n = ts->bytes_acked / thresh;
+    ts->cwnd += n * mss;
+    ts->bytes_acked -= n * thresh;
+  }
+}
+
+
+static ci_uint32 ci_tcp_cubic_ssthresh(ci_netif* ni, ci_tcp_state* ts)
+{
+  /* cwnd keeps growing when the sender is not using all of it, so don't
+   * take it to be larger than what was in flight. */
+  ci_uint32 cwnd = CI_MIN(ts->cwnd, ci_tcp_inflight(ts));
+  ci_uint32 ssthresh;
+
+  ts->cubic_epoch_start = 0;
+
+  /* Fast convergence: if the window is smaller than at the previous loss,
+   * another flow has probably arrived, so leave it some room by aiming
+   * below this window. */
+  if( cwnd < ts->cubic_w_max )
+    ts->cubic_w_max = ((ci_uint64) cwnd *
+                       ((1 << CUBIC_BETA_SHIFT) + CUBIC_BETA)) >>
+                      (CUBIC_BETA_SHIFT + 1);
+  else
+    ts->cubic_w_max = cwnd;
+
+  ssthresh = ((ci_uint64) cwnd * CUBIC_BETA) >> CUBIC_BETA_SHIFT;
+  return CI_MAX(ssthresh, (ci_uint32) tcp_eff_mss(ts) << 1u);
+}
+
+
+static const ci_tcp_cc_ops ci_tcp_cubic_ops = {
+  .name       = "cubic",
+  .init       = ci_tcp_cubic_init,
+  .cong_avoid = ci_tcp_cubic_cong_avoid,
+  .ssthresh   = ci_tcp_cubic_ssthresh,
+};
+
+
+/**********************************************************************/
+
+const ci_tcp_cc_ops* const ci_tcp_cc_algos[CI_TCP_CC_N] = {
+  [CI_TCP_CC_RENO]  = &ci_tcp_reno_ops,
+  [CI_TCP_CC_CUBIC] = &ci_tcp_cubic_ops,
+};
+
+
+int ci_tcp_cc_find(const char* name, int len)
+{
+  int i;
+
+  /* The length may or may not include a terminating nul. */
+  len = strnlen(name, len);
+  for( i = 0; i < CI_TCP_CC_N; ++i )
+    if( strlen(ci_tcp_cc_algos[i]->name) == len &&
+        ! strncmp(ci_tcp_cc_algos[i]->name, name, len) )
+      return i;
+  return -1;
+}
+
+
+void ci_tcp_cc_select(ci_netif* ni, ci_tcp_state* ts, unsigned algo)
+{
+  ts->c.cc_algo = algo;
+  ci_tcp_cc(ts)->init(ni, ts);
+}
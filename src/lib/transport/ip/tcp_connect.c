@@ -100,6 +100,20 @@ ci_inline void ci_tcp_bind_flags_assert_valid(ci_sock_cmn* s)
   }
 }
 
+
+/* Should connect() return rather than block?  As well as O_NONBLOCK on the
+ * socket, onload_ring asks for this per call, so that it need not change
+ * file flags which are shared with other threads.
+ */
+ci_inline int ci_tcp_connect_nonblock(ci_sock_cmn* s)
+{
+#ifndef __KERNEL__
+  if( __oo_per_thread_get()->ring_nonblock )
+    return 1;
+#endif
+  return s->b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY);
+}
+
 #ifndef __ci_driver__
 /* Set CI_SOCK_FLAG_BOUND_ALIEN if needed */
 static void ci_tcp_bind_check_laddr(ci_netif *ni, ci_sock_cmn *s,
@@ -885,10 +899,15 @@ ci_inline void ci_tcp_connect_drop_implicit_address(ci_tcp_state *ts)
 #define CI_CONNECT_UL_LOCK_DROPPED	-3
 #define CI_CONNECT_UL_ALIEN_BOUND	-4
 
-/* The fd parameter is ignored when this is called in the kernel */
+/* The fd parameter is ignored when this is called in the kernel.
+ *
+ * [tfo_iov] is the data for a Fast Open SYN, if any.  The number of bytes
+ * of it carried on the SYN is stored at [tfo_len].
+ */
 static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
                                    ci_addr_t dst, unsigned dport_be16,
-                                   int* fail_rc)
+                                   const ci_iovec* tfo_iov, int tfo_iovlen,
+                                   int* tfo_len, int* fail_rc)
 {
   ci_ip_pkt_fmt* pkt;
   int rc = 0;
@@ -1011,7 +1030,7 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
   if( CI_UNLIKELY(! pkt) ) {
     /* Should we block or return error? */
     if( NI_OPTS(ni).tcp_nonblock_no_pkts_mode &&
-        (ts->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY)) ) {
+        ci_tcp_connect_nonblock(&ts->s) ) {
       CI_SET_ERROR(*fail_rc, ENOBUFS);
       rc = CI_CONNECT_UL_FAIL;
       goto fail;
@@ -1151,6 +1170,12 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
   if( ci_tcp_can_stripe(ni, ts->s.pkt.ipx.ip4.ip_saddr_be32,
 			ts->s.pkt.ipx.ip4.ip_daddr_be32) )
     ts->tcpflags |= CI_TCPT_FLAG_STRIPE;
+  ts->tcpflags &= ~CI_TCPT_FLAG_TFO;
+  if( (tfo_iov != NULL || (ts->tcpflags & CI_TCPT_FLAG_TFO_CONNECT)) &&
+      (NI_OPTS(ni).tcp_fastopen & CI_TCP_FASTOPEN_CLIENT) &&
+      ! (ts->s.pkt.flags & CI_IP_CACHE_IS_LOCALROUTE) &&
+      ! (ts->tcpflags & CI_TCPT_FLAG_STRIPE) )
+    ts->tcpflags |= CI_TCPT_FLAG_TFO;
   ci_tcp_set_slow_state(ni, ts, CI_TCP_SYN_SENT);
 
   /* If the app trys to send data on a socket in SYN_SENT state
@@ -1170,10 +1195,17 @@ static int ci_tcp_connect_ul_start(ci_netif *ni, ci_tcp_state* ts, ci_fd_t fd,
   /* If ARP resolution fails, we have to drop the connection, so we store
    * the socket id in the SYN packet. */
   pkt->pf.tcp_tx.sock_id = ts->s.b.bufid;
-  ci_tcp_enqueue_no_data(ts, ni, pkt);
+  if( ts->tcpflags & CI_TCPT_FLAG_TFO ) {
+    int n = ci_tcp_enqueue_syn_fastopen(ts, ni, pkt, tfo_iov, tfo_iovlen);
+    if( tfo_len != NULL )
+      *tfo_len = n;
+  }
+  else {
+    ci_tcp_enqueue_no_data(ts, ni, pkt);
+  }
   ci_tcp_set_flags(ts, CI_TCP_FLAG_ACK);  
 
-  if( ts->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY) ) {
+  if( ci_tcp_connect_nonblock(&ts->s) ) {
     ts->tcpflags |= CI_TCPT_FLAG_NONBLOCK_CONNECT;
     LOG_TC(log( LNT_FMT "Non-blocking connect - return EINPROGRESS",
 		LNT_PRI_ARGS(ni, ts)));
@@ -1416,8 +1448,10 @@ ci_tcp_retrieve_addr(ci_netif* netif, const struct sockaddr* serv_addr,
  *          CI_SOCKET_HANDOVER we tell the upper layers to handover, no need
  *                             to set errno since it isn't a real error
  */
-int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
-		   socklen_t addrlen, ci_fd_t fd, int *p_moved)
+static int __ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
+                            socklen_t addrlen, ci_fd_t fd, int *p_moved,
+                            const ci_iovec* tfo_iov, int tfo_iovlen,
+                            int* tfo_len)
 {
   ci_sock_cmn* s = ep->s;
   ci_tcp_state* ts = &SOCK_TO_WAITABLE_OBJ(s)->tcp;
@@ -1483,7 +1517,7 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
     else {
       /* Socket is in SYN-SENT state. Let's block for receiving SYN-ACK */
       ci_assert_equal(s->b.state, CI_TCP_SYN_SENT);
-      if( s->b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK | CI_SB_AFLAG_O_NDELAY) )
+      if( ci_tcp_connect_nonblock(s) )
         CI_SET_ERROR(rc, EALREADY);
       else
         goto syn_sent;
@@ -1536,6 +1570,12 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
       OO_SP_IS_NULL(ts->local_peer) ) {
     /* Try to connect to another stack; handover if can't */
     struct oo_op_loopback_connect op;
+    if( tfo_iov != NULL ) {
+      /* There's no Fast Open over loopback, and the data would be lost
+       * with a handover. */
+      ci_netif_unlock(ep->netif);
+      RET_WITH_ERRNO(EOPNOTSUPP);
+    }
     op.dst_port = dst_port;
     op.dst_addr = dst_addr;
     /* this operation unlocks netif */
@@ -1561,7 +1601,7 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   }
 
   crc = ci_tcp_connect_ul_start(ep->netif, ts, fd, dst_addr, dst_port,
-                                &rc);
+                                tfo_iov, tfo_iovlen, tfo_len, &rc);
   if( crc != CI_CONNECT_UL_OK ) {
     switch( crc ) {
     case CI_CONNECT_UL_ALIEN_BOUND:
@@ -1594,6 +1634,33 @@ int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
   }
   return rc;
 }
+
+
+int ci_tcp_connect(citp_socket* ep, const struct sockaddr* serv_addr,
+		   socklen_t addrlen, ci_fd_t fd, int *p_moved)
+{
+  return __ci_tcp_connect(ep, serv_addr, addrlen, fd, p_moved, NULL, 0, NULL);
+}
+
+
+/* connect() for sendmsg(MSG_FASTOPEN): as ci_tcp_connect(), but the SYN
+ * carries as much of [iov] as it can.  The number of bytes it carries is
+ * stored at [tfo_len], including when a non-blocking connect fails with
+ * EINPROGRESS.  Loopback connections fail with EOPNOTSUPP.
+ */
+int ci_tcp_connect_fastopen(citp_socket* ep, const struct sockaddr* serv_addr,
+                            socklen_t addrlen, ci_fd_t fd,
+                            const ci_iovec* iov, int iovlen, int* tfo_len)
+{
+  int moved = 0, rc;
+
+  *tfo_len = 0;
+  rc = __ci_tcp_connect(ep, serv_addr, addrlen, fd, &moved,
+                        iov, iovlen, tfo_len);
+  /* Only a loopback connect moves the socket to another stack. */
+  ci_assert_equal(moved, 0);
+  return rc;
+}
 #endif
 
 int ci_tcp_listen_init(ci_netif *ni, ci_tcp_socket_listen *tls)
@@ -1610,8 +1677,17 @@ int ci_tcp_listen_init(ci_netif *ni, ci_tcp_socket_listen *tls)
   tls->listenq_tid.fn = CI_IP_TIMER_TCP_LISTEN;
 
   tls->acceptq_n_in = tls->acceptq_n_out = 0;
+  tls->tfo_n_in = tls->tfo_n_out = 0;
   tls->acceptq_put = CI_ILL_END;
   tls->acceptq_get = OO_SP_NULL;
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  tls->acceptq_n_shards = NI_OPTS(ni).tcp_acceptq_shards;
+  for( i = 0; i < CI_CFG_TCP_ACCEPTQ_SHARDS; ++i ) {
+    tls->acceptq_shard[i].put = CI_ILL_END;
+    tls->acceptq_shard[i].get = OO_SP_NULL;
+    tls->acceptq_shard[i].lock = 0;
+  }
+#endif
   tls->n_listenq = 0;
   tls->n_listenq_new = 0;
 
@@ -1658,7 +1734,7 @@ int ci_tcp_connect_lo_samestack(ci_netif *ni, ci_tcp_state *ts, oo_sp tls_id,
 
   ts->local_peer = tls_id;
   crc = ci_tcp_connect_ul_start(ni, ts, CI_FD_BAD, sock_ipx_raddr(&ts->s),
-                                ts->s.pkt.dport_be16, &rc);
+                                ts->s.pkt.dport_be16, NULL, 0, NULL, &rc);
 
   /* The connect is really finished, but we should return EINPROGRESS
    * for non-blocking connect and 0 for normal. */
@@ -1705,6 +1781,9 @@ int ci_tcp_connect_lo_toconn(ci_netif *c_ni, oo_sp c_id, ci_addr_t dst,
 
   /* init common tcp fields */
   ts->s.so = alien_tls->s.so;
+#if CI_CFG_TX_PACING
+  ts->s.pace_max_rate = alien_tls->s.pace_max_rate;
+#endif
   ts->s.cp.ip_ttl = alien_tls->s.cp.ip_ttl;
 #if CI_CFG_IPV6
   ts->s.cp.hop_limit = alien_tls->s.cp.hop_limit;
@@ -1762,6 +1841,8 @@ int ci_tcp_connect_lo_toconn(ci_netif *c_ni, oo_sp c_id, ci_addr_t dst,
     return -EBUSY;
   }
   w = ci_tcp_acceptq_get(c_ni, tls);
+  /* Nobody else accepts from the shadow listener, so its shards are never
+   * locked. */
   ci_assert(w);
   LOG_TV(ci_log("%s: %d:%d to %d:%d shadow %d:%d accepted %d:%d",
                 __FUNCTION__,
@@ -423,6 +423,9 @@ void ci_tcp_state_assert_valid(ci_netif* netif, ci_tcp_state* ts,
   chk(delack_tid);
   chk(zwin_tid);
   chk(kalive_tid);
+#if CI_CFG_TCP_RACK
+  chk(rack_tid);
+#endif
 # undef chk
 
   verify(SEQ_LE(tcp_snd_una(ts), tcp_snd_nxt(ts)));
@@ -689,6 +692,13 @@ void ci_tcp_socket_listen_dump(ci_netif* ni, ci_tcp_socket_listen* tls,
          tls->n_buckets);
   logger(log_arg, "%s  acceptq: max=%d n=%d accepted=%d", pf,
          tls->acceptq_max, ci_tcp_acceptq_n(tls), tls->acceptq_n_out);
+  if( tls->c.tfo_qlen != 0 )
+    logger(log_arg, "%s  acceptq: fastopen_qlen=%d n_fastopen=%d", pf,
+           tls->c.tfo_qlen, ci_tcp_acceptq_n_tfo(tls));
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( ci_tcp_acceptq_sharded(tls) )
+    logger(log_arg, "%s  acceptq: shards=%d", pf, tls->acceptq_n_shards);
+#endif
   logger(log_arg, "%s  defer_accept=%d", pf, tls->c.tcp_defer_accept);
 #if CI_CFG_FD_CACHING
   logger(log_arg, "%s  sockcache: n=%d sock_n=%d cache=%s pending=%s connected=%s",
@@ -789,15 +799,23 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
          SEQ_SUB(ts->snd_max, tcp_snd_nxt(ts)));
   if( ts->snd_delegated != 0 )
     logger(log_arg, "%s  snd delegated=%d", pf, ts->snd_delegated);
-  logger(log_arg, "%s  snd: cwnd=%d+%d used=%d ssthresh=%d bytes_acked=%d %s",
-         pf, ts->cwnd, ts->cwnd_extra, tcp_cwnd_used(ts),
-         ts->ssthresh, ts->bytes_acked, congstate_str(ts));
+  logger(log_arg, "%s  snd: cc=%s cwnd=%d+%d used=%d ssthresh=%d "
+         "bytes_acked=%d %s", pf, ci_tcp_cc(ts)->name, ts->cwnd,
+         ts->cwnd_extra, tcp_cwnd_used(ts), ts->ssthresh, ts->bytes_acked,
+         congstate_str(ts));
+  if( ts->c.cc_algo == CI_TCP_CC_CUBIC )
+    logger(log_arg, "%s  snd: cubic w_max=%u origin=%u cwnd_epoch=%u k=%ums "
+           "epoch_start=%x", pf, ts->cubic_w_max, ts->cubic_origin,
+           ts->cubic_cwnd_epoch, ts->cubic_k, ts->cubic_epoch_start);
   logger(log_arg, "%s  snd: timed_seq %x timed_ts %x",
          pf, ts->timed_seq, ts->timed_ts);
   logger(log_arg, "%s  snd: sndbuf_pkts=%d "OOF_IPCACHE_STATE" "
 	 OOF_IPCACHE_DETAIL,
 	 pf, ts->so_sndbuf_pkts, OOFA_IPCACHE_STATE(ni, &ts->s.pkt),
          OOFA_IPCACHE_DETAIL(&ts->s.pkt));
+  if( ci_tcp_notsent_lowat(ni, ts) != 0 )
+    logger(log_arg, "%s  snd: notsent_lowat=%u unsent=%d", pf,
+           ci_tcp_notsent_lowat(ni, ts), ci_tcp_sendq_unsent_bytes(ts));
   logger(log_arg, "%s  snd: limited rwnd=%d cwnd=%d nagle=%d more=%d app=%d",
          pf, stats.tx_stop_rwnd, stats.tx_stop_cwnd, stats.tx_stop_nagle,
          stats.tx_stop_more, stats.tx_stop_app);
@@ -805,6 +823,19 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
   if( ts->tcpflags & CI_TCPT_FLAG_TAIL_DROP_MARKED )
     logger(log_arg, "%s  snd: tail loss probe at %x", pf, ts->taildrop_mark);
 #endif
+#if CI_CFG_TCP_RACK
+  if( ci_tcp_rack_enabled(ni, ts) )
+    logger(log_arg, "%s  snd: rack xmit_ts=%x end_seq=%x rtt=%uus "
+           "min_rtt=%uus reo_wnd_mult=%d%s", pf, ts->rack_xmit_ts,
+           ts->rack_end_seq, ts->rack_rtt, ts->rack_min_rtt,
+           ts->rack_reo_wnd_mult,
+           (ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER) ? " REORDER" : "");
+#endif
+#if CI_CFG_TX_PACING
+  if( ci_tcp_may_pace(ni, ts) )
+    logger(log_arg, "%s  snd: pace rate=%llu limited=%d", pf,
+           (unsigned long long) ci_tcp_pace_rate(ni, ts), stats.tx_stop_pace);
+#endif
 
   logger(log_arg, "%s  rcv: nxt-max=%08x-%08x wnd adv=%d cur=%d %s%s", pf,
          tcp_rcv_nxt(ts), tcp_rcv_wnd_right_edge_sent(ts),
@@ -873,6 +904,9 @@ void ci_tcp_state_dump(ci_netif* ni, ci_tcp_state* ts,
   fmt_timer(buf, LINE_LEN, n, delack, ts->delack_tid);
   fmt_timer(buf, LINE_LEN, n, zwin, ts->zwin_tid);
   fmt_timer(buf, LINE_LEN, n, kalive, ts->kalive_tid);
+#if CI_CFG_TCP_RACK
+  fmt_timer(buf, LINE_LEN, n, rack, ts->rack_tid);
+#endif
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(ni, ts->pmtus);
     fmt_timer(buf, LINE_LEN, n, pmtu, pmtus->tid);
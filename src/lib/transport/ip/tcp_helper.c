@@ -304,6 +304,25 @@ int ci_tcp_helper_tcp_accept_sock_attach(ci_fd_t stack_fd, oo_sp ep_id,
   return op.fd;
 }
 
+int ci_tcp_helper_tcp_accept_sock_attach_batch(ci_fd_t stack_fd,
+                                               const oo_sp* ep_ids,
+                                               int* fds, int n, int type)
+{
+  int rc;
+  oo_tcp_accept_sock_attach_batch_t op;
+
+  CI_USER_PTR_SET(op.ep_ids, ep_ids);
+  CI_USER_PTR_SET(op.fds, fds);
+  op.n = n;
+  op.type = type;
+  oo_rwlock_lock_read(&citp_dup2_lock);
+  rc = oo_resource_op(stack_fd, OO_IOC_TCP_ACCEPT_SOCK_ATTACH_BATCH, &op);
+  oo_rwlock_unlock_read (&citp_dup2_lock);
+  if( rc < 0 )
+    return rc;
+  return op.n;
+}
+
 int ci_tcp_helper_pipe_attach(ci_fd_t stack_fd, oo_sp ep_id,
                               int flags, int fds[2])
 {
@@ -320,6 +339,25 @@ int ci_tcp_helper_pipe_attach(ci_fd_t stack_fd, oo_sp ep_id,
   return rc;
 }
 
+int ci_tcp_helper_unix_attach(ci_fd_t stack_fd, const oo_sp ep_ids[2],
+                              const int os_fds[2], int flags, int fds[2])
+{
+  int rc;
+  oo_unix_attach_t op;
+
+  op.ep_id[0] = ep_ids[0];
+  op.ep_id[1] = ep_ids[1];
+  op.os_fd[0] = os_fds[0];
+  op.os_fd[1] = os_fds[1];
+  op.flags = flags;
+  rc = oo_resource_op(stack_fd, OO_IOC_UNIX_ATTACH, &op);
+  if( rc < 0 )
+    return rc;
+  fds[0] = op.fd[0];
+  fds[1] = op.fd[1];
+  return rc;
+}
+
 
 #include <onload/dup2_lock.h>
 oo_rwlock citp_dup2_lock;
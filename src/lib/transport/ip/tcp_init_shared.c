@@ -44,6 +44,9 @@ static void ci_tcp_state_setup_timers(ci_netif* ni, ci_tcp_state* ts)
   ci_tcp_setup_timer(stats,    CI_IP_TIMER_TCP_STATS,  "stat");
 #endif
   ci_tcp_setup_timer(cork,     CI_IP_TIMER_TCP_CORK,   "cork");
+#if CI_CFG_TCP_RACK
+  ci_tcp_setup_timer(rack,     CI_IP_TIMER_TCP_RACK,   "rack");
+#endif
 
 #undef ci_tcp_setup_timer
 }
@@ -55,6 +58,7 @@ static void ci_tcp_state_connected_opts_init(ci_netif* netif, ci_tcp_state* ts)
 
   ts->send_prequeue = CI_ILL_END;
   oo_atomic_set(&ts->send_prequeue_in, 0);
+  oo_atomic_set(&ts->send_prequeue_bytes, 0);
   ts->send_in = 0;
   ts->send_out = 0;
 
@@ -135,6 +139,10 @@ void ci_tcp_state_tcb_reinit_minimal(ci_netif* netif, ci_tcp_state* ts)
   ts->cwnd_extra = 0;
   ts->dup_acks = 0;
   ts->bytes_acked = 0;
+  ci_tcp_cc(ts)->init(netif, ts);
+#if CI_CFG_TCP_RACK
+  ci_tcp_rack_init(netif, ts);
+#endif
 
   /* ts->eff_mss is not cleared as might be used without lock on send path */
   ts->ssthresh = 0;
@@ -190,6 +198,9 @@ static void ci_tcp_state_tcb_reinit(ci_netif* netif, ci_tcp_state* ts,
   if( ts->tcpflags & CI_TCPT_FLAG_TSO )  ts->outgoing_hdrs_len += 12;
   ts->incoming_tcp_hdr_len = (ci_uint8)sizeof(ci_tcp_hdr);
   ts->c.tcp_defer_accept = OO_TCP_DEFER_ACCEPT_OFF;
+  ts->c.cc_algo = NI_OPTS(netif).tcp_cc;
+  ts->c.tfo_qlen = 0;
+  ts->c.notsent_lowat = 0;
 
   ci_tcp_state_connected_opts_init(netif, ts);
 
@@ -287,6 +298,8 @@ void ci_tcp_state_init(ci_netif* netif, ci_tcp_state* ts, int from_cache)
 #if CI_CFG_TIMESTAMPING
   ci_udp_recv_q_init(&ts->timestamp_q);
   ts->timestamp_q_pending = OO_PP_NULL;
+  ts->zerocopy_next_id = 0;
+  ts->zerocopy_n_pinned = 0;
 #endif
 
   /* Initialise this level. */
@@ -312,6 +325,8 @@ void ci_tcp_state_reinit(ci_netif* netif, ci_tcp_state* ts)
 #if CI_CFG_TIMESTAMPING
   ci_udp_recv_q_init(&ts->timestamp_q);
   ts->timestamp_q_pending = OO_PP_NULL;
+  ts->zerocopy_next_id = 0;
+  ts->zerocopy_n_pinned = 0;
 #endif
   /* Reinitialise this level. */
   ci_tcp_state_tcb_reinit(netif, ts, 0);
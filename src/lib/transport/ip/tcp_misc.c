@@ -191,12 +191,80 @@ void ci_tcp_state_verify_no_timers(ci_netif *ni, ci_tcp_state *ts)
 #if CI_CFG_TCP_SOCK_STATS
   chk(stats_tid);
 #endif
+#if CI_CFG_TCP_RACK
+  chk(rack_tid);
+#endif
 #undef chk
   ci_assert(OO_PP_IS_NULL(ts->pmtus));
 }
 #endif
 
 
+#if CI_CFG_TIMESTAMPING
+/* Releases the registrations of the MSG_ZEROCOPY sends in [pkt], whose
+ * completions will now never be read.  Pages which the NIC may still be
+ * reading are left for the tx completion of [pkt] to release, which passes
+ * a NULL [ts] as the socket may have gone by then. */
+void ci_tcp_zerocopy_release(ci_netif* ni, ci_tcp_state* ts,
+                             ci_ip_pkt_fmt* pkt)
+{
+  struct ci_pkt_zc_header* zch;
+  struct ci_pkt_zc_payload* zcp;
+
+  if( ! (pkt->flags & CI_PKT_FLAG_INDIRECT) )
+    return;
+  zch = oo_tx_zc_header(pkt);
+  OO_TX_FOR_EACH_ZC_PAYLOAD(ni, zch, zcp) {
+    if( ! zcp->is_remote || ! zcp->use_remote_cookie ||
+        ! zcp->is_msg_zerocopy || zcp->remote.app_cookie == 0 )
+      continue;
+    if( ts != NULL ) {
+      ci_assert_gt(ts->zerocopy_n_pinned, 0);
+      ci_atomic32_dec(&ts->zerocopy_n_pinned);
+    }
+    if( pkt->flags & CI_PKT_FLAG_TX_PENDING )
+      continue;
+#ifdef __KERNEL__
+    /* We may not sleep here. */
+    efab_tcp_helper_zc_unregister_buffers_deferred(
+                       netif2tcp_helper_resource(ni), zcp->remote.app_cookie);
+#else
+    ci_tcp_helper_zc_unregister_buffers(ni, zcp->remote.app_cookie);
+#endif
+    zcp->remote.app_cookie = 0;
+  }
+}
+
+
+static void ci_tcp_zerocopy_release_queue(ci_netif* ni, ci_tcp_state* ts,
+                                          ci_ip_pkt_queue* qu)
+{
+  oo_pkt_p id;
+  ci_ip_pkt_fmt* pkt;
+
+  for( id = qu->head; OO_PP_NOT_NULL(id); id = pkt->next ) {
+    pkt = PKT_CHK(ni, id);
+    ci_tcp_zerocopy_release(ni, ts, pkt);
+  }
+}
+
+
+/* Completions which have been read have released their registrations
+ * already, so this can walk the whole of the timestamp queue. */
+static void ci_tcp_zerocopy_release_timestamp_q(ci_netif* ni,
+                                                ci_tcp_state* ts)
+{
+  oo_pkt_p id;
+  ci_ip_pkt_fmt* pkt;
+
+  for( id = ts->timestamp_q.head; OO_PP_NOT_NULL(id); id = pkt->udp_rx_next ) {
+    pkt = PKT_CHK(ni, id);
+    ci_tcp_zerocopy_release(ni, ts, pkt);
+  }
+}
+#endif
+
+
 static void __ci_tcp_state_free(ci_netif *ni, ci_tcp_state *ts)
 {
   struct oo_p_dllink_state link;
@@ -222,6 +290,9 @@ static void __ci_tcp_state_free(ci_netif *ni, ci_tcp_state *ts)
   oo_p_dllink_del_init(ni, link);
   link = oo_p_dllink_sb(ni, &ts->s.b, &ts->s.reap_link);
   oo_p_dllink_del_init(ni, link);
+#if CI_CFG_TX_PACING
+  ci_tx_pace_cancel(ni, &ts->s);
+#endif
 
   citp_waitable_remove_from_epoll(ni, &ts->s.b, 1);
 
@@ -237,6 +308,7 @@ static void __ci_tcp_state_free(ci_netif *ni, ci_tcp_state *ts)
   ci_tcp_rx_queue_drop(ni, ts, &ts->recv2);
 
 #if CI_CFG_TIMESTAMPING
+  ci_tcp_zerocopy_release_timestamp_q(ni, ts);
   ci_udp_recv_q_drop(ni, &ts->timestamp_q);
   ts->timestamp_q_pending = OO_PP_NULL;
 #endif
@@ -531,6 +603,20 @@ int ci_tcp_parse_options(ci_netif* ni, ciip_tcp_rx_pkt* rxp,
       }
       if( topts )  topts->flags |= CI_TCPT_FLAG_SACK;
       break;
+    case CI_TCP_OPT_FASTOPEN:
+      /* An empty option is a cookie request.  A cookie of invalid length
+       * is ignored, as if there was no option. */
+      if( len != 2 && (len < 2 + CI_TCP_FASTOPEN_COOKIE_MIN ||
+                       len > 2 + CI_TCP_FASTOPEN_COOKIE_MAX || (len & 1)) ) {
+        LOG_U(log(LPF "FastOpen(bad length %d)", len));
+        break;
+      }
+      if( topts ) {
+        rxp->flags |= CI_TCPT_FLAG_TFO;
+        rxp->tfo_cookie = opt + 2;
+        rxp->tfo_cookie_len = len - 2;
+      }
+      break;
     default:
 #if CI_CFG_PORT_STRIPING
       if( opt[0] == NI_OPTS(ni).stripe_tcp_opt ) {
@@ -574,6 +660,13 @@ void ci_tcp_stop_timers(ci_netif* netif, ci_tcp_state* ts)
   ci_ip_timer_clear_ool(netif, &ts->zwin_tid);
   ci_ip_timer_clear_ool(netif, &ts->kalive_tid);
   ci_ip_timer_clear_ool(netif, &ts->cork_tid);
+#if CI_CFG_TCP_RACK
+  ci_ip_timer_clear_ool(netif, &ts->rack_tid);
+#endif
+#if CI_CFG_TX_PACING
+  /* Not a timer of its own, but the pacing timer would send. */
+  ci_tx_pace_cancel(netif, &ts->s);
+#endif
   if( OO_PP_NOT_NULL(ts->pmtus) ) {
     ci_pmtu_state_t* pmtus = ci_ni_aux_p2pmtus(netif, ts->pmtus);
     ci_ip_timer_clear_ool(netif, &pmtus->tid);
@@ -617,8 +710,14 @@ void ci_ip_queue_drop(ci_netif* netif, ci_ip_pkt_queue *qu)
 
 static void ci_tcp_tx_drop_queues(ci_netif* ni, ci_tcp_state* ts)
 {
+#if CI_CFG_TIMESTAMPING
+  ci_tcp_zerocopy_release_queue(ni, ts, &ts->retrans);
+#endif
   ci_tcp_retrans_drop(ni, ts);
   ci_tcp_sendmsg_enqueue_prequeue(ni, ts, CI_TRUE);
+#if CI_CFG_TIMESTAMPING
+  ci_tcp_zerocopy_release_queue(ni, ts, &ts->send);
+#endif
   ci_tcp_sendq_drop(ni, ts);
 
   /* Maintain invariants. */
@@ -1030,6 +1129,10 @@ void ci_tcp_recovered(ci_netif* ni, ci_tcp_state* ts)
   ts->congstate = CI_TCP_CONG_OPEN;
   ts->cwnd_extra = 0;
   ts->dup_acks = 0;
+#if CI_CFG_TCP_RACK
+  if( ci_tcp_rack_enabled(ni, ts) )
+    ci_tcp_rack_recovered(ni, ts);
+#endif
 
   LOG_TL(log(LNT_FMT "RECOVERED "TCP_SND_FMT" cwnd=%d ssthresh=%d rto=%d",
              LNT_PRI_ARGS(ni, ts), TCP_SND_PRI_ARG(ts),
@@ -0,0 +1,243 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* RACK loss detection (RFC 8985).
+ *
+ * With EF_TCP_RACK, a SACK connection takes a segment to be lost once a
+ * segment sent after it has been delivered, and it has been outstanding
+ * for longer than the RTT of that segment plus a reordering window.  This
+ * replaces the dupack threshold for entering fast recovery and limits which
+ * segments are retransmitted while in it.  The tail loss probe half of
+ * RACK-TLP is EF_TAIL_DROP_PROBE.
+ *
+ * Transmit times are kept per segment in pf.tcp_tx.xmit_time, in
+ * microseconds from the cached cycle counter, because timer ticks are too
+ * coarse to time a reordering window on a LAN.  The window is timed by
+ * [rack_tid] on the timer wheel, rounded up to whole ticks.
+ *
+ * DSACKs open the window as in the RFC, but also count as evidence of
+ * reordering: they show that a fast retransmit was spurious, which is what
+ * the reordering window is for.
+ */
+
+#include "ip_internal.h"
+
+
+#define LPF "TCP RACK "
+
+/* Recoveries without a DSACK before the reordering window shrinks back. */
+#define CI_TCP_RACK_REO_WND_PERSIST  16
+
+
+ci_inline int ci_tcp_rack_time_shift(ci_netif* ni)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  return its->ci_ip_time_frc2tick - its->ci_ip_time_frc2us;
+}
+
+
+/* Was the segment sent at [t1] ending at [seq1] sent after the one sent at
+ * [t2] ending at [seq2]?  Segments stamped in the same microsecond were
+ * sent in sequence order.
+ */
+ci_inline int ci_tcp_rack_sent_after(ci_iptime_t t1, ci_uint32 seq1,
+                                     ci_iptime_t t2, ci_uint32 seq2)
+{
+  return TIME_GT(t1, t2) || (t1 == t2 && SEQ_GT(seq1, seq2));
+}
+
+
+void ci_tcp_rack_init(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->tcpflags &=~ (CI_TCPT_FLAG_RACK_SAMPLE | CI_TCPT_FLAG_RACK_REORDER |
+                    CI_TCPT_FLAG_RACK_DSACK | CI_TCPT_FLAG_RACK_DEFERRED);
+  ts->rack_xmit_ts = 0;
+  ts->rack_end_seq = 0;
+  ts->rack_rtt = 0;
+  ts->rack_min_rtt = ~0u;
+  ts->rack_dsack_round = 0;
+  ts->rack_reo_wnd_mult = 1;
+  ts->rack_reo_wnd_persist = 0;
+}
+
+
+void ci_tcp_rack_delivered(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt)
+{
+  ci_iptime_t xmit_ts = pkt->pf.tcp_tx.xmit_time;
+  ci_uint32 end_seq = pkt->pf.tcp_tx.end_seq;
+  ci_uint32 rtt = ci_ip_time_now_us(ni) - xmit_ts;
+
+  if( ! (ts->tcpflags & CI_TCPT_FLAG_RACK_SAMPLE) ) {
+    if( pkt->flags & CI_PKT_FLAG_RTQ_RETRANS )
+      /* Nothing to tell which transmission this is for. */
+      return;
+  }
+  else if( ~pkt->flags & CI_PKT_FLAG_RTQ_RETRANS ) {
+    /* A segment that was sent once is delivered after one sent later.
+     * (RACK.fack in the RFC is the highest sequence delivered, but before
+     * any retransmits that is [rack_end_seq], and a retransmit is not
+     * evidence of reordering.) */
+    if( SEQ_LT(end_seq, ts->rack_end_seq) &&
+        ! (ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER) ) {
+      LOG_TL(log(LNT_FMT "RACK reordering %08x < %08x",
+                 LNT_PRI_ARGS(ni, ts), end_seq, ts->rack_end_seq));
+      ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+    }
+  }
+  else if( rtt < ts->rack_min_rtt ) {
+    /* Delivered too soon to be for the retransmit, so must be the
+     * original. */
+    return;
+  }
+
+  if( rtt < ts->rack_min_rtt )
+    ts->rack_min_rtt = rtt;
+
+  if( ! (ts->tcpflags & CI_TCPT_FLAG_RACK_SAMPLE) ||
+      ci_tcp_rack_sent_after(xmit_ts, end_seq,
+                             ts->rack_xmit_ts, ts->rack_end_seq) ) {
+    ts->rack_xmit_ts = xmit_ts;
+    ts->rack_end_seq = end_seq;
+    ts->rack_rtt = rtt;
+    ts->tcpflags |= CI_TCPT_FLAG_RACK_SAMPLE;
+  }
+}
+
+
+void ci_tcp_rack_dsack(ci_netif* ni, ci_tcp_state* ts)
+{
+  ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+
+  /* Open the window by a quarter of min RTT at most once per round trip. */
+  if( (ts->tcpflags & CI_TCPT_FLAG_RACK_DSACK) &&
+      SEQ_GE(tcp_snd_una(ts), ts->rack_dsack_round) )
+    ts->tcpflags &=~ CI_TCPT_FLAG_RACK_DSACK;
+  if( ts->tcpflags & CI_TCPT_FLAG_RACK_DSACK )
+    return;
+
+  ts->tcpflags |= CI_TCPT_FLAG_RACK_DSACK;
+  ts->rack_dsack_round = tcp_snd_nxt(ts);
+  if( ts->rack_reo_wnd_mult < 255 )
+    ++ts->rack_reo_wnd_mult;
+  ts->rack_reo_wnd_persist = CI_TCP_RACK_REO_WND_PERSIST;
+  LOG_TL(log(LNT_FMT "RACK DSACK reo_wnd_mult=%d",
+             LNT_PRI_ARGS(ni, ts), ts->rack_reo_wnd_mult));
+}
+
+
+void ci_tcp_rack_recovered(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ts->rack_reo_wnd_persist != 0 && --ts->rack_reo_wnd_persist == 0 )
+    ts->rack_reo_wnd_mult = 1;
+}
+
+
+/* Returns the reordering window in microseconds. */
+static ci_uint32 ci_tcp_rack_reo_wnd(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_uint32 wnd, max;
+
+  /* Until reordering has been seen, behave as the dupack threshold does
+   * once it has been reached, and in recovery. */
+  if( ! (ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER) &&
+      (ts->dup_acks >= ci_tcp_base_dupack_thresh(ts) ||
+       (ts->congstate != CI_TCP_CONG_OPEN &&
+        ts->congstate != CI_TCP_CONG_NOTIFIED)) )
+    return 0;
+
+  wnd = (ts->rack_min_rtt >> 2) * ts->rack_reo_wnd_mult;
+
+  /* The RFC limits the window to SRTT.  Ours is in ticks, which may round
+   * it to zero, so allow at least the RTT of the latest delivery. */
+  max = CI_MAX((ci_uint32) tcp_srtt(ts) << ci_tcp_rack_time_shift(ni),
+               ts->rack_rtt);
+  return CI_MIN(wnd, max);
+}
+
+
+static void ci_tcp_rack_timer_set(ci_netif* ni, ci_tcp_state* ts,
+                                  ci_uint32 us)
+{
+  ci_iptime_t t;
+
+  ci_assert(!(ts->s.b.state & CI_TCP_STATE_NO_TIMERS));
+  t = ci_tcp_time_now(ni) + (us >> ci_tcp_rack_time_shift(ni)) + 1;
+  if( ci_ip_timer_pending(ni, &ts->rack_tid) )
+    ci_ip_timer_modify(ni, &ts->rack_tid, t);
+  else
+    ci_ip_timer_set(ni, &ts->rack_tid, t);
+}
+
+
+int ci_tcp_rack_is_lost(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt)
+{
+  ci_uint32 timeout;
+  ci_int32 elapsed;
+
+  ci_assert(ci_tcp_rack_enabled(ni, ts));
+  ci_assert(~pkt->flags & CI_PKT_FLAG_RTQ_SACKED);
+
+  /* Nothing sent after [pkt] has been delivered, so no news. */
+  if( ! (ts->tcpflags & CI_TCPT_FLAG_RACK_SAMPLE) ||
+      ! ci_tcp_rack_sent_after(ts->rack_xmit_ts, ts->rack_end_seq,
+                               pkt->pf.tcp_tx.xmit_time,
+                               pkt->pf.tcp_tx.end_seq) )
+    return 0;
+
+  timeout = ts->rack_rtt + ci_tcp_rack_reo_wnd(ni, ts);
+  elapsed = ci_ip_time_now_us(ni) - pkt->pf.tcp_tx.xmit_time;
+  if( elapsed >= 0 && (ci_uint32) elapsed >= timeout )
+    return 1;
+
+  LOG_TV(log(LNT_FMT "RACK %08x-%08x lost in %uus", LNT_PRI_ARGS(ni, ts),
+             pkt->pf.tcp_tx.start_seq, pkt->pf.tcp_tx.end_seq,
+             timeout - CI_MAX(elapsed, 0)));
+  ci_tcp_rack_timer_set(ni, ts, timeout - CI_MAX(elapsed, 0));
+  return 0;
+}
+
+
+int ci_tcp_rack_head_lost(ci_netif* ni, ci_tcp_state* ts)
+{
+  if( ci_ip_queue_is_empty(&ts->retrans) )
+    return 0;
+
+  if( ci_tcp_rack_is_lost(ni, ts, PKT_CHK(ni, ts->retrans.head)) ) {
+    ts->tcpflags &=~ CI_TCPT_FLAG_RACK_DEFERRED;
+    CITP_STATS_NETIF_INC(ni, tcp_rack_recoveries);
+    return 1;
+  }
+
+  /* The dupack threshold would have retransmitted by now.  If the segment
+   * turns up in time, we've avoided a spurious retransmit. */
+  if( ts->dup_acks >= ci_tcp_base_dupack_thresh(ts) )
+    ts->tcpflags |= CI_TCPT_FLAG_RACK_DEFERRED;
+  return 0;
+}
+
+
+void ci_tcp_timeout_rack(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_assert(ts->s.b.state != CI_TCP_CLOSED);
+
+  if( ci_ip_queue_is_empty(&ts->retrans) || ! ci_tcp_rack_enabled(ni, ts) )
+    return;
+
+  CITP_STATS_NETIF_INC(ni, tcp_rack_timeouts);
+  LOG_TL(log(LNT_FMT "RACK timeout %s "TCP_SND_FMT, LNT_PRI_ARGS(ni, ts),
+             congstate_str(ts), TCP_SND_PRI_ARG(ts)));
+
+  switch( ts->congstate ) {
+  case CI_TCP_CONG_OPEN:
+  case CI_TCP_CONG_NOTIFIED:
+    ci_tcp_maybe_enter_fast_recovery(ni, ts);
+    break;
+  case CI_TCP_CONG_FAST_RECOV:
+    ci_tcp_retrans_recover(ni, ts, 0);
+    break;
+  default:
+    /* RTO recovery retransmits everything, and COOLING has retransmitted
+     * all that it is going to. */
+    break;
+  }
+}
@@ -227,6 +227,8 @@ ci_tcp_recvmsg_get_nopeek(int peek_off, ci_tcp_state *ts, ci_netif *netif,
     /* for now run every time we update rcv_delivered */
     ci_tcp_rcvbuf_drs(netif, ts);
   if( oo_offbuf_left(&(*pkt)->buf) == 0 ) {
+    ci_netif_lat_hist_sample(netif, &ts->s, CI_LAT_HIST_RX,
+                             (*pkt)->tstamp_frc);
     if( total == max_bytes || OO_PP_IS_NULL((*pkt)->next) )
       /* We've emptied the receive queue. Return non-zero to report this
        * to the calling function, so that it can return appropriately. */
@@ -283,6 +285,52 @@ ci_tcp_fill_recv_timestamp(struct tcp_recv_info* rinf, ci_ip_pkt_fmt* pkt)
       msg->msg_controllen = 0;
   }
 }
+
+
+/* Reports the completions of the zero-copy sends in [pkt] from the timestamp
+ * queue. */
+void ci_tcp_zc_complete_to_cmsg(ci_netif* ni, ci_tcp_state* ts,
+                                ci_ip_pkt_fmt* pkt,
+                                struct cmsg_state* cmsg_state)
+{
+  struct ci_pkt_zc_header* zch = oo_tx_zc_header(pkt);
+  struct ci_pkt_zc_payload* zcp;
+  ci_uint32 zc_lo = 0, zc_hi = 0;
+  int zc_copied = 0, zc_n = 0, copied;
+
+  OO_TX_FOR_EACH_ZC_PAYLOAD(ni, zch, zcp) {
+    if( ! zcp->is_remote || ! zcp->use_remote_cookie )
+      continue;
+    if( ! zcp->is_msg_zerocopy ) {
+      ci_put_cmsg(cmsg_state, SOL_IP, ONLOAD_SO_ONLOADZC_COMPLETE,
+                  sizeof(zcp->remote.app_cookie), &zcp->remote.app_cookie);
+      continue;
+    }
+    /* MSG_ZEROCOPY: app_cookie is the registration of the pages of this
+     * send, or zero if the data was copied.  Consecutive sends are reported
+     * as a single range, as Linux does. */
+    copied = zcp->remote.app_cookie == 0;
+    if( ! copied ) {
+      ci_tcp_helper_zc_unregister_buffers(ni, zcp->remote.app_cookie);
+      /* Not to be released again when the socket is freed */
+      zcp->remote.app_cookie = 0;
+      ci_assert_gt(ts->zerocopy_n_pinned, 0);
+      ci_atomic32_dec(&ts->zerocopy_n_pinned);
+    }
+    if( zc_n && zcp->zerocopy_id == zc_hi + 1 && copied == zc_copied ) {
+      zc_hi = zcp->zerocopy_id;
+    }
+    else {
+      if( zc_n )
+        ci_ip_zerocopy_to_cmsg(&ts->s, cmsg_state, zc_lo, zc_hi, zc_copied);
+      zc_lo = zc_hi = zcp->zerocopy_id;
+      zc_copied = copied;
+      zc_n = 1;
+    }
+  }
+  if( zc_n )
+    ci_ip_zerocopy_to_cmsg(&ts->s, cmsg_state, zc_lo, zc_hi, zc_copied);
+}
 #endif
 #endif
 
@@ -1007,17 +1055,8 @@ static inline int ci_tcp_recvmsg_impl(const ci_tcp_recvmsg_args* a,
           goto timestamp_q_check;
 
       }
-      if( pkt->flags & CI_PKT_FLAG_INDIRECT ) {
-        struct ci_pkt_zc_header* zch = oo_tx_zc_header(pkt);
-        struct ci_pkt_zc_payload* zcp;
-        OO_TX_FOR_EACH_ZC_PAYLOAD(ni, zch, zcp) {
-          if( zcp->is_remote && zcp->use_remote_cookie ) {
-            ci_put_cmsg(&cmsg_state, SOL_IP, ONLOAD_SO_ONLOADZC_COMPLETE,
-                        sizeof(zcp->remote.app_cookie),
-                        &zcp->remote.app_cookie);
-          }
-        }
-      }
+      if( pkt->flags & CI_PKT_FLAG_INDIRECT )
+        ci_tcp_zc_complete_to_cmsg(ni, ts, pkt, &cmsg_state);
 
       ci_ip_cmsg_finish(&cmsg_state);
       rinf.msg_flags |= MSG_ERRQUEUE;
@@ -704,7 +704,8 @@ ci_inline unsigned ci_tcp_paws_check(ci_netif* netif, ci_uint32 tsval,
 
 
 /* function to open the congestion window following the
-** reception of an ack for new data. Implements RFC3465 (ABC)
+** reception of an ack for new data.  Slow start implements RFC3465 (ABC);
+** congestion avoidance is up to the socket's congestion control algorithm.
 */
 ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
 {
@@ -718,28 +719,7 @@ ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
   else
 #endif
   if( ts->cwnd >= ts->ssthresh ) {
-    /* Hack - Increase less aggresively on small round trip times */
-#if CI_CFG_CONG_AVOID_SCALE_BACK
-    unsigned tmp = 0, cwnd_scaled;
-    /* tcp_srtt(ts) would relatively easy exceed 32 for a round trip time
-     * on longer links */
-    if( tcp_srtt(ts) < 32 )
-      tmp = NI_OPTS(ni).cong_avoid_scale_back >> tcp_srtt(ts);
-    cwnd_scaled = CI_MAX(1U, tmp) * ts->cwnd;
-#else
-    unsigned cwnd_scaled = ts->cwnd;
-#endif
-    /* Congestion avoidance.  RFC3465 says: increase the congestion window
-    ** by one segment each RTT.  i.e. wait for bytes_acked to be > cwnd
-    ** (which takes one RTT), then reset bytes_acked by subtracting the
-    ** cwnd from it, and add one segment to cwnd.
-    */
-    LOG_TV(log(LPF "%d OPENCWND: CA eff_mss=%u bytes_acked=%u cwnd=%u",
-               S_FMT(ts), tcp_eff_mss(ts), ts->bytes_acked, ts->cwnd));
-    if( ts->bytes_acked >= cwnd_scaled ) {
-      ts->bytes_acked -= cwnd_scaled;
-      ts->cwnd += tcp_eff_mss(ts);
-    }
+    ci_tcp_cc(ts)->cong_avoid(ni, ts);
   }
   else {
     /* Slow-start. */
@@ -774,7 +754,7 @@ ci_inline void ci_tcp_opencwnd(ci_netif *ni, ci_tcp_state* ts)
 
 static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
 {
-  ts->ssthresh = ci_tcp_losswnd(ts);
+  ts->ssthresh = ci_tcp_cc(ts)->ssthresh(ni, ts);
   ts->cwnd = ts->ssthresh + ci_tcp_base_dupack_thresh(ts) * tcp_eff_mss(ts);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).loss_min_cwnd);
   ts->cwnd = CI_MAX(ts->cwnd, NI_OPTS(ni).min_cwnd);
@@ -782,13 +762,21 @@ static void ci_tcp_reset_cwnd_on_loss(ci_netif* ni, ci_tcp_state* ts)
 }
 
 
-/* Enters fast recovery if we've received enough dupacks.  Returns non-zero
+/* Enters fast recovery if we've received enough dupacks, or with RACK if
+ * the segment at the head of the retransmit queue is lost.  Returns non-zero
  * iff we enter fast recovery. */
 int /*bool*/ ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
 {
   ci_uint32 dup_thresh = ci_tcp_base_dupack_thresh(ts);
   ci_ip_pkt_fmt *pkt;
 
+#if CI_CFG_TCP_RACK
+  if( ci_tcp_rack_enabled(ni, ts) ) {
+    if( ! ci_tcp_rack_head_lost(ni, ts) )
+      return 0;
+  }
+  else
+#endif
   if( ts->dup_acks == 0 ) {
     return 0;
   }
@@ -1205,13 +1193,16 @@ ci_tcp_rx_sack_process_block(ci_netif* ni, ci_tcp_state* ts, unsigned start,
     pkt = start_block;
   else
     pkt = start_pkt;
-  while( pkt != end_pkt ) {
+  while( 1 ) {
+#if CI_CFG_TCP_RACK
+    if( ~pkt->flags & CI_PKT_FLAG_RTQ_SACKED && ci_tcp_rack_enabled(ni, ts) )
+      ci_tcp_rack_delivered(ni, ts, pkt);
+#endif
     pkt->pf.tcp_tx.block_end = next_pp;
     pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+    if( pkt == end_pkt )  break;
     pkt = PKT_CHK(ni, pkt->next);
   }
-  pkt->pf.tcp_tx.block_end = next_pp;
-  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
 
   /* We took early exits from this function when this SACK block was contained
    * within an earlier one, so we know that we have recorded new SACK
@@ -1260,6 +1251,10 @@ ci_inline int ci_tcp_rx_dsack_check(ci_netif* ni, ci_tcp_state* ts,
     CITP_STATS_NETIF(++ni->state->stats.tail_drop_probe_unnecessary);
     ts->tcpflags &=~ CI_TCPT_FLAG_TAIL_DROP_MARKED;
   }
+#endif
+#if CI_CFG_TCP_RACK
+  if( rc && ci_tcp_rack_enabled(ni, ts) )
+    ci_tcp_rack_dsack(ni, ts);
 #endif
   return rc;
 }
@@ -1413,6 +1408,11 @@ static void ci_tcp_rx_free_acked_bufs(ci_netif* netif, ci_tcp_state* ts,
 
     ci_assert(p->refcount > 0);
 
+#if CI_CFG_TCP_RACK
+    if( ~p->flags & CI_PKT_FLAG_RTQ_SACKED && ci_tcp_rack_enabled(netif, ts) )
+      ci_tcp_rack_delivered(netif, ts, p);
+#endif
+
 #if CI_CFG_TIMESTAMPING
     if( (p->flags & CI_PKT_FLAG_TX_TIMESTAMPED &&
          onload_timestamping_want_tx_nic(ts->s.timestamping_flags)) ||
@@ -1592,9 +1592,27 @@ static void ci_tcp_rx_handle_ack(ci_tcp_state* ts, ci_netif* netif,
     /* Free TX buffers that have been acked. */
     ci_tcp_rx_free_acked_bufs(netif, ts, rxp);
 
+#if CI_CFG_TCP_RACK
+    if( ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED ) {
+      /* The segment that the dupack threshold would have retransmitted
+       * turned up within the reordering window. */
+      ts->tcpflags &=~ CI_TCPT_FLAG_RACK_DEFERRED;
+      if( ts->congstate == CI_TCP_CONG_OPEN ||
+          ts->congstate == CI_TCP_CONG_NOTIFIED )
+        CITP_STATS_NETIF_INC(netif, tcp_rack_spurious_avoided);
+    }
+#endif
+
     if( ts->congstate != CI_TCP_CONG_OPEN && ts->congstate != CI_TCP_CONG_NOTIFIED)
       /* Congested: try to recover. */
       ci_tcp_try_cwndrecover(ts, netif, pkt);
+#if CI_CFG_TCP_RACK
+    else if( (rxp->flags & CI_TCP_SACKED) && ci_tcp_rack_enabled(netif, ts) &&
+             ci_ip_queue_not_empty(&ts->retrans) )
+      /* RACK does not need dupacks: an ACK that SACKs segments sent after
+       * the new head may show it to be lost. */
+      ci_tcp_maybe_enter_fast_recovery(netif, ts);
+#endif
 
     if( NI_OPTS(netif).tcp_sndbuf_mode == 2 &&
 	ci_tcp_should_expand_sndbuf(netif, ts) )
@@ -2770,6 +2788,84 @@ static void handle_rx_synrecv_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
 ** sends a SYN-ACK, inserts the connection
 ** into the filters, and will be moved to the accept queue when the
 ** SYN-ACK is acknowledged */
+/* Decides what to do with the Fast Open option in a SYN to a TCP_FASTOPEN
+ * listening socket.  Returns true if the data on the SYN is to be accepted.
+ * Otherwise the data is dropped, and the SYN-ACK carries a fresh cookie if
+ * the peer asked for one or sent an invalid one.
+ */
+static int handle_rx_listen_fastopen(ci_netif* netif,
+                                     ci_tcp_socket_listen* tls,
+                                     ci_tcp_state_synrecv* tsr,
+                                     ciip_tcp_rx_pkt* rxp)
+{
+  if( rxp->tfo_cookie_len == 0 ) {
+    CITP_STATS_NETIF_INC(netif, tfo_cookie_req_rx);
+    tsr->tcpopts.flags |= CI_TCPT_FLAG_TFO;
+    return 0;
+  }
+  if( ! ci_tcp_fastopen_cookie_ok(netif, &tsr->r_addr, rxp->tfo_cookie,
+                                  rxp->tfo_cookie_len) ) {
+    LOG_TC(log(LNT_FMT "SYN with invalid Fast Open cookie",
+               LNT_PRI_ARGS(netif, tls)));
+    CITP_STATS_NETIF_INC(netif, tfo_cookie_invalid);
+    tsr->tcpopts.flags |= CI_TCPT_FLAG_TFO;
+    return 0;
+  }
+  if( rxp->pkt->pf.tcp_rx.pay_len == 0 )
+    return 0;
+  if( ! ci_tcp_acceptq_tfo_ok(tls) ) {
+    CITP_STATS_NETIF_INC(netif, tfo_qlen_overflow);
+    return 0;
+  }
+  return 1;
+}
+
+
+/* Promote [tsr] straight to the accept queue, with the data from the SYN
+ * in its receive queue, and send a SYN-ACK which acknowledges the data.
+ * Returns false, without consuming [rxp->pkt], if the promotion fails.
+ */
+static int handle_rx_listen_fastopen_data(ci_netif* netif,
+                                          ci_tcp_socket_listen* tls,
+                                          ci_tcp_state_synrecv* tsr,
+                                          ci_ip_cached_hdrs* ipcache,
+                                          ciip_tcp_rx_pkt* rxp)
+{
+  ci_ip_pkt_fmt* pkt = rxp->pkt;
+  ci_ip_pkt_fmt* tx_pkt;
+  ci_tcp_state_synrecv synack_tsr;
+  ci_tcp_state* ts;
+
+  /* Promotion frees [tsr], so keep what the SYN-ACK needs. */
+  synack_tsr = *tsr;
+  synack_tsr.rcv_nxt = pkt->pf.tcp_rx.end_seq;
+  tsr->tcpopts.flags |= CI_TCPT_FLAG_TFO_DATA;
+  if( ci_tcp_listenq_try_promote(netif, tls, tsr, ipcache, pkt, &ts) < 0 ) {
+    tsr->tcpopts.flags &= ~CI_TCPT_FLAG_TFO_DATA;
+    return 0;
+  }
+  ci_assert_flags(ts->tcpflags, CI_TCPT_FLAG_TFO);
+
+  /* Unlike the usual promotion on the handshake ACK, we know the peer's
+   * window already, and may reply before the handshake completes. */
+  ci_tcp_set_snd_max(ts, rxp->seq, tcp_snd_una(ts), pkt->pf.tcp_rx.window);
+  CITP_STATS_NETIF_INC(netif, tfo_syn_data_accepted);
+  LOG_TC(log(LNTS_FMT "accepted %d bytes of Fast Open data",
+             LNTS_PRI_ARGS(netif, ts), pkt->pf.tcp_rx.pay_len));
+
+  /* The receive queue takes one reference, and the SYN-ACK needs its own
+   * packet. */
+  ci_netif_pkt_hold(netif, pkt);
+  rxp->seq += 1;
+  ci_tcp_rx_deliver_to_recvq(ts, netif, rxp);
+  tx_pkt = ci_netif_pkt_rx_to_tx(netif, pkt);
+  if( tx_pkt != NULL )
+    ci_tcp_synrecv_send(netif, tls, &synack_tsr, tx_pkt,
+                        CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK, ipcache);
+  return 1;
+}
+
+
 static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
                              ciip_tcp_rx_pkt* rxp, int already_parsed)
 {
@@ -2781,6 +2877,7 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
   ci_ip_cached_hdrs ipcache;
   oo_sp local_peer = OO_SP_NULL;
   int do_syncookie = 0;
+  int tfo_data = 0;
 #if CI_CFG_IPV6
   int af = oo_pkt_af(pkt);
 #endif
@@ -2915,7 +3012,7 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
 #endif
     sock_cp.lport_be16 = tcp->tcp_dest_be16;
     sock_cp.sock_cp_flags |= OO_SCP_BOUND_ADDR;
-    cicp_user_retrieve(netif, &ipcache, &sock_cp);
+    ci_tcp_reply_retrieve(netif, &ipcache, &sock_cp);
   }
 
   switch( ipcache.status ) {
@@ -3076,7 +3173,8 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
 
   /* It is legal to pass data with a SYN, but it is not desirable to keep
   ** the data because it provides a simple way to do a DOS.  So we bin the
-  ** data, and the other end can retransmit it.
+  ** data, and the other end can retransmit it.  The exception is a SYN
+  ** with a valid Fast Open cookie, which is handled below.
   */
   if( pkt->pf.tcp_rx.pay_len ) {
     LOG_U(log(LPF "%d LISTEN SYN with data (%d bytes)", S_FMT(tls),
@@ -3165,6 +3263,11 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
     tsr->rcv_wscl = 0;
   }
 
+  if( (rxp->flags & CI_TCPT_FLAG_TFO) && tls->c.tfo_qlen != 0 &&
+      ! do_syncookie && OO_SP_IS_NULL(tsr->local_peer) &&
+      (NI_OPTS(netif).tcp_fastopen & CI_TCP_FASTOPEN_SERVER) )
+    tfo_data = handle_rx_listen_fastopen(netif, tls, tsr, rxp);
+
   if( do_syncookie )
     ci_tcp_syncookie_syn(netif, tls, tsr);
   else {
@@ -3186,6 +3289,9 @@ static void handle_rx_listen(ci_netif* netif, ci_tcp_socket_listen* tls,
 
   /* send SYN-ACK packet */
   CI_TCP_STATS_INC_PASSIVE_OPENS( netif );
+  if( tfo_data &&
+      handle_rx_listen_fastopen_data(netif, tls, tsr, &ipcache, rxp) )
+    return;
   if( OO_SP_NOT_NULL(tsr->local_peer) )
     ci_netif_pkt_hold(netif, pkt);
   tx_pkt = ci_netif_pkt_rx_to_tx(netif, pkt);
@@ -3325,11 +3431,39 @@ static int handle_syn_sent_opts(ci_netif* netif, ci_tcp_state* ts,
 }
 
 
+/* Handle the SYN-ACK in reply to a SYN with a Fast Open option.  Returns
+ * true if the SYN carried data which the server did not acknowledge.
+ */
+static int handle_syn_sent_fastopen(ci_netif* netif, ci_tcp_state* ts,
+                                    ciip_tcp_rx_pkt* rxp)
+{
+  ci_ip_pkt_fmt* syn = PKT_CHK(netif, ts->retrans.head);
+
+  ts->tcpflags &= ~CI_TCPT_FLAG_TFO;
+  if( (rxp->flags & CI_TCPT_FLAG_TFO) && rxp->tfo_cookie_len > 0 ) {
+    ci_addr_t raddr = ipcache_raddr(&ts->s.pkt);
+    ci_tcp_fastopen_cache_put(netif, &raddr,
+                              rxp->tfo_cookie, rxp->tfo_cookie_len);
+  }
+
+  if( SEQ_SUB(syn->pf.tcp_tx.end_seq, syn->pf.tcp_tx.start_seq) == 1 )
+    return 0;
+  if( SEQ_EQ(rxp->ack, syn->pf.tcp_tx.end_seq) ) {
+    CITP_STATS_NETIF_INC(netif, tfo_syn_data_acked);
+    return 0;
+  }
+  LOG_TC(log(LNTS_FMT "Fast Open data not acked", LNTS_PRI_ARGS(netif, ts)));
+  CITP_STATS_NETIF_INC(netif, tfo_syn_data_rejected);
+  return 1;
+}
+
+
 static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
                                ciip_tcp_rx_pkt* rxp)
 {
   ci_ip_pkt_fmt* pkt = rxp->pkt;
   ci_tcp_hdr* tcp = rxp->tcp;
+  int tfo_rejected = 0;
 
   /* RST handled elsewhere; we shouldn't see it here. */
   ci_assert(~tcp->tcp_flags & CI_TCP_FLAG_RST);
@@ -3410,6 +3544,8 @@ static void handle_rx_syn_sent(ci_netif* netif, ci_tcp_state* ts,
   */
 
   if( handle_syn_sent_opts(netif, ts, rxp) < 0 ) return;
+  if( ts->tcpflags & CI_TCPT_FLAG_TFO )
+    tfo_rejected = handle_syn_sent_fastopen(netif, ts, rxp);
 
   /* remove SYN (and any sent data) from retransmission queue
   ** and seed RTT */
@@ -3479,6 +3615,9 @@ set_isn:
              S_FMT(ts), RCV_WND_ARGS(ts),
              tcp_snd_una(ts), tcp_snd_nxt(ts), ts->snd_max, tcp_enq_nxt(ts)));
 
+  if( tfo_rejected )
+    ci_tcp_fastopen_retrans_syn_data(netif, ts);
+
   /* Send any data that was enqueued in advance. */
   if( ci_tcp_sendq_not_empty(ts) ) {
     ci_netif_pkt_release_rx(netif, pkt);
@@ -3998,12 +4137,45 @@ static void handle_unacceptable_seq(ci_netif* netif, ci_tcp_state* ts,
 }
 
 
+/* Sends the ACK forced by a segment which handle_rx_slow() has just
+ * processed, or with EF_TCP_ACK_COALESCE leaves an ACK for in-order data to
+ * ci_tcp_rx_post_poll().  [was_forced] is true if an earlier segment in this
+ * poll had already left one there.
+ */
+void ci_tcp_rx_forced_ack(ci_netif* netif, ci_tcp_state* ts, int in_order,
+                          int was_forced, int do_update_wnd)
+{
+  ci_ip_pkt_fmt* pkt;
+
+  ci_assert(TCP_ACK_FORCED(ts));
+  if( in_order && TCP_ACK_MAY_COALESCE(netif, ts) ) {
+    /* ci_tcp_rx_post_poll() sends one ACK for everything delivered by
+    ** this poll.
+    */
+    if( was_forced )
+      CITP_STATS_NETIF_INC(netif, tcp_acks_coalesced);
+    else
+      CITP_STATS_NETIF_INC(netif, tcp_acks_deferred);
+    return;
+  }
+
+  /* ACK was forced.  I assuming for now that it would be a bad idea to
+  ** piggy-back this ACK onto a segment with payload, since then it can't be
+  ** interpreted as a dupack.
+  */
+  pkt = ci_netif_pkt_alloc(netif, 0);
+  if( pkt )  ci_tcp_send_ack_rx(netif, ts, pkt, CI_FALSE, do_update_wnd);
+}
+
+
 static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
 			   ciip_tcp_rx_pkt* rxp)
 {
   ci_ip_pkt_fmt* pkt = rxp->pkt;
   ci_tcp_hdr* tcp = rxp->tcp;
   int do_update_wnd = CI_TRUE;
+  int /*bool*/ in_order = CI_TRUE;
+  int /*bool*/ ack_deferred = TCP_ACK_FORCED(ts);
 
   CI_IP_SOCK_STATS_INC_RXSLOW( ts );
   ci_assert(ts->s.b.state != CI_TCP_LISTEN);
@@ -4181,6 +4353,7 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
        * would block our ability to receive and mark the socket as SHUT_RD,
        * which would make is always-ready even when it's not */
       do_update_wnd = CI_FALSE;
+      in_order = CI_FALSE;
       ci_tcp_rx_enqueue_ooo(netif, ts, rxp);
       if( ! ci_ip_queue_is_empty(&ts->rob) )
         ci_tcp_rx_deliver_rob(netif, ts);
@@ -4316,6 +4489,7 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
           CITP_TCP_FASTSTART(ts->faststart_acks =
                                NI_OPTS(netif).tcp_faststart_loss);
           do_update_wnd = CI_FALSE;
+          in_order = CI_FALSE;
           if( ts->acks_pending ) {
             /* We have a delayed-ack in hand.  We are entitled to send this
             ** as well as forcing an ack for the new segment.  Should speed
@@ -4344,6 +4518,7 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
       }
       else if( ci_tcp_rx_enqueue_ooo(netif, ts, rxp) ) {
         do_update_wnd = CI_FALSE;
+        in_order = CI_FALSE;
         TCP_FORCE_ACK(ts);
       }
     }
@@ -4357,14 +4532,8 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
       ci_netif_pkt_release_rx(netif, pkt);
     }
 
-    if( TCP_ACK_FORCED(ts) ) {
-      /* ACK was forced.  I assuming for now that it would be a bad idea to
-      ** piggy-back this ACK onto a segment with payload, since then it
-      ** can't be interpreted as a dupack.
-      */
-      pkt = ci_netif_pkt_alloc(netif, 0);
-      if( pkt )  ci_tcp_send_ack_rx(netif, ts, pkt, CI_FALSE, do_update_wnd);
-    }
+    if( TCP_ACK_FORCED(ts) )
+      ci_tcp_rx_forced_ack(netif, ts, in_order, ack_deferred, do_update_wnd);
 
     /* May need to advance TX or send ACK. */
     ts->s.b.sb_flags |= CI_SB_FLAG_TCP_POST_POLL;
@@ -4468,6 +4637,18 @@ static void handle_rx_slow(ci_tcp_state* ts, ci_netif* netif,
     return;
   }
 
+  /* A retransmitted SYN, after we accepted Fast Open data from the
+   * original. */
+  if( CI_UNLIKELY(ts->tcpflags & CI_TCPT_FLAG_TFO) &&
+      (ts->tcpflags & CI_TCPT_FLAG_PASSIVE_OPENED) &&
+      (tcp->tcp_flags & (CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK))
+      == CI_TCP_FLAG_SYN &&
+      SEQ_EQ(rxp->seq + 1, ts->stats.rx_isn) ) {
+    if( ! ci_tcp_send_fastopen_synack(netif, ts, pkt) )
+      ci_netif_pkt_release_rx(netif, pkt);
+    return;
+  }
+
   /* Should we DSACK it? */
   if( NI_OPTS(netif).use_dsack && (ts->tcpflags & CI_TCPT_FLAG_SACK) &&
       SEQ_LE(pkt->pf.tcp_rx.end_seq, tcp_rcv_nxt(ts)) &&
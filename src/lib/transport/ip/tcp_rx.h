@@ -75,7 +75,7 @@ ci_inline void ci_tcp_rx_post_poll(ci_netif* ni, ci_tcp_state* ts)
 
   if( ts->acks_pending ) {
 #ifndef NDEBUG
-    if( TCP_ACK_FORCED(ts) )
+    if( TCP_ACK_FORCED(ts) && ! NI_OPTS(ni).tcp_ack_coalesce )
       ci_log("%s: "NTS_FMT "ACK_FORCED flag set unexpectedly: %x", 
              __FUNCTION__, NTS_PRI_ARGS(ni, ts), ts->acks_pending);
 #endif
@@ -85,7 +85,9 @@ ci_inline void ci_tcp_rx_post_poll(ci_netif* ni, ci_tcp_state* ts)
         ci_tcp_send_ack_loopback(ni, ts);
       return;
     }
-    if( ci_tcp_need_ack(ni, ts) ) {
+    /* ACK_FORCED is set here when the ACK was left to us by
+     * EF_TCP_ACK_COALESCE. */
+    if( TCP_ACK_FORCED(ts) || ci_tcp_need_ack(ni, ts) ) {
       ci_ip_pkt_fmt* pkt = ci_netif_pkt_alloc(ni, 0);
       if(CI_LIKELY( pkt != NULL )) {
         ci_tcp_send_ack(ni, ts, pkt, CI_FALSE);
@@ -19,10 +19,11 @@
 #include <ci/internal/crc_offload_prefix.h>
 
 #if CI_CFG_NVME_LOCAL_CRC_MODE
-#include "crc32c.h"
+#include <ci/tools/crc32c.h>
 #endif
 
 #if !defined(__KERNEL__)
+#include <ci/efhw/common.h>
 #include <sys/socket.h>
 #include <onload/extensions_zc.h>
 #include <onload/extensions_zc_hlrx.h>
@@ -157,6 +158,8 @@ ci_inline void __ci_tcp_tx_pkt_init(ci_ip_pkt_fmt* pkt, int hdrlen, int mss)
   pkt->buf_len = pkt->pay_len = oo_tx_ether_hdr_size(pkt) + hdrlen;
   pkt->pf.tcp_tx.start_seq = hdrlen;
   pkt->pf.tcp_tx.end_seq = 0;
+  /* When latency histograms are enabled, the time of the send call */
+  pkt->tstamp_frc = 0;
 }
 
 
@@ -181,6 +184,7 @@ int ci_tcp_sendmsg_fill_pkt(ci_netif* ni, ci_tcp_state* ts,
   ci_assert(pkt);
   ci_assert(! ci_iovec_ptr_is_empty_proper(piov));
   ci_tcp_tx_pkt_init(pkt, hdrlen, maxlen);
+  pkt->tstamp_frc = ci_netif_lat_hist_tx_stamp(ni);
   oo_pkt_filler_init(&sinf->pf, pkt,
                      (uint8_t*) oo_tx_l3_hdr(pkt) + hdrlen);
 
@@ -1007,9 +1011,11 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
   ci_assert_ge(pkt->pio_addr, 0);
 
   if( ci_ip_queue_is_empty(&ts->send) && ef_vi_transmit_space(vi) > 0 &&
-      ci_tcp_inflight(ts) + ts->smss < CI_MIN(ts->cwnd, tcp_snd_wnd(ts)) ) {
+      ci_tcp_inflight(ts) + ts->smss < CI_MIN(ts->cwnd, tcp_snd_wnd(ts)) &&
+      ! ci_tcp_may_pace(ni, ts) ) {
     /* Sendq is empty, TXQ is not full, and send window allows us to
-     * send the requested amount of data, so go ahead and send
+     * send the requested amount of data, so go ahead and send.  Paced
+     * connections take the normal path, which checks the pacing rate.
      */
 
     if( CI_BSWAP_BE32(tcp->tcp_seq_be32) != tcp_enq_nxt(ts) ) {
@@ -1032,6 +1038,10 @@ ci_tcp_tmpl_update(ci_netif* ni, ci_tcp_state* ts,
       unsigned now = ci_tcp_time_now(ni);
       ci_tcp_tx_opt_tso(&tcp_opts, now, ts->tsrecent);
     }
+#if CI_CFG_TCP_RACK
+    if( NI_OPTS(ni).tcp_rack )
+      pkt->pf.tcp_tx.xmit_time = ci_ip_time_now_us(ni);
+#endif
 
     ci_netif_pkt_hold(ni, pkt);
     __ci_netif_dmaq_insert_prep_pkt(ni, pkt);
@@ -1147,12 +1157,13 @@ ci_tcp_tx_prequeue(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* fill_list)
 {
   ci_ip_pkt_fmt* next;
   ci_ip_pkt_fmt* pkt;
-  int n_pkts = 0;
+  int n_pkts = 0, bytes = 0;
 
   /* Walk the fill_list to convert pointers to indirected pointers. */
   pkt = fill_list;
   while( 1 ) {
     ++n_pkts;
+    bytes += pkt->pf.tcp_tx.end_seq;
     if( ! (next = CI_USER_PTR_GET(pkt->pf.tcp_tx.next)) )  break;
     pkt->next = OO_PKT_P(next);
     pkt = next;
@@ -1169,6 +1180,7 @@ ci_tcp_tx_prequeue(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* fill_list)
                        OO_PP_ID(pkt->next), OO_PKT_ID(fill_list)) );
 
   oo_atomic_add(&ts->send_prequeue_in, n_pkts);
+  oo_atomic_add(&ts->send_prequeue_bytes, bytes);
   ++ts->stats.tx_defer;
 
   return 1;
@@ -1181,7 +1193,7 @@ void ci_tcp_sendmsg_enqueue_prequeue(ci_netif* ni, ci_tcp_state* ts,
   ci_ip_pkt_queue* sendq = &ts->send;
   ci_ip_pkt_fmt* pkt;
   oo_pkt_p tail_pkt_id, send_list, id;
-  int bytes, n_pkts = 0;
+  int bytes, n_pkts = 0, total_bytes = 0;
   ci_assert(ci_netif_is_locked(ni));
 
   if( ts->send_prequeue == OO_PP_ID_INVALID )
@@ -1221,10 +1233,12 @@ void ci_tcp_sendmsg_enqueue_prequeue(ci_netif* ni, ci_tcp_state* ts,
     if( pkt->flags & CI_PKT_FLAG_TX_PSH )
       TX_PKT_IPX_TCP(ipcache_af(&ts->s.pkt), pkt)->tcp_flags |= CI_TCP_FLAG_PSH;
     tcp_enq_nxt(ts) += bytes;
+    total_bytes += bytes;
 
     if( OO_PP_IS_NULL(pkt->next) )  break;
     pkt = PKT_CHK(ni, pkt->next);
   }
+  oo_atomic_add(&ts->send_prequeue_bytes, -total_bytes);
 
   /* Append onto the sendq. */
   ni->state->n_async_pkts -= n_pkts;
@@ -1304,8 +1318,9 @@ static void ci_netif_pkt_convert_ptr_list(ci_netif* ni, ci_ip_pkt_fmt* list)
 static void
 ci_tcp_tx_free_prequeue(ci_netif* ni, ci_tcp_state* ts, int netif_locked)
 {
-  int n_pkts;
-  oo_pkt_p id;
+  ci_ip_pkt_fmt* pkt;
+  int n_pkts, bytes = 0;
+  oo_pkt_p id, p;
 
   ci_assert( ! netif_locked || ci_netif_is_locked(ni));
 
@@ -1316,6 +1331,10 @@ ci_tcp_tx_free_prequeue(ci_netif* ni, ci_tcp_state* ts, int netif_locked)
     if( OO_PP_IS_NULL(id) )  return;
   } while( ci_cas32_fail(&ts->send_prequeue, OO_PP_ID(id), OO_PP_ID_NULL) );
 
+  for( p = id; OO_PP_NOT_NULL(p); p = pkt->next ) {
+    pkt = PKT(ni, p);
+    bytes += pkt->pf.tcp_tx.end_seq;
+  }
   n_pkts = ci_tcp_sendmsg_free_pkt_list(ni, ts, id, netif_locked, 1);
 
   /* Despite the comment at send_prequeue_in definition, we do decrement it
@@ -1323,6 +1342,7 @@ ci_tcp_tx_free_prequeue(ci_netif* ni, ci_tcp_state* ts, int netif_locked)
    * only, i.e. these packets have not really got into sendq, and should
    * not be accounted at all.  */
   oo_atomic_add(&ts->send_prequeue_in, -n_pkts);
+  oo_atomic_add(&ts->send_prequeue_bytes, -bytes);
 }
 
 
@@ -1933,6 +1953,12 @@ static int ci_tcp_send_via_prequeue(ci_netif* ni, ci_tcp_state* ts,
   return 1;
 }
 
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY) && ! defined(__KERNEL__)
+static int ci_tcp_sendmsg_zerocopy(ci_netif* ni, ci_tcp_state* ts,
+                                   const ci_iovec* iov, unsigned long iovlen,
+                                   int flags);
+#endif
+
 /* It is not safe to call this function while holding the netif lock */
 /*! \todo Confirm */
 int ci_tcp_sendmsg(ci_netif* ni, ci_tcp_state* ts,
@@ -1952,6 +1978,11 @@ int ci_tcp_sendmsg(ci_netif* ni, ci_tcp_state* ts,
   ci_assert(ts);
   ci_assert(ts->s.b.state != CI_TCP_LISTEN);
 
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY) && ! defined(__KERNEL__)
+  if(CI_UNLIKELY( flags & MSG_ZEROCOPY ))
+    return ci_tcp_sendmsg_zerocopy(ni, ts, iov, iovlen, flags);
+#endif
+
   if( ts->snd_delegated ) {
     int rc;
     /* We do not know which seq number to use.  Call
@@ -2069,9 +2100,10 @@ int ci_tcp_sendmsg(ci_netif* ni, ci_tcp_state* ts,
    * If the connection is going on well (CONG_OPEN or CONG_FAST_RECOV),
    * then give a bit more send credit.  We hope that retransmit queue
    * packets will be acked soon and we'll return to
-   * ci_tcp_tx_send_space() constrains. */
+   * ci_tcp_tx_send_space() constrains.  That does not help a socket held
+   * back by TCP_NOTSENT_LOWAT, which is waiting for the sendq to drain. */
   if( sinf.sendq_credit <= 0 && NI_OPTS(ni).tcp_sndbuf_mode &&
-      sinf.total_sent &&
+      sinf.total_sent && ci_tcp_notsent_lowat(ni, ts) == 0 &&
       ( ts->congstate == CI_TCP_CONG_OPEN ||
         ts->congstate == CI_TCP_CONG_FAST_RECOV ) )
     sinf.sendq_credit += ts->retrans.num >> 1;
@@ -2355,7 +2387,8 @@ ci_tcp_offload_zc_send_accum_crc(ci_netif* ni, ci_ip_pkt_fmt* pkt,
     abort();
   }
   ci_uint32 crc = crc_prefix->accum_crc.reset ? 0 : ni->state->nvme_crc_plugin_idp[intf_i].crcs[id];
-  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] = crc32c(crc ^ 0xffffffff, zcp->local_addr, zcp->len);
+  ni->state->nvme_crc_plugin_idp[intf_i].crcs[id] =
+    ~ci_crc32c_partial(zcp->local_addr, zcp->len, ~crc);
 #endif
 #endif
 
@@ -2468,8 +2501,11 @@ static inline bool ci_tcp_tx_has_room_for_zc(ci_netif* ni, ci_ip_pkt_fmt* pkt,
 }
 
 
-int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
-                   int flags)
+/* [zerocopy_id] is non-NULL for a MSG_ZEROCOPY send: the completion of the
+ * data is reported with that id rather than with its app_cookie. */
+static int __ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts,
+                            struct onload_zc_mmsg* msg, int flags,
+                            const ci_uint32* zerocopy_id)
 {
   struct tcp_send_info sinf;
   ci_ip_pkt_fmt* pkt;
@@ -2767,6 +2803,9 @@ int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
           zcp->len = room_len;
           zcp->remote.app_cookie = (uintptr_t)msg->msg.iov[j].app_cookie;
           zcp->remote.addr_space = um->addr_space;
+          zcp->is_msg_zerocopy = zerocopy_id != NULL;
+          if( zerocopy_id != NULL )
+            zcp->zerocopy_id = *zerocopy_id;
 #if CI_CFG_NVME_LOCAL_CRC_MODE
           if( zcp->remote.addr_space == EF_ADDRSPACE_LOCAL )
             zcp->local_addr = (void*)iov_base;
@@ -2958,7 +2997,9 @@ int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
     }
   }
 
-  if( j == 0 )
+  /* A MSG_ZEROCOPY send has a single iovec, so this is the only way to
+   * report that some of it was queued. */
+  if( j == 0 && (zerocopy_id == NULL || sinf.total_sent == 0) )
     msg->rc = -EINVAL;
   else
     msg->rc = sinf.total_sent;
@@ -2980,6 +3021,218 @@ int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
 }
 
 
+int ci_tcp_zc_send(ci_netif* ni, ci_tcp_state* ts, struct onload_zc_mmsg* msg,
+                   int flags)
+{
+  return __ci_tcp_zc_send(ni, ts, msg, flags, NULL);
+}
+
+
+/* Usermem can't be sent from by NICs without checksum offload, because the
+ * code necessary to compute checksums on the host is gnarly and thus
+ * non-existent. */
+bool ci_netif_zc_usermem_unsupported(ci_netif* ni)
+{
+  int nic_i;
+
+  OO_STACK_FOR_EACH_INTF_I(ni, nic_i)
+    if( ci_netif_vi(ni, nic_i)->nic_type.arch == EF_VI_ARCH_AF_XDP ||
+        ci_netif_vi(ni, nic_i)->nic_type.nic_flags & EFHW_VI_NIC_CTPIO_ONLY )
+      return true;
+
+  return false;
+}
+
+
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY)
+
+/* Pins the pages of [base, base + len) for sending, as
+ * onload_zc_register_buffers() does. */
+static struct ci_zc_usermem*
+ci_tcp_zerocopy_register(ci_netif* ni, void* base, size_t len)
+{
+  uint64_t start = (uintptr_t) base & ~(uint64_t)(EF_VI_NIC_PAGE_SIZE - 1);
+  uint64_t end = CI_ALIGN_FWD((uintptr_t) base + len,
+                              (uint64_t) EF_VI_NIC_PAGE_SIZE);
+  int num_pages = (end - start) >> EF_VI_NIC_PAGE_SHIFT;
+  struct ci_zc_usermem* um;
+
+  um = ci_alloc(sizeof(*um) + sizeof(um->hw_addrs[0]) * num_pages *
+                oo_stack_intf_max(ni));
+  if( um == NULL )
+    return NULL;
+  um->addr_space = EF_ADDRSPACE_LOCAL;
+  um->base = start;
+  um->size = end - start;
+  if( ci_tcp_helper_zc_register_buffers(ni, (void*)(uintptr_t) start,
+                                        num_pages, um->hw_addrs,
+                                        &um->kernel_id) < 0 ) {
+    ci_free(um);
+    return NULL;
+  }
+  return um;
+}
+
+
+/* Whether a MSG_ZEROCOPY send can have its pages pinned, rather than being
+ * copied. */
+int ci_tcp_zerocopy_pin_ok(ci_netif* ni, ci_tcp_state* ts,
+                           const ci_iovec* iov, unsigned long iovlen)
+{
+  size_t len;
+
+  if( iovlen != 1 || CI_IOVEC_BASE(&iov[0]) == NULL )
+    return 0;
+  len = CI_IOVEC_LEN(&iov[0]);
+  return len >= CI_TCP_ZEROCOPY_MIN_LEN && len <= CI_TCP_ZEROCOPY_MAX_LEN &&
+         ts->zerocopy_n_pinned < CI_TCP_ZEROCOPY_MAX_PINNED &&
+         OO_SP_IS_NULL(ts->local_peer) && ! ts->snd_delegated &&
+         ! ci_netif_zc_usermem_unsupported(ni);
+}
+
+
+/* Fills [pkt] as the completion of a MSG_ZEROCOPY send whose data was
+ * copied. */
+void ci_tcp_zerocopy_copied_init(ci_netif* ni, ci_tcp_state* ts,
+                                 ci_ip_pkt_fmt* pkt, ci_uint32 id)
+{
+  struct ci_pkt_zc_header* zch;
+  struct ci_pkt_zc_payload* zcp;
+
+  pkt->flags |= CI_PKT_FLAG_INDIRECT;
+  pkt->pf.tcp_tx.sock_id = ts->s.b.bufid;
+  oo_pkt_af_set(pkt, ipcache_af(&ts->s.pkt));
+  oo_tx_pkt_layout_init(pkt);
+  pkt->tstamp_frc = 0;
+  ci_tcp_tx_pkt_set_zc_header_pos(ts, pkt);
+  zch = oo_tx_zc_header(pkt);
+  zch->segs = 1;
+  zch->prefix_spc = 0;
+  zch->end = sizeof(*zch) + oo_tx_zc_payload_size(ni);
+  zcp = zch->data;
+  memset(zcp, 0, oo_tx_zc_payload_size(ni));
+  zcp->is_remote = 1;
+  zcp->use_remote_cookie = 1;
+  zcp->is_msg_zerocopy = 1;
+  zcp->crc_id = ZC_NVME_CRC_ID_INVALID;
+  zcp->zerocopy_id = id;
+  /* remote.app_cookie is zero: there is no registration to release */
+}
+
+
+/* Queues the completion of a MSG_ZEROCOPY send whose data was copied.  It
+ * goes on the timestamp queue behind any zero-copy sends which are still
+ * waiting for their tx completions. */
+static void ci_tcp_zerocopy_notify_copied(ci_netif* ni, ci_tcp_state* ts,
+                                          ci_ip_pkt_fmt* pkt, ci_uint32 id)
+{
+  ci_assert(ci_netif_is_locked(ni));
+
+  ci_tcp_zerocopy_copied_init(ni, ts, pkt, id);
+  ci_udp_recv_q_put_pending(ni, &ts->timestamp_q, pkt);
+  if( OO_PP_IS_NULL(ts->timestamp_q_pending) ) {
+    ci_udp_recv_q_put_complete(&ts->timestamp_q, pkt->n_buffers);
+    ts->s.b.sb_flags |= CI_SB_FLAG_RX_DELIVERED;
+    ci_netif_put_on_post_poll(ni, &ts->s.b);
+    ci_tcp_wake_possibly_not_in_poll(ni, ts, CI_SB_FLAG_WAKE_RX);
+  }
+}
+
+
+/* sendmsg() with MSG_ZEROCOPY on a socket with SO_ZEROCOPY.  Each send that
+ * succeeds takes the next notification id, and its completion is reported
+ * on the error queue when the data has been acknowledged and can no longer
+ * be retransmitted.  A send of a single large iovec has its pages pinned and
+ * is sent with the zero-copy machinery of onload_zc_send(); the others are
+ * copied and completed at once with SO_EE_CODE_ZEROCOPY_COPIED.  Linux
+ * permits either outcome.  The pages stay pinned until the application
+ * reads the completion, so once CI_TCP_ZEROCOPY_MAX_PINNED sends are
+ * waiting to be read, further sends are copied. */
+static int ci_tcp_sendmsg_zerocopy(ci_netif* ni, ci_tcp_state* ts,
+                                   const ci_iovec* iov, unsigned long iovlen,
+                                   int flags)
+{
+  struct ci_zc_usermem* um = NULL;
+  ci_ip_pkt_fmt* pkt = NULL;
+  size_t len = 0;
+  ci_uint32 id;
+  unsigned long i;
+  int rc, err;
+
+  flags &= ~MSG_ZEROCOPY;
+  for( i = 0; i < iovlen; ++i )
+    len += CI_IOVEC_LEN(&iov[i]);
+  if( ! (ts->s.s_aflags & CI_SOCK_AFLAG_ZEROCOPY) || len == 0 ||
+      (flags & (MSG_OOB | ONLOAD_MSG_WARM)) )
+    return ci_tcp_sendmsg(ni, ts, iov, iovlen, flags);
+
+  if( ci_tcp_zerocopy_pin_ok(ni, ts, iov, iovlen) )
+    um = ci_tcp_zerocopy_register(ni, CI_IOVEC_BASE(&iov[0]), len);
+
+  ci_netif_lock(ni);
+  id = ts->zerocopy_next_id++;
+  ci_netif_unlock(ni);
+
+  if( um != NULL ) {
+    struct onload_zc_iovec zc_iov;
+    struct onload_zc_mmsg msg;
+    uint64_t kernel_id = um->kernel_id;
+
+    memset(&zc_iov, 0, sizeof(zc_iov));
+    zc_iov.iov_base = CI_IOVEC_BASE(&iov[0]);
+    zc_iov.iov_len = len;
+    zc_iov.buf = zc_usermem_to_handle(um);
+    zc_iov.app_cookie = (void*)(uintptr_t) kernel_id;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg.iov = &zc_iov;
+    msg.msg.msghdr.msg_iovlen = 1;
+    /* Counted before the data can be acked and its completion read */
+    ci_atomic32_inc(&ts->zerocopy_n_pinned);
+    __ci_tcp_zc_send(ni, ts, &msg, flags, &id);
+    /* The DMA addresses have been copied into the packets. */
+    ci_free(um);
+    if( msg.rc > 0 ) {
+      CITP_STATS_NETIF_INC(ni, tcp_zerocopy_sent);
+      return msg.rc;
+    }
+    /* Nothing was queued, so leave it to the copying path to find out
+     * why. */
+    ci_atomic32_dec(&ts->zerocopy_n_pinned);
+    ci_tcp_helper_zc_unregister_buffers(ni, kernel_id);
+  }
+
+  /* The notification is allocated up front so that a send can't succeed
+   * without one, which would leave the application waiting forever. */
+  ci_netif_lock(ni);
+  pkt = ci_netif_pkt_alloc(ni, 0);
+  if( pkt == NULL && ts->zerocopy_next_id == id + 1 )
+    ts->zerocopy_next_id = id;
+  ci_netif_unlock(ni);
+  if( pkt == NULL ) {
+    CI_SET_ERROR(rc, ENOBUFS);
+    return rc;
+  }
+
+  rc = ci_tcp_sendmsg(ni, ts, iov, iovlen, flags);
+  err = errno;
+  ci_netif_lock(ni);
+  if( rc > 0 ) {
+    CITP_STATS_NETIF_INC(ni, tcp_zerocopy_copied);
+    ci_tcp_zerocopy_notify_copied(ni, ts, pkt, id);
+  }
+  else {
+    ci_netif_pkt_release(ni, pkt);
+    if( ts->zerocopy_next_id == id + 1 )
+      ts->zerocopy_next_id = id;
+  }
+  ci_netif_unlock(ni);
+  errno = err;
+  return rc;
+}
+
+#endif
+
+
 static int ci_tcp_ds_get_arp(ci_netif* ni, ci_tcp_state* ts)
 {
   int i;
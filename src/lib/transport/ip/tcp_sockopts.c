@@ -15,6 +15,7 @@
 
 #include "ip_internal.h"
 #include <ci/internal/ip_stats.h>
+#include <onload/sleep.h>
 #include <ci/net/sockopts.h>
 
 #if !defined(__KERNEL__)
@@ -238,6 +239,32 @@ int ci_get_sol_tcp(ci_netif* netif, ci_sock_cmn* s, int optname, void *optval,
         u = ci_tcp_is_in_faststart(SOCK_TO_TCP(s));
       goto u_out;
     }
+#ifdef TCP_FASTOPEN
+  case TCP_FASTOPEN:
+    u = c->tfo_qlen;
+    goto u_out;
+#endif
+  case TCP_NOTSENT_LOWAT:
+    u = c->notsent_lowat;
+    goto u_out;
+#ifdef TCP_FASTOPEN_CONNECT
+  case TCP_FASTOPEN_CONNECT:
+    u = 0;
+    if( s->b.state != CI_TCP_LISTEN )
+      u = (SOCK_TO_TCP(s)->tcpflags & CI_TCPT_FLAG_TFO_CONNECT) != 0;
+    goto u_out;
+#endif
+  case TCP_CONGESTION:
+    {
+      /* As Linux, return the name padded to TCP_CA_NAME_MAX. */
+      char name[16];
+      const char* algo = ci_tcp_cc_algo(c->cc_algo)->name;
+      memset(name, 0, sizeof(name));
+      memcpy(name, algo, strlen(algo));
+      *optlen = CI_MIN(*optlen, sizeof(name));
+      memcpy(optval, name, *optlen);
+      return 0;
+    }
 #ifndef __KERNEL__
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
   case ONLOAD_TCP_OFFLOAD:
@@ -395,7 +422,26 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
     return ci_set_sol_ip6(netif, s, optname, optval, optlen);
   }
   else if( level == IPPROTO_TCP ) {
-    /* These are ints values */
+    if( optname == TCP_CONGESTION ) {
+      /* The value is the name of the algorithm */
+      int algo;
+      if( optlen < 1 ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      algo = ci_tcp_cc_find(optval, optlen);
+      if( algo < 0 ) {
+        rc = -ENOENT;
+        goto fail_inval;
+      }
+      if( s->b.state == CI_TCP_LISTEN )
+        c->cc_algo = algo;
+      else
+        ci_tcp_cc_select(netif, SOCK_TO_TCP(s), algo);
+      return 0;
+    }
+
+    /* The rest are ints values */
     if( (rc = opt_not_ok(optval, optlen, int)) )
       goto fail_inval;
     switch(optname) {
@@ -509,6 +555,37 @@ static int ci_tcp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, int level,
         }
       }
       break;
+#ifdef TCP_FASTOPEN
+    case TCP_FASTOPEN:
+      /* Maximum number of Fast Open connections waiting to be accepted */
+      if( *(int*) optval < 0 ||
+          (s->b.state != CI_TCP_CLOSED && s->b.state != CI_TCP_LISTEN) ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      c->tfo_qlen = *(int*) optval;
+      break;
+#endif
+    case TCP_NOTSENT_LOWAT:
+      c->notsent_lowat = *(unsigned*) optval;
+      /* A larger limit may make room for a blocked writer. */
+      if( (s->b.state & CI_TCP_STATE_SYNCHRONISED) &&
+          ci_tcp_tx_advertise_space(netif, SOCK_TO_TCP(s)) )
+        ci_tcp_wake_possibly_not_in_poll(netif, SOCK_TO_TCP(s),
+                                         CI_SB_FLAG_WAKE_TX);
+      break;
+#ifdef TCP_FASTOPEN_CONNECT
+    case TCP_FASTOPEN_CONNECT:
+      if( *(unsigned*) optval > 1 || s->b.state != CI_TCP_CLOSED ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      if( *(int*) optval )
+        SOCK_TO_TCP(s)->tcpflags |= CI_TCPT_FLAG_TFO_CONNECT;
+      else
+        SOCK_TO_TCP(s)->tcpflags &= ~CI_TCPT_FLAG_TFO_CONNECT;
+      break;
+#endif
 #if CI_CFG_TCP_OFFLOAD_RECYCLER
     case ONLOAD_TCP_OFFLOAD:
       {
@@ -909,6 +986,24 @@ static int ci_tcp_sync_tcp_sockopts(ci_netif* ni, ci_tcp_state* ts,
                                &optval, sizeof(optval));
   }
 
+  if( ts->c.cc_algo != NI_OPTS(ni).tcp_cc ) {
+    const char* name = ci_tcp_cc(ts)->name;
+    ci_tcp_sock_ops_setsockopt(sock, &err, SOL_TCP, TCP_CONGESTION,
+                               (void*) name, strlen(name));
+  }
+#ifdef TCP_FASTOPEN
+  if( ts->c.tfo_qlen != 0 ) {
+    optval = ts->c.tfo_qlen;
+    ci_tcp_sock_ops_setsockopt(sock, &err, SOL_TCP, TCP_FASTOPEN,
+                               &optval, sizeof(optval));
+  }
+#endif
+  if( ts->c.notsent_lowat != 0 ) {
+    optval = ts->c.notsent_lowat;
+    ci_tcp_sock_ops_setsockopt(sock, &err, SOL_TCP, TCP_NOTSENT_LOWAT,
+                               &optval, sizeof(optval));
+  }
+
   optval = 1;
   if( ts->s.s_aflags & CI_SOCK_AFLAG_CORK_BIT )
     ci_tcp_sock_ops_setsockopt(sock, &err, SOL_TCP, TCP_CORK,
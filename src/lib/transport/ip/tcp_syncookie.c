@@ -258,3 +258,80 @@ ci_tcp_syncookie_ack(ci_netif* netif, ci_tcp_socket_listen* tls,
   CITP_STATS_TCP_LISTEN(++tls->stats.n_syncookie_ack_answ);
 }
 
+
+
+/* TCP Fast Open cookies (RFC7413).  The cookie is a MAC of the client
+ * address, keyed with the same secret as the syncookies.  A leading byte
+ * keeps the hash input distinct from that of the syncookies. */
+static ci_uint64
+ci_tcp_fastopen_hash(ci_netif* netif, const ci_addr_t* raddr, ci_uint8 kind)
+{
+  ci_uint8 hash_data[1 + sizeof(ci_addr_t)];
+
+  hash_data[0] = kind;
+  memcpy(hash_data + 1, raddr, sizeof(ci_addr_t));
+  return sip_hash((void *)netif->state->hash_salt,
+                  hash_data, sizeof(hash_data));
+}
+
+void
+ci_tcp_fastopen_cookie(ci_netif* netif, const ci_addr_t* raddr,
+                       ci_uint8* cookie)
+{
+  ci_uint64 h = ci_tcp_fastopen_hash(netif, raddr, 'F');
+
+  CI_BUILD_ASSERT(sizeof(h) == CI_TCP_FASTOPEN_COOKIE_LEN);
+  memcpy(cookie, &h, CI_TCP_FASTOPEN_COOKIE_LEN);
+}
+
+int
+ci_tcp_fastopen_cookie_ok(ci_netif* netif, const ci_addr_t* raddr,
+                          const ci_uint8* cookie, int len)
+{
+  ci_uint8 expected[CI_TCP_FASTOPEN_COOKIE_LEN];
+
+  if( len != CI_TCP_FASTOPEN_COOKIE_LEN )
+    return 0;
+  ci_tcp_fastopen_cookie(netif, raddr, expected);
+  return memcmp(cookie, expected, CI_TCP_FASTOPEN_COOKIE_LEN) == 0;
+}
+
+
+/* The client cache is direct-mapped, so a colliding server just costs an
+ * extra round trip to fetch a new cookie. */
+static ci_tcp_fastopen_cache_entry*
+ci_tcp_fastopen_cache_entry_get(ci_netif* netif, const ci_addr_t* raddr)
+{
+  ci_uint64 h = ci_tcp_fastopen_hash(netif, raddr, 'C');
+
+  CI_BUILD_ASSERT(CI_IS_POW2(CI_CFG_TCP_FASTOPEN_CACHE_SIZE));
+  return &netif->state->tfo_cache[h & (CI_CFG_TCP_FASTOPEN_CACHE_SIZE - 1)];
+}
+
+int
+ci_tcp_fastopen_cache_get(ci_netif* netif, const ci_addr_t* raddr,
+                          ci_uint8* cookie)
+{
+  ci_tcp_fastopen_cache_entry* e;
+
+  ci_assert(ci_netif_is_locked(netif));
+  e = ci_tcp_fastopen_cache_entry_get(netif, raddr);
+  if( e->len == 0 || ! CI_IPX_ADDR_EQ(e->raddr, *raddr) )
+    return 0;
+  memcpy(cookie, e->cookie, e->len);
+  return e->len;
+}
+
+void
+ci_tcp_fastopen_cache_put(ci_netif* netif, const ci_addr_t* raddr,
+                          const ci_uint8* cookie, int len)
+{
+  ci_tcp_fastopen_cache_entry* e;
+
+  ci_assert(ci_netif_is_locked(netif));
+  ci_assert_le(len, CI_TCP_FASTOPEN_COOKIE_MAX);
+  e = ci_tcp_fastopen_cache_entry_get(netif, raddr);
+  e->raddr = *raddr;
+  e->len = len;
+  memcpy(e->cookie, cookie, len);
+}
@@ -583,6 +583,9 @@ static void ci_tcp_inherit_options(ci_netif* ni, ci_sock_cmn* s,
   ci_assert(ts);
 
   ts->s.so = s->so;
+#if CI_CFG_TX_PACING
+  ts->s.pace_max_rate = s->pace_max_rate;
+#endif
 #if CI_CFG_IPV6
   /* IPv6 link-local address requires an interface. Don't overwrite it. */
   if( !CI_IPX_IS_LINKLOCAL(ts->s.cp.laddr) ||
@@ -648,6 +651,11 @@ static void ci_tcp_inherit_options(ci_netif* ni, ci_sock_cmn* s,
   ts->c.t_ka_intvl         = c->t_ka_intvl;
   ts->c.t_ka_intvl_in_secs = c->t_ka_intvl_in_secs;
   ts->c.ka_probe_th        = c->ka_probe_th;
+  /* TCP_NOTSENT_LOWAT */
+  ts->c.notsent_lowat      = c->notsent_lowat;
+  /* TCP_CONGESTION */
+  if( ts->c.cc_algo != c->cc_algo )
+    ci_tcp_cc_select(ni, ts, c->cc_algo);
   {
     int af = ipcache_af(&ts->s.pkt);
     ci_ipx_hdr_init_fixed(&ts->s.pkt.ipx, af, IPPROTO_TCP,
@@ -911,8 +919,13 @@ int ci_tcp_listenq_try_promote(ci_netif* netif, ci_tcp_socket_listen* tls,
 
     /* options and flags */
     ts->tcpflags = 0;
-    ts->tcpflags |= tsr->tcpopts.flags;
+    ts->tcpflags |= tsr->tcpopts.flags &
+                    ~(CI_TCPT_FLAG_TFO | CI_TCPT_FLAG_TFO_DATA);
     ts->tcpflags |= CI_TCPT_FLAG_PASSIVE_OPENED;
+    /* Must be set before the socket is queued, to be counted against the
+     * Fast Open qlen. */
+    if( tsr->tcpopts.flags & CI_TCPT_FLAG_TFO_DATA )
+      ts->tcpflags |= CI_TCPT_FLAG_TFO;
     ts->outgoing_hdrs_len = CI_IPX_HDR_SIZE(ipcache_af(&ts->s.pkt)) +
                             sizeof(ci_tcp_hdr);
     if( ts->tcpflags & CI_TCPT_FLAG_WSCL ) {
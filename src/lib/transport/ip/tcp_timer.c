@@ -80,6 +80,11 @@ void ci_tcp_timer_init(ci_netif* netif)
 
   NI_CONF(netif).tconst_stats = 
     ci_tcp_time_ms2ticks(netif, CI_TCONST_STATS);
+
+#if CI_CFG_IP_REASM
+  NI_CONF(netif).tconst_ip_reasm =
+    ci_tcp_time_ms2ticks(netif, NI_OPTS(netif).ip_reasm_timeout);
+#endif
 }
 
 
@@ -564,7 +569,9 @@ void ci_tcp_timeout_rto(ci_netif* netif, ci_tcp_state* ts)
       ts->ssthresh = CI_MAX(x, y);
     }
     else
-      ts->ssthresh = ci_tcp_losswnd(ts);
+      ts->ssthresh = ci_tcp_cc(ts)->ssthresh(netif, ts);
+    /* Start again from slow start, as for a new connection. */
+    ci_tcp_cc(ts)->init(netif, ts);
 
     ts->congstate = CI_TCP_CONG_RTO;
     ts->cwnd_extra = 0;
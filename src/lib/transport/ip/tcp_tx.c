@@ -603,9 +603,12 @@ void ci_tcp_tx_change_mss(ci_netif* ni, ci_tcp_state* ts)
 }
 
 
+/* [tfo_cookie_len] is negative if there is to be no Fast Open option, and
+ * zero for a cookie request. */
 static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
                                         unsigned optflags, unsigned rcv_wscl,
-                                        ci_uint8** opt)
+                                        const ci_uint8* tfo_cookie,
+                                        int tfo_cookie_len, ci_uint8** opt)
 {
   int optlen = 0;
 
@@ -629,6 +632,15 @@ static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
   }
 #endif
 
+  /* Fast Open (RFC7413). */
+  if( tfo_cookie_len >= 0 ) {
+    (*opt)[0] = CI_TCP_OPT_FASTOPEN;
+    (*opt)[1] = 2 + tfo_cookie_len;
+    memcpy(*opt + 2, tfo_cookie, tfo_cookie_len);
+    *opt += 2 + tfo_cookie_len;
+    optlen += 2 + tfo_cookie_len;
+  }
+
   /* Pad to dword boundary. */
   while( optlen & 3 ) {
     *(*opt)++ = CI_TCP_OPT_END;
@@ -639,16 +651,37 @@ static int ci_tcp_tx_insert_syn_options(ci_netif* ni, ci_uint16 amss,
 }
 
 
-/*
-** called to enqueue a packet with no data (i.e. SYN/FIN) the segment
-** is placed on the TX queue and so is reliably transmitted
-*/
-void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
-                            ci_ip_pkt_fmt* pkt)
+/* Decides the Fast Open option for a SYN, and returns the number of bytes
+ * of [iov] that can go with it. */
+static int ci_tcp_tx_syn_fastopen(ci_netif* netif, ci_tcp_state* ts,
+                                  const ci_iovec* iov, int iovlen,
+                                  ci_uint8* cookie, int* cookie_len)
+{
+  ci_addr_t raddr = ipcache_raddr(&ts->s.pkt);
+  int i, n = 0;
+
+  *cookie_len = ci_tcp_fastopen_cache_get(netif, &raddr, cookie);
+  if( *cookie_len == 0 ) {
+    CITP_STATS_NETIF_INC(netif, tfo_cookie_req_tx);
+    return 0;
+  }
+  for( i = 0; i < iovlen; ++i )
+    n += CI_IOVEC_LEN(&iov[i]);
+  return n;
+}
+
+
+static void __ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
+                                     ci_ip_pkt_fmt* pkt,
+                                     const ci_iovec* iov, int iovlen,
+                                     int* data_len)
 {
   ci_tcp_hdr* thdr;
   int af = ipcache_af(&ts->s.pkt);
   int optlen = tcp_ipx_outgoing_opts_len(af, ts);
+  ci_uint8 tfo_cookie[CI_TCP_FASTOPEN_COOKIE_MAX];
+  int tfo_cookie_len = -1;
+  int n = 0;
 
   ci_assert(ts);
   ci_assert(netif);
@@ -658,6 +691,7 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   ci_assert(TS_IPX_TCP(ts)->tcp_flags & (CI_TCP_FLAG_SYN|CI_TCP_FLAG_FIN));
 
   oo_tx_pkt_layout_init(pkt);
+  pkt->tstamp_frc = 0;
   ci_ipcache_update_flowlabel(netif, &ts->s);
   ci_pkt_init_from_ipcache(pkt, &ts->s.pkt);
 
@@ -666,8 +700,12 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
   if( TS_IPX_TCP(ts)->tcp_flags & CI_TCP_FLAG_SYN ) {
     ci_uint8* opt = CI_TCP_HDR_OPTS(thdr);
     opt += optlen;
-    optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss,
-                                           ts->tcpflags, ts->rcv_wscl, &opt);
+    if( ts->tcpflags & CI_TCPT_FLAG_TFO )
+      n = ci_tcp_tx_syn_fastopen(netif, ts, iov, iovlen,
+                                 tfo_cookie, &tfo_cookie_len);
+    optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss, ts->tcpflags,
+                                           ts->rcv_wscl, tfo_cookie,
+                                           tfo_cookie_len, &opt);
 
     /* If we don't get timestamps, we'll need to calculate RTT without
      * them.  Let's prepare: */
@@ -678,27 +716,113 @@ void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
 
   pkt->buf_len = ( oo_tx_ether_hdr_size(pkt) + CI_IPX_HDR_SIZE(af)
                    + sizeof(ci_tcp_hdr) + optlen );
+
+#ifndef __KERNEL__
+  /* Data on the SYN gives up the space taken by the SYN options. */
+  n = CI_MIN(n, (int) tcp_eff_mss(ts) -
+                (optlen - tcp_ipx_outgoing_opts_len(af, ts)));
+  if( n > 0 ) {
+    char* p = PKT_START(pkt) + pkt->buf_len;
+    int i, frag;
+
+    for( i = 0, frag = n; frag > 0; ++i ) {
+      int len = CI_MIN(frag, (int) CI_IOVEC_LEN(&iov[i]));
+      memcpy(p, CI_IOVEC_BASE(&iov[i]), len);
+      p += len;
+      frag -= len;
+    }
+    pkt->buf_len += n;
+    CITP_STATS_NETIF_INC(netif, tfo_syn_data_tx);
+  }
+  else
+#endif
+    n = 0;
+
   pkt->pay_len = pkt->buf_len;
   oo_offbuf_init(&pkt->buf, PKT_START(pkt) + pkt->buf_len, 0);
   pkt->flags &= CI_PKT_FLAG_NONB_POOL;
   ASSERT_VALID_PKT(netif, pkt);
 
   pkt->pf.tcp_tx.start_seq = tcp_enq_nxt(ts);
-  tcp_enq_nxt(ts) += 1;
+  tcp_enq_nxt(ts) += 1 + n;
   pkt->pf.tcp_tx.end_seq = tcp_enq_nxt(ts);
   pkt->pf.tcp_tx.block_end = OO_PP_NULL;
+  if( n > 0 )
+    ts->snd_max += n;
 
   ci_ip_queue_enqueue(netif, &ts->send, pkt);
   ++ts->send_in;
 
-  LOG_TC(log(LNTS_FMT "enqueue ["CI_TCP_FLAGS_FMT"] seq=%x",
+  LOG_TC(log(LNTS_FMT "enqueue ["CI_TCP_FLAGS_FMT"] seq=%x len=%d",
              LNTS_PRI_ARGS(netif, ts),
              CI_TCP_HDR_FLAGS_PRI_ARG(TX_PKT_IPX_TCP(af, pkt)),
-             tcp_enq_nxt(ts) - 1));
+             pkt->pf.tcp_tx.start_seq, n));
 
+  if( data_len != NULL )
+    *data_len = n;
   ci_tcp_tx_advance(ts, netif);
 }
 
+
+/*
+** called to enqueue a packet with no data (i.e. SYN/FIN) the segment
+** is placed on the TX queue and so is reliably transmitted
+*/
+void ci_tcp_enqueue_no_data(ci_tcp_state* ts, ci_netif* netif,
+                            ci_ip_pkt_fmt* pkt)
+{
+  __ci_tcp_enqueue_no_data(ts, netif, pkt, NULL, 0, NULL);
+}
+
+
+/* Enqueue a SYN with a Fast Open option, carrying as much of [iov] as the
+ * cookie cache allows.  Returns the number of bytes carried. */
+int ci_tcp_enqueue_syn_fastopen(ci_tcp_state* ts, ci_netif* netif,
+                                ci_ip_pkt_fmt* pkt,
+                                const ci_iovec* iov, int iovlen)
+{
+  int n;
+
+  ci_assert_flags(ts->tcpflags, CI_TCPT_FLAG_TFO);
+  __ci_tcp_enqueue_no_data(ts, netif, pkt, iov, iovlen, &n);
+  return n;
+}
+
+/* The server acknowledged our SYN but not the Fast Open data on it.  Turn
+ * the SYN into an ordinary data segment and retransmit it at once, rather
+ * than waiting for the RTO.
+ */
+void ci_tcp_fastopen_retrans_syn_data(ci_netif* netif, ci_tcp_state* ts)
+{
+  ci_ip_pkt_fmt* pkt = PKT_CHK(netif, ts->retrans.head);
+  int af = ipcache_af(&ts->s.pkt);
+  ci_tcp_hdr* tcp = TX_PKT_IPX_TCP(af, pkt);
+  int hdrlen = sizeof(ci_tcp_hdr) + tcp_ipx_outgoing_opts_len(af, ts);
+  int n = SEQ_SUB(pkt->pf.tcp_tx.end_seq, pkt->pf.tcp_tx.start_seq) - 1;
+  char* data;
+
+  ci_assert(tcp->tcp_flags & CI_TCP_FLAG_SYN);
+  ci_assert_gt(n, 0);
+  ci_assert(SEQ_EQ(pkt->pf.tcp_tx.start_seq + 1, tcp_snd_una(ts)));
+
+  /* If the SYN is still in flight, the RTO will retransmit it as it is,
+   * and the server will challenge-ACK it. */
+  if( pkt->flags & CI_PKT_FLAG_TX_PENDING )
+    return;
+
+  data = (char*) tcp + hdrlen;
+  memmove(data, (char*) tcp + CI_TCP_HDR_LEN(tcp), n);
+  CI_TCP_HDR_SET_LEN(tcp, hdrlen);
+  tcp->tcp_flags = CI_TCP_FLAG_ACK | CI_TCP_FLAG_PSH;
+  pkt->pf.tcp_tx.start_seq += 1;
+  tcp->tcp_seq_be32 = CI_BSWAP_BE32(pkt->pf.tcp_tx.start_seq);
+
+  pkt->buf_len = pkt->pay_len = (ci_int32)(data + n - PKT_START(pkt));
+  oo_offbuf_init(&pkt->buf, data + n, 0);
+  ci_tcp_retrans_one(ts, netif, pkt);
+}
+
+
 /* Rewrite the first SYN packet as a SYNACK for simultaneous open */
 int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state *ts)
 {
@@ -733,13 +857,18 @@ int ci_tcp_send_sim_synack(ci_netif* netif, ci_tcp_state *ts)
     return 0;
   }
 
+  /* Rewriting the options would lose any Fast Open data on the SYN. */
+  if( SEQ_SUB(pkt->pf.tcp_tx.end_seq, pkt->pf.tcp_tx.start_seq) != 1 )
+    return 0;
+
   /* fill out options */
   opt = CI_TCP_HDR_OPTS(tcp);
   if( ts->tcpflags & CI_TCPT_FLAG_TSO )
     optlen += ci_tcp_tx_opt_tso(&opt, ci_tcp_time_now(netif), 0);
 
   optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss,
-                                         ts->tcpflags, ts->rcv_wscl, &opt);
+                                         ts->tcpflags, ts->rcv_wscl,
+                                         NULL, -1, &opt);
 
   CI_TCP_HDR_SET_LEN(tcp, sizeof(*tcp) + optlen);
   tcp->tcp_flags |= CI_TCP_FLAG_ACK;
@@ -857,7 +986,7 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
   if( ipcache == NULL ) {
     ipcache = &ipcache_storage;
     ci_ip_cache_init(ipcache, CI_ADDR_AF(tsr->l_addr));
-    ci_ip_send_pkt_lookup(netif, &tls->s.cp, pkt, ipcache);
+    ci_tcp_reply_pkt_lookup(netif, &tls->s.cp, pkt, ipcache);
   }
 
   TX_PKT_TTL(af, pkt) = ipcache_ttl(ipcache);
@@ -875,10 +1004,19 @@ int ci_tcp_synrecv_send(ci_netif* netif, ci_tcp_socket_listen* tls,
       (ipcache->status == retrrc_success ||
        ipcache->status == retrrc_nomac ||
        OO_SP_NOT_NULL(tsr->local_peer)) ) {
+    ci_uint8 tfo_cookie[CI_TCP_FASTOPEN_COOKIE_LEN];
+    int tfo_cookie_len = -1;
+
     tsr->amss = ci_tcp_amss(netif, &tls->c, ipcache, __func__);
+    if( tsr->tcpopts.flags & CI_TCPT_FLAG_TFO ) {
+      ci_tcp_fastopen_cookie(netif, &tsr->r_addr, tfo_cookie);
+      tfo_cookie_len = CI_TCP_FASTOPEN_COOKIE_LEN;
+      CITP_STATS_NETIF_INC(netif, tfo_cookie_sent);
+    }
     optlen += ci_tcp_tx_insert_syn_options(netif, tsr->amss,
                                            tsr->tcpopts.flags,
-                                           tsr->rcv_wscl, &opt);
+                                           tsr->rcv_wscl, tfo_cookie,
+                                           tfo_cookie_len, &opt);
     pkt->pf.tcp_tx.sock_id = OO_SP_NULL;
   }
   /* NB. If [ipcache->status] has some other value, then packet won't be
@@ -1106,6 +1244,15 @@ int ci_tcp_retrans(ci_netif* ni, ci_tcp_state* ts, int seq_limit,
     /* Stop if we've reached the recovery sequence number. */
     if( SEQ_LE(ts->congrecover, pkt->pf.tcp_tx.start_seq) )  return 1;
 
+#if CI_CFG_TCP_RACK
+    /* In fast recovery RACK decides which segments are lost.  Those that
+    ** are not lost yet may be when the RACK timer fires.
+    */
+    if( ts->congstate == CI_TCP_CONG_FAST_RECOV &&
+        ci_tcp_rack_enabled(ni, ts) && ! ci_tcp_rack_is_lost(ni, ts, pkt) )
+      return 0;
+#endif
+
 #if CI_CFG_BURST_CONTROL
     if(ts->burst_window && ci_tcp_burst_exhausted(ni, ts)){
       LOG_TV(log(LNT_FMT "tx limited by burst avoidance",
@@ -1295,6 +1442,11 @@ void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
 {
   unsigned cwnd_right_edge, right_edge;
   ci_uint32* p_stop_cntr;
+#if CI_CFG_TX_PACING
+  ci_uint64 pace_rate = 0;
+  unsigned snd_nxt;
+  ci_uint32 stop_pace;
+#endif
 
   ci_assert(ci_netif_is_locked(ni));
   ci_assert(ci_ip_queue_not_empty(&ts->send));
@@ -1348,7 +1500,29 @@ void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
   }
 #endif
 
+#if CI_CFG_TX_PACING
+  if( ci_tcp_may_pace(ni, ts) && (pace_rate = ci_tcp_pace_rate(ni, ts)) ) {
+    unsigned pace_right_edge = tcp_snd_nxt(ts) +
+      ci_tx_pace_tokens(ni, &ts->s, pace_rate, tcp_eff_mss(ts) << 1);
+    if( SEQ_LT(pace_right_edge, right_edge) ) {
+      p_stop_cntr = &ts->stats.tx_stop_pace;
+      right_edge = pace_right_edge;
+    }
+  }
+  snd_nxt = tcp_snd_nxt(ts);
+  stop_pace = ts->stats.tx_stop_pace;
+#endif
+
   ci_tcp_tx_advance_to(ni, ts, right_edge, p_stop_cntr);
+
+#if CI_CFG_TX_PACING
+  if( pace_rate != 0 ) {
+    ts->s.pace_tokens -= SEQ_SUB(tcp_snd_nxt(ts), snd_nxt);
+    if( ts->stats.tx_stop_pace != stop_pace &&
+        ! (ts->s.b.state & CI_TCP_STATE_NO_TIMERS) )
+      ci_tx_pace_throttle(ni, &ts->s, pace_rate, tcp_eff_mss(ts));
+  }
+#endif
 }
 
 
@@ -1447,6 +1621,14 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
     CI_TCP_STATS_INC_OUT_SEGS(ni);
     last_pkt = pkt;
 
+    if( CI_UNLIKELY( pkt->tstamp_frc != 0 ) ) {
+      if( ~ts->tcpflags & CI_TCPT_FLAG_MSG_WARM )
+        ci_netif_lat_hist_sample(ni, &ts->s, CI_LAT_HIST_TX, pkt->tstamp_frc);
+      /* Don't count it again if it comes back round, and leave the field
+       * for onload_tcpdump. */
+      pkt->tstamp_frc = 0;
+    }
+
     /* Prep the packet for the retransmit queue. */
     ci_assert( ! (pkt->flags & CI_PKT_FLAG_TX_PENDING));
     ci_assert_equal(pkt->flags & ~CI_PKT_FLAG_TX_MASK_ALLOWED, 0);
@@ -1522,8 +1704,7 @@ void ci_tcp_tx_advance_to(ci_netif* ni, ci_tcp_state* ts,
     ts->send_out += sent_num;
 
     /* Wake up TX if necessary */
-    if( NI_OPTS(ni).tcp_sndbuf_mode == 0 &&
-        ci_tcp_tx_advertise_space(ni, ts) )
+    if( ci_tcp_tx_wake_on_send(ni, ts) )
       ci_tcp_wake_possibly_not_in_poll(ni, ts, CI_SB_FLAG_WAKE_TX);
 
 #if CI_CFG_CONGESTION_WINDOW_VALIDATION
@@ -1811,7 +1992,7 @@ ci_tcp_reply_with_rst(ci_netif* netif, const struct oo_sock_cplane* sock_cp,
     /* ?? TODO: should we respect here SO_BINDTODEVICE? */
     ci_ip_cached_hdrs ipcache;
     ci_ip_cache_init(&ipcache, af);
-    ci_ip_send_pkt_lookup(netif, NULL, pkt, &ipcache);
+    ci_tcp_reply_pkt_lookup(netif, NULL, pkt, &ipcache);
     ci_ip_send_pkt_send(netif, sock_cp, pkt, &ipcache);
   }
   CI_TCP_STATS_INC_OUT_SEGS(netif);
@@ -2051,6 +2232,62 @@ ci_tcp_may_send_ack_ratelimited(ci_netif* netif, ci_tcp_state* ts)
   return 0;
 }
 
+/* Answer a retransmitted SYN from a peer whose Fast Open data we accepted.
+ * The SYN-ACK was probably lost, and the peer won't accept anything else
+ * until it gets one.  Returns 1 if the packet has been consumed.
+ */
+int ci_tcp_send_fastopen_synack(ci_netif* netif, ci_tcp_state* ts,
+                                ci_ip_pkt_fmt* pkt)
+{
+  ci_tcp_hdr* tcp;
+  ci_uint8* opt;
+  int optlen = 0;
+  int af = ipcache_af(&ts->s.pkt);
+
+  ci_assert_flags(ts->tcpflags, CI_TCPT_FLAG_TFO | CI_TCPT_FLAG_PASSIVE_OPENED);
+
+  if( OO_SP_NOT_NULL(ts->local_peer) ||
+      ! ci_tcp_may_send_ack_ratelimited(netif, ts) )
+    return 0;
+  pkt = ci_netif_pkt_rx_to_tx(netif, pkt);
+  if( pkt == NULL )
+    return 1;
+
+  oo_tx_pkt_layout_init(pkt);
+  ci_ipcache_update_flowlabel(netif, &ts->s);
+  ci_pkt_init_from_ipcache(pkt, &ts->s.pkt);
+
+  tcp = TX_PKT_IPX_TCP(af, pkt);
+  opt = CI_TCP_HDR_OPTS(tcp);
+  tcp->tcp_seq_be32 = CI_BSWAP_BE32(tcp_snd_una(ts) - 1);
+  if( ts->tcpflags & CI_TCPT_FLAG_TSO )
+    optlen += ci_tcp_tx_opt_tso(&opt, ci_tcp_time_now(netif), ts->tsrecent);
+  optlen += ci_tcp_tx_insert_syn_options(netif, ts->amss, ts->tcpflags,
+                                         ts->rcv_wscl, NULL, -1, &opt);
+  tcp->tcp_flags = CI_TCP_FLAG_SYN | CI_TCP_FLAG_ACK;
+  CI_TCP_HDR_SET_LEN(tcp, sizeof(ci_tcp_hdr) + optlen);
+
+  ci_tcp_ipx_hdr_init(af, oo_tx_ipx_hdr(af, pkt),
+                      CI_IPX_HDR_SIZE(af) + sizeof(ci_tcp_hdr) + optlen);
+  tcp->tcp_ack_be32 = CI_BSWAP_BE32(tcp_rcv_nxt(ts));
+  tcp->tcp_window_be16 =
+    CI_BSWAP_BE16(ci_tcp_calc_rcv_wnd_syn(ts->s.so.rcvbuf, ts->amss,
+                                          ts->rcv_wscl));
+
+  LOG_TC(log(LNT_FMT "Fast Open SYN-ACK resent s=%08x a=%08x",
+             LNT_PRI_ARGS(netif, ts), tcp_snd_una(ts) - 1,
+             tcp_rcv_nxt(ts)));
+
+  pkt->buf_len = ( oo_tx_ether_hdr_size(pkt) + CI_IPX_HDR_SIZE(af)
+                   + sizeof(ci_tcp_hdr) + optlen );
+  pkt->pay_len = pkt->buf_len;
+
+  __ci_ip_send_tcp(netif, pkt, ts);
+  CI_TCP_STATS_INC_OUT_SEGS(netif);
+  ci_netif_pkt_release(netif, pkt);
+  return 1;
+}
+
 /* Return 1 if the packet have been consumed. */
 int ci_tcp_send_challenge_ack(ci_netif* netif, ci_tcp_state* ts,
                                ci_ip_pkt_fmt* pkt)
@@ -21,6 +21,7 @@ ci_inline int ci_tcp_tx_opt_tso(ci_uint8** opt,
 /* finish off a transmitted data segment by:
 **   - snarfing a timestamp for RTT measurement
 **   - timestamps
+**   - recording the transmit time for RACK
 ** could be a place to deal with ECN.
 ** We could not deal with outgoing SACK here, because it will change packet
 ** length.
@@ -61,6 +62,11 @@ ci_inline void ci_tcp_tx_finish(ci_netif* netif, ci_tcp_state* ts,
     }
   }
 
+#if CI_CFG_TCP_RACK
+  if( NI_OPTS(netif).tcp_rack )
+    pkt->pf.tcp_tx.xmit_time = ci_ip_time_now_us(netif);
+#endif
+
   tcp->tcp_seq_be32 = CI_BSWAP_BE32(seq);
 }
 
@@ -192,6 +192,8 @@ static void ci_tcp_tx_merge_indirect(ci_netif* __restrict__ ni,
       if( split_zcp->is_remote ) {
         zcp->use_remote_cookie = split_zcp->use_remote_cookie;
         split_zcp->use_remote_cookie = 0;
+        zcp->is_msg_zerocopy = split_zcp->is_msg_zerocopy;
+        zcp->zerocopy_id = split_zcp->zerocopy_id;
         zcp->remote.app_cookie = split_zcp->remote.app_cookie;
         zcp->remote.addr_space = split_zcp->remote.addr_space;
         for( i = 0; i < oo_stack_intf_max(ni); ++i )
@@ -261,6 +263,12 @@ static ci_ip_pkt_fmt* ci_tcp_tx_allocate_pkt(ci_netif* ni, ci_tcp_state* ts,
   next->pf.tcp_tx.end_seq   = next->pf.tcp_tx.start_seq;
   next->pf.tcp_tx.block_end = OO_PP_NULL;
   next->pf.tcp_tx.sock_id   = pkt->pf.tcp_tx.sock_id;
+#if CI_CFG_TCP_RACK
+  next->pf.tcp_tx.xmit_time = pkt->pf.tcp_tx.xmit_time;
+#endif
+  /* Unsent data keeps the time of its send call for the latency
+   * histogram.  Elsewhere the field is onload_tcpdump's. */
+  next->tstamp_frc = qu == &ts->send ? pkt->tstamp_frc : 0;
 
   /* Flags in [next] match those in [pkt], with the exception of the SENDPAGE
   ** flag, which may be different depending on the distribution of zerocopied
@@ -497,6 +505,13 @@ int ci_tcp_tx_coalesce(ci_netif* ni, ci_tcp_state* ts,
   }
 
   next->pf.tcp_tx.start_seq += bytes_moved;
+#if CI_CFG_TCP_RACK
+  /* RACK must not think the data from [next] was sent earlier than it
+   * was. */
+  if( bytes_moved && ! is_sendq &&
+      TIME_GT(next->pf.tcp_tx.xmit_time, pkt->pf.tcp_tx.xmit_time) )
+    pkt->pf.tcp_tx.xmit_time = next->pf.tcp_tx.xmit_time;
+#endif
 
   if( SEQ_EQ(next->pf.tcp_tx.start_seq, next->pf.tcp_tx.end_seq) ) {
     /* Preserve the PSH bit. */
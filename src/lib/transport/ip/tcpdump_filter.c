@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Capture filter for onload_tcpdump.
+ *
+ * onload_tcpdump compiles its filter expression to classic BPF and installs
+ * it in the stack, which runs it before queuing a packet for dumping.  That
+ * way packets which don't match neither take dump queue entries nor push
+ * out those which do.
+ *
+ * The program is in the shared stack state, where any process mapping the
+ * stack can change it while we run it, so each instruction is copied before
+ * use and nothing is trusted: loads are bounds checked, jumps only go
+ * forwards and must stay within the program, and anything unexpected
+ * rejects the packet.
+ */
+
+#include "ip_internal.h"
+#include <linux/filter.h>
+
+#if CI_CFG_TCPDUMP
+
+/* The frame as the filter sees it */
+struct oo_dump_filter_frame {
+  const ci_uint8* data;
+  ci_uint32 len;        /* bytes of the first buffer that can be loaded */
+  ci_uint32 skip;       /* bytes of 802.1Q tag to skip after the MACs */
+  int zero_macs;        /* loopback frames have no real MAC addresses */
+};
+
+
+/* Load [size] bytes at [off] as a big-endian value.  Returns false if they
+ * are out of bounds. */
+static int oo_dump_filter_load(const struct oo_dump_filter_frame* f,
+                               ci_uint32 off, unsigned size, ci_uint32* val)
+{
+  ci_uint32 v = 0;
+  unsigned i;
+
+  if( off >= f->len || size > f->len - off )
+    return 0;
+  for( i = 0; i < size; ++i, ++off ) {
+    if( off >= 2 * ETH_ALEN )
+      v = (v << 8) | f->data[off + f->skip];
+    else
+      v = (v << 8) | (f->zero_macs ? 0 : f->data[off]);
+  }
+  *val = v;
+  return 1;
+}
+
+
+int oo_tcpdump_filter_match(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ci_netif_state* ns = ni->state;
+  struct oo_dump_filter_frame f;
+  ci_uint32 mem[BPF_MEMWORDS];
+  ci_uint32 a = 0, x = 0, src, wirelen;
+  unsigned pc, n;
+
+  n = CI_MIN(OO_ACCESS_ONCE(ns->dump_filter_len), CI_CFG_DUMP_FILTER_LEN);
+
+  f.data = (const ci_uint8*) oo_ether_hdr(pkt);
+  f.len = pkt->n_buffers > 1 ? pkt->buf_len : pkt->pay_len;
+  f.len = CI_MIN(f.len, (ci_uint32) (CI_CFG_PKT_BUF_SIZE -
+                                     (f.data - (const ci_uint8*) pkt)));
+  f.skip = 0;
+  f.zero_macs = pkt->intf_i == OO_INTF_I_LOOPBACK;
+  wirelen = pkt->pay_len;
+  if( ns->dump_filter_vlan && f.len >= 2 * ETH_ALEN + ETH_VLAN_HLEN &&
+      *(const ci_uint16*) (f.data + 2 * ETH_ALEN) == CI_ETHERTYPE_8021Q ) {
+    f.skip = ETH_VLAN_HLEN;
+    f.len -= ETH_VLAN_HLEN;
+    wirelen -= ETH_VLAN_HLEN;
+  }
+  memset(mem, 0, sizeof(mem));
+
+  for( pc = 0; pc < n; ++pc ) {
+    oo_dump_filter_insn insn = ns->dump_filter[pc];
+    ci_compiler_barrier();
+
+    src = BPF_SRC(insn.code) == BPF_X ? x : insn.k;
+    switch( insn.code ) {
+    case BPF_RET | BPF_K:
+      return insn.k != 0;
+    case BPF_RET | BPF_A:
+      return a != 0;
+
+    case BPF_LD | BPF_W | BPF_ABS:
+      if( ! oo_dump_filter_load(&f, insn.k, 4, &a) )
+        return 0;
+      break;
+    case BPF_LD | BPF_H | BPF_ABS:
+      if( ! oo_dump_filter_load(&f, insn.k, 2, &a) )
+        return 0;
+      break;
+    case BPF_LD | BPF_B | BPF_ABS:
+      if( ! oo_dump_filter_load(&f, insn.k, 1, &a) )
+        return 0;
+      break;
+    case BPF_LD | BPF_W | BPF_IND:
+      if( ! oo_dump_filter_load(&f, x + insn.k, 4, &a) )
+        return 0;
+      break;
+    case BPF_LD | BPF_H | BPF_IND:
+      if( ! oo_dump_filter_load(&f, x + insn.k, 2, &a) )
+        return 0;
+      break;
+    case BPF_LD | BPF_B | BPF_IND:
+      if( ! oo_dump_filter_load(&f, x + insn.k, 1, &a) )
+        return 0;
+      break;
+    case BPF_LDX | BPF_B | BPF_MSH:
+      if( ! oo_dump_filter_load(&f, insn.k, 1, &x) )
+        return 0;
+      x = (x & 0xf) << 2;
+      break;
+    case BPF_LD | BPF_W | BPF_LEN:
+      a = wirelen;
+      break;
+    case BPF_LDX | BPF_W | BPF_LEN:
+      x = wirelen;
+      break;
+    case BPF_LD | BPF_IMM:
+      a = insn.k;
+      break;
+    case BPF_LDX | BPF_IMM:
+      x = insn.k;
+      break;
+    case BPF_LD | BPF_MEM:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      a = mem[insn.k];
+      break;
+    case BPF_LDX | BPF_MEM:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      x = mem[insn.k];
+      break;
+    case BPF_ST:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      mem[insn.k] = a;
+      break;
+    case BPF_STX:
+      if( insn.k >= BPF_MEMWORDS )
+        return 0;
+      mem[insn.k] = x;
+      break;
+
+    case BPF_ALU | BPF_ADD | BPF_K:
+    case BPF_ALU | BPF_ADD | BPF_X:
+      a += src;
+      break;
+    case BPF_ALU | BPF_SUB | BPF_K:
+    case BPF_ALU | BPF_SUB | BPF_X:
+      a -= src;
+      break;
+    case BPF_ALU | BPF_MUL | BPF_K:
+    case BPF_ALU | BPF_MUL | BPF_X:
+      a *= src;
+      break;
+    case BPF_ALU | BPF_DIV | BPF_K:
+    case BPF_ALU | BPF_DIV | BPF_X:
+      if( src == 0 )
+        return 0;
+      a /= src;
+      break;
+    case BPF_ALU | BPF_MOD | BPF_K:
+    case BPF_ALU | BPF_MOD | BPF_X:
+      if( src == 0 )
+        return 0;
+      a %= src;
+      break;
+    case BPF_ALU | BPF_AND | BPF_K:
+    case BPF_ALU | BPF_AND | BPF_X:
+      a &= src;
+      break;
+    case BPF_ALU | BPF_OR | BPF_K:
+    case BPF_ALU | BPF_OR | BPF_X:
+      a |= src;
+      break;
+    case BPF_ALU | BPF_XOR | BPF_K:
+    case BPF_ALU | BPF_XOR | BPF_X:
+      a ^= src;
+      break;
+    case BPF_ALU | BPF_LSH | BPF_K:
+    case BPF_ALU | BPF_LSH | BPF_X:
+      a = src < 32 ? a << src : 0;
+      break;
+    case BPF_ALU | BPF_RSH | BPF_K:
+    case BPF_ALU | BPF_RSH | BPF_X:
+      a = src < 32 ? a >> src : 0;
+      break;
+    case BPF_ALU | BPF_NEG:
+      a = -a;
+      break;
+
+    /* Jumps past the end of the program fall out of the loop. */
+    case BPF_JMP | BPF_JA:
+      if( insn.k >= n - pc )
+        return 0;
+      pc += insn.k;
+      break;
+    case BPF_JMP | BPF_JEQ | BPF_K:
+    case BPF_JMP | BPF_JEQ | BPF_X:
+      pc += a == src ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGT | BPF_K:
+    case BPF_JMP | BPF_JGT | BPF_X:
+      pc += a > src ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JGE | BPF_K:
+    case BPF_JMP | BPF_JGE | BPF_X:
+      pc += a >= src ? insn.jt : insn.jf;
+      break;
+    case BPF_JMP | BPF_JSET | BPF_K:
+    case BPF_JMP | BPF_JSET | BPF_X:
+      pc += (a & src) ? insn.jt : insn.jf;
+      break;
+
+    case BPF_MISC | BPF_TAX:
+      x = a;
+      break;
+    case BPF_MISC | BPF_TXA:
+      a = x;
+      break;
+
+    default:
+      return 0;
+    }
+  }
+
+  /* A program must end by returning. */
+  return 0;
+}
+
+#endif /* CI_CFG_TCPDUMP */
@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Transmit pacing.
+ *
+ * A socket with SO_MAX_PACING_RATE, or a TCP connection with
+ * EF_TCP_AUTO_PACING, has a token bucket of bytes that may be sent, filled
+ * at the pacing rate.  The bucket holds two timer ticks' worth of bytes
+ * plus a couple of segments, because a socket that runs out is released by
+ * the pacing timer up to two ticks later, and must not lose what it was
+ * owed in the meantime.  TCP limits how far
+ * ci_tcp_tx_advance() may go by the tokens, and UDP holds datagrams back on
+ * [tx_pace_head] until there are tokens for them.
+ *
+ * A socket that is held back goes on the stack's [pace_q], and [pace_tid]
+ * releases the whole queue when the first of them expects to have tokens
+ * again.  So sends from throttled sockets are batched per tick, and the
+ * rate is met over a tick rather than per packet; between ticks, TCP sends
+ * as ACKs arrive if the bucket has refilled.
+ *
+ * Tokens are refilled from the cached cycle counter, so that the rate does
+ * not depend on how often the bucket is looked at.
+ */
+
+#include "ip_internal.h"
+
+#if CI_CFG_TX_PACING
+
+#define LPF "pace "
+
+/* Longest interval credited by one refill, as a fraction of a second given
+ * as a shift.  Together with CI_TX_PACE_RATE_MAX this keeps the arithmetic
+ * in 64 bits; the rest of a longer interval is credited by later refills.
+ */
+#define CI_TX_PACE_INTERVAL_SHIFT  4
+
+
+ci_inline ci_uint64 ci_tx_pace_hz(ci_ip_timer_state* its)
+{
+  return (ci_uint64) its->khz * 1000;
+}
+
+
+void ci_tx_pace_init(ci_netif* ni)
+{
+  ci_netif_state* nis = ni->state;
+
+  ci_ip_timer_init(ni, &nis->pace_tid,
+                   oo_ptr_to_statep(ni, &nis->pace_tid),
+                   "pace");
+  nis->pace_tid.fn = CI_IP_TIMER_NETIF_TX_PACE;
+  oo_p_dllink_init(ni, oo_p_dllink_ptr(ni, &nis->pace_q));
+}
+
+
+ci_int32 ci_tx_pace_tokens(ci_netif* ni, ci_sock_cmn* s, ci_uint64 rate,
+                           ci_int32 quantum)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint64 hz = ci_tx_pace_hz(its);
+  ci_uint64 now = its->frc;
+  ci_uint64 elapsed, depth, add;
+
+  ci_assert_gt(rate, 0);
+  ci_assert_lt(rate, CI_TX_PACE_RATE_MAX);
+
+  elapsed = CI_MIN(now - s->pace_stamp,
+                   hz >> CI_TX_PACE_INTERVAL_SHIFT);
+  depth = ((rate << (its->ci_ip_time_frc2tick + 1)) / hz) + quantum;
+  add = rate * elapsed / hz;
+
+  if( (ci_int64) s->pace_tokens + (ci_int64) add >= (ci_int64) depth ) {
+    s->pace_tokens = depth;
+    s->pace_stamp = now;
+  }
+  else if( add != 0 ) {
+    s->pace_tokens += add;
+    /* Keep the part of the interval that was worth less than a byte.
+     * Rounding up means the rate is never exceeded. */
+    s->pace_stamp += (add * hz + rate - 1) / rate;
+  }
+  return s->pace_tokens;
+}
+
+
+void ci_tx_pace_throttle(ci_netif* ni, ci_sock_cmn* s, ci_uint64 rate,
+                         ci_int32 need)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_netif_state* nis = ni->state;
+  struct oo_p_dllink_state link = oo_p_dllink_sb(ni, &s->b, &s->pace_link);
+  ci_uint64 cycles = 0;
+  ci_iptime_t t;
+
+  if( oo_p_dllink_is_empty(ni, link) )
+    oo_p_dllink_add(ni, oo_p_dllink_ptr(ni, &nis->pace_q), link);
+
+  if( need > s->pace_tokens )
+    cycles = (ci_uint64) (need - s->pace_tokens) * ci_tx_pace_hz(its) / rate;
+  t = ci_ip_time_now(ni) + (ci_iptime_t) (cycles >> its->ci_ip_time_frc2tick)
+      + 1;
+  LOG_TV(log(LPF NS_FMT "need=%d tokens=%d until %u", NS_PRI_ARGS(ni, s),
+             need, s->pace_tokens, t));
+
+  if( ! ci_ip_timer_pending(ni, &nis->pace_tid) )
+    ci_ip_timer_set(ni, &nis->pace_tid, t);
+  else if( TIME_LT(t, nis->pace_tid.time) )
+    ci_ip_timer_modify(ni, &nis->pace_tid, t);
+}
+
+
+ci_uint64 ci_tcp_pace_rate(ci_netif* ni, ci_tcp_state* ts)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(ni);
+  ci_uint64 rate = ts->s.pace_max_rate;
+  ci_uint64 ticks_per_sec, auto_rate;
+
+  /* Below the resolution of srtt there is nothing to go on, and on a path
+   * that short there is little queueing for pacing to avoid. */
+  if( NI_OPTS(ni).tcp_auto_pacing && ts->sa != 0 ) {
+    /* sa is eight times srtt in ticks. */
+    ticks_per_sec = ci_tx_pace_hz(its) >> its->ci_ip_time_frc2tick;
+    auto_rate = ((ci_uint64) ts->cwnd << 3) * ticks_per_sec / ts->sa;
+    if( ts->cwnd < ts->ssthresh )
+      auto_rate *= 2;
+    else
+      auto_rate = auto_rate * 6 / 5;
+    rate = CI_MIN(rate, auto_rate);
+  }
+
+  if( rate >= CI_TX_PACE_RATE_MAX )
+    return 0;
+  return CI_MAX(rate, 1);
+}
+
+
+void ci_tx_pace_timeout(ci_netif* ni)
+{
+  struct oo_p_dllink_state list = oo_p_dllink_ptr(ni, &ni->state->pace_q);
+  struct oo_p_dllink_state lnk, tmp;
+  ci_sock_cmn* s;
+  ci_tcp_state* ts;
+
+  CITP_STATS_NETIF_INC(ni, tx_pace_timeouts);
+
+  /* Sockets that are still short of tokens go back on the queue at the
+   * head, so this visits each one once. */
+  oo_p_dllink_for_each_safe(ni, lnk, tmp, list) {
+    s = CI_CONTAINER(ci_sock_cmn, pace_link, lnk.l);
+    oo_p_dllink_del_init(ni, lnk);
+    if( s->b.state == CI_TCP_STATE_UDP ) {
+      ci_udp_sendmsg_send_paced(ni, SOCK_TO_UDP(s), 0);
+    }
+    else if( s->b.state & CI_TCP_STATE_TCP_CONN ) {
+      ts = SOCK_TO_TCP(s);
+      if( ci_ip_queue_not_empty(&ts->send) )
+        ci_tcp_tx_advance(ts, ni);
+    }
+  }
+}
+
+#endif
@@ -42,6 +42,10 @@ static void ci_udp_hdrs_init(ci_ip_cached_hdrs* ipcache)
 ** There are no IP options, no destination addresses, no ports */
 static void ci_udp_state_init(ci_netif* netif, ci_udp_state* us)
 {
+#if CI_CFG_UDP_SEND_RING
+  int i;
+#endif
+
   ci_sock_cmn_init(netif, &us->s, 1);
 
   /* IP_MULTICAST_LOOP is 1 by default, so we should not send multicast
@@ -90,7 +94,19 @@ static void ci_udp_state_init(ci_netif* netif, ci_udp_state* us)
   us->zc_kernel_datagram_count = 0;
   us->tx_async_q = CI_ILL_END;
   oo_atomic_set(&us->tx_async_q_level, 0);
+#if CI_CFG_UDP_SEND_RING
+  us->tx_ring_head = 0;
+  us->tx_ring_tail = 0;
+  us->tx_ring_kick = 0;
+  for( i = 0; i < CI_CFG_UDP_SEND_RING; ++i )
+    us->tx_ring[i] = OO_PP_ID_NULL;
+#endif
+#if CI_CFG_TX_PACING
+  us->tx_pace_head = OO_PP_NULL;
+  us->tx_pace_tail = OO_PP_NULL;
+#endif
   us->tx_count = 0;
+  us->gso_size = 0;
   us->udpflags = CI_UDPF_MCAST_LOOP;
   us->future_intf_i = 0;
   us->ip_pktinfo_cache.intf_i = -1;
@@ -271,6 +287,8 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
          uss.max_recvq_pkts);
   logger(log_arg, "%s  rcv: os=%u(%u%%) os_slow=%u os_error=%u", pf,
          rx_os, percent(rx_os, rx_total), uss.n_rx_os_slow, uss.n_rx_os_error);
+  logger(log_arg, "%s  rcv: gro=%u gro_segs=%u", pf,
+         uss.n_rx_gro, uss.n_rx_gro_segs);
 
   /* Send path. */
   logger(log_arg, "%s  snd: q=%u+%u ul=%u os=%u(%u%%)", pf,
@@ -319,6 +337,21 @@ void ci_udp_state_dump(ci_netif* ni, ci_udp_state* us, const char* pf,
          uss.n_tx_eagain, uss.n_tx_spin, uss.n_tx_block);
   logger(log_arg, "%s  snd: poll_avoids_full=%d fragments=%d confirm=%d", pf,
          uss.n_tx_poll_avoids_full, uss.n_tx_fragments, uss.n_tx_msg_confirm);
+  logger(log_arg, "%s  snd: gso_size=%u gso=%u gso_segs=%u", pf,
+         us->gso_size, uss.n_tx_gso, uss.n_tx_gso_segs);
+#if CI_CFG_UDP_SEND_RING
+  logger(log_arg, "%s  snd: ring=%u(%u%%) full=%u drains=%u max_batch=%u "
+         "head=%u tail=%u", pf, uss.n_tx_ring,
+         percent(uss.n_tx_ring, n_tx_onload), uss.n_tx_ring_full,
+         uss.n_tx_ring_drains, uss.tx_ring_max_batch,
+         us->tx_ring_head, us->tx_ring_tail);
+#endif
+#if CI_CFG_TX_PACING
+  if( us->s.pace_max_rate != CI_TX_PACE_RATE_UNLIMITED )
+    logger(log_arg, "%s  snd: paced=%u(%u%%) held=%s", pf, uss.n_tx_paced,
+           percent(uss.n_tx_paced, n_tx_onload),
+           OO_PP_IS_NULL(us->tx_pace_head) ? "no" : "yes");
+#endif
   logger(log_arg,
          "%s  snd: os_slow=%d os_late=%d unconnect_late=%d nomac=%u(%u%%)", pf,
          uss.n_tx_os_slow, uss.n_tx_os_late, uss.n_tx_unconnect_late,
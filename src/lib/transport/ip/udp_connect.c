@@ -760,6 +760,12 @@ void ci_udp_all_fds_gone(ci_netif* netif, oo_sp sock_id, int do_free)
 #endif
   ci_udp_recv_q_drop(netif, &us->recv_q);
   oo_p_dllink_del(netif, oo_p_dllink_sb(netif, &us->s.b, &us->s.reap_link));
+#if CI_CFG_TX_PACING
+  /* Datagrams held back by pacing were accepted by sendmsg(), so send
+   * them now rather than wait. */
+  ci_udp_sendmsg_send_paced(netif, us, 1);
+  ci_tx_pace_cancel(netif, &us->s);
+#endif
 
   if( OO_PP_NOT_NULL(us->zc_kernel_datagram) ) {
     ci_ip_pkt_fmt* pkt = PKT_CHK(netif, us->zc_kernel_datagram);
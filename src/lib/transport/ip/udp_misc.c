@@ -54,6 +54,9 @@ void ci_udp_perform_deferred_socket_work(ci_netif* ni, ci_udp_state* us)
 {
   ci_assert(us->s.b.state == CI_TCP_STATE_UDP);
 
+#if CI_CFG_UDP_SEND_RING
+  ci_udp_sendmsg_send_ring(ni, us);
+#endif
   ci_udp_sendmsg_send_async_q(ni, us);
 }
 #endif
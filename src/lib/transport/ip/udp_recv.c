@@ -146,6 +146,140 @@ oo_copy_pkt_to_iovec_no_adv(ci_netif* ni, const ci_ip_pkt_fmt* pkt,
 
 
 #ifndef __KERNEL__
+/* As oo_copy_pkt_to_iovec_no_adv(), but leaves [piov] pointing just past
+ * the copied data, so that several datagrams can be copied back to back.
+ */
+static int
+oo_copy_pkt_to_iovec(ci_netif* ni, const ci_ip_pkt_fmt* pkt,
+                     ci_iovec_ptr* piov, int bytes_to_copy)
+{
+  int rc, copied;
+  struct oo_copy_state ocs;
+  ocs.bytes_copied = 0;
+  ocs.bytes_to_copy = bytes_to_copy;
+  ocs.pkt_off = 0;
+  ocs.pkt = pkt;
+
+  while( 1 ) {
+    ocs.pkt_left = oo_offbuf_left(&(ocs.pkt->buf)) - ocs.pkt_off;
+    ocs.from = oo_offbuf_ptr(&(ocs.pkt->buf));
+    copied = ocs.bytes_copied;
+    rc = __oo_copy_frag_to_iovec_no_adv(ni, piov, &ocs);
+    if( rc == 0 ) {
+      /* The last chunk is not consumed from [piov] by the above. */
+      ci_iovec_ptr_advance(piov, ocs.bytes_copied - copied);
+      return ocs.bytes_copied;
+    }
+    else if( rc == 1 )
+      continue;
+    else if( rc < 0 )
+      return rc;
+    else
+      ci_assert(0);
+  }
+}
+
+
+/* Limits on the datagrams returned by a single read with UDP_GRO, as in
+ * Linux. */
+#define CI_UDP_MAX_GRO_SEGS   64
+#define CI_UDP_MAX_GRO_BYTES  0xffff
+
+static bool ci_udp_gro_same_flow(ci_ip_pkt_fmt* pkt1, ci_ip_pkt_fmt* pkt2)
+{
+  int af = oo_pkt_af(pkt1);
+  ci_addr_t saddr1, saddr2, daddr1, daddr2;
+
+  if( oo_pkt_af(pkt2) != af || pkt1->intf_i != pkt2->intf_i ||
+      pkt1->vlan != pkt2->vlan )
+    return false;
+  saddr1 = RX_PKT_SADDR(pkt1);
+  saddr2 = RX_PKT_SADDR(pkt2);
+  daddr1 = RX_PKT_DADDR(pkt1);
+  daddr2 = RX_PKT_DADDR(pkt2);
+  return CI_IPX_ADDR_EQ(saddr1, saddr2) && CI_IPX_ADDR_EQ(daddr1, daddr2) &&
+         ((ci_udp_hdr*) oo_ipx_data(af, pkt1))->udp_source_be16 ==
+         ((ci_udp_hdr*) oo_ipx_data(af, pkt2))->udp_source_be16;
+}
+
+
+/* Returns the number of datagrams at the head of the receive queue,
+ * starting with [pkt], which can be returned together by one read with
+ * UDP_GRO.  Like the kernel, we require the datagrams to be from the same
+ * flow and have the same size, except that the last one may be shorter.
+ * Unlike the kernel, we stop when the user's buffer is full rather than
+ * truncate.
+ */
+static int ci_udp_recvmsg_gro_segs(ci_netif* ni, ci_udp_state* us,
+                                   ci_ip_pkt_fmt* pkt, int space)
+{
+  ci_ip_pkt_fmt* first = pkt;
+  ci_ip_pkt_fmt* next;
+  int gro_size = pkt->pf.udp.pay_len;
+  int bytes = gro_size;
+  /* Buffers queued behind [pkt]: we must not look beyond the packets
+   * which have been completely added to the queue. */
+  int avail = ci_udp_recv_q_pkts(&us->recv_q) - pkt->n_buffers;
+  int n = 1;
+
+  if( gro_size == 0 || (pkt->flags & CI_PKT_FLAG_INDIRECT) )
+    return 1;
+#if CI_CFG_ZC_RECV_FILTER
+  /* The filter callback is given one datagram at a time. */
+  if( us->recv_q_filter )
+    return 1;
+#endif
+
+  while( n < CI_UDP_MAX_GRO_SEGS && avail > 0 &&
+         (next = ci_udp_recv_q_next(ni, pkt)) != NULL ) {
+    int len = next->pf.udp.pay_len;
+
+    if( next->n_buffers > avail || len == 0 || len > gro_size ||
+        bytes + len > space || bytes + len > CI_UDP_MAX_GRO_BYTES ||
+        (next->flags & CI_PKT_FLAG_INDIRECT) ||
+        ! ci_udp_gro_same_flow(first, next) )
+      break;
+    avail -= next->n_buffers;
+    bytes += len;
+    ++n;
+    if( len < gro_size )
+      break;
+    pkt = next;
+  }
+
+  return n;
+}
+
+
+/* Copy [n_segs] datagrams, the first of which is [pkt], to [piov] and
+ * remove them from the receive queue. */
+static int ci_udp_recvmsg_get_gro(ci_udp_recv_info* rinf, ci_iovec_ptr* piov,
+                                  ci_ip_pkt_fmt* pkt, int n_segs)
+{
+  ci_netif* ni = rinf->a->ni;
+  ci_udp_state* us = rinf->a->us;
+  int i, rc, bytes = 0;
+
+  for( i = 0; i < n_segs; ++i ) {
+    if( i != 0 ) {
+      pkt = ci_udp_recv_q_get(ni, &us->recv_q);
+      ci_assert(pkt);
+    }
+    rc = oo_copy_pkt_to_iovec(ni, pkt, piov, pkt->pf.udp.pay_len);
+    if(CI_UNLIKELY( rc < 0 ))
+      return bytes > 0 ? bytes : rc;
+    ci_assert_equal(rc, pkt->pf.udp.pay_len);
+    bytes += rc;
+    ci_netif_lat_hist_sample(ni, &us->s, CI_LAT_HIST_RX, pkt->tstamp_frc);
+    ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
+  }
+
+  ++us->stats.n_rx_gro;
+  us->stats.n_rx_gro_segs += n_segs;
+  return bytes;
+}
+
+
 /* Max number of iovecs needed:
  * = max_datagram / (min_mtu - udp_header)
  * = 65536 / (576 - 28) 
@@ -241,6 +375,9 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
   ci_msghdr* msg = rinf->msg;
   ci_ip_pkt_fmt* pkt;
   int rc;
+#ifndef __KERNEL__
+  int gro_segs = 1;
+#endif
 
   /* NB. [msg] can be NULL for async recv. */
 
@@ -249,8 +386,13 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 
 #ifndef __KERNEL__
   if( msg != NULL ) {
-    if( CI_UNLIKELY(us->s.cmsg_flags != 0 ) )
-      ci_ip_cmsg_recv(ni, us, pkt, msg, 0, &rinf->msg_flags);
+    if(CI_UNLIKELY( (us->udpflags & CI_UDPF_GRO) &&
+                    ! (rinf->flags & MSG_PEEK) ))
+      gro_segs = ci_udp_recvmsg_gro_segs(ni, us, pkt,
+                                         ci_iovec_ptr_bytes_count(piov));
+    if( CI_UNLIKELY(us->s.cmsg_flags != 0 || gro_segs > 1) )
+      ci_ip_cmsg_recv(ni, us, pkt, msg, 0, &rinf->msg_flags,
+                      gro_segs > 1 ? pkt->pf.udp.pay_len : 0);
     else
       msg->msg_controllen = 0;
   }
@@ -258,6 +400,14 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
   us->stamp = pkt->tstamp_frc;
   us->future_intf_i = pkt->intf_i;
 
+#ifndef __KERNEL__
+  if(CI_UNLIKELY( gro_segs > 1 )) {
+    ci_udp_recvmsg_fill_msghdr(ni, msg, pkt, &us->s);
+    us->udpflags |= CI_UDPF_LAST_RECV_ON;
+    return ci_udp_recvmsg_get_gro(rinf, piov, pkt, gro_segs);
+  }
+#endif
+
   rc = oo_copy_pkt_to_iovec_no_adv(ni, pkt, piov, pkt->pf.udp.pay_len);
 
   if(CI_LIKELY( rc >= 0 )) {
@@ -298,6 +448,7 @@ static int ci_udp_recvmsg_get(ci_udp_recv_info* rinf, ci_iovec_ptr* piov)
 # endif
 #endif
 
+      ci_netif_lat_hist_sample(ni, &us->s, CI_LAT_HIST_RX, pkt->tstamp_frc);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
     }
     us->udpflags |= CI_UDPF_LAST_RECV_ON;
@@ -1144,7 +1295,7 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
         args->msg.msghdr.msg_controllen = supplied_controllen;
         args->msg.msghdr.msg_control = supplied_control;
         ci_ip_cmsg_recv(ni, us, pkt, &args->msg.msghdr, 0,
-                        &args->msg.msghdr.msg_flags);
+                        &args->msg.msghdr.msg_flags, 0);
       }
       else
         args->msg.msghdr.msg_controllen = 0;
@@ -1173,6 +1324,7 @@ int ci_udp_zc_recv(ci_udp_iomsg_args* a, struct onload_zc_recv_args* args)
 
       ci_pkt_zc_free_clean(pkt, cb_rc);
 
+      ci_netif_lat_hist_sample(ni, &us->s, CI_LAT_HIST_RX, pkt->tstamp_frc);
       ci_udp_recv_q_deliver(ni, &us->recv_q, pkt);
 
       done_callback = 1;
@@ -314,7 +314,10 @@ void ci_udp_handle_rx(ci_netif* ni, ci_ip_pkt_fmt* pkt, ci_udp_hdr* udp,
     int oo_vi_flags =
       (0 <= pkt->intf_i && pkt->intf_i < oo_stack_intf_max(ni)) ?
         ni->state->nic[pkt->intf_i].oo_vi_flags : 0;
-    if( (pkt->rx_flags & CI_PKT_RX_FLAG_RX_SHARED) ||
+    /* A reassembled datagram can't be passed to the kernel, as the
+     * fragments it was made from no longer exist. */
+    if( (pkt->rx_flags & (CI_PKT_RX_FLAG_RX_SHARED |
+                          CI_PKT_RX_FLAG_REASSEMBLED)) ||
         ((oo_vi_flags & OO_VI_FLAGS_HW_MULTICAST_REPLICATION) &&
           ci_eth_addr_is_multicast(oo_ether_dhost(pkt))) ) {
       CITP_STATS_NETIF_INC(ni, no_match_pass_to_kernel_udp);
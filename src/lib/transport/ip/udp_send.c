@@ -76,6 +76,7 @@ struct udp_send_info {
   int                   stack_locked;
   ci_uint32             timeout;
   int                   old_ipcache_updated;
+  ci_uint16             gso_size;
 };
 
 static bool ci_ipx_is_first_frag(int af, ci_ipx_hdr_t* ipx)
@@ -648,9 +649,9 @@ static void fixup_pkt_not_transmitted(ci_netif *ni, ci_ip_pkt_fmt* pkt)
 }
 
 
-static void ci_udp_sendmsg_send(ci_netif* ni, ci_udp_state* us,
-                                ci_ip_pkt_fmt* pkt, int flags,
-                                struct udp_send_info* sinf)
+static void __ci_udp_sendmsg_send(ci_netif* ni, ci_udp_state* us,
+                                  ci_ip_pkt_fmt* pkt, int flags,
+                                  struct udp_send_info* sinf)
 {
   ci_ip_pkt_fmt* first_pkt = pkt;
   ci_ip_cached_hdrs* ipcache;
@@ -774,6 +775,12 @@ static void ci_udp_sendmsg_send(ci_netif* ni, ci_udp_state* us,
   /* Linux allows sending IPv6 packets with zero Hop Limit field */
   if( ipcache_ttl(ipcache) || ipcache_is_ipv6(ipcache) ) {
     if(CI_LIKELY( ipcache_onloadable )) {
+      if( CI_UNLIKELY( first_pkt->tstamp_frc != 0 ) ) {
+        ci_netif_lat_hist_sample(ni, &us->s, CI_LAT_HIST_TX,
+                                 first_pkt->tstamp_frc);
+        /* Looped back multicast takes its own stamp. */
+        first_pkt->tstamp_frc = 0;
+      }
       /* TODO: Hit the doorbell just once. */
       while( 1 ) {
         oo_pkt_p next = pkt->next;
@@ -889,6 +896,89 @@ static int ci_udp_tx_datagram_level(ci_netif* ni, ci_ip_pkt_fmt* pkt,
 }
 
 
+#if CI_CFG_TX_PACING
+void ci_udp_sendmsg_send_paced(ci_netif* ni, ci_udp_state* us, int all)
+{
+  ci_uint64 rate = ci_tx_pace_max_rate(&us->s);
+  ci_ip_pkt_fmt* pkt;
+  int flags, level;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  while( OO_PP_NOT_NULL(us->tx_pace_head) ) {
+    pkt = PKT_CHK(ni, us->tx_pace_head);
+    level = ci_udp_tx_datagram_level(ni, pkt, CI_TRUE);
+    if( ! all && rate != 0 ) {
+      if( ci_tx_pace_tokens(ni, &us->s, rate, level) <= 0 ) {
+        ci_tx_pace_throttle(ni, &us->s, rate, 1);
+        return;
+      }
+      us->s.pace_tokens -= level;
+    }
+    us->tx_pace_head = pkt->netif.tx.dmaq_next;
+    oo_atomic_add(&us->tx_async_q_level, -level);
+    if( pkt->flags & CI_PKT_FLAG_MSG_CONFIRM )
+      flags = MSG_CONFIRM;
+    else
+      flags = 0;
+    __ci_udp_sendmsg_send(ni, us, pkt, flags, NULL);
+    ci_netif_pkt_release(ni, pkt);
+  }
+}
+
+
+/* Holds [pkt] back if the socket is out of pacing tokens, or if earlier
+ * datagrams are still held back.  Returns true if it was held back, and
+ * otherwise the caller should send it now.
+ */
+static int ci_udp_sendmsg_pace(ci_netif* ni, ci_udp_state* us,
+                               ci_ip_pkt_fmt* pkt, int flags)
+{
+  ci_uint64 rate = ci_tx_pace_max_rate(&us->s);
+  int level = ci_udp_tx_datagram_level(ni, pkt, CI_TRUE);
+
+  if( OO_PP_NOT_NULL(us->tx_pace_head) )
+    ci_udp_sendmsg_send_paced(ni, us, 0);
+  if( OO_PP_IS_NULL(us->tx_pace_head) ) {
+    if( rate == 0 )
+      return 0;
+    if( ci_tx_pace_tokens(ni, &us->s, rate, level) > 0 ) {
+      us->s.pace_tokens -= level;
+      return 0;
+    }
+  }
+
+  if( flags & MSG_CONFIRM )
+    pkt->flags |= CI_PKT_FLAG_MSG_CONFIRM;
+  ci_netif_pkt_hold(ni, pkt);
+  pkt->netif.tx.dmaq_next = OO_PP_NULL;
+  if( OO_PP_IS_NULL(us->tx_pace_head) )
+    us->tx_pace_head = OO_PKT_P(pkt);
+  else
+    PKT_CHK(ni, us->tx_pace_tail)->netif.tx.dmaq_next = OO_PKT_P(pkt);
+  us->tx_pace_tail = OO_PKT_P(pkt);
+  oo_atomic_add(&us->tx_async_q_level, level);
+  ++us->stats.n_tx_paced;
+  ci_tx_pace_throttle(ni, &us->s, rate, 1);
+  return 1;
+}
+#endif
+
+
+static void ci_udp_sendmsg_send(ci_netif* ni, ci_udp_state* us,
+                                ci_ip_pkt_fmt* pkt, int flags,
+                                struct udp_send_info* sinf)
+{
+#if CI_CFG_TX_PACING
+  if(CI_UNLIKELY( us->s.pace_max_rate != CI_TX_PACE_RATE_UNLIMITED ||
+                  OO_PP_NOT_NULL(us->tx_pace_head) ) &&
+     ci_udp_sendmsg_pace(ni, us, pkt, flags) )
+    return;
+#endif
+  __ci_udp_sendmsg_send(ni, us, pkt, flags, sinf);
+}
+
+
 void ci_udp_sendmsg_send_async_q(ci_netif* ni, ci_udp_state* us)
 {
   oo_pkt_p pp, send_list;
@@ -929,6 +1019,117 @@ void ci_udp_sendmsg_send_async_q(ci_netif* ni, ci_udp_state* us)
   }
 }
 
+#if CI_CFG_UDP_SEND_RING
+void ci_udp_sendmsg_send_ring(ci_netif* ni, ci_udp_state* us)
+{
+  ci_ip_pkt_fmt* pkt;
+  oo_pkt_p pp;
+  unsigned i, n = 0;
+  int flags, level = 0;
+
+  ci_assert(ci_netif_is_locked(ni));
+
+  /* Senders which fill a slot after this will arrange another drain. */
+  us->tx_ring_kick = 0;
+  ci_mb();
+
+  while( 1 ) {
+    i = us->tx_ring_head & (CI_CFG_UDP_SEND_RING - 1);
+    OO_PP_INIT(ni, pp, us->tx_ring[i]);
+    if( OO_PP_IS_NULL(pp) )
+      break;
+    ci_rmb();
+    /* The slot must be seen to be empty before it is seen to be free. */
+    us->tx_ring[i] = OO_PP_ID_NULL;
+    ci_wmb();
+    ++us->tx_ring_head;
+
+    pkt = PKT_CHK(ni, pp);
+    level += ci_udp_tx_datagram_level(ni, pkt, CI_TRUE);
+    if( pkt->flags & CI_PKT_FLAG_MSG_CONFIRM )
+      flags = MSG_CONFIRM;
+    else
+      flags = 0;
+    ci_udp_sendmsg_send(ni, us, pkt, flags, NULL);
+    ci_netif_pkt_release(ni, pkt);
+    ++n;
+  }
+
+  if( n == 0 )
+    return;
+  oo_atomic_add(&us->tx_async_q_level, -level);
+  us->stats.n_tx_ring += n;
+  ++us->stats.n_tx_ring_drains;
+  if( n > us->stats.tx_ring_max_batch )
+    us->stats.tx_ring_max_batch = n;
+}
+
+
+/* Leave a datagram in the send ring for the lock holder.  Returns false if
+ * the ring is full.  The stats are updated by the lock holder, as the
+ * socket isn't locked here.
+ */
+static int ci_udp_sendmsg_ring_put(ci_netif* ni, ci_udp_state* us,
+                                   ci_ip_pkt_fmt* pkt)
+{
+  ci_uint32 tail;
+
+  do {
+    tail = us->tx_ring_tail;
+    if( tail - us->tx_ring_head >= CI_CFG_UDP_SEND_RING )
+      return 0;
+  } while( ci_cas32u_fail(&us->tx_ring_tail, tail, tail + 1) );
+
+  ci_wmb();
+  us->tx_ring[tail & (CI_CFG_UDP_SEND_RING - 1)] = OO_PKT_ID(pkt);
+
+  /* Only the first sender since the last drain needs to get the lock
+   * holder's attention.  Everyone else's datagram will be picked up by the
+   * drain which that sender arranged, as the drain clears [tx_ring_kick]
+   * before looking at the ring.
+   */
+  ci_mb();
+  if( us->tx_ring_kick == 0 && ci_cas32u_succeed(&us->tx_ring_kick, 0, 1) &&
+      ci_netif_lock_or_defer_work(ni, &us->s.b) )
+    ci_netif_unlock(ni);
+  return 1;
+}
+
+
+/* The send ring is full.  Sending this datagram via [tx_async_q] would let
+ * it overtake those in the ring, so wait for the stack lock and send the
+ * ring and then the datagram.  Returns false if the wait was interrupted.
+ */
+static int ci_udp_sendmsg_ring_full(ci_netif* ni, ci_udp_state* us,
+                                    ci_ip_pkt_fmt* pkt, int flags)
+{
+  int rc = ci_netif_lock(ni);
+
+  if(CI_UNLIKELY( ci_netif_lock_was_interrupted(rc) ))
+    return 0;
+  ++us->stats.n_tx_ring_full;
+  ci_udp_sendmsg_send_ring(ni, us);
+  oo_atomic_add(&us->tx_async_q_level,
+                -ci_udp_tx_datagram_level(ni, pkt, CI_TRUE));
+  ci_udp_sendmsg_send(ni, us, pkt, flags, NULL);
+  ci_netif_pkt_release(ni, pkt);
+  ci_netif_unlock(ni);
+  return 1;
+}
+#endif
+
+
+/* Datagrams left by other senders go before ours. */
+ci_inline void ci_udp_sendmsg_send_queued(ci_netif* ni, ci_udp_state* us)
+{
+#if CI_CFG_UDP_SEND_RING
+  if( us->tx_ring_head != us->tx_ring_tail )
+    ci_udp_sendmsg_send_ring(ni, us);
+#endif
+  ci_udp_sendmsg_send_async_q(ni, us);
+}
+
+
 static void ci_udp_sendmsg_async_q_enqueue(ci_netif* ni, ci_udp_state* us,
                                            ci_ip_pkt_fmt* pkt, int flags)
 {
@@ -938,6 +1139,14 @@ static void ci_udp_sendmsg_async_q_enqueue(ci_netif* ni, ci_udp_state* us,
 
   oo_atomic_add(&us->tx_async_q_level, 
                 ci_udp_tx_datagram_level(ni, pkt, CI_FALSE));
+#if CI_CFG_UDP_SEND_RING
+  /* With the ring in use, [tx_async_q] takes datagrams only when waiting
+   * for the lock was interrupted, so the two queues aren't interleaved. */
+  if( NI_OPTS(ni).udp_send_ring &&
+      (ci_udp_sendmsg_ring_put(ni, us, pkt) ||
+       ci_udp_sendmsg_ring_full(ni, us, pkt, flags)) )
+    return;
+#endif
   do
     OO_PP_INIT(ni, pkt->netif.tx.dmaq_next, us->tx_async_q);
   while( ci_cas32_fail(&us->tx_async_q,
@@ -1215,6 +1424,7 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
   if( rc != 0 )
     return rc;
   oo_tx_pkt_layout_init(first_pkt);
+  first_pkt->tstamp_frc = ci_netif_lat_hist_tx_stamp(ni);
 
   /* ID for IPv6 case should only be generated when fragmentation is really
    * required. */
@@ -1361,6 +1571,119 @@ int ci_udp_sendmsg_fill(ci_netif* ni, ci_udp_state* us,
 }
 
 
+/* Maximum number of datagrams a single UDP_SEGMENT send may produce.  This
+ * matches UDP_MAX_SEGMENTS in Linux. */
+#define CI_UDP_MAX_GSO_SEGS  64
+
+
+/* Send [bytes_to_send] as a train of datagrams with [sinf->gso_size] bytes
+ * of payload each (the last one may be shorter).  This is equivalent to
+ * calling sendmsg() once per datagram, but the caller pays for the call,
+ * the control plane lookup and the stack lock only once.
+ *
+ * As with the kernel, the send is all-or-nothing: if we fail to fill any
+ * of the datagrams then none of them is sent.
+ */
+static void ci_udp_sendmsg_gso(ci_netif* ni, ci_udp_state* us,
+                               ci_iovec_ptr* piov, int bytes_to_send,
+                               int flags, struct udp_send_info* sinf)
+{
+  oo_pkt_p segs[CI_UDP_MAX_GSO_SEGS];
+  struct oo_pkt_filler pf;
+  ci_ip_pkt_fmt* pkt;
+  int af = ipcache_af(&us->s.pkt);
+  int was_locked = sinf->stack_locked;
+  int bytes_left = bytes_to_send;
+  int n_segs = 0;
+  int i, rc;
+
+  ci_assert_gt(bytes_to_send, sinf->gso_size);
+  ci_assert_le(CI_IPX_HDR_SIZE(af) + sizeof(ci_udp_hdr) + sinf->gso_size,
+               sinf->ipcache.mtu);
+
+  pf.alloc_pkt = NULL;
+  while( bytes_left > 0 ) {
+    int seg_bytes = CI_MIN(bytes_left, (int) sinf->gso_size);
+
+    ci_assert_lt(n_segs, CI_UDP_MAX_GSO_SEGS);
+    rc = ci_udp_sendmsg_fill(ni, us, piov, seg_bytes, flags, &pf, sinf,
+                             false);
+    if(CI_UNLIKELY( rc < 0 ))
+      goto fill_failed;
+    TX_PKT_SET_DADDR(af, pf.pkt, ipcache_raddr(&sinf->ipcache));
+    TX_PKT_IPX_UDP(af, pf.pkt, false)->udp_dest_be16 =
+        sinf->ipcache.dport_be16;
+#if CI_CFG_TIMESTAMPING
+    /* All the datagrams report the same key, as they do with the kernel
+     * stack. */
+    if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID )
+      pf.pkt->ts_key = us->s.ts_key;
+#endif
+    segs[n_segs++] = OO_PKT_P(pf.pkt);
+    bytes_left -= seg_bytes;
+  }
+#if CI_CFG_TIMESTAMPING
+  if( us->s.timestamping_flags & ONLOAD_SOF_TIMESTAMPING_OPT_ID )
+    ci_atomic32_inc(&us->s.ts_key);
+#endif
+  if( sinf->stack_locked && ! was_locked )
+    ++us->stats.n_tx_lock_pkt;
+
+  ++us->stats.n_tx_gso;
+  us->stats.n_tx_gso_segs += n_segs;
+  sinf->rc = bytes_to_send;
+
+  if( si_trylock_and_inc(ni, sinf, us->stats.n_tx_lock_snd) ) {
+    ci_udp_sendmsg_send_queued(ni, us);
+    for( i = 0; i < n_segs; ++i ) {
+      pkt = PKT_CHK(ni, segs[i]);
+      ci_udp_sendmsg_send(ni, us, pkt, flags, sinf);
+      ci_netif_pkt_release(ni, pkt);
+    }
+    ci_netif_unlock(ni);
+    sinf->stack_locked = 0;
+  }
+  else {
+    for( i = 0; i < n_segs; ++i )
+      ci_udp_sendmsg_async_q_enqueue(ni, us, PKT_CHK_NNL(ni, segs[i]),
+                                     flags);
+  }
+  return;
+
+ fill_failed:
+  sinf->rc = rc;
+  if( n_segs == 0 )
+    return;
+  if( ! sinf->stack_locked && ci_netif_lock(ni) == 0 )
+    sinf->stack_locked = 1;
+
+  /* Drop the datagrams we have filled.  As in ci_udp_sendmsg_fill(), the
+   * kernel may have failed to get the lock if interrupted by a signal, and
+   * then frees the buffers atomically. */
+#ifdef __KERNEL__
+  if( ! sinf->stack_locked )
+    ci_netif_set_merge_atomic_flag(ni);
+#else
+  ci_assert(sinf->stack_locked);
+#endif
+  for( i = 0; i < n_segs; ++i ) {
+    int n_buffers;
+
+    pkt = PKT_CHK_NNL(ni, segs[i]);
+    for( n_buffers = pkt->n_buffers; n_buffers > 0; --n_buffers )
+      CI_NETIF_STATE_MOD(ni, sinf->stack_locked, n_async_pkts, -);
+    /* Drop the ref taken for ci_netif_send(). */
+    ci_assert_gt(pkt->refcount, 1);
+    pkt->refcount--;
+#ifdef __KERNEL__
+    ci_netif_pkt_release_mnl(ni, pkt, &sinf->stack_locked);
+#else
+    ci_netif_pkt_release(ni, pkt);
+#endif
+  }
+}
+
+
 static
 void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
                            const ci_msghdr* msg, int flags,
@@ -1373,6 +1696,7 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
   int was_locked;
   int af = ipcache_af(&us->s.pkt);
   bool need_frag = false;
+  bool gso = false;
 
   /* Caller should guarantee the following: */
   ci_assert(ni);
@@ -1395,9 +1719,29 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     ci_iovec_ptr_init(&piov, NULL, 0);
   }
 
-  if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
-      sizeof(ci_udp_hdr) )
+  if( sinf->gso_size != 0 && bytes_to_send > sinf->gso_size ) {
+    /* UDP_SEGMENT: each segment must fit in the path MTU, and there is a
+     * limit on the number of segments.  Same errors as Linux. */
+    if( CI_IPX_HDR_SIZE(af) + sizeof(ci_udp_hdr) + sinf->gso_size >
+        sinf->ipcache.mtu ) {
+      /* As for an oversized datagram with DF, the error queue is the OS's
+       * business. */
+      if( is_sock_flag_always_df_set(&us->s, af) &&
+          is_sockopt_flag_ip_recverr_set(&us->s, af) )
+        goto send_via_os;
+      sinf->rc = -EINVAL;
+      return;
+    }
+    if( bytes_to_send > (unsigned long) sinf->gso_size * CI_UDP_MAX_GSO_SEGS ) {
+      sinf->rc = -EINVAL;
+      return;
+    }
+    gso = true;
+  }
+  else if( bytes_to_send > sinf->ipcache.mtu - CI_IPX_HDR_SIZE(af) -
+           sizeof(ci_udp_hdr) ) {
     need_frag = true;
+  }
 
   /* For now we don't allocate packets in advance, so init to NULL */
   pf.alloc_pkt = NULL;
@@ -1407,6 +1751,10 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
     goto no_space_or_too_big;
 
  back_to_fast_path:
+  if( gso ) {
+    ci_udp_sendmsg_gso(ni, us, &piov, bytes_to_send, flags, sinf);
+    return;
+  }
   was_locked = sinf->stack_locked;
   if( need_frag && is_sock_flag_always_df_set(&us->s, af) ) {
     /* We are trying to send too large a datagram with DontFragment bit */
@@ -1459,6 +1807,7 @@ void ci_udp_sendmsg_onload(ci_netif* ni, ci_udp_state* us,
         sinf->ipcache.dport_be16;
 
     if( si_trylock_and_inc(ni, sinf, us->stats.n_tx_lock_snd) ) {
+      ci_udp_sendmsg_send_queued(ni, us);
       ci_udp_sendmsg_send(ni, us, pf.pkt, flags, sinf);
       ci_netif_pkt_release(ni, pf.pkt);
       ci_netif_unlock(ni);
@@ -1541,6 +1890,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
   sinf.used_ipcache = 0;
   sinf.old_ipcache_updated = 0;
   sinf.timeout = us->s.so.sndtimeo_msec;
+  sinf.gso_size = us->gso_size;
 
 #ifndef __KERNEL__
 #ifdef __i386__
@@ -1552,7 +1902,7 @@ int ci_udp_sendmsg(ci_udp_iomsg_args *a,
 #else
   if(CI_UNLIKELY( CMSG_FIRSTHDR(msg) != NULL )) {
     void* info = NULL;
-    if( ci_ip_cmsg_send(msg, &info) != 0 || info != NULL )
+    if( ci_ip_cmsg_send(msg, &info, &sinf.gso_size) != 0 || info != NULL )
       goto send_via_os;
   }
 #endif
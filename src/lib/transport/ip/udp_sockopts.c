@@ -295,8 +295,16 @@ int ci_udp_getsockopt(citp_socket* ep, ci_fd_t fd, int level,
 #endif
 
   } else if (level == IPPROTO_UDP) {
-    /* We definitely don't support this */
-    RET_WITH_ERRNO(ENOPROTOOPT);
+    switch( optname ) {
+    case UDP_SEGMENT:
+      u = us->gso_size;
+      return ci_getsockopt_final(optval, optlen, level, &u, sizeof(u));
+    case UDP_GRO:
+      u = !!(us->udpflags & CI_UDPF_GRO);
+      return ci_getsockopt_final(optval, optlen, level, &u, sizeof(u));
+    default:
+      RET_WITH_ERRNO(ENOPROTOOPT);
+    }
   } else {
     SOCKOPT_RET_INVALID_LEVEL(&us->s);
   }
@@ -632,7 +640,31 @@ static int ci_udp_setsockopt_lk(citp_socket* ep, ci_fd_t fd, ci_fd_t os_sock,
 #endif
 
   } else if (level == IPPROTO_UDP) {
-    RET_WITH_ERRNO(ENOPROTOOPT);
+    switch( optname ) {
+    case UDP_SEGMENT:
+      if( (rc = opt_not_ok(optval, optlen, int)) )
+        goto fail_inval;
+      v = *(int*) optval;
+      if( v < 0 || v > 0xffff ) {
+        rc = -EINVAL;
+        goto fail_inval;
+      }
+      /* Sends larger than this are split into datagrams of [gso_size]
+       * bytes of payload by ci_udp_sendmsg(). */
+      us->gso_size = v;
+      break;
+    case UDP_GRO:
+      if( (rc = opt_not_ok(optval, optlen, int)) )
+        goto fail_inval;
+      /* Coalesce datagrams of the same flow in ci_udp_recvmsg(). */
+      if( *(int*) optval )
+        us->udpflags |= CI_UDPF_GRO;
+      else
+        us->udpflags &= ~CI_UDPF_GRO;
+      break;
+    default:
+      RET_WITH_ERRNO(ENOPROTOOPT);
+    }
   }
   else {
     LOG_U(log(FNS_FMT "unknown level=%d optname=%d accepted by O/S",
@@ -75,10 +75,6 @@ exec()
 Restore onload epoll fd after exec.  Currently, we get kernel epoll fd
 in the exec'ed app.
 
-epoll_pwait()
-=============
-epoll_pwait(), ppoll() and pselect() are not accelerated.
-
 multi-level poll
 ================
 If an application uses poll/epoll/select on onload epoll fd, we can
@@ -1764,6 +1760,32 @@ static ci_uint64 timeout_hr_to_us(ci_int64 hr)
 }
 
 
+/* Block in the kernel with better than millisecond precision when the
+ * timeout from epoll_pwait2() needs it.  Returns false if the caller
+ * should use epoll_pwait() instead, because the timeout is a whole number
+ * of milliseconds or because libc or the kernel lack epoll_pwait2(). */
+static bool citp_epoll_pwait2_passthrough(int epfd,
+                                          struct epoll_event* events,
+                                          int maxevents, ci_int64 hr,
+                                          const sigset_t* sigmask, int* rc)
+{
+#if CI_LIBC_HAS_epoll_pwait2
+  ci_uint64 frc_per_sec = (ci_uint64) citp.cpu_khz * 1000;
+  struct timespec ts;
+
+  if( ci_sys_epoll_pwait2 == NULL || hr >= OO_EPOLL_MAX_TIMEOUT_HR ||
+      hr % citp.cpu_khz == 0 )
+    return false;
+  ts.tv_sec = hr / frc_per_sec;
+  ts.tv_nsec = (hr % frc_per_sec) * 1000000 / citp.cpu_khz;
+  *rc = ci_sys_epoll_pwait2(epfd, events, maxevents, &ts, sigmask);
+  return *rc >= 0 || errno != ENOSYS;
+#else
+  return false;
+#endif
+}
+
+
 /* Synchronise state to kernel if:
    - EF_EPOLL_CTL_FAST=0;
    - or we are going to block (timeout != 0 && rc == 0) */
@@ -1778,7 +1800,8 @@ citp_epoll_ctl_try_sync(struct citp_epoll_fd* ep, citp_fdinfo* fdi,
 
 
 int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
-                    struct citp_ordered_wait* ordering, int maxevents,
+                    int* fds, struct citp_ordered_wait* ordering,
+                    int maxevents,
                     ci_int64 timeout_hr, const sigset_t *sigmask,
                     citp_lib_context_t *lib_context)
 {
@@ -1831,10 +1854,14 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
     if( timeout_ms )
       ep->blocking = 1;
     Log_VPOLL(ci_log("%s(%d, ..): passthrough", __FUNCTION__, fdi->fd));
-    if( sigmask != NULL )
-      rc = ci_sys_epoll_pwait(fdi->fd, events, maxevents, timeout_ms, sigmask);
-    else
-      rc = ci_sys_epoll_wait(fdi->fd, events, maxevents, timeout_ms);
+    if( ! citp_epoll_pwait2_passthrough(fdi->fd, events, maxevents,
+                                        timeout_hr, sigmask, &rc) ) {
+      if( sigmask != NULL )
+        rc = ci_sys_epoll_pwait(fdi->fd, events, maxevents, timeout_ms,
+                                sigmask);
+      else
+        rc = ci_sys_epoll_wait(fdi->fd, events, maxevents, timeout_ms);
+    }
 
     /* We don't have valid timestamps for events grabbed via the kernel, so
      * we need to ensure that the ordering info shows that.
@@ -1857,6 +1884,7 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
   eps.events = events;
   eps.events_top = events + maxevents;
   eps.ordering_info = ordering ? ordering->ordering_info : NULL;
+  eps.fds = fds;
   eps.has_epollet = 0;
   eps.phase = ep->phase;
   /* NB. We do need to call oo_per_thread_get() here (despite having
@@ -1908,6 +1936,8 @@ int citp_epoll_wait(citp_fdinfo* fdi, struct epoll_event*__restrict__ events,
         if( rc_os > 0 ) {
           rc += rc_os;
           eps.events += rc_os;
+          if( eps.fds )
+            eps.fds += rc_os;
         }
         else {
           rc_os = 0; /* ignore errors */
@@ -2157,6 +2187,8 @@ no_events:
         if( rc < 0 )
           return rc;
         eps.events += rc;
+        if( eps.fds )
+          eps.fds += rc;
       }
 
 #if CI_CFG_EPOLL3
@@ -2486,6 +2518,8 @@ citp_ul_epoll_store_event(struct oo_ul_epoll_state*__restrict__ eps,
   eps->events[0].events = events;
   eps->events[0].data = eitem->epoll_data.data;
   ++eps->events;
+  if( eps->fds )
+    *eps->fds++ = eitem->fd;
 #if CI_CFG_TIMESTAMPING
   if( eps->ordering_info ) {
     citp_fdinfo* fdi = citp_ul_epoll_member_to_fdi(eitem);
@@ -2843,7 +2877,7 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
   wait.poll_again = 0;
   wait.ordering_stack = ni;
   /* citp_epoll_wait will do citp_exit_lib */
-  rc = citp_epoll_wait(fdi, ep->wait_events, &wait,
+  rc = citp_epoll_wait(fdi, ep->wait_events, NULL, &wait,
                        n_socks, timeout_hr, sigmask, lib_context);
   if( rc < 0 )
     goto out;
@@ -2860,7 +2894,7 @@ int citp_epoll_ordered_wait(citp_fdinfo* fdi,
       goto new_stack;
     citp_epoll_get_ordering_limit(ni, &limit_ts);
 
-    rc = citp_epoll_wait(fdi, ep->wait_events, &wait, n_socks,
+    rc = citp_epoll_wait(fdi, ep->wait_events, NULL, &wait, n_socks,
                          0, sigmask, lib_context);
     /* We've just called citp_epoll_wait() with timeout=0, and it may
      * have rewritten the wait.next_timeout_hr value.  Rewrite it back. */
@@ -660,6 +660,10 @@ citp_fdtable_probe_restore(int fd, ci_ep_info_t * info, int print_banner,
     proto = &citp_pipe_write_protocol_impl;
     c_sock_fdi = 0;
     break;
+  case OO_FDFLAG_EP_UNIX:
+    proto = &citp_unix_protocol_impl;
+    c_sock_fdi = 0;
+    break;
   default:                   ci_assert(0);
   }
 
@@ -861,6 +865,7 @@ citp_fdtable_probe_locked(unsigned fd, int print_banner,
     case OO_FDFLAG_EP_ALIEN:
     case OO_FDFLAG_EP_PIPE_READ:
     case OO_FDFLAG_EP_PIPE_WRITE:
+    case OO_FDFLAG_EP_UNIX:
     {
       citp_fdinfo_p fdip;
 
@@ -1396,6 +1401,7 @@ static inline ci_netif* fdi_to_stack(citp_fdinfo* fdi)
     case CITP_UDP_SOCKET:
       return fdi_to_socket(fdi)->netif;
     case CITP_PIPE_FD:
+    case CITP_UNIX_FD:
       return fdi_to_pipe_fdi(fdi)->ni;
     case CITP_PASSTHROUGH_FD:
       return fdi_to_alien_fdi(fdi)->netif;
@@ -1625,6 +1631,28 @@ citp_fdtable_new_fd_set(unsigned fd, citp_fdinfo_p new_fdip, int fdt_locked)
 }
 
 
+/* Mark each of [n] newly created fds as busy, as citp_fdtable_new_fd_set()
+** with fdip_busy, extending the table at most once.
+*/
+void citp_fdtable_new_fds_busy(const int* fds, int n, int fdt_locked)
+{
+  unsigned max_fd = 0;
+  int i;
+
+  for( i = 0; i < n; ++i )
+    max_fd = CI_MAX(max_fd, (unsigned) fds[i]);
+  if( max_fd >= citp_fdtable.inited_count ) {
+    ci_assert_lt(max_fd, citp_fdtable.size);
+    if( ! fdt_locked )  CITP_FDTABLE_LOCK();
+    __citp_fdtable_extend(max_fd);
+    if( ! fdt_locked )  CITP_FDTABLE_UNLOCK();
+  }
+
+  for( i = 0; i < n; ++i )
+    citp_fdtable_new_fd_set(fds[i], fdip_busy, fdt_locked);
+}
+
+
 void citp_fdtable_insert(citp_fdinfo* fdi, unsigned fd, int fdt_locked)
 {
   ci_assert(fdi);
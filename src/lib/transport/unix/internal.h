@@ -212,6 +212,7 @@ struct citp_protocol_impl_s {
 # define        CITP_EPOLL_FD        4
 # define        CITP_EPOLLB_FD       5
 # define        CITP_PIPE_FD         6
+# define        CITP_UNIX_FD         7
 
   citp_fdops    ops;
 
@@ -464,6 +465,7 @@ extern citp_protocol_impl citp_epollb_protocol_impl CI_HV;
 #endif
 extern citp_protocol_impl citp_pipe_read_protocol_impl CI_HV;
 extern citp_protocol_impl citp_pipe_write_protocol_impl CI_HV;
+extern citp_protocol_impl citp_unix_protocol_impl CI_HV;
 extern citp_protocol_impl citp_passthrough_protocol_impl;
 
 
@@ -542,6 +544,10 @@ extern int citp_syscall_init(void) CI_HF;
 #undef socklen_t
 
 extern citp_fdinfo* citp_tcp_dup(citp_fdinfo* orig_fdi);
+extern int citp_tcp_accept_batch(citp_fdinfo* fdinfo, int* fds,
+                                 struct sockaddr_storage* addrs, int n,
+                                 int flags,
+                                 citp_lib_context_t* lib_context) CI_HF;
 
 /* Locking order:
  * - citp_pkt_map_lock is the innermost lock;
@@ -774,6 +780,8 @@ extern void          citp_netif_cache_warn_on_fork(void) CI_HF;
 extern void          citp_fdtable_fork_hook(void) CI_HF;
 extern citp_fdinfo_p citp_fdtable_new_fd_set(unsigned fd, citp_fdinfo_p,
 					     int fdt_locked) CI_HF;
+extern void          citp_fdtable_new_fds_busy(const int* fds, int n,
+                                               int fdt_locked) CI_HF;
 extern void          citp_fdtable_insert(citp_fdinfo*,
 					 unsigned fd, int fdt_locked) CI_HF;
 extern void        __citp_fdtable_reserve(int fd, int reserve) CI_HF;
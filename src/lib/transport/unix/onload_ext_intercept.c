@@ -76,6 +76,7 @@ int onload_fd_stat(int fd, struct onload_stat* stat)
       rc = 0;
       break;
     case CITP_PIPE_FD:
+    case CITP_UNIX_FD:
       if( stat ==  NULL ) {
         rc = 1;
       }
@@ -577,3 +578,46 @@ int onload_socket_unicast_nonaccel(int domain, int type, int protocol)
   return fd;
 }
 
+
+extern int onload_accept4(int fd, struct sockaddr* sa, socklen_t* p_sa_len,
+                          int flags);
+int onload_accept_batch(int fd, int* fds, struct sockaddr_storage* addrs,
+                        int n, int flags)
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  socklen_t sa_len = sizeof(*addrs);
+  int rc;
+
+  Log_CALL(ci_log("%s(%d, %p, %p, %d, 0x%x)", __FUNCTION__, fd, fds, addrs,
+                  n, flags));
+
+  if( n <= 0 ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  citp_enter_lib(&lib_context);
+  fdi = citp_fdtable_lookup(fd);
+  if( fdi != NULL && citp_fdinfo_get_type(fdi) == CITP_TCP_SOCKET ) {
+    rc = citp_tcp_accept_batch(fdi, fds, addrs, n, flags, &lib_context);
+    citp_fdinfo_release_ref(fdi, 0);
+    citp_exit_lib(&lib_context, rc >= 0);
+    Log_CALL_RESULT(rc);
+    return rc;
+  }
+  if( fdi != NULL )
+    citp_fdinfo_release_ref(fdi, 0);
+  citp_exit_lib(&lib_context, TRUE);
+
+  /* Not ours: accept one connection in the usual way. */
+  rc = onload_accept4(fd, (struct sockaddr*) addrs, addrs ? &sa_len : NULL,
+                      flags);
+  if( rc >= 0 ) {
+    fds[0] = rc;
+    rc = 1;
+  }
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
@@ -0,0 +1,374 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Implementation of the onload_ring_* submission/completion extension API.
+ *
+ * Requests are executed with the same entry points as the intercepted
+ * system calls, without blocking.  Those which would block are kept in the
+ * pending list, and onload_ring_wait() polls their fds (which polls the
+ * stacks) and retries them when they become ready.
+ *
+ * This is a convenience layer over those calls, not a faster path: each
+ * request still takes the socket and stack locks as its system call would,
+ * and completions are found by onload_ring_wait() after onload_poll()
+ * returns, rather than being posted by the stack as it processes events.
+ */
+
+#include "internal.h"
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <onload/extensions.h>
+#include <onload/extensions_ring.h>
+
+
+/* Some arbitrary sanity limit */
+#define ONLOAD_RING_MAX_ENTRIES  32768
+
+
+struct oo_ring_req {
+  struct onload_ring_sqe sqe;
+  /* connect() has returned EINPROGRESS, and we are waiting for the result */
+  bool connecting;
+};
+
+struct oo_ring_priv {
+  /* Requests in flight, in the order they were submitted.  There can't be
+   * more than cq_entries of them. */
+  struct oo_ring_req* pending;
+  unsigned n_pending;
+
+  /* Scratch space for onload_ring_wait(), one per pending request */
+  struct pollfd* pfds;
+};
+
+
+static inline unsigned oo_ring_in_flight(const struct onload_ring* ring)
+{
+  const struct oo_ring_priv* priv = ring->priv;
+  return priv->n_pending + (ring->cq_tail - ring->cq_head);
+}
+
+
+static void oo_ring_complete(struct onload_ring* ring, uint64_t user_data,
+                             int res)
+{
+  struct onload_ring_cqe* cqe;
+
+  /* Guaranteed by the in-flight limit in onload_ring_submit() */
+  ci_assert_lt(ring->cq_tail - ring->cq_head, ring->cq_entries);
+
+  cqe = &ring->cqes[ring->cq_tail & (ring->cq_entries - 1)];
+  cqe->user_data = user_data;
+  cqe->res = res;
+  cqe->flags = 0;
+  ++ring->cq_tail;
+}
+
+
+static bool oo_ring_op_is_write(int opcode)
+{
+  return opcode == ONLOAD_RING_OP_SEND || opcode == ONLOAD_RING_OP_CONNECT;
+}
+
+
+/* Requests in the same direction on the same fd must complete in order,
+ * so a request can't be attempted while an earlier one is pending.  The
+ * pending list is bounded by the ring size, so a linear search is fine.
+ * NOP doesn't use its fd, so is never held up, and never holds up others
+ * as it is never pending. */
+static bool oo_ring_req_blocked(const struct oo_ring_priv* priv, unsigned i)
+{
+  const struct onload_ring_sqe* sqe = &priv->pending[i].sqe;
+  unsigned j;
+
+  if( sqe->opcode == ONLOAD_RING_OP_NOP )
+    return false;
+  for( j = 0; j < i; ++j )
+    if( priv->pending[j].sqe.fd == sqe->fd &&
+        oo_ring_op_is_write(priv->pending[j].sqe.opcode) ==
+          oo_ring_op_is_write(sqe->opcode) )
+      return true;
+  return false;
+}
+
+
+static bool oo_ring_fd_ready(int fd, short events)
+{
+  struct pollfd pfd = { .fd = fd, .events = events };
+  return onload_poll(&pfd, 1, 0) != 0;
+}
+
+
+/* connect() and accept() have no per-call flag to stop them blocking.  On
+ * accelerated sockets we ask the stack for that with a per-thread flag.  We
+ * mustn't change O_NONBLOCK on other fds, as the file flags are shared with
+ * any other thread using the fd.  Returns true if the call may block. */
+static bool oo_ring_nonblock_begin(int fd)
+{
+  int fl;
+
+  if( onload_fd_stat(fd, NULL) > 0 ) {
+    __oo_per_thread_get()->ring_nonblock = 1;
+    return false;
+  }
+  fl = onload_fcntl(fd, F_GETFL);
+  return fl >= 0 && ! (fl & O_NONBLOCK);
+}
+
+
+static void oo_ring_nonblock_end(void)
+{
+  __oo_per_thread_get()->ring_nonblock = 0;
+}
+
+
+static int oo_ring_connect(struct oo_ring_req* req)
+{
+  const struct onload_ring_sqe* sqe = &req->sqe;
+  int rc, err;
+  socklen_t len = sizeof(err);
+
+  if( req->connecting ) {
+    if( ! oo_ring_fd_ready(sqe->fd, POLLOUT) )
+      return -EAGAIN;
+    if( onload_getsockopt(sqe->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 )
+      return -errno;
+    return -err;
+  }
+
+  /* A blocking kernel socket (including one which the stack hands the
+   * connect over to) can only connect synchronously, as the system call
+   * would. */
+  oo_ring_nonblock_begin(sqe->fd);
+  rc = onload_connect(sqe->fd, (const struct sockaddr*)(uintptr_t) sqe->addr,
+                      sqe->len);
+  err = errno;
+  oo_ring_nonblock_end();
+
+  if( rc == 0 )
+    return 0;
+  if( err == EINPROGRESS ) {
+    req->connecting = true;
+    return -EAGAIN;
+  }
+  return -err;
+}
+
+
+static int oo_ring_accept(const struct onload_ring_sqe* sqe)
+{
+  int rc;
+
+  /* A blocking kernel listener is only tried once it polls readable, so
+   * accept() blocks only if another thread takes the connection first. */
+  if( oo_ring_nonblock_begin(sqe->fd) &&
+      ! oo_ring_fd_ready(sqe->fd, POLLIN) )
+    return -EAGAIN;
+  rc = onload_accept4(sqe->fd, (struct sockaddr*)(uintptr_t) sqe->addr,
+                      (socklen_t*)(uintptr_t) sqe->addr2, sqe->msg_flags);
+  if( rc < 0 )
+    rc = errno == EWOULDBLOCK ? -EAGAIN : -errno;
+  oo_ring_nonblock_end();
+  return rc;
+}
+
+
+/* Attempt a request without blocking.  Returns the result for the CQE, or
+ * -EAGAIN if the request has to wait. */
+static int oo_ring_req_try(struct oo_ring_req* req)
+{
+  const struct onload_ring_sqe* sqe = &req->sqe;
+  ssize_t rc;
+
+  switch( sqe->opcode ) {
+  case ONLOAD_RING_OP_NOP:
+    return 0;
+  case ONLOAD_RING_OP_SEND:
+    rc = onload_send(sqe->fd, (const void*)(uintptr_t) sqe->addr, sqe->len,
+                     sqe->msg_flags | MSG_DONTWAIT);
+    break;
+  case ONLOAD_RING_OP_RECV:
+    rc = onload_recv(sqe->fd, (void*)(uintptr_t) sqe->addr, sqe->len,
+                     sqe->msg_flags | MSG_DONTWAIT);
+    break;
+  case ONLOAD_RING_OP_ACCEPT:
+    return oo_ring_accept(sqe);
+  case ONLOAD_RING_OP_CONNECT:
+    return oo_ring_connect(req);
+  default:
+    return -EINVAL;
+  }
+
+  if( rc >= 0 )
+    return rc;
+  if( errno == EWOULDBLOCK )
+    return -EAGAIN;
+  return -errno;
+}
+
+
+/* Retry the pending requests, or only those whose fds polled ready if
+ * [pfds] is given, and complete the ones which are done. */
+static void oo_ring_progress(struct onload_ring* ring,
+                             const struct pollfd* pfds)
+{
+  struct oo_ring_priv* priv = ring->priv;
+  unsigned i, n = 0;
+
+  for( i = 0; i < priv->n_pending; ++i ) {
+    struct oo_ring_req* req;
+    int rc = -EAGAIN;
+
+    /* Move down over the requests which have completed, so that entries
+     * before [n] are the earlier ones which are still pending. */
+    if( n != i )
+      priv->pending[n] = priv->pending[i];
+    req = &priv->pending[n];
+    if( (pfds == NULL || pfds[i].revents != 0) &&
+        ! oo_ring_req_blocked(priv, n) )
+      rc = oo_ring_req_try(req);
+    if( rc == -EAGAIN )
+      ++n;
+    else
+      oo_ring_complete(ring, req->sqe.user_data, rc);
+  }
+  priv->n_pending = n;
+}
+
+
+int onload_ring_init(unsigned entries, struct onload_ring* ring,
+                     unsigned flags)
+{
+  struct oo_ring_priv* priv;
+
+  Log_CALL(ci_log("%s(%u, %p, %x)", __FUNCTION__, entries, ring, flags));
+
+  if( flags != 0 || entries == 0 || entries > ONLOAD_RING_MAX_ENTRIES )
+    return -EINVAL;
+  entries = 1u << ci_log2_ge(entries, 0);
+
+  memset(ring, 0, sizeof(*ring));
+  ring->sq_entries = entries;
+  ring->cq_entries = entries * 2;
+  ring->sqes = calloc(ring->sq_entries, sizeof(*ring->sqes));
+  ring->cqes = calloc(ring->cq_entries, sizeof(*ring->cqes));
+  priv = ring->priv = calloc(1, sizeof(*priv));
+  if( priv != NULL ) {
+    priv->pending = calloc(ring->cq_entries, sizeof(*priv->pending));
+    priv->pfds = calloc(ring->cq_entries, sizeof(*priv->pfds));
+  }
+  if( ring->sqes == NULL || ring->cqes == NULL || priv == NULL ||
+      priv->pending == NULL || priv->pfds == NULL ) {
+    onload_ring_free(ring);
+    return -ENOMEM;
+  }
+  return 0;
+}
+
+
+int onload_ring_free(struct onload_ring* ring)
+{
+  struct oo_ring_priv* priv = ring->priv;
+
+  Log_CALL(ci_log("%s(%p)", __FUNCTION__, ring));
+
+  if( priv != NULL ) {
+    free(priv->pending);
+    free(priv->pfds);
+    free(priv);
+  }
+  free(ring->sqes);
+  free(ring->cqes);
+  memset(ring, 0, sizeof(*ring));
+  return 0;
+}
+
+
+int onload_ring_submit(struct onload_ring* ring)
+{
+  struct oo_ring_priv* priv = ring->priv;
+  int n = 0;
+
+  Log_CALL(ci_log("%s(%p) sq=%u", __FUNCTION__, ring,
+                  ring->sq_tail - ring->sq_head));
+
+  while( ring->sq_head != ring->sq_tail &&
+         oo_ring_in_flight(ring) < ring->cq_entries ) {
+    struct oo_ring_req* req = &priv->pending[priv->n_pending];
+    int rc = -EAGAIN;
+
+    req->sqe = ring->sqes[ring->sq_head++ & (ring->sq_entries - 1)];
+    req->connecting = false;
+    ++n;
+    if( ! oo_ring_req_blocked(priv, priv->n_pending) )
+      rc = oo_ring_req_try(req);
+    if( rc == -EAGAIN )
+      ++priv->n_pending;
+    else
+      oo_ring_complete(ring, req->sqe.user_data, rc);
+  }
+
+  if( n == 0 && ring->sq_head != ring->sq_tail )
+    n = -EBUSY;
+  Log_CALL_RESULT(n);
+  return n;
+}
+
+
+static ci_int64 oo_ring_now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ci_int64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+int onload_ring_wait(struct onload_ring* ring, unsigned min_complete,
+                     int timeout)
+{
+  struct oo_ring_priv* priv = ring->priv;
+  ci_int64 deadline = timeout >= 0 ? oo_ring_now_ms() + timeout : 0;
+  unsigned i;
+  int rc = 0;
+
+  Log_CALL(ci_log("%s(%p, %u, %d) pending=%u", __FUNCTION__, ring,
+                  min_complete, timeout, priv->n_pending));
+
+  oo_ring_progress(ring, NULL);
+
+  while( ring->cq_tail - ring->cq_head < min_complete &&
+         priv->n_pending > 0 ) {
+    int wait_ms = -1;
+
+    if( timeout >= 0 ) {
+      wait_ms = CI_MAX(deadline - oo_ring_now_ms(), 0);
+      if( wait_ms == 0 && timeout != 0 )
+        break;
+    }
+
+    for( i = 0; i < priv->n_pending; ++i ) {
+      const struct oo_ring_req* req = &priv->pending[i];
+      priv->pfds[i].fd = req->sqe.fd;
+      priv->pfds[i].events = oo_ring_op_is_write(req->sqe.opcode) ?
+                             POLLOUT : POLLIN;
+      priv->pfds[i].revents = 0;
+    }
+    /* This spins on the stacks as configured, and then sleeps. */
+    rc = onload_poll(priv->pfds, priv->n_pending, wait_ms);
+    if( rc < 0 ) {
+      rc = -errno;
+      break;
+    }
+    if( rc == 0 )
+      break;
+    oo_ring_progress(ring, priv->pfds);
+    if( timeout == 0 )
+      break;
+  }
+
+  if( rc >= 0 )
+    rc = ring->cq_tail - ring->cq_head;
+  Log_CALL_RESULT(rc);
+  return rc;
+}
@@ -74,7 +74,7 @@ static int citp_pipe_recv(citp_fdinfo* fdinfo,
   ci_assert(msg);
   ci_assert(msg->msg_iov);
 
-  return ci_pipe_read(epi->ni, epi->pipe, msg->msg_iov, msg->msg_iovlen);
+  return ci_pipe_read(epi->ni, epi->pipe, msg->msg_iov, msg->msg_iovlen, 0);
 }
 
 
@@ -87,7 +87,7 @@ static int citp_pipe_send(citp_fdinfo* fdinfo,
   ci_assert(msg);
   ci_assert(msg->msg_iov);
 
-  return ci_pipe_write(epi->ni, epi->pipe, msg->msg_iov, msg->msg_iovlen);
+  return ci_pipe_write(epi->ni, epi->pipe, msg->msg_iov, msg->msg_iovlen, 0);
 }
 
 
@@ -824,6 +824,8 @@ static int oo_pipe_init(ci_netif* ni, struct oo_pipe* p)
   p->bytes_removed = 0;
 
   p->aflags = 0;
+  p->peer = OO_SP_NULL;
+  p->ctrl_n = 0;
 
   oo_pipe_buf_clear_state(ni, p);
 
@@ -980,3 +982,948 @@ fail1:
 
   return rc;
 }
+
+
+/**********************************************************************
+ * AF_UNIX socketpair
+ *
+ * Each end of an accelerated socketpair reads its own pipe and writes the
+ * pipe of its peer, so the byte stream in each direction is an ordinary
+ * oo_pipe and reads and writes need no knowledge of sockets.
+ *
+ * Each end is also backed by an end of a kernel socketpair, its OS socket.
+ * bind(), connect(), listen(), accept() and the socket's names are passed
+ * to the OS socket, so they behave exactly as they do without Onload.
+ * Ancillary data, including SCM_RIGHTS, goes over the OS socket too, tagged
+ * with the position in the byte stream of the data sent with it.  The data
+ * itself still goes through the pipe, so readiness is the pipe's alone.
+ */
+
+#define unix_rx(_epi) ((_epi)->pipe)
+#define unix_tx(_epi) SP_TO_PIPE((_epi)->ni, (_epi)->pipe->peer)
+
+
+/* Sent over the OS socket with each message of ancillary data: the data
+ * that went with it is [len] bytes at [pos] in the pipe's byte stream. */
+struct oo_unix_ctrl {
+  ci_uint32 pos;
+  ci_uint32 len;
+};
+
+
+static ci_fd_t citp_unix_os_sock_get(citp_fdinfo* fdinfo)
+{
+  ci_fd_t os_sock = ci_get_os_sock_fd(fdinfo->fd);
+
+  if( ! CI_IS_VALID_SOCKET(os_sock) ) {
+    LOG_U(ci_log("%s: [%d] no backing socket (rc=%d)", __FUNCTION__,
+                 fdinfo->fd, os_sock));
+    errno = -os_sock;
+  }
+  return os_sock;
+}
+
+
+static int citp_unix_ctrl_peek(ci_fd_t os_sock, struct oo_unix_ctrl* ctrl)
+{
+  return ci_sys_recv(os_sock, ctrl, sizeof(*ctrl),
+                     MSG_PEEK | MSG_DONTWAIT) == sizeof(*ctrl);
+}
+
+
+/* Returns how many bytes may be read from [rx] in one go.  As in the
+ * kernel, a read stops at the end of data that was sent with ancillary
+ * data.  Ancillary data whose bytes have already gone, as they do when read
+ * without Onload, is dropped along with any descriptors in it. */
+static size_t citp_unix_ctrl_limit(citp_pipe_fdi* epi, ci_fd_t os_sock,
+                                   int flags)
+{
+  struct oo_unix_ctrl ctrl;
+  ci_int32 ahead;
+
+  while( citp_unix_ctrl_peek(os_sock, &ctrl) ) {
+    ahead = ctrl.pos - unix_rx(epi)->bytes_removed;
+    if( ahead >= 0 )
+      return ahead + ctrl.len;
+    if( (flags & MSG_PEEK) ||
+        ci_sys_recv(os_sock, &ctrl, sizeof(ctrl), MSG_DONTWAIT) !=
+          sizeof(ctrl) )
+      break;
+    ci_atomic32_dec(&unix_rx(epi)->ctrl_n);
+  }
+  return SIZE_MAX;
+}
+
+
+/* Hands the caller the ancillary data sent with the [n] bytes from [start]
+ * in the stream, which it has just read. */
+static void citp_unix_ctrl_take(citp_pipe_fdi* epi, ci_fd_t os_sock,
+                                struct msghdr* msg, int flags,
+                                void* control, size_t controllen,
+                                ci_uint32 start, int n)
+{
+  struct oo_unix_ctrl ctrl;
+  struct msghdr os_msg;
+  struct iovec iov;
+  size_t used = 0;
+  ci_int32 ahead;
+
+  while( citp_unix_ctrl_peek(os_sock, &ctrl) ) {
+    ahead = ctrl.pos - start;
+    if( ahead >= n || (ahead < 0 && (flags & MSG_PEEK)) )
+      break;
+
+    memset(&os_msg, 0, sizeof(os_msg));
+    iov.iov_base = &ctrl;
+    iov.iov_len = sizeof(ctrl);
+    os_msg.msg_iov = &iov;
+    os_msg.msg_iovlen = 1;
+    /* Ancillary data for bytes already gone is received into nothing,
+     * which makes the kernel close any descriptors in it. */
+    if( ahead >= 0 ) {
+      os_msg.msg_control = (char*) control + used;
+      os_msg.msg_controllen = controllen - used;
+    }
+    if( ci_sys_recvmsg(os_sock, &os_msg, MSG_DONTWAIT |
+                       (flags & (MSG_PEEK | MSG_CMSG_CLOEXEC))) !=
+          sizeof(ctrl) )
+      break;
+    if( ahead >= 0 ) {
+      used += os_msg.msg_controllen;
+      msg->msg_flags |= os_msg.msg_flags & MSG_CTRUNC;
+    }
+    if( flags & MSG_PEEK )
+      break;
+    ci_atomic32_dec(&unix_rx(epi)->ctrl_n);
+  }
+  msg->msg_controllen = used;
+}
+
+
+static int citp_unix_read(citp_pipe_fdi* epi, const struct iovec* iov,
+                          size_t iovlen, size_t limit, int flags)
+{
+  struct iovec* short_iov;
+  size_t i;
+  int rc;
+
+  for( i = 0; i < iovlen; ++i ) {
+    if( iov[i].iov_len >= limit )
+      break;
+    limit -= iov[i].iov_len;
+  }
+  if( i == iovlen )
+    return ci_pipe_read(epi->ni, unix_rx(epi), iov, iovlen, flags);
+
+  short_iov = CI_ALLOC_ARRAY(struct iovec, i + 1);
+  if( short_iov == NULL ) {
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(short_iov, iov, (i + 1) * sizeof(*iov));
+  short_iov[i].iov_len = limit;
+  rc = ci_pipe_read(epi->ni, unix_rx(epi), short_iov, i + 1, flags);
+  ci_free(short_iov);
+  return rc;
+}
+
+
+/* Reads into [iov] once, and takes any ancillary data sent with what it
+ * read. */
+static int citp_unix_recv_once(citp_fdinfo* fdinfo, struct msghdr* msg,
+                               const struct iovec* iov, size_t iovlen,
+                               int flags, void* control, size_t controllen)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  size_t limit = SIZE_MAX;
+  ci_fd_t os_sock = -1;
+  ci_uint32 start;
+  int rc;
+
+  if( CI_UNLIKELY(unix_rx(epi)->ctrl_n != 0) ) {
+    if( ! CI_IS_VALID_SOCKET(os_sock = citp_unix_os_sock_get(fdinfo)) )
+      return -1;
+    limit = citp_unix_ctrl_limit(epi, os_sock, flags);
+  }
+
+  start = unix_rx(epi)->bytes_removed;
+  rc = citp_unix_read(epi, iov, iovlen, limit,
+                      flags & (MSG_DONTWAIT | MSG_PEEK));
+
+  /* The peer tags ancillary data before it writes the data, so it is
+   * waiting by the time the data has been read. */
+  if( rc > 0 && CI_UNLIKELY(unix_rx(epi)->ctrl_n != 0) &&
+      (CI_IS_VALID_SOCKET(os_sock) ||
+       CI_IS_VALID_SOCKET(os_sock = citp_unix_os_sock_get(fdinfo))) )
+    citp_unix_ctrl_take(epi, os_sock, msg, flags, control, controllen,
+                        start, rc);
+  if( CI_IS_VALID_SOCKET(os_sock) )
+    ci_rel_os_sock_fd(os_sock);
+  return rc;
+}
+
+
+/* MSG_WAITALL: having read [got] bytes, reads on until the buffer is full.
+ * As in the kernel, it stops early at end-of-file, on an error or signal,
+ * or once it has been handed ancillary data. */
+static int citp_unix_recv_waitall(citp_fdinfo* fdinfo, struct msghdr* msg,
+                                  int flags, void* control,
+                                  size_t controllen, int got)
+{
+  size_t iovlen = msg->msg_iovlen;
+  size_t done = got;
+  struct iovec* iov;
+  size_t i = 0;
+  int rc;
+
+  iov = CI_ALLOC_ARRAY(struct iovec, iovlen);
+  if( iov == NULL )
+    return got;
+  memcpy(iov, msg->msg_iov, iovlen * sizeof(*iov));
+  while( msg->msg_controllen == 0 && ! (msg->msg_flags & MSG_CTRUNC) ) {
+    for( ; i < iovlen && done >= iov[i].iov_len; ++i )
+      done -= iov[i].iov_len;
+    if( i == iovlen )
+      break;
+    iov[i].iov_base = (char*) iov[i].iov_base + done;
+    iov[i].iov_len -= done;
+    rc = citp_unix_recv_once(fdinfo, msg, iov + i, iovlen - i, flags,
+                             control, controllen);
+    if( rc <= 0 )
+      break;
+    got += rc;
+    done = rc;
+  }
+  ci_free(iov);
+  return got;
+}
+
+
+static int citp_unix_recv(citp_fdinfo* fdinfo, struct msghdr* msg, int flags)
+{
+  void* control = msg->msg_control;
+  size_t controllen = msg->msg_controllen;
+  int rc;
+
+  if( flags & MSG_OOB ) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  msg->msg_controllen = 0;
+  msg->msg_flags = 0;
+  if( msg->msg_name != NULL )
+    msg->msg_namelen = 0;
+  if( msg->msg_iovlen == 0 )
+    return 0;
+
+  rc = citp_unix_recv_once(fdinfo, msg, msg->msg_iov, msg->msg_iovlen, flags,
+                           control, controllen);
+  /* A peek or a non-blocking read takes only what is there already. */
+  if( rc > 0 && (flags & MSG_WAITALL) &&
+      ! (flags & (MSG_PEEK | MSG_DONTWAIT)) )
+    rc = citp_unix_recv_waitall(fdinfo, msg, flags, control, controllen, rc);
+  return rc;
+}
+
+
+struct citp_unix_ctrl_send_ctx {
+  citp_pipe_fdi* epi;
+  const struct msghdr* msg;
+  ci_fd_t os_sock;
+  ci_uint32 len;
+  int os_sock_full;
+};
+
+
+/* Queues the ancillary data on the OS socket, tagged with the position of
+ * the first byte of the data sent with it.  Called by ci_pipe_write_cb()
+ * with the stack locked, so that no other writer can get in between. */
+static int citp_unix_ctrl_send(void* context, ci_uint32 pos)
+{
+  struct citp_unix_ctrl_send_ctx* ctx = context;
+  struct oo_unix_ctrl ctrl;
+  struct msghdr os_msg;
+  struct iovec iov;
+
+  ctrl.pos = pos;
+  ctrl.len = ctx->len;
+  memset(&os_msg, 0, sizeof(os_msg));
+  iov.iov_base = &ctrl;
+  iov.iov_len = sizeof(ctrl);
+  os_msg.msg_iov = &iov;
+  os_msg.msg_iovlen = 1;
+  os_msg.msg_control = ctx->msg->msg_control;
+  os_msg.msg_controllen = ctx->msg->msg_controllen;
+  if( ci_sys_sendmsg(ctx->os_sock, &os_msg,
+                     MSG_NOSIGNAL | MSG_DONTWAIT) < 0 ) {
+    ctx->os_sock_full = errno == EAGAIN;
+    return -errno;
+  }
+  ci_atomic32_inc(&unix_tx(ctx->epi)->ctrl_n);
+  return 0;
+}
+
+
+/* Sends data with ancillary data.  The ancillary data is tagged and queued
+ * on the OS socket just before the first byte of the data goes into the
+ * pipe, so a write which fails sends nothing. */
+static int citp_unix_send_ctrl(citp_fdinfo* fdinfo,
+                               const struct msghdr* msg, int flags)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  struct oo_pipe* tx = unix_tx(epi);
+  struct citp_unix_ctrl_send_ctx ctx;
+  struct pollfd pfd;
+  size_t len = 0;
+  int nonblock;
+  size_t i;
+  int rc;
+
+  for( i = 0; i < msg->msg_iovlen; ++i )
+    len += msg->msg_iov[i].iov_len;
+  /* As in the kernel, ancillary data goes nowhere without data. */
+  if( len == 0 )
+    return 0;
+
+  if( ! CI_IS_VALID_SOCKET(ctx.os_sock = citp_unix_os_sock_get(fdinfo)) )
+    return -1;
+  ctx.epi = epi;
+  ctx.msg = msg;
+  ctx.len = CI_MIN(len, (size_t) 0x7fffffff);  /* as a write returns int */
+  nonblock = (flags & MSG_DONTWAIT) ||
+             (tx->aflags & (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT));
+  while( 1 ) {
+    ctx.os_sock_full = 0;
+    rc = ci_pipe_write_cb(epi->ni, tx, msg->msg_iov, msg->msg_iovlen,
+                          flags & (MSG_DONTWAIT | MSG_NOSIGNAL),
+                          citp_unix_ctrl_send, &ctx);
+    if( rc >= 0 || ! ctx.os_sock_full || nonblock )
+      break;
+    /* The reader has yet to take the ancillary data already queued.  Wait
+     * for it without the stack lock, and try again. */
+    pfd.fd = ctx.os_sock;
+    pfd.events = POLLOUT;
+    if( ci_sys_poll(&pfd, 1, -1) < 0 )
+      break;
+  }
+  ci_rel_os_sock_fd(ctx.os_sock);
+  return rc;
+}
+
+
+static int citp_unix_send(citp_fdinfo* fdinfo,
+                          const struct msghdr* msg, int flags)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+
+  if( flags & MSG_OOB ) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  if( msg->msg_name != NULL ) {
+    errno = EISCONN;
+    return -1;
+  }
+  if( msg->msg_iovlen == 0 )
+    return 0;
+  if( CI_UNLIKELY(msg->msg_controllen != 0) )
+    return citp_unix_send_ctrl(fdinfo, msg, flags);
+
+  return ci_pipe_write(epi->ni, unix_tx(epi), msg->msg_iov, msg->msg_iovlen,
+                       flags & (MSG_DONTWAIT | MSG_NOSIGNAL));
+}
+
+
+static int citp_unix_recvmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
+                              unsigned vlen, int flags,
+                              ci_recvmmsg_timespec* timeout)
+{
+  unsigned i;
+  int rc;
+
+  /* Linux checks [timeout] only after each message is received, so it
+   * never cuts short a wait for data; neither do we. */
+  (void) timeout;
+  for( i = 0; i < vlen; ++i ) {
+    rc = citp_unix_recv(fdinfo, &msg[i].msg_hdr,
+                        (flags & ~MSG_WAITFORONE) |
+                        (i > 0 && (flags & MSG_WAITFORONE) ? MSG_DONTWAIT : 0));
+    if( rc < 0 )
+      return i > 0 ? i : rc;
+    msg[i].msg_len = rc;
+    if( rc == 0 )
+      return i + 1;
+  }
+  return i;
+}
+
+
+static int citp_unix_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
+                              unsigned vlen, int flags)
+{
+  unsigned i;
+  int rc;
+
+  for( i = 0; i < vlen; ++i ) {
+    rc = citp_unix_send(fdinfo, &msg[i].msg_hdr, flags);
+    if( rc < 0 )
+      return i > 0 ? i : rc;
+    msg[i].msg_len = rc;
+  }
+  return i;
+}
+
+
+static ci_uint64 citp_unix_sleep_seq(citp_fdinfo* fdi)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdi);
+  ci_sleep_seq_t seq;
+
+  seq.rw.rx = unix_rx(epi)->b.sleep_seq.rw.rx;
+  seq.rw.tx = unix_tx(epi)->b.sleep_seq.rw.tx;
+  return seq.all;
+}
+
+
+static int citp_unix_select(citp_fdinfo* fdinfo, int* n,
+                            int rd, int wr, int ex,
+                            struct oo_ul_select_state* ss)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  unsigned mask;
+
+#if CI_CFG_SPIN_STATS
+  if( CI_UNLIKELY(! ss->stat_incremented) ) {
+    epi->ni->state->stats.spin_select++;
+    ss->stat_incremented = 1;
+  }
+#endif
+
+  mask = oo_unix_poll_events(unix_rx(epi), unix_tx(epi));
+
+  if( rd && (mask & SELECT_RD_SET) ) {
+    FD_SET(fdinfo->fd, ss->rdu);
+    ++*n;
+  }
+  if( wr && (mask & SELECT_WR_SET) ) {
+    FD_SET(fdinfo->fd, ss->wru);
+    ++*n;
+  }
+
+  return 1;
+}
+
+
+static int citp_unix_poll(citp_fdinfo* fdinfo, struct pollfd* pfd,
+                          struct oo_ul_poll_state* ps)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  unsigned mask;
+
+#if CI_CFG_SPIN_STATS
+  if( CI_UNLIKELY(! ps->stat_incremented) ) {
+    epi->ni->state->stats.spin_poll++;
+    ps->stat_incremented = 1;
+  }
+#endif
+
+  mask = oo_unix_poll_events(unix_rx(epi), unix_tx(epi));
+  pfd->revents = mask & (pfd->events | POLLERR | POLLHUP);
+
+  return 1;
+}
+
+
+static int citp_unix_epoll(citp_fdinfo* fdinfo,
+                           struct citp_epoll_member* eitem,
+                           struct oo_ul_epoll_state* eps,
+                           int* stored_event)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  unsigned mask;
+  ci_uint64 sleep_seq;
+  volatile ci_uint64 sleep_seq_now;
+  int seq_mismatch = 0;
+
+#if CI_CFG_SPIN_STATS
+  if( CI_UNLIKELY(! eps->stat_incremented) ) {
+    epi->ni->state->stats.spin_epoll++;
+    eps->stat_incremented = 1;
+  }
+#endif
+
+  /* The sequence numbers live in two pipes, so sample them again after
+   * looking at the state rather than letting the caller re-read one. */
+  sleep_seq = citp_unix_sleep_seq(fdinfo);
+  ci_rmb();
+  mask = oo_unix_poll_events(unix_rx(epi), unix_tx(epi));
+  ci_rmb();
+  sleep_seq_now = citp_unix_sleep_seq(fdinfo);
+  *stored_event = citp_ul_epoll_set_ul_events(eps, eitem, mask, sleep_seq,
+                                              &sleep_seq_now, &seq_mismatch);
+  return seq_mismatch;
+}
+
+
+static void citp_unix_set_nonblock(citp_pipe_fdi* epi, int on)
+{
+  ci_uint32 rx_bit = CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_READER_SHIFT;
+  ci_uint32 tx_bit = CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT;
+
+  if( on ) {
+    ci_bit_mask_set(&unix_rx(epi)->aflags, rx_bit);
+    ci_bit_mask_set(&unix_tx(epi)->aflags, tx_bit);
+  }
+  else {
+    ci_bit_mask_clear(&unix_rx(epi)->aflags, rx_bit);
+    ci_bit_mask_clear(&unix_tx(epi)->aflags, tx_bit);
+  }
+}
+
+
+static int citp_unix_fcntl(citp_fdinfo* fdinfo, int cmd, long arg)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  int rc;
+
+  switch( cmd ) {
+  case F_GETFL:
+    rc = O_RDWR;
+    if( unix_rx(epi)->aflags &
+        (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_READER_SHIFT) )
+      rc |= O_NONBLOCK;
+    break;
+  case F_SETFL:
+    rc = ci_sys_fcntl(fdinfo->fd, cmd, arg);
+    if( rc < 0 )
+      break;
+    citp_unix_set_nonblock(epi, arg & (O_NONBLOCK | O_NDELAY));
+    break;
+  case F_SETPIPE_SZ:
+  case F_GETPIPE_SZ:
+    errno = EBADF;
+    rc = CI_SOCKET_ERROR;
+    break;
+  default:
+    return citp_pipe_fcntl(fdinfo, cmd, arg);
+  }
+
+  Log_VSC(log("%s(%d, %d, %ld) = %d  (errno=%d)",
+              __FUNCTION__, fdinfo->fd, cmd, arg, rc, errno));
+  return rc;
+}
+
+
+static int citp_unix_ioctl(citp_fdinfo* fdinfo, int cmd, void* arg)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+
+  switch( cmd ) {
+  case FIONBIO:
+    citp_unix_set_nonblock(epi, *(int*) arg);
+    return 0;
+  case FIONREAD:
+    *(int*) arg = oo_pipe_data_len(unix_rx(epi));
+    return 0;
+  case TIOCOUTQ: /* synonym of SIOCOUTQ */
+    *(int*) arg = oo_pipe_data_len(unix_tx(epi));
+    return 0;
+  default:
+    errno = ENOTTY;
+    return -1;
+  }
+}
+
+
+static int citp_unix_shutdown(citp_fdinfo* fdinfo, int how)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+
+  Log_V(log(LPF "unix shutdown(%d, %d)", fdinfo->fd, how));
+
+  if( how != SHUT_RD && how != SHUT_WR && how != SHUT_RDWR ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* The pipe code treats an end that is marked closed by its owner as
+   * shut: reads of it see end-of-file, and writes to it fail. */
+  ci_netif_lock(epi->ni);
+  if( how != SHUT_WR ) {
+    ci_atomic32_or(&unix_rx(epi)->aflags,
+                   CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_READER_SHIFT);
+    oo_pipe_wake_peer(epi->ni, unix_rx(epi),
+                      CI_SB_FLAG_WAKE_RX | CI_SB_FLAG_WAKE_TX);
+  }
+  if( how != SHUT_RD ) {
+    ci_atomic32_or(&unix_tx(epi)->aflags,
+                   CI_PFD_AFLAG_CLOSED << CI_PFD_AFLAG_WRITER_SHIFT);
+    oo_pipe_wake_peer(epi->ni, unix_tx(epi),
+                      CI_SB_FLAG_WAKE_RX | CI_SB_FLAG_WAKE_TX);
+  }
+  ci_netif_unlock(epi->ni);
+
+  return 0;
+}
+
+
+static int citp_unix_bind(citp_fdinfo* fdinfo,
+                          const struct sockaddr* sa, socklen_t sa_len)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_bind(os_sock, sa, sa_len);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  citp_fdinfo_release_ref(fdinfo, 0);
+  return rc;
+}
+
+
+static int citp_unix_listen(citp_fdinfo* fdinfo, int backlog)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_listen(os_sock, backlog);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  citp_fdinfo_release_ref(fdinfo, 0);
+  return rc;
+}
+
+
+/* The OS socket is connected, so it can never listen, and accept() fails
+ * at once; it never returns an fd that we would need to know about. */
+static int citp_unix_accept(citp_fdinfo* fdinfo,
+                            struct sockaddr* sa, socklen_t* p_sa_len,
+                            int flags, citp_lib_context_t* lib_context)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_accept4(os_sock, sa, p_sa_len, flags);
+    ci_assert_lt(rc, 0);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  return rc;
+}
+
+
+static int citp_unix_connect(citp_fdinfo* fdinfo,
+                             const struct sockaddr* sa, socklen_t sa_len,
+                             citp_lib_context_t* lib_context)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_connect(os_sock, sa, sa_len);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  citp_fdinfo_release_ref(fdinfo, 0);
+  return rc;
+}
+
+
+static int citp_unix_getsockname(citp_fdinfo* fdinfo,
+                                 struct sockaddr* sa, socklen_t* p_sa_len)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_getsockname(os_sock, sa, p_sa_len);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  return rc;
+}
+
+
+static int citp_unix_getpeername(citp_fdinfo* fdinfo,
+                                 struct sockaddr* sa, socklen_t* p_sa_len)
+{
+  ci_fd_t os_sock = citp_unix_os_sock_get(fdinfo);
+  int rc = -1;
+
+  if( CI_IS_VALID_SOCKET(os_sock) ) {
+    rc = ci_sys_getpeername(os_sock, sa, p_sa_len);
+    ci_rel_os_sock_fd(os_sock);
+  }
+  return rc;
+}
+
+
+static int citp_unix_getsockopt(citp_fdinfo* fdinfo, int level,
+                                int optname, void* optval, socklen_t* optlen)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  ci_fd_t os_sock;
+  int v, rc;
+
+  if( level != SOL_SOCKET )
+    goto os_sock;
+
+  switch( optname ) {
+  case SO_TYPE:
+    v = SOCK_STREAM;
+    break;
+  case SO_DOMAIN:
+    v = AF_UNIX;
+    break;
+  case SO_PROTOCOL:
+  case SO_ERROR:
+  case SO_ACCEPTCONN:
+    v = 0;
+    break;
+  case SO_SNDBUF:
+    v = unix_tx(epi)->bufs_max * OO_PIPE_BUF_MAX_SIZE;
+    break;
+  case SO_RCVBUF:
+    v = unix_rx(epi)->bufs_max * OO_PIPE_BUF_MAX_SIZE;
+    break;
+  default:
+    goto os_sock;
+  }
+
+  *optlen = CI_MIN(*optlen, sizeof(v));
+  memcpy(optval, &v, *optlen);
+  return 0;
+
+ os_sock:
+  /* SO_PEERCRED and the like are the same for the OS socket. */
+  if( ! CI_IS_VALID_SOCKET(os_sock = citp_unix_os_sock_get(fdinfo)) )
+    return -1;
+  rc = ci_sys_getsockopt(os_sock, level, optname, optval, optlen);
+  ci_rel_os_sock_fd(os_sock);
+  return rc;
+}
+
+
+static int citp_unix_setsockopt(citp_fdinfo* fdinfo, int level, int optname,
+                                const void* optval, socklen_t optlen)
+{
+  citp_pipe_fdi* epi = fdi_to_pipe_fdi(fdinfo);
+  struct oo_pipe* p;
+  int v, rc;
+
+  if( level != SOL_SOCKET ||
+      (optname != SO_SNDBUF && optname != SO_RCVBUF) ) {
+    rc = -ENOPROTOOPT;
+    goto out;
+  }
+  if( optlen < sizeof(int) ) {
+    rc = -EINVAL;
+    goto out;
+  }
+
+  /* Sizes beyond what a pipe can hold are clamped, as the kernel clamps
+   * them to its own limits. */
+  v = *(const int*) optval;
+  v = CI_MAX(v, OO_PIPE_MIN_BUFS * OO_PIPE_BUF_MAX_SIZE);
+  v = CI_MIN(v, OO_PIPE_MAX_BUFS * OO_PIPE_BUF_MAX_SIZE);
+  p = optname == SO_SNDBUF ? unix_tx(epi) : unix_rx(epi);
+  rc = ci_pipe_set_size(epi->ni, p, v);
+  /* A pipe that already holds more than the new size keeps its buffers. */
+  if( rc == -EBUSY )
+    rc = 0;
+
+ out:
+  citp_fdinfo_release_ref(fdinfo, 0);
+  if( rc < 0 ) {
+    errno = -rc;
+    return -1;
+  }
+  return 0;
+}
+
+
+citp_protocol_impl citp_unix_protocol_impl = {
+  .type        = CITP_UNIX_FD,
+  .ops         = {
+    .socket      = NULL,        /* nobody should ever call this */
+    .dtor        = citp_pipe_dtor,
+    .dup         = citp_pipe_dup,
+
+    .recv        = citp_unix_recv,
+    .send        = citp_unix_send,
+
+    .fcntl       = citp_unix_fcntl,
+    .ioctl       = citp_unix_ioctl,
+    .select	 = citp_unix_select,
+    .poll	 = citp_unix_poll,
+    .epoll       = citp_unix_epoll,
+    .sleep_seq   = citp_unix_sleep_seq,
+
+    .bind        = citp_unix_bind,
+    .listen      = citp_unix_listen,
+    .accept      = citp_unix_accept,
+    .connect     = citp_unix_connect,
+    .shutdown    = citp_unix_shutdown,
+    .getsockname = citp_unix_getsockname,
+    .getpeername = citp_unix_getpeername,
+    .getsockopt  = citp_unix_getsockopt,
+    .setsockopt  = citp_unix_setsockopt,
+    .recvmmsg    = citp_unix_recvmmsg,
+    .sendmmsg    = citp_unix_sendmmsg,
+    .zc_send     = citp_nonsock_zc_send,
+    .zc_recv     = citp_nonsock_zc_recv,
+    .zc_recv_filter = citp_nonsock_zc_recv_filter,
+    .recvmsg_kernel = citp_nonsock_recvmsg_kernel,
+    .tmpl_alloc    = citp_nonsock_tmpl_alloc,
+    .tmpl_update   = citp_nonsock_tmpl_update,
+    .tmpl_abort    = citp_nonsock_tmpl_abort,
+#if CI_CFG_TIMESTAMPING
+    .ordered_data   = citp_nonsock_ordered_data,
+#endif
+    .is_spinning   = citp_pipe_is_spinning,
+#if CI_CFG_FD_CACHING
+    .cache          = citp_nonsock_cache,
+#endif
+  }
+};
+
+
+static int oo_unix_ctor(ci_netif* netif, struct oo_pipe* p[2],
+                        int fds[2], int flags)
+{
+  oo_sp ids[2];
+  int os_fds[2];
+  int rc;
+
+  /* The kernel keeps its own references to the OS sockets. */
+  if( ci_sys_socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, os_fds) < 0 )
+    return -1;
+
+  ci_netif_lock(netif);
+  p[0] = oo_pipe_buf_get(netif);
+  if( p[0] == NULL ) {
+    rc = -1;
+    errno = EMFILE;
+    goto out;
+  }
+  p[1] = oo_pipe_buf_get(netif);
+  if( p[1] == NULL ) {
+    citp_waitable_obj_free(netif, &p[0]->b);
+    rc = -1;
+    errno = EMFILE;
+    goto out;
+  }
+
+  ids[0] = W_SP(&p[0]->b);
+  ids[1] = W_SP(&p[1]->b);
+  p[0]->peer = ids[1];
+  p[1]->peer = ids[0];
+  if( flags & O_NONBLOCK ) {
+    p[0]->aflags = p[1]->aflags =
+        (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_READER_SHIFT) |
+        (CI_PFD_AFLAG_NONBLOCK << CI_PFD_AFLAG_WRITER_SHIFT);
+  }
+
+  /* attach */
+  rc = ci_tcp_helper_unix_attach(ci_netif_get_driver_handle(netif),
+                                 ids, os_fds, flags, fds);
+  if( rc < 0 ) {
+    LOG_E(ci_log("%s: ci_tcp_helper_unix_attach %d", __FUNCTION__, rc));
+    errno = -rc;
+    rc = -1;
+    goto out;
+  }
+
+out:
+  ci_netif_unlock(netif);
+  ci_sys_close(os_fds[0]);
+  ci_sys_close(os_fds[1]);
+
+  return rc;
+}
+
+
+int citp_unix_socketpair(int type, int fds[2])
+{
+  citp_pipe_fdi* epi[2];
+  struct oo_pipe* p[2];
+  ci_netif* ni;
+  int flags = 0;
+  int rc = -1;
+  int i;
+  ef_driver_handle fd = -1;
+
+  Log_V(log(LPF "socketpair(AF_UNIX, %d)", type));
+
+  if( type & SOCK_NONBLOCK )
+    flags |= O_NONBLOCK;
+  if( type & SOCK_CLOEXEC )
+    flags |= O_CLOEXEC;
+
+  /* citp_netif_exists() does not need citp_ul_lock here */
+  if( CITP_OPTS.ul_unix_socketpair == CI_UNIX_PIPE_ACCELERATE_IF_NETIF &&
+      ! citp_netif_exists() ) {
+    return CITP_NOT_HANDLED;
+  }
+
+  rc = citp_netif_alloc_and_init(&fd, &ni);
+  if( rc != 0 ) {
+    if( rc == CI_SOCKET_HANDOVER )
+      return CITP_NOT_HANDLED;
+    goto fail1;
+  }
+  rc = -1;
+
+  CI_MAGIC_CHECK(ni, NETIF_MAGIC);
+
+  /* add another reference as we have 2 fdis */
+  citp_netif_add_ref(ni);
+
+  for( i = 0; i < 2; ++i ) {
+    epi[i] = CI_ALLOC_OBJ(citp_pipe_fdi);
+    if( epi[i] == NULL ) {
+      Log_U(ci_log(LPF "socketpair: failed to allocate epi"));
+      errno = ENOMEM;
+      goto fail2;
+    }
+    citp_fdinfo_init(&epi[i]->fdinfo, &citp_unix_protocol_impl);
+    epi[i]->ni = ni;
+  }
+
+  if( fdtable_strict() )  CITP_FDTABLE_LOCK();
+  rc = oo_unix_ctor(ni, p, fds, flags);
+  if( rc < 0 ) {
+    if( fdtable_strict() )  CITP_FDTABLE_UNLOCK();
+    goto fail2;
+  }
+  citp_fdtable_new_fd_set(fds[0], fdip_busy, fdtable_strict());
+  citp_fdtable_new_fd_set(fds[1], fdip_busy, fdtable_strict());
+  if( fdtable_strict() )  CITP_FDTABLE_UNLOCK();
+
+  LOG_PIPE("%s: pipes=%d,%d", __FUNCTION__, p[0]->b.bufid, p[1]->b.bufid);
+
+  for( i = 0; i < 2; ++i ) {
+    epi[i]->pipe = p[i];
+    ci_assert(p[i]->b.sb_aflags & CI_SB_AFLAG_NOT_READY);
+    ci_atomic32_and(&p[i]->b.sb_aflags, ~CI_SB_AFLAG_NOT_READY);
+  }
+  citp_fdtable_insert(&epi[0]->fdinfo, fds[0], 0);
+  citp_fdtable_insert(&epi[1]->fdinfo, fds[1], 0);
+
+  CI_MAGIC_CHECK(ni, NETIF_MAGIC);
+
+  return 0;
+
+fail2:
+  while( --i >= 0 )
+    CI_FREE_OBJ(epi[i]);
+  citp_netif_release_ref(ni, 0);
+  citp_netif_release_ref(ni, 0);
+fail1:
+  if( CITP_OPTS.no_fail && errno != ELIBACC ) {
+    Log_U(ci_log("%s: failed (errno:%d) - PASSING TO OS", __FUNCTION__, errno));
+    return CITP_NOT_HANDLED;
+  }
+
+  return rc;
+}
@@ -1226,7 +1226,7 @@ OO_INTERCEPT(int, pselect,
                   timeout_ts ? (int)timeout_ts->tv_nsec : -1,
                   sigmask));
 
-  if( ! CITP_OPTS.ul_poll || nfds <= 0 ||
+  if( ! CITP_OPTS.ul_select || nfds <= 0 ||
       (timeout_ts != NULL &&
        (timeout_ts->tv_sec < 0 || timeout_ts->tv_nsec < 0 ))) {
     rc = ci_sys_pselect(nfds, rds, wrs, exs, timeout_ts, sigmask);
@@ -1491,7 +1491,7 @@ OO_INTERCEPT(int, epoll_wait,
     int rc = CI_SOCKET_HANDOVER;
     if( fdi->protocol->type == CITP_EPOLL_FD ) {
       /* NB. citp_epoll_wait() calls citp_exit_lib(). */
-      rc = citp_epoll_wait(fdi, events, NULL, maxevents,
+      rc = citp_epoll_wait(fdi, events, NULL, NULL, maxevents,
                            oo_epoll_ms_to_frc(timeout), NULL,
                            &lib_context);
       citp_reenter_lib(&lib_context);
@@ -1542,7 +1542,7 @@ OO_INTERCEPT(int, epoll_pwait,
     int rc = CI_SOCKET_HANDOVER;
     if( fdi->protocol->type == CITP_EPOLL_FD ) {
       /* NB. citp_epoll_wait() calls citp_exit_lib(). */
-      rc = citp_epoll_wait(fdi, events, NULL, maxevents,
+      rc = citp_epoll_wait(fdi, events, NULL, NULL, maxevents,
                            oo_epoll_ms_to_frc(timeout), sigmask,
                            &lib_context);
       citp_reenter_lib(&lib_context);
@@ -1571,6 +1571,82 @@ error:
   return ci_sys_epoll_pwait(epfd, events, maxevents, timeout, sigmask);
 }
 
+#if CI_LIBC_HAS_epoll_pwait2
+static int oo_sys_epoll_pwait2(int epfd, struct epoll_event* events,
+                               int maxevents, const struct timespec* timeout,
+                               const sigset_t* sigmask)
+{
+  if( ci_sys_epoll_pwait2 == NULL ) {
+    errno = ENOSYS;
+    return -1;
+  }
+  return ci_sys_epoll_pwait2(epfd, events, maxevents, timeout, sigmask);
+}
+
+OO_INTERCEPT(int, epoll_pwait2,
+             (int epfd, struct epoll_event*events, int maxevents,
+              const struct timespec *timeout, const sigset_t *sigmask))
+{
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+
+  if(CI_UNLIKELY( citp.init_level < CITP_INIT_ALL )) {
+    citp_do_init(CITP_INIT_SYSCALLS);
+    goto pass_through;
+  }
+  if( ! CITP_OPTS.ul_epoll )
+    goto pass_through;
+  /* Let the kernel report EINVAL */
+  if( timeout != NULL &&
+      (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+       timeout->tv_nsec >= 1000000000) )
+    goto pass_through;
+
+  citp_enter_lib(&lib_context);
+  Log_CALL(ci_log("%s(%d, %p, %d, {%ld,%ld}, %p)", __FUNCTION__, epfd,
+                  events, maxevents, timeout ? (long) timeout->tv_sec : -1,
+                  timeout ? (long) timeout->tv_nsec : -1, sigmask));
+
+  if( (fdi=citp_fdtable_lookup(epfd)) ) {
+    int rc = CI_SOCKET_HANDOVER;
+    if( fdi->protocol->type == CITP_EPOLL_FD ) {
+      /* NB. citp_epoll_wait() calls citp_exit_lib(). */
+      rc = citp_epoll_wait(fdi, events, NULL, NULL, maxevents,
+                           oo_epoll_ts_to_frc(timeout), sigmask,
+                           &lib_context);
+      citp_reenter_lib(&lib_context);
+    }
+#if CI_CFG_EPOLL2
+    else if (fdi->protocol->type == CITP_EPOLLB_FD ) {
+      /* The epoll2 driver interface counts in milliseconds */
+      int timeout_ms = -1;
+      if( timeout != NULL )
+        timeout_ms = CI_MIN((ci_uint64) timeout->tv_sec * 1000 +
+                            (timeout->tv_nsec + 999999) / 1000000,
+                            (ci_uint64) 0x7fffffff);
+      rc = citp_epollb_wait(fdi, events, maxevents, timeout_ms, sigmask,
+                            &lib_context);
+    }
+#endif
+    citp_fdinfo_release_ref(fdi, 0);
+    citp_exit_lib(&lib_context, rc >= 0);
+    if( rc == CI_SOCKET_HANDOVER )
+      goto error;
+    Log_CALL_RESULT(rc);
+    return rc;
+  }
+  else {
+    citp_exit_lib(&lib_context, TRUE);
+  }
+
+error:
+  Log_PT(log("PT: sys_epoll_pwait2(%d, %p, %d, %p, %p)", epfd, events,
+             maxevents, timeout, sigmask));
+ pass_through:
+  return oo_sys_epoll_pwait2(epfd, events, maxevents, timeout, sigmask);
+}
+#endif
+
 
 
 OO_INTERCEPT(ssize_t, read,
@@ -2271,7 +2347,7 @@ OO_INTERCEPT(int, creat64,
 OO_INTERCEPT(int, socketpair,
              (int d, int type, int protocol, int sv[2]))
 {
-  int rc;
+  int rc = CITP_NOT_HANDLED;
   citp_lib_context_t lib_context;
 
   if( CI_UNLIKELY(citp.init_level < CITP_INIT_ALL) ) {
@@ -2282,14 +2358,20 @@ OO_INTERCEPT(int, socketpair,
   Log_CALL(ci_log("%s(%d, %d, %d, [%d, %d])", __FUNCTION__,d,type,protocol,
                   sv ? sv[0] : -1, sv ? sv[1] : -1));
 
-  rc = ci_sys_socketpair(d, type, protocol, sv);
   citp_enter_lib(&lib_context);
-  if( rc == 0 ) {
-    citp_fdtable_passthru(sv[0], 0);
-    citp_fdtable_passthru(sv[1], 0);
+  if( CITP_OPTS.ul_unix_socketpair && d == AF_UNIX && sv != NULL &&
+      (type & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)) == SOCK_STREAM &&
+      protocol == 0 )
+    rc = citp_unix_socketpair(type, sv);
+  if( rc == CITP_NOT_HANDLED ) {
+    rc = ci_sys_socketpair(d, type, protocol, sv);
+    if( rc == 0 ) {
+      citp_fdtable_passthru(sv[0], 0);
+      citp_fdtable_passthru(sv[1], 0);
+    }
+    Log_PT(log("PT: sys_socketpair(%d, %d, %d, sv) = %d  sv={%d,%d}",
+               d, type, protocol, rc, sv ? sv[0]:-1, sv ? sv[1]:-1));
   }
-  Log_PT(log("PT: sys_socketpair(%d, %d, %d, sv) = %d  sv={%d,%d}",
-             d, type, protocol, rc, sv ? sv[0]:-1, sv ? sv[1]:-1));
   citp_exit_lib(&lib_context, rc == 0);
   Log_CALL(ci_log("%s returning %d, [%d,%d] (errno %d)",__FUNCTION__,
                   rc,sv[0],sv[1],errno));
@@ -2799,6 +2881,9 @@ OO_INTERCEPT(long, syscall,
     NR(epoll_ctl)
     NR(epoll_wait)
     NR(epoll_pwait)
+#if CI_LIBC_HAS_epoll_pwait2 && defined(__NR_epoll_pwait2)
+    NR(epoll_pwait2)
+#endif
     /* When adding new syscalls here, make sure to check that the libc API
     matches the kernel API. It does for almost everything (on x86-64) but
     there are a few exceptions.  */
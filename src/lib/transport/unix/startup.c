@@ -71,6 +71,9 @@ void citp_setup_logging_prefix(void)
  */
 static void __oo_per_thread_init_thread(struct oo_per_thread* pt)
 {
+  static ci_uint32 accept_shard_next;
+  ci_uint32 accept_shard;
+
   /* It's possible that we got here because we're not initialised at all! */
   if( citp.init_level < CITP_INIT_SYSCALLS ) {
     if( _citp_do_init_inprogress == 0 )
@@ -114,6 +117,12 @@ static void __oo_per_thread_init_thread(struct oo_per_thread* pt)
     pt->spinstate |= (1 << ONLOAD_SPIN_STACK_LOCK);
   if( CITP_OPTS.so_busy_poll_spin )
     pt->spinstate |= (1 << ONLOAD_SPIN_SO_BUSY_POLL);
+
+  /* Spread threads over the accept queues of sharded listening sockets. */
+  do
+    accept_shard = accept_shard_next;
+  while( ci_cas32u_fail(&accept_shard_next, accept_shard, accept_shard + 1) );
+  pt->accept_shard = accept_shard;
 }
 
 
@@ -184,6 +193,7 @@ static void citp_dump_opts(citp_opts_t *o)
   DUMP_OPT_INT("EF_SA_ONSTACK_INTERCEPT",	sa_onstack_intercept);
   DUMP_OPT_INT("EF_ACCEPT_INHERIT_NONBLOCK", accept_force_inherit_nonblock);
   DUMP_OPT_INT("EF_PIPE", ul_pipe);
+  DUMP_OPT_INT("EF_UNIX_SOCKETPAIR", ul_unix_socketpair);
   DUMP_OPT_HEX("EF_SIGNALS_NOPOSTPONE", signals_no_postpone);
   DUMP_OPT_HEX("EF_SYNC_CPLANE_AT_CREATE", sync_cplane);
   DUMP_OPT_INT("EF_CLUSTER_SIZE",  cluster_size);
@@ -446,6 +456,7 @@ static void citp_opts_getenv(citp_opts_t* opts)
   GET_ENV_OPT_INT("EF_ACCEPT_INHERIT_NONBLOCK",	accept_force_inherit_nonblock);
   GET_ENV_OPT_INT("EF_VFORK_MODE",	vfork_mode);
   GET_ENV_OPT_INT("EF_PIPE",        ul_pipe);
+  GET_ENV_OPT_INT("EF_UNIX_SOCKETPAIR", ul_unix_socketpair);
   GET_ENV_OPT_INT("EF_SYNC_CPLANE_AT_CREATE",	sync_cplane);
 
   if( (s = getenv("EF_FORK_NETIF")) && sscanf(s, "%x", &v) == 1 ) {
@@ -743,8 +743,84 @@ fail:
 #endif
 
 
+/* The [get] side of the accept queue is protected by the sock lock, or by
+ * the lock of the shard [sh] if the listening socket is sharded.
+ */
+static void citp_tcp_acceptq_lock(ci_netif* ni, ci_tcp_socket_listen* listener,
+                                  struct ci_tcp_acceptq_shard* sh)
+{
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( sh != NULL )
+    ci_tcp_acceptq_shard_lock(sh);
+  else
+#endif
+    ci_sock_lock(ni, &listener->s.b);
+}
+
+
+static void citp_tcp_acceptq_unlock(ci_netif* ni,
+                                    ci_tcp_socket_listen* listener,
+                                    struct ci_tcp_acceptq_shard* sh)
+{
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( sh != NULL )
+    ci_tcp_acceptq_shard_unlock(sh);
+  else
+#endif
+    ci_sock_unlock(ni, &listener->s.b);
+}
+
+
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+/* Lock and return a non-empty accept queue shard of [listener], preferring
+ * this thread's own.  Returns NULL if all of them are empty.
+ */
+static struct ci_tcp_acceptq_shard*
+citp_tcp_acceptq_shard_lock(ci_netif* ni, ci_tcp_socket_listen* listener)
+{
+  unsigned n = CI_MIN(listener->acceptq_n_shards, CI_CFG_TCP_ACCEPTQ_SHARDS);
+  unsigned home = oo_per_thread_get()->accept_shard % n;
+  struct ci_tcp_acceptq_shard* sh;
+  unsigned i;
+
+  /* Avoid waiting for a shard which another thread is accepting from if
+   * there is something to do elsewhere. */
+  for( i = 0; i < n; ++i ) {
+    sh = &listener->acceptq_shard[(home + i) % n];
+    if( ci_tcp_acceptq_shard_not_empty(sh) &&
+        ci_tcp_acceptq_shard_trylock(sh) ) {
+      if( ci_tcp_acceptq_shard_not_empty(sh) ) {
+        if( i != 0 )
+          CITP_STATS_NETIF_INC(ni, acceptq_shard_steals);
+        return sh;
+      }
+      ci_tcp_acceptq_shard_unlock(sh);
+    }
+  }
+
+  for( i = 0; i < n; ++i ) {
+    sh = &listener->acceptq_shard[(home + i) % n];
+    if( ! ci_tcp_acceptq_shard_not_empty(sh) )
+      continue;
+    ci_tcp_acceptq_shard_lock(sh);
+    if( ci_tcp_acceptq_shard_not_empty(sh) ) {
+      if( i != 0 )
+        CITP_STATS_NETIF_INC(ni, acceptq_shard_steals);
+      return sh;
+    }
+    ci_tcp_acceptq_shard_unlock(sh);
+  }
+  return NULL;
+}
+#endif
+
+
+/* Must hold the accept queue lock (see citp_tcp_acceptq_lock()), which is
+ * dropped.
+ */
 static int citp_tcp_accept_ul(citp_fdinfo* fdinfo, ci_netif* ni,
 			      ci_tcp_socket_listen* listener,
+                              struct ci_tcp_acceptq_shard* sh,
 			      struct sockaddr* sa, socklen_t* p_sa_len,
                               int flags)
 {
@@ -764,14 +840,23 @@ static int citp_tcp_accept_ul(citp_fdinfo* fdinfo, ci_netif* ni,
 redo:
 #endif
   /* Pop the socket off the accept queue. */
-  ci_assert(ci_sock_is_locked(ni, &listener->s.b));
-  ci_assert(ci_tcp_acceptq_not_empty(listener));
-  w = ci_tcp_acceptq_get(ni, listener);
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( sh != NULL ) {
+    ci_assert(ci_tcp_acceptq_shard_not_empty(sh));
+    w = ci_tcp_acceptq_shard_get(ni, listener, sh);
+  }
+  else
+#endif
+  {
+    ci_assert(ci_sock_is_locked(ni, &listener->s.b));
+    ci_assert(ci_tcp_acceptq_not_empty(listener));
+    w = ci_tcp_acceptq_get(ni, listener);
+  }
 
 #if CI_CFG_ENDPOINT_MOVE
   if( w->sb_aflags & CI_SB_AFLAG_MOVED_AWAY ) {
     int rc;
-    ci_sock_unlock(ni, &listener->s.b);
+    citp_tcp_acceptq_unlock(ni, listener, sh);
     rc = citp_tcp_accept_alien(ni, listener, sa, p_sa_len, flags, w);
     if( rc != CI_ACCEPT_FAKED_UP )
       return rc;
@@ -795,22 +880,29 @@ redo:
   if( from_cache ) {
     /* We need a listening socket lock to remove from the epcache list.
      * But faked-up loopback connection can't be cached, so we are safe
-     * here. */
+     * here.  Sharded accept queues are not used with caching.  */
     ci_assert(! unlocked);
+    ci_assert(sh == NULL);
     oo_p_dllink_del_init(ni, oo_p_dllink_sb(ni, &ts->s.b,
                                             &ts->epcache_fd_link));
   }
 #endif
   if( ! unlocked )
-    ci_sock_unlock(ni, &listener->s.b);
+    citp_tcp_acceptq_unlock(ni, listener, sh);
 
   newfd = citp_tcp_ep_acquire_fd(ni, ts, listener, ts->s.domain, SOCK_STREAM,
                                  flags);
   if( newfd < 0 ) {
     Log_E(ci_log(LPF "%s: citp_tcp_ep_acquire_fd failed: %d",
                  __FUNCTION__, newfd));
-    ci_sock_lock(ni, &listener->s.b);
+    citp_tcp_acceptq_lock(ni, listener, sh);
     ci_assert(ts->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+    if( sh != NULL ) {
+      ci_tcp_acceptq_shard_put_back(ni, listener, sh, &ts->s.b);
+    }
+    else
+#endif
 #if CI_CFG_FD_CACHING
     if( newfd == -ENOANO ) {
       Log_EP(ci_log("%s: [%d:%d]. puttint accepted socket back on acceptq",
@@ -823,7 +915,7 @@ redo:
 #endif
       ci_tcp_acceptq_put_back(ni, listener, &ts->s.b);
     CITP_STATS_TCP_LISTEN(++listener->stats.n_accept_no_fd);
-    ci_sock_unlock(ni, &listener->s.b);
+    citp_tcp_acceptq_unlock(ni, listener, sh);
     RET_WITH_ERRNO(-newfd);
   }
 
@@ -919,6 +1011,23 @@ check_ul_accept_q:
   }
 
   if( ci_tcp_acceptq_n(listener) ) {
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+    if( ci_tcp_acceptq_sharded(listener) ) {
+      struct ci_tcp_acceptq_shard* sh;
+      sh = citp_tcp_acceptq_shard_lock(ni, listener);
+      if( sh != NULL ) {
+        if( CI_UNLIKELY(p_sa_len == NULL && sa != NULL) ) {
+          ci_tcp_acceptq_shard_unlock(sh);
+          CI_SET_ERROR(rc, EFAULT);
+          return rc;
+        }
+        return citp_tcp_accept_ul(fdinfo, ni, listener, sh,
+                                  sa, p_sa_len, flags);
+      }
+    }
+    else
+#endif
+    {
       ci_sock_lock(ni, &listener->s.b);
       if( ci_tcp_acceptq_not_empty(listener) ) {
           /* delayed error report (after a connect came) */
@@ -927,9 +1036,11 @@ check_ul_accept_q:
               CI_SET_ERROR(rc, EFAULT);
               return rc;
           }
-          return citp_tcp_accept_ul(fdinfo, ni, listener, sa, p_sa_len, flags);
+          return citp_tcp_accept_ul(fdinfo, ni, listener, NULL,
+                                    sa, p_sa_len, flags);
       }
       ci_sock_unlock(ni, &listener->s.b);
+    }
   }
 
   /* User-level accept queue is empty.  Are we up-to-date? */
@@ -958,8 +1069,9 @@ check_ul_accept_q:
     }
   }
 
-  if( listener->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK |
-                                 CI_SB_AFLAG_O_NDELAY) ) {
+  if( (listener->s.b.sb_aflags & (CI_SB_AFLAG_O_NONBLOCK |
+                                  CI_SB_AFLAG_O_NDELAY)) ||
+      __oo_per_thread_get()->ring_nonblock ) {
     CITP_STATS_NETIF(++ni->state->stats.accept_eagain);
     errno = EAGAIN;
     rc = -1;
@@ -1068,6 +1180,184 @@ check_ul_accept_q:
   return rc;
 }
 
+/* Take up to [n] connections from the user-level accept queue of [fdinfo]
+ * without blocking, and create the fds for all of them with one system
+ * call.  Sockets from the cache or which have moved to another stack are
+ * left for citp_tcp_accept_ul().  Returns the number of connections
+ * accepted, 0 if there were none to accept this way, or -1 with errno set.
+ */
+static int citp_tcp_accept_ul_batch(citp_fdinfo* fdinfo, int* fds,
+                                    struct sockaddr_storage* addrs, int n,
+                                    int flags)
+{
+  citp_sock_fdi* epi = fdi_to_sock_fdi(fdinfo);
+  ci_netif* ni = epi->sock.netif;
+  ci_tcp_socket_listen* listener;
+  struct ci_tcp_acceptq_shard* sh = NULL;
+  ci_tcp_state* tss[OO_ACCEPT_BATCH_MAX];
+  oo_sp sps[OO_ACCEPT_BATCH_MAX];
+  int i, n_got = 0, n_fds, n_done = 0;
+
+  if( epi->sock.s->b.state != CI_TCP_LISTEN )
+    return 0;
+  listener = SOCK_TO_TCP_LISTEN(epi->sock.s);
+  if( ci_tcp_acceptq_n(listener) == 0 )
+    return 0;
+  n = CI_MIN(n, OO_ACCEPT_BATCH_MAX);
+
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+  if( ci_tcp_acceptq_sharded(listener) ) {
+    sh = citp_tcp_acceptq_shard_lock(ni, listener);
+    if( sh == NULL )
+      return 0;
+  }
+  else
+#endif
+    ci_sock_lock(ni, &listener->s.b);
+
+  while( n_got < n ) {
+    ci_tcp_state* ts;
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+    if( sh != NULL ) {
+      if( ! ci_tcp_acceptq_shard_not_empty(sh) )
+        break;
+      ts = ci_tcp_acceptq_shard_peek(ni, sh);
+    }
+    else
+#endif
+    {
+      if( ! ci_tcp_acceptq_not_empty(listener) )
+        break;
+      ts = ci_tcp_acceptq_peek(ni, listener);
+    }
+    if( ts->s.b.sb_aflags & CI_SB_AFLAG_MOVED_AWAY )
+      break;
+#if CI_CFG_FD_CACHING
+    if( ci_tcp_is_cached(ts) || S_TO_EPS(ni, ts)->fd != CI_FD_BAD )
+      break;
+#endif
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+    if( sh != NULL )
+      ci_tcp_acceptq_shard_get(ni, listener, sh);
+    else
+#endif
+      ci_tcp_acceptq_get(ni, listener);
+    ci_assert(ts->s.b.state & CI_TCP_STATE_TCP);
+    ci_assert(ts->s.b.state != CI_TCP_LISTEN);
+    tss[n_got] = ts;
+    sps[n_got] = S_SP(ts);
+    ++n_got;
+  }
+  citp_tcp_acceptq_unlock(ni, listener, sh);
+  if( n_got == 0 )
+    return 0;
+
+  /* As in citp_tcp_ep_acquire_fd(), the fdtable lock prevents a probe of
+   * the new fds until we've finished setting them up. */
+  if( fdtable_strict() )  CITP_FDTABLE_LOCK();
+  n_fds = ci_tcp_helper_tcp_accept_sock_attach_batch(
+                        ci_netif_get_driver_handle(ni), sps, fds, n_got, flags);
+  if( n_fds > 0 )
+    citp_fdtable_new_fds_busy(fds, n_fds, fdtable_strict());
+  if( fdtable_strict() )  CITP_FDTABLE_UNLOCK();
+
+  if( n_fds < n_got ) {
+    Log_E(ci_log(LPF "%s: attached %d of %d", __FUNCTION__, n_fds, n_got));
+    /* Put the rest back in their original order. */
+    citp_tcp_acceptq_lock(ni, listener, sh);
+    for( i = n_got - 1; i >= CI_MAX(n_fds, 0); --i ) {
+      ci_assert(tss[i]->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ);
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+      if( sh != NULL )
+        ci_tcp_acceptq_shard_put_back(ni, listener, sh, &tss[i]->s.b);
+      else
+#endif
+        ci_tcp_acceptq_put_back(ni, listener, &tss[i]->s.b);
+    }
+    CITP_STATS_TCP_LISTEN(++listener->stats.n_accept_no_fd);
+    citp_tcp_acceptq_unlock(ni, listener, sh);
+    if( n_fds <= 0 )
+      RET_WITH_ERRNO(-n_fds);
+  }
+
+  for( i = 0; i < n_fds; ++i ) {
+    ci_tcp_state* ts = tss[i];
+    citp_sock_fdi* newepi;
+    citp_fdinfo* newfdi;
+    socklen_t sa_len = sizeof(*addrs);
+
+    ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_ORPHAN));
+    ci_assert(!(ts->s.b.sb_aflags & CI_SB_AFLAG_TCP_IN_ACCEPTQ));
+
+    newepi = CI_ALLOC_OBJ(citp_sock_fdi);
+    if( newepi == 0 ) {
+      Log_E (ci_log(LPF "accept: newepi malloc failed"));
+      citp_fdtable_busy_clear(fds[i], fdip_unknown, 0);
+      ci_tcp_helper_close_no_trampoline(fds[i]);
+      S_TO_EPS(ni,ts)->fd = CI_FD_BAD;
+      continue;
+    }
+    newfdi = &newepi->fdinfo;
+    citp_fdinfo_init(newfdi, &citp_tcp_protocol_impl);
+#if CI_CFG_FD_CACHING
+    newfdi->can_cache = 1;
+#endif
+    newepi->sock.s = &ts->s;
+    newepi->sock.netif = ni;
+    citp_netif_add_ref(ni);
+
+    ci_assert(ts->s.b.sb_aflags & CI_SB_AFLAG_NOT_READY);
+    ci_atomic32_and(&ts->s.b.sb_aflags, ~CI_SB_AFLAG_NOT_READY);
+    citp_fdtable_insert(newfdi, fds[i], 0);
+    fds[n_done] = citp_tcp_accept_complete(ni,
+                                addrs ? (struct sockaddr*) &addrs[n_done] : NULL,
+                                &sa_len, listener, ts, fds[i]);
+    ++n_done;
+  }
+
+  if( n_done > 1 ) {
+    CITP_STATS_NETIF_INC(ni, accept_batches);
+    CITP_STATS_NETIF_ADD(ni, accept_batch_socks, n_done);
+  }
+  if( n_done == 0 )
+    RET_WITH_ERRNO(ENOMEM);
+  return n_done;
+}
+
+
+/* Accept up to [n] connections, as onload_accept_batch(). */
+int citp_tcp_accept_batch(citp_fdinfo* fdinfo, int* fds,
+                          struct sockaddr_storage* addrs, int n, int flags,
+                          citp_lib_context_t* lib_context)
+{
+  socklen_t sa_len = sizeof(*addrs);
+  int rc, saved_errno;
+
+  rc = citp_tcp_accept_ul_batch(fdinfo, fds, addrs, n, flags);
+  if( rc != 0 )
+    return rc;
+
+  /* Nothing to take from the accept queue.  Wait as accept4() would, which
+   * may also find a connection on the OS socket or in another stack.
+   */
+  rc = citp_tcp_accept(fdinfo, addrs ? (struct sockaddr*) addrs : NULL,
+                       addrs ? &sa_len : NULL, flags, lib_context);
+  if( rc < 0 )
+    return rc;
+  fds[0] = rc;
+  if( n == 1 )
+    return 1;
+  /* The first connection has been accepted, so a failure to find more is
+   * not an error. */
+  saved_errno = errno;
+  rc = citp_tcp_accept_ul_batch(fdinfo, fds + 1, addrs ? addrs + 1 : NULL,
+                                n - 1, flags);
+  if( rc < 0 )
+    errno = saved_errno;
+  return 1 + CI_MAX(rc, 0);
+}
+
+
 static int citp_tcp_connect(citp_fdinfo* fdinfo,
                             const struct sockaddr* sa, socklen_t sa_len,
                             citp_lib_context_t* lib_context)
@@ -1131,6 +1421,7 @@ static int citp_tcp_connect(citp_fdinfo* fdinfo,
     if( !(s->s_flags & CI_SOCK_FLAG_TPROXY) ||
          (s->s_flags & CI_SOCK_FLAG_CONNECT_MUST_BIND) ) {
       int fd = fdinfo->fd;
+
       rc = 0;
       ci_netif_lock_fdi(epi);
       if( ~epi->sock.s->b.sb_aflags & CI_SB_AFLAG_OS_BACKED ) {
@@ -1751,6 +2042,54 @@ static int citp_tcp_sendmmsg(citp_fdinfo* fdinfo, struct mmsghdr* msg,
   return -1;
 }
 
+#ifdef MSG_FASTOPEN
+/* sendmsg(MSG_FASTOPEN) on an unconnected socket: connect with the start
+ * of the data on the SYN.  A blocking call then sends the rest, once
+ * connected.  A non-blocking one returns the number of bytes on the SYN, or
+ * fails with EINPROGRESS if there were none.
+ */
+static int citp_tcp_send_fastopen(citp_sock_fdi* epi, int fd,
+                                  const struct msghdr* msg, int flags)
+{
+  ci_tcp_state* ts = SOCK_TO_TCP(epi->sock.s);
+  int rc, n, sent, i;
+
+  rc = ci_tcp_connect_fastopen(&epi->sock, msg->msg_name, msg->msg_namelen,
+                               fd, msg->msg_iov, msg->msg_iovlen, &n);
+  if( rc == CI_SOCKET_HANDOVER ) {
+    /* The data can't be sent unless the socket is accelerated. */
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  if( rc < 0 )
+    return (errno == EINPROGRESS && n > 0) ? n : rc;
+  if( flags & MSG_DONTWAIT )
+    return n;
+
+  /* Connected, so send whatever didn't fit on the SYN. */
+  sent = n;
+  for( i = 0; i < msg->msg_iovlen; ++i ) {
+    struct iovec iov = msg->msg_iov[i];
+    if( n >= iov.iov_len ) {
+      n -= iov.iov_len;
+      continue;
+    }
+    iov.iov_base = (char*) iov.iov_base + n;
+    iov.iov_len -= n;
+    n = 0;
+    rc = ci_tcp_sendmsg(epi->sock.netif, ts, &iov, 1,
+                        flags & ~MSG_FASTOPEN);
+    if( rc < 0 )
+      return sent > 0 ? sent : rc;
+    sent += rc;
+    if( rc < iov.iov_len )
+      break;
+  }
+  return sent;
+}
+#endif
+
+
 static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
                          int flags)
 {
@@ -1776,6 +2115,13 @@ static int citp_tcp_send(citp_fdinfo* fdinfo, const struct msghdr* msg,
     /* Process CI_TCP_CLOSED without entering ci_tcp_sendmsg() because TCP state
      * can be changed under our feet and we do not want to meet CI_TCP_LISTEN
      * state inside ci_tcp_sendmsg(). */
+#ifdef MSG_FASTOPEN
+    if( CI_UNLIKELY(state == CI_TCP_CLOSED && (flags & MSG_FASTOPEN) &&
+                    msg->msg_name != NULL) ) {
+      rc = citp_tcp_send_fastopen(epi, fdinfo->fd, msg, flags);
+    }
+    else
+#endif
     if( CI_UNLIKELY(state == CI_TCP_CLOSED || state == CI_TCP_LISTEN ||
                     state == CI_TCP_INVALID) ) {
       if( CI_UNLIKELY(flags & ONLOAD_MSG_WARM) )
@@ -242,6 +242,12 @@ struct oo_ul_epoll_state {
   /* Information associated with ordering. */
   struct citp_ordering_info* ordering_info;
 
+  /* If not NULL, the fd of each event stored in [events] is stored here,
+   * for onload_zc_recv_epoll().  Events reported by the kernel are left
+   * as the caller initialised them.
+   */
+  int* fds;
+
   /* Timestamp for the beginning of the current poll.  Used to avoid doing
    * ci_netif_poll() on stacks too frequently.
    */
@@ -276,11 +282,24 @@ static inline ci_int64 oo_epoll_ms_to_frc(int ms_timeout)
     return (ci_int64)ms_timeout * citp.cpu_khz;
 }
 
+/* As above, for the timespec timeout of epoll_pwait2().  The timeout is
+ * rounded up so that we never return early. */
+static inline ci_int64 oo_epoll_ts_to_frc(const struct timespec* ts)
+{
+  ci_uint64 khz = citp.cpu_khz;
+
+  if( ts == NULL || ts->tv_sec >= OO_EPOLL_MAX_TIMEOUT_HR / (khz * 1000) )
+    return OO_EPOLL_MAX_TIMEOUT_HR;
+  return CI_MIN((ci_uint64) ts->tv_sec * khz * 1000 +
+                ((ci_uint64) ts->tv_nsec * khz + 999999) / 1000000,
+                OO_EPOLL_MAX_TIMEOUT_HR);
+}
+
 
 extern int citp_epoll_create(int size, int flags) CI_HF;
 extern int citp_epoll_ctl(citp_fdinfo* fdi, int op, int fd,
                           struct epoll_event *event) CI_HF;
-extern int citp_epoll_wait(citp_fdinfo*, struct epoll_event*,
+extern int citp_epoll_wait(citp_fdinfo*, struct epoll_event*, int* fds,
                            struct citp_ordered_wait* ordering, int maxev,
                            ci_int64 timeout_hr, const sigset_t *sigmask,
                            citp_lib_context_t*) CI_HF;
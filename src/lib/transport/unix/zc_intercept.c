@@ -12,6 +12,7 @@
 \**************************************************************************/
 
 #include "internal.h"
+#include "ul_epoll.h"
 #include <ci/efhw/common.h>
 #include <onload/ul/tcp_helper.h>
 
@@ -50,6 +51,7 @@ static int fd_to_stack(int fd, ci_netif** pni, citp_fdinfo** pfdi)
   case CITP_PIPE_FD:
     rc = -ENOTSOCK;
     break;
+  case CITP_UNIX_FD:
   case CITP_PASSTHROUGH_FD:
     rc = -ESOCKTNOSUPPORT;
     break;
@@ -339,6 +341,182 @@ int onload_zc_recv(int fd, struct onload_zc_recv_args* args)
 
 
 
+/* Limit on the ready fds taken from the set by one call to
+ * onload_zc_recv_epoll(), so that the scratch space can go on the stack.
+ */
+#define ZC_EPOLL_MAX_EVENTS  256
+
+struct zc_epoll_state {
+  struct onload_zc_recv_args args;
+  /* Next message to fill, and the end of the caller's array */
+  struct onload_zc_mmsg* msg;
+  struct onload_zc_mmsg* msg_end;
+  int fd;
+  /* Where the receive path puts the address and control messages, before
+   * they are copied to the caller's message */
+  struct sockaddr_storage name;
+  char control[512];
+};
+
+
+/* Copy the control messages which fit in [out], whole. */
+static void zc_epoll_copy_control(struct msghdr* out, struct msghdr* in)
+{
+  struct cmsghdr* cmsg;
+  size_t len = 0;
+
+  for( cmsg = CMSG_FIRSTHDR(in); cmsg != NULL; cmsg = CMSG_NXTHDR(in, cmsg) ) {
+    if( len + CMSG_ALIGN(cmsg->cmsg_len) > out->msg_controllen ) {
+      out->msg_flags |= MSG_CTRUNC;
+      break;
+    }
+    memcpy((char*) out->msg_control + len, cmsg, cmsg->cmsg_len);
+    len += CMSG_ALIGN(cmsg->cmsg_len);
+  }
+  out->msg_controllen = len;
+}
+
+
+static enum onload_zc_callback_rc
+zc_epoll_recv_cb(struct onload_zc_recv_args* args, int flags)
+{
+  struct zc_epoll_state* st = args->user_ptr;
+  struct onload_zc_mmsg* m = st->msg++;
+  struct msghdr* in = &args->msg.msghdr;
+  struct msghdr* out = &m->msg.msghdr;
+  size_t i, n = CI_MIN(in->msg_iovlen, out->msg_iovlen);
+
+  m->fd = st->fd;
+  m->rc = 0;
+  for( i = 0; i < n; ++i ) {
+    m->msg.iov[i] = args->msg.iov[i];
+    m->rc += args->msg.iov[i].iov_len;
+  }
+  out->msg_iovlen = n;
+  out->msg_flags = in->msg_flags;
+  /* The remaining buffers are chained from the first, so are freed with
+   * it. */
+  if( n < in->msg_iovlen )
+    out->msg_flags |= MSG_TRUNC;
+
+  if( out->msg_name != NULL ) {
+    if( in->msg_name != NULL ) {
+      memcpy(out->msg_name, in->msg_name,
+             CI_MIN(out->msg_namelen, in->msg_namelen));
+      out->msg_namelen = in->msg_namelen;
+    }
+    else {
+      out->msg_namelen = 0;
+    }
+  }
+  if( out->msg_control != NULL )
+    zc_epoll_copy_control(out, in);
+
+  if( st->msg == st->msg_end )
+    return ONLOAD_ZC_KEEP | ONLOAD_ZC_TERMINATE;
+  return ONLOAD_ZC_KEEP;
+}
+
+
+int onload_zc_recv_epoll(int epfd, struct onload_zc_mmsg* msgs, int mlen,
+                         struct epoll_event* events, int* n_events,
+                         int timeout, int flags)
+{
+  struct epoll_event ready[ZC_EPOLL_MAX_EVENTS];
+  int ready_fd[ZC_EPOLL_MAX_EVENTS];
+  struct zc_epoll_state st;
+  struct onload_zc_mmsg* first;
+  citp_lib_context_t lib_context;
+  citp_fdinfo* fdi;
+  int i, rc, n_ready, n_ev = 0, maxevents;
+  unsigned ev;
+
+  Log_CALL(ci_log("%s(%d, %p, %d, %p, %d, %d, %x)", __FUNCTION__, epfd, msgs,
+                  mlen, events, *n_events, timeout, flags));
+
+  if( (flags & ~ONLOAD_MSG_RECV_OS_INLINE) || mlen <= 0 || *n_events <= 0 )
+    return -EINVAL;
+
+  maxevents = CI_MIN(CI_MIN(mlen, *n_events), ZC_EPOLL_MAX_EVENTS);
+  for( i = 0; i < maxevents; ++i )
+    ready_fd[i] = -1;
+
+  citp_enter_lib(&lib_context);
+
+  /* Only when Onload handles the set do we find out which fds the events
+   * are for. */
+  fdi = citp_fdtable_lookup(epfd);
+  if( fdi != NULL && fdi->protocol->type == CITP_EPOLL_FD ) {
+    /* NB. citp_epoll_wait() calls citp_exit_lib(). */
+    n_ready = citp_epoll_wait(fdi, ready, ready_fd, NULL, maxevents,
+                              oo_epoll_ms_to_frc(timeout), NULL,
+                              &lib_context);
+    if( n_ready < 0 )
+      n_ready = -errno;
+    citp_reenter_lib(&lib_context);
+    citp_fdinfo_release_ref(fdi, 0);
+  }
+  else {
+    if( fdi != NULL )
+      citp_fdinfo_release_ref(fdi, 0);
+    citp_exit_lib(&lib_context, FALSE);
+    n_ready = ci_sys_epoll_wait(epfd, ready, maxevents, timeout);
+    if( n_ready < 0 )
+      n_ready = -errno;
+    citp_reenter_lib(&lib_context);
+  }
+  if( n_ready < 0 ) {
+    rc = n_ready;
+    goto out;
+  }
+
+  st.msg = msgs;
+  st.msg_end = msgs + mlen;
+  st.args.cb = zc_epoll_recv_cb;
+  st.args.user_ptr = &st;
+  st.args.flags = flags | ONLOAD_MSG_DONTWAIT;
+
+  for( i = 0; i < n_ready; ++i ) {
+    ev = ready[i].events;
+    first = st.msg;
+
+    if( ready_fd[i] >= 0 && (ev & EPOLLIN) && ! (ev & EPOLLERR) &&
+        st.msg < st.msg_end &&
+        (fdi = citp_fdtable_lookup(ready_fd[i])) != NULL ) {
+      st.fd = ready_fd[i];
+      st.args.msg.msghdr.msg_name = &st.name;
+      st.args.msg.msghdr.msg_namelen = sizeof(st.name);
+      st.args.msg.msghdr.msg_control = st.control;
+      st.args.msg.msghdr.msg_controllen = sizeof(st.control);
+      rc = citp_fdinfo_get_ops(fdi)->zc_recv(fdi, &st.args);
+      citp_fdinfo_release_ref(fdi, 0);
+
+      /* Leave EPOLLIN set if there may be more to read, or if there is
+       * something (end of file, kernel traffic, an error) that the caller
+       * must read in the ordinary way. */
+      if( rc == -EAGAIN ||
+          (rc == 0 && st.msg > first && st.msg < st.msg_end) )
+        ev &= ~EPOLLIN;
+    }
+
+    if( ev != 0 ) {
+      events[n_ev].events = ev;
+      events[n_ev].data = ready[i].data;
+      ++n_ev;
+    }
+  }
+
+  rc = st.msg - msgs;
+  *n_events = n_ev;
+
+ out:
+  citp_exit_lib(&lib_context, TRUE);
+  Log_CALL_RESULT(rc);
+  return rc;
+}
+
+
+
 int onload_zc_send(struct onload_zc_mmsg* msgs, int mlen, int flags)
 {
   int done = 0, last_fd = -1, i;
@@ -442,19 +620,6 @@ static int verify_addrspace_override(ci_netif* ni)
 }
 
 
-static bool have_unsupported_nic(ci_netif* ni)
-{
-  int nic_i;
-
-  OO_STACK_FOR_EACH_INTF_I(ni, nic_i)
-    if( ci_netif_vi(ni, nic_i)->nic_type.arch == EF_VI_ARCH_AF_XDP ||
-        ci_netif_vi(ni, nic_i)->nic_type.nic_flags & EFHW_VI_NIC_CTPIO_ONLY )
-      return true;
-
-  return false;
-}
-
-
 int onload_zc_register_buffers(int fd, ef_addrspace addr_space,
                                uint64_t base_ptr, uint64_t len, int flags,
                                onload_zc_handle* handle)
@@ -489,7 +654,7 @@ int onload_zc_register_buffers(int fd, ef_addrspace addr_space,
              (rc = verify_addrspace_override(ni)) < 0 ) {
       /* error code already set appropriately */
     }
-    else if( have_unsupported_nic(ni) ) {
+    else if( ci_netif_zc_usermem_unsupported(ni) ) {
       /* Because these NICs don't support checksum offload, the code necessary
        * to compute checksums on the host is gnarly and thus non-existant. */
       rc = -ENOTSUP;
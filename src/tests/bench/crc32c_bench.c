@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Microbenchmark for the CRC32C implementations.
+ *
+ * Times the table-driven version and each hardware version supported by
+ * this CPU over a range of buffer sizes, and prints the cost of one call
+ * in nanoseconds and the throughput.
+ *
+ * Usage: crc32c_bench [iterations]
+ */
+
+#include <ci/tools.h>
+#include <ci/tools/crc32c.h>
+#include <ci/tools/cpu_features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef ci_uint32 (*crc_fn)(const ci_uint8*, ci_uint32, ci_uint32);
+
+static const struct {
+  const char* name;
+  const char* feature;
+  crc_fn fn;
+} impls[] = {
+  { "table",  NULL,     ci_crc32c_partial_table },
+#if CI_CRC32C_HW
+  { "sse4.2", "sse4.2", ci_crc32c_partial_sse42 },
+  { "pclmul", "pclmul", ci_crc32c_partial_pclmul },
+#endif
+};
+#define N_IMPLS  (sizeof(impls) / sizeof(impls[0]))
+
+static const int sizes[] = { 64, 256, 512, 1024, 1460, 4096, 9000, 65536 };
+#define N_SIZES  (sizeof(sizes) / sizeof(sizes[0]))
+
+static ci_uint8 buf[65536];
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static double run(crc_fn fn, int size, long iters)
+{
+  volatile ci_uint32 sink;
+  ci_uint32 crc = 0xffffffff;
+  double start;
+  long i;
+
+  for( i = 0; i < iters / 10; ++i )
+    crc = fn(buf, size, crc);
+  start = now_ns();
+  for( i = 0; i < iters; ++i )
+    crc = fn(buf, size, crc);
+  sink = crc;
+  (void) sink;
+  return (now_ns() - start) / iters;
+}
+
+
+int main(int argc, char* argv[])
+{
+  long iters = 100000;
+  unsigned i, s;
+
+  if( argc > 1 )
+    iters = atol(argv[1]);
+  if( iters <= 0 ) {
+    fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  for( i = 0; i < sizeof(buf); ++i )
+    buf[i] = rand();
+
+  printf("%-8s", "bytes");
+  for( i = 0; i < N_IMPLS; ++i )
+    printf("  %17s", impls[i].name);
+  printf("\n");
+
+  for( s = 0; s < N_SIZES; ++s ) {
+    printf("%-8d", sizes[s]);
+    for( i = 0; i < N_IMPLS; ++i ) {
+      double ns;
+      if( impls[i].feature != NULL &&
+          (! ci_cpu_has_feature("sse4.2") ||
+           ! ci_cpu_has_feature((char*) impls[i].feature)) ) {
+        printf("  %17s", "n/a");
+        continue;
+      }
+      /* The table version is slow: don't spend all day on it. */
+      ns = run(impls[i].fn, sizes[s], i == 0 ? iters / 10 + 1 : iters);
+      printf("  %7.1fns %5.1fG/s", ns, sizes[s] / ns);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Microbenchmark for the checksum-and-copy kernels.
+ *
+ * Times the scalar ci_ip_csum_copy_aligned_c() and each vector kernel
+ * supported by this CPU over a range of buffer sizes, and prints the cost
+ * of one call in nanoseconds and the throughput.
+ *
+ * Usage: csum_copy_bench [iterations]
+ */
+
+#include <ci/tools.h>
+#include <ci/tools/cpu_features.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef unsigned (*csum_copy_fn)(void*, const void*, int, unsigned);
+
+static unsigned csum_copy_c(void* dest, const void* src, int n, unsigned sum)
+{
+  return ci_ip_csum_copy_aligned_c(dest, src, n, sum);
+}
+
+static const struct {
+  const char* name;
+  const char* feature;
+  csum_copy_fn fn;
+} kernels[] = {
+  { "c",      NULL,      csum_copy_c },
+#if CI_IP_CSUM_SIMD
+  { "sse2",   "sse2",    ci_ip_csum_copy_sse2 },
+  { "avx2",   "avx2",    ci_ip_csum_copy_avx2 },
+  { "avx512", "avx512f", ci_ip_csum_copy_avx512 },
+#endif
+};
+#define N_KERNELS  (sizeof(kernels) / sizeof(kernels[0]))
+
+static const int sizes[] = { 64, 128, 256, 512, 1024, 1472, 4096, 9000 };
+#define N_SIZES  (sizeof(sizes) / sizeof(sizes[0]))
+
+static char src_buf[9000];
+static char dst_buf[9000];
+
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static double run(csum_copy_fn fn, int size, long iters)
+{
+  volatile unsigned sink = 0;
+  unsigned sum = 0;
+  double start;
+  long i;
+
+  for( i = 0; i < iters / 10; ++i )
+    sum = fn(dst_buf, src_buf, size, sum);
+  start = now_ns();
+  for( i = 0; i < iters; ++i )
+    sum = fn(dst_buf, src_buf, size, sum);
+  sink = sum;
+  (void) sink;
+  return (now_ns() - start) / iters;
+}
+
+
+int main(int argc, char* argv[])
+{
+  long iters = 1000000;
+  unsigned k, s;
+
+  if( argc > 1 )
+    iters = atol(argv[1]);
+  if( iters <= 0 ) {
+    fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  for( s = 0; s < sizeof(src_buf); ++s )
+    src_buf[s] = rand();
+
+  printf("%-8s", "bytes");
+  for( k = 0; k < N_KERNELS; ++k )
+    printf("  %16s", kernels[k].name);
+  printf("\n");
+
+  for( s = 0; s < N_SIZES; ++s ) {
+    printf("%-8d", sizes[s]);
+    for( k = 0; k < N_KERNELS; ++k ) {
+      double ns;
+      if( kernels[k].feature != NULL &&
+          ! ci_cpu_has_feature((char*) kernels[k].feature) ) {
+        printf("  %16s", "n/a");
+        continue;
+      }
+      ns = run(kernels[k].fn, sizes[s], iters);
+      printf("  %6.1fns %5.1fG/s", ns, sizes[s] / ns);
+    }
+    printf("\n");
+  }
+  return 0;
+}
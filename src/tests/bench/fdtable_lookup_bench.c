@@ -0,0 +1,173 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Multithreaded fd lookup benchmark.
+ *
+ * Each reader thread makes non-blocking recv() calls on its own set of
+ * UDP sockets.  The sockets are created in turn for each thread, so
+ * neighbouring fds belong to different threads and share fdtable cache
+ * lines.  With no data queued each call is little more than the fd lookup
+ * and a check of the receive queue.  Meanwhile churn threads create and
+ * close sockets, which frees fdinfo structures under the readers.
+ *
+ * Prints the call rate and mean cost of each reader.  Run under Onload
+ * with EF_FDS_MT_SAFE=0 to measure the lookups that take a reference.
+ *
+ * Usage: fdtable_lookup_bench [-t readers] [-c churners] [-n socks]
+ *                             [-s seconds]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+
+static int cfg_readers = 4;
+static int cfg_churners = 1;
+static int cfg_socks = 16;
+static int cfg_seconds = 5;
+
+static volatile int running = 1;
+
+struct reader {
+  pthread_t          thread;
+  int*               socks;
+  unsigned long long n_calls;
+};
+
+struct churner {
+  pthread_t          thread;
+  unsigned long long n_closed;
+};
+
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d errno=%d (%s)\n",        \
+              #x, __rc, errno, strerror(errno));                        \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+
+static double now_s(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void* reader_fn(void* arg)
+{
+  struct reader* r = arg;
+  char buf[64];
+  int i;
+
+  while( running )
+    for( i = 0; i < cfg_socks; ++i ) {
+      if( recv(r->socks[i], buf, sizeof(buf), MSG_DONTWAIT) < 0 &&
+          errno != EAGAIN ) {
+        fprintf(stderr, "ERROR: recv failed: %s\n", strerror(errno));
+        exit(1);
+      }
+      ++r->n_calls;
+    }
+  return NULL;
+}
+
+
+static void* churner_fn(void* arg)
+{
+  struct churner* c = arg;
+  int sock;
+
+  while( running ) {
+    TRY(sock = socket(AF_INET, SOCK_DGRAM, 0));
+    /* Look it up once so that the fdinfo is created before it's closed. */
+    recv(sock, NULL, 0, MSG_DONTWAIT);
+    close(sock);
+    ++c->n_closed;
+  }
+  return NULL;
+}
+
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "usage: %s [-t readers] [-c churners] [-n socks] "
+          "[-s seconds]\n", prog);
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  struct reader* readers;
+  struct churner* churners;
+  unsigned long long total = 0, total_closed = 0;
+  double start, elapsed;
+  int i, j, c;
+
+  while( (c = getopt(argc, argv, "t:c:n:s:")) != -1 )
+    switch( c ) {
+    case 't':  cfg_readers = atoi(optarg);  break;
+    case 'c':  cfg_churners = atoi(optarg);  break;
+    case 'n':  cfg_socks = atoi(optarg);  break;
+    case 's':  cfg_seconds = atoi(optarg);  break;
+    default:   usage(argv[0]);
+    }
+  if( optind != argc || cfg_readers <= 0 || cfg_churners < 0 ||
+      cfg_socks <= 0 || cfg_seconds <= 0 )
+    usage(argv[0]);
+
+  readers = calloc(cfg_readers, sizeof(*readers));
+  churners = calloc(cfg_churners ? cfg_churners : 1, sizeof(*churners));
+  for( i = 0; i < cfg_readers; ++i )
+    readers[i].socks = calloc(cfg_socks, sizeof(int));
+  for( j = 0; j < cfg_socks; ++j )
+    for( i = 0; i < cfg_readers; ++i )
+      TRY(readers[i].socks[j] = socket(AF_INET, SOCK_DGRAM, 0));
+
+  start = now_s();
+  for( i = 0; i < cfg_readers; ++i )
+    TRY(pthread_create(&readers[i].thread, NULL, reader_fn, &readers[i]));
+  for( i = 0; i < cfg_churners; ++i )
+    TRY(pthread_create(&churners[i].thread, NULL, churner_fn, &churners[i]));
+  sleep(cfg_seconds);
+  running = 0;
+  for( i = 0; i < cfg_readers; ++i )
+    pthread_join(readers[i].thread, NULL);
+  for( i = 0; i < cfg_churners; ++i )
+    pthread_join(churners[i].thread, NULL);
+  elapsed = now_s() - start;
+
+  printf("readers: %d  churners: %d  socks/reader: %d\n",
+         cfg_readers, cfg_churners, cfg_socks);
+  for( i = 0; i < cfg_readers; ++i ) {
+    printf("reader %-3d %12.0f calls/s %8.1f ns/call\n", i,
+           readers[i].n_calls / elapsed,
+           elapsed * 1e9 / (readers[i].n_calls ? readers[i].n_calls : 1));
+    total += readers[i].n_calls;
+    for( j = 0; j < cfg_socks; ++j )
+      close(readers[i].socks[j]);
+    free(readers[i].socks);
+  }
+  for( i = 0; i < cfg_churners; ++i )
+    total_closed += churners[i].n_closed;
+  printf("total      %12.0f calls/s  closes=%.0f/s\n", total / elapsed,
+         total_closed / elapsed);
+  free(readers);
+  free(churners);
+  return 0;
+}
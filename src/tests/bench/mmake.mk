@@ -0,0 +1,18 @@
+# SPDX-License-Identifier: GPL-2.0
+# X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc.
+APPS := csum_copy_bench crc32c_bench udp_send_mt_bench fdtable_lookup_bench
+TARGETS := $(APPS:%=$(AppPattern))
+
+MMAKE_LIBS := $(LINK_CITOOLS_LIB)
+MMAKE_LIB_DEPS := $(CITOOLS_LIB_DEPEND)
+
+udp_send_mt_bench: MMAKE_LIBS += -lpthread
+fdtable_lookup_bench: MMAKE_LIBS += -lpthread
+
+all: $(TARGETS)
+
+$(TARGETS): %: %.o $(MMAKE_LIB_DEPS)
+	(libs="$(MMAKE_LIBS)"; $(MMakeLinkCApp))
+
+clean:
+	@$(MakeClean)
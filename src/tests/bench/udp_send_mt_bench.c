@@ -0,0 +1,201 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Multithreaded UDP send benchmark.
+ *
+ * Each thread sends datagrams as fast as it can on its own connected UDP
+ * socket, so that under Onload all of the sockets share one stack and the
+ * threads contend for its lock.  Prints the send rate of each thread and
+ * the total.  Compare runs with and without EF_UDP_SEND_RING=1, and look
+ * at the udp_send_ring_* counters in "onload_stackdump more_stats".
+ *
+ * By default the datagrams go to a socket bound on 127.0.0.1, which is
+ * drained by another thread.  Use -d to send to another host, or to an
+ * address reached through an interface with EF_NO_HW=1.
+ *
+ * Usage: udp_send_mt_bench [-t threads] [-s seconds] [-l bytes]
+ *                          [-d host:port]
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+static int cfg_threads = 4;
+static int cfg_seconds = 5;
+static int cfg_size = 64;
+static const char* cfg_dest = NULL;
+
+static struct sockaddr_in dest;
+static volatile int running = 1;
+
+struct sender {
+  pthread_t          thread;
+  int                sock;
+  unsigned long long n_sent;
+  unsigned long long n_eagain;
+};
+
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d errno=%d (%s)\n",        \
+              #x, __rc, errno, strerror(errno));                        \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+
+static double now_s(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void* sender_fn(void* arg)
+{
+  struct sender* s = arg;
+  char* buf = calloc(1, cfg_size);
+
+  while( running ) {
+    if( send(s->sock, buf, cfg_size, 0) == cfg_size )
+      ++s->n_sent;
+    else if( errno == EAGAIN || errno == ENOBUFS )
+      ++s->n_eagain;
+    else if( errno != ECONNREFUSED ) {
+      fprintf(stderr, "ERROR: send failed: %s\n", strerror(errno));
+      exit(1);
+    }
+  }
+  free(buf);
+  return NULL;
+}
+
+
+static void* sink_fn(void* arg)
+{
+  int sock = *(int*) arg;
+  char buf[65536];
+
+  while( running )
+    recv(sock, buf, sizeof(buf), 0);
+  return NULL;
+}
+
+
+static void parse_dest(const char* s)
+{
+  char host[256];
+  const char* colon = strrchr(s, ':');
+  struct addrinfo hints, *ai;
+
+  if( colon == NULL || colon - s >= (int) sizeof(host) ) {
+    fprintf(stderr, "ERROR: expected host:port, got '%s'\n", s);
+    exit(1);
+  }
+  memcpy(host, s, colon - s);
+  host[colon - s] = '\0';
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if( getaddrinfo(host, colon + 1, &hints, &ai) != 0 ) {
+    fprintf(stderr, "ERROR: could not resolve '%s'\n", s);
+    exit(1);
+  }
+  memcpy(&dest, ai->ai_addr, sizeof(dest));
+  freeaddrinfo(ai);
+}
+
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "usage: %s [-t threads] [-s seconds] [-l bytes] "
+          "[-d host:port]\n", prog);
+  exit(1);
+}
+
+
+int main(int argc, char* argv[])
+{
+  struct sender* senders;
+  unsigned long long total = 0, total_eagain = 0;
+  int sink = -1, i, c;
+  pthread_t sink_thread;
+  struct timeval tv = { 0, 100000 };
+  double start, elapsed;
+
+  while( (c = getopt(argc, argv, "t:s:l:d:")) != -1 )
+    switch( c ) {
+    case 't':  cfg_threads = atoi(optarg);  break;
+    case 's':  cfg_seconds = atoi(optarg);  break;
+    case 'l':  cfg_size = atoi(optarg);  break;
+    case 'd':  cfg_dest = optarg;  break;
+    default:   usage(argv[0]);
+    }
+  if( optind != argc || cfg_threads <= 0 || cfg_seconds <= 0 ||
+      cfg_size <= 0 || cfg_size > 65507 )
+    usage(argv[0]);
+
+  if( cfg_dest != NULL ) {
+    parse_dest(cfg_dest);
+  }
+  else {
+    socklen_t len = sizeof(dest);
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TRY(sink = socket(AF_INET, SOCK_DGRAM, 0));
+    TRY(bind(sink, (struct sockaddr*) &dest, sizeof(dest)));
+    TRY(getsockname(sink, (struct sockaddr*) &dest, &len));
+    TRY(setsockopt(sink, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)));
+    TRY(pthread_create(&sink_thread, NULL, sink_fn, &sink));
+  }
+
+  senders = calloc(cfg_threads, sizeof(*senders));
+  for( i = 0; i < cfg_threads; ++i ) {
+    TRY(senders[i].sock = socket(AF_INET, SOCK_DGRAM, 0));
+    TRY(connect(senders[i].sock, (struct sockaddr*) &dest, sizeof(dest)));
+  }
+
+  start = now_s();
+  for( i = 0; i < cfg_threads; ++i )
+    TRY(pthread_create(&senders[i].thread, NULL, sender_fn, &senders[i]));
+  sleep(cfg_seconds);
+  running = 0;
+  for( i = 0; i < cfg_threads; ++i )
+    pthread_join(senders[i].thread, NULL);
+  elapsed = now_s() - start;
+  if( sink >= 0 )
+    pthread_join(sink_thread, NULL);
+
+  printf("threads: %d  bytes: %d  dest: %s:%d\n", cfg_threads, cfg_size,
+         inet_ntoa(dest.sin_addr), ntohs(dest.sin_port));
+  for( i = 0; i < cfg_threads; ++i ) {
+    printf("thread %-3d %10.0f msg/s  eagain=%llu\n", i,
+           senders[i].n_sent / elapsed, senders[i].n_eagain);
+    total += senders[i].n_sent;
+    total_eagain += senders[i].n_eagain;
+    close(senders[i].sock);
+  }
+  printf("total      %10.0f msg/s  eagain=%llu\n", total / elapsed,
+         total_eagain);
+  if( sink >= 0 )
+    close(sink);
+  free(senders);
+  return 0;
+}
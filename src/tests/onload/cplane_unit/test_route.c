@@ -502,6 +502,384 @@ static void test_cross_namespace_routing(void)
 #endif
 
 
+/* The route prefix trie is checked against a linear scan of a plain array
+ * of routes, which picks the route in the same way as the linear scan of
+ * the sorted route table in route.c: longest prefix first, then the lowest
+ * metric and scope, then the specific TOS before TOS=0. */
+
+#define LPM_TEST_MAX_ROUTES 256
+
+struct lpm_test_route {
+  ci_addr_sh_t addr;
+  cicp_prefixlen_t prefix;
+  struct cp_route_lpm_key key;
+  bool present;
+};
+
+struct lpm_test_table {
+  int af;
+  struct cp_route_lpm lpm;
+  int n_routes;
+  struct lpm_test_route routes[LPM_TEST_MAX_ROUTES];
+};
+
+
+static ci_addr_sh_t lpm_test_addr(int af, const char* s)
+{
+  ci_ip6_addr_t ip6;
+
+  if( af == AF_INET )
+    return ASH(s);
+  CP_TEST(inet_pton(AF_INET6, s, &ip6) == 1);
+  return CI_ADDR_SH_FROM_IP6(&ip6);
+}
+
+
+static ci_addr_sh_t
+lpm_test_mask(int af, ci_addr_sh_t addr, cicp_prefixlen_t prefix)
+{
+  if( af == AF_INET6 )
+    cp_addr_apply_pfx(&addr, prefix);
+  else
+    addr.ip4 &= cp_prefixlen2bitmask(prefix);
+  return addr;
+}
+
+
+static void lpm_test_table_init(struct lpm_test_table* t, int af)
+{
+  t->af = af;
+  t->n_routes = 0;
+  cp_route_lpm_init(&t->lpm, af);
+}
+
+
+/* Add a route to both the array and the trie.  Returns its index. */
+static int
+lpm_test_add(struct lpm_test_table* t, ci_addr_sh_t addr,
+             cicp_prefixlen_t prefix, uint32_t metric, uint8_t scope,
+             cicp_ip_tos_t tos)
+{
+  struct lpm_test_route* r = &t->routes[t->n_routes];
+
+  CP_TEST(t->n_routes < LPM_TEST_MAX_ROUTES);
+  r->addr = lpm_test_mask(t->af, addr, prefix);
+  r->prefix = prefix;
+  r->key.metric = metric;
+  r->key.scope = scope;
+  r->key.tos = tos;
+  r->key.refs = 0;
+  r->present = true;
+  CP_TEST(cp_route_lpm_insert(&t->lpm, r->addr, r->prefix, &r->key));
+  return t->n_routes++;
+}
+
+
+static void lpm_test_del(struct lpm_test_table* t, int i)
+{
+  struct lpm_test_route* r = &t->routes[i];
+
+  ci_assert(r->present);
+  cp_route_lpm_remove(&t->lpm, r->addr, r->prefix, &r->key);
+  r->present = false;
+}
+
+
+static void lpm_test_readd(struct lpm_test_table* t, int i)
+{
+  struct lpm_test_route* r = &t->routes[i];
+
+  ci_assert(! r->present);
+  CP_TEST(cp_route_lpm_insert(&t->lpm, r->addr, r->prefix, &r->key));
+  r->present = true;
+}
+
+
+/* Re-create the trie from the routes which are present, as the control
+ * plane does when a route dump finalizes. */
+static void lpm_test_rebuild(struct lpm_test_table* t)
+{
+  int i;
+
+  cp_route_lpm_clear(&t->lpm);
+  for( i = 0; i < t->n_routes; i++ )
+    if( t->routes[i].present )
+      CP_TEST(cp_route_lpm_insert(&t->lpm, t->routes[i].addr,
+                                  t->routes[i].prefix, &t->routes[i].key));
+}
+
+
+static bool
+lpm_test_better(const struct lpm_test_route* a,
+                const struct lpm_test_route* b)
+{
+  if( a->prefix != b->prefix )
+    return a->prefix > b->prefix;
+  if( a->key.metric != b->key.metric )
+    return a->key.metric < b->key.metric;
+  if( a->key.scope != b->key.scope )
+    return a->key.scope < b->key.scope;
+  return a->key.tos > b->key.tos;
+}
+
+
+static const struct lpm_test_route*
+lpm_test_linear(const struct lpm_test_table* t, ci_addr_sh_t dst,
+                cicp_ip_tos_t tos)
+{
+  const struct lpm_test_route* best = NULL;
+  int i;
+
+  for( i = 0; i < t->n_routes; i++ ) {
+    const struct lpm_test_route* r = &t->routes[i];
+    if( r->present &&
+        cp_ipx_ippl_pfx_match(t->af, dst, r->addr, r->prefix) &&
+        (r->key.tos == 0 || r->key.tos == tos) &&
+        (best == NULL || lpm_test_better(r, best)) )
+      best = r;
+  }
+  return best;
+}
+
+
+/* Returns true if the trie and the linear scan agree on the route for
+ * this destination. */
+static bool
+lpm_test_lookup_ok(const struct lpm_test_table* t, ci_addr_sh_t dst,
+                   cicp_ip_tos_t tos)
+{
+  const struct lpm_test_route* r = lpm_test_linear(t, dst, tos);
+  const struct cp_route_lpm_node* node;
+  struct cp_route_lpm_key key;
+
+  node = cp_route_lpm_find(&t->lpm, dst, tos, &key);
+  if( r == NULL || node == NULL )
+    return r == NULL && node == NULL;
+  return node->prefix == r->prefix &&
+         cp_ipx_ippl_pfx_match(t->af, node->addr, r->addr, r->prefix) &&
+         key.metric == r->key.metric && key.scope == r->key.scope &&
+         key.tos == r->key.tos;
+}
+
+
+/* Check that the trie matches the linear scan for the addresses of all the
+ * routes, for the addresses next to them and for some random ones, with
+ * TOS 0 and with the TOS of the route. */
+static int lpm_test_check(const struct lpm_test_table* t)
+{
+  int max_prefix = CI_IPX_MAX_PREFIX_LEN(t->af);
+  int bad = 0;
+  int i;
+
+  for( i = 0; i < t->n_routes; i++ ) {
+    const struct lpm_test_route* r = &t->routes[i];
+    ci_addr_sh_t dst = r->addr;
+    uint8_t* bytes = t->af == AF_INET6 ? dst.ip6 : (uint8_t*) &dst.ip4;
+    int bit;
+
+    bad += ! lpm_test_lookup_ok(t, dst, 0);
+    bad += ! lpm_test_lookup_ok(t, dst, r->key.tos);
+
+    /* Just outside the prefix, and somewhere inside it. */
+    if( r->prefix > 0 ) {
+      bit = r->prefix - 1;
+      bytes[bit >> 3] ^= 0x80 >> (bit & 7);
+      bad += ! lpm_test_lookup_ok(t, dst, r->key.tos);
+      bytes[bit >> 3] ^= 0x80 >> (bit & 7);
+    }
+    if( r->prefix < max_prefix ) {
+      bit = r->prefix + rand() % (max_prefix - r->prefix);
+      bytes[bit >> 3] ^= 0x80 >> (bit & 7);
+      bad += ! lpm_test_lookup_ok(t, dst, r->key.tos);
+    }
+  }
+
+  for( i = 0; i < 64; i++ ) {
+    ci_addr_sh_t dst = t->routes[rand() % t->n_routes].addr;
+    uint8_t* bytes = t->af == AF_INET6 ? dst.ip6 : (uint8_t*) &dst.ip4;
+    bytes[rand() % (max_prefix / 8)] ^= rand();
+    bad += ! lpm_test_lookup_ok(t, dst, rand() & 0x18);
+  }
+
+  return bad;
+}
+
+
+static void test_lpm_overlapping(int af)
+{
+  const char* afs = af == AF_INET6 ? "IPv6" : "IPv4";
+  bool v6 = af == AF_INET6;
+  struct lpm_test_table t;
+  int slash0, slash8, slash24, host;
+
+  lpm_test_table_init(&t, af);
+  ok(cp_route_lpm_find(&t.lpm, lpm_test_addr(af, v6 ? "::1" : "1.1.1.1"),
+                       0, &(struct cp_route_lpm_key){}) == NULL,
+     "%s: empty trie finds nothing", afs);
+
+  /* Nested prefixes, all of them with the same address, and siblings
+   * which need a glue node to branch. */
+  slash8 = lpm_test_add(&t, lpm_test_addr(af, v6 ? "10::" : "10.0.0.0"),
+                        8, 0, 0, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1::" : "10.1.0.0"),
+               16, 0, 0, 0);
+  slash24 = lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1:2::" : "10.1.2.0"),
+                         v6 ? 48 : 24, 0, 0, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1:3::" : "10.1.3.0"),
+               v6 ? 48 : 24, 0, 0, 0);
+  host = lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1:2::3" : "10.1.2.3"),
+                      CI_IPX_MAX_PREFIX_LEN(af), 0, 0, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1:2::2" : "10.1.2.2"),
+               CI_IPX_MAX_PREFIX_LEN(af), 0, 0, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "11::" : "11.0.0.0"),
+               8, 0, 0, 0);
+  /* Same prefix with worse and better metric and scope, and a TOS
+   * route. */
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1::" : "10.1.0.0"),
+               16, 10, 0, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1::" : "10.1.0.0"),
+               16, 0, 253, 0);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1::" : "10.1.0.0"),
+               16, 0, 0, 0x10);
+  lpm_test_add(&t, lpm_test_addr(af, v6 ? "10:1:2::" : "10.1.2.0"),
+               v6 ? 48 : 24, 0, 0, 0x08);
+  cmp_ok(lpm_test_check(&t), "==", 0,
+         "%s: overlapping prefixes match the linear scan", afs);
+
+  /* Nothing matches outside of the routes until there is a default
+   * route. */
+  ok(lpm_test_lookup_ok(&t, lpm_test_addr(af, v6 ? "12::1" : "12.0.0.1"), 0),
+     "%s: no route without a default route", afs);
+  slash0 = lpm_test_add(&t, lpm_test_addr(af, v6 ? "::" : "0.0.0.0"),
+                        0, 100, 0, 0);
+  ok(lpm_test_lookup_ok(&t, lpm_test_addr(af, v6 ? "12::1" : "12.0.0.1"), 0),
+     "%s: default route", afs);
+  cmp_ok(lpm_test_check(&t), "==", 0,
+         "%s: /0 route matches the linear scan", afs);
+
+  /* Take out the routes in the middle of the chain and check that the
+   * longer and shorter ones are still found. */
+  lpm_test_del(&t, slash24);
+  lpm_test_del(&t, slash8);
+  cmp_ok(lpm_test_check(&t), "==", 0,
+         "%s: matches the linear scan after removal", afs);
+  lpm_test_del(&t, host);
+  lpm_test_del(&t, slash0);
+  cmp_ok(lpm_test_check(&t), "==", 0,
+         "%s: matches the linear scan after removal of /0 and /%d", afs,
+         CI_IPX_MAX_PREFIX_LEN(af));
+  lpm_test_readd(&t, slash0);
+  lpm_test_readd(&t, host);
+  lpm_test_readd(&t, slash8);
+  lpm_test_readd(&t, slash24);
+  cmp_ok(lpm_test_check(&t), "==", 0,
+         "%s: matches the linear scan after reinsertion", afs);
+
+  cp_route_lpm_clear(&t.lpm);
+}
+
+
+/* Multipath routes share the trie key, so the key stays until the last
+ * of them goes. */
+static void test_lpm_multipath(void)
+{
+  struct lpm_test_table t;
+  int leg1, leg2;
+
+  lpm_test_table_init(&t, AF_INET);
+  lpm_test_add(&t, ASH("0.0.0.0"), 0, 0, 0, 0);
+  leg1 = lpm_test_add(&t, ASH("1.2.0.0"), 16, 5, 0, 0);
+  leg2 = lpm_test_add(&t, ASH("1.2.0.0"), 16, 5, 0, 0);
+  cmp_ok(t.lpm.n_keys, "==", 2, "multipath legs share the key");
+
+  lpm_test_del(&t, leg1);
+  ok(lpm_test_lookup_ok(&t, ASH("1.2.3.4"), 0),
+     "multipath route found while one leg remains");
+  lpm_test_del(&t, leg2);
+  ok(lpm_test_lookup_ok(&t, ASH("1.2.3.4"), 0),
+     "default route found when the last leg goes");
+  cmp_ok(t.lpm.n_nodes, "==", 1, "no nodes left behind by the removal");
+
+  cp_route_lpm_clear(&t.lpm);
+}
+
+
+static void lpm_test_random_route(struct lpm_test_table* t)
+{
+  int max_prefix = CI_IPX_MAX_PREFIX_LEN(t->af);
+  ci_addr_sh_t addr = {};
+  cicp_prefixlen_t prefix;
+  int i;
+
+  /* Addresses from a small space so that the prefixes overlap a lot, and
+   * prefix lengths of all sizes, /0 and the host routes included. */
+  if( t->af == AF_INET6 ) {
+    for( i = 0; i < 16; i += 5 )
+      addr.ip6[i] = rand() & 0x83;
+  }
+  else {
+    addr = CI_ADDR_SH_FROM_IP4(rand32() & htonl(0xc3c3c3c3));
+  }
+  prefix = rand() % (max_prefix + 1);
+  if( rand() % 4 == 0 )
+    prefix = rand() & 1 ? 0 : max_prefix;
+  lpm_test_add(t, addr, prefix, rand() % 3, rand() % 2 ? 0 : 253,
+               rand() % 3 ? 0 : 0x10);
+}
+
+
+/* Random route tables, changed by removing and re-adding routes and
+ * rebuilt from scratch as after a new route dump. */
+static void test_lpm_random(int af)
+{
+  const char* afs = af == AF_INET6 ? "IPv6" : "IPv4";
+  struct lpm_test_table t;
+  int bad_add = 0, bad_del = 0, bad_readd = 0, bad_rebuild = 0;
+  int iter, i;
+
+  for( iter = 0; iter < 50; iter++ ) {
+    lpm_test_table_init(&t, af);
+    for( i = 0; i < LPM_TEST_MAX_ROUTES; i++ )
+      lpm_test_random_route(&t);
+    bad_add += lpm_test_check(&t);
+
+    for( i = 0; i < t.n_routes; i++ )
+      if( rand() % 2 )
+        lpm_test_del(&t, i);
+    bad_del += lpm_test_check(&t);
+
+    for( i = 0; i < t.n_routes; i++ )
+      if( ! t.routes[i].present && rand() % 2 )
+        lpm_test_readd(&t, i);
+    bad_readd += lpm_test_check(&t);
+
+    for( i = 0; i < t.n_routes; i++ ) {
+      if( t.routes[i].present && rand() % 4 == 0 )
+        lpm_test_del(&t, i);
+      else if( ! t.routes[i].present && rand() % 4 == 0 )
+        t.routes[i].present = true;
+    }
+    lpm_test_rebuild(&t);
+    bad_rebuild += lpm_test_check(&t);
+
+    for( i = 0; i < t.n_routes; i++ )
+      if( t.routes[i].present )
+        lpm_test_del(&t, i);
+    if( t.lpm.root != NULL || t.lpm.n_nodes != 0 || t.lpm.n_keys != 0 )
+      bad_del++;
+  }
+
+  cmp_ok(bad_add, "==", 0,
+         "%s: random routes match the linear scan", afs);
+  cmp_ok(bad_del, "==", 0,
+         "%s: random routes match the linear scan after removal", afs);
+  cmp_ok(bad_readd, "==", 0,
+         "%s: random routes match the linear scan after reinsertion", afs);
+  cmp_ok(bad_rebuild, "==", 0,
+         "%s: random routes match the linear scan after rebuild", afs);
+}
+
+
 int main(void)
 {
   cp_unit_init();
@@ -509,6 +887,13 @@ int main(void)
   test_resolutions();
   test_route_resolve();
 
+  srand(0);
+  test_lpm_overlapping(AF_INET);
+  test_lpm_overlapping(AF_INET6);
+  test_lpm_multipath();
+  test_lpm_random(AF_INET);
+  test_lpm_random(AF_INET6);
+
 #ifdef CAN_TEST_ONLOAD_CPLANE_CALLS
   test_user_retrieve();
   test_cross_namespace_routing();
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/*
+ * Build the file using the following command:
+ *   $ gcc -lonload_ext -o accept_batch accept_batch.c
+ *
+ * Test by running the following command:
+ *   $ EF_TCP_ACCEPTQ_SHARDS=4 onload ./accept_batch [n_conns]
+ *
+ * Makes a number of connections to a listening socket and then accepts
+ * them all with onload_accept_batch().  Checks that each connection is
+ * accepted exactly once, with the right peer address, by sending the
+ * client's index down each one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <onload/extensions.h>
+
+#define MAX_CONNS  256
+#define BATCH      16
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d errno=%d\n", #x, __rc,   \
+              errno);                                                   \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+static int clients[MAX_CONNS];
+static struct sockaddr_in client_addrs[MAX_CONNS];
+static int accepted[MAX_CONNS];
+
+
+int main(int argc, char* argv[])
+{
+  struct sockaddr_storage addrs[BATCH];
+  struct sockaddr_in sa;
+  socklen_t sa_len = sizeof(sa);
+  int fds[BATCH];
+  int n_conns = argc > 1 ? atoi(argv[1]) : 64;
+  int lfd, i, j, rc, n_done = 0, n_calls = 0;
+
+  if( n_conns <= 0 || n_conns > MAX_CONNS ) {
+    fprintf(stderr, "usage: %s [n_conns (1..%d)]\n", argv[0], MAX_CONNS);
+    return 1;
+  }
+
+  TRY(lfd = socket(AF_INET, SOCK_STREAM, 0));
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TRY(bind(lfd, (struct sockaddr*) &sa, sizeof(sa)));
+  TRY(getsockname(lfd, (struct sockaddr*) &sa, &sa_len));
+  TRY(listen(lfd, MAX_CONNS));
+
+  for( i = 0; i < n_conns; ++i ) {
+    TRY(clients[i] = socket(AF_INET, SOCK_STREAM, 0));
+    TRY(connect(clients[i], (struct sockaddr*) &sa, sizeof(sa)));
+    sa_len = sizeof(client_addrs[i]);
+    TRY(getsockname(clients[i], (struct sockaddr*) &client_addrs[i],
+                    &sa_len));
+    TRY(send(clients[i], &i, sizeof(i), 0));
+  }
+
+  while( n_done < n_conns ) {
+    rc = onload_accept_batch(lfd, fds, addrs, BATCH, 0);
+    TRY(rc);
+    if( rc == 0 || rc > BATCH ) {
+      fprintf(stderr, "ERROR: onload_accept_batch returned %d\n", rc);
+      return 1;
+    }
+    ++n_calls;
+    for( j = 0; j < rc; ++j ) {
+      struct sockaddr_in* peer = (struct sockaddr_in*) &addrs[j];
+      TRY(recv(fds[j], &i, sizeof(i), MSG_WAITALL));
+      if( i < 0 || i >= n_conns || accepted[i] ) {
+        fprintf(stderr, "ERROR: bad or repeated client index %d\n", i);
+        return 1;
+      }
+      if( peer->sin_family != AF_INET ||
+          peer->sin_port != client_addrs[i].sin_port ) {
+        fprintf(stderr, "ERROR: wrong peer address for client %d\n", i);
+        return 1;
+      }
+      accepted[i] = 1;
+      close(fds[j]);
+      ++n_done;
+    }
+  }
+
+  for( i = 0; i < n_conns; ++i )
+    close(clients[i]);
+  close(lfd);
+
+  printf("Accepted %d connections in %d calls\n", n_done, n_calls);
+  return 0;
+}
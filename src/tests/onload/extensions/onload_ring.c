@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/*
+ * Build the file using the following command:
+ *   $ gcc -lonload_ext -o onload_ring onload_ring.c
+ *
+ * Test by running the following command:
+ *   $ onload ./onload_ring [port]
+ *
+ * Makes a TCP connection to itself over loopback using only ring requests
+ * (accept and connect, then a batch of sends and recvs), and checks that
+ * every request completes with the expected result.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <onload/extensions.h>
+#include <onload/extensions_ring.h>
+
+#define N_MSGS   16
+#define MSG_LEN  64
+
+enum { UD_ACCEPT = 1, UD_CONNECT, UD_NOP, UD_SEND,
+       UD_RECV = UD_SEND + N_MSGS };
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d errno=%d\n", #x, __rc,   \
+              errno);                                                   \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+static struct onload_ring ring;
+
+
+/* Wait for [n] completions, checking that none has failed, and return the
+ * result of the one with [user_data]. */
+static int reap(int n, uint64_t user_data)
+{
+  struct onload_ring_cqe* cqe;
+  int res = -1;
+
+  while( n > 0 ) {
+    TRY(onload_ring_wait(&ring, 1, 5000));
+    cqe = onload_ring_peek_cqe(&ring);
+    if( cqe == NULL ) {
+      fprintf(stderr, "ERROR: timed out\n");
+      exit(1);
+    }
+    if( cqe->res < 0 ) {
+      fprintf(stderr, "ERROR: request %llu failed: %s\n",
+              (unsigned long long) cqe->user_data, strerror(-cqe->res));
+      exit(1);
+    }
+    if( cqe->user_data == user_data )
+      res = cqe->res;
+    onload_ring_cqe_seen(&ring, cqe);
+    --n;
+  }
+  return res;
+}
+
+
+int main(int argc, char* argv[])
+{
+  struct sockaddr_in sa;
+  struct onload_ring_sqe* sqe;
+  char tx[N_MSGS][MSG_LEN], rx[N_MSGS * MSG_LEN];
+  int ls, cs, as, rc, i, got;
+
+  rc = onload_ring_init(32, &ring, 0);
+  if( rc == -ENOSYS ) {
+    printf("Not running with Onload\n");
+    return 0;
+  }
+  TRY(rc);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(argc > 1 ? atoi(argv[1]) : 20002);
+  TRY(ls = socket(AF_INET, SOCK_STREAM, 0));
+  TRY(setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &(int){1}, sizeof(int)));
+  TRY(bind(ls, (struct sockaddr*) &sa, sizeof(sa)));
+  TRY(listen(ls, 1));
+  /* Both sockets are left blocking: the ring must not block in accept().
+   * Unless EF_TCP_CLIENT_LOOPBACK is set the connect is handed over to the
+   * kernel, and completes synchronously. */
+  TRY(cs = socket(AF_INET, SOCK_STREAM, 0));
+
+  /* The accept can't complete until after the connect is submitted. */
+  sqe = onload_ring_get_sqe(&ring);
+  onload_ring_prep_accept(sqe, ls, NULL, NULL, 0);
+  sqe->user_data = UD_ACCEPT;
+  sqe = onload_ring_get_sqe(&ring);
+  onload_ring_prep_connect(sqe, cs, (struct sockaddr*) &sa, sizeof(sa));
+  sqe->user_data = UD_CONNECT;
+  TRY(onload_ring_submit(&ring));
+  as = reap(2, UD_ACCEPT);
+  printf("Connected: fd %d accepted\n", as);
+
+  /* Post the receives first so that they have to wait. */
+  sqe = onload_ring_get_sqe(&ring);
+  onload_ring_prep_recv(sqe, as, rx, sizeof(rx), MSG_WAITALL);
+  sqe->user_data = UD_RECV;
+  TRY(onload_ring_submit(&ring));
+
+  /* A NOP completes at once, even on the fd of a pending request. */
+  sqe = onload_ring_get_sqe(&ring);
+  sqe->opcode = ONLOAD_RING_OP_NOP;
+  sqe->fd = as;
+  sqe->user_data = UD_NOP;
+  TRY(onload_ring_submit(&ring));
+  if( onload_ring_peek_cqe(&ring) == NULL ||
+      onload_ring_peek_cqe(&ring)->user_data != UD_NOP ) {
+    fprintf(stderr, "ERROR: NOP did not complete on submission\n");
+    return 1;
+  }
+  onload_ring_cqe_seen(&ring, onload_ring_peek_cqe(&ring));
+
+  for( i = 0; i < N_MSGS; ++i ) {
+    memset(tx[i], 'a' + i, MSG_LEN);
+    sqe = onload_ring_get_sqe(&ring);
+    onload_ring_prep_send(sqe, cs, tx[i], MSG_LEN, 0);
+    sqe->user_data = UD_SEND + i;
+  }
+  TRY(onload_ring_submit(&ring));
+  got = reap(N_MSGS + 1, UD_RECV);
+  if( got != sizeof(rx) ) {
+    fprintf(stderr, "ERROR: received %d bytes, expected %zu\n",
+            got, sizeof(rx));
+    return 1;
+  }
+  for( i = 0; i < N_MSGS; ++i )
+    if( memcmp(rx + i * MSG_LEN, tx[i], MSG_LEN) != 0 ) {
+      fprintf(stderr, "ERROR: message %d out of order\n", i);
+      return 1;
+    }
+  printf("Received %d messages in order\n", N_MSGS);
+
+  onload_ring_free(&ring);
+  close(as);
+  close(cs);
+  close(ls);
+  return 0;
+}
@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+/*
+ * Build the file using the following command:
+ *   $ gcc -lonload_ext -o zc_recv_epoll zc_recv_epoll.c
+ *
+ * Test by running the following command:
+ *   $ EF_UL_EPOLL=1 onload ./zc_recv_epoll [n_socks]
+ *
+ * Binds a number of UDP sockets on loopback, adds them all to one epoll
+ * set, sends a datagram to each and then collects them all with
+ * onload_zc_recv_epoll().  Loopback traffic arrives through the kernel, so
+ * this uses ONLOAD_MSG_RECV_OS_INLINE.  Checks that each datagram arrives
+ * once, on the right socket, from the right address, and that events not
+ * returned as messages can be handled with ordinary calls.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <onload/extensions.h>
+#include <onload/extensions_zc.h>
+
+#define MAX_SOCKS  512
+#define N_MSGS     32
+#define N_IOVS     4
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d errno=%d\n", #x, __rc,   \
+              errno);                                                   \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+static int socks[MAX_SOCKS];
+static int received[MAX_SOCKS];
+static struct sockaddr_in sender_addr;
+
+
+static int sock_index(int fd)
+{
+  int i;
+  for( i = 0; i < MAX_SOCKS; ++i )
+    if( socks[i] == fd )
+      return i;
+  fprintf(stderr, "ERROR: message for unknown fd %d\n", fd);
+  exit(1);
+}
+
+
+static void check_payload(int i, const char* data, size_t len)
+{
+  char expect[32];
+
+  snprintf(expect, sizeof(expect), "datagram %d", i);
+  if( len != strlen(expect) || memcmp(data, expect, len) ) {
+    fprintf(stderr, "ERROR: socket %d got '%.*s'\n", i, (int) len, data);
+    exit(1);
+  }
+  ++received[i];
+}
+
+
+int main(int argc, char* argv[])
+{
+  struct onload_zc_mmsg msgs[N_MSGS];
+  struct onload_zc_iovec iovs[N_MSGS][N_IOVS];
+  struct sockaddr_in names[N_MSGS];
+  struct epoll_event ev, events[N_MSGS];
+  struct sockaddr_in sa;
+  socklen_t sa_len;
+  int n_socks = 64, n_done = 0, n_zc = 0, n_ev, sender, epfd, i, j, rc;
+  char buf[64];
+
+  if( argc > 1 )
+    n_socks = atoi(argv[1]);
+  if( n_socks <= 0 || n_socks > MAX_SOCKS ) {
+    fprintf(stderr, "usage: %s [n_socks]\n", argv[0]);
+    return 1;
+  }
+
+  TRY(epfd = epoll_create(1));
+  TRY(sender = socket(AF_INET, SOCK_DGRAM, 0));
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TRY(bind(sender, (struct sockaddr*) &sa, sizeof(sa)));
+  sa_len = sizeof(sender_addr);
+  TRY(getsockname(sender, (struct sockaddr*) &sender_addr, &sa_len));
+
+  for( i = 0; i < n_socks; ++i ) {
+    TRY(socks[i] = socket(AF_INET, SOCK_DGRAM, 0));
+    sa.sin_port = 0;
+    TRY(bind(socks[i], (struct sockaddr*) &sa, sizeof(sa)));
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    TRY(epoll_ctl(epfd, EPOLL_CTL_ADD, socks[i], &ev));
+  }
+
+  for( i = 0; i < n_socks; ++i ) {
+    sa_len = sizeof(sa);
+    TRY(getsockname(socks[i], (struct sockaddr*) &sa, &sa_len));
+    snprintf(buf, sizeof(buf), "datagram %d", i);
+    TRY(sendto(sender, buf, strlen(buf), 0, (struct sockaddr*) &sa,
+               sizeof(sa)));
+  }
+
+  while( n_done < n_socks ) {
+    for( i = 0; i < N_MSGS; ++i ) {
+      msgs[i].msg.iov = iovs[i];
+      msgs[i].msg.msghdr.msg_iovlen = N_IOVS;
+      msgs[i].msg.msghdr.msg_name = &names[i];
+      msgs[i].msg.msghdr.msg_namelen = sizeof(names[i]);
+      msgs[i].msg.msghdr.msg_control = NULL;
+      msgs[i].msg.msghdr.msg_controllen = 0;
+    }
+    n_ev = N_MSGS;
+    TRY(rc = onload_zc_recv_epoll(epfd, msgs, N_MSGS, events, &n_ev, 5000,
+                                  ONLOAD_MSG_RECV_OS_INLINE));
+    if( rc == 0 && n_ev == 0 ) {
+      fprintf(stderr, "ERROR: timed out with %d of %d received\n",
+              n_done, n_socks);
+      return 1;
+    }
+
+    for( i = 0; i < rc; ++i ) {
+      j = sock_index(msgs[i].fd);
+      if( msgs[i].msg.msghdr.msg_iovlen != 1 ||
+          msgs[i].rc != msgs[i].msg.iov[0].iov_len ||
+          names[i].sin_port != sender_addr.sin_port ) {
+        fprintf(stderr, "ERROR: bad message %d on socket %d\n", i, j);
+        return 1;
+      }
+      check_payload(j, msgs[i].msg.iov[0].iov_base, msgs[i].rc);
+      TRY(onload_zc_release_buffers(msgs[i].fd, &msgs[i].msg.iov[0].buf, 1));
+      ++n_done;
+      ++n_zc;
+    }
+
+    /* Anything not returned as a message is read the ordinary way. */
+    for( i = 0; i < n_ev; ++i ) {
+      j = events[i].data.u32;
+      if( ! (events[i].events & EPOLLIN) )
+        continue;
+      while( (rc = recv(socks[j], buf, sizeof(buf), MSG_DONTWAIT)) > 0 ) {
+        check_payload(j, buf, rc);
+        ++n_done;
+      }
+    }
+  }
+
+  for( i = 0; i < n_socks; ++i )
+    if( received[i] != 1 ) {
+      fprintf(stderr, "ERROR: socket %d got %d datagrams\n", i, received[i]);
+      return 1;
+    }
+
+  printf("Received %d datagrams on %d sockets, %d zero-copy\n",
+         n_done, n_socks, n_zc);
+  return 0;
+}
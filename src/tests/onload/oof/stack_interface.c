@@ -28,6 +28,11 @@ int tcp_helper_cluster_vi_base(tcp_helper_cluster_t* thc, int hwport)
   return 1;
 }
 
+int tcp_helper_cluster_vi_rss(tcp_helper_cluster_t* thc)
+{
+  return thc->thc_cluster_size > 1;
+}
+
 int tcp_helper_vi_hw_rx_loopback_supported(tcp_helper_resource_t* trs,
                                                   int hwport)
 {
@@ -13,9 +13,10 @@ close		:= $(patsubst %,$(AppPattern),close)
 sendfile	:= $(patsubst %,$(AppPattern),sendfile)
 sendfile_clnt	:= $(patsubst %,$(AppPattern),sendfile_clnt)
 splice		:= $(patsubst %,$(AppPattern),splice)
+socketpair	:= $(patsubst %,$(AppPattern),socketpair)
 
 TARGETS	:= $(read) $(write) $(writev) $(printf) $(ci_log) $(dup) $(streams) \
-	   $(execve) $(close) $(splice)
+	   $(execve) $(close) $(splice) $(socketpair)
 
 ifeq ($(GNU),1)
 TARGETS	+= $(sendfile) $(sendfile_clnt)
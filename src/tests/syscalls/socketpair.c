@@ -0,0 +1,517 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* socketpair
+ *
+ * Checks that socketpair(AF_UNIX, SOCK_STREAM) behaves as the kernel's:
+ * data, shutdown and end-of-file, EPIPE, epoll readiness, sharing across
+ * fork(), names, passing descriptors with SCM_RIGHTS, and MSG_WAITALL.
+ *
+ * Run it without Onload to check the test, and with Onload to check the
+ * accelerated sockets:
+ *
+ * ./socketpair
+ * EF_UNIX_SOCKETPAIR=1 onload ./socketpair
+ *
+ * It exits with status 0 if every check passes.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+
+
+#define TRY(x)                                                  \
+  do {                                                          \
+    int __rc = (x);                                             \
+    if( __rc < 0 ) {                                            \
+      fprintf(stderr, "ERROR: '%s' failed\n", #x);              \
+      fprintf(stderr, "ERROR: at %s:%d\n", __FILE__, __LINE__); \
+      fprintf(stderr, "ERROR: rc=%d errno=%d (%s)\n",           \
+              __rc, errno, strerror(errno));                    \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+
+#define TEST(x)                                                 \
+  do {                                                          \
+    if( ! (x) ) {                                               \
+      fprintf(stderr, "ERROR: test '%s' failed\n", #x);         \
+      fprintf(stderr, "ERROR: at %s:%d\n", __FILE__, __LINE__); \
+      exit(1);                                                  \
+    }                                                           \
+  } while( 0 )
+
+
+/* Checks that [x] fails with [err]. */
+#define TEST_ERRNO(x, err)                                      \
+  do {                                                          \
+    errno = 0;                                                  \
+    TEST((x) < 0);                                              \
+    TEST(errno == (err));                                       \
+  } while( 0 )
+
+
+static void make_pair(int sv[2])
+{
+  TRY(socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+}
+
+
+static void close_pair(int sv[2])
+{
+  TRY(close(sv[0]));
+  TRY(close(sv[1]));
+}
+
+
+/* Returns the events that epoll reports for [fd], without waiting. */
+static unsigned epoll_events(int fd)
+{
+  struct epoll_event ev;
+  int epfd, rc;
+
+  TRY(epfd = epoll_create1(0));
+  ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP;
+  ev.data.fd = fd;
+  TRY(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev));
+  TRY(rc = epoll_wait(epfd, &ev, 1, 0));
+  TRY(close(epfd));
+  return rc == 0 ? 0 : ev.events;
+}
+
+
+static void test_data(void)
+{
+  char buf[16];
+  int sv[2];
+  int n;
+
+  make_pair(sv);
+  TEST(send(sv[0], "hello", 5, 0) == 5);
+  TRY(ioctl(sv[1], FIONREAD, &n));
+  TEST(n == 5);
+  TEST(recv(sv[1], buf, sizeof(buf), MSG_PEEK) == 5);
+  TEST(read(sv[1], buf, sizeof(buf)) == 5);
+  TEST(memcmp(buf, "hello", 5) == 0);
+  TEST(write(sv[1], "back", 4) == 4);
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 4);
+  TEST(memcmp(buf, "back", 4) == 0);
+  TEST_ERRNO(recv(sv[0], buf, sizeof(buf), MSG_DONTWAIT), EAGAIN);
+  close_pair(sv);
+}
+
+
+static void test_shutdown(void)
+{
+  char buf[16];
+  int sv[2];
+
+  make_pair(sv);
+  TEST(send(sv[0], "x", 1, 0) == 1);
+  TRY(shutdown(sv[0], SHUT_WR));
+
+  /* The peer reads what was sent, then end-of-file, and can still reply. */
+  TEST(epoll_events(sv[1]) & EPOLLRDHUP);
+  TEST(recv(sv[1], buf, sizeof(buf), 0) == 1);
+  TEST(recv(sv[1], buf, sizeof(buf), 0) == 0);
+  TEST(send(sv[1], "y", 1, 0) == 1);
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 1);
+  TEST(buf[0] == 'y');
+
+  /* The socket that was shut down cannot send. */
+  TEST_ERRNO(send(sv[0], "z", 1, MSG_NOSIGNAL), EPIPE);
+  close_pair(sv);
+}
+
+
+static void test_epipe(void)
+{
+  struct sigaction sa, old_sa;
+  char buf[16];
+  int sv[2];
+
+  make_pair(sv);
+  TEST(send(sv[1], "x", 1, 0) == 1);
+  TRY(close(sv[1]));
+  TEST_ERRNO(send(sv[0], "x", 1, MSG_NOSIGNAL), EPIPE);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = SIG_IGN;
+  TRY(sigaction(SIGPIPE, &sa, &old_sa));
+  TEST_ERRNO(write(sv[0], "x", 1), EPIPE);
+  TRY(sigaction(SIGPIPE, &old_sa, NULL));
+
+  /* What the peer sent before it went is still there. */
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 1);
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 0);
+  TRY(close(sv[0]));
+}
+
+
+static void test_epoll(void)
+{
+  unsigned ev;
+  char buf[16];
+  int sv[2];
+
+  make_pair(sv);
+  TEST(epoll_events(sv[0]) == EPOLLOUT);
+
+  TEST(send(sv[1], "x", 1, 0) == 1);
+  TEST(epoll_events(sv[0]) == (EPOLLIN | EPOLLOUT));
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 1);
+  TEST(epoll_events(sv[0]) == EPOLLOUT);
+
+  TRY(close(sv[1]));
+  ev = epoll_events(sv[0]);
+  TEST(ev & EPOLLIN);
+  TEST(ev & EPOLLRDHUP);
+  TEST(ev & EPOLLHUP);
+  TRY(close(sv[0]));
+}
+
+
+/* A child shares the parent's sockets, and the peer sees end-of-file only
+ * once every copy of a socket is closed. */
+static void test_fork(void)
+{
+  char buf[16];
+  int sv[2];
+  int status;
+  pid_t pid;
+
+  make_pair(sv);
+  TRY(pid = fork());
+  if( pid == 0 ) {
+    close(sv[0]);
+    if( send(sv[1], "child", 5, 0) != 5 ||
+        recv(sv[1], buf, sizeof(buf), 0) != 6 ||
+        memcmp(buf, "parent", 6) != 0 )
+      _exit(1);
+    _exit(0);
+  }
+
+  TEST(send(sv[0], "parent", 6, 0) == 6);
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 5);
+  TEST(memcmp(buf, "child", 5) == 0);
+  TRY(waitpid(pid, &status, 0));
+  TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  TEST(epoll_events(sv[0]) == EPOLLOUT);
+  TRY(close(sv[1]));
+  TEST(recv(sv[0], buf, sizeof(buf), 0) == 0);
+  TEST(epoll_events(sv[0]) & EPOLLHUP);
+  TRY(close(sv[0]));
+}
+
+
+static void test_names(void)
+{
+  struct sockaddr_un addr, got;
+  struct ucred cred;
+  socklen_t len;
+  int sv[2];
+  int s;
+
+  make_pair(sv);
+
+  /* Both ends start unnamed. */
+  len = sizeof(got);
+  TRY(getsockname(sv[0], (struct sockaddr*) &got, &len));
+  TEST(len == sizeof(sa_family_t));
+  TEST(got.sun_family == AF_UNIX);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  len = offsetof(struct sockaddr_un, sun_path) + 1 +
+        sprintf(addr.sun_path + 1, "onload-socketpair-%d", (int) getpid());
+  TRY(bind(sv[0], (struct sockaddr*) &addr, len));
+  TEST_ERRNO(bind(sv[0], (struct sockaddr*) &addr, len), EINVAL);
+
+  len = sizeof(got);
+  TRY(getsockname(sv[0], (struct sockaddr*) &got, &len));
+  TEST(memcmp(&got, &addr, len) == 0);
+  len = sizeof(got);
+  TRY(getpeername(sv[1], (struct sockaddr*) &got, &len));
+  TEST(memcmp(&got, &addr, len) == 0);
+
+  len = sizeof(cred);
+  TRY(getsockopt(sv[1], SOL_SOCKET, SO_PEERCRED, &cred, &len));
+  TEST(cred.pid == getpid());
+
+  /* The sockets are connected, so they cannot listen, and nothing can
+   * connect to the bound name. */
+  TEST_ERRNO(listen(sv[0], 1), EINVAL);
+  TEST_ERRNO(accept(sv[0], NULL, NULL), EINVAL);
+  TEST_ERRNO(connect(sv[1], (struct sockaddr*) &addr, len), ECONNREFUSED);
+  TRY(s = socket(AF_UNIX, SOCK_STREAM, 0));
+  TEST_ERRNO(connect(s, (struct sockaddr*) &addr, len), ECONNREFUSED);
+  TRY(close(s));
+  close_pair(sv);
+}
+
+
+/* Sends [data] with a descriptor for [fd], or with none if [fd] is -1. */
+static int send_fd(int s, const char* data, int fd)
+{
+  char control[CMSG_SPACE(sizeof(int))];
+  struct msghdr msg;
+  struct cmsghdr* cmsg;
+  struct iovec iov;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = (void*) data;
+  iov.iov_len = strlen(data);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if( fd >= 0 ) {
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+  return sendmsg(s, &msg, 0);
+}
+
+
+/* Receives into [buf] and returns the descriptor received, or -1. */
+static int recv_fd(int s, char* buf, size_t len, int* n_out)
+{
+  char control[CMSG_SPACE(sizeof(int) * 4)];
+  struct msghdr msg;
+  struct cmsghdr* cmsg;
+  struct iovec iov;
+  int fd = -1;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  TRY(*n_out = recvmsg(s, &msg, MSG_DONTWAIT));
+  TEST((msg.msg_flags & MSG_CTRUNC) == 0);
+  for( cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg) ) {
+    TEST(cmsg->cmsg_level == SOL_SOCKET);
+    TEST(cmsg->cmsg_type == SCM_RIGHTS);
+    TEST(cmsg->cmsg_len == CMSG_LEN(sizeof(int)));
+    TEST(fd == -1);
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  }
+  return fd;
+}
+
+
+static void test_scm_rights(void)
+{
+  char buf[16];
+  int sv[2], p[2];
+  int fd, n;
+
+  make_pair(sv);
+  TRY(pipe(p));
+  TEST(write(p[1], "!", 1) == 1);
+
+  /* A read takes the data before a descriptor, but stops at the end of the
+   * data sent with it. */
+  TEST(send_fd(sv[0], "ab", -1) == 2);
+  TEST(send_fd(sv[0], "cd", p[0]) == 2);
+  TEST(send_fd(sv[0], "ef", -1) == 2);
+  fd = recv_fd(sv[1], buf, sizeof(buf), &n);
+  TEST(n == 4);
+  TEST(memcmp(buf, "abcd", 4) == 0);
+  TEST(fd >= 0);
+  TEST(read(fd, buf, sizeof(buf)) == 1);
+  TEST(buf[0] == '!');
+  TRY(close(fd));
+  fd = recv_fd(sv[1], buf, sizeof(buf), &n);
+  TEST(n == 2);
+  TEST(memcmp(buf, "ef", 2) == 0);
+  TEST(fd == -1);
+
+  /* A descriptor read without room for it is closed, and does not turn up
+   * with later data. */
+  TEST(send_fd(sv[1], "g", p[0]) == 1);
+  TEST(read(sv[0], buf, sizeof(buf)) == 1);
+  TEST(send_fd(sv[1], "h", -1) == 1);
+  fd = recv_fd(sv[0], buf, sizeof(buf), &n);
+  TEST(n == 1);
+  TEST(buf[0] == 'h');
+  TEST(fd == -1);
+
+  /* A bad descriptor fails the send, and nothing is sent. */
+  TRY(close(p[1]));
+  TEST_ERRNO(send_fd(sv[0], "j", p[1]), EBADF);
+  TEST_ERRNO(recv(sv[1], buf, sizeof(buf), MSG_DONTWAIT), EAGAIN);
+
+  TRY(close(p[0]));
+  close_pair(sv);
+}
+
+
+/* Fills the direction from [s] to its peer, and returns how many bytes it
+ * took. */
+static int fill(int s)
+{
+  char buf[4096];
+  int n = 0, rc;
+
+  memset(buf, '.', sizeof(buf));
+  while( (rc = send(s, buf, sizeof(buf), MSG_DONTWAIT)) > 0 )
+    n += rc;
+  TEST(errno == EAGAIN);
+  return n;
+}
+
+
+/* Reads and discards [n] bytes. */
+static void drain(int s, int n)
+{
+  char buf[4096];
+  int rc;
+
+  while( n > 0 ) {
+    TRY(rc = recv(s, buf, n < (int) sizeof(buf) ? n : (int) sizeof(buf), 0));
+    TEST(rc > 0);
+    n -= rc;
+  }
+}
+
+
+static void test_scm_rights_blocked(void)
+{
+  char buf[16];
+  int sv[2], p[2];
+  int fd, n, n_fill, status;
+  pid_t pid;
+
+  make_pair(sv);
+  TRY(pipe(p));
+
+  /* A descriptor goes with the data it was sent with, even when the send
+   * had to wait for space and another writer got in first.  The reader
+   * sees the writes in either order, but the data read with the descriptor
+   * always ends with its own. */
+  n_fill = fill(sv[0]);
+  TRY(pid = fork());
+  if( pid == 0 ) {
+    TEST(send_fd(sv[0], "cd", p[0]) == 2);
+    exit(0);
+  }
+  usleep(100000);
+  drain(sv[1], n_fill);
+  TEST(send_fd(sv[0], "ab", -1) == 2);
+  TRY(waitpid(pid, &status, 0));
+  TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  fd = recv_fd(sv[1], buf, sizeof(buf), &n);
+  if( fd < 0 ) {
+    TEST(n == 2);
+    TEST(memcmp(buf, "ab", 2) == 0);
+    fd = recv_fd(sv[1], buf, sizeof(buf), &n);
+  }
+  TEST(fd >= 0);
+  TEST(n >= 2);
+  TEST(memcmp(buf + n - 2, "cd", 2) == 0);
+  TRY(close(fd));
+
+  TRY(close(p[0]));
+  TRY(close(p[1]));
+  close_pair(sv);
+}
+
+
+static void test_waitall(void)
+{
+  char buf[16];
+  int sv[2], p[2];
+  int fd, status;
+  struct msghdr msg;
+  struct iovec iov;
+  char control[CMSG_SPACE(sizeof(int))];
+  pid_t pid;
+
+  make_pair(sv);
+
+  /* A read waits for all it asked for. */
+  TEST(send(sv[0], "abc", 3, 0) == 3);
+  TRY(pid = fork());
+  if( pid == 0 ) {
+    usleep(100000);
+    TEST(send(sv[0], "def", 3, 0) == 3);
+    exit(0);
+  }
+  TEST(recv(sv[1], buf, 6, MSG_WAITALL) == 6);
+  TEST(memcmp(buf, "abcdef", 6) == 0);
+  TRY(waitpid(pid, &status, 0));
+  TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  /* Unless a non-blocking read, which takes what there is. */
+  TEST(send(sv[0], "gh", 2, 0) == 2);
+  TEST(recv(sv[1], buf, 6, MSG_WAITALL | MSG_DONTWAIT) == 2);
+
+  /* It stops once it has been given a descriptor. */
+  TRY(pipe(p));
+  TEST(send_fd(sv[0], "ij", -1) == 2);
+  TEST(send_fd(sv[0], "kl", p[0]) == 2);
+  TEST(send_fd(sv[0], "mn", -1) == 2);
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = buf;
+  iov.iov_len = sizeof(buf);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  TEST(recvmsg(sv[1], &msg, MSG_WAITALL) == 4);
+  TEST(memcmp(buf, "ijkl", 4) == 0);
+  TEST(msg.msg_controllen != 0);
+  memcpy(&fd, CMSG_DATA(CMSG_FIRSTHDR(&msg)), sizeof(int));
+  TRY(close(fd));
+  TRY(close(p[0]));
+  TRY(close(p[1]));
+
+  /* And at end-of-file. */
+  TRY(shutdown(sv[0], SHUT_WR));
+  TEST(recv(sv[1], buf, 6, MSG_WAITALL) == 2);
+  TEST(memcmp(buf, "mn", 2) == 0);
+  TEST(recv(sv[1], buf, 6, MSG_WAITALL) == 0);
+
+  close_pair(sv);
+}
+
+
+int main(int argc, char* argv[])
+{
+  test_data();
+  test_shutdown();
+  test_epipe();
+  test_epoll();
+  test_fork();
+  test_names();
+  test_scm_rights();
+  test_scm_rights_blocked();
+  test_waitall();
+  printf("socketpair: all tests passed\n");
+  return 0;
+}
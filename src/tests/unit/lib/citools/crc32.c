@@ -0,0 +1,96 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/tools.h>
+#include <ci/tools/crc32c.h>
+#include <ci/tools/cpu_features.h>
+
+/* Test infrastructure */
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+
+/* Long enough for several rounds of the three-way version */
+#define MAX_LEN 16384
+#define MAX_OFF 8
+
+static ci_uint8 buf[MAX_LEN + MAX_OFF];
+static ci_uint8 dst[MAX_LEN + MAX_OFF];
+
+static void test_known_values(void)
+{
+  static const ci_uint8 digits[] = "123456789";
+  ci_uint8 zeros[32] = {0};
+
+  /* Check values from RFC 3720 and the CRC catalogue */
+  CHECK(ci_crc32c(digits, 9), ==, 0xe3069283);
+  CHECK(ci_crc32c(zeros, 32), ==, 0x8a9136aa);
+  CHECK(~ci_crc32c_partial_table(digits, 9, 0xffffffff), ==, 0xe3069283);
+}
+
+#if CI_CRC32C_HW
+static void check_fn(ci_uint32 (*fn)(const ci_uint8*, ci_uint32, ci_uint32))
+{
+  int len, i;
+
+  for( len = 0; len <= 1024; ++len )
+    CHECK(fn(buf, len, 0xffffffff), ==,
+          ci_crc32c_partial_table(buf, len, 0xffffffff));
+
+  for( i = 0; i < 1000; ++i ) {
+    int len = random() % (MAX_LEN + 1);
+    int off = random() % MAX_OFF;
+    ci_uint32 crc = random();
+    CHECK(fn(buf + off, len, crc), ==,
+          ci_crc32c_partial_table(buf + off, len, crc));
+  }
+}
+
+static void test_hw(void)
+{
+  if( ! ci_cpu_has_feature("sse4.2") ) {
+    printf("sse4.2: not supported on this CPU, skipped\n");
+    return;
+  }
+  check_fn(ci_crc32c_partial_sse42);
+  if( ! ci_cpu_has_feature("pclmul") ) {
+    printf("pclmul: not supported on this CPU, skipped\n");
+    return;
+  }
+  check_fn(ci_crc32c_partial_pclmul);
+}
+#endif
+
+static void test_dispatch(void)
+{
+  int i;
+
+  for( i = 0; i < 1000; ++i ) {
+    int len = random() % (MAX_LEN + 1);
+    int off = random() % MAX_OFF;
+    ci_uint32 expect = ci_crc32c_partial_table(buf + off, len, 0xffffffff);
+
+    CHECK(ci_crc32c_partial(buf + off, len, 0xffffffff), ==, expect);
+    memset(dst, 0, sizeof(dst));
+    CHECK(ci_crc32c_partial_copy(dst, buf + off, len, 0xffffffff), ==,
+          expect);
+    CHECK_MEM(dst, buf + off, len);
+  }
+}
+
+int main(void)
+{
+  int i;
+
+  srandom(0);
+  for( i = 0; i < sizeof(buf); ++i )
+    buf[i] = random();
+
+  TEST_RUN(test_known_values);
+#if CI_CRC32C_HW
+  TEST_RUN(test_hw);
+#endif
+  TEST_RUN(test_dispatch);
+  TEST_END();
+}
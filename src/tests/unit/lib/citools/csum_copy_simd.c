@@ -0,0 +1,127 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/tools.h>
+#include <ci/tools/cpu_features.h>
+#include <ci/tools/ipcsum_base.h>
+
+/* Test infrastructure */
+#include <stdbool.h>
+#include <string.h>
+#include "unit_test.h"
+
+#define MAX_LEN 4096
+#define MAX_OFF 64
+
+typedef unsigned (*csum_copy_fn)(void*, const void*, int, unsigned);
+typedef unsigned (*csum_fn)(const void*, int, unsigned);
+
+static struct {
+  const char* feature;
+  csum_copy_fn copy;
+  csum_fn sum;
+} kernels[] = {
+  { "sse2",    ci_ip_csum_copy_sse2,   ci_ip_csum_sse2 },
+  { "avx2",    ci_ip_csum_copy_avx2,   ci_ip_csum_avx2 },
+  { "avx512f", ci_ip_csum_copy_avx512, ci_ip_csum_avx512 },
+};
+
+static ci_uint8 src_buf[MAX_LEN + MAX_OFF];
+static ci_uint8 ref_buf[MAX_LEN + MAX_OFF];
+static ci_uint8 dst_buf[MAX_LEN + MAX_OFF + 1];
+
+/* The kernels don't return the same partial sum as the C version, only one
+ * which folds to the same value. */
+static unsigned fold(unsigned sum)
+{
+  while( sum >> 16 )
+    sum = (sum & 0xffff) + (sum >> 16);
+  return sum;
+}
+
+static void fill_random(ci_uint8* buf, int len, int pattern)
+{
+  int i;
+  for( i = 0; i < len; ++i ) {
+    switch( pattern ) {
+    case 0:  buf[i] = random();  break;
+    case 1:  buf[i] = 0xff;  break;   /* maximise carries */
+    default: buf[i] = 0;  break;
+    }
+  }
+}
+
+static void check_one(int k, int len, int src_off, int dst_off, unsigned sum)
+{
+  unsigned expect, got;
+  const ci_uint8* src = src_buf + src_off;
+  ci_uint8* dst = dst_buf + dst_off;
+
+  memset(ref_buf, 0xaa, sizeof(ref_buf));
+  memset(dst_buf, 0xaa, sizeof(dst_buf));
+  expect = ci_ip_csum_copy_aligned_c(ref_buf + dst_off, src, len, sum);
+  got = kernels[k].copy(dst, src, len, sum);
+  CHECK(fold(got), ==, fold(expect));
+  CHECK_MEM(dst_buf, ref_buf, dst_off + len);
+  /* Nothing written past the end */
+  CHECK(dst_buf[dst_off + len], ==, 0xaa);
+
+  got = kernels[k].sum(src, len, sum);
+  CHECK(fold(got), ==, fold(ci_ip_csum_aligned_c(src, len, sum)));
+}
+
+static void test_kernels(void)
+{
+  static const unsigned sums[] = { 0, 1, 0xffff, 0xfffffffe, 0xffffffff };
+  int k, pattern, len, i;
+
+  for( k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k ) {
+    if( ! ci_cpu_has_feature((char*) kernels[k].feature) ) {
+      printf("%s: not supported on this CPU, skipped\n", kernels[k].feature);
+      continue;
+    }
+    for( pattern = 0; pattern < 3; ++pattern ) {
+      fill_random(src_buf, sizeof(src_buf), pattern);
+      /* Every length around the vector sizes */
+      for( len = 0; len <= 300; ++len )
+        check_one(k, len, 0, 0, sums[len % 5]);
+      /* Random lengths and misalignment of both buffers */
+      for( i = 0; i < 2000; ++i )
+        check_one(k, random() % (MAX_LEN + 1), random() % MAX_OFF,
+                  random() % MAX_OFF, sums[i % 5]);
+    }
+  }
+}
+
+/* The public entry points pick a kernel by themselves */
+static void test_dispatch(void)
+{
+  int i;
+
+  fill_random(src_buf, sizeof(src_buf), 0);
+  for( i = 0; i < 1000; ++i ) {
+    int len = random() % (MAX_LEN + 1);
+    int off = random() % MAX_OFF;
+    unsigned expect = ci_ip_csum_copy_aligned_c(ref_buf, src_buf + off,
+                                                len, 0);
+    CHECK(fold(ci_ip_csum_copy_simd(dst_buf, src_buf + off, len, 0)), ==,
+          fold(expect));
+    CHECK_MEM(dst_buf, ref_buf, len);
+    CHECK(fold(ci_ip_csum_simd(src_buf + off, len, 0)), ==, fold(expect));
+
+    len &= ~1;
+    CHECK(fold(ci_ip_csum_copy2(dst_buf, src_buf + off, len, 0)), ==,
+          fold(ci_ip_csum_copy_aligned_c(ref_buf, src_buf + off, len, 0)));
+    CHECK(fold(ci_ip_csum_partial(0, src_buf + off, len)), ==,
+          fold(ci_ip_csum_aligned_c(src_buf + off, len, 0)));
+  }
+}
+
+int main(void)
+{
+  srandom(0);
+  TEST_RUN(test_kernels);
+  TEST_RUN(test_dispatch);
+  TEST_END();
+}
@@ -0,0 +1,283 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include <pthread.h>
+
+#if CI_CFG_CLUSTER_STEER
+
+#define N_RINGS 2
+#define RING_SIZE 4
+#define ETH_LEN 14
+#define FRAME_LEN (ETH_LEN + sizeof(ci_ip4_hdr) + sizeof(ci_udp_hdr) + 8)
+
+static ci_netif* test_ni;
+static ci_ip_pkt_fmt* test_pkt;
+static struct oo_steer_ring* test_ring;
+static int n_freed;
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ++n_freed;
+}
+
+#define TEST_FRC 0x123456789ull
+#define TEST_HW_SEC 1000
+#define TEST_HW_NSEC 2000
+
+void ci_netif_get_rx_timestamp(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+#if CI_CFG_TIMESTAMPING
+  pkt->hw_stamp.tv_sec = TEST_HW_SEC;
+  pkt->hw_stamp.tv_nsec = TEST_HW_NSEC;
+#endif
+}
+
+/* Every flow belongs to instance 1. */
+int ci_netif_active_wild_nic_hash(ci_netif *ni,
+                                  ci_addr_t laddr, ci_uint16 lport,
+                                  ci_addr_t raddr, ci_uint16 rport)
+{
+  return 1;
+}
+
+
+/* Test fixtures */
+static void setup(void)
+{
+  ci_ip4_hdr* ip;
+  ci_udp_hdr* udp;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  test_ni->steer = calloc(1, OO_STEER_SLOTS_OFS +
+                          (N_RINGS - 1) * RING_SIZE * OO_STEER_SLOT_SIZE);
+  test_ni->steer_n_rings = N_RINGS;
+  test_ni->steer_ring_mask = RING_SIZE - 1;
+  test_ring = &test_ni->steer->ring[1];
+  n_freed = 0;
+
+  test_pkt = calloc(1, CI_CFG_PKT_BUF_SIZE);
+  test_pkt->n_buffers = 1;
+  test_pkt->flags = CI_PKT_FLAG_RX;
+  test_pkt->pkt_start_off = 0;
+  test_pkt->pkt_eth_payload_off = ETH_LEN;
+  test_pkt->pay_len = FRAME_LEN;
+  memset(PKT_START(test_pkt), 0xee, ETH_LEN);
+  *((ci_uint16*) oo_l3_hdr(test_pkt) - 1) = CI_ETHERTYPE_IP;
+
+  ip = oo_ip_hdr(test_pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_protocol = IPPROTO_UDP;
+  ip->ip_saddr_be32 = CI_BSWAPC_BE32(0x0a000001);
+  ip->ip_daddr_be32 = CI_BSWAPC_BE32(0x0a000002);
+  udp = (ci_udp_hdr*) (ip + 1);
+  udp->udp_source_be16 = CI_BSWAPC_BE16(1234);
+  udp->udp_dest_be16 = CI_BSWAPC_BE16(5678);
+}
+
+static void teardown(void)
+{
+  free(test_pkt);
+  free(test_ni->steer);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+/* Returns whether the packet was passed on.  CHECK() evaluates its
+ * arguments more than once, so the result is stored. */
+static int steered;
+
+static void steer_rx(void)
+{
+  test_pkt->refcount = 1;
+  steered = ci_netif_steer_rx(test_ni, test_pkt);
+}
+
+
+/* A ring without a stack is left alone, and the packet handled locally. */
+static void test_steer_not_live(void)
+{
+  setup();
+  steer_rx();
+  CHECK(steered, ==, 0);
+  CHECK(test_ring->head, ==, 0);
+  CHECK(test_ring->busy, ==, 0);
+  CHECK(n_freed, ==, 0);
+  CHECK(test_ni->steer_kick_mask, ==, 0);
+  teardown();
+}
+
+/* A frame is copied into the next slot of a live ring, and the ring is
+ * never left busy, including when it is full. */
+static void test_steer_live(void)
+{
+  struct oo_steer_slot* slot;
+  int i;
+
+  setup();
+  test_ring->live = 1;
+  steer_rx();
+  CHECK(steered, ==, 1);
+  CHECK(test_ring->head, ==, 1);
+  CHECK(test_ring->busy, ==, 0);
+  CHECK(n_freed, ==, 1);
+  CHECK(test_ni->steer_kick_mask, ==, 1ull << 1);
+  slot = ci_netif_steer_slot(test_ni, 1, 0);
+  CHECK(slot->len, ==, FRAME_LEN);
+  CHECK_MEM(slot->frame, PKT_START(test_pkt), FRAME_LEN);
+
+  for( i = 1; i < RING_SIZE; ++i ) {
+    steer_rx();
+    CHECK(steered, ==, 1);
+  }
+  CHECK(test_ring->head, ==, RING_SIZE);
+  steer_rx();
+  CHECK(steered, ==, 1);
+  CHECK(test_ring->head, ==, RING_SIZE);
+  CHECK(test_ring->n_full, ==, 1);
+  CHECK(test_ring->busy, ==, 0);
+  CHECK(n_freed, ==, RING_SIZE + 1);
+
+  /* Once stopped, the ring is not used again. */
+  CHECK_TRUE(oo_steer_ring_stop(test_ring));
+  CHECK(test_ring->live, ==, 0);
+  test_ring->tail = test_ring->head;
+  steer_rx();
+  CHECK(steered, ==, 0);
+  CHECK(test_ring->head, ==, RING_SIZE);
+  teardown();
+}
+
+/* The frame takes the time at which instance 0 received it into the ring,
+ * and the other stack's packet comes out with the same timestamps. */
+static void test_steer_timestamps(void)
+{
+  struct oo_steer_slot* slot;
+  ci_ip_pkt_fmt* pkt;
+
+  setup();
+  test_ring->live = 1;
+  IPTIMER_STATE(test_ni)->frc = TEST_FRC;
+  steer_rx();
+  CHECK(steered, ==, 1);
+  slot = ci_netif_steer_slot(test_ni, 1, 0);
+  CHECK(slot->tstamp_frc, ==, TEST_FRC);
+#if CI_CFG_TIMESTAMPING
+  CHECK(slot->hw_stamp.tv_sec, ==, TEST_HW_SEC);
+  CHECK(slot->hw_stamp.tv_nsec, ==, TEST_HW_NSEC);
+#endif
+
+  /* Later, in the other stack. */
+  IPTIMER_STATE(test_ni)->frc = TEST_FRC + 1000;
+  pkt = calloc(1, CI_CFG_PKT_BUF_SIZE);
+  ci_netif_steer_pkt_fill(test_ni, pkt, slot, slot->len, 3);
+  CHECK(pkt->pay_len, ==, FRAME_LEN);
+  CHECK(pkt->intf_i, ==, 3);
+  CHECK(pkt->refcount, ==, 1);
+  CHECK_TRUE(pkt->flags & CI_PKT_FLAG_RX);
+  CHECK_TRUE(pkt->rx_flags & CI_PKT_RX_FLAG_STEERED);
+  CHECK(pkt->tstamp_frc, ==, TEST_FRC);
+#if CI_CFG_TIMESTAMPING
+  CHECK(pkt->hw_stamp.tv_sec, ==, TEST_HW_SEC);
+  CHECK(pkt->hw_stamp.tv_nsec, ==, TEST_HW_NSEC);
+#endif
+  CHECK(test_ni->state->n_rx_pkts, ==, 1);
+  CHECK(oo_offbuf_left(&pkt->buf), ==, FRAME_LEN);
+  CHECK_MEM(PKT_START(pkt), PKT_START(test_pkt), FRAME_LEN);
+  free(pkt);
+  teardown();
+}
+
+/* Stopping a ring which the producer is filling must wait for it. */
+static void test_steer_stop_busy(void)
+{
+  setup();
+  test_ring->live = 1;
+  test_ring->busy = 1;
+  CHECK_FALSE(oo_steer_ring_stop(test_ring));
+  CHECK(test_ring->live, ==, 0);
+  test_ring->busy = 0;
+  CHECK_TRUE(oo_steer_ring_stop(test_ring));
+  teardown();
+}
+
+static volatile int producer_stop;
+
+static void* producer(void* arg)
+{
+  while( ! producer_stop ) {
+    ci_netif_steer_rx(test_ni, test_pkt);
+    test_ring->tail = test_ring->head;
+  }
+  return NULL;
+}
+
+/* Once a stop has succeeded, a producer running concurrently never moves
+ * the head again.  This is what the kernel relies on before resetting the
+ * ring for a new stack. */
+static void test_steer_stop_race(void)
+{
+  volatile ci_uint32* head;
+  pthread_t thread;
+  ci_uint32 stopped_head;
+  int i, j, rc;
+
+  setup();
+  head = &test_ring->head;
+  /* The producer drops a reference each time it passes the packet on. */
+  test_pkt->refcount = 1000000000;
+  producer_stop = 0;
+  rc = pthread_create(&thread, NULL, producer, NULL);
+  CHECK(rc, ==, 0);
+
+  for( i = 0; i < 200; ++i ) {
+    stopped_head = *head;
+    test_ring->live = 1;
+    while( *head == stopped_head )
+      ci_spinloop_pause();
+    while( ! oo_steer_ring_stop(test_ring) )
+      ci_spinloop_pause();
+    stopped_head = *head;
+    for( j = 0; j < 1000; ++j ) {
+      CHECK(*head, ==, stopped_head);
+      ci_spinloop_pause();
+    }
+  }
+
+  producer_stop = 1;
+  pthread_join(thread, NULL);
+  CHECK(test_ring->busy, ==, 0);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_steer_not_live);
+  TEST_RUN(test_steer_live);
+  TEST_RUN(test_steer_timestamps);
+  TEST_RUN(test_steer_stop_busy);
+  TEST_RUN(test_steer_stop_race);
+  TEST_END();
+}
+
+#else
+
+int main(void)
+{
+  TEST_END();
+}
+
+#endif
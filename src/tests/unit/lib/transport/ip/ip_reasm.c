@@ -0,0 +1,518 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_PKTS 16
+#define ETH_LEN 14
+
+/* A datagram of 8 bytes of UDP header and 40 of data, sent as three
+ * fragments of 16 bytes each. */
+#define DGRAM_LEN 48
+#define FRAG_LEN  16
+
+static ci_netif* test_ni;
+static char* test_pkt_set;
+static int freed[N_PKTS];
+
+static ci_ip_pkt_fmt* delivered;
+static int delivered_paylen;
+static int n_delivered;
+
+static int to_kernel[N_PKTS];
+static int n_to_kernel;
+static int kernel_accepts;
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ++freed[OO_PP_ID(OO_PKT_P(pkt))];
+  if( OO_PP_NOT_NULL(pkt->frag_next) ) {
+    ci_netif_pkt_release(ni, PKT(ni, pkt->frag_next));
+    pkt->frag_next = OO_PP_NULL;
+  }
+}
+
+void ci_udp_handle_rx(ci_netif* ni, ci_ip_pkt_fmt* pkt, ci_udp_hdr* udp,
+                      int ip_paylen)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK((char*) udp, ==, oo_offbuf_ptr(&pkt->buf));
+  delivered = pkt;
+  delivered_paylen = ip_paylen;
+  ++n_delivered;
+}
+
+int ci_netif_pkt_pass_to_kernel(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(pkt->n_buffers, >=, 1);
+  CHECK(OO_PP_ID(pkt->frag_next), ==, OO_PP_ID(OO_PP_NULL));
+  if( ! kernel_accepts )
+    return 0;
+  to_kernel[n_to_kernel++] = OO_PP_ID(OO_PKT_P(pkt));
+  return 1;
+}
+
+void __ci_ip_timer_set(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
+{
+  /* Enough to make the timer pending */
+  ts->link.next = OO_P_NULL;
+  ts->time = t;
+}
+
+unsigned ci_udp_checksum(const ci_ip4_hdr* ip, const ci_udp_hdr* udp,
+                         const ci_iovec *iov, int iovlen)
+{
+  return 0;
+}
+
+static int ip6_csum_iovlen;
+
+unsigned ci_ip6_udp_checksum(const ci_ip6_hdr* ip6, const ci_udp_hdr* udp,
+                             const ci_iovec *iov, int iovlen)
+{
+  ip6_csum_iovlen = iovlen;
+  return udp->udp_check_be16;
+}
+
+
+/* Test fixtures */
+static void setup(int max_pkts)
+{
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  test_ni->packets = calloc(1, sizeof(*test_ni->packets));
+  *(ci_int32*) &test_ni->packets->n_pkts_allocated = N_PKTS;
+  test_pkt_set = calloc(N_PKTS, CI_CFG_PKT_BUF_SIZE);
+  test_ni->pkt_bufs = (ci_pkt_bufs*) &test_pkt_set;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  NI_OPTS(test_ni).ip_reasm_max_pkts = max_pkts;
+  NI_CONF(test_ni).tconst_ip_reasm = 100;
+
+  for( i = 0; i < N_PKTS; ++i ) {
+    ci_ip_pkt_fmt* pkt = (ci_ip_pkt_fmt*) (test_pkt_set +
+                                           i * CI_CFG_PKT_BUF_SIZE);
+    OO_PKT_PP_INIT(pkt, i);
+    freed[i] = 0;
+  }
+  delivered = NULL;
+  n_delivered = 0;
+  n_to_kernel = 0;
+  kernel_accepts = 1;
+
+  ci_ip_reasm_init(test_ni);
+}
+
+/* The timer wheel removes a timer before calling its handler. */
+static void fire_timer(void)
+{
+  ci_ip_timer* tid = &test_ni->state->reasm_tid;
+  ci_ip_timer_init(test_ni, tid, oo_ptr_to_statep(test_ni, tid), "rsmt");
+  ci_ip_reasm_timeout(test_ni);
+}
+
+static void teardown(void)
+{
+  free(test_pkt_set);
+  free(test_ni->packets);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+static ci_uint8 datagram_byte(int id, int i)
+{
+  return id * 31 + i;
+}
+
+/* Builds fragment [frag] of the datagram with IP id [id] in packet
+ * [pkt_id]. */
+static ci_ip_pkt_fmt* make_frag4(int pkt_id, int id, int frag)
+{
+  ci_ip_pkt_fmt* pkt = PKT(test_ni, pkt_id);
+  ci_ip4_hdr* ip;
+  ci_uint8* payload;
+  int i, offset = frag * FRAG_LEN;
+
+  pkt->refcount = 1;
+  pkt->n_buffers = 1;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->flags = CI_PKT_FLAG_RX;
+  pkt->pkt_start_off = 0;
+  pkt->pkt_eth_payload_off = ETH_LEN;
+  pkt->pay_len = ETH_LEN + sizeof(ci_ip4_hdr) + FRAG_LEN;
+
+  ip = oo_ip_hdr(pkt);
+  memset(ip, 0, sizeof(*ip));
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_tot_len_be16 = CI_BSWAP_BE16(sizeof(*ip) + FRAG_LEN);
+  ip->ip_id_be16 = CI_BSWAP_BE16(id);
+  ip->ip_frag_off_be16 = CI_BSWAP_BE16(offset >> 3);
+  if( offset + FRAG_LEN < DGRAM_LEN )
+    ip->ip_frag_off_be16 |= CI_IP4_FRAG_MORE;
+  ip->ip_protocol = IPPROTO_UDP;
+  ip->ip_saddr_be32 = CI_BSWAPC_BE32(0x0a000001);
+  ip->ip_daddr_be32 = CI_BSWAPC_BE32(0x0a000002);
+
+  payload = (ci_uint8*) (ip + 1);
+  for( i = 0; i < FRAG_LEN; ++i )
+    payload[i] = datagram_byte(id, offset + i);
+  if( frag == 0 ) {
+    ci_udp_hdr* udp = (ci_udp_hdr*) payload;
+    udp->udp_source_be16 = CI_BSWAPC_BE16(1234);
+    udp->udp_dest_be16 = CI_BSWAPC_BE16(5678);
+    udp->udp_len_be16 = CI_BSWAP_BE16(DGRAM_LEN);
+    udp->udp_check_be16 = 0;
+  }
+  return pkt;
+}
+
+#if CI_CFG_IPV6
+static ci_ip_pkt_fmt* make_frag6(int pkt_id, int id, int frag)
+{
+  ci_ip_pkt_fmt* pkt = PKT(test_ni, pkt_id);
+  ci_ip6_hdr* ip6;
+  ci_ip6_frag_hdr* fh;
+  ci_uint8* payload;
+  int i, offset = frag * FRAG_LEN;
+
+  pkt->refcount = 1;
+  pkt->n_buffers = 1;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->flags = CI_PKT_FLAG_RX | CI_PKT_FLAG_IS_IP6;
+  pkt->pkt_start_off = 0;
+  pkt->pkt_eth_payload_off = ETH_LEN;
+  pkt->pay_len = ETH_LEN + sizeof(*ip6) + sizeof(*fh) + FRAG_LEN;
+  memset(PKT_START(pkt), 0xee, ETH_LEN);
+
+  ip6 = oo_ip6_hdr(pkt);
+  memset(ip6, 0, sizeof(*ip6));
+  ip6->prio_version = 6 << 4;
+  ip6->payload_len = CI_BSWAP_BE16(sizeof(*fh) + FRAG_LEN);
+  ip6->next_hdr = CI_NEXTHDR_FRAGMENT;
+  ip6->saddr[15] = 1;
+  ip6->daddr[15] = 2;
+
+  fh = (ci_ip6_frag_hdr*) (ip6 + 1);
+  ci_ip6_frag_hdr_init(fh, IPPROTO_UDP, offset,
+                       offset + FRAG_LEN < DGRAM_LEN, CI_BSWAP_BE32(id));
+
+  payload = (ci_uint8*) (fh + 1);
+  for( i = 0; i < FRAG_LEN; ++i )
+    payload[i] = datagram_byte(id, offset + i);
+  if( frag == 0 ) {
+    ci_udp_hdr* udp = (ci_udp_hdr*) payload;
+    udp->udp_len_be16 = CI_BSWAP_BE16(DGRAM_LEN);
+    udp->udp_check_be16 = CI_BSWAPC_BE16(0x1234);
+  }
+  return pkt;
+}
+#endif
+
+/* Checks that the delivered chain of buffers holds the datagram [id]. */
+static void check_delivered_data(int id)
+{
+  ci_ip_pkt_fmt* frag = delivered;
+  ci_uint8* udp = (ci_uint8*) oo_offbuf_ptr(&delivered->buf);
+  int off = 0, i;
+
+  CHECK(n_delivered, ==, 1);
+  CHECK(delivered_paylen, ==, DGRAM_LEN);
+  CHECK(delivered->n_buffers, ==, DGRAM_LEN / FRAG_LEN);
+  CHECK_TRUE(delivered->rx_flags & CI_PKT_RX_FLAG_REASSEMBLED);
+  CHECK(CI_BSWAP_BE16(((ci_udp_hdr*) udp)->udp_len_be16), ==, DGRAM_LEN);
+
+  while( 1 ) {
+    ci_uint8* p = (ci_uint8*) oo_offbuf_ptr(&frag->buf);
+    for( i = 0; i < oo_offbuf_left(&frag->buf); ++i, ++off )
+      if( off >= sizeof(ci_udp_hdr) )
+        CHECK(p[i], ==, datagram_byte(id, off));
+    if( OO_PP_IS_NULL(frag->frag_next) )
+      break;
+    frag = PKT(test_ni, frag->frag_next);
+  }
+  CHECK(off, ==, DGRAM_LEN);
+}
+
+static void check_delivered4(int id)
+{
+  ci_ip4_hdr* ip = oo_ip_hdr(delivered);
+
+  check_delivered_data(id);
+  CHECK(delivered->pay_len, ==, ETH_LEN + sizeof(*ip) + DGRAM_LEN);
+  CHECK(CI_BSWAP_BE16(ip->ip_tot_len_be16), ==, sizeof(*ip) + DGRAM_LEN);
+  CHECK(ip->ip_frag_off_be16 & (CI_IP4_OFFSET_MASK | CI_IP4_FRAG_MORE),
+        ==, 0);
+}
+
+
+/* Fragments arriving in order are delivered once the last arrives. */
+static void test_ip_reasm_in_order(void)
+{
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 7, 1));
+  CHECK(n_delivered, ==, 0);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 2);
+  ci_ip_reasm_rx(test_ni, make_frag4(2, 7, 2));
+
+  check_delivered4(7);
+  CHECK(delivered, ==, PKT(test_ni, 0));
+  CHECK(test_ni->state->reasm_n_pkts, ==, 0);
+  CHECK(test_ni->state->stats.ip_reasm_frags, ==, 3);
+  CHECK(test_ni->state->stats.ip_reasm_ok, ==, 1);
+
+  teardown();
+}
+
+/* Fragments arriving in any order are chained in order of offset. */
+static void test_ip_reasm_out_of_order(void)
+{
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 2));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 7, 0));
+  CHECK(n_delivered, ==, 0);
+  ci_ip_reasm_rx(test_ni, make_frag4(2, 7, 1));
+
+  check_delivered4(7);
+  CHECK(delivered, ==, PKT(test_ni, 1));
+  CHECK(OO_PP_ID(delivered->frag_next), ==, 2);
+  CHECK(test_ni->state->stats.ip_reasm_ok, ==, 1);
+
+  teardown();
+}
+
+/* Fragments of different datagrams are kept apart. */
+static void test_ip_reasm_interleaved(void)
+{
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 1));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 8, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(2, 8, 2));
+  ci_ip_reasm_rx(test_ni, make_frag4(3, 7, 2));
+  ci_ip_reasm_rx(test_ni, make_frag4(4, 8, 1));
+  check_delivered4(8);
+
+  n_delivered = 0;
+  ci_ip_reasm_rx(test_ni, make_frag4(5, 7, 0));
+  check_delivered4(7);
+  CHECK(test_ni->state->stats.ip_reasm_ok, ==, 2);
+
+  teardown();
+}
+
+/* An exact duplicate is dropped without affecting reassembly. */
+static void test_ip_reasm_duplicate(void)
+{
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 1));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 7, 1));
+  CHECK(freed[1], ==, 1);
+  CHECK(freed[0], ==, 0);
+  ci_ip_reasm_rx(test_ni, make_frag4(2, 7, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(3, 7, 2));
+
+  check_delivered4(7);
+  CHECK(test_ni->state->stats.ip_reasm_drops, ==, 1);
+
+  teardown();
+}
+
+/* An overlapping fragment discards the whole datagram. */
+static void test_ip_reasm_overlap(void)
+{
+  ci_ip_pkt_fmt* pkt;
+  ci_ip4_hdr* ip;
+
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 7, 2));
+
+  /* Second fragment starting 8 bytes early */
+  pkt = make_frag4(2, 7, 1);
+  ip = oo_ip_hdr(pkt);
+  ip->ip_frag_off_be16 = CI_IP4_FRAG_MORE | CI_BSWAP_BE16((FRAG_LEN - 8) >> 3);
+  ci_ip_reasm_rx(test_ni, pkt);
+
+  CHECK(n_delivered, ==, 0);
+  CHECK(freed[0], ==, 1);
+  CHECK(freed[1], ==, 1);
+  CHECK(freed[2], ==, 1);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 0);
+  CHECK(test_ni->state->stats.ip_reasm_overlaps, ==, 1);
+
+  /* The real second fragment no longer completes anything */
+  ci_ip_reasm_rx(test_ni, make_frag4(3, 7, 1));
+  CHECK(n_delivered, ==, 0);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 1);
+
+  teardown();
+}
+
+/* Incomplete datagrams are discarded when they expire. */
+static void test_ip_reasm_timeout(void)
+{
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 0));
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks += 50;
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 8, 0));
+  CHECK(test_ni->state->reasm_tid.time, ==, 100);
+
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks += 50;
+  fire_timer();
+  CHECK(freed[0], ==, 1);
+  CHECK(freed[1], ==, 0);
+  CHECK(test_ni->state->reasm_tid.time, ==, 150);
+  CHECK(test_ni->state->stats.ip_reasm_timeouts, ==, 1);
+
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks += 50;
+  fire_timer();
+  CHECK(freed[1], ==, 1);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 0);
+  CHECK(test_ni->state->stats.ip_reasm_timeouts, ==, 2);
+
+  teardown();
+}
+
+#if CI_CFG_IPV6
+/* The IPv6 fragment header is removed from the reassembled datagram. */
+static void test_ip_reasm_ip6(void)
+{
+  ci_uint8 eth[ETH_LEN];
+  ci_ip6_hdr* ip6;
+
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag6(0, 7, 1));
+  ci_ip_reasm_rx(test_ni, make_frag6(1, 7, 2));
+  ci_ip_reasm_rx(test_ni, make_frag6(2, 7, 0));
+
+  check_delivered_data(7);
+  CHECK(delivered, ==, PKT(test_ni, 2));
+  CHECK(ip6_csum_iovlen, ==, 3);
+  CHECK(delivered->pkt_start_off, ==, sizeof(ci_ip6_frag_hdr));
+  CHECK(delivered->pay_len, ==, ETH_LEN + sizeof(*ip6) + DGRAM_LEN);
+  memset(eth, 0xee, sizeof(eth));
+  CHECK_MEM(PKT_START(delivered), eth, sizeof(eth));
+  ip6 = oo_ip6_hdr(delivered);
+  CHECK((char*) (ip6 + 1), ==, oo_offbuf_ptr(&delivered->buf));
+  CHECK(ip6->next_hdr, ==, IPPROTO_UDP);
+  CHECK(CI_BSWAP_BE16(ip6->payload_len), ==, DGRAM_LEN);
+  CHECK(ip6->saddr[15], ==, 1);
+  CHECK(ip6->daddr[15], ==, 2);
+
+  teardown();
+}
+#endif
+
+/* The oldest datagram is discarded when too many fragments are held. */
+static void test_ip_reasm_max_pkts(void)
+{
+  setup(2);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 0));
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks += 10;
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 8, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(2, 8, 1));
+  CHECK(freed[0], ==, 1);
+  CHECK(test_ni->state->stats.ip_reasm_evictions, ==, 1);
+
+  /* Completing a datagram needs its fragments under the limit. */
+  ci_ip_reasm_rx(test_ni, make_frag4(3, 8, 2));
+  CHECK(n_delivered, ==, 0);
+  CHECK(freed[1], ==, 1);
+  CHECK(freed[2], ==, 1);
+  CHECK(freed[3], ==, 1);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 0);
+
+  teardown();
+}
+
+/* A fragment scattered over several buffers goes to the kernel, with every
+ * other fragment of its datagram until the datagram expires. */
+static void test_ip_reasm_scattered(void)
+{
+  ci_ip_pkt_fmt* pkt;
+
+  setup(128);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(0, 7, 0));
+  ci_ip_reasm_rx(test_ni, make_frag4(1, 8, 0));
+  pkt = make_frag4(2, 7, 1);
+  pkt->n_buffers = 2;
+  ci_ip_reasm_rx(test_ni, pkt);
+  CHECK(n_to_kernel, ==, 2);
+  CHECK(to_kernel[0], ==, 0);
+  CHECK(to_kernel[1], ==, 2);
+  CHECK(freed[0], ==, 0);
+  CHECK(freed[2], ==, 0);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 1);
+
+  ci_ip_reasm_rx(test_ni, make_frag4(3, 7, 2));
+  CHECK(n_to_kernel, ==, 3);
+  CHECK(to_kernel[2], ==, 3);
+  CHECK(test_ni->state->stats.ip_reasm_to_kernel, ==, 3);
+  CHECK(test_ni->state->stats.ip_reasm_drops, ==, 0);
+
+  /* Other datagrams are reassembled as usual. */
+  ci_ip_reasm_rx(test_ni, make_frag4(4, 8, 1));
+  ci_ip_reasm_rx(test_ni, make_frag4(5, 8, 2));
+  check_delivered4(8);
+  CHECK(n_to_kernel, ==, 3);
+
+  /* Once the entry expires the id is reassembled here again. */
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks += 100;
+  fire_timer();
+  CHECK(test_ni->state->stats.ip_reasm_timeouts, ==, 0);
+  ci_ip_reasm_rx(test_ni, make_frag4(6, 7, 0));
+  CHECK(n_to_kernel, ==, 3);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 1);
+
+  /* A scattered first fragment is released if the kernel cannot take it,
+   * and the rest of its datagram follows it. */
+  kernel_accepts = 0;
+  pkt = make_frag4(7, 9, 0);
+  pkt->n_buffers = 3;
+  ci_ip_reasm_rx(test_ni, pkt);
+  CHECK(freed[7], ==, 1);
+  ci_ip_reasm_rx(test_ni, make_frag4(8, 9, 1));
+  CHECK(freed[8], ==, 1);
+  CHECK(test_ni->state->reasm_n_pkts, ==, 1);
+  CHECK(test_ni->state->stats.ip_reasm_to_kernel, ==, 5);
+
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_ip_reasm_in_order);
+  TEST_RUN(test_ip_reasm_out_of_order);
+  TEST_RUN(test_ip_reasm_interleaved);
+  TEST_RUN(test_ip_reasm_duplicate);
+  TEST_RUN(test_ip_reasm_overlap);
+  TEST_RUN(test_ip_reasm_timeout);
+#if CI_CFG_IPV6
+  TEST_RUN(test_ip_reasm_ip6);
+#endif
+  TEST_RUN(test_ip_reasm_max_pkts);
+  TEST_RUN(test_ip_reasm_scattered);
+  TEST_END();
+}
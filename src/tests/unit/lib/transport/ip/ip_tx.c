@@ -0,0 +1,192 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <cplane/cplane.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#if CI_CFG_TCP_REPLY_CACHE_SIZE
+
+/* fwd table rows, of which the route lookup always finds ROUTE_ROW */
+#define N_ROWS 4
+#define ROUTE_ROW 2
+
+static ci_netif* test_ni;
+static struct oo_cplane_handle* test_cp;
+static struct cp_fwd_row* test_rows;
+
+static int n_retrieve;
+static ci_uint32 route_encap;
+static cicpos_retrieve_rc_t route_status;
+
+/* Dependencies */
+
+/* Each lookup returns a route with a distinct MTU, so that a result can be
+ * matched with the lookup which produced it. */
+void cicp_user_retrieve(ci_netif* ni, ci_ip_cached_hdrs* ipcache,
+                        const struct oo_sock_cplane* sock_cp)
+{
+  CHECK(ni, ==, test_ni);
+  ++n_retrieve;
+  ipcache->status = route_status;
+  ipcache->mtu = 1000 + n_retrieve;
+  ipcache->encap.type = route_encap;
+  ipcache->fwd_ver.id = ROUTE_ROW;
+  ipcache->fwd_ver.version = test_rows[ROUTE_ROW].version;
+  ipcache->fwd_ver_init_net.id = CICP_MAC_ROWID_UNUSED;
+}
+
+
+/* Test fixtures */
+static void setup(void)
+{
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+
+  test_cp = calloc(1, sizeof(*test_cp));
+  test_rows = calloc(N_ROWS, sizeof(*test_rows));
+  test_cp->mib[0].fwd_table.rows = test_rows;
+  test_cp->mib[0].fwd_table.rw_rows = calloc(N_ROWS,
+                                             sizeof(struct cp_fwd_rw_row));
+  test_cp->mib[0].fwd_table.mask = N_ROWS - 1;
+  test_rows[ROUTE_ROW].version = 6;
+  test_ni->cplane = test_cp;
+
+  ci_tcp_reply_cache_init(test_ni);
+  n_retrieve = 0;
+  route_encap = CICP_LLAP_TYPE_NONE;
+  route_status = retrrc_success;
+}
+
+static void teardown(void)
+{
+  free(test_cp->mib[0].fwd_table.rw_rows);
+  free(test_rows);
+  free(test_cp);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+/* Looks up the reply route from the listening address [lport] to [raddr]
+ * and [rport], and returns the MTU of the route found. */
+static int retrieve(ci_uint32 raddr, ci_uint16 lport, ci_uint16 rport)
+{
+  struct oo_sock_cplane sock_cp;
+  ci_ip_cached_hdrs ipcache;
+
+  memset(&sock_cp, 0, sizeof(sock_cp));
+  sock_cp.laddr = CI_ADDR_FROM_IP4(CI_BSWAPC_BE32(0x0a000001));
+  sock_cp.lport_be16 = CI_BSWAP_BE16(lport);
+  sock_cp.sock_cp_flags = OO_SCP_BOUND_ADDR;
+
+  ci_ip_cache_init(&ipcache, AF_INET);
+  ipcache.ipx.ip4.ip_daddr_be32 = CI_BSWAP_BE32(raddr);
+  ipcache.ipx.ip4.ip_protocol = IPPROTO_TCP;
+  ipcache.dport_be16 = CI_BSWAP_BE16(rport);
+
+  ci_tcp_reply_retrieve(test_ni, &ipcache, &sock_cp);
+  CHECK(ipcache.status, ==, route_status);
+  CHECK(CI_BSWAP_BE32(ipcache.ipx.ip4.ip_daddr_be32), ==, raddr);
+  CHECK(CI_BSWAP_BE16(ipcache.dport_be16), ==, rport);
+  CHECK(ipcache.ipx.ip4.ip_protocol, ==, IPPROTO_TCP);
+  return ipcache.mtu;
+}
+
+
+/* Replies to the same remote address from the same listening socket reuse
+ * the route, whatever the remote port. */
+static void test_reply_cache_hit(void)
+{
+  int mtu, got;
+
+  setup();
+  mtu = retrieve(0xc0a80001, 80, 1000);
+  CHECK(n_retrieve, ==, 1);
+  CHECK(test_ni->state->stats.tcp_reply_cache_misses, ==, 1);
+
+  got = retrieve(0xc0a80001, 80, 1001);
+  CHECK(got, ==, mtu);
+  got = retrieve(0xc0a80001, 80, 1002);
+  CHECK(got, ==, mtu);
+  CHECK(n_retrieve, ==, 1);
+  CHECK(test_ni->state->stats.tcp_reply_cache_hits, ==, 2);
+
+  /* A different remote address or listening port is looked up. */
+  got = retrieve(0xc0a80002, 80, 1000);
+  CHECK(got, !=, mtu);
+  CHECK(n_retrieve, ==, 2);
+  got = retrieve(0xc0a80001, 81, 1000);
+  CHECK(got, !=, mtu);
+  CHECK(n_retrieve, ==, 3);
+  teardown();
+}
+
+/* A change to the fwd table row of a cached route invalidates it. */
+static void test_reply_cache_cplane_version(void)
+{
+  int mtu, mtu2, got;
+
+  setup();
+  mtu = retrieve(0xc0a80001, 80, 1000);
+  got = retrieve(0xc0a80001, 80, 1000);
+  CHECK(got, ==, mtu);
+  CHECK(n_retrieve, ==, 1);
+
+  test_rows[ROUTE_ROW].version += 2;
+  mtu2 = retrieve(0xc0a80001, 80, 1000);
+  CHECK(mtu2, !=, mtu);
+  CHECK(n_retrieve, ==, 2);
+  CHECK(test_ni->state->stats.tcp_reply_cache_misses, ==, 2);
+
+  /* The new route is cached in turn. */
+  got = retrieve(0xc0a80001, 80, 1000);
+  CHECK(got, ==, mtu2);
+  CHECK(n_retrieve, ==, 2);
+  teardown();
+}
+
+/* Failed lookups, and routes over bonds which hash on the packet, are
+ * never cached. */
+static void test_reply_cache_uncached(void)
+{
+  setup();
+  route_status = retrrc_noroute;
+  retrieve(0xc0a80001, 80, 1000);
+  retrieve(0xc0a80001, 80, 1000);
+  CHECK(n_retrieve, ==, 2);
+
+  route_status = retrrc_success;
+#if CI_CFG_TEAMING
+  route_encap = CICP_LLAP_TYPE_BOND | CICP_LLAP_TYPE_XMIT_HASH_LAYER34;
+  retrieve(0xc0a80001, 80, 1000);
+  retrieve(0xc0a80001, 80, 1001);
+  CHECK(n_retrieve, ==, 4);
+  route_encap = CICP_LLAP_TYPE_NONE;
+#endif
+  n_retrieve = 0;
+  retrieve(0xc0a80001, 80, 1000);
+  retrieve(0xc0a80001, 80, 1000);
+  CHECK(n_retrieve, ==, 1);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_reply_cache_hit);
+  TEST_RUN(test_reply_cache_cplane_version);
+  TEST_RUN(test_reply_cache_uncached);
+  TEST_END();
+}
+
+#else
+
+int main(void)
+{
+  TEST_END();
+}
+
+#endif
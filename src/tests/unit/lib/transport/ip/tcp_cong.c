@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define MSS 1000
+#define RTT_MS 100
+
+struct test_state {
+  ci_netif_state ns;
+  ci_tcp_state ts;
+};
+
+static ci_netif* test_ni;
+static ci_tcp_state* test_ts;
+static struct test_state* test_state;
+static const ci_tcp_cc_ops* cubic;
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+
+/* Test fixtures */
+
+/* One tick per millisecond. */
+static void set_time_ms(ci_iptime_t ms)
+{
+  IPTIMER_STATE(test_ni)->ci_ip_time_real_ticks = ms;
+}
+
+static void setup(void)
+{
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_state = calloc(1, sizeof(*test_state));
+  test_ni->state = &test_state->ns;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  IPTIMER_STATE(test_ni)->ci_ip_time_ms2tick_fxp = 1ull << 32;
+  set_time_ms(1000);
+
+  test_ts = &test_state->ts;
+  test_ts->s.b.state = CI_TCP_ESTABLISHED;
+  test_ts->outgoing_hdrs_len = sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr);
+  test_ts->eff_mss = MSS;
+  test_ts->sa = RTT_MS << 3;
+
+  cubic = ci_tcp_cc_algo(CI_TCP_CC_CUBIC);
+  ci_tcp_cc_select(test_ni, test_ts, CI_TCP_CC_CUBIC);
+}
+
+static void teardown(void)
+{
+  free(test_state);
+  free(test_ni);
+}
+
+static void set_inflight(ci_uint32 bytes)
+{
+  test_ts->snd_una = 5000;
+  test_ts->snd_nxt = test_ts->snd_una + bytes;
+}
+
+
+/* The cube root rounds down, over the whole range of its input. */
+static void test_cubic_cbrt(void)
+{
+  ci_uint64 n;
+
+  CHECK(ci_tcp_cubic_cbrt(0), ==, 0);
+  CHECK(ci_tcp_cubic_cbrt(1), ==, 1);
+  CHECK(ci_tcp_cubic_cbrt(7), ==, 1);
+  CHECK(ci_tcp_cubic_cbrt(8), ==, 2);
+  CHECK(ci_tcp_cubic_cbrt(26), ==, 2);
+  CHECK(ci_tcp_cubic_cbrt(27), ==, 3);
+  CHECK(ci_tcp_cubic_cbrt(1000000000ull), ==, 1000);
+
+  for( n = 2; n < (1u << 21); n = n * 3 / 2 + 1 ) {
+    CHECK(ci_tcp_cubic_cbrt(n * n * n), ==, n);
+    CHECK(ci_tcp_cubic_cbrt(n * n * n - 1), ==, n - 1);
+  }
+
+  /* The largest input allowed: 2^63 is the cube of 2^21. */
+  CHECK(ci_tcp_cubic_cbrt((1ull << 63) - 1), ==, (1u << 21) - 1);
+}
+
+/* At the start of congestion avoidance after a reduction, K is the time
+ * to climb back to W_max: cbrt((W_max - cwnd) / C). */
+static void test_cubic_epoch_start(void)
+{
+  setup();
+  test_ts->cubic_w_max = 100 * MSS;
+  test_ts->cwnd = 70 * MSS;
+
+  cubic->cong_avoid(test_ni, test_ts);
+  CHECK(test_ts->cubic_epoch_start, ==, 1000);
+  CHECK(test_ts->cubic_cwnd_epoch, ==, 70 * MSS);
+  CHECK(test_ts->cubic_origin, ==, 100 * MSS);
+  /* cbrt(30 segments * 2.5e9 ms^3/segment) = 4217.2ms */
+  CHECK(test_ts->cubic_k, ==, 4217);
+
+  /* Above W_max there is nothing to climb back to. */
+  teardown();
+  setup();
+  test_ts->cubic_w_max = 50 * MSS;
+  test_ts->cwnd = 70 * MSS;
+  cubic->cong_avoid(test_ni, test_ts);
+  CHECK(test_ts->cubic_k, ==, 0);
+  CHECK(test_ts->cubic_origin, ==, 70 * MSS);
+  teardown();
+}
+
+/* cwnd grows by a segment for each share of cwnd acked needed to reach
+ * the curve's value one RTT ahead. */
+static void test_cubic_cong_avoid(void)
+{
+  setup();
+  test_ts->cubic_w_max = 100 * MSS;
+  test_ts->cwnd = 70 * MSS;
+  cubic->cong_avoid(test_ni, test_ts);
+  CHECK(test_ts->cwnd, ==, 70 * MSS);
+
+  /* One RTT short of K the target is W_max, 30 segments away, so a
+   * segment is added for every 70/30 segments acked. */
+  set_time_ms(1000 + 4217 - RTT_MS);
+  test_ts->bytes_acked = 7 * MSS;
+  cubic->cong_avoid(test_ni, test_ts);
+  CHECK(test_ts->cwnd, ==, 73 * MSS);
+  CHECK(test_ts->bytes_acked, ==, 7 * MSS - 3 * 2333);
+
+  /* Close to the plateau the curve is flat, and growth follows the
+   * TCP-friendly estimate of 9/17 segment per RTT instead. */
+  teardown();
+  setup();
+  test_ts->cubic_w_max = 100 * MSS;
+  test_ts->cwnd = 99 * MSS;
+  cubic->cong_avoid(test_ni, test_ts);
+  set_time_ms(1000 + 1700);
+  test_ts->bytes_acked = 99 * MSS;
+  cubic->cong_avoid(test_ni, test_ts);
+  /* The estimate is 99 + 9 segments. */
+  CHECK(test_ts->cwnd, ==, 108 * MSS);
+  CHECK(test_ts->bytes_acked, ==, 0);
+  teardown();
+}
+
+/* On loss, ssthresh is beta = 0.7 of what was in flight, and W_max is
+ * remembered, lowered further when the window is shrinking. */
+static void test_cubic_ssthresh(void)
+{
+  ci_uint32 ssthresh;
+
+  setup();
+  test_ts->cwnd = 100 * MSS;
+  set_inflight(100 * MSS);
+  test_ts->cubic_epoch_start = 1000;
+  ssthresh = cubic->ssthresh(test_ni, test_ts);
+  CHECK(ssthresh, ==, 70019);
+  CHECK(test_ts->cubic_w_max, ==, 100 * MSS);
+  CHECK(test_ts->cubic_epoch_start, ==, 0);
+
+  /* Fast convergence: W_max = cwnd * (1 + beta) / 2 */
+  test_ts->cwnd = 80 * MSS;
+  set_inflight(80 * MSS);
+  ssthresh = cubic->ssthresh(test_ni, test_ts);
+  CHECK(ssthresh, ==, 56015);
+  CHECK(test_ts->cubic_w_max, ==, 68007);
+
+  /* cwnd which isn't being used doesn't count. */
+  test_ts->cubic_w_max = 0;
+  test_ts->cwnd = 100 * MSS;
+  set_inflight(50 * MSS);
+  ssthresh = cubic->ssthresh(test_ni, test_ts);
+  CHECK(ssthresh, ==, 35009);
+  CHECK(test_ts->cubic_w_max, ==, 50 * MSS);
+
+  /* Never below two segments. */
+  test_ts->cwnd = MSS;
+  set_inflight(MSS);
+  ssthresh = cubic->ssthresh(test_ni, test_ts);
+  CHECK(ssthresh, ==, 2 * MSS);
+  teardown();
+}
+
+/* An out of range algorithm in the shared state falls back to reno. */
+static void test_cc_algo_bounds(void)
+{
+  CHECK(ci_tcp_cc_algo(CI_TCP_CC_CUBIC), ==, cubic);
+  CHECK(ci_tcp_cc_algo(CI_TCP_CC_N), ==, ci_tcp_cc_algo(CI_TCP_CC_RENO));
+  CHECK(ci_tcp_cc_algo(~0u), ==, ci_tcp_cc_algo(CI_TCP_CC_RENO));
+}
+
+int main(void)
+{
+  TEST_RUN(test_cubic_cbrt);
+  TEST_RUN(test_cubic_epoch_start);
+  TEST_RUN(test_cubic_cong_avoid);
+  TEST_RUN(test_cubic_ssthresh);
+  TEST_RUN(test_cc_algo_bounds);
+  TEST_END();
+}
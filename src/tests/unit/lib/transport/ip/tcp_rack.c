@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_PKTS 4
+#define MSS 1000
+
+/* One microsecond per cycle, and 1024 microseconds per tick. */
+#define FRC2US   0
+#define FRC2TICK 10
+
+/* The timer links must be in the shared state. */
+struct test_state {
+  ci_netif_state ns;
+  ci_tcp_state ts;
+  struct oo_p_dllink timers;
+};
+
+static ci_netif* test_ni;
+static ci_tcp_state* test_ts;
+static struct test_state* test_state;
+static char* test_pkt_set;
+
+static int n_enter_fast_recovery;
+static int n_retrans_recover;
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+void __ci_ip_timer_set(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
+{
+  ts->time = t;
+  oo_p_dllink_add(ni, oo_p_dllink_ptr(ni, &test_state->timers),
+                  oo_p_dllink_statep(ni, ts->statep));
+}
+
+int ci_tcp_maybe_enter_fast_recovery(ci_netif* ni, ci_tcp_state* ts)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(ts, ==, test_ts);
+  ++n_enter_fast_recovery;
+  return 0;
+}
+
+void ci_tcp_retrans_recover(ci_netif* ni, ci_tcp_state* ts,
+                            int force_retrans_first)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(ts, ==, test_ts);
+  CHECK(force_retrans_first, ==, 0);
+  ++n_retrans_recover;
+}
+
+
+/* Test fixtures */
+static void set_time_us(ci_uint64 us)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(test_ni);
+  its->frc = us << FRC2US;
+  its->ci_ip_time_real_ticks = its->frc >> FRC2TICK;
+}
+
+static void setup(void)
+{
+  ci_ip_timer_state* its;
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_state = calloc(1, sizeof(*test_state));
+  test_ni->state = &test_state->ns;
+  test_ni->packets = calloc(1, sizeof(*test_ni->packets));
+  *(ci_int32*) &test_ni->packets->n_pkts_allocated = N_PKTS;
+  test_pkt_set = calloc(N_PKTS, CI_CFG_PKT_BUF_SIZE);
+  test_ni->pkt_bufs = (ci_pkt_bufs*) &test_pkt_set;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  NI_OPTS(test_ni).tcp_rack = 1;
+
+  its = IPTIMER_STATE(test_ni);
+  its->ci_ip_time_frc2us = FRC2US;
+  its->ci_ip_time_frc2tick = FRC2TICK;
+  set_time_us(0);
+
+  for( i = 0; i < N_PKTS; ++i )
+    OO_PKT_PP_INIT(PKT(test_ni, i), i);
+
+  test_ts = &test_state->ts;
+  test_ts->s.b.state = CI_TCP_ESTABLISHED;
+  test_ts->tcpflags = CI_TCPT_FLAG_SACK;
+  test_ts->congstate = CI_TCP_CONG_OPEN;
+  ci_ip_queue_init(&test_ts->retrans);
+  oo_p_dllink_init(test_ni, oo_p_dllink_ptr(test_ni, &test_state->timers));
+  ci_ip_timer_init(test_ni, &test_ts->rack_tid,
+                   oo_ptr_to_statep(test_ni, &test_ts->rack_tid), "rack");
+  ci_tcp_rack_init(test_ni, test_ts);
+
+  n_enter_fast_recovery = 0;
+  n_retrans_recover = 0;
+}
+
+static void teardown(void)
+{
+  free(test_pkt_set);
+  free(test_ni->packets);
+  free(test_state);
+  free(test_ni);
+}
+
+/* Puts segment [i] on the retransmit queue, sent at [xmit_us]. */
+static ci_ip_pkt_fmt* send_seg(int i, ci_uint32 xmit_us)
+{
+  ci_ip_pkt_fmt* pkt = PKT(test_ni, i);
+
+  pkt->flags = 0;
+  pkt->pf.tcp_tx.start_seq = i * MSS;
+  pkt->pf.tcp_tx.end_seq = (i + 1) * MSS;
+  pkt->pf.tcp_tx.xmit_time = xmit_us;
+  ci_ip_queue_enqueue(test_ni, &test_ts->retrans, pkt);
+  test_ts->snd_nxt = pkt->pf.tcp_tx.end_seq;
+  return pkt;
+}
+
+static void deliver(ci_ip_pkt_fmt* pkt, ci_uint32 now_us)
+{
+  set_time_us(now_us);
+  ci_tcp_rack_delivered(test_ni, test_ts, pkt);
+  pkt->flags |= CI_PKT_FLAG_RTQ_SACKED;
+}
+
+
+/* Deliveries give the RTT of the most recently sent segment, and one sent
+ * earlier than that being delivered later is reordering. */
+static void test_rack_delivered(void)
+{
+  ci_ip_pkt_fmt* a;
+  ci_ip_pkt_fmt* b;
+
+  setup();
+  a = send_seg(0, 100);
+  b = send_seg(1, 200);
+
+  deliver(b, 1200);
+  CHECK_TRUE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_SAMPLE);
+  CHECK(test_ts->rack_xmit_ts, ==, 200);
+  CHECK(test_ts->rack_end_seq, ==, 2 * MSS);
+  CHECK(test_ts->rack_rtt, ==, 1000);
+  CHECK(test_ts->rack_min_rtt, ==, 1000);
+  CHECK_FALSE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER);
+
+  deliver(a, 1300);
+  CHECK_TRUE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER);
+  CHECK(test_ts->rack_xmit_ts, ==, 200);
+  CHECK(test_ts->rack_rtt, ==, 1000);
+
+  teardown();
+}
+
+/* Delivery of a retransmitted segment is ignored when it can't be told
+ * which transmission it was for. */
+static void test_rack_delivered_retrans(void)
+{
+  ci_ip_pkt_fmt* a;
+  ci_ip_pkt_fmt* b;
+  ci_ip_pkt_fmt* c;
+
+  setup();
+  a = send_seg(0, 0);
+  b = send_seg(1, 1000);
+  c = send_seg(2, 1500);
+
+  a->flags |= CI_PKT_FLAG_RTQ_RETRANS;
+  deliver(a, 1200);
+  CHECK_FALSE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_SAMPLE);
+
+  deliver(b, 1800);
+  CHECK(test_ts->rack_min_rtt, ==, 800);
+
+  /* Too soon after the retransmit to be for it. */
+  c->flags |= CI_PKT_FLAG_RTQ_RETRANS;
+  deliver(c, 2000);
+  CHECK(test_ts->rack_xmit_ts, ==, 1000);
+  CHECK(test_ts->rack_min_rtt, ==, 800);
+
+  teardown();
+}
+
+/* A segment is lost once it's been outstanding for the RTT of a segment
+ * sent after it plus the reordering window.  Until then the window timer
+ * is armed. */
+static void test_rack_is_lost(void)
+{
+  ci_ip_pkt_fmt* a;
+  ci_ip_pkt_fmt* b;
+
+  setup();
+  a = send_seg(0, 0);
+  b = send_seg(1, 100);
+  CHECK_FALSE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+
+  /* RTT 1000us gives a window of 250us. */
+  deliver(b, 1100);
+  CHECK_FALSE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+  CHECK_TRUE(ci_ip_timer_pending(test_ni, &test_ts->rack_tid));
+  CHECK(test_ts->rack_tid.time, ==, ci_tcp_time_now(test_ni) + 1);
+
+  set_time_us(1249);
+  CHECK_FALSE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+  set_time_us(1250);
+  CHECK_TRUE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+
+  /* Without reordering, enough dupacks close the window. */
+  teardown();
+  setup();
+  a = send_seg(0, 0);
+  b = send_seg(1, 100);
+  deliver(b, 1100);
+  test_ts->dup_acks = ci_tcp_base_dupack_thresh(test_ts);
+  CHECK_TRUE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+
+  /* ... but not once reordering has been seen. */
+  test_ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+  CHECK_FALSE(ci_tcp_rack_is_lost(test_ni, test_ts, a));
+
+  teardown();
+}
+
+/* DSACKs widen the window once per round trip, and it shrinks back after
+ * enough recoveries without one. */
+static void test_rack_dsack(void)
+{
+  int i;
+
+  setup();
+  test_ts->snd_una = 0;
+  test_ts->snd_nxt = 4 * MSS;
+
+  ci_tcp_rack_dsack(test_ni, test_ts);
+  CHECK_TRUE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_REORDER);
+  CHECK(test_ts->rack_reo_wnd_mult, ==, 2);
+  ci_tcp_rack_dsack(test_ni, test_ts);
+  CHECK(test_ts->rack_reo_wnd_mult, ==, 2);
+
+  test_ts->snd_una = 4 * MSS;
+  test_ts->snd_nxt = 8 * MSS;
+  ci_tcp_rack_dsack(test_ni, test_ts);
+  CHECK(test_ts->rack_reo_wnd_mult, ==, 3);
+
+  for( i = 0; i < 15; ++i )
+    ci_tcp_rack_recovered(test_ni, test_ts);
+  CHECK(test_ts->rack_reo_wnd_mult, ==, 3);
+  ci_tcp_rack_recovered(test_ni, test_ts);
+  CHECK(test_ts->rack_reo_wnd_mult, ==, 1);
+
+  teardown();
+}
+
+/* Recovery waits for the head to be lost, remembering when the dupack
+ * threshold would not have waited. */
+static void test_rack_head_lost(void)
+{
+  ci_ip_pkt_fmt* b;
+
+  setup();
+  CHECK_FALSE(ci_tcp_rack_head_lost(test_ni, test_ts));
+
+  send_seg(0, 0);
+  b = send_seg(1, 100);
+  deliver(b, 1100);
+  test_ts->tcpflags |= CI_TCPT_FLAG_RACK_REORDER;
+  test_ts->dup_acks = ci_tcp_base_dupack_thresh(test_ts);
+  CHECK_FALSE(ci_tcp_rack_head_lost(test_ni, test_ts));
+  CHECK_TRUE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED);
+
+  set_time_us(1250);
+  CHECK_TRUE(ci_tcp_rack_head_lost(test_ni, test_ts));
+  CHECK_FALSE(test_ts->tcpflags & CI_TCPT_FLAG_RACK_DEFERRED);
+  CHECK(test_ni->state->stats.tcp_rack_recoveries, ==, 1);
+
+  teardown();
+}
+
+/* The window timer enters or continues recovery. */
+static void test_rack_timeout(void)
+{
+  setup();
+  ci_tcp_timeout_rack(test_ni, test_ts);
+  CHECK(test_ni->state->stats.tcp_rack_timeouts, ==, 0);
+
+  send_seg(0, 0);
+  ci_tcp_timeout_rack(test_ni, test_ts);
+  CHECK(n_enter_fast_recovery, ==, 1);
+
+  test_ts->congstate = CI_TCP_CONG_FAST_RECOV;
+  ci_tcp_timeout_rack(test_ni, test_ts);
+  CHECK(n_retrans_recover, ==, 1);
+
+  test_ts->congstate = CI_TCP_CONG_RTO_RECOV;
+  ci_tcp_timeout_rack(test_ni, test_ts);
+  CHECK(n_enter_fast_recovery, ==, 1);
+  CHECK(n_retrans_recover, ==, 1);
+  CHECK(test_ni->state->stats.tcp_rack_timeouts, ==, 3);
+
+  /* Nothing to do when disabled. */
+  NI_OPTS(test_ni).tcp_rack = 0;
+  test_ts->congstate = CI_TCP_CONG_OPEN;
+  ci_tcp_timeout_rack(test_ni, test_ts);
+  CHECK(n_enter_fast_recovery, ==, 1);
+
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_rack_delivered);
+  TEST_RUN(test_rack_delivered_retrans);
+  TEST_RUN(test_rack_is_lost);
+  TEST_RUN(test_rack_dsack);
+  TEST_RUN(test_rack_head_lost);
+  TEST_RUN(test_rack_timeout);
+  TEST_END();
+}
@@ -3,6 +3,7 @@
 
 /* Functions under test */
 #include <ci/internal/ip.h>
+#include "../../../../../lib/transport/ip/tcp_rx.h"
 
 /* Test infrastructure */
 #include "unit_test.h"
@@ -130,9 +131,100 @@ static void test_ci_tcp_handle_rx(void)
   STATE_FREE(tcp);
 }
 
+/* Forced ACKs for segments received in one poll */
+static int n_acks;
+static ci_ip_pkt_fmt* ack_pkt;
+
+ci_ip_pkt_fmt* ci_netif_pkt_alloc_slow(ci_netif* ni, int flags)
+{
+  return ack_pkt;
+}
+
+void ci_tcp_send_ack_rx(ci_netif* ni, ci_tcp_state* ts, ci_ip_pkt_fmt* pkt,
+                        int sock_locked, int update_wnd)
+{
+  CHECK(pkt, ==, ack_pkt);
+  ++n_acks;
+  ts->acks_pending = 0;
+}
+
+/* Handles the forced ACKs of [n] segments, as handle_rx_slow() does, and
+ * then ends the poll.  Returns the number of ACKs sent. */
+static int poll_forced_acks(ci_netif* ni, ci_tcp_state* ts, int n,
+                            int in_order)
+{
+  int i, was_forced;
+
+  n_acks = 0;
+  for( i = 0; i < n; ++i ) {
+    was_forced = TCP_ACK_FORCED(ts);
+    TCP_FORCE_ACK(ts);
+    ci_tcp_rx_forced_ack(ni, ts, in_order, was_forced, CI_TRUE);
+    ts->s.b.sb_flags |= CI_SB_FLAG_TCP_POST_POLL;
+  }
+  ci_tcp_rx_post_poll(ni, ts);
+  CHECK(ts->acks_pending, ==, 0);
+  return n_acks;
+}
+
+/* With EF_TCP_ACK_COALESCE, the ACKs forced by in-order segments in one
+ * poll are sent as one at the end of the poll.  Without it, and for
+ * out-of-order segments or TCP_NODELAY, each is sent at once. */
+static void test_ack_coalesce(void)
+{
+  ci_netif* netif = calloc(1, sizeof(*netif));
+  ci_netif_state* ns = calloc(1, sizeof(*ns));
+  ci_tcp_state* ts = calloc(1, sizeof(*ts));
+  int n;
+
+  netif->state = ns;
+  ns->lock.lock = CI_EPLOCK_LOCKED;
+  netif->packets = calloc(1, sizeof(*netif->packets) +
+                          sizeof(netif->packets->set[0]));
+  ack_pkt = calloc(1, CI_CFG_PKT_BUF_SIZE);
+  ts->s.b.state = CI_TCP_ESTABLISHED;
+  ts->local_peer = OO_SP_NULL;
+
+  NI_OPTS(netif).tcp_ack_coalesce = 0;
+  n = poll_forced_acks(netif, ts, 5, CI_TRUE);
+  CHECK(n, ==, 5);
+  CHECK(ns->stats.tcp_acks_deferred, ==, 0);
+
+  NI_OPTS(netif).tcp_ack_coalesce = 1;
+  n = poll_forced_acks(netif, ts, 5, CI_TRUE);
+  CHECK(n, ==, 1);
+  CHECK(ns->stats.tcp_acks_deferred, ==, 1);
+  CHECK(ns->stats.tcp_acks_coalesced, ==, 4);
+  n = poll_forced_acks(netif, ts, 1, CI_TRUE);
+  CHECK(n, ==, 1);
+  CHECK(ns->stats.tcp_acks_deferred, ==, 2);
+  CHECK(ns->stats.tcp_acks_coalesced, ==, 4);
+
+  /* The sender counts dupacks for out-of-order segments. */
+  n = poll_forced_acks(netif, ts, 3, CI_FALSE);
+  CHECK(n, ==, 3);
+
+  ts->s.s_aflags |= CI_SOCK_AFLAG_NODELAY;
+  n = poll_forced_acks(netif, ts, 3, CI_TRUE);
+  CHECK(n, ==, 3);
+  ts->s.s_aflags &=~ CI_SOCK_AFLAG_NODELAY;
+
+  ts->s.b.state = CI_TCP_CLOSE_WAIT;
+  n = poll_forced_acks(netif, ts, 2, CI_TRUE);
+  CHECK(n, ==, 2);
+  CHECK(ns->stats.tcp_acks_deferred, ==, 2);
+
+  free(ack_pkt);
+  free(netif->packets);
+  free(ts);
+  free(ns);
+  free(netif);
+}
+
 int main(void)
 {
   TEST_RUN(test_ci_tcp_handle_rx);
+  TEST_RUN(test_ack_coalesce);
   TEST_END();
 }
 
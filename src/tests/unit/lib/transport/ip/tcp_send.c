@@ -0,0 +1,511 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <onload/extensions_zc_hlrx.h>
+#include <onload/ul/per_thread.h>
+#include <linux/errqueue.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define N_PKTS 4
+#define MSS 1000
+#define HDR_LEN (sizeof(ci_ip4_hdr) + sizeof(ci_tcp_hdr))
+
+struct test_state {
+  ci_netif_state ns;
+  ci_tcp_state ts;
+};
+
+static ci_netif* test_ni;
+static ci_tcp_state* test_ts;
+static struct test_state* test_state;
+static ci_ip_pkt_fmt* test_pkt;
+static char* test_pkt_set;
+
+#define MAX_COOKIES 8
+static uint64_t unregistered[MAX_COOKIES];
+static int n_unregistered;
+
+/* Dependencies */
+__thread struct oo_per_thread oo_per_thread;
+
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+#if CI_CFG_IPV6
+void ci_ipcache_update_flowlabel(ci_netif* ni, ci_sock_cmn* s)
+{
+}
+#endif
+
+int ci_tcp_helper_zc_unregister_buffers(ci_netif* ni, uint64_t id)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(n_unregistered, <, MAX_COOKIES);
+  unregistered[n_unregistered++] = id;
+  return 0;
+}
+
+
+/* Test fixtures */
+static void setup(void)
+{
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_state = calloc(1, sizeof(*test_state));
+  test_ni->state = &test_state->ns;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  test_ni->packets = calloc(1, sizeof(*test_ni->packets));
+  *(ci_int32*) &test_ni->packets->n_pkts_allocated = N_PKTS;
+  test_pkt_set = calloc(N_PKTS, CI_CFG_PKT_BUF_SIZE);
+  test_ni->pkt_bufs = (ci_pkt_bufs*) &test_pkt_set;
+  for( i = 0; i < N_PKTS; ++i )
+    OO_PKT_PP_INIT(PKT(test_ni, i), i);
+
+  test_ts = &test_state->ts;
+  test_ts->s.b.state = CI_TCP_ESTABLISHED;
+  test_ts->s.domain = AF_INET;
+  test_ts->s.pkt.ether_type = CI_ETHERTYPE_IP;
+  test_ts->s.pkt.ether_offset = ETH_VLAN_HLEN;
+  test_ts->s.pkt.ipx.ip4.ip_ihl_version =
+    CI_IP4_IHL_VERSION(sizeof(ci_ip4_hdr));
+  CI_TCP_HDR_SET_LEN(TS_IPX_TCP(test_ts), sizeof(ci_tcp_hdr));
+  test_ts->local_peer = OO_SP_NULL;
+  test_ts->send_prequeue = OO_PP_ID_NULL;
+  test_ts->eff_mss = MSS;
+  test_ts->outgoing_hdrs_len = HDR_LEN;
+  test_ts->so_sndbuf_pkts = 100;
+  test_ts->s.so.sndbuf = 100 * MSS;
+  ci_ip_queue_init(&test_ts->send);
+  tcp_snd_nxt(test_ts) = 5000;
+  tcp_enq_nxt(test_ts) = 5000;
+
+  test_pkt = calloc(1, CI_CFG_PKT_BUF_SIZE);
+  test_pkt->pkt_start_off = PKT_START_OFF_BAD;
+  test_pkt->pkt_eth_payload_off = PKT_START_OFF_BAD;
+  n_unregistered = 0;
+}
+
+static void teardown(void)
+{
+  free(test_pkt);
+  free(test_pkt_set);
+  free(test_ni->packets);
+  free(test_state);
+  free(test_ni);
+}
+
+/* Queues [unsent] bytes on the sendq which have not yet been sent. */
+static void set_unsent(int unsent)
+{
+  tcp_enq_nxt(test_ts) = tcp_snd_nxt(test_ts) + unsent;
+  test_ts->send_in = (unsent + MSS - 1) / MSS;
+  test_ts->send_out = 0;
+}
+
+
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY)
+
+/* Adds the descriptor of a zero-copy send of [id] to the notification in
+ * [test_pkt].  A zero [cookie] means that the data was copied. */
+static void add_msg_zerocopy(ci_uint32 id, uint64_t cookie)
+{
+  struct ci_pkt_zc_header* zch = oo_tx_zc_header(test_pkt);
+  struct ci_pkt_zc_payload* zcp = (void*) ((char*) zch + zch->end);
+
+  memset(zcp, 0, oo_tx_zc_payload_size(test_ni));
+  zcp->is_remote = 1;
+  zcp->use_remote_cookie = 1;
+  zcp->is_msg_zerocopy = 1;
+  zcp->zerocopy_id = id;
+  zcp->remote.app_cookie = cookie;
+  zch->end += oo_tx_zc_payload_size(test_ni);
+  ++zch->segs;
+}
+
+struct test_cmsgs {
+  struct msghdr msg;
+  char buf[512];
+  int msg_flags;
+  struct cmsghdr* cm;
+};
+
+static void complete_to_cmsg(struct test_cmsgs* c)
+{
+  struct cmsg_state cmsg_state;
+
+  memset(c, 0, sizeof(*c));
+  c->msg.msg_control = c->buf;
+  c->msg.msg_controllen = sizeof(c->buf);
+  cmsg_state.msg = &c->msg;
+  cmsg_state.cm = CMSG_FIRSTHDR(&c->msg);
+  cmsg_state.cmsg_bytes_used = 0;
+  cmsg_state.p_msg_flags = &c->msg_flags;
+  ci_tcp_zc_complete_to_cmsg(test_ni, test_ts, test_pkt, &cmsg_state);
+  ci_ip_cmsg_finish(&cmsg_state);
+  CHECK(c->msg_flags & MSG_CTRUNC, ==, 0);
+}
+
+static struct cmsghdr* next_cmsg(struct test_cmsgs* c)
+{
+  if( c->cm == NULL )
+    c->cm = CMSG_FIRSTHDR(&c->msg);
+  else
+    c->cm = CMSG_NXTHDR(&c->msg, c->cm);
+  return c->cm;
+}
+
+static void check_zerocopy_cmsg(struct test_cmsgs* c, ci_uint32 lo,
+                                ci_uint32 hi, int copied)
+{
+  struct cmsghdr* cm = next_cmsg(c);
+  struct sock_extended_err* ee;
+
+  CHECK(cm, !=, NULL);
+  CHECK(cm->cmsg_level, ==, SOL_IP);
+  CHECK(cm->cmsg_type, ==, IP_RECVERR);
+  ee = (struct sock_extended_err*) CMSG_DATA(cm);
+  CHECK(ee->ee_errno, ==, 0);
+  CHECK(ee->ee_origin, ==, SO_EE_ORIGIN_ZEROCOPY);
+  CHECK(ee->ee_code, ==, copied ? SO_EE_CODE_ZEROCOPY_COPIED : 0);
+  CHECK(ee->ee_info, ==, lo);
+  CHECK(ee->ee_data, ==, hi);
+}
+
+
+/* Short, scattered and loopback sends are copied, as are all sends once too
+ * many are waiting for their completions to be read. */
+static void test_zerocopy_pin_ok(void)
+{
+  static char buf[2 * CI_TCP_ZEROCOPY_MIN_LEN];
+  ci_iovec iov[2];
+
+  setup();
+  CI_IOVEC_BASE(&iov[0]) = buf;
+  CI_IOVEC_LEN(&iov[0]) = CI_TCP_ZEROCOPY_MIN_LEN;
+  iov[1] = iov[0];
+  CHECK_TRUE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 2));
+
+  CI_IOVEC_LEN(&iov[0]) = CI_TCP_ZEROCOPY_MIN_LEN - 1;
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  CI_IOVEC_LEN(&iov[0]) = sizeof(buf);
+  CHECK_TRUE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  CI_IOVEC_BASE(&iov[0]) = NULL;
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  CI_IOVEC_BASE(&iov[0]) = buf;
+
+  test_ts->zerocopy_n_pinned = CI_TCP_ZEROCOPY_MAX_PINNED - 1;
+  CHECK_TRUE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  test_ts->zerocopy_n_pinned = CI_TCP_ZEROCOPY_MAX_PINNED;
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  test_ts->zerocopy_n_pinned = 0;
+
+  test_ts->local_peer = OO_SP_FROM_INT(test_ni, 1);
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  test_ts->local_peer = OO_SP_NULL;
+  test_ts->snd_delegated = 1;
+  CHECK_FALSE(ci_tcp_zerocopy_pin_ok(test_ni, test_ts, iov, 1));
+  teardown();
+}
+
+/* A copied send completes with SO_EE_CODE_ZEROCOPY_COPIED, and has nothing
+ * to unpin. */
+static void test_zerocopy_copied(void)
+{
+  struct test_cmsgs c;
+
+  setup();
+  ci_tcp_zerocopy_copied_init(test_ni, test_ts, test_pkt, 7);
+  CHECK(test_pkt->flags & CI_PKT_FLAG_INDIRECT, !=, 0);
+  CHECK(oo_tx_zc_header(test_pkt)->segs, ==, 1);
+
+  complete_to_cmsg(&c);
+  check_zerocopy_cmsg(&c, 7, 7, 1);
+  next_cmsg(&c);
+  CHECK(c.cm, ==, NULL);
+  CHECK(n_unregistered, ==, 0);
+  teardown();
+}
+
+/* Completions unpin each send once, and consecutive sends with the same
+ * outcome are reported as one range. */
+static void test_zerocopy_complete(void)
+{
+  struct ci_pkt_zc_header* zch;
+  struct ci_pkt_zc_payload* zcp;
+  struct test_cmsgs c;
+  uint64_t cookie;
+
+  setup();
+  ci_tcp_zerocopy_copied_init(test_ni, test_ts, test_pkt, 2);
+  add_msg_zerocopy(3, 0x100);
+  add_msg_zerocopy(4, 0x200);
+  /* The start of a send which was split across packets is completed with
+   * its end. */
+  add_msg_zerocopy(5, 0x300);
+  zch = oo_tx_zc_header(test_pkt);
+  zcp = (void*) ((char*) zch + zch->end - oo_tx_zc_payload_size(test_ni));
+  zcp->use_remote_cookie = 0;
+  add_msg_zerocopy(5, 0x300);
+  add_msg_zerocopy(7, 0x400);
+  /* onload_zc_send() completions are reported as they are found, while
+   * the range from 7 is still open. */
+  add_msg_zerocopy(0, 0x999);
+  zcp = (void*) ((char*) zch + zch->end - oo_tx_zc_payload_size(test_ni));
+  zcp->is_msg_zerocopy = 0;
+  test_ts->zerocopy_n_pinned = 4;
+
+  complete_to_cmsg(&c);
+  check_zerocopy_cmsg(&c, 2, 2, 1);
+  check_zerocopy_cmsg(&c, 3, 5, 0);
+  next_cmsg(&c);
+  CHECK(c.cm, !=, NULL);
+  CHECK(c.cm->cmsg_level, ==, SOL_IP);
+  CHECK(c.cm->cmsg_type, ==, ONLOAD_SO_ONLOADZC_COMPLETE);
+  memcpy(&cookie, CMSG_DATA(c.cm), sizeof(cookie));
+  CHECK(cookie, ==, 0x999);
+  check_zerocopy_cmsg(&c, 7, 7, 0);
+  next_cmsg(&c);
+  CHECK(c.cm, ==, NULL);
+
+  CHECK(n_unregistered, ==, 4);
+  CHECK(unregistered[0], ==, 0x100);
+  CHECK(unregistered[1], ==, 0x200);
+  CHECK(unregistered[2], ==, 0x300);
+  CHECK(unregistered[3], ==, 0x400);
+  CHECK(test_ts->zerocopy_n_pinned, ==, 0);
+
+  /* Nor are they released again when the socket is freed. */
+  ci_tcp_zerocopy_release(test_ni, test_ts, test_pkt);
+  CHECK(n_unregistered, ==, 4);
+  teardown();
+}
+
+/* Sends dropped by the socket are unpinned once, and only the registrations
+ * of MSG_ZEROCOPY sends are released. */
+static void test_zerocopy_release(void)
+{
+  struct ci_pkt_zc_header* zch;
+  struct ci_pkt_zc_payload* zcp;
+
+  setup();
+  ci_tcp_zerocopy_copied_init(test_ni, test_ts, test_pkt, 2);
+  add_msg_zerocopy(3, 0x100);
+  add_msg_zerocopy(4, 0x200);
+  add_msg_zerocopy(0, 0x999);
+  zch = oo_tx_zc_header(test_pkt);
+  zcp = (void*) ((char*) zch + zch->end - oo_tx_zc_payload_size(test_ni));
+  zcp->is_msg_zerocopy = 0;
+  test_ts->zerocopy_n_pinned = 2;
+
+  ci_tcp_zerocopy_release(test_ni, test_ts, test_pkt);
+  CHECK(n_unregistered, ==, 2);
+  CHECK(unregistered[0], ==, 0x100);
+  CHECK(unregistered[1], ==, 0x200);
+  CHECK(test_ts->zerocopy_n_pinned, ==, 0);
+
+  ci_tcp_zerocopy_release(test_ni, test_ts, test_pkt);
+  CHECK(n_unregistered, ==, 2);
+  teardown();
+}
+
+/* A send dropped while the NIC is still reading it is unpinned by its tx
+ * completion, though it stops counting against the socket at once. */
+static void test_zerocopy_release_tx_pending(void)
+{
+  setup();
+  ci_tcp_zerocopy_copied_init(test_ni, test_ts, test_pkt, 2);
+  add_msg_zerocopy(3, 0x100);
+  test_pkt->flags |= CI_PKT_FLAG_TX_PENDING;
+  test_ts->zerocopy_n_pinned = 1;
+
+  ci_tcp_zerocopy_release(test_ni, test_ts, test_pkt);
+  CHECK(n_unregistered, ==, 0);
+  CHECK(test_ts->zerocopy_n_pinned, ==, 0);
+
+  test_pkt->flags &= ~CI_PKT_FLAG_TX_PENDING;
+  ci_tcp_zerocopy_release(test_ni, NULL, test_pkt);
+  CHECK(n_unregistered, ==, 1);
+  CHECK(unregistered[0], ==, 0x100);
+  CHECK(test_ts->zerocopy_n_pinned, ==, 0);
+  teardown();
+}
+
+#endif
+
+/* With TCP_NOTSENT_LOWAT a sender may queue segments up to the limit, and
+ * none once it is reached, where send() fails with EAGAIN. */
+static void test_notsent_lowat_send_space(void)
+{
+  int space;
+
+  setup();
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 100);
+
+  test_ts->c.notsent_lowat = 4 * MSS;
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 4);
+  set_unsent(MSS / 2);
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 4);
+  set_unsent(3 * MSS + 1);
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 1);
+  set_unsent(4 * MSS);
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 0);
+  set_unsent(4 * MSS + 1);
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 0);
+
+  /* Bytes in flight do not count. */
+  tcp_snd_nxt(test_ts) += 3 * MSS;
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 3);
+
+  /* The stack-wide default applies to a socket without its own. */
+  test_ts->c.notsent_lowat = 0;
+  NI_OPTS(test_ni).tcp_notsent_lowat = MSS;
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 0);
+  NI_OPTS(test_ni).tcp_notsent_lowat = 0;
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 100 - test_ts->send_in);
+
+  /* The limit never gives more than the sndbuf. */
+  test_ts->c.notsent_lowat = 1000 * MSS;
+  set_unsent(0);
+  test_ts->send_in = 98;
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 2);
+  teardown();
+}
+
+/* The socket is writable only once less than half the limit is unsent. */
+static void test_notsent_lowat_advertise(void)
+{
+  setup();
+  test_ts->c.notsent_lowat = 4 * MSS;
+  set_unsent(2 * MSS);
+  CHECK_FALSE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+  set_unsent(2 * MSS - 1);
+  CHECK_TRUE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+  set_unsent(0);
+  CHECK_TRUE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+
+  /* A full sndbuf still holds the writer back. */
+  test_ts->send_in = 100;
+  CHECK_FALSE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+  teardown();
+}
+
+/* With EF_TCP_SNDBUF_MODE=1 a writer is normally woken by the ACK, but
+ * under TCP_NOTSENT_LOWAT sending from the sendq wakes it. */
+static void test_notsent_lowat_wake(void)
+{
+  setup();
+  set_unsent(MSS);
+  CHECK_TRUE(ci_tcp_tx_wake_on_send(test_ni, test_ts));
+  NI_OPTS(test_ni).tcp_sndbuf_mode = 1;
+  CHECK_FALSE(ci_tcp_tx_wake_on_send(test_ni, test_ts));
+
+  test_ts->c.notsent_lowat = 4 * MSS;
+  CHECK_TRUE(ci_tcp_tx_wake_on_send(test_ni, test_ts));
+  set_unsent(2 * MSS);
+  CHECK_FALSE(ci_tcp_tx_wake_on_send(test_ni, test_ts));
+
+  /* Sent but unacknowledged segments fill the sndbuf in this mode. */
+  set_unsent(0);
+  test_ts->retrans.num = 80;
+  CHECK_FALSE(ci_tcp_tx_wake_on_send(test_ni, test_ts));
+  teardown();
+}
+
+static ci_ip_pkt_fmt* make_prequeue_pkt(int pkt_id, int bytes)
+{
+  ci_ip_pkt_fmt* pkt = PKT(test_ni, pkt_id);
+
+  pkt->refcount = 1;
+  pkt->pkt_start_off = PKT_START_OFF_BAD;
+  pkt->pkt_eth_payload_off = PKT_START_OFF_BAD;
+  oo_tx_pkt_layout_init(pkt);
+  pkt->pay_len = ETH_HLEN + HDR_LEN + bytes;
+  /* As filled by the sender: the header length, and sequence numbers
+   * relative to the start of the packet. */
+  pkt->pf.tcp_tx.start_seq = HDR_LEN;
+  pkt->pf.tcp_tx.end_seq = bytes;
+  pkt->next = OO_PP_NULL;
+  return pkt;
+}
+
+/* Data on the prequeue counts as unsent until it is moved to the sendq,
+ * and then counts there instead. */
+static void test_notsent_lowat_prequeue(void)
+{
+  ci_ip_pkt_fmt* pkt0;
+  ci_ip_pkt_fmt* pkt1;
+  int space, unsent;
+
+  setup();
+  test_ts->c.notsent_lowat = 2 * MSS;
+
+  /* Two sends deferred to the prequeue, as ci_tcp_tx_prequeue() leaves
+   * them. */
+  pkt0 = make_prequeue_pkt(0, 700);
+  pkt1 = make_prequeue_pkt(1, 600);
+  pkt1->next = OO_PKT_P(pkt0);
+  test_ts->send_prequeue = OO_PKT_ID(pkt1);
+  oo_atomic_set(&test_ts->send_prequeue_in, 2);
+  oo_atomic_set(&test_ts->send_prequeue_bytes, 1300);
+  test_ni->state->n_async_pkts = 2;
+
+  unsent = ci_tcp_sendq_unsent_bytes(test_ts);
+  CHECK(unsent, ==, 1300);
+  space = ci_tcp_tx_send_space(test_ni, test_ts);
+  CHECK(space, ==, 1);
+  CHECK_FALSE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+
+  ci_tcp_sendmsg_enqueue_prequeue(test_ni, test_ts, 0);
+  CHECK(oo_atomic_read(&test_ts->send_prequeue_bytes), ==, 0);
+  CHECK(test_ts->send_prequeue, ==, OO_PP_ID_NULL);
+  CHECK(test_ts->send.num, ==, 2);
+  CHECK(OO_PP_ID(test_ts->send.head), ==, 0);
+  CHECK(pkt0->pf.tcp_tx.start_seq, ==, 5000);
+  CHECK(pkt1->pf.tcp_tx.start_seq, ==, 5700);
+  CHECK(tcp_enq_nxt(test_ts), ==, 6300);
+  CHECK(test_ni->state->n_async_pkts, ==, 0);
+  unsent = ci_tcp_sendq_unsent_bytes(test_ts);
+  CHECK(unsent, ==, 1300);
+
+  /* Once sent, the data no longer counts. */
+  tcp_snd_nxt(test_ts) = 6300;
+  unsent = ci_tcp_sendq_unsent_bytes(test_ts);
+  CHECK(unsent, ==, 0);
+  CHECK_TRUE(ci_tcp_tx_advertise_space(test_ni, test_ts));
+  teardown();
+}
+
+int main(void)
+{
+#if CI_CFG_TIMESTAMPING && defined(MSG_ZEROCOPY)
+  TEST_RUN(test_zerocopy_pin_ok);
+  TEST_RUN(test_zerocopy_copied);
+  TEST_RUN(test_zerocopy_complete);
+  TEST_RUN(test_zerocopy_release);
+  TEST_RUN(test_zerocopy_release_tx_pending);
+#endif
+  TEST_RUN(test_notsent_lowat_send_space);
+  TEST_RUN(test_notsent_lowat_advertise);
+  TEST_RUN(test_notsent_lowat_wake);
+  TEST_RUN(test_notsent_lowat_prequeue);
+  TEST_END();
+}
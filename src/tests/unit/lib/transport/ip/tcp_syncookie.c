@@ -0,0 +1,215 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+/* A listening socket and connections for its accept queue */
+#define N_EPS 4
+
+static ci_netif* test_ni;
+static char* test_mem;
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+
+/* Test fixtures */
+static unsigned ep_ofs(void)
+{
+  return CI_ROUND_UP(sizeof(ci_netif_state), EP_BUF_SIZE);
+}
+
+static citp_waitable_obj* ep(int id)
+{
+  return (citp_waitable_obj*) (test_mem + ep_ofs() + id * EP_BUF_SIZE);
+}
+
+static void setup(void)
+{
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_mem = calloc(1, ep_ofs() + N_EPS * EP_BUF_SIZE);
+  test_ni->state = (ci_netif_state*) test_mem;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  *(ci_uint32*) &test_ni->state->ep_ofs = ep_ofs();
+  *(ci_uint32*) &test_ni->state->n_ep_bufs = N_EPS;
+  for( i = 0; i < 16; ++i )
+    ((ci_uint8*) test_ni->state->hash_salt)[i] = i;
+
+  for( i = 0; i < N_EPS; ++i ) {
+    ep(i)->waitable.bufid = OO_SP_FROM_INT(test_ni, i);
+    ep(i)->waitable.wt_next = OO_SP_NULL;
+  }
+}
+
+static void teardown(void)
+{
+  free(test_mem);
+  free(test_ni);
+}
+
+static ci_addr_t addr4(ci_uint32 ip)
+{
+  return CI_ADDR_FROM_IP4(CI_BSWAP_BE32(ip));
+}
+
+
+/* The cookie depends on the peer address and the stack's secret. */
+static void test_fastopen_cookie(void)
+{
+  ci_uint8 a[CI_TCP_FASTOPEN_COOKIE_LEN], b[CI_TCP_FASTOPEN_COOKIE_LEN];
+  ci_addr_t raddr = addr4(0xc0a80001);
+  ci_addr_t other = addr4(0xc0a80002);
+
+  setup();
+  ci_tcp_fastopen_cookie(test_ni, &raddr, a);
+  ci_tcp_fastopen_cookie(test_ni, &raddr, b);
+  CHECK_MEM(a, b, sizeof(a));
+
+  ci_tcp_fastopen_cookie(test_ni, &other, b);
+  CHECK_TRUE(memcmp(a, b, sizeof(a)) != 0);
+
+  ((ci_uint8*) test_ni->state->hash_salt)[0] ^= 1;
+  ci_tcp_fastopen_cookie(test_ni, &raddr, b);
+  CHECK_TRUE(memcmp(a, b, sizeof(a)) != 0);
+  teardown();
+}
+
+/* Only the exact cookie for the address is valid. */
+static void test_fastopen_cookie_ok(void)
+{
+  ci_uint8 c[CI_TCP_FASTOPEN_COOKIE_MAX];
+  ci_addr_t raddr = addr4(0xc0a80001);
+  ci_addr_t other = addr4(0xc0a80002);
+
+  setup();
+  memset(c, 0, sizeof(c));
+  ci_tcp_fastopen_cookie(test_ni, &raddr, c);
+  CHECK_TRUE(ci_tcp_fastopen_cookie_ok(test_ni, &raddr, c,
+                                       CI_TCP_FASTOPEN_COOKIE_LEN));
+  CHECK_FALSE(ci_tcp_fastopen_cookie_ok(test_ni, &other, c,
+                                        CI_TCP_FASTOPEN_COOKIE_LEN));
+  CHECK_FALSE(ci_tcp_fastopen_cookie_ok(test_ni, &raddr, c,
+                                        CI_TCP_FASTOPEN_COOKIE_MIN));
+  CHECK_FALSE(ci_tcp_fastopen_cookie_ok(test_ni, &raddr, c,
+                                        CI_TCP_FASTOPEN_COOKIE_MAX));
+
+  c[CI_TCP_FASTOPEN_COOKIE_LEN - 1] ^= 0x80;
+  CHECK_FALSE(ci_tcp_fastopen_cookie_ok(test_ni, &raddr, c,
+                                        CI_TCP_FASTOPEN_COOKIE_LEN));
+  teardown();
+}
+
+/* The client cache returns what was put for the same address only, and a
+ * colliding address replaces the entry. */
+static void test_fastopen_cache(void)
+{
+  ci_uint8 put[CI_TCP_FASTOPEN_COOKIE_MAX], got[CI_TCP_FASTOPEN_COOKIE_MAX];
+  ci_addr_t raddr = addr4(0x0a000001);
+  ci_addr_t other;
+  ci_uint32 ip;
+  int i, n_other;
+
+  setup();
+  for( i = 0; i < sizeof(put); ++i )
+    put[i] = 0xa0 + i;
+  CHECK(ci_tcp_fastopen_cache_get(test_ni, &raddr, got), ==, 0);
+
+  ci_tcp_fastopen_cache_put(test_ni, &raddr, put, 6);
+  memset(got, 0, sizeof(got));
+  CHECK(ci_tcp_fastopen_cache_get(test_ni, &raddr, got), ==, 6);
+  CHECK_MEM(got, put, 6);
+
+  /* A longer cookie replaces the shorter one. */
+  ci_tcp_fastopen_cache_put(test_ni, &raddr, put + 1,
+                            CI_TCP_FASTOPEN_COOKIE_MAX - 1);
+  CHECK(ci_tcp_fastopen_cache_get(test_ni, &raddr, got), ==,
+        CI_TCP_FASTOPEN_COOKIE_MAX - 1);
+  CHECK_MEM(got, put + 1, CI_TCP_FASTOPEN_COOKIE_MAX - 1);
+
+  /* Find addresses which share the entry, and one which doesn't. */
+  n_other = 0;
+  for( ip = 0x0a000002; n_other < 2; ++ip ) {
+    other = addr4(ip);
+    ci_tcp_fastopen_cache_put(test_ni, &other, put, 4);
+    if( ci_tcp_fastopen_cache_get(test_ni, &raddr, got) != 0 ) {
+      if( n_other == 0 ) {
+        /* Doesn't collide, so both are cached. */
+        CHECK(ci_tcp_fastopen_cache_get(test_ni, &other, got), ==, 4);
+        ++n_other;
+      }
+      continue;
+    }
+    /* Collides, and has replaced [raddr]. */
+    CHECK(ci_tcp_fastopen_cache_get(test_ni, &other, got), ==, 4);
+    ++n_other;
+  }
+  teardown();
+}
+
+/* TCP_FASTOPEN's qlen counts only the connections in the accept queue
+ * which accepted data from the SYN. */
+static void test_fastopen_qlen(void)
+{
+  ci_tcp_socket_listen* tls;
+  citp_waitable* w;
+
+  setup();
+  tls = &ep(0)->tcp_listen;
+  tls->s.b.lock.wl_val = OO_WAITABLE_LK_LOCKED;
+  tls->acceptq_put = CI_ILL_END;
+  tls->acceptq_get = OO_SP_NULL;
+  tls->c.tfo_qlen = 2;
+  ep(1)->tcp.tcpflags = CI_TCPT_FLAG_PASSIVE_OPENED | CI_TCPT_FLAG_TFO;
+  ep(2)->tcp.tcpflags = CI_TCPT_FLAG_PASSIVE_OPENED;
+  ep(3)->tcp.tcpflags = CI_TCPT_FLAG_PASSIVE_OPENED | CI_TCPT_FLAG_TFO;
+  CHECK_TRUE(ci_tcp_acceptq_tfo_ok(tls));
+
+  ci_tcp_acceptq_put(test_ni, tls, &ep(1)->waitable);
+  ci_tcp_acceptq_put(test_ni, tls, &ep(2)->waitable);
+  CHECK(ci_tcp_acceptq_n(tls), ==, 2);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 1);
+  CHECK_TRUE(ci_tcp_acceptq_tfo_ok(tls));
+
+  ci_tcp_acceptq_put(test_ni, tls, &ep(3)->waitable);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 2);
+  CHECK_FALSE(ci_tcp_acceptq_tfo_ok(tls));
+
+  /* Accepting a Fast Open connection makes room, until it's put back. */
+  w = ci_tcp_acceptq_get(test_ni, tls);
+  CHECK(w, ==, &ep(1)->waitable);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 1);
+  CHECK_TRUE(ci_tcp_acceptq_tfo_ok(tls));
+  w->sb_aflags |= CI_SB_AFLAG_TCP_IN_ACCEPTQ;
+  ci_tcp_acceptq_put_back(test_ni, tls, w);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 2);
+
+  w = ci_tcp_acceptq_get(test_ni, tls);
+  CHECK(w, ==, &ep(1)->waitable);
+  w = ci_tcp_acceptq_get(test_ni, tls);
+  CHECK(w, ==, &ep(2)->waitable);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 1);
+  w = ci_tcp_acceptq_get(test_ni, tls);
+  CHECK(w, ==, &ep(3)->waitable);
+  CHECK(ci_tcp_acceptq_n(tls), ==, 0);
+  CHECK(ci_tcp_acceptq_n_tfo(tls), ==, 0);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_fastopen_cookie);
+  TEST_RUN(test_fastopen_cookie_ok);
+  TEST_RUN(test_fastopen_cache);
+  TEST_RUN(test_fastopen_qlen);
+  TEST_END();
+}
@@ -0,0 +1,293 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+#include <linux/filter.h>
+
+#if CI_CFG_TCPDUMP
+
+#define ETH_LEN 14
+#define FRAME_LEN (ETH_LEN + sizeof(ci_ip4_hdr) + sizeof(ci_udp_hdr) + 8)
+
+static ci_netif* test_ni;
+static ci_ip_pkt_fmt* test_pkt;
+
+/* IPv4 UDP to port 53 */
+static const oo_dump_filter_insn udp_53[] = {
+  BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0x0800, 0, 6),
+  BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),
+  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 4),
+  BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),
+  BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),
+  BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 53, 0, 1),
+  BPF_STMT(BPF_RET | BPF_K, 65535),
+  BPF_STMT(BPF_RET | BPF_K, 0),
+};
+
+/* Dependencies */
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+
+/* Test fixtures */
+static void setup(void)
+{
+  ci_ip4_hdr* ip;
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  for( i = 0; i < CI_CFG_DUMPQUEUE_LEN; i++ )
+    test_ni->state->dump_queue[i] = OO_PP_NULL;
+
+  test_pkt = calloc(1, CI_CFG_PKT_BUF_SIZE);
+  test_pkt->refcount = 1;
+  test_pkt->n_buffers = 1;
+  test_pkt->pkt_start_off = 0;
+  test_pkt->pkt_eth_payload_off = ETH_LEN;
+  test_pkt->pay_len = FRAME_LEN;
+  memset(PKT_START(test_pkt), 0xee, ETH_LEN);
+  *((ci_uint16*) oo_l3_hdr(test_pkt) - 1) = CI_ETHERTYPE_IP;
+
+  ip = oo_ip_hdr(test_pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_protocol = IPPROTO_UDP;
+  ((ci_udp_hdr*) (ip + 1))->udp_dest_be16 = CI_BSWAPC_BE16(53);
+}
+
+static void teardown(void)
+{
+  free(test_pkt);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+static void set_filter(const oo_dump_filter_insn* prog, unsigned len)
+{
+  memcpy(test_ni->state->dump_filter, prog, len * sizeof(*prog));
+  test_ni->state->dump_filter_len = len;
+}
+
+#define SET_FILTER(prog) set_filter((prog), sizeof(prog) / sizeof((prog)[0]))
+
+static void set_dport(ci_uint16 port)
+{
+  ((ci_udp_hdr*) (oo_ip_hdr(test_pkt) + 1))->udp_dest_be16 =
+    CI_BSWAP_BE16(port);
+}
+
+/* Insert an 802.1Q tag after the MAC addresses. */
+static void add_vlan_tag(void)
+{
+  char* eth = PKT_START(test_pkt);
+
+  memmove(eth + 2 * ETH_ALEN + ETH_VLAN_HLEN, eth + 2 * ETH_ALEN,
+          test_pkt->pay_len - 2 * ETH_ALEN);
+  *(ci_uint16*) (eth + 2 * ETH_ALEN) = CI_ETHERTYPE_8021Q;
+  *(ci_uint16*) (eth + 2 * ETH_ALEN + 2) = CI_BSWAPC_BE16(100);
+  test_pkt->pkt_eth_payload_off += ETH_VLAN_HLEN;
+  test_pkt->pay_len += ETH_VLAN_HLEN;
+}
+
+
+/* Without a filter every packet is dumped. */
+static void test_no_filter(void)
+{
+  setup();
+  test_ni->state->dump_intf[0] = OO_INTF_I_DUMP_ALL;
+  set_dport(54);
+  CHECK(oo_tcpdump_check(test_ni, test_pkt, 0), ==, 1);
+  teardown();
+}
+
+/* The filter picks out the packets it matches, for dumping all packets or
+ * only those which don't match a socket. */
+static void test_filter_match(void)
+{
+  setup();
+  SET_FILTER(udp_53);
+  test_ni->state->dump_intf[0] = OO_INTF_I_DUMP_ALL;
+  CHECK(oo_tcpdump_check(test_ni, test_pkt, 0), ==, 1);
+  set_dport(54);
+  CHECK(oo_tcpdump_check(test_ni, test_pkt, 0), ==, 0);
+
+  test_ni->state->dump_intf[0] = OO_INTF_I_DUMP_NO_MATCH;
+  CHECK(oo_tcpdump_check_no_match(test_ni, test_pkt, 0), ==, 0);
+  set_dport(53);
+  CHECK(oo_tcpdump_check_no_match(test_ni, test_pkt, 0), ==, 1);
+  teardown();
+}
+
+/* Packets which don't match take no dump queue entries and aren't counted
+ * as missed, so they can't push out those which do. */
+static void test_no_match_keeps_queue(void)
+{
+  int i;
+
+  setup();
+  SET_FILTER(udp_53);
+  test_ni->state->dump_intf[0] = OO_INTF_I_DUMP_ALL;
+
+  set_dport(54);
+  for( i = 0; i < 4 * CI_CFG_DUMPQUEUE_LEN; ++i )
+    if( oo_tcpdump_check(test_ni, test_pkt, 0) )
+      oo_tcpdump_dump_pkt(test_ni, test_pkt);
+  CHECK(test_ni->state->dump_write_i, ==, 0);
+  CHECK(test_ni->state->stats.tcpdump_missed, ==, 0);
+  CHECK(test_pkt->refcount, ==, 1);
+
+  set_dport(53);
+  for( i = 0; i < CI_CFG_DUMPQUEUE_LEN; ++i )
+    if( oo_tcpdump_check(test_ni, test_pkt, 0) )
+      oo_tcpdump_dump_pkt(test_ni, test_pkt);
+  CHECK(test_ni->state->dump_write_i, ==, CI_CFG_DUMPQUEUE_LEN - 1);
+  CHECK(test_ni->state->stats.tcpdump_missed, ==, 1);
+  CHECK(test_pkt->refcount, ==, CI_CFG_DUMPQUEUE_LEN);
+  teardown();
+}
+
+/* When dumping a VLAN interface the filter is written for untagged frames,
+ * and sees them with the tag removed. */
+static void test_vlan(void)
+{
+  static const oo_dump_filter_insn len_is_frame[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, FRAME_LEN, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+
+  setup();
+  SET_FILTER(udp_53);
+  add_vlan_tag();
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  test_ni->state->dump_filter_vlan = 1;
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 1);
+  SET_FILTER(len_is_frame);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 1);
+  teardown();
+}
+
+/* Loopback frames are dumped with zero MAC addresses, so the filter sees
+ * them that way too. */
+static void test_loopback_macs(void)
+{
+  static const oo_dump_filter_insn zero_src_mac[] = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 8),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+    BPF_STMT(BPF_RET | BPF_K, 0),
+  };
+
+  setup();
+  SET_FILTER(zero_src_mac);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  test_pkt->intf_i = OO_INTF_I_LOOPBACK;
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 1);
+  teardown();
+}
+
+/* Only the first buffer of a packet can be loaded. */
+static void test_first_buffer(void)
+{
+  setup();
+  SET_FILTER(udp_53);
+  test_pkt->n_buffers = 2;
+  test_pkt->buf_len = ETH_LEN + sizeof(ci_ip4_hdr) + 2;
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  test_pkt->buf_len += 2;
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 1);
+  teardown();
+}
+
+/* Programs which are malformed, or changed to be, reject the packet rather
+ * than misbehave. */
+static void test_bad_programs(void)
+{
+  static const oo_dump_filter_insn load_past_end[] = {
+    BPF_STMT(BPF_LD | BPF_H | BPF_ABS, FRAME_LEN - 1),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn load_wraps[] = {
+    BPF_STMT(BPF_LDX | BPF_IMM, 0xfffffffe),
+    BPF_STMT(BPF_LD | BPF_W | BPF_IND, 0),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn div_zero[] = {
+    BPF_STMT(BPF_LD | BPF_IMM, 1),
+    BPF_STMT(BPF_ALU | BPF_DIV | BPF_X, 0),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn bad_mem[] = {
+    BPF_STMT(BPF_ST, BPF_MEMWORDS),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn ja_wraps[] = {
+    BPF_STMT(BPF_JMP | BPF_JA, 0xffffffff),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn jump_past_end[] = {
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 2, 2),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+  static const oo_dump_filter_insn no_ret[] = {
+    BPF_STMT(BPF_LD | BPF_IMM, 1),
+  };
+  static const oo_dump_filter_insn bad_opcode[] = {
+    BPF_STMT(0xffff, 0),
+    BPF_STMT(BPF_RET | BPF_K, 65535),
+  };
+
+  setup();
+  SET_FILTER(load_past_end);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(load_wraps);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(div_zero);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(bad_mem);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(ja_wraps);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(jump_past_end);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(no_ret);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+  SET_FILTER(bad_opcode);
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 0);
+
+  /* A length beyond the program area is limited to it. */
+  SET_FILTER(udp_53);
+  test_ni->state->dump_filter_len = 0xffff;
+  CHECK(oo_tcpdump_filter_match(test_ni, test_pkt), ==, 1);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_no_filter);
+  TEST_RUN(test_filter_match);
+  TEST_RUN(test_no_match_keeps_queue);
+  TEST_RUN(test_vlan);
+  TEST_RUN(test_loopback_macs);
+  TEST_RUN(test_first_buffer);
+  TEST_RUN(test_bad_programs);
+  TEST_END();
+}
+
+#else
+
+int main(void)
+{
+  TEST_END();
+}
+
+#endif
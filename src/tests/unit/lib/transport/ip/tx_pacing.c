@@ -0,0 +1,342 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include "../../../../../lib/transport/ip/ip_internal.h"
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#define MSS 1000
+
+/* A 1GHz cycle counter, and 2^20 cycles (about 1ms) per tick. */
+#define KHZ      1000000
+#define HZ       (KHZ * 1000ull)
+#define FRC2TICK 20
+
+/* The timer and list links must be in the shared state. */
+struct test_state {
+  ci_netif_state ns;
+  ci_tcp_state ts;
+  ci_udp_state us;
+  struct oo_p_dllink timers;
+};
+
+static ci_netif* test_ni;
+static ci_tcp_state* test_ts;
+static ci_udp_state* test_us;
+static struct test_state* test_state;
+
+static int n_tcp_tx_advance;
+static int n_udp_send_paced;
+
+/* Dependencies */
+void __ci_ip_timer_set(ci_netif* ni, ci_ip_timer* ts, ci_iptime_t t)
+{
+  ts->time = t;
+  oo_p_dllink_add(ni, oo_p_dllink_ptr(ni, &test_state->timers),
+                  oo_p_dllink_statep(ni, ts->statep));
+}
+
+void ci_tcp_tx_advance(ci_tcp_state* ts, ci_netif* ni)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(ts, ==, test_ts);
+  ++n_tcp_tx_advance;
+}
+
+void ci_udp_sendmsg_send_paced(ci_netif* ni, ci_udp_state* us, int all)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK(us, ==, test_us);
+  CHECK(all, ==, 0);
+  ++n_udp_send_paced;
+}
+
+
+/* Test fixtures */
+static void set_time(ci_uint64 cycles)
+{
+  ci_ip_timer_state* its = IPTIMER_STATE(test_ni);
+  its->frc = cycles;
+  its->ci_ip_time_real_ticks = its->frc >> FRC2TICK;
+}
+
+static void setup(void)
+{
+  ci_ip_timer_state* its;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_state = calloc(1, sizeof(*test_state));
+  test_ni->state = &test_state->ns;
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+
+  its = IPTIMER_STATE(test_ni);
+  its->khz = KHZ;
+  its->ci_ip_time_frc2tick = FRC2TICK;
+  set_time(HZ);
+
+  oo_p_dllink_init(test_ni, oo_p_dllink_ptr(test_ni, &test_state->timers));
+  ci_tx_pace_init(test_ni);
+
+  test_ts = &test_state->ts;
+  test_ts->s.b.state = CI_TCP_ESTABLISHED;
+  test_ts->s.pace_max_rate = CI_TX_PACE_RATE_UNLIMITED;
+  test_ts->local_peer = OO_SP_NULL;
+  ci_ip_queue_init(&test_ts->send);
+  oo_p_dllink_init(test_ni, oo_p_dllink_sb(test_ni, &test_ts->s.b,
+                                           &test_ts->s.pace_link));
+
+  test_us = &test_state->us;
+  test_us->s.b.state = CI_TCP_STATE_UDP;
+  test_us->s.pace_max_rate = CI_TX_PACE_RATE_UNLIMITED;
+  oo_p_dllink_init(test_ni, oo_p_dllink_sb(test_ni, &test_us->s.b,
+                                           &test_us->s.pace_link));
+
+  n_tcp_tx_advance = 0;
+  n_udp_send_paced = 0;
+}
+
+static void teardown(void)
+{
+  free(test_state);
+  free(test_ni);
+}
+
+static int pace_throttled(ci_sock_cmn* s)
+{
+  return ! oo_p_dllink_is_empty(test_ni, oo_p_dllink_sb(test_ni, &s->b,
+                                                        &s->pace_link));
+}
+
+/* Sends whole segments for [cycles] in steps of [step], as TCP does, and
+ * returns the number of bytes sent. */
+static ci_uint64 send_for(ci_sock_cmn* s, ci_uint64 rate, ci_uint64 cycles,
+                          ci_uint64 step)
+{
+  ci_uint64 now = IPTIMER_STATE(test_ni)->frc;
+  ci_uint64 end = now + cycles;
+  ci_uint64 sent = 0;
+
+  for( ; now < end; now += step ) {
+    set_time(now);
+    while( ci_tx_pace_tokens(test_ni, s, rate, 2 * MSS) >= MSS ) {
+      s->pace_tokens -= MSS;
+      sent += MSS;
+    }
+  }
+  return sent;
+}
+
+
+/* The bucket starts full, and after that the rate is met however often it
+ * is refilled, down to intervals of a microsecond. */
+static void test_pace_accuracy(void)
+{
+  static const ci_uint64 steps[] = { 1000, 4321, 123457, 1 << FRC2TICK };
+  static const ci_uint64 rates[] = { 1000000, 12500000, 1250000000 };
+  ci_uint64 rate, depth, sent;
+  int i, j;
+
+  for( i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i )
+    for( j = 0; j < sizeof(steps) / sizeof(steps[0]); ++j ) {
+      setup();
+      rate = rates[i];
+      depth = ((rate << (FRC2TICK + 1)) / HZ) + 2 * MSS;
+      CHECK(ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS), ==,
+            depth);
+
+      /* A second's worth of sends, less the initial burst, is within a
+       * segment and a step of the rate. */
+      sent = send_for(&test_ts->s, rate, HZ / 10, steps[j]);
+      sent += send_for(&test_ts->s, rate, HZ - HZ / 10, steps[j]);
+      CHECK(sent, <=, rate + depth);
+      CHECK(sent + MSS + rate * steps[j] / HZ, >=, rate);
+      teardown();
+    }
+}
+
+/* An idle socket may burst only the depth of the bucket. */
+static void test_pace_idle(void)
+{
+  ci_uint64 rate = 125000000;
+  ci_int32 tick = (rate << FRC2TICK) / HZ;
+
+  setup();
+  ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS);
+  test_ts->s.pace_tokens = 0;
+  set_time(IPTIMER_STATE(test_ni)->frc + 10 * HZ);
+  CHECK(ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS), ==,
+        2 * tick + 2 * MSS);
+
+  /* Half a tick later, half a tick's worth more. */
+  test_ts->s.pace_tokens = 0;
+  set_time(IPTIMER_STATE(test_ni)->frc + (1 << (FRC2TICK - 1)));
+  CHECK(ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS), ==,
+        tick / 2);
+  teardown();
+}
+
+/* A socket idle for longer than a 32-bit cycle count wraps still finds its
+ * bucket full. */
+static void test_pace_idle_wrap(void)
+{
+  ci_uint64 rate = 125000000;
+  ci_int32 depth = ((rate << (FRC2TICK + 1)) / HZ) + 2 * MSS;
+  ci_int32 tokens;
+
+  setup();
+  ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS);
+  test_ts->s.pace_tokens = 0;
+  set_time(IPTIMER_STATE(test_ni)->frc + (1ull << 32) + 1000);
+  tokens = ci_tx_pace_tokens(test_ni, &test_ts->s, rate, 2 * MSS);
+  CHECK(tokens, ==, depth);
+  CHECK(test_ts->s.pace_stamp, ==, IPTIMER_STATE(test_ni)->frc);
+  teardown();
+}
+
+/* SO_MAX_PACING_RATE takes 32 or 64 bits, and rejects anything shorter. */
+static void test_pace_sockopt(void)
+{
+  ci_uint64 rate64 = 5000000000ull;
+  unsigned rate32 = 1000;
+  ci_uint16 rate16 = 1000;
+  int rc;
+
+  setup();
+  rc = ci_set_sol_socket(test_ni, &test_us->s, SO_MAX_PACING_RATE,
+                         &rate16, sizeof(rate16));
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(test_us->s.pace_max_rate, ==, CI_TX_PACE_RATE_UNLIMITED);
+
+  rc = ci_set_sol_socket(test_ni, &test_us->s, SO_MAX_PACING_RATE,
+                         NULL, sizeof(rate32));
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EFAULT);
+
+  rc = ci_set_sol_socket(test_ni, &test_us->s, SO_MAX_PACING_RATE,
+                         &rate32, sizeof(rate32));
+  CHECK(rc, ==, 0);
+  CHECK(test_us->s.pace_max_rate, ==, 1000);
+
+  rc = ci_set_sol_socket(test_ni, &test_us->s, SO_MAX_PACING_RATE,
+                         &rate64, sizeof(rate64));
+  CHECK(rc, ==, 0);
+  CHECK(test_us->s.pace_max_rate, ==, rate64);
+
+  rate32 = ~0u;
+  rc = ci_set_sol_socket(test_ni, &test_us->s, SO_MAX_PACING_RATE,
+                         &rate32, sizeof(rate32));
+  CHECK(rc, ==, 0);
+  CHECK(test_us->s.pace_max_rate, ==, CI_TX_PACE_RATE_UNLIMITED);
+  teardown();
+}
+
+/* UDP can overdraw the bucket with a large datagram, and then waits for it
+ * to be paid back. */
+static void test_pace_overdraw(void)
+{
+  ci_uint64 rate = 1000000;
+  ci_int32 depth = ((rate << (FRC2TICK + 1)) / HZ) + 1500;
+
+  setup();
+  CHECK(ci_tx_pace_tokens(test_ni, &test_us->s, rate, 1500), ==, depth);
+  test_us->s.pace_tokens = -7500;
+
+  ci_tx_pace_throttle(test_ni, &test_us->s, rate, 1);
+  CHECK_TRUE(pace_throttled(&test_us->s));
+  CHECK_TRUE(ci_ip_timer_pending(test_ni, &test_ni->state->pace_tid));
+  /* 7.5ms is 7 ticks and a bit. */
+  CHECK(test_ni->state->pace_tid.time, ==, ci_ip_time_now(test_ni) + 8);
+
+  set_time(IPTIMER_STATE(test_ni)->frc + HZ / 200);
+  CHECK(ci_tx_pace_tokens(test_ni, &test_us->s, rate, 1500), ==, -2500);
+  set_time(IPTIMER_STATE(test_ni)->frc + HZ / 200);
+  CHECK(ci_tx_pace_tokens(test_ni, &test_us->s, rate, 1500), ==, 2500);
+  set_time(IPTIMER_STATE(test_ni)->frc + HZ / 200);
+  CHECK(ci_tx_pace_tokens(test_ni, &test_us->s, rate, 1500), ==, depth);
+  teardown();
+}
+
+/* The timer is set for the earliest socket that will have tokens, and
+ * releases every throttled socket. */
+static void test_pace_timeout(void)
+{
+  ci_uint64 rate = 1000000;
+  ci_iptime_t now;
+
+  setup();
+  now = ci_ip_time_now(test_ni);
+  test_us->s.pace_tokens = -10000;
+  ci_tx_pace_throttle(test_ni, &test_us->s, rate, 1);
+  CHECK(test_ni->state->pace_tid.time, ==, now + 10);
+
+  test_ts->s.pace_tokens = 0;
+  ci_tx_pace_throttle(test_ni, &test_ts->s, rate, MSS);
+  CHECK(test_ni->state->pace_tid.time, ==, now + 1);
+  ci_tx_pace_throttle(test_ni, &test_us->s, rate, 1);
+  CHECK(test_ni->state->pace_tid.time, ==, now + 1);
+
+  /* Nothing to send on the TCP socket. */
+  ci_tx_pace_timeout(test_ni);
+  CHECK(n_tcp_tx_advance, ==, 0);
+  CHECK(n_udp_send_paced, ==, 1);
+  CHECK_FALSE(pace_throttled(&test_ts->s));
+  CHECK_FALSE(pace_throttled(&test_us->s));
+  CHECK(test_ni->state->stats.tx_pace_timeouts, ==, 1);
+
+  test_ts->send.num = 1;
+  ci_tx_pace_throttle(test_ni, &test_ts->s, rate, MSS);
+  ci_tx_pace_timeout(test_ni);
+  CHECK(n_tcp_tx_advance, ==, 1);
+
+  /* Closed sockets are left alone. */
+  test_ts->s.b.state = CI_TCP_CLOSED;
+  ci_tx_pace_throttle(test_ni, &test_ts->s, rate, MSS);
+  ci_tx_pace_timeout(test_ni);
+  CHECK(n_tcp_tx_advance, ==, 1);
+  teardown();
+}
+
+/* The automatic rate follows cwnd and srtt, and SO_MAX_PACING_RATE caps
+ * it. */
+static void test_pace_auto_rate(void)
+{
+  ci_uint64 ticks_per_sec = HZ >> FRC2TICK;
+
+  setup();
+  test_ts->cwnd = 10 * MSS;
+  test_ts->ssthresh = 20 * MSS;
+  test_ts->sa = 8 * 4;
+  CHECK(ci_tcp_pace_rate(test_ni, test_ts), ==, 0);
+
+  NI_OPTS(test_ni).tcp_auto_pacing = 1;
+  CHECK(ci_tcp_pace_rate(test_ni, test_ts), ==,
+        2 * 10 * MSS * ticks_per_sec / 4);
+  test_ts->ssthresh = 10 * MSS;
+  CHECK(ci_tcp_pace_rate(test_ni, test_ts), ==,
+        10 * MSS * ticks_per_sec / 4 * 6 / 5);
+
+  test_ts->s.pace_max_rate = 100000;
+  CHECK(ci_tcp_pace_rate(test_ni, test_ts), ==, 100000);
+
+  /* No RTT yet. */
+  test_ts->s.pace_max_rate = CI_TX_PACE_RATE_UNLIMITED;
+  test_ts->sa = 0;
+  CHECK(ci_tcp_pace_rate(test_ni, test_ts), ==, 0);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_pace_accuracy);
+  TEST_RUN(test_pace_idle);
+  TEST_RUN(test_pace_idle_wrap);
+  TEST_RUN(test_pace_overdraw);
+  TEST_RUN(test_pace_timeout);
+  TEST_RUN(test_pace_auto_rate);
+  TEST_RUN(test_pace_sockopt);
+  TEST_END();
+}
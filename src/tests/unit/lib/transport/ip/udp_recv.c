@@ -0,0 +1,340 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define N_PKTS 80
+#define ETH_LEN 14
+#define SPORT 1234
+
+static ci_netif* test_ni;
+static char* test_pkt_set;
+static citp_waitable_obj* test_wo;
+static ci_udp_state* test_us;
+static int n_queued;
+
+static char buf[0x20000];
+static char cbuf[CMSG_SPACE(sizeof(int)) + 64];
+static int msg_flags;
+static int cmsg_gro_size;
+
+/* Dependencies */
+#include <onload/ul/per_thread.h>
+__thread struct oo_per_thread oo_per_thread;
+
+/* Only used to block, which the tests never do. */
+int (*ci_sys_poll)(struct pollfd*, nfds_t, int);
+
+/* Consumed buffers stay allocated; the fixture frees them all. */
+int ci_udp_recv_q_reap(ci_netif* ni, ci_udp_recv_q* q)
+{
+  while( ! OO_PP_EQ(q->head, q->extract) ) {
+    ci_ip_pkt_fmt* pkt = PKT_CHK(ni, q->head);
+    q->head = pkt->udp_rx_next;
+    q->pkts_reaped += pkt->n_buffers;
+  }
+  return 0;
+}
+
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+
+/* Test fixtures */
+static void setup(void)
+{
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  test_ni->state->lock.lock = CI_EPLOCK_LOCKED;
+  test_ni->packets = calloc(1, sizeof(*test_ni->packets));
+  *(ci_int32*) &test_ni->packets->n_pkts_allocated = N_PKTS;
+  test_pkt_set = aligned_alloc(CI_CFG_PKT_BUF_SIZE,
+                               N_PKTS * CI_CFG_PKT_BUF_SIZE);
+  memset(test_pkt_set, 0, N_PKTS * CI_CFG_PKT_BUF_SIZE);
+  test_ni->pkt_bufs = (ci_pkt_bufs*) &test_pkt_set;
+  for( i = 0; i < N_PKTS; ++i )
+    OO_PKT_PP_INIT(PKT(test_ni, i), i);
+
+  test_wo = calloc(1, sizeof(*test_wo));
+  test_us = &test_wo->udp;
+  test_us->s.domain = AF_INET;
+  test_us->udpflags = CI_UDPF_GRO;
+  udp_lport_be16(test_us) = CI_BSWAPC_BE16(5678);
+  ci_udp_recv_q_init(&test_us->recv_q);
+  n_queued = 0;
+}
+
+static void teardown(void)
+{
+  free(test_wo);
+  free(test_pkt_set);
+  free(test_ni->packets);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+/* Queues a datagram of [len] bytes from port [sport].  Each byte of the
+ * payload is the number of the datagram. */
+static void queue_dgram(int len, int sport)
+{
+  ci_ip_pkt_fmt* pkt;
+  ci_ip4_hdr* ip;
+  ci_udp_hdr* udp;
+
+  CHECK(n_queued, <, N_PKTS);
+  pkt = PKT(test_ni, n_queued);
+  pkt->refcount = 1;
+  pkt->n_buffers = 1;
+  pkt->flags = CI_PKT_FLAG_RX;
+  pkt->frag_next = OO_PP_NULL;
+  pkt->pkt_start_off = 0;
+  pkt->pkt_eth_payload_off = ETH_LEN;
+  *((ci_uint16*) oo_l3_hdr(pkt) - 1) = CI_ETHERTYPE_IP;
+
+  ip = oo_ip_hdr(pkt);
+  ip->ip_ihl_version = CI_IP4_IHL_VERSION(sizeof(*ip));
+  ip->ip_protocol = IPPROTO_UDP;
+  ip->ip_saddr_be32 = CI_BSWAPC_BE32(0x0a000001);
+  ip->ip_daddr_be32 = CI_BSWAPC_BE32(0x0a000002);
+  udp = (ci_udp_hdr*) (ip + 1);
+  udp->udp_source_be16 = CI_BSWAP_BE16(sport);
+  udp->udp_dest_be16 = CI_BSWAPC_BE16(5678);
+  memset(udp + 1, n_queued, len);
+  pkt->pf.udp.pay_len = len;
+  pkt->pay_len = ETH_LEN + sizeof(*ip) + sizeof(*udp) + len;
+  oo_offbuf_init(&pkt->buf, (char*) (udp + 1), len);
+
+  ci_udp_recv_q_put(test_ni, &test_us->recv_q, pkt);
+  ++n_queued;
+}
+
+/* Reads into a buffer of [space] bytes, and records the flags and the
+ * UDP_GRO control message, if any, in [msg_flags] and [cmsg_gro_size]. */
+static int udp_recv(int space, int flags)
+{
+  struct msghdr msg;
+  struct cmsghdr* cm;
+  struct iovec iov;
+  ci_udp_iomsg_args a;
+  int rc;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = buf;
+  iov.iov_len = space;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  memset(&a, 0, sizeof(a));
+  a.ni = test_ni;
+  a.us = test_us;
+  memset(buf, 0xff, sizeof(buf));
+  rc = ci_udp_recvmsg(&a, &msg, flags | MSG_DONTWAIT);
+
+  msg_flags = msg.msg_flags;
+  cmsg_gro_size = 0;
+  for( cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm) ) {
+    if( cm->cmsg_level != IPPROTO_UDP || cm->cmsg_type != UDP_GRO )
+      continue;
+    /* Linux gives the segment size as an int. */
+    CHECK(cm->cmsg_len, ==, CMSG_LEN(sizeof(int)));
+    memcpy(&cmsg_gro_size, CMSG_DATA(cm), sizeof(int));
+  }
+  if( cmsg_gro_size != 0 )
+    CHECK(msg.msg_controllen, ==, CMSG_SPACE(sizeof(int)));
+  return rc;
+}
+
+/* Checks that [len] bytes at [off] in the buffer came from datagram
+ * [dgram]. */
+static void check_data(int off, int len, int dgram)
+{
+  char expect[2048];
+
+  CHECK(len, <=, sizeof(expect));
+  memset(expect, dgram, len);
+  CHECK_MEM(buf + off, expect, len);
+}
+
+
+/* Datagrams of the same size are returned together, the last one of a run
+ * may be shorter, and it ends the run. */
+static void test_gro_short_last(void)
+{
+  int rc;
+
+  setup();
+  queue_dgram(1000, SPORT);
+  queue_dgram(1000, SPORT);
+  queue_dgram(400, SPORT);
+  queue_dgram(1000, SPORT);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 2400);
+  CHECK(cmsg_gro_size, ==, 1000);
+  CHECK(msg_flags & MSG_TRUNC, ==, 0);
+  check_data(0, 1000, 0);
+  check_data(1000, 1000, 1);
+  check_data(2000, 400, 2);
+  CHECK(test_us->stats.n_rx_gro, ==, 1);
+  CHECK(test_us->stats.n_rx_gro_segs, ==, 3);
+
+  /* A single datagram has no control message. */
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 1000);
+  CHECK(cmsg_gro_size, ==, 0);
+  check_data(0, 1000, 3);
+  CHECK_TRUE(ci_udp_recv_q_is_empty(&test_us->recv_q));
+  CHECK(test_us->stats.n_rx_gro, ==, 1);
+  teardown();
+}
+
+/* A longer datagram, or one from another flow, is not coalesced. */
+static void test_gro_run_ends(void)
+{
+  int rc;
+
+  setup();
+  queue_dgram(500, SPORT);
+  queue_dgram(500, SPORT);
+  queue_dgram(600, SPORT);
+  queue_dgram(600, SPORT);
+  queue_dgram(600, SPORT + 1);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 1000);
+  CHECK(cmsg_gro_size, ==, 500);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 1200);
+  CHECK(cmsg_gro_size, ==, 600);
+  check_data(600, 600, 3);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 600);
+  CHECK(cmsg_gro_size, ==, 0);
+  check_data(0, 600, 4);
+  teardown();
+}
+
+/* No more than 64 datagrams are returned by one read. */
+static void test_gro_max_segs(void)
+{
+  int i, rc;
+
+  setup();
+  for( i = 0; i < 70; ++i )
+    queue_dgram(100, SPORT);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 64 * 100);
+  CHECK(cmsg_gro_size, ==, 100);
+  check_data(63 * 100, 100, 63);
+  CHECK(test_us->stats.n_rx_gro_segs, ==, 64);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 6 * 100);
+  check_data(0, 100, 64);
+  CHECK_TRUE(ci_udp_recv_q_is_empty(&test_us->recv_q));
+  teardown();
+}
+
+/* No more than 64KiB is returned by one read. */
+static void test_gro_max_bytes(void)
+{
+  int i, rc;
+
+  setup();
+  for( i = 0; i < 50; ++i )
+    queue_dgram(1400, SPORT);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 46 * 1400);
+  CHECK(rc, <=, 0xffff);
+  CHECK(cmsg_gro_size, ==, 1400);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 4 * 1400);
+  check_data(0, 1400, 46);
+  teardown();
+}
+
+/* A read stops at the last datagram which fits in the buffer rather than
+ * truncate one; a datagram larger than the buffer is truncated as usual. */
+static void test_gro_small_buffer(void)
+{
+  int rc;
+
+  setup();
+  queue_dgram(1000, SPORT);
+  queue_dgram(1000, SPORT);
+  queue_dgram(1000, SPORT);
+  rc = udp_recv(2500, 0);
+  CHECK(rc, ==, 2000);
+  CHECK(msg_flags & MSG_TRUNC, ==, 0);
+  CHECK(cmsg_gro_size, ==, 1000);
+  CHECK((ci_uint8) buf[2000], ==, 0xff);
+  rc = udp_recv(500, 0);
+  CHECK(rc, ==, 500);
+  CHECK(msg_flags & MSG_TRUNC, ==, MSG_TRUNC);
+  CHECK(cmsg_gro_size, ==, 0);
+  check_data(0, 500, 2);
+  CHECK_TRUE(ci_udp_recv_q_is_empty(&test_us->recv_q));
+  teardown();
+}
+
+/* MSG_PEEK returns one datagram, and leaves the queue alone. */
+static void test_gro_peek(void)
+{
+  int rc;
+
+  setup();
+  queue_dgram(1000, SPORT);
+  queue_dgram(1000, SPORT);
+  rc = udp_recv(sizeof(buf), MSG_PEEK);
+  CHECK(rc, ==, 1000);
+  CHECK(cmsg_gro_size, ==, 0);
+  check_data(0, 1000, 0);
+  CHECK(ci_udp_recv_q_pkts(&test_us->recv_q), ==, 2);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 2000);
+  CHECK(cmsg_gro_size, ==, 1000);
+  CHECK(test_us->stats.n_rx_gro, ==, 1);
+  teardown();
+}
+
+/* Without the option, datagrams are returned one at a time. */
+static void test_gro_off(void)
+{
+  int rc;
+
+  setup();
+  test_us->udpflags &= ~CI_UDPF_GRO;
+  queue_dgram(1000, SPORT);
+  queue_dgram(1000, SPORT);
+  rc = udp_recv(sizeof(buf), 0);
+  CHECK(rc, ==, 1000);
+  CHECK(cmsg_gro_size, ==, 0);
+  CHECK(ci_udp_recv_q_pkts(&test_us->recv_q), ==, 1);
+  CHECK(test_us->stats.n_rx_gro, ==, 0);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_gro_short_last);
+  TEST_RUN(test_gro_run_ends);
+  TEST_RUN(test_gro_max_segs);
+  TEST_RUN(test_gro_max_bytes);
+  TEST_RUN(test_gro_small_buffer);
+  TEST_RUN(test_gro_peek);
+  TEST_RUN(test_gro_off);
+  TEST_END();
+}
@@ -0,0 +1,423 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Functions under test */
+#include <ci/internal/ip.h>
+#include <cplane/cplane.h>
+#include <netinet/udp.h>
+
+/* Test infrastructure */
+#include "unit_test.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#define N_PKTS 16
+#define N_ROWS 4
+#define ROUTE_ROW 1
+#define MTU 1500
+#define OS_SOCK 99
+
+static ci_netif* test_ni;
+static char* test_pkt_set;
+static struct oo_cplane_handle* test_cp;
+static citp_waitable_obj* test_wo;
+static ci_udp_state* test_us;
+static citp_socket test_ep;
+static int n_allocated;
+static int n_freed;
+
+static char payload[64 * 1000];
+
+/* The datagrams passed to the NIC, in order */
+#define MAX_SENT 70
+static struct {
+  int udp_len;
+  int ip_len;
+  int frag_off;
+  int first_byte;
+} sent[MAX_SENT];
+static int n_sent;
+
+/* Dependencies */
+#include <onload/ul/per_thread.h>
+__thread struct oo_per_thread oo_per_thread;
+
+#include <ci/internal/efabcfg.h>
+ci_cfg_opts_t ci_cfg_opts;
+
+void ci_assert_valid_pkt(ci_netif* ni, ci_ip_pkt_fmt* pkt,
+                         ci_boolean_t ni_locked,
+                         const char* file, int line)
+{
+}
+
+citp_waitable_obj* citp_waitable_obj_alloc(ci_netif* netif)
+{
+  CHECK(netif, ==, test_ni);
+  return test_wo;
+}
+
+void ci_sock_cmn_init(ci_netif* ni, ci_sock_cmn* s, int can_poison)
+{
+  s->s_flags = 0;
+  memset(&s->so, 0, sizeof(s->so));
+  ci_ip_cache_init(&s->pkt, AF_INET);
+#if CI_CFG_TX_PACING
+  s->pace_max_rate = CI_TX_PACE_RATE_UNLIMITED;
+#endif
+}
+
+void ci_ipcache_set_saddr(ci_ip_cached_hdrs* ipcache, ci_addr_t addr)
+{
+  ipcache->ipx.ip4.ip_saddr_be32 = addr.ip4;
+}
+
+void ci_ipcache_set_daddr(ci_ip_cached_hdrs* ipcache, ci_addr_t addr)
+{
+  ipcache->ipx.ip4.ip_daddr_be32 = addr.ip4;
+}
+
+int ci_netif_pkt_alloc_block(ci_netif* ni, ci_sock_cmn* s,
+                             int* p_netif_locked, int can_block,
+                             ci_ip_pkt_fmt** p_pkt)
+{
+  ci_ip_pkt_fmt* pkt;
+  int i;
+
+  for( i = 0; i < N_PKTS; ++i ) {
+    pkt = PKT(ni, i);
+    if( pkt->refcount == 0 ) {
+      pkt->refcount = 1;
+      pkt->n_buffers = 1;
+      pkt->flags = 0;
+      pkt->next = OO_PP_NULL;
+      pkt->frag_next = OO_PP_NULL;
+      pkt->pkt_start_off = PKT_START_OFF_BAD;
+      pkt->pkt_eth_payload_off = PKT_START_OFF_BAD;
+      pkt->pay_len = 0;
+      ++n_allocated;
+      *p_pkt = pkt;
+      return 0;
+    }
+  }
+  return -ENOBUFS;
+}
+
+void ci_netif_pkt_free(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  CHECK(pkt->refcount, ==, 0);
+  ++n_freed;
+}
+
+/* Records the datagram, and completes it at once. */
+void __ci_netif_send(ci_netif* ni, ci_ip_pkt_fmt* pkt)
+{
+  ci_ip4_hdr* ip = oo_tx_ip_hdr(pkt);
+  ci_udp_hdr* udp = (ci_udp_hdr*) (ip + 1);
+
+  CHECK(ni, ==, test_ni);
+  CHECK(n_sent, <, MAX_SENT);
+  sent[n_sent].udp_len = CI_BSWAP_BE16(udp->udp_len_be16);
+  sent[n_sent].ip_len = CI_BSWAP_BE16(ip->ip_tot_len_be16);
+  sent[n_sent].frag_off = CI_BSWAP_BE16(ip->ip_frag_off_be16 &
+                                        ~CI_IP4_FRAG_DONT);
+  sent[n_sent].first_byte = *(ci_uint8*) (udp + 1);
+  ++n_sent;
+  pkt->flags &= ~CI_PKT_FLAG_TX_PENDING;
+  ci_netif_pkt_release(ni, pkt);
+}
+
+void cicp_user_retrieve(ci_netif* ni, ci_ip_cached_hdrs* ipcache,
+                        const struct oo_sock_cplane* sock_cp)
+{
+  ipcache->status = retrrc_success;
+  ipcache->mtu = MTU;
+  ipcache->intf_i = 0;
+  ipcache->ether_offset = ETH_VLAN_HLEN;
+  memcpy(ipcache->ether_header + ETH_VLAN_HLEN + 2 * ETH_ALEN,
+         &ipcache->ether_type, sizeof(ipcache->ether_type));
+  ipcache->fwd_ver.id = ROUTE_ROW;
+  ipcache->fwd_ver.version = test_cp->mib[0].fwd_table.rows[ROUTE_ROW].version;
+  ipcache->fwd_ver_init_net.id = CICP_MAC_ROWID_UNUSED;
+}
+
+void ci_netif_unlock(ci_netif* ni)
+{
+  CHECK(ni, ==, test_ni);
+  CHECK_TRUE(ci_netif_is_locked(ni));
+  ni->state->lock.lock = 0;
+}
+
+ci_fd_t ci_tcp_helper_get_sock_fd(ci_fd_t fd)
+{
+  return OS_SOCK;
+}
+
+int ci_tcp_helper_rel_sock_fd(ci_fd_t fd)
+{
+  CHECK(fd, ==, OS_SOCK);
+  return 0;
+}
+
+static int fake_setsockopt(int fd, int level, int optname,
+                           const void* optval, socklen_t optlen)
+{
+  CHECK(fd, ==, OS_SOCK);
+  return 0;
+}
+
+int (*ci_sys_setsockopt)(int, int, int, const void*, socklen_t) =
+  fake_setsockopt;
+int (*ci_sys_bind)(int, const struct sockaddr*, socklen_t);
+int (*ci_sys_getsockname)(int, struct sockaddr*, socklen_t*);
+
+
+/* Test fixtures */
+
+/* Creates a socket from an endpoint buffer which last held [stale], and
+ * connects it. */
+static void setup(ci_uint8 stale)
+{
+  int i;
+
+  test_ni = calloc(1, sizeof(*test_ni));
+  test_ni->state = calloc(1, sizeof(*test_ni->state));
+  test_ni->packets = calloc(1, sizeof(*test_ni->packets));
+  *(ci_int32*) &test_ni->packets->n_pkts_allocated = N_PKTS;
+  /* The packet filler finds the end of a buffer by alignment. */
+  test_pkt_set = aligned_alloc(CI_CFG_PKT_BUF_SIZE,
+                               N_PKTS * CI_CFG_PKT_BUF_SIZE);
+  memset(test_pkt_set, 0, N_PKTS * CI_CFG_PKT_BUF_SIZE);
+  test_ni->pkt_bufs = (ci_pkt_bufs*) &test_pkt_set;
+  for( i = 0; i < N_PKTS; ++i )
+    OO_PKT_PP_INIT(PKT(test_ni, i), i);
+  NI_OPTS(test_ni).udp_sndbuf_def = 1 << 24;
+  NI_OPTS(test_ni).udp_send_unlock_thresh = 1500;
+
+  test_cp = calloc(1, sizeof(*test_cp));
+  test_cp->mib[0].fwd_table.rows = calloc(N_ROWS, sizeof(struct cp_fwd_row));
+  test_cp->mib[0].fwd_table.rw_rows = calloc(N_ROWS,
+                                             sizeof(struct cp_fwd_rw_row));
+  test_cp->mib[0].fwd_table.mask = N_ROWS - 1;
+  test_cp->mib[0].fwd_table.rows[ROUTE_ROW].version = 2;
+  test_ni->cplane = test_cp;
+
+  test_wo = malloc(sizeof(*test_wo));
+  memset(test_wo, stale, sizeof(*test_wo));
+  memset(&test_wo->waitable, 0, sizeof(test_wo->waitable));
+  test_us = ci_udp_get_state_buf(test_ni);
+  CHECK(test_us, ==, &test_wo->udp);
+
+  /* As ci_udp_ep_ctor() and connect() leave it */
+  test_us->s.rx_errno = 0;
+  test_us->s.tx_errno = 0;
+  test_us->s.so_error = 0;
+  test_us->s.s_flags |= CI_SOCK_FLAG_CONNECTED;
+  ci_ipcache_set_daddr(&test_us->s.pkt,
+                       CI_ADDR_FROM_IP4(CI_BSWAPC_BE32(0x0a000002)));
+  udp_lport_be16(test_us) = CI_BSWAPC_BE16(1234);
+  udp_rport_be16(test_us) = CI_BSWAPC_BE16(5678);
+  test_ep.netif = test_ni;
+  test_ep.s = &test_us->s;
+
+  for( i = 0; i < sizeof(payload); ++i )
+    payload[i] = i / 1000 + 1;
+  n_allocated = 0;
+  n_freed = 0;
+  n_sent = 0;
+}
+
+static void teardown(void)
+{
+  CHECK(n_freed, ==, n_allocated);
+  CHECK_FALSE(ci_netif_is_locked(test_ni));
+  free(test_wo);
+  free(test_cp->mib[0].fwd_table.rw_rows);
+  free(test_cp->mib[0].fwd_table.rows);
+  free(test_cp);
+  free(test_pkt_set);
+  free(test_ni->packets);
+  free(test_ni->state);
+  free(test_ni);
+}
+
+static int set_gso_size(int v)
+{
+  return ci_udp_setsockopt(&test_ep, 0, IPPROTO_UDP, UDP_SEGMENT,
+                           &v, sizeof(v));
+}
+
+static int get_gso_size(void)
+{
+  int v = -1;
+  socklen_t len = sizeof(v);
+  int rc = ci_udp_getsockopt(&test_ep, 0, IPPROTO_UDP, UDP_SEGMENT,
+                             &v, &len);
+  CHECK(rc, ==, 0);
+  CHECK(len, ==, sizeof(v));
+  return v;
+}
+
+/* Sends [len] bytes of [payload], with a UDP_SEGMENT control message if
+ * [cmsg_gso_size] is not zero. */
+static int udp_send(int len, ci_uint16 cmsg_gso_size)
+{
+  char cbuf[CMSG_SPACE(sizeof(ci_uint16))];
+  struct msghdr msg;
+  struct cmsghdr* cm;
+  struct iovec iov;
+  ci_udp_iomsg_args a;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = payload;
+  iov.iov_len = len;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if( cmsg_gso_size != 0 ) {
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = IPPROTO_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(ci_uint16));
+    memcpy(CMSG_DATA(cm), &cmsg_gso_size, sizeof(cmsg_gso_size));
+  }
+  memset(&a, 0, sizeof(a));
+  a.ni = test_ni;
+  a.us = test_us;
+  a.ep = &test_ep;
+  return ci_udp_sendmsg(&a, &msg, 0);
+}
+
+/* Checks that datagram [i] carried [len] bytes from offset [off]. */
+static void check_sent(int i, int len, int off)
+{
+  CHECK(sent[i].udp_len, ==, len + sizeof(ci_udp_hdr));
+  CHECK(sent[i].ip_len, ==, len + sizeof(ci_udp_hdr) + sizeof(ci_ip4_hdr));
+  CHECK(sent[i].frag_off, ==, 0);
+  CHECK(sent[i].first_byte, ==, payload[off]);
+}
+
+
+/* The option is set and read back, and bad values are refused. */
+static void test_gso_sockopt(void)
+{
+  setup(0);
+  CHECK(get_gso_size(), ==, 0);
+  CHECK(set_gso_size(1000), ==, 0);
+  CHECK(get_gso_size(), ==, 1000);
+  CHECK(test_us->gso_size, ==, 1000);
+  CHECK(set_gso_size(-1), ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(set_gso_size(0x10000), ==, -1);
+  CHECK(get_gso_size(), ==, 1000);
+  CHECK(set_gso_size(0), ==, 0);
+  CHECK(get_gso_size(), ==, 0);
+  teardown();
+}
+
+/* A send larger than the segment size goes as a train of datagrams of that
+ * size, the last one shorter. */
+static void test_gso_train(void)
+{
+  int rc;
+
+  setup(0);
+  CHECK(set_gso_size(1000), ==, 0);
+  rc = udp_send(2500, 0);
+  CHECK(rc, ==, 2500);
+  CHECK(n_sent, ==, 3);
+  check_sent(0, 1000, 0);
+  check_sent(1, 1000, 1000);
+  check_sent(2, 500, 2000);
+  CHECK(test_us->stats.n_tx_gso, ==, 1);
+  CHECK(test_us->stats.n_tx_gso_segs, ==, 3);
+
+  /* A send no larger than the segment size is a single datagram. */
+  n_sent = 0;
+  rc = udp_send(1000, 0);
+  CHECK(rc, ==, 1000);
+  CHECK(n_sent, ==, 1);
+  check_sent(0, 1000, 0);
+  CHECK(test_us->stats.n_tx_gso, ==, 1);
+  teardown();
+}
+
+/* The control message overrides the socket option for one send. */
+static void test_gso_cmsg(void)
+{
+  int rc;
+
+  setup(0);
+  rc = udp_send(1200, 400);
+  CHECK(rc, ==, 1200);
+  CHECK(n_sent, ==, 3);
+  check_sent(0, 400, 0);
+  check_sent(1, 400, 400);
+  check_sent(2, 400, 800);
+  CHECK(test_us->gso_size, ==, 0);
+
+  n_sent = 0;
+  rc = udp_send(1200, 0);
+  CHECK(rc, ==, 1200);
+  CHECK(n_sent, ==, 1);
+  check_sent(0, 1200, 0);
+  teardown();
+}
+
+/* Trains of too many segments, or of segments which do not fit the path
+ * MTU, are refused and send nothing. */
+static void test_gso_limits(void)
+{
+  int rc;
+
+  setup(0);
+  CHECK(set_gso_size(1000), ==, 0);
+  rc = udp_send(64 * 1000 + 1, 0);
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(n_sent, ==, 0);
+  CHECK(set_gso_size(MTU), ==, 0);
+  rc = udp_send(2 * MTU, 0);
+  CHECK(rc, ==, -1);
+  CHECK(errno, ==, EINVAL);
+  CHECK(n_sent, ==, 0);
+  CHECK(n_allocated, ==, 0);
+  teardown();
+}
+
+/* A new socket made from a buffer which held another socket does not
+ * segment its sends, whatever was left in the buffer. */
+static void test_gso_fresh_socket(void)
+{
+  int rc;
+
+  setup(0xff);
+  CHECK(get_gso_size(), ==, 0);
+  rc = udp_send(1200, 0);
+  CHECK(rc, ==, 1200);
+  CHECK(n_sent, ==, 1);
+  check_sent(0, 1200, 0);
+  CHECK(test_us->stats.n_tx_gso, ==, 0);
+  teardown();
+
+  setup(0x01);
+  CHECK(get_gso_size(), ==, 0);
+  rc = udp_send(1200, 0);
+  CHECK(rc, ==, 1200);
+  CHECK(n_sent, ==, 1);
+  teardown();
+}
+
+int main(void)
+{
+  TEST_RUN(test_gso_sockopt);
+  TEST_RUN(test_gso_train);
+  TEST_RUN(test_gso_cmsg);
+  TEST_RUN(test_gso_limits);
+  TEST_RUN(test_gso_fresh_socket);
+  TEST_END();
+}
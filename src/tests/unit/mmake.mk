@@ -13,8 +13,21 @@ UNIT_TEST_WRAPPER ?=
 # In principle, this could be autogenerated by searching the source directory.
 ALL_UNIT_TESTS := \
   header/ci/internal/ip_timestamp \
+  lib/citools/crc32 \
+  lib/citools/csum_copy_simd \
+  lib/transport/ip/cluster_steer \
+  lib/transport/ip/ip_reasm \
+  lib/transport/ip/ip_tx \
   lib/transport/ip/netif_init \
+  lib/transport/ip/tcp_cong \
+  lib/transport/ip/tcp_rack \
   lib/transport/ip/tcp_rx \
+  lib/transport/ip/tcp_send \
+  lib/transport/ip/tcp_syncookie \
+  lib/transport/ip/tcpdump_filter \
+  lib/transport/ip/tx_pacing \
+  lib/transport/ip/udp_recv \
+  lib/transport/ip/udp_send \
 
 # The tests to be run, and their corresponding files
 TESTS := $(filter $(UNIT_TEST_FILTER)%, $(ALL_UNIT_TESTS))
@@ -23,7 +36,8 @@ OBJECTS := $(TESTS:%=%.o)
 PASSED := $(TESTS:%=%.passed)
 
 # Library objects names are mangled with a prefix. Deal with that madness here.
-LIB_PREFIXES := lib/transport/common/ci_tp_common_ lib/transport/ip/ci_ip_
+LIB_PREFIXES := lib/citools/ci_tools_ lib/transport/common/ci_tp_common_ \
+                lib/transport/ip/ci_ip_
 
 lib_prefix = $(notdir $(filter $(dir $(1))%,$(LIB_PREFIXES)))
 lib_object = ../../$(dir $(1))$(call lib_prefix,$(1))$(notdir $(1)).o
@@ -62,6 +76,29 @@ NO_PIE = $(shell echo 'int main(void){return 0;}' | \
 # invididual test without waiting for several seconds of flappery first.
 $(TARGETS): MMAKE_DIR_LINKFLAGS += -Wl,--unresolved-symbols=ignore-all $(NO_PIE)
 $(filter lib/%, $(TARGETS)): $$(call lib_object,$$@)
+lib/citools/crc32: ../../lib/citools/ci_tools_cpu_features.o
+# The vector checksum kernels choose themselves using the CPU feature checks,
+# and are also tested through the generic checksum entry points.
+lib/citools/csum_copy_simd: ../../lib/citools/ci_tools_cpu_features.o \
+  ../../lib/citools/ci_tools_csum_copy2.o \
+  ../../lib/citools/ci_tools_ip_csum_partial.o
+# The congestion control algorithms are referenced through a table.
+lib/transport/ip/tcp_rx: ../../lib/transport/ip/ci_ip_tcp_cong.o
+# Zero-copy completions are read back by the receive path, and released
+# when the socket drops them.
+lib/transport/ip/tcp_send: ../../lib/transport/ip/ci_ip_tcp_recv.o \
+  ../../lib/transport/ip/ci_ip_ip_cmsg.o \
+  ../../lib/transport/ip/ci_ip_tcp_misc.o
+# SO_MAX_PACING_RATE is checked through the setsockopt handler.
+lib/transport/ip/tx_pacing: ../../lib/transport/ip/ci_ip_common_sockopts.o
+# The UDP_GRO segment size is reported with the other control messages.
+lib/transport/ip/udp_recv: ../../lib/transport/ip/ci_ip_ip_cmsg.o
+# UDP_SEGMENT is set on a new socket and given per send.
+lib/transport/ip/udp_send: ../../lib/transport/ip/ci_ip_udp.o \
+  ../../lib/transport/ip/ci_ip_udp_sockopts.o \
+  ../../lib/transport/ip/ci_ip_ip_cmsg.o \
+  ../../lib/transport/ip/ci_ip_pkt_filler.o \
+  ../../lib/transport/ip/ci_ip_tcp_tx.o
 $(TARGETS): %: %.o stubs.o
 	$(MMakeLinkCApp)
 
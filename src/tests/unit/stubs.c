@@ -10,6 +10,8 @@ __attribute__ ((weak)) unsigned ci_tp_log = 0;
 __attribute__ ((weak)) unsigned ci_tp_max_dump = 0;
 __attribute__ ((weak)) void (*ci_log_fn)(const char* msg) = NULL;
 __attribute__ ((weak)) int  (*ci_sys_ioctl)(int, long unsigned int, ...) = NULL;
+__attribute__ ((weak)) int  (*ci_sys_getsockopt)(int, int, int, void*,
+                                                 unsigned*) = NULL;
 
 /* Allow the unit under test to call ci_log (with no effect) */
 __attribute__ ((weak)) void ci_log(const char* fmt, ...) {}
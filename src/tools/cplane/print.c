@@ -85,6 +85,11 @@ print_route_table(struct cp_session* s, struct cp_route_table** tables)
     for( table = tables[i];
          table != NULL; table = table->next ) {
       cp_print(s, "Route table %d:", table->id);
+      if( table->lpm_valid )
+        cp_print(s, "  prefix trie nodes/keys: %d / %d",
+                 table->lpm.n_nodes, table->lpm.n_keys);
+      else
+        cp_print(s, "  prefix trie: invalid, using linear lookup");
       cp_ippl_print(s, &table->routes, print_route);
     }
   }
@@ -38,6 +38,7 @@
 #include <cplane/ioctl.h>
 #include "mask.h"
 #include "ip_prefix_list.h"
+#include "route_lpm.h"
 
 /* CP_FWD_FLAG_* flags
  * Definitions are in:
@@ -325,6 +326,11 @@ struct cp_route {
 struct cp_route_table {
   uint32_t id;
   struct cp_ip_prefix_list routes;
+  /* Longest-prefix-match index of the routes above.  If we failed to
+   * allocate memory for it, lpm_valid is false and lookups fall back to
+   * the linear scan until the next route dump rebuilds it. */
+  struct cp_route_lpm lpm;
+  bool lpm_valid;
   struct cp_route_table* next;
 };
 
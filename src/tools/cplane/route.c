@@ -290,6 +290,65 @@ cp_route_entry_from_dst(struct cp_ip_with_prefix* dst)
   return CI_CONTAINER(struct cp_route, dst, dst);
 }
 
+static void
+cp_route_lpm_key_from_route(const struct cp_route* route,
+                            struct cp_route_lpm_key* key)
+{
+  key->metric = route->metric;
+  key->scope = route->scope;
+  key->tos = route->tos;
+  key->refs = 0;
+}
+
+static void
+cp_route_lpm_add_entry(struct cp_session* s, struct cp_route_table* table,
+                       const struct cp_route* entry)
+{
+  struct cp_route_lpm_key key;
+
+  if( ! table->lpm_valid )
+    return;
+  cp_route_lpm_key_from_route(entry, &key);
+  if( ! cp_route_lpm_insert(&table->lpm, entry->dst.addr, entry->dst.prefix,
+                            &key) ) {
+    /* Fall back to the linear scan until the next route dump. */
+    cp_route_lpm_clear(&table->lpm);
+    table->lpm_valid = false;
+    s->stats.route.lpm_nomem++;
+  }
+}
+
+/* Remove a route entry from the table and from its prefix trie.  The
+ * entry must be a member of table->routes. */
+static void
+cp_route_table_del_entry(struct cp_route_table* table,
+                         struct cp_route* entry)
+{
+  if( table->lpm_valid ) {
+    struct cp_route_lpm_key key;
+    cp_route_lpm_key_from_route(entry, &key);
+    cp_route_lpm_remove(&table->lpm, entry->dst.addr, entry->dst.prefix,
+                        &key);
+  }
+  cp_ippl_del(&table->routes, &entry->dst);
+}
+
+/* Re-create the prefix trie from the route list.  Used when a lot of
+ * entries are removed at once, i.e. at the end of the route dump. */
+static void
+cp_route_lpm_rebuild(struct cp_session* s, struct cp_route_table* table)
+{
+  int id;
+
+  cp_route_lpm_clear(&table->lpm);
+  table->lpm_valid = true;
+  for( id = 0; id < table->routes.used && table->lpm_valid; id++ ) {
+    struct cp_ip_with_prefix* ipp = cp_ippl_entry(&table->routes, id);
+    if( ipp->sort_by >= 0 )
+      cp_route_lpm_add_entry(s, table, cp_route_entry_from_dst(ipp));
+  }
+}
+
 static bool
 cp_route_del(struct cp_session* s, uint32_t table_id,
              struct cp_route* route, int af)
@@ -314,7 +373,7 @@ cp_route_del(struct cp_session* s, uint32_t table_id,
     if( ! multipath )
       multipath = cp_route_entry_from_dst(dst)->weight.end != 0;
 
-    cp_ippl_del(&table->routes, dst);
+    cp_route_table_del_entry(table, cp_route_entry_from_dst(dst));
     changed = true;
     if( s->flags & CP_SESSION_LADDR_USE_PREF_SRC )
       s->flags |= CP_SESSION_LADDR_REFRESH_NEEDED;
@@ -349,6 +408,8 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
     table->id = table_id;
     cp_ippl_init(&table->routes, sizeof(struct cp_route),
                  cp_route_compare, 4);
+    cp_route_lpm_init(&table->lpm, af);
+    table->lpm_valid = true;
     if( cp_routes_under_dump(s,af) )
       cp_ippl_start_dump(&table->routes);
     table->next =
@@ -370,6 +431,9 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
   struct cp_route* entry = cp_route_entry_by_idx(table, idx);
   bool key_changed = changed;
 
+  if( key_changed )
+    cp_route_lpm_add_entry(s, table, entry);
+
   if( ! changed ) {
     /* Update route data if needed and return */
     if( memcmp(&entry->data, &route->data, sizeof(route->data)) != 0 ||
@@ -431,13 +495,13 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
     if( t->weight.end == 0 ) {
       /* Non-multipath entry is definitely wrong, and definitely the
        * only one. */
-      cp_ippl_del(&table->routes, &t->dst);
+      cp_route_table_del_entry(table, t);
       key_changed = true;
       break;
     }
     if( t->weight.end <= entry->weight.end - entry->weight.val )
       break;
-    cp_ippl_del(&table->routes, &t->dst);
+    cp_route_table_del_entry(table, t);
     key_changed = true;
   }
 
@@ -449,7 +513,7 @@ cp_route_add(struct cp_session* s, uint32_t table_id,
       struct cp_route* t = cp_route_entry_by_idx(table, id);
       if( cp_route_cmp_multipath(entry, t) != 0 )
         break;
-      cp_ippl_del(&table->routes, &t->dst);
+      cp_route_table_del_entry(table, t);
       key_changed = true;
     }
   }
@@ -611,8 +675,8 @@ cp_nl_route_table_update(struct cp_session* s, struct nlmsghdr* nlhdr,
 }
 
 static struct cp_route *
-cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
-              struct cp_route_table* table, int af)
+cp_route_find_linear(struct cp_session* s, struct cp_fwd_key* key,
+                     struct cp_route_table* table, int af)
 {
   struct cp_ip_with_prefix* ipp = NULL;
   struct cp_route *route = NULL;
@@ -634,6 +698,72 @@ cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
   return route;
 }
 
+/* Find the best route via the prefix trie.  The trie gives us the
+ * destination prefix and the metric/scope/tos of the best route; then we
+ * look up the route entry itself in the sorted route list.  For multipath
+ * routes we return the first path, as the linear scan does. */
+static struct cp_route *
+cp_route_find_lpm(struct cp_route_table* table, struct cp_fwd_key* key)
+{
+  const struct cp_route_lpm_node* node;
+  struct cp_route_lpm_key lpm_key;
+  struct cp_route probe;
+  struct cp_ip_with_prefix* ipp;
+  int idx;
+
+  node = cp_route_lpm_find(&table->lpm, key->dst, key->tos, &lpm_key);
+  if( node == NULL )
+    return NULL;
+
+  memset(&probe, 0, sizeof(probe));
+  probe.dst.addr = node->addr;
+  probe.dst.prefix = node->prefix;
+  probe.metric = lpm_key.metric;
+  probe.scope = lpm_key.scope;
+  probe.tos = lpm_key.tos;
+  ipp = __cp_ippl_search(&table->routes, &probe.dst, cp_route_cmp_multipath);
+  if( ipp == NULL )
+    return NULL;
+
+  idx = cp_ippl_idx(&table->routes, ipp);
+  while( idx > 0 && idx < table->routes.sorted &&
+         cp_route_cmp_multipath(&probe,
+                                cp_route_entry_by_idx(table, idx - 1)) == 0 )
+    idx--;
+  return cp_route_entry_by_idx(table, idx);
+}
+
+static struct cp_route *
+cp_route_find(struct cp_session* s, struct cp_fwd_key* key,
+              struct cp_route_table* table, int af)
+{
+  struct cp_route *route;
+
+  if( ! table->lpm_valid )
+    return cp_route_find_linear(s, key, table, af);
+
+  route = cp_route_find_lpm(table, key);
+
+  /* The linear scan gives the same answer as long as the route list is
+   * sorted, i.e. not under dump. */
+  if( (s->flags & CP_SESSION_VERIFY_ROUTES) && ! table->routes.in_dump ) {
+    struct cp_route *route1 = cp_route_find_linear(s, key, table, af);
+    if( route != route1 ) {
+      ci_log("%s ERROR: "CP_FWD_KEY_FMT" table %d: trie found %s/%d, "
+             "linear scan found %s/%d", __func__, CP_FWD_KEY_ARGS(key),
+             table->id,
+             AF_IP_L3(route == NULL ? addr_sh_any : route->dst.addr),
+             route == NULL ? -1 : route->dst.prefix,
+             AF_IP_L3(route1 == NULL ? addr_sh_any : route1->dst.addr),
+             route1 == NULL ? -1 : route1->dst.prefix);
+      s->stats.route.lpm_mismatch++;
+      route = route1;
+    }
+  }
+
+  return route;
+}
+
 /* This function finds the preferred source address for a given route.
  * It is not needed in normal case, but we have to do it in multipath case.
  * This function is also used in --verify-routes mode, which exists solely
@@ -2720,7 +2850,10 @@ void cp_route_dump_done(struct cp_session* s, int af)
   for( i = 0; i < ROUTE_TABLE_HASH_SIZE; i++ ) {
     struct cp_route_table* table;
     for( table = tables[i]; table != NULL; table = table->next ) {
-      if( cp_ippl_finalize(s, &table->routes, NULL) ) {
+      bool removed = cp_ippl_finalize(s, &table->routes, NULL);
+      if( removed || ! table->lpm_valid )
+        cp_route_lpm_rebuild(s, table);
+      if( removed ) {
         s->flags |= CP_SESSION_FLAG_FWD_REFRESH_NEEDED |
                     CP_SESSION_FLAG_FWD_PREFIX_CHECK_NEEDED;
         s->flags &=~ CP_SESSION_FLAG_FWD_REFRESHED;
@@ -0,0 +1,263 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+#include <ci/compat.h>
+
+#include "private.h"
+#include "route_lpm.h"
+
+
+/* Bit number "bit" of the address, counting from the most significant
+ * bit of the network-order address. */
+static inline int
+cp_route_lpm_bit(int af, const ci_addr_sh_t* addr, int bit)
+{
+  const uint8_t* bytes = af == AF_INET6 ? (const uint8_t*)addr->ip6 :
+                                          (const uint8_t*)&addr->ip4;
+  return (bytes[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/* Length of the common prefix of two addresses, capped by "max". */
+static cicp_prefixlen_t
+cp_route_lpm_common(int af, ci_addr_sh_t a, ci_addr_sh_t b,
+                    cicp_prefixlen_t max)
+{
+  ci_addr_sh_t x = ci_ipx_addr_xor(af, &a, &b);
+  cicp_prefixlen_t len;
+
+  if( CI_IPX_ADDR_IS_ANY(x) )
+    return max;
+  len = cp_ipx_clz(af, x);
+  return CI_MIN(len, max);
+}
+
+static struct cp_route_lpm_node*
+cp_route_lpm_node_alloc(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                        cicp_prefixlen_t prefix)
+{
+  struct cp_route_lpm_node* node = calloc(1, sizeof(*node));
+  if( node == NULL )
+    return NULL;
+  node->addr = addr;
+  node->prefix = prefix;
+  lpm->n_nodes++;
+  return node;
+}
+
+static void
+cp_route_lpm_node_free(struct cp_route_lpm* lpm,
+                       struct cp_route_lpm_node* node)
+{
+  lpm->n_keys -= node->n_keys;
+  lpm->n_nodes--;
+  free(node->keys);
+  free(node);
+}
+
+static void
+cp_route_lpm_free_subtree(struct cp_route_lpm* lpm,
+                          struct cp_route_lpm_node* node)
+{
+  if( node == NULL )
+    return;
+  cp_route_lpm_free_subtree(lpm, node->child[0]);
+  cp_route_lpm_free_subtree(lpm, node->child[1]);
+  cp_route_lpm_node_free(lpm, node);
+}
+
+void cp_route_lpm_clear(struct cp_route_lpm* lpm)
+{
+  cp_route_lpm_free_subtree(lpm, lpm->root);
+  lpm->root = NULL;
+  ci_assert_equal(lpm->n_nodes, 0);
+  ci_assert_equal(lpm->n_keys, 0);
+}
+
+/* Same ordering as cp_route_cmp_multipath() for routes with the same
+ * destination. */
+static int
+cp_route_lpm_key_cmp(const struct cp_route_lpm_key* a,
+                     const struct cp_route_lpm_key* b)
+{
+  if( a->metric != b->metric )
+    return a->metric < b->metric ? -1 : 1;
+  if( a->scope != b->scope )
+    return a->scope - b->scope;
+  return b->tos - a->tos;
+}
+
+/* Find the node for exactly this prefix, creating it if necessary. */
+static struct cp_route_lpm_node*
+cp_route_lpm_node_get(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                      cicp_prefixlen_t prefix)
+{
+  struct cp_route_lpm_node** pp = &lpm->root;
+
+  while( *pp != NULL ) {
+    struct cp_route_lpm_node* n = *pp;
+    cicp_prefixlen_t common =
+        cp_route_lpm_common(lpm->af, addr, n->addr,
+                            CI_MIN(prefix, n->prefix));
+
+    if( common < n->prefix ) {
+      /* The new prefix does not go below n: insert it above n, possibly
+       * with a glue node at the branching point. */
+      struct cp_route_lpm_node* new_node;
+
+      if( common == prefix ) {
+        new_node = cp_route_lpm_node_alloc(lpm, addr, prefix);
+        if( new_node == NULL )
+          return NULL;
+        new_node->child[cp_route_lpm_bit(lpm->af, &n->addr, prefix)] = n;
+        *pp = new_node;
+        return new_node;
+      }
+
+      struct cp_route_lpm_node* glue =
+          cp_route_lpm_node_alloc(lpm, addr, common);
+      if( glue == NULL )
+        return NULL;
+      new_node = cp_route_lpm_node_alloc(lpm, addr, prefix);
+      if( new_node == NULL ) {
+        cp_route_lpm_node_free(lpm, glue);
+        return NULL;
+      }
+      glue->child[cp_route_lpm_bit(lpm->af, &addr, common)] = new_node;
+      glue->child[cp_route_lpm_bit(lpm->af, &n->addr, common)] = n;
+      *pp = glue;
+      return new_node;
+    }
+
+    if( n->prefix == prefix )
+      return n;
+    pp = &n->child[cp_route_lpm_bit(lpm->af, &addr, n->prefix)];
+  }
+
+  *pp = cp_route_lpm_node_alloc(lpm, addr, prefix);
+  return *pp;
+}
+
+bool cp_route_lpm_insert(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                         cicp_prefixlen_t prefix,
+                         const struct cp_route_lpm_key* key)
+{
+  struct cp_route_lpm_node* node = cp_route_lpm_node_get(lpm, addr, prefix);
+  int i;
+
+  if( node == NULL )
+    return false;
+
+  /* A glue node may have been created with the address of some longer
+   * prefix; store the real destination address now. */
+  if( node->n_keys == 0 )
+    node->addr = addr;
+
+  for( i = 0; i < node->n_keys; i++ ) {
+    int cmp = cp_route_lpm_key_cmp(key, &node->keys[i]);
+    if( cmp == 0 ) {
+      node->keys[i].refs++;
+      return true;
+    }
+    if( cmp < 0 )
+      break;
+  }
+
+  if( node->n_keys == node->max_keys ) {
+    int max = node->max_keys == 0 ? 1 : node->max_keys * 2;
+    struct cp_route_lpm_key* keys = realloc(node->keys,
+                                            max * sizeof(*keys));
+    if( keys == NULL )
+      return false;
+    node->keys = keys;
+    node->max_keys = max;
+  }
+
+  memmove(&node->keys[i + 1], &node->keys[i],
+          (node->n_keys - i) * sizeof(node->keys[0]));
+  node->keys[i] = *key;
+  node->keys[i].refs = 1;
+  node->n_keys++;
+  lpm->n_keys++;
+  return true;
+}
+
+void cp_route_lpm_remove(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                         cicp_prefixlen_t prefix,
+                         const struct cp_route_lpm_key* key)
+{
+  struct cp_route_lpm_node** pp = &lpm->root;
+  struct cp_route_lpm_node** parent_pp = NULL;
+  struct cp_route_lpm_node* n;
+  int i;
+
+  while( (n = *pp) != NULL && n->prefix < prefix ) {
+    if( ! cp_ipx_ippl_pfx_match(lpm->af, addr, n->addr, n->prefix) )
+      return;
+    parent_pp = pp;
+    pp = &n->child[cp_route_lpm_bit(lpm->af, &addr, n->prefix)];
+  }
+  if( n == NULL || n->prefix != prefix ||
+      ! cp_ipx_ippl_pfx_match(lpm->af, addr, n->addr, prefix) )
+    return;
+
+  for( i = 0; i < n->n_keys; i++ )
+    if( cp_route_lpm_key_cmp(key, &n->keys[i]) == 0 )
+      break;
+  if( i == n->n_keys )
+    return;
+  if( --n->keys[i].refs > 0 )
+    return;
+  memmove(&n->keys[i], &n->keys[i + 1],
+          (n->n_keys - i - 1) * sizeof(n->keys[0]));
+  n->n_keys--;
+  lpm->n_keys--;
+  if( n->n_keys > 0 )
+    return;
+
+  /* The node has become a glue node.  Remove it if it does not branch,
+   * and then remove its parent if the parent is a glue node which no
+   * longer branches. */
+  while( n != NULL && n->n_keys == 0 &&
+         (n->child[0] == NULL || n->child[1] == NULL) ) {
+    *pp = n->child[0] != NULL ? n->child[0] : n->child[1];
+    cp_route_lpm_node_free(lpm, n);
+
+    if( parent_pp == NULL )
+      break;
+    pp = parent_pp;
+    n = *pp;
+    parent_pp = NULL;
+  }
+}
+
+const struct cp_route_lpm_node*
+cp_route_lpm_find(const struct cp_route_lpm* lpm, ci_addr_sh_t dst,
+                  cicp_ip_tos_t tos, struct cp_route_lpm_key* key_out)
+{
+  /* Matching nodes, shortest prefix first.  There can't be more of them
+   * than bits in the address plus the /0 one. */
+  const struct cp_route_lpm_node* match[CI_IPX_MAX_PREFIX_LEN(AF_INET6) + 1];
+  const struct cp_route_lpm_node* n = lpm->root;
+  int n_match = 0;
+  int i;
+
+  while( n != NULL &&
+         cp_ipx_ippl_pfx_match(lpm->af, dst, n->addr, n->prefix) ) {
+    if( n->n_keys > 0 )
+      match[n_match++] = n;
+    if( n->prefix == CI_IPX_MAX_PREFIX_LEN(lpm->af) )
+      break;
+    n = n->child[cp_route_lpm_bit(lpm->af, &dst, n->prefix)];
+  }
+
+  while( n_match-- > 0 ) {
+    n = match[n_match];
+    for( i = 0; i < n->n_keys; i++ ) {
+      if( n->keys[i].tos == 0 || n->keys[i].tos == tos ) {
+        *key_out = n->keys[i];
+        return n;
+      }
+    }
+  }
+
+  return NULL;
+}
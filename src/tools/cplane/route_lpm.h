@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+#ifndef __TOOLS_CPLANE_ROUTE_LPM_H__
+#define __TOOLS_CPLANE_ROUTE_LPM_H__
+
+/* Longest-prefix-match index over a route table.
+ *
+ * The route table itself is a cp_ip_prefix_list sorted by prefix length and
+ * metric, and the entries move whenever the list is re-sorted.  Walking the
+ * list to find the first matching route is O(number of routes), which is
+ * too slow with full BGP tables.  This structure is a path-compressed
+ * binary trie (one per route table, and therefore per address family)
+ * which maps a destination address to the route keys which match it.
+ *
+ * Each trie node represents one destination prefix.  It holds the list of
+ * (metric, scope, tos) keys of the routes with this destination, ordered
+ * in the same way as cp_route_compare() orders them.  Multipath routes
+ * share a key, and are reference-counted.  Nodes without any keys are
+ * "glue" nodes created at the branching points.
+ *
+ * The trie does not point into the route list; the caller uses the key
+ * returned by cp_route_lpm_find() to locate the route entry itself.
+ */
+
+struct cp_route_lpm_key {
+  uint32_t metric;
+  uint8_t scope;
+  cicp_ip_tos_t tos;
+  int refs;   /* number of route entries (multipath legs) with this key */
+};
+
+struct cp_route_lpm_node {
+  ci_addr_sh_t addr;
+  cicp_prefixlen_t prefix;
+  struct cp_route_lpm_node* child[2];
+
+  int n_keys;
+  int max_keys;
+  struct cp_route_lpm_key* keys;
+};
+
+struct cp_route_lpm {
+  int af;
+  struct cp_route_lpm_node* root;
+  int n_nodes;  /* including glue nodes */
+  int n_keys;
+};
+
+static inline void
+cp_route_lpm_init(struct cp_route_lpm* lpm, int af)
+{
+  lpm->af = af;
+  lpm->root = NULL;
+  lpm->n_nodes = 0;
+  lpm->n_keys = 0;
+}
+
+void cp_route_lpm_clear(struct cp_route_lpm* lpm);
+
+/* Returns false if memory allocation failed. */
+bool cp_route_lpm_insert(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                         cicp_prefixlen_t prefix,
+                         const struct cp_route_lpm_key* key);
+void cp_route_lpm_remove(struct cp_route_lpm* lpm, ci_addr_sh_t addr,
+                         cicp_prefixlen_t prefix,
+                         const struct cp_route_lpm_key* key);
+
+/* Find the best route key for the destination: longest prefix first, then
+ * the lowest metric and scope, then the specific TOS before TOS=0.  Routes
+ * with TOS not equal to 0 or to the requested TOS are skipped.
+ *
+ * Returns the node (so that the caller knows the matching prefix) and
+ * fills in *key_out, or returns NULL if nothing matches. */
+const struct cp_route_lpm_node*
+cp_route_lpm_find(const struct cp_route_lpm* lpm, ci_addr_sh_t dst,
+                  cicp_ip_tos_t tos, struct cp_route_lpm_key* key_out);
+
+#endif /*__TOOLS_CPLANE_ROUTE_LPM_H__*/
@@ -85,4 +85,9 @@ CP_STAT("Failed to find any suitable source address", int, no_source)
 CP_STAT("Data mismatch between netlink info and route tables, used when "
         "--verify-routes is specified or multipath route is present",
         int, mismatch)
+CP_STAT("Route lookup via the prefix trie disagrees with the linear scan "
+        "of the route table, checked when --verify-routes is specified",
+        int, lpm_mismatch)
+CP_STAT("Failed to allocate memory for the route prefix trie",
+        int, lpm_nomem)
 CP_STAT_GROUP_END(route)
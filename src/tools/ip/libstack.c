@@ -1333,6 +1333,94 @@ static void stack_more_stats_describe(ci_netif* ni)
   ci_dump_stats(more_stats_fields, N_MORE_STATS_FIELDS, &stats, 1, NULL, NULL);
 }
 
+#if CI_CFG_LATENCY_HIST
+
+static const char* const lat_hist_names[CI_LAT_HIST_N] = {
+  [CI_LAT_HIST_RX] = "rx (arrival to read)",
+  [CI_LAT_HIST_TX] = "tx (send to push)",
+};
+
+static ci_uint64 lat_hist_ns(ci_netif* ni, ci_uint64 ticks)
+{
+  return ticks * 1000000 / IPTIMER_STATE(ni)->khz;
+}
+
+/* Upper bound in ns of the bucket holding the sample [n] in order */
+static ci_uint64 lat_hist_rank_ns(ci_netif* ni, const ci_lat_hist* h,
+                                  ci_uint64 n)
+{
+  ci_uint64 cum = 0;
+  unsigned i;
+
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS - 1; ++i ) {
+    cum += h->bucket[i];
+    if( cum > n )
+      return lat_hist_ns(ni, ci_lat_hist_bucket_lo(i + 1));
+  }
+  return lat_hist_ns(ni, h->max);
+}
+
+static void dump_lat_hist(ci_netif* ni, const char* name,
+                          const ci_lat_hist* hist)
+{
+  static const unsigned pct[] = { 5000, 9000, 9900, 9990, 9999 };
+  ci_lat_hist h;
+  ci_uint64 total = 0, cum = 0;
+  unsigned i;
+
+  /* Written without the stack lock, so take a copy to work on. */
+  memcpy(&h, hist, sizeof(h));
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS; ++i )
+    total += h.bucket[i];
+  ci_log("%s: samples=%llu max=%lluns", name, (unsigned long long) total,
+         (unsigned long long) lat_hist_ns(ni, h.max));
+  if( total == 0 )
+    return;
+
+  for( i = 0; i < sizeof(pct) / sizeof(pct[0]); ++i )
+    ci_log("  p%u.%02u <= %lluns", pct[i] / 100, pct[i] % 100,
+           (unsigned long long)
+           lat_hist_rank_ns(ni, &h, total * pct[i] / 10000));
+
+  ci_log("  %12s %12s %12s %8s", "from_ns", "to_ns", "count", "cum%");
+  for( i = 0; i < CI_LAT_HIST_N_BUCKETS; ++i ) {
+    if( h.bucket[i] == 0 )
+      continue;
+    cum += h.bucket[i];
+    ci_log("  %12llu %12llu %12u %7.3f%%",
+           (unsigned long long) (i == 0 ? 0 :
+                                 lat_hist_ns(ni, ci_lat_hist_bucket_lo(i))),
+           (unsigned long long) (i == CI_LAT_HIST_N_BUCKETS - 1 ?
+                                 lat_hist_ns(ni, h.max) :
+                                 lat_hist_ns(ni, ci_lat_hist_bucket_lo(i + 1))),
+           h.bucket[i], 100.0 * cum / total);
+  }
+}
+
+static void dump_lat_hists(ci_netif* ni, const ci_lat_hist* hists)
+{
+  int i;
+
+  if( ! NI_OPTS(ni).latency_hist )
+    ci_log("EF_LATENCY_HIST is not enabled");
+  for( i = 0; i < CI_LAT_HIST_N; ++i )
+    dump_lat_hist(ni, lat_hist_names[i], &hists[i]);
+}
+
+static void stack_lat_hist(ci_netif* ni)
+{
+  ci_log("-------------------- lat_hist: %d ---------------------------",
+         NI_ID(ni));
+  dump_lat_hists(ni, ni->state->lat_hist);
+}
+
+static void stack_clear_lat_hist(ci_netif* ni)
+{
+  memset(ni->state->lat_hist, 0, sizeof(ni->state->lat_hist));
+}
+
+#endif
+
 #if CI_CFG_SUPPORT_STATS_COLLECTION
 
 static void stack_ip_stats(ci_netif* ni)
@@ -2354,6 +2442,10 @@ static const stack_op_t stack_ops[] = {
   STACK_OP(clear_stats,        "reset stack statistics"),
   STACK_OP(dstats,             "show derived statistics"),
   STACK_OP(more_stats,         "show more stack statistics"),
+#if CI_CFG_LATENCY_HIST
+  STACK_OP(lat_hist,           "show latency histograms"),
+  STACK_OP(clear_lat_hist,     "reset latency histograms"),
+#endif
 #if CI_CFG_SUPPORT_STATS_COLLECTION
   STACK_OP(ip_stats,           "show IP statistics"),
   STACK_OP(tcp_stats,          "show TCP statistics"),
@@ -2480,6 +2572,14 @@ static void socket_qs(ci_netif* ni, ci_tcp_state* ts) {
   ci_tcp_state_dump_qs(ni, S_SP(ts), cfg_dump);
 }
 
+#if CI_CFG_LATENCY_HIST_SOCK
+static void socket_lat_hist(ci_netif* ni, ci_tcp_state* ts) {
+  ci_log("------------------------------------------------------------");
+  ci_log("%d:%d latency histograms", NI_ID(ni), S_SP(ts));
+  dump_lat_hists(ni, ts->s.lat_hist);
+}
+#endif
+
 static void socket_lock(ci_netif* ni, ci_tcp_state* ts)
 { ci_sock_lock(ni, &ts->s.b); }
 
@@ -2793,6 +2893,10 @@ static const socket_op_t socket_ops[] = {
              "try to lock socket"),
   SOCK_OP_F (filters, FL_NO_LOCK,
              "show socket's filter info"),
+#if CI_CFG_LATENCY_HIST_SOCK
+  SOCK_OP_F (lat_hist, FL_NO_LOCK,
+             "show socket's latency histograms"),
+#endif
   SOCK_OP_A (ul_poll, FL_NO_LOCK | FL_ARG_U,
              "set user level polling cycles option", "<ul_poll>", 1),
   TCPC_OP   (nodelay,
@@ -54,6 +54,17 @@ static int cfg_dump_no_match_only = 0;
 static const char *cfg_precision = "micro";
 static int do_nano = 0;
 
+/* Packet filter.  It is installed in each stack, which only queues packets
+ * that match, unless it is too long, when it is applied here instead
+ * before packets are copied out. */
+static const char *cfg_pkt_filter = NULL;
+static struct bpf_program filter_prog;
+static int filter_in_stack = 0;
+
+/* Output format and timestamps */
+static int cfg_pcapng = 0;
+static int cfg_hw_tstamp = 0;
+
 /* Interface to dump */
 static const char *cfg_interface = "any";
 static int cfg_ifindex = -1;
@@ -87,6 +98,13 @@ static ci_cfg_desc cfg_opts[] = {
                            "dump only packets not matching onload sockets"},
   {  2, "time-stamp-precision", CI_CFG_STR, &cfg_precision,
                  "set the timestamp precision, default to \"micro\", man tcpdump"},
+  {  3, "filter",    CI_CFG_STR,  &cfg_pkt_filter,
+                 "dump only packets matching this pcap filter expression"},
+  {  4, "pcapng",    CI_CFG_FLAG, &cfg_pcapng,
+                 "write pcapng, with a block for each stack's interfaces and "
+                 "nanosecond timestamps"},
+  {  5, "hw-timestamps", CI_CFG_FLAG, &cfg_hw_tstamp,
+                 "use the NIC's timestamp for packets which have one"},
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
@@ -190,6 +208,21 @@ static void pkt_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
 }
 
 
+/* Timestamp for the dump: the NIC's if asked for and the packet has one,
+ * otherwise the time at which Onload handled it. */
+static void pkt_dump_tstamp(const ci_ip_pkt_fmt* pkt, struct timespec* ts_out)
+{
+#if CI_CFG_TIMESTAMPING
+  if( cfg_hw_tstamp && pkt->hw_stamp.tv_sec != 0 ) {
+    ts_out->tv_sec = pkt->hw_stamp.tv_sec;
+    ts_out->tv_nsec = pkt->hw_stamp.tv_nsec & ~CI_IP_PKT_HW_STAMP_FLAG_IN_SYNC;
+    return;
+  }
+#endif
+  pkt_tstamp(pkt, ts_out);
+}
+
+
 static inline ci_uint8 dump_hwport_val_get(void) {
   return cfg_dump_no_match_only ? OO_INTF_I_DUMP_NO_MATCH :
                                   OO_INTF_I_DUMP_ALL;
@@ -244,6 +277,257 @@ suicide:
   exit(1);
 }
 
+/* Dump and flush dumped data */
+static void dump_data(const void *data, size_t size)
+{
+  if( fwrite(data, size, 1, stdout) != 1 ) {
+    ci_log("Failed to dump packet data to stdout");
+    exit(1);
+  }
+}
+static void dump_flush(void)
+{
+  if( fflush(stdout) == EOF ) {
+    ci_log("Failed to flush stdout");
+    exit(1);
+  }
+}
+
+
+/* pcapng output.  Each (stack, intf_i) pair is a pcapng interface, whose
+ * description block is written before its first packet. */
+#define PCAPNG_BT_SHB           0x0A0D0D0A
+#define PCAPNG_BT_IDB           0x00000001
+#define PCAPNG_BT_EPB           0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_END          0
+#define PCAPNG_OPT_IF_NAME      2
+#define PCAPNG_OPT_IF_TSRESOL   9
+#define PCAPNG_PAD(len)         (((len) + 3) & ~3)
+
+struct pcapng_block_hdr {
+  ci_uint32 type;
+  ci_uint32 len;
+};
+
+struct pcapng_epb_hdr {
+  struct pcapng_block_hdr bh;
+  ci_uint32 if_id;
+  ci_uint32 ts_high;
+  ci_uint32 ts_low;
+  ci_uint32 caplen;
+  ci_uint32 len;
+};
+
+/* Interface ids, indexed by stack_id * OO_INTF_I_NUM + intf_i, or -1 */
+static int* pcapng_if_ids;
+static unsigned pcapng_if_ids_n;
+static int pcapng_n_ifs;
+
+
+static void write_pcapng_shb(void)
+{
+  struct {
+    struct pcapng_block_hdr bh;
+    ci_uint32 magic;
+    ci_uint16 version_major;
+    ci_uint16 version_minor;
+    ci_uint32 section_len[2];
+    ci_uint32 len;
+  } shb = {
+    .bh = { PCAPNG_BT_SHB, sizeof(shb) },
+    .magic = PCAPNG_BYTE_ORDER_MAGIC,
+    .version_major = 1,
+    .version_minor = 0,
+    .section_len = { 0xffffffff, 0xffffffff },  /* unknown */
+    .len = sizeof(shb),
+  };
+  CI_BUILD_ASSERT(sizeof(shb) == 28);
+  dump_data(&shb, sizeof(shb));
+}
+
+
+static int pcapng_opt(char* buf, ci_uint16 code, const void* val,
+                      ci_uint16 len)
+{
+  memcpy(buf, &code, 2);
+  memcpy(buf + 2, &len, 2);
+  memcpy(buf + 4, val, len);
+  memset(buf + 4 + len, 0, PCAPNG_PAD(len) - len);
+  return 4 + PCAPNG_PAD(len);
+}
+
+
+static void write_pcapng_idb(ci_netif* ni, int intf_i)
+{
+  struct {
+    struct pcapng_block_hdr bh;
+    ci_uint16 linktype;
+    ci_uint16 reserved;
+    ci_uint32 snaplen;
+  } idb;
+  char name[CI_CFG_STACK_NAME_LEN + 32];
+  char opts[sizeof(name) + 16];
+  ci_uint8 tsresol = 9;  /* nanoseconds */
+  ci_uint32 len;
+  int n = 0;
+
+  if( intf_i == OO_INTF_I_LOOPBACK )
+    snprintf(name, sizeof(name), "%s/lo", ni->state->name);
+  else if( intf_i == OO_INTF_I_SEND_VIA_OS )
+    snprintf(name, sizeof(name), "%s/os", ni->state->name);
+  else
+    snprintf(name, sizeof(name), "%s/%s", ni->state->name,
+             ni->state->nic[intf_i].dev_name);
+  n += pcapng_opt(opts + n, PCAPNG_OPT_IF_NAME, name, strlen(name));
+  n += pcapng_opt(opts + n, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1);
+  n += pcapng_opt(opts + n, PCAPNG_OPT_END, NULL, 0);
+
+  len = sizeof(idb) + n + sizeof(len);
+  idb.bh.type = PCAPNG_BT_IDB;
+  idb.bh.len = len;
+  idb.linktype = DLT_EN10MB;
+  idb.reserved = 0;
+  idb.snaplen = cfg_snaplen;
+  dump_data(&idb, sizeof(idb));
+  dump_data(opts, n);
+  dump_data(&len, sizeof(len));
+}
+
+
+static int pcapng_if_id(ci_netif* ni, int intf_i)
+{
+  unsigned i = ni->state->stack_id * OO_INTF_I_NUM + intf_i;
+
+  ci_assert_lt((unsigned) intf_i, OO_INTF_I_NUM);
+
+  if( i >= pcapng_if_ids_n ) {
+    unsigned n = (ni->state->stack_id + 1) * OO_INTF_I_NUM;
+    int* ids = realloc(pcapng_if_ids, n * sizeof(*ids));
+    if( ids == NULL ) {
+      ci_log("Out of memory");
+      exit(1);
+    }
+    memset(ids + pcapng_if_ids_n, 0xff,
+           (n - pcapng_if_ids_n) * sizeof(*ids));
+    pcapng_if_ids = ids;
+    pcapng_if_ids_n = n;
+  }
+  if( pcapng_if_ids[i] < 0 ) {
+    write_pcapng_idb(ni, intf_i);
+    pcapng_if_ids[i] = pcapng_n_ifs++;
+  }
+  return pcapng_if_ids[i];
+}
+
+
+static void pcapng_forget_stack(unsigned stack_id)
+{
+  unsigned i = stack_id * OO_INTF_I_NUM;
+  if( i < pcapng_if_ids_n )
+    memset(pcapng_if_ids + i, 0xff, OO_INTF_I_NUM * sizeof(*pcapng_if_ids));
+}
+
+
+static void write_pcapng_epb_hdr(ci_netif* ni, int intf_i,
+                                 const struct timespec* ts,
+                                 int caplen, int len)
+{
+  struct pcapng_epb_hdr epb;
+  ci_uint64 ns = (ci_uint64) ts->tv_sec * 1000000000 + ts->tv_nsec;
+
+  epb.if_id = pcapng_if_id(ni, intf_i);
+  epb.bh.type = PCAPNG_BT_EPB;
+  epb.bh.len = sizeof(epb) + PCAPNG_PAD(caplen) + sizeof(ci_uint32);
+  epb.ts_high = ns >> 32;
+  epb.ts_low = (ci_uint32) ns;
+  epb.caplen = caplen;
+  epb.len = len;
+  dump_data(&epb, sizeof(epb));
+}
+
+
+static void write_pcapng_epb_end(int caplen)
+{
+  static const char pad[3];
+  ci_uint32 len = sizeof(struct pcapng_epb_hdr) + PCAPNG_PAD(caplen) +
+                  sizeof(ci_uint32);
+  if( PCAPNG_PAD(caplen) != caplen )
+    dump_data(pad, PCAPNG_PAD(caplen) - caplen);
+  dump_data(&len, sizeof(len));
+}
+
+
+/* Bytes of a frame whose VLAN tag is removed that are copied for the
+ * filter to look at.  This covers the headers of any TCP or UDP packet. */
+#define FILTER_VLAN_COPY 256
+
+static void filter_compile(void)
+{
+  pcap_t* p = pcap_open_dead(DLT_EN10MB, cfg_snaplen);
+
+  if( p == NULL ) {
+    ci_log("ERROR: unable to open libpcap");
+    exit(1);
+  }
+  if( pcap_compile(p, &filter_prog, cfg_pkt_filter, 1,
+                   PCAP_NETMASK_UNKNOWN) != 0 ) {
+    ci_log("ERROR: bad filter '%s': %s", cfg_pkt_filter, pcap_geterr(p));
+    exit(1);
+  }
+  pcap_close(p);
+
+  filter_in_stack = filter_prog.bf_len <= CI_CFG_DUMP_FILTER_LEN;
+  if( ! filter_in_stack )
+    ci_log("WARNING: filter '%s' has %u instructions, more than the stack "
+           "can run (%d), so all packets are queued for dumping",
+           cfg_pkt_filter, filter_prog.bf_len, CI_CFG_DUMP_FILTER_LEN);
+}
+
+
+/* Install the filter in the stack.  It must be in place before dumping is
+ * turned on, as the stack reads it without the lock. */
+static void filter_install(ci_netif* ni)
+{
+  unsigned i;
+
+  ni->state->dump_filter_len = 0;
+  if( ! filter_in_stack )
+    return;
+  for( i = 0; i < filter_prog.bf_len; ++i ) {
+    ni->state->dump_filter[i].code = filter_prog.bf_insns[i].code;
+    ni->state->dump_filter[i].jt = filter_prog.bf_insns[i].jt;
+    ni->state->dump_filter[i].jf = filter_prog.bf_insns[i].jf;
+    ni->state->dump_filter[i].k = filter_prog.bf_insns[i].k;
+  }
+  ni->state->dump_filter_vlan = !! (cfg_encap.type & CICP_LLAP_TYPE_VLAN);
+  ci_wmb();
+  ni->state->dump_filter_len = filter_prog.bf_len;
+}
+
+
+/* Run the filter over the frame as it would be written, so that packets
+ * which don't match cost no more than this.  Only the first buffer of the
+ * packet is looked at, which holds all the headers. */
+static int pkt_filter_match(const ci_ip_pkt_fmt* pkt, int paylen,
+                            int strip_vlan)
+{
+  const u_char* frame = (const u_char*) oo_ether_hdr(pkt);
+  u_char buf[FILTER_VLAN_COPY];
+  int buflen = pkt->n_buffers > 1 ? pkt->buf_len : pkt->pay_len;
+
+  if( strip_vlan ) {
+    buflen = CI_MIN(buflen - ETH_VLAN_HLEN, (int) sizeof(buf));
+    memcpy(buf, frame, 2 * ETH_ALEN);
+    memcpy(buf + 2 * ETH_ALEN, frame + 2 * ETH_ALEN + ETH_VLAN_HLEN,
+           buflen - 2 * ETH_ALEN);
+    frame = buf;
+  }
+  buflen = CI_MIN(buflen, cfg_snaplen);
+  return bpf_filter(filter_prog.bf_insns, frame, paylen, buflen) != 0;
+}
+
+
 /* Turn dumping on */
 static void stack_dump_on(ci_netif *ni)
 {
@@ -281,9 +565,15 @@ static void stack_dump_on(ci_netif *ni)
   if( dump_hwports[0] == -1 )
     ifindex_to_intf_i(ni);
 
+  /* Stack ids are reused, so this stack needs interface blocks of its
+   * own. */
+  pcapng_forget_stack(ni->state->stack_id);
+
   /* Set up dumping */
   ci_log("Onload stack [%d,%s]: start packet dump",
          ni->state->stack_id, ni->state->name);
+  filter_install(ni);
+  ci_wmb();
   {
     ci_hwport_id_t hwport_i;
     int intf_i;
@@ -306,28 +596,13 @@ static void stack_dump_off(ci_netif *ni)
 {
   memset(ni->state->dump_intf, 0, sizeof(ni->state->dump_intf));
   libstack_netif_lock(ni);
+  ni->state->dump_filter_len = 0;
   oo_tcpdump_free_pkts(ni, ni->state->dump_read_i);
   ni->state->dump_read_i = ni->state->dump_write_i;
   ci_log("Onload stack [%d,%s]: stop packet dump",
          ni->state->stack_id, ni->state->name);
 }
 
-/* Dump and flush dumped data */
-static void dump_data(const void *data, size_t size)
-{
-  if( fwrite(data, size, 1, stdout) != 1 ) {
-    ci_log("Failed to dump packet data to stdout");
-    exit(1);
-  }
-}
-static void dump_flush(void)
-{
-  if( fflush(stdout) == EOF ) {
-    ci_log("Failed to flush stdout");
-    exit(1);
-  }
-}
-
 /* Do dump */
 static void stack_dump(ci_netif *ni)
 {
@@ -360,6 +635,7 @@ static void stack_dump(ci_netif *ni)
     struct oo_pcap_pkthdr hdr;
     struct timespec ts;
     int paylen;
+    int caplen, left;
     int fraglen;
     oo_pkt_p id;
     ci_ip_pkt_fmt *pkt;
@@ -403,20 +679,29 @@ static void stack_dump(ci_netif *ni)
 
     if( do_strip_vlan )
       paylen -= ETH_VLAN_HLEN;
-    hdr.caplen = CI_MIN(cfg_snaplen, paylen);
-    hdr.len = paylen;
-    pkt_tstamp(pkt, &ts);
-    hdr.t.ts.tv_sec = ts.tv_sec;
-    if( do_nano )
-      hdr.t.ts.tv_nsec = ts.tv_nsec;
-    else
-      hdr.t.tv.tv_usec = ts.tv_nsec / 1000;
+    if( cfg_pkt_filter != NULL && ! filter_in_stack &&
+        ! pkt_filter_match(pkt, paylen, do_strip_vlan) )
+      continue;
+    caplen = CI_MIN(cfg_snaplen, paylen);
+    pkt_dump_tstamp(pkt, &ts);
     LOG_DUMP(ci_log("%u: got ni %d pkt %d len %d ref %d",
                     read_i, ni->state->stack_id,
                     OO_PKT_FMT(pkt), paylen, pkt->refcount));
 
-    dump_data(&hdr, sizeof(hdr));
-    fraglen = hdr.caplen;
+    if( cfg_pcapng ) {
+      write_pcapng_epb_hdr(ni, pkt->intf_i, &ts, caplen, paylen);
+    }
+    else {
+      hdr.caplen = caplen;
+      hdr.len = paylen;
+      hdr.t.ts.tv_sec = ts.tv_sec;
+      if( do_nano )
+        hdr.t.ts.tv_nsec = ts.tv_nsec;
+      else
+        hdr.t.tv.tv_usec = ts.tv_nsec / 1000;
+      dump_data(&hdr, sizeof(hdr));
+    }
+    fraglen = caplen;
     if( do_strip_vlan ) {
       if( pkt->n_buffers > 1 )
         fraglen = CI_MIN(fraglen, pkt->buf_len - ETH_VLAN_HLEN);
@@ -431,11 +716,12 @@ static void stack_dump(ci_netif *ni)
     }
 
     /* Dump all scatter-gather chain */
+    left = caplen;
     if( pkt->n_buffers  > 1 ) {
       ci_ip_pkt_fmt *frag = PKT_CHK_NNL(ni, pkt->frag_next);
       do {
-        hdr.caplen -= fraglen;
-        fraglen = CI_MIN(hdr.caplen, frag->buf_len);
+        left -= fraglen;
+        fraglen = CI_MIN(left, frag->buf_len);
         if( fraglen > 0 )
           dump_data(frag->dma_start, fraglen);
         if( OO_PP_IS_NULL(frag->frag_next) )
@@ -443,6 +729,9 @@ static void stack_dump(ci_netif *ni)
         frag = PKT_CHK_NNL(ni, frag->frag_next);
       } while( frag != NULL );
     }
+
+    if( cfg_pcapng )
+      write_pcapng_epb_end(caplen);
   }
 
   /* Ensure we've finished reading before we release. */
@@ -463,6 +752,7 @@ static void stack_pre_detach(ci_netif *ni)
 
   /* The stack is dying, but we should free the last packets to check that
    * there is no packet leak */
+  ni->state->dump_filter_len = 0;
 #ifndef NDEBUG
   libstack_netif_lock(ni);
   oo_tcpdump_free_pkts(ni, ni->state->dump_read_i);
@@ -551,6 +841,13 @@ static void write_pcap_header(void)
 {
   struct pcap_file_header hdr;
 
+  if( cfg_pcapng ) {
+    /* Interface blocks follow as each interface is seen. */
+    write_pcapng_shb();
+    dump_flush();
+    return;
+  }
+
   if( do_nano )
     hdr.magic = 0xa1b23c4d; //pcap-ns
   else
@@ -691,6 +988,9 @@ int main(int argc, char* argv[])
   cfg_snaplen = CI_MAX(cfg_snaplen, 80);
   cfg_snaplen = CI_MIN(cfg_snaplen, MAXIMUM_SNAPLEN);
 
+  if( cfg_pkt_filter != NULL )
+    filter_compile();
+
   /* Parse interfaces */
   parse_interface();
 
@@ -47,12 +47,24 @@
 #define ON_CI_CFG_ZC_RECV_FILTER IGNORE
 #endif
 
+#if CI_CFG_UDP_SEND_RING
+#define ON_CI_CFG_UDP_SEND_RING DO
+#else
+#define ON_CI_CFG_UDP_SEND_RING IGNORE
+#endif
+
 #if CI_CFG_FD_CACHING
 #define ON_CI_CFG_FD_CACHING DO
 #else
 #define ON_CI_CFG_FD_CACHING IGNORE
 #endif
 
+#if CI_CFG_TCP_ACCEPTQ_SHARDS
+#define ON_CI_CFG_TCP_ACCEPTQ_SHARDS DO
+#else
+#define ON_CI_CFG_TCP_ACCEPTQ_SHARDS IGNORE
+#endif
+
 #if CI_CFG_ENDPOINT_MOVE
 #define ON_CI_CFG_ENDPOINT_MOVE DO
 #else
@@ -117,6 +129,18 @@
 #define ON_CI_CFG_TAIL_DROP_PROBE IGNORE
 #endif
 
+#if CI_CFG_TCP_RACK
+#define ON_CI_CFG_TCP_RACK DO
+#else
+#define ON_CI_CFG_TCP_RACK IGNORE
+#endif
+
+#if CI_CFG_TX_PACING
+#define ON_CI_CFG_TX_PACING DO
+#else
+#define ON_CI_CFG_TX_PACING IGNORE
+#endif
+
 #if CI_CFG_CONGESTION_WINDOW_VALIDATION
 #define ON_CI_CFG_CONGESTION_WINDOW_VALIDATION DO
 #else
@@ -517,6 +541,10 @@ typedef struct oo_p_dllink oo_p_dllink_t;
   FTL_TFIELD_ARRAYOFSTRUCT(ctx, oo_p_dllink_t, timeout_q, \
                            OO_TIMEOUT_Q_MAX, ORM_OUTPUT_STACK, 1)         \
   FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, reap_list, ORM_OUTPUT_EXTRA)     \
+  ON_CI_CFG_TX_PACING(                                                  \
+    FTL_TFIELD_STRUCT(ctx, ci_ip_timer, pace_tid, ORM_OUTPUT_STACK)       \
+    FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, pace_q, ORM_OUTPUT_EXTRA)       \
+  )                                                                     \
   ON_CI_CFG_SUPPORT_STATS_COLLECTION(                                   \
     FTL_TFIELD_INT(ctx, ci_int32, stats_fmt, ORM_OUTPUT_STACK)            \
     FTL_TFIELD_STRUCT(ctx, ci_ip_timer, stats_tid, ORM_OUTPUT_STACK)      \
@@ -818,6 +846,12 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_int32, pid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                       \
   FTL_TFIELD_INT(ctx, ci_uint8, domain, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
   FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, reap_link, ORM_OUTPUT_EXTRA)     \
+  ON_CI_CFG_TX_PACING(                                                  \
+    FTL_TFIELD_INT(ctx, ci_uint64, pace_max_rate, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+    FTL_TFIELD_INT(ctx, ci_int32, pace_tokens, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+    FTL_TFIELD_INT(ctx, ci_uint64, pace_stamp, ORM_OUTPUT_EXTRA)          \
+    FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, pace_link, ORM_OUTPUT_EXTRA)    \
+  )                                                                     \
   FTL_TSTRUCT_END(ctx)
     
 #define STRUCT_IP_PKT_QUEUE(ctx)                                              \
@@ -844,6 +878,8 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_mem_drop, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
   FTL_TFIELD_INT(ctx, ci_uint32, n_rx_pktinfo, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, max_recvq_pkts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_gro, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_rx_gro_segs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_slow, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_onload_c, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
@@ -866,6 +902,15 @@ typedef struct oo_sock_cplane oo_sock_cplane_t;
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_msg_confirm, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_os_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
   FTL_TFIELD_INT(ctx, ci_uint32, n_tx_unconnect_late, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_gso, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_gso_segs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_ring, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_ring_full, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, n_tx_ring_drains, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  FTL_TFIELD_INT(ctx, ci_uint32, tx_ring_max_batch, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  ON_CI_CFG_TX_PACING( \
+    FTL_TFIELD_INT(ctx, ci_uint32, n_tx_paced, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+  ) \
   FTL_TSTRUCT_END(ctx)
 
 typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
@@ -881,6 +926,9 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   ON_CI_CFG_BURST_CONTROL(                                              \
      FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_burst, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
                                                                         ) \
+  ON_CI_CFG_TX_PACING(                                                  \
+     FTL_TFIELD_INT(ctx, ci_uint32, tx_stop_pace, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+                                                                        ) \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_nomac_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))   \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_defer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_msg_warm_abort, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
@@ -913,6 +961,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_STRUCT(ctx, ci_sock_cmn, s, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
   FTL_TFIELD_STRUCT(ctx, ci_ip_cached_hdrs, ephemeral_pkt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
   FTL_TFIELD_INT(ctx, ci_uint32, udpflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+  FTL_TFIELD_INT(ctx, ci_uint16, gso_size, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
   ON_CI_CFG_ZC_RECV_FILTER( \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint64, recv_q_filter_arg, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -928,6 +977,15 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   FTL_TFIELD_INT(ctx, ci_uint64, stamp_pre_sots, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
   FTL_TFIELD_INT(ctx, ci_int32, tx_async_q, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
   FTL_TFIELD_INT(ctx, oo_atomic_t, tx_async_q_level, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
+  ON_CI_CFG_UDP_SEND_RING( \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ring_head, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ring_tail, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+    FTL_TFIELD_INT(ctx, ci_uint32, tx_ring_kick, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+  ) \
+  ON_CI_CFG_TX_PACING( \
+    FTL_TFIELD_INT(ctx, ci_int32, tx_pace_head, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+    FTL_TFIELD_INT(ctx, ci_int32, tx_pace_tail, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+  ) \
   FTL_TFIELD_INT(ctx, ci_uint32, tx_count, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
   FTL_TFIELD_STRUCT(ctx, ci_udp_socket_stats, stats, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))      \
   FTL_TSTRUCT_END(ctx)
@@ -1002,6 +1060,9 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_ka_intvl_in_secs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_uint16, user_mss, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
     FTL_TFIELD_INT(ctx, ci_uint8, tcp_defer_accept, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))	      \
+    FTL_TFIELD_INT(ctx, ci_uint8, cc_algo, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+    FTL_TFIELD_INT(ctx, ci_uint32, tfo_qlen, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+    FTL_TFIELD_INT(ctx, ci_uint32, notsent_lowat, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TSTRUCT_END(ctx)
 
 #define STRUCT_TCP(ctx) \
@@ -1032,6 +1093,8 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
   ON_CI_CFG_TIMESTAMPING( \
     FTL_TFIELD_STRUCT(ctx, ci_udp_recv_q, timestamp_q, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
     FTL_TFIELD_INT(ctx, ci_int32, timestamp_q_pending, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
+    FTL_TFIELD_INT(ctx, ci_uint32, zerocopy_next_id, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
+    FTL_TFIELD_INT(ctx, ci_uint32, zerocopy_n_pinned, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
   ) \
     FTL_TFIELD_INT(ctx, ci_uint32, snd_check, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                   \
     FTL_TFIELD_INT(ctx, ci_uint32, snd_nxt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                     \
@@ -1066,6 +1129,11 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_uint32, cwnd_extra, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
     FTL_TFIELD_INT(ctx, ci_uint32, ssthresh, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     FTL_TFIELD_INT(ctx, ci_uint32, bytes_acked, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                 \
+    FTL_TFIELD_INT(ctx, ci_uint32, cubic_w_max, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                 \
+    FTL_TFIELD_INT(ctx, ci_uint32, cubic_origin, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
+    FTL_TFIELD_INT(ctx, ci_uint32, cubic_cwnd_epoch, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
+    FTL_TFIELD_INT(ctx, ci_uint32, cubic_k, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                     \
+    FTL_TFIELD_INT(ctx, ci_iptime_t, cubic_epoch_start, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))         \
     FTL_TFIELD_INT(ctx, ci_uint8, dup_acks, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                    \
     ON_CI_CFG_TCP_FASTSTART(                                                  \
       FTL_TFIELD_INT(ctx, ci_uint32, faststart_acks, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
@@ -1073,6 +1141,15 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     ON_CI_CFG_TAIL_DROP_PROBE(                                                \
       FTL_TFIELD_INT(ctx, ci_uint32, taildrop_mark, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
     )                                                                         \
+    ON_CI_CFG_TCP_RACK(                                                       \
+      FTL_TFIELD_INT(ctx, ci_iptime_t, rack_xmit_ts, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
+      FTL_TFIELD_INT(ctx, ci_uint32, rack_end_seq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+      FTL_TFIELD_INT(ctx, ci_uint32, rack_rtt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
+      FTL_TFIELD_INT(ctx, ci_uint32, rack_min_rtt, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))              \
+      FTL_TFIELD_INT(ctx, ci_uint32, rack_dsack_round, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+      FTL_TFIELD_INT(ctx, ci_uint8, rack_reo_wnd_mult, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
+      FTL_TFIELD_INT(ctx, ci_uint8, rack_reo_wnd_persist, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))       \
+    )                                                                         \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_prev_recv_payload, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_last_recv_payload, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_INT(ctx, ci_iptime_t, t_last_recv_ack, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))     \
@@ -1106,6 +1183,9 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
       FTL_TFIELD_STRUCT(ctx, ci_ip_timer, stats_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     )                                                                         \
     FTL_TFIELD_STRUCT(ctx, ci_ip_timer, cork_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
+    ON_CI_CFG_TCP_RACK(                                                       \
+      FTL_TFIELD_STRUCT(ctx, ci_ip_timer, rack_tid, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))             \
+    )                                                                         \
     ON_CI_CFG_TCP_SOCK_STATS(                                                 \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_snapshot, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))  \
       FTL_TFIELD_STRUCT(ctx, ci_ip_sock_stats, stats_cumulative, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))\
@@ -1119,6 +1199,7 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     )                                                                         \
     FTL_TFIELD_INT(ctx, ci_int32, send_prequeue, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                \
     FTL_TFIELD_INT(ctx, oo_atomic_t, send_prequeue_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))    \
+    FTL_TFIELD_INT(ctx, oo_atomic_t, send_prequeue_bytes, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
     FTL_TFIELD_STRUCT(ctx, oo_p_dllink_t, timeout_q_link, ORM_OUTPUT_EXTRA)   \
     FTL_TFIELD_STRUCT(ctx, oo_tcp_socket_stats, stats, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
     FTL_TFIELD_ANON_STRUCT_BEGIN(ctx, rcvbuf_drs, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))               \
@@ -1175,6 +1256,11 @@ typedef struct oo_tcp_socket_stats oo_tcp_socket_stats;
     FTL_TFIELD_INT(ctx, ci_uint32, acceptq_n_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_INT(ctx, ci_int32, acceptq_get, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))          \
     FTL_TFIELD_INT(ctx, ci_uint32, acceptq_n_out, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))       \
+    FTL_TFIELD_INT(ctx, ci_uint32, tfo_n_in, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
+    FTL_TFIELD_INT(ctx, ci_uint32, tfo_n_out, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))           \
+    ON_CI_CFG_TCP_ACCEPTQ_SHARDS(                                             \
+      FTL_TFIELD_INT(ctx, ci_uint32, acceptq_n_shards, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS)) \
+    )                                                                         \
     FTL_TFIELD_INT(ctx, ci_int32, n_listenq, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))            \
     FTL_TFIELD_INT(ctx, ci_int32, n_listenq_new, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))        \
     FTL_TFIELD_ARRAYOFSTRUCT(ctx, oo_p_dllink_t,       \
@@ -1242,6 +1328,8 @@ typedef struct oo_pipe oo_pipe;
   FTL_TFIELD_ANON_STRUCT(ctx, oo_pkt_p, write_ptr, pp_wait)    \
   FTL_TFIELD_ANON_STRUCT_END(ctx, write_ptr)                   \
   FTL_TFIELD_INT(ctx, ci_uint32, aflags, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                       \
+  FTL_TFIELD_INT(ctx, ci_int32, peer, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                          \
+  FTL_TFIELD_INT(ctx, ci_uint32, ctrl_n, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                       \
   FTL_TFIELD_INT(ctx, ci_uint32, bufs_num, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                     \
   FTL_TFIELD_INT(ctx, ci_uint32, bufs_max, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                     \
   FTL_TFIELD_INT(ctx, ci_uint32, bytes_added, (ORM_OUTPUT_STACK | ORM_OUTPUT_SOCKETS))                  \
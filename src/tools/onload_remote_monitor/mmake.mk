@@ -1,7 +1,7 @@
 # SPDX-License-Identifier: GPL-2.0
 # X-SPDX-Copyright-Text: (c) Copyright 2014-2020 Xilinx, Inc.
 
-APPS := orm_json
+APPS := orm_json orm_bench
 
 SRCS := orm_json orm_json_lib
 
@@ -41,10 +41,13 @@ all: $(APPS)
 orm_json: $(DEPS)
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
-orm_zmq_publisher: orm_zmq_publisher.o orm_json_lib.o
+orm_bench: orm_bench.o orm_json_lib.o orm_bin.o $(MMAKE_LIB_DEPS)
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
-zmq_subscriber: zmq_subscriber.o
+orm_zmq_publisher: orm_zmq_publisher.o orm_json_lib.o orm_bin.o
+	(libs="$(LIBS)"; $(MMakeLinkCApp))
+
+zmq_subscriber: zmq_subscriber.o orm_bin.o
 	(libs="$(LIBS)"; $(MMakeLinkCApp))
 
 clean:
@@ -0,0 +1,277 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Compare the cost of publishing stack counters as JSON (orm_do_dump())
+ * with the binary delta encoding of orm_bin.h.
+ *
+ * By default this samples the stacks on this host.  With --synthetic it
+ * needs no stacks: it makes up counters for the given number of stacks,
+ * changing --churn percent of them between samples, and the JSON side is a
+ * minimal printer of the same counters in orm_do_dump()'s format.
+ *
+ * Every binary message is decoded again and checked against the values
+ * which were encoded.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <ci/internal/ip.h>
+#include <ci/app/testapp.h>
+#include <onload/version.h>
+
+#include "orm_json_lib.h"
+#include "orm_bin.h"
+
+
+static struct orm_cfg cfg;
+static int cfg_iter = 1000;
+static int cfg_synthetic = 0;
+static int cfg_churn = 5;
+static int cfg_keyframe = 100;
+
+static ci_cfg_desc cfg_opts[] = {
+  { 'h', "help", CI_CFG_USAGE, 0, "this message" },
+  { 0, "name",  CI_CFG_STR,  &cfg.stackname, "select a single stack name" },
+  { 'n', "iter",  CI_CFG_INT,  &cfg_iter,
+    "number of samples (default 1000)" },
+  { 0, "synthetic",  CI_CFG_INT,  &cfg_synthetic,
+    "use this many made-up stacks instead of the real ones" },
+  { 0, "churn",  CI_CFG_INT,  &cfg_churn,
+    "percentage of synthetic counters changed per sample (default 5)" },
+  { 0, "keyframe",  CI_CFG_INT,  &cfg_keyframe,
+    "send all counters every this many samples (default 100)" },
+};
+#define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
+
+
+#define TRY(x)                                                          \
+  do {                                                                  \
+    int __rc = (x);                                                     \
+    if( __rc < 0 ) {                                                    \
+      fprintf(stderr, "ERROR: %s failed: rc=%d\n", #x, __rc);           \
+      exit(1);                                                          \
+    }                                                                   \
+  } while( 0 )
+
+
+struct bench_stack {
+  unsigned  id;
+  char      name[CI_CFG_STACK_NAME_LEN + 1];
+  uint64_t* values;
+};
+
+static const char* const* names;
+static int n_counters;
+static struct bench_stack* stacks;
+static int n_stacks;
+
+static struct orm_sampler* smp;
+static struct orm_bin_dec* dec;
+
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+/**********************************************************/
+/* Sources of counters */
+/**********************************************************/
+
+static void synthetic_init(void)
+{
+  int i, j;
+
+  n_stacks = cfg_synthetic;
+  stacks = calloc(n_stacks, sizeof(*stacks));
+  for( i = 0; i < n_stacks; ++i ) {
+    stacks[i].id = i;
+    snprintf(stacks[i].name, sizeof(stacks[i].name), "stack%d", i);
+    stacks[i].values = calloc(n_counters, sizeof(uint64_t));
+    /* Most counters in a busy stack are zero; the rest are anything. */
+    for( j = 0; j < n_counters; ++j )
+      if( random() % 4 == 0 )
+        stacks[i].values[j] = (uint64_t) random() * random();
+  }
+}
+
+
+static void synthetic_step(void)
+{
+  int i, j, n = n_counters * cfg_churn / 100;
+
+  for( i = 0; i < n_stacks; ++i )
+    for( j = 0; j < n; ++j )
+      stacks[i].values[random() % n_counters] += random() % 1000;
+}
+
+
+static void real_init(void)
+{
+  TRY(orm_sampler_refresh(smp));
+  n_stacks = orm_sampler_n_stacks(smp);
+  stacks = calloc(n_stacks ? n_stacks : 1, sizeof(*stacks));
+  for( int i = 0; i < n_stacks; ++i )
+    stacks[i].values = calloc(n_counters, sizeof(uint64_t));
+}
+
+
+/* Read the real stacks into stacks[], skipping those excluded by --name. */
+static int real_read(void)
+{
+  int i, n = 0;
+
+  for( i = 0; i < orm_sampler_n_stacks(smp); ++i ) {
+    const char* name;
+    if( orm_sampler_read(smp, i, &stacks[n].id, &name, stacks[n].values) ) {
+      strncpy(stacks[n].name, name, CI_CFG_STACK_NAME_LEN);
+      ++n;
+    }
+  }
+  return n;
+}
+
+
+/**********************************************************/
+/* Encoders */
+/**********************************************************/
+
+/* Same output as orm_do_dump() with --flat, for the counters only */
+static size_t json_synthetic(FILE* f)
+{
+  int i, j;
+
+  fprintf(f, "{\"onload_version\":\"%s\",\"stacks\":[", onload_version);
+  for( i = 0; i < n_stacks; ++i ) {
+    fprintf(f, "%s{\"id\":%u,\"name\":\"%s\"", i ? "," : "",
+            stacks[i].id, stacks[i].name);
+    for( j = 0; j < n_counters; ++j )
+      fprintf(f, ",\"%s\":\"%llu\"", names[j],
+              (unsigned long long) stacks[i].values[j]);
+    fprintf(f, "}");
+  }
+  fprintf(f, "]}");
+  return ftell(f);
+}
+
+
+static size_t json_sample(void)
+{
+  char* data = NULL;
+  size_t len = 0;
+  FILE* f = open_memstream(&data, &len);
+
+  if( cfg_synthetic )
+    json_synthetic(f);
+  else
+    TRY(orm_do_dump(&cfg, ORM_OUTPUT_SUM, f));
+  fclose(f);
+  free(data);
+  return len;
+}
+
+
+static void bin_check(const uint8_t* msg, size_t len, int n)
+{
+  int type = orm_bin_dec_feed(dec, msg, len);
+  int i;
+
+  if( type <= 0 || orm_bin_dec_n_stacks(dec) != n ) {
+    fprintf(stderr, "ERROR: decode failed: type=%d\n", type);
+    exit(1);
+  }
+  for( i = 0; i < n; ++i ) {
+    const struct orm_bin_dec_stack* s = orm_bin_dec_stack(dec, i);
+    if( s->id != stacks[i].id || strcmp(s->name, stacks[i].name) ||
+        memcmp(s->values, stacks[i].values, n_counters * sizeof(uint64_t)) ) {
+      fprintf(stderr, "ERROR: stack %u decoded wrongly\n", stacks[i].id);
+      exit(1);
+    }
+  }
+}
+
+
+/**********************************************************/
+/* Main */
+/**********************************************************/
+
+int main(int argc, char** argv)
+{
+  struct orm_bin_enc* enc;
+  const uint8_t* msg;
+  size_t len, json_bytes = 0, key_bytes = 0, delta_bytes = 0;
+  uint64_t t, json_ns = 0, bin_ns = 0;
+  int i, j, n, n_keys = 0;
+
+  ci_app_standard_opts = 0;
+  ci_app_getopt("", &argc, argv, cfg_opts, N_CFG_OPTS);
+  if( cfg_iter <= 0 || cfg_keyframe <= 0 ) {
+    fprintf(stderr, "Invalid option specified\n");
+    return EXIT_FAILURE;
+  }
+
+  names = orm_counter_names_get(&n_counters);
+  enc = orm_bin_enc_new(names, n_counters);
+  dec = orm_bin_dec_new();
+  smp = orm_sampler_new(&cfg);
+  if( cfg_synthetic )
+    synthetic_init();
+  else
+    real_init();
+
+  TRY(orm_bin_enc_schema(enc, &msg, &len));
+  TRY(orm_bin_dec_feed(dec, msg, len));
+
+  for( i = 0; i < cfg_iter; ++i ) {
+    bool key = i % cfg_keyframe == 0;
+
+    if( cfg_synthetic )
+      synthetic_step();
+
+    t = now_ns();
+    json_bytes += json_sample();
+    json_ns += now_ns() - t;
+
+    t = now_ns();
+    n = cfg_synthetic ? n_stacks : real_read();
+    orm_bin_enc_begin(enc, key, t / 1000);
+    for( j = 0; j < n; ++j )
+      TRY(orm_bin_enc_stack(enc, stacks[j].id, stacks[j].name,
+                            stacks[j].values));
+    TRY(orm_bin_enc_end(enc, &msg, &len));
+    bin_ns += now_ns() - t;
+
+    if( key ) {
+      key_bytes += len;
+      ++n_keys;
+    }
+    else {
+      delta_bytes += len;
+    }
+    bin_check(msg, len, n);
+  }
+
+  printf("stacks: %d  counters: %d  samples: %d\n",
+         n_stacks, n_counters, cfg_iter);
+  printf("json:   %8.1f us/sample %10zu bytes/sample\n",
+         json_ns / 1000.0 / cfg_iter, json_bytes / cfg_iter);
+  printf("binary: %8.1f us/sample %10zu bytes/sample "
+         "(key %zu, delta %zu)\n", bin_ns / 1000.0 / cfg_iter,
+         (key_bytes + delta_bytes) / cfg_iter,
+         n_keys ? key_bytes / n_keys : 0,
+         cfg_iter > n_keys ? delta_bytes / (cfg_iter - n_keys) : 0);
+  printf("Decoded all samples correctly\n");
+
+  orm_sampler_free(smp);
+  orm_bin_dec_free(dec);
+  orm_bin_enc_free(enc);
+  return 0;
+}
@@ -0,0 +1,604 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Encoder and decoder for the binary telemetry format described in
+ * orm_bin.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "orm_bin.h"
+
+
+/**********************************************************/
+/* Buffers and primitive types */
+/**********************************************************/
+
+struct orm_bin_buf {
+  uint8_t* p;
+  size_t   len;
+  size_t   cap;
+  int      rc;
+};
+
+
+static void orm_bin_put(struct orm_bin_buf* b, const void* data, size_t len)
+{
+  if( b->rc )
+    return;
+  if( b->len + len > b->cap ) {
+    size_t cap = b->cap ? b->cap : 4096;
+    uint8_t* p;
+    while( cap < b->len + len )
+      cap *= 2;
+    if( (p = realloc(b->p, cap)) == NULL ) {
+      b->rc = -ENOMEM;
+      return;
+    }
+    b->p = p;
+    b->cap = cap;
+  }
+  memcpy(b->p + b->len, data, len);
+  b->len += len;
+}
+
+
+static void orm_bin_put_u8(struct orm_bin_buf* b, uint8_t v)
+{
+  orm_bin_put(b, &v, 1);
+}
+
+
+static void orm_bin_put_varint(struct orm_bin_buf* b, uint64_t v)
+{
+  uint8_t tmp[10];
+  int n = 0;
+
+  while( v >= 0x80 ) {
+    tmp[n++] = (uint8_t) v | 0x80;
+    v >>= 7;
+  }
+  tmp[n++] = (uint8_t) v;
+  orm_bin_put(b, tmp, n);
+}
+
+
+static void orm_bin_put_string(struct orm_bin_buf* b, const char* s)
+{
+  size_t len = strlen(s);
+  orm_bin_put_varint(b, len);
+  orm_bin_put(b, s, len);
+}
+
+
+static inline uint64_t orm_bin_zigzag(uint64_t delta)
+{
+  return (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63);
+}
+
+
+static inline uint64_t orm_bin_unzigzag(uint64_t v)
+{
+  return (v >> 1) ^ -(v & 1);
+}
+
+
+struct orm_bin_rd {
+  const uint8_t* p;
+  const uint8_t* end;
+  bool           bad;
+};
+
+
+static uint8_t orm_bin_get_u8(struct orm_bin_rd* r)
+{
+  if( r->p >= r->end ) {
+    r->bad = true;
+    return 0;
+  }
+  return *r->p++;
+}
+
+
+static uint64_t orm_bin_get_varint(struct orm_bin_rd* r)
+{
+  uint64_t v = 0;
+  int shift;
+
+  for( shift = 0; shift < 64; shift += 7 ) {
+    uint8_t c = orm_bin_get_u8(r);
+    v |= (uint64_t) (c & 0x7f) << shift;
+    if( ! (c & 0x80) )
+      return v;
+  }
+  r->bad = true;
+  return 0;
+}
+
+
+/* Returns a copy of the string, or NULL. */
+static char* orm_bin_get_string(struct orm_bin_rd* r)
+{
+  uint64_t len = orm_bin_get_varint(r);
+  char* s;
+
+  if( r->bad || len > (uint64_t) (r->end - r->p) ) {
+    r->bad = true;
+    return NULL;
+  }
+  if( (s = malloc(len + 1)) == NULL ) {
+    r->bad = true;
+    return NULL;
+  }
+  memcpy(s, r->p, len);
+  s[len] = '\0';
+  r->p += len;
+  return s;
+}
+
+
+static void orm_bin_put_header(struct orm_bin_buf* b, int type, uint64_t seq,
+                               uint32_t schema_id)
+{
+  orm_bin_put_u8(b, ORM_BIN_MAGIC0);
+  orm_bin_put_u8(b, ORM_BIN_MAGIC1);
+  orm_bin_put_u8(b, ORM_BIN_VERSION);
+  orm_bin_put_u8(b, type);
+  orm_bin_put_varint(b, seq);
+  orm_bin_put_varint(b, schema_id);
+}
+
+
+/**********************************************************/
+/* Encoder */
+/**********************************************************/
+
+struct orm_bin_enc_stack {
+  unsigned  id;
+  char*     name;
+  uint64_t* values;
+  bool      seen;
+};
+
+struct orm_bin_enc {
+  const char* const* names;
+  int                n_counters;
+  uint32_t           schema_id;
+  uint64_t           seq;
+
+  struct orm_bin_buf schema;
+  struct orm_bin_buf msg;
+  /* Stack records of the message being built */
+  struct orm_bin_buf body;
+  unsigned           body_n_stacks;
+  bool               key;
+  uint64_t           time_us;
+
+  /* Values sent for each stack in the previous message */
+  struct orm_bin_enc_stack* stacks;
+  int                n_stacks;
+  int                max_stacks;
+};
+
+
+/* FNV-1a over the names, so that a receiver can tell whether a message
+ * matches the schema it has. */
+static uint32_t orm_bin_schema_id(const char* const* names, int n)
+{
+  uint32_t h = 2166136261u;
+  const char* s;
+  int i;
+
+  for( i = 0; i < n; ++i )
+    for( s = names[i]; ; ++s ) {
+      h = (h ^ (uint8_t) *s) * 16777619u;
+      if( *s == '\0' )
+        break;
+    }
+  return h;
+}
+
+
+struct orm_bin_enc* orm_bin_enc_new(const char* const* names, int n_counters)
+{
+  struct orm_bin_enc* enc = calloc(1, sizeof(*enc));
+
+  if( enc == NULL )
+    return NULL;
+  enc->names = names;
+  enc->n_counters = n_counters;
+  enc->schema_id = orm_bin_schema_id(names, n_counters);
+  return enc;
+}
+
+
+static void orm_bin_enc_stack_free(struct orm_bin_enc_stack* s)
+{
+  free(s->name);
+  free(s->values);
+}
+
+
+void orm_bin_enc_free(struct orm_bin_enc* enc)
+{
+  int i;
+
+  for( i = 0; i < enc->n_stacks; ++i )
+    orm_bin_enc_stack_free(&enc->stacks[i]);
+  free(enc->stacks);
+  free(enc->schema.p);
+  free(enc->msg.p);
+  free(enc->body.p);
+  free(enc);
+}
+
+
+int orm_bin_enc_schema(struct orm_bin_enc* enc,
+                       const uint8_t** msg, size_t* len)
+{
+  struct orm_bin_buf* b = &enc->schema;
+  int i;
+
+  b->len = 0;
+  orm_bin_put_header(b, ORM_BIN_MSG_SCHEMA, enc->seq++, enc->schema_id);
+  orm_bin_put_varint(b, enc->n_counters);
+  for( i = 0; i < enc->n_counters; ++i )
+    orm_bin_put_string(b, enc->names[i]);
+  if( b->rc )
+    return b->rc;
+  *msg = b->p;
+  *len = b->len;
+  return 0;
+}
+
+
+void orm_bin_enc_begin(struct orm_bin_enc* enc, bool key, uint64_t time_us)
+{
+  int i;
+
+  enc->key = key;
+  enc->time_us = time_us;
+  enc->body.len = 0;
+  enc->body_n_stacks = 0;
+  for( i = 0; i < enc->n_stacks; ++i )
+    enc->stacks[i].seen = false;
+}
+
+
+static struct orm_bin_enc_stack*
+orm_bin_enc_find(struct orm_bin_enc* enc, unsigned id, const char* name)
+{
+  struct orm_bin_enc_stack* s;
+  int i;
+
+  for( i = 0; i < enc->n_stacks; ++i ) {
+    s = &enc->stacks[i];
+    if( s->id == id ) {
+      /* Stack ids are reused, so this may be a different stack. */
+      if( strcmp(s->name, name) == 0 )
+        return s;
+      free(s->name);
+      s->name = NULL;
+      return s;
+    }
+  }
+
+  if( enc->n_stacks == enc->max_stacks ) {
+    int max = enc->max_stacks ? enc->max_stacks * 2 : 16;
+    s = realloc(enc->stacks, max * sizeof(*s));
+    if( s == NULL )
+      return NULL;
+    enc->stacks = s;
+    enc->max_stacks = max;
+  }
+  s = &enc->stacks[enc->n_stacks];
+  memset(s, 0, sizeof(*s));
+  s->id = id;
+  if( (s->values = calloc(enc->n_counters, sizeof(uint64_t))) == NULL )
+    return NULL;
+  ++enc->n_stacks;
+  return s;
+}
+
+
+int orm_bin_enc_stack(struct orm_bin_enc* enc, unsigned stack_id,
+                      const char* name, const uint64_t* values)
+{
+  struct orm_bin_buf* b = &enc->body;
+  struct orm_bin_enc_stack* s = orm_bin_enc_find(enc, stack_id, name);
+  bool is_new;
+  int i, last = 0;
+
+  if( s == NULL )
+    return -ENOMEM;
+  is_new = enc->key || s->name == NULL;
+  if( s->name == NULL && (s->name = strdup(name)) == NULL )
+    return -ENOMEM;
+  if( is_new )
+    memset(s->values, 0, enc->n_counters * sizeof(uint64_t));
+  s->seen = true;
+
+  orm_bin_put_varint(b, stack_id);
+  orm_bin_put_u8(b, is_new ? ORM_BIN_STACK_NEW : 0);
+  if( is_new )
+    orm_bin_put_string(b, name);
+  for( i = 0; i < enc->n_counters; ++i )
+    if( values[i] != s->values[i] ) {
+      orm_bin_put_varint(b, i - last);
+      orm_bin_put_varint(b, orm_bin_zigzag(values[i] - s->values[i]));
+      last = i + 1;
+    }
+  orm_bin_put_varint(b, enc->n_counters - last);
+  memcpy(s->values, values, enc->n_counters * sizeof(uint64_t));
+  ++enc->body_n_stacks;
+  return b->rc;
+}
+
+
+int orm_bin_enc_end(struct orm_bin_enc* enc, const uint8_t** msg, size_t* len)
+{
+  struct orm_bin_buf* b = &enc->msg;
+  int i, n = 0;
+
+  /* Forget the stacks which have gone. */
+  for( i = 0; i < enc->n_stacks; ++i )
+    if( enc->stacks[i].seen )
+      enc->stacks[n++] = enc->stacks[i];
+    else
+      orm_bin_enc_stack_free(&enc->stacks[i]);
+  enc->n_stacks = n;
+
+  if( enc->body.rc )
+    return enc->body.rc;
+  b->len = 0;
+  orm_bin_put_header(b, enc->key ? ORM_BIN_MSG_KEY : ORM_BIN_MSG_DELTA,
+                     enc->seq++, enc->schema_id);
+  orm_bin_put_varint(b, enc->time_us);
+  orm_bin_put_varint(b, enc->body_n_stacks);
+  orm_bin_put(b, enc->body.p, enc->body.len);
+  if( b->rc )
+    return b->rc;
+  *msg = b->p;
+  *len = b->len;
+  return 0;
+}
+
+
+/**********************************************************/
+/* Decoder */
+/**********************************************************/
+
+struct orm_bin_dec {
+  char**   names;
+  int      n_counters;
+  uint32_t schema_id;
+  bool     have_schema;
+
+  /* Set when a key message has been applied and no message has been
+   * missed since. */
+  bool     synced;
+  uint64_t next_seq;
+
+  uint64_t time_us;
+  struct orm_bin_dec_stack* stacks;
+  int      n_stacks;
+};
+
+
+struct orm_bin_dec* orm_bin_dec_new(void)
+{
+  return calloc(1, sizeof(struct orm_bin_dec));
+}
+
+
+static void orm_bin_dec_free_stacks(struct orm_bin_dec_stack* stacks, int n)
+{
+  int i;
+
+  for( i = 0; i < n; ++i ) {
+    free(stacks[i].name);
+    free(stacks[i].values);
+    free(stacks[i].changed);
+  }
+  free(stacks);
+}
+
+
+static void orm_bin_dec_free_names(struct orm_bin_dec* dec)
+{
+  int i;
+
+  for( i = 0; i < dec->n_counters; ++i )
+    free(dec->names[i]);
+  free(dec->names);
+  dec->names = NULL;
+  dec->n_counters = 0;
+}
+
+
+void orm_bin_dec_free(struct orm_bin_dec* dec)
+{
+  orm_bin_dec_free_names(dec);
+  orm_bin_dec_free_stacks(dec->stacks, dec->n_stacks);
+  free(dec);
+}
+
+
+static int orm_bin_dec_schema(struct orm_bin_dec* dec, struct orm_bin_rd* r,
+                              uint32_t schema_id)
+{
+  uint64_t n = orm_bin_get_varint(r);
+  int i;
+
+  orm_bin_dec_free_names(dec);
+  dec->have_schema = false;
+  dec->synced = false;
+  /* Each name takes at least a byte. */
+  if( r->bad || n > (uint64_t) (r->end - r->p) )
+    return -EINVAL;
+  if( (dec->names = calloc(n, sizeof(char*))) == NULL )
+    return -ENOMEM;
+  dec->n_counters = n;
+  for( i = 0; i < n; ++i )
+    if( (dec->names[i] = orm_bin_get_string(r)) == NULL ) {
+      orm_bin_dec_free_names(dec);
+      return -EINVAL;
+    }
+  dec->schema_id = schema_id;
+  dec->have_schema = true;
+  return ORM_BIN_MSG_SCHEMA;
+}
+
+
+static const struct orm_bin_dec_stack*
+orm_bin_dec_find(const struct orm_bin_dec* dec, unsigned id)
+{
+  int i;
+  for( i = 0; i < dec->n_stacks; ++i )
+    if( dec->stacks[i].id == id )
+      return &dec->stacks[i];
+  return NULL;
+}
+
+
+/* Parse the stack records into a new list, so that the current state is
+ * untouched if the message is bad. */
+static int orm_bin_dec_values(struct orm_bin_dec* dec, struct orm_bin_rd* r,
+                              bool key)
+{
+  struct orm_bin_dec_stack* stacks;
+  uint64_t time_us, n_stacks;
+  int i, n = 0;
+
+  time_us = orm_bin_get_varint(r);
+  n_stacks = orm_bin_get_varint(r);
+  /* Each stack record takes at least three bytes. */
+  if( r->bad || n_stacks > (uint64_t) (r->end - r->p) / 3 )
+    return -EINVAL;
+  if( (stacks = calloc(n_stacks ? n_stacks : 1, sizeof(*stacks))) == NULL )
+    return -ENOMEM;
+
+  for( n = 0; n < n_stacks; ++n ) {
+    struct orm_bin_dec_stack* s = &stacks[n];
+    const struct orm_bin_dec_stack* old = NULL;
+    uint64_t skip;
+    int flags;
+
+    s->id = orm_bin_get_varint(r);
+    flags = orm_bin_get_u8(r);
+    if( key && ! (flags & ORM_BIN_STACK_NEW) )
+      goto bad;
+    if( flags & ORM_BIN_STACK_NEW )
+      s->name = orm_bin_get_string(r);
+    else if( (old = orm_bin_dec_find(dec, s->id)) != NULL )
+      s->name = strdup(old->name);
+    s->values = calloc(dec->n_counters ? dec->n_counters : 1,
+                       sizeof(uint64_t));
+    s->changed = calloc(dec->n_counters ? dec->n_counters : 1, sizeof(bool));
+    if( r->bad || s->name == NULL || s->values == NULL || s->changed == NULL )
+      goto bad;
+    if( old != NULL )
+      memcpy(s->values, old->values, dec->n_counters * sizeof(uint64_t));
+
+    i = 0;
+    while( 1 ) {
+      skip = orm_bin_get_varint(r);
+      if( r->bad || skip > (uint64_t) (dec->n_counters - i) )
+        goto bad;
+      i += skip;
+      if( i == dec->n_counters )
+        break;
+      s->values[i] += orm_bin_unzigzag(orm_bin_get_varint(r));
+      s->changed[i] = true;
+      ++i;
+    }
+  }
+  if( r->bad || r->p != r->end )
+    goto bad;
+
+  orm_bin_dec_free_stacks(dec->stacks, dec->n_stacks);
+  dec->stacks = stacks;
+  dec->n_stacks = n_stacks;
+  dec->time_us = time_us;
+  return 0;
+
+ bad:
+  /* [n] is the entry which failed, and may be partly filled. */
+  orm_bin_dec_free_stacks(stacks, n < n_stacks ? n + 1 : n);
+  return -EINVAL;
+}
+
+
+int orm_bin_dec_feed(struct orm_bin_dec* dec, const uint8_t* msg, size_t len)
+{
+  struct orm_bin_rd r = { msg, msg + len, false };
+  uint64_t seq;
+  uint32_t schema_id;
+  int type, rc;
+
+  if( orm_bin_get_u8(&r) != ORM_BIN_MAGIC0 ||
+      orm_bin_get_u8(&r) != ORM_BIN_MAGIC1 ||
+      orm_bin_get_u8(&r) != ORM_BIN_VERSION )
+    return -EINVAL;
+  type = orm_bin_get_u8(&r);
+  seq = orm_bin_get_varint(&r);
+  schema_id = orm_bin_get_varint(&r);
+  if( r.bad )
+    return -EINVAL;
+
+  switch( type ) {
+  case ORM_BIN_MSG_SCHEMA:
+    return orm_bin_dec_schema(dec, &r, schema_id);
+  case ORM_BIN_MSG_KEY:
+  case ORM_BIN_MSG_DELTA:
+    if( ! dec->have_schema || schema_id != dec->schema_id )
+      return 0;
+    if( type == ORM_BIN_MSG_DELTA && (! dec->synced || seq != dec->next_seq) ) {
+      dec->synced = false;
+      return 0;
+    }
+    rc = orm_bin_dec_values(dec, &r, type == ORM_BIN_MSG_KEY);
+    if( rc < 0 ) {
+      dec->synced = false;
+      return rc;
+    }
+    dec->synced = true;
+    dec->next_seq = seq + 1;
+    return type;
+  default:
+    return -EINVAL;
+  }
+}
+
+
+int orm_bin_dec_n_counters(const struct orm_bin_dec* dec)
+{
+  return dec->n_counters;
+}
+
+
+const char* orm_bin_dec_name(const struct orm_bin_dec* dec, int i)
+{
+  return dec->names[i];
+}
+
+
+uint64_t orm_bin_dec_time_us(const struct orm_bin_dec* dec)
+{
+  return dec->time_us;
+}
+
+
+int orm_bin_dec_n_stacks(const struct orm_bin_dec* dec)
+{
+  return dec->n_stacks;
+}
+
+
+const struct orm_bin_dec_stack*
+orm_bin_dec_stack(const struct orm_bin_dec* dec, int i)
+{
+  return &dec->stacks[i];
+}
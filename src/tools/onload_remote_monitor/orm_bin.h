@@ -0,0 +1,113 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* X-SPDX-Copyright-Text: (c) Copyright 2024 Advanced Micro Devices, Inc. */
+
+/* Compact binary encoding of stack counters for streaming telemetry.
+ *
+ * A stream is a series of messages, each starting with
+ *
+ *   'O' 'B' version type varint(seq) varint(schema_id)
+ *
+ * Integers are LEB128 varints, and signed ones are zigzag encoded first.
+ * Strings are a varint length followed by the bytes, without a nul.
+ *
+ * ORM_BIN_MSG_SCHEMA gives the names of the counters, in the order used by
+ * the other messages:
+ *
+ *   varint(n_counters) { string(name) }*
+ *
+ * ORM_BIN_MSG_KEY gives the value of every counter, and ORM_BIN_MSG_DELTA
+ * the change in each since the previous message of either kind:
+ *
+ *   varint(time_us) varint(n_stacks) { stack }*
+ *   stack := varint(stack_id) u8(flags) [string(name)] { counter }* end
+ *   counter := varint(skip) zigzag(delta)
+ *   end := varint(n_counters - index)
+ *
+ * [skip] is the number of unchanged counters before the one which follows,
+ * and the record ends when skipping takes the index to n_counters.  A
+ * stack with ORM_BIN_STACK_NEW is followed by its name, and its deltas are
+ * from zero; all stacks are new in a key message.  Stacks missing from a
+ * message have gone away.
+ *
+ * A receiver needs a schema and then a key message with the same
+ * schema_id before it can apply deltas.  If [seq] shows that a message was
+ * missed it must wait for the next key message.
+ */
+
+#ifndef __ORM_BIN_H__
+#define __ORM_BIN_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define ORM_BIN_MAGIC0     'O'
+#define ORM_BIN_MAGIC1     'B'
+#define ORM_BIN_VERSION    1
+
+#define ORM_BIN_MSG_SCHEMA 1
+#define ORM_BIN_MSG_KEY    2
+#define ORM_BIN_MSG_DELTA  3
+
+#define ORM_BIN_STACK_NEW  0x1
+
+
+/**********************************************************/
+/* Encoder */
+/**********************************************************/
+
+struct orm_bin_enc;
+
+/* Create an encoder for the given counters.  [names] must remain valid for
+ * the lifetime of the encoder. */
+extern struct orm_bin_enc* orm_bin_enc_new(const char* const* names,
+                                           int n_counters);
+extern void orm_bin_enc_free(struct orm_bin_enc* enc);
+
+/* Returns the schema message. */
+extern int orm_bin_enc_schema(struct orm_bin_enc* enc,
+                              const uint8_t** msg, size_t* len);
+
+/* Build a key or delta message from the stacks added since the previous
+ * one. */
+extern void orm_bin_enc_begin(struct orm_bin_enc* enc, bool key,
+                              uint64_t time_us);
+extern int orm_bin_enc_stack(struct orm_bin_enc* enc, unsigned stack_id,
+                             const char* name, const uint64_t* values);
+extern int orm_bin_enc_end(struct orm_bin_enc* enc,
+                           const uint8_t** msg, size_t* len);
+
+
+/**********************************************************/
+/* Decoder */
+/**********************************************************/
+
+struct orm_bin_dec;
+
+struct orm_bin_dec_stack {
+  unsigned        id;
+  char*           name;
+  uint64_t*       values;
+  /* Counters changed by the last message */
+  bool*           changed;
+};
+
+extern struct orm_bin_dec* orm_bin_dec_new(void);
+extern void orm_bin_dec_free(struct orm_bin_dec* dec);
+
+/* Apply a message.  Returns the message type, 0 if the message had to be
+ * ignored until the stream is resynchronised, or -EINVAL if it is
+ * malformed. */
+extern int orm_bin_dec_feed(struct orm_bin_dec* dec,
+                            const uint8_t* msg, size_t len);
+
+/* State after the last message which was applied */
+extern int orm_bin_dec_n_counters(const struct orm_bin_dec* dec);
+extern const char* orm_bin_dec_name(const struct orm_bin_dec* dec, int i);
+extern uint64_t orm_bin_dec_time_us(const struct orm_bin_dec* dec);
+extern int orm_bin_dec_n_stacks(const struct orm_bin_dec* dec);
+extern const struct orm_bin_dec_stack*
+orm_bin_dec_stack(const struct orm_bin_dec* dec, int i);
+
+#endif  /* __ORM_BIN_H__ */
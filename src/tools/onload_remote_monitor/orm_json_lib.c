@@ -109,9 +109,13 @@ static int orm_map_stack(orm_state_t* state, unsigned stack_id)
   state->stacks = new_stacks;
   state->stacks[state->n_stacks++] = orm_stack;
   orm_stack->os_id = stack_id;
-  if( (rc = ci_netif_restore_id(&orm_stack->os_ni, stack_id, true)) != 0 )
+  if( (rc = ci_netif_restore_id(&orm_stack->os_ni, stack_id, true)) != 0 ) {
     LOG("%s: Fail: ci_netif_restore_id(%d)=%d\n", __func__,
             stack_id, rc);
+    /* Only mapped stacks are kept, so that they can be unmapped. */
+    --state->n_stacks;
+    free(orm_stack);
+  }
   return rc;
 }
 
@@ -797,6 +801,48 @@ static void orm_dump_struct_ci_netif_config_opts(char* label, ci_netif_config_op
 #include "ftl_decls.h"
 
 
+#if CI_CFG_LATENCY_HIST
+static const char* const orm_lat_hist_names[CI_LAT_HIST_N] = {
+  [CI_LAT_HIST_RX] = "rx",
+  [CI_LAT_HIST_TX] = "tx",
+};
+
+static unsigned long long orm_lat_hist_ns(ci_netif* ni, ci_uint64 ticks)
+{
+  return ticks * 1000000 / IPTIMER_STATE(ni)->khz;
+}
+
+/* Only the buckets which have counted something are output, each as the
+ * smallest latency in ns that it counts and the count. */
+static void orm_oo_lat_hist_dump(ci_netif* ni, const char* label,
+                                 const ci_lat_hist* hists)
+{
+  ci_lat_hist h;
+  unsigned i, j;
+
+  dump_buf_label("\"", label, "\":{");
+  for( i = 0; i < CI_LAT_HIST_N; ++i ) {
+    memcpy(&h, &hists[i], sizeof(h));
+    dump_buf_label("\"", orm_lat_hist_names[i], "\":{");
+    dump_buf_cat_comma("\"max_ns\":%llu", orm_lat_hist_ns(ni, h.max));
+    dump_buf_literal("\"buckets\":[");
+    for( j = 0; j < CI_LAT_HIST_N_BUCKETS; ++j )
+      if( h.bucket[j] != 0 )
+        dump_buf_cat_comma("[%llu,%u]",
+                           j == 0 ? 0 :
+                           orm_lat_hist_ns(ni, ci_lat_hist_bucket_lo(j)),
+                           h.bucket[j]);
+    dump_buf_cleanup();
+    dump_buf_literal_comma("]");
+    dump_buf_cleanup();
+    dump_buf_literal_comma("}");
+  }
+  dump_buf_cleanup();
+  dump_buf_literal_comma("}");
+}
+#endif
+
+
 static void orm_waitable_dump(ci_netif* ni, const char* sock_type,
                               int output_flags, const sockbuf_filter_t* sft)
 {
@@ -822,6 +868,10 @@ static void orm_waitable_dump(ci_netif* ni, const char* sock_type,
                sockbuf_filter_matches(sft, wo) ) {
         dump_buf_cat("\"%d\":{", W_FMT(w));
         orm_dump_struct_ci_tcp_state("tcp_state", &wo->tcp, output_flags);
+#if CI_CFG_LATENCY_HIST_SOCK
+        if( output_flags & ORM_OUTPUT_LAT_HIST )
+          orm_oo_lat_hist_dump(ni, "lat_hist", wo->tcp.s.lat_hist);
+#endif
         dump_buf_cleanup();
         dump_buf_literal_comma("}");
       }
@@ -830,6 +880,10 @@ static void orm_waitable_dump(ci_netif* ni, const char* sock_type,
                sockbuf_filter_matches(sft, wo) ) {
         dump_buf_cat("\"%d\":{", W_FMT(w));
         orm_dump_struct_ci_udp_state("udp_state", &wo->udp, output_flags);
+#if CI_CFG_LATENCY_HIST_SOCK
+        if( output_flags & ORM_OUTPUT_LAT_HIST )
+          orm_oo_lat_hist_dump(ni, "lat_hist", wo->udp.s.lat_hist);
+#endif
         dump_buf_cleanup();
         dump_buf_literal_comma("}");
       }
@@ -981,6 +1035,10 @@ static int orm_netif_dump(ci_netif* ni, int id, int output_flags, bool cfg_flat,
       return rc;
     }
   }
+#if CI_CFG_LATENCY_HIST
+  if (output_flags & ORM_OUTPUT_LAT_HIST)
+    orm_oo_lat_hist_dump(ni, "lat_hist", ni->state->lat_hist);
+#endif
   dump_buf_cleanup();
   if( ! cfg_flat )
     dump_buf_literal("}}");
@@ -1031,6 +1089,8 @@ int orm_parse_output_flags(int argc, const char* const* argv)
       output_flags |= ORM_OUTPUT_VIS;
     else if ( !strcmp(argv[i], "opts") )
       output_flags |= ORM_OUTPUT_OPTS;
+    else if ( !strcmp(argv[i], "lat_hist") )
+      output_flags |= ORM_OUTPUT_LAT_HIST;
     else if ( !strcmp(argv[i], "lots") )
       output_flags |= ORM_OUTPUT_LOTS;
     else if ( !strcmp(argv[i], "extra") )
@@ -1185,3 +1245,142 @@ done:
 
   return rc;
 }
+
+
+/**********************************************************/
+/* Counter sampling */
+/**********************************************************/
+
+struct orm_sampler {
+  orm_state_t state;
+  const char* stackname;
+};
+
+
+#define OO_STAT(desc, type, name, kind)  PREFIX #name,
+
+static const char* const orm_counter_names[] = {
+#define PREFIX "stats."
+#include <ci/internal/stats_def.h>
+#undef PREFIX
+#define PREFIX "more_stats."
+#include <ci/internal/more_stats_def.h>
+#undef PREFIX
+#define PREFIX "tcp_stats."
+#include <ci/internal/tcp_stats_count_def.h>
+#undef PREFIX
+#define PREFIX "tcp_ext_stats."
+#include <ci/internal/tcp_ext_stats_count_def.h>
+#undef PREFIX
+};
+
+#undef OO_STAT
+
+#define ORM_N_COUNTERS \
+  (sizeof(orm_counter_names) / sizeof(orm_counter_names[0]))
+
+
+const char* const* orm_counter_names_get(int* n_counters)
+{
+  *n_counters = ORM_N_COUNTERS;
+  return orm_counter_names;
+}
+
+
+static void orm_sampler_unmap(struct orm_sampler* smp)
+{
+  int i;
+  for( i = 0; i < smp->state.n_stacks; ++i )
+    ci_netif_dtor(&smp->state.stacks[i]->os_ni);
+  orm_unmap_stacks(&smp->state);
+  smp->state.n_stacks = 0;
+}
+
+
+struct orm_sampler* orm_sampler_new(const struct orm_cfg* cfg)
+{
+  struct orm_sampler* smp = calloc(1, sizeof(*smp));
+  if( smp != NULL )
+    smp->stackname = cfg->stackname;
+  return smp;
+}
+
+
+void orm_sampler_free(struct orm_sampler* smp)
+{
+  orm_sampler_unmap(smp);
+  free(smp);
+}
+
+
+int orm_sampler_refresh(struct orm_sampler* smp)
+{
+  orm_sampler_unmap(smp);
+  if( orm_map_stacks(&smp->state) != 0 ) {
+    orm_sampler_unmap(smp);
+    return -EFAULT;
+  }
+  return 0;
+}
+
+
+int orm_sampler_n_stacks(const struct orm_sampler* smp)
+{
+  return smp->state.n_stacks;
+}
+
+
+#define OO_STAT(desc, type, name, kind)  *v++ = stats->name;
+
+static uint64_t* orm_read_stats(uint64_t* v, const ci_netif_stats* stats)
+{
+#include <ci/internal/stats_def.h>
+  return v;
+}
+
+
+static uint64_t* orm_read_more_stats(uint64_t* v, const more_stats_t* stats)
+{
+#include <ci/internal/more_stats_def.h>
+  return v;
+}
+
+
+static uint64_t* orm_read_tcp_stats_count(uint64_t* v,
+                                          const ci_tcp_stats_count* stats)
+{
+#include <ci/internal/tcp_stats_count_def.h>
+  return v;
+}
+
+
+static uint64_t*
+orm_read_tcp_ext_stats_count(uint64_t* v, const ci_tcp_ext_stats_count* stats)
+{
+#include <ci/internal/tcp_ext_stats_count_def.h>
+  return v;
+}
+
+#undef OO_STAT
+
+
+int orm_sampler_read(struct orm_sampler* smp, int i, unsigned* stack_id,
+                     const char** name, uint64_t* values)
+{
+  ci_netif* ni = &smp->state.stacks[i]->os_ni;
+  more_stats_t more_stats;
+  uint64_t* v = values;
+
+  if( smp->stackname != NULL && strcmp(smp->stackname, ni->state->name) )
+    return 0;
+
+  *stack_id = smp->state.stacks[i]->os_id;
+  *name = ni->state->name;
+  get_more_stats(ni, &more_stats);
+  v = orm_read_stats(v, &ni->state->stats);
+  v = orm_read_more_stats(v, &more_stats);
+  v = orm_read_tcp_stats_count(v, &ni->state->stats_snapshot.tcp);
+  v = orm_read_tcp_ext_stats_count(v, &ni->state->stats_snapshot.tcp_ext);
+  ci_assert_equal(v - values, ORM_N_COUNTERS);
+  return 1;
+}
@@ -11,6 +11,7 @@
 #define ORM_OUTPUT_SOCKETS 0x20
 #define ORM_OUTPUT_VIS 0x40
 #define ORM_OUTPUT_OPTS 0x100
+#define ORM_OUTPUT_LAT_HIST 0x200
 #define ORM_OUTPUT_EXTRA 0x100000
 #define ORM_OUTPUT_LOTS 0xFFFFF
 #define ORM_OUTPUT_SUM (ORM_OUTPUT_STATS | ORM_OUTPUT_MORE_STATS | \
@@ -36,3 +37,28 @@ extern int orm_parse_output_flags(int argc, const char* const* argv);
 extern int orm_do_dump(const struct orm_cfg* cfg, int output_flags,
                        FILE* output_stream);
 
+
+/* Sampling of the counters in ORM_OUTPUT_SUM as arrays of integers, for
+ * the binary stream (see orm_bin.h).  Unlike orm_do_dump(), which maps the
+ * stacks afresh on each call, the sampler keeps them mapped until the next
+ * orm_sampler_refresh(), so new stacks are seen only then and stacks which
+ * have gone are kept alive until then.
+ */
+struct orm_sampler;
+
+/* Returns the names of the counters, in the order they are read. */
+extern const char* const* orm_counter_names_get(int* n_counters);
+
+extern struct orm_sampler* orm_sampler_new(const struct orm_cfg* cfg);
+extern void orm_sampler_free(struct orm_sampler* smp);
+
+/* Map the stacks which exist now.  Return 0 on success, or negative error
+ * code */
+extern int orm_sampler_refresh(struct orm_sampler* smp);
+extern int orm_sampler_n_stacks(const struct orm_sampler* smp);
+
+/* Read the counters of the i'th mapped stack into [values].  Returns 1, or
+ * 0 if the stack is excluded by orm_cfg.stackname. */
+extern int orm_sampler_read(struct orm_sampler* smp, int i,
+                            unsigned* stack_id, const char** name,
+                            uint64_t* values);
@@ -11,10 +11,14 @@
 #include <czmq.h>
 
 #include "orm_json_lib.h"
+#include "orm_bin.h"
 
 
 static struct orm_cfg cfg;
 static int cfg_interval = 10;
+static int cfg_interval_ms = 0;
+static int cfg_binary = 0;
+static int cfg_keyframe = 100;
 static char* cfg_endpoint = "tcp://*:5556";
 
 static ci_cfg_desc cfg_opts[] = {
@@ -32,31 +36,36 @@ static ci_cfg_desc cfg_opts[] = {
     "ZMQ endpoint to publish stats (default tcp://*:5556)" },
   { 0, "interval",  CI_CFG_INT,  &cfg_interval,
     "Interval between stats in seconds (default 10s)" },
+  { 0, "interval-ms",  CI_CFG_INT,  &cfg_interval_ms,
+    "Interval between stats in milliseconds (overrides --interval)" },
+  { 0, "binary", CI_CFG_FLAG,   &cfg_binary,
+    "publish counter deltas in binary (see orm_bin.h) instead of JSON" },
+  { 0, "keyframe",  CI_CFG_INT,  &cfg_keyframe,
+    "With --binary, send all counters every this many messages "
+    "(default 100)" },
 };
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
 
-int main(int argc, char** argv)
+static void orm_sleep_until(struct timespec* next)
 {
-  ci_app_standard_opts = 0;
-  ci_app_getopt(
-    "[stats] [more_stats] [tcp_stats] [stack] [stack_state] [vis] [opts] "
-    "[lots] [extra] [all]",
-    &argc, argv, cfg_opts, N_CFG_OPTS);
-  ++argv;  --argc;
+  next->tv_nsec += (long) (cfg_interval_ms % 1000) * 1000000;
+  next->tv_sec += cfg_interval_ms / 1000 + next->tv_nsec / 1000000000;
+  next->tv_nsec %= 1000000000;
+  /* Sleep to an absolute time so that the interval does not drift by the
+   * time taken to publish. */
+  while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL) == EINTR
+         && ! zsys_interrupted )
+    ;
+}
 
-  int output_flags = orm_parse_output_flags(argc, (const char * const*)argv);
-  if( output_flags < 0 ) {
-    printf("Invalid option specified\n");
-    return EXIT_FAILURE;
-  }
-  unsigned int n = 0;
 
-  printf("Publishing stats to ZMQ endpoint: %s\n", cfg_endpoint);
-  zsock_t* publisher = zsock_new_pub(cfg_endpoint);
-  // allow ^C etc to stop the app
-  zsys_catch_interrupts();
+static void orm_publish_json(zsock_t* publisher, int output_flags)
+{
+  struct timespec next;
+  unsigned int n = 0;
 
+  clock_gettime(CLOCK_MONOTONIC, &next);
   while( 1 ) {
     if( zsys_interrupted )
       break;
@@ -80,8 +89,117 @@ int main(int argc, char** argv)
     fflush(stdout);
     free(data);
 
-    sleep(cfg_interval);
+    orm_sleep_until(&next);
   }
+}
+
+
+static int orm_send_bin(zsock_t* publisher, const uint8_t* msg, size_t len)
+{
+  zframe_t* frame = zframe_new(msg, len);
+  return frame ? zframe_send(&frame, publisher, 0) : -ENOMEM;
+}
+
+
+/* Stacks are looked for again at each key message, which is also preceded
+ * by the schema so that subscribers can join at any key message. */
+static void orm_publish_bin(zsock_t* publisher)
+{
+  const char* const* names;
+  struct orm_bin_enc* enc;
+  struct orm_sampler* smp;
+  struct timespec next, now;
+  uint64_t* values;
+  const uint8_t* msg;
+  size_t len;
+  unsigned int n = 0;
+  int n_counters, i, rc;
+
+  names = orm_counter_names_get(&n_counters);
+  enc = orm_bin_enc_new(names, n_counters);
+  smp = orm_sampler_new(&cfg);
+  values = calloc(n_counters, sizeof(*values));
+  if( enc == NULL || smp == NULL || values == NULL ) {
+    printf("Out of memory\n");
+    goto out;
+  }
+  if( cfg_keyframe <= 0 )
+    cfg_keyframe = 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while( 1 ) {
+    bool key = n % cfg_keyframe == 0;
+
+    if( zsys_interrupted )
+      break;
+
+    if( key ) {
+      if( (rc = orm_sampler_refresh(smp)) != 0 )
+        printf("Not able to map stacks rc=%d\n", rc);
+      if( orm_bin_enc_schema(enc, &msg, &len) == 0 )
+        orm_send_bin(publisher, msg, len);
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    orm_bin_enc_begin(enc, key, now.tv_sec * 1000000ull + now.tv_nsec / 1000);
+    rc = 0;
+    for( i = 0; i < orm_sampler_n_stacks(smp) && rc == 0; ++i ) {
+      unsigned stack_id;
+      const char* name;
+      if( orm_sampler_read(smp, i, &stack_id, &name, values) )
+        rc = orm_bin_enc_stack(enc, stack_id, name, values);
+    }
+    if( rc == 0 )
+      rc = orm_bin_enc_end(enc, &msg, &len);
+
+    if( rc == 0 ) {
+      orm_send_bin(publisher, msg, len);
+      ++n;
+    }
+    else {
+      printf("Not able to encode stats rc=%d\n", rc);
+      /* The encoder's state no longer matches what was sent. */
+      n = 0;
+    }
+
+    orm_sleep_until(&next);
+  }
+
+ out:
+  free(values);
+  if( smp != NULL )
+    orm_sampler_free(smp);
+  if( enc != NULL )
+    orm_bin_enc_free(enc);
+}
+
+
+int main(int argc, char** argv)
+{
+  ci_app_standard_opts = 0;
+  ci_app_getopt(
+    "[stats] [more_stats] [tcp_stats] [stack] [stack_state] [vis] [opts] "
+    "[lat_hist] "
+    "[lots] [extra] [all]",
+    &argc, argv, cfg_opts, N_CFG_OPTS);
+  ++argv;  --argc;
+
+  int output_flags = orm_parse_output_flags(argc, (const char * const*)argv);
+  if( output_flags < 0 ) {
+    printf("Invalid option specified\n");
+    return EXIT_FAILURE;
+  }
+  printf("Publishing stats to ZMQ endpoint: %s\n", cfg_endpoint);
+  zsock_t* publisher = zsock_new_pub(cfg_endpoint);
+  // allow ^C etc to stop the app
+  zsys_catch_interrupts();
+
+  if( cfg_interval_ms <= 0 )
+    cfg_interval_ms = cfg_interval * 1000;
+  if( cfg_binary )
+    orm_publish_bin(publisher);
+  else
+    orm_publish_json(publisher, output_flags);
 
   // clean up
   zsock_destroy(&publisher);
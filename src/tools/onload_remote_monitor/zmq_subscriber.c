@@ -11,6 +11,8 @@
 
 #include <czmq.h>
 
+#include "orm_bin.h"
+
 static char* cfg_endpoint = "tcp://localhost:5556";
 
 static ci_cfg_desc cfg_opts[] = {
@@ -21,6 +23,28 @@ static ci_cfg_desc cfg_opts[] = {
 #define N_CFG_OPTS (sizeof(cfg_opts) / sizeof(cfg_opts[0]))
 
 
+/* Print the stacks' counters as a line of JSON: all of them after a key
+ * message, and only those which changed after a delta. */
+static void orm_bin_print(const struct orm_bin_dec* dec, int type)
+{
+  int i, j, n_counters = orm_bin_dec_n_counters(dec);
+
+  printf("{\"time_us\":\"%llu\",\"type\":\"%s\",\"stacks\":[",
+         (unsigned long long) orm_bin_dec_time_us(dec),
+         type == ORM_BIN_MSG_KEY ? "key" : "delta");
+  for( i = 0; i < orm_bin_dec_n_stacks(dec); ++i ) {
+    const struct orm_bin_dec_stack* s = orm_bin_dec_stack(dec, i);
+    printf("%s{\"id\":%u,\"name\":\"%s\"", i ? "," : "", s->id, s->name);
+    for( j = 0; j < n_counters; ++j )
+      if( type == ORM_BIN_MSG_KEY || s->changed[j] )
+        printf(",\"%s\":\"%llu\"", orm_bin_dec_name(dec, j),
+               (unsigned long long) s->values[j]);
+    printf("}");
+  }
+  printf("]}\n");
+}
+
+
 int main (int argc, char *argv [])
 {
   ci_app_standard_opts = 0;
@@ -28,7 +52,7 @@ int main (int argc, char *argv [])
   ++argv;  --argc;
 
   unsigned int update_n = 0;
-  char* buffer = NULL;
+  struct orm_bin_dec* dec = orm_bin_dec_new();
 
   // allow ^C etc to stop the app
   zsys_catch_interrupts();
@@ -39,15 +63,35 @@ int main (int argc, char *argv [])
   fprintf(stderr, "Waiting for update from publisher...\n");
 
   while( 1 ) {
-    buffer = zstr_recv(subscriber);
-    if( zsys_interrupted )
+    zframe_t* frame = zframe_recv(subscriber);
+    if( zsys_interrupted || frame == NULL ) {
+      zframe_destroy(&frame);
       break;
+    }
     ++update_n;
-    fprintf(stderr, "Received update #%u :\n", update_n);
-    printf("%s\n", buffer);
-    zstr_free(&buffer);
+
+    const uint8_t* data = zframe_data(frame);
+    size_t len = zframe_size(frame);
+    if( len >= 2 && data[0] == ORM_BIN_MAGIC0 && data[1] == ORM_BIN_MAGIC1 ) {
+      int type = orm_bin_dec_feed(dec, data, len);
+      if( type < 0 )
+        fprintf(stderr, "Bad binary update #%u\n", update_n);
+      else if( type == 0 )
+        fprintf(stderr, "Waiting for key update, skipped #%u\n", update_n);
+      else if( type != ORM_BIN_MSG_SCHEMA )
+        orm_bin_print(dec, type);
+    }
+    else {
+      char* buffer = zframe_strdup(frame);
+      fprintf(stderr, "Received update #%u :\n", update_n);
+      printf("%s\n", buffer);
+      free(buffer);
+    }
+    fflush(stdout);
+    zframe_destroy(&frame);
   }
 
+  orm_bin_dec_free(dec);
   zsock_destroy(&subscriber);
   return 0;
 }